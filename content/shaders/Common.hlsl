@@ -4,10 +4,17 @@
 #define SH_C0 0.282094792f // 1 / 2sqrt(pi)
 #define SH_C1 0.488602512f // sqrt(3/pi) / 2
 
+// LPV_DIM is set by DXRSExampleGIScene for every shader, the fallback keeps standalone compiles working
+#ifndef LPV_DIM
 #define LPV_DIM 32
-#define LPV_DIM_HALF 16
-#define LPV_DIM_INVERSE 0.03125f
+#endif
+#define LPV_DIM_HALF (LPV_DIM / 2)
+#define LPV_DIM_INVERSE (1.0f / LPV_DIM)
 #define LPV_SCALE 0.25f
+// cascades the LPV textures have room for, stacked along z, LPV_DIM slices each
+#ifndef LPV_CASCADES
+#define LPV_CASCADES 1
+#endif
 
 static const float FLT_MAX = asfloat(0x7F7FFFFF);
 
@@ -91,12 +98,18 @@ float3 OffsetRay(const float3 p, const float3 n)
 		abs(p.z) < origin ? p.z + floatScale * n.z : p_i.z);
 }
 
-// Get a cosine-weighted random vector centered around a specified normal direction.
-float3 GetCosHemisphereSample(inout uint randSeed, float3 hitNorm)  
+// Per pixel dither of the sampling library (Sampling.h): R2 over the pixel grid and interleaved gradient noise
+// (Jimenez 2014), both spread evenly over the screen, shifted by the per frame rotation
+float2 GetPixelSample(float2 pixel, float2 rotation)
 {
-	// Get 2 random numbers to select our sample with
-    float2 randVal = float2(nextRand(randSeed), nextRand(randSeed));
+    float r2 = frac(dot(pixel, float2(0.75487766f, 0.56984029f)));
+    float ign = frac(52.9829189f * frac(dot(pixel, float2(0.06711056f, 0.00583715f))));
+    return frac(float2(r2, ign) + rotation);
+}
 
+// Get a cosine-weighted vector centered around a specified normal direction from 2 numbers in [0, 1).
+float3 GetCosHemisphereSample(float2 randVal, float3 hitNorm)
+{
 	// Cosine weighted hemisphere sample from RNG
     float3 bitangent = getPerpendicularVector(hitNorm);
     float3 tangent = cross(bitangent, hitNorm);
@@ -107,6 +120,13 @@ float3 GetCosHemisphereSample(inout uint randSeed, float3 hitNorm)
     return tangent * (r * cos(phi).x) + bitangent * (r * sin(phi)) + hitNorm.xyz * sqrt(1 - randVal.x);
 }
 
+// Get a cosine-weighted random vector centered around a specified normal direction.
+float3 GetCosHemisphereSample(inout uint randSeed, float3 hitNorm)
+{
+	// Get 2 random numbers to select our sample with
+    return GetCosHemisphereSample(float2(nextRand(randSeed), nextRand(randSeed)), hitNorm);
+}
+
 struct Payload
 {
     bool skipShading;
@@ -126,4 +146,11 @@ float4 DirToSH(float3 direction)
 float4 DirCosLobeToSH(float3 direction)
 {
     return float4(SH_COSINE_LOBE_C0, -SH_COSINE_LOBE_C1 * direction.y, SH_COSINE_LOBE_C1 * direction.z, -SH_COSINE_LOBE_C1 * direction.x);
+}
+
+// Distance in cells to the nearest face of an LPV cascade, negative outside (LPVCascades::GetBorderDistance)
+float LPVBorderDistance(float3 cell)
+{
+    float3 distance = min(cell, float3(LPV_DIM, LPV_DIM, LPV_DIM) - cell);
+    return min(distance.x, min(distance.y, distance.z));
 }
\ No newline at end of file
@@ -33,6 +33,7 @@ cbuffer DXRConstantBuffer : register(b0)
     float2 ScreenResolution;
     float2 RTAORadiusPower;
     int FrameIndex;
+    float2 SampleRotation;
 }
 
 cbuffer LightsConstantBuffer : register(b1)
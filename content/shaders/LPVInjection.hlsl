@@ -17,6 +17,12 @@ cbuffer LPVConstantBuffer : register(b0)
     float LPVCutoff;
     float LPVPower;
     float LPVAttenuation;
+    int LPVCascadeCount;
+    float4 LPVCascadeTransforms[LPV_CASCADES]; // cell = position * w + xyz
+    float LPVCascadeMargin;
+    float LPVCascadeBlend;
+    int LPVInjectCoarser;
+    float LPVStorageScale; // the SH volumes hold the coefficients divided by it (LPVSHCodec)
 };
 
 struct VS_IN
@@ -26,7 +32,7 @@ struct VS_IN
 
 struct GS_IN
 {
-    float4 cellPos : SV_POSITION;
+    float3 positionWS : POSITION;
     float3 normal : NORMAL;
     float3 flux : FLUX;
 };
@@ -65,34 +71,56 @@ GS_IN VSMain(VS_IN input)
 
     RSMTexel texel = GetRSMTexel(rsmCoords.xy);
 
-    float3 pos = texel.positionWS;
-    output.cellPos = float4(int3(pos * LPV_SCALE + float3(LPV_DIM_HALF, LPV_DIM_HALF, LPV_DIM_HALF) + 0.5f * texel.normalWS), 1.0f);
+    output.positionWS = texel.positionWS;
     output.normal = texel.normalWS;
     output.flux = texel.flux;
     
     return output;
 }
 
-[maxvertexcount(1)]
+// one point per cascade the VPL is routed to, see LPVCascades::Route
+[maxvertexcount(LPV_CASCADES)]
 void GSMain(point GS_IN input[1], inout PointStream<PS_IN> OutputStream)
 {
-    PS_IN output = (PS_IN)0;
-    output.layerID = floor(input[0].cellPos.z);
-    
-    output.screenPos = float4((input[0].cellPos.xy + 0.5f) * LPV_DIM_INVERSE * 2.0f - 1.0f, 0.0f, 1.0f);
-    output.screenPos.y = -output.screenPos.y;
+    int lastCascade = LPVCascadeCount - 1;
+    int targetCascade = lastCascade;
+    for (int i = 0; i < lastCascade; i++)
+    {
+        if (LPVBorderDistance(input[0].positionWS * LPVCascadeTransforms[i].w + LPVCascadeTransforms[i].xyz) >= LPVCascadeMargin)
+        {
+            targetCascade = i;
+            break;
+        }
+    }
+
+    for (int cascade = targetCascade; cascade <= lastCascade; cascade++)
+    {
+        float3 cell = input[0].positionWS * LPVCascadeTransforms[cascade].w + LPVCascadeTransforms[cascade].xyz;
+        if (cascade > targetCascade && (!LPVInjectCoarser || LPVBorderDistance(cell) < 0.0f))
+            continue;
+
+        int3 cellPos = int3(cell + 0.5f * input[0].normal);
+        if (any(cellPos < 0) || any(cellPos >= LPV_DIM))
+            continue;
+
+        PS_IN output = (PS_IN)0;
+        output.layerID = cascade * LPV_DIM + cellPos.z;
+
+        output.screenPos = float4((cellPos.xy + 0.5f) * LPV_DIM_INVERSE * 2.0f - 1.0f, 0.0f, 1.0f);
+        output.screenPos.y = -output.screenPos.y;
 
-    output.normal = input[0].normal;
-    output.flux = input[0].flux;
+        output.normal = input[0].normal;
+        output.flux = input[0].flux;
 
-    OutputStream.Append(output);
+        OutputStream.Append(output);
+    }
 }
 
 PS_OUT PSMain(PS_IN input)
 {
     PS_OUT output = (PS_OUT) 0;
     
-    float4 SH_coef = DirCosLobeToSH(input.normal) / PI;
+    float4 SH_coef = DirCosLobeToSH(input.normal) / (PI * LPVStorageScale);
     output.redSH = SH_coef * input.flux.r;
     output.greenSH = SH_coef * input.flux.g;
     output.blueSH = SH_coef * input.flux.b;
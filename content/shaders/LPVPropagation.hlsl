@@ -3,6 +3,8 @@
 Texture3D<float4> redSH : register(t0);
 Texture3D<float4> greenSH : register(t1);
 Texture3D<float4> blueSH : register(t2);
+// occlusion SH of the surfaces in every cell, zero without occluders (LPVGeometryVolume)
+Texture3D<float4> geometryVolume : register(t3);
 
 static const float3 cellDirections[6] = 
 {
@@ -98,19 +100,41 @@ float3 getReprojSideDirection(int index, int3 orientation)
     return float3(orientation.x * side.x, orientation.y * side.y, 0);
 }
 
+// Fraction of the light towards direction the occluders of a cell block (LPVGeometryVolume::GetBlocking)
+float GetBlocking(float4 occlusion, float3 direction)
+{
+    float coverage = occlusion.x / SH_COSINE_LOBE_C0;
+    float3 normal = float3(-occlusion.w, -occlusion.y, occlusion.z) / SH_COSINE_LOBE_C1;
+    
+    float facing = max(dot(normal, direction), 0.0f);
+    float cancelled = max(coverage - length(normal), 0.0f);
+    return min(facing + 0.5f * cancelled, 1.0f);
+}
+
 SHContribution GetSHGatheringContribution(int4 cellIndex)
 {
     SHContribution result = (SHContribution) 0;
     
+    // cascades are stacked along z, light does not cross into the next one
+    int cascadeFirstSlice = (cellIndex.z / LPV_DIM) * LPV_DIM;
     for (int neighbourCell = 0; neighbourCell < 6; neighbourCell++)
     {
         int4 neighbourPos = cellIndex - int4(cellDirections[neighbourCell], 0);
+        if (neighbourPos.z < cascadeFirstSlice || neighbourPos.z >= cascadeFirstSlice + LPV_DIM)
+            continue;
         
         SHContribution neighbourContribution = (SHContribution) 0;
         neighbourContribution.red = redSH.Load(neighbourPos);
         neighbourContribution.green = greenSH.Load(neighbourPos);
         neighbourContribution.blue = blueSH.Load(neighbourPos);
         
+        // surfaces in either cell facing the neighbour block the light coming from it
+        float3 against = -cellDirections[neighbourCell];
+        float transmittance = 1.0f - max(GetBlocking(geometryVolume.Load(neighbourPos), against), GetBlocking(geometryVolume.Load(cellIndex), against));
+        neighbourContribution.red *= transmittance;
+        neighbourContribution.green *= transmittance;
+        neighbourContribution.blue *= transmittance;
+        
         // add contribution from main direction
         float4 directionCosLobeSH = DirCosLobeToSH(cellDirections[neighbourCell]);
         float4 directionSH = DirToSH(cellDirections[neighbourCell]);
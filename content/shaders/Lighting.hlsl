@@ -29,6 +29,12 @@ cbuffer LPVConstantBuffer : register(b2)
     float LPVCutoff;
     float LPVPower;
     float LPVAttenuation;
+    int LPVCascadeCount;
+    float4 LPVCascadeTransforms[LPV_CASCADES]; // cell = position * w + xyz
+    float LPVCascadeMargin;
+    float LPVCascadeBlend;
+    int LPVInjectCoarser;
+    float LPVStorageScale; // the SH volumes hold the coefficients divided by it (LPVSHCodec)
 }
 
 cbuffer IlluminationFlagsBuffer : register(b3)
@@ -245,13 +251,32 @@ PSOutput PSMain(PSInput input)
     
         float3 lpv = float3(0.0f, 0.0f, 0.0f);
         float4 SHintensity = DirToSH(normal.rgb);
-        float3 lpvCellCoords = (worldPos.rgb * LPV_SCALE + float3(LPV_DIM_HALF, LPV_DIM_HALF, LPV_DIM_HALF)) * LPV_DIM_INVERSE;
-        float4 lpvIntensity =
-        float4(
-	    	max(0.0f, dot(SHintensity, redSH.Sample(samplerLPV, lpvCellCoords))),
-	    	max(0.0f, dot(SHintensity, greenSH.Sample(samplerLPV, lpvCellCoords))),
-	    	max(0.0f, dot(SHintensity, blueSH.Sample(samplerLPV, lpvCellCoords))),
-	    1.0f) / PI;
+        float4 lpvIntensity = float4(0.0f, 0.0f, 0.0f, 1.0f);
+
+        // finest cascade first, fading into the next coarser one near its border (LPVCascades::GetBlendWeights)
+        float remainingWeight = 1.0f;
+        for (int cascade = 0; cascade < LPVCascadeCount && remainingWeight > 0.0f; cascade++)
+        {
+            float3 cell = worldPos.rgb * LPVCascadeTransforms[cascade].w + LPVCascadeTransforms[cascade].xyz;
+            float borderDistance = LPVBorderDistance(cell);
+            float weight = (cascade == LPVCascadeCount - 1) ? (borderDistance >= 0.0f ? 1.0f : 0.0f) :
+                saturate((borderDistance - LPVCascadeMargin) / max(LPVCascadeBlend, 1e-6f));
+            weight *= remainingWeight;
+            remainingWeight -= weight;
+            if (weight <= 0.0f)
+                continue;
+
+            // stay inside the cascade's slices so the filter never reads the neighbouring cascade,
+            // SampleLevel since the loop is not uniform across the quad
+            float3 lpvCellCoords = float3(cell.xy * LPV_DIM_INVERSE,
+                (cascade * LPV_DIM + clamp(cell.z, 0.5f, LPV_DIM - 0.5f)) / (LPV_DIM * LPV_CASCADES));
+            lpvIntensity.rgb += weight * float3(
+                max(0.0f, dot(SHintensity, redSH.SampleLevel(samplerLPV, lpvCellCoords, 0))),
+                max(0.0f, dot(SHintensity, greenSH.SampleLevel(samplerLPV, lpvCellCoords, 0))),
+                max(0.0f, dot(SHintensity, blueSH.SampleLevel(samplerLPV, lpvCellCoords, 0))));
+        }
+        lpvIntensity /= PI;
+        lpvIntensity.rgb *= LPVStorageScale;
     
         lpv = LPVAttenuation * min(lpvIntensity.rgb * LPVPower, float3(LPVCutoff, LPVCutoff, LPVCutoff)) * albedo.rgb;
         
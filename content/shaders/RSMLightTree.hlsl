@@ -0,0 +1,30 @@
+// Light tree over the RSM, shared by RSMLightTreeBuildCS.hlsl and ReflectiveShadowMappingLightcutsCS.hlsl.
+// Follows RSMLightTree.h/.cpp: a complete quadtree stored root first, each level row major.
+
+// RSMLightTree::Node, 72 bytes
+struct LightTreeNode
+{
+    float3 Flux;
+    float ConeCos;      // normals within acos(ConeCos) of Normal, -1 for any direction
+    float3 Position;
+    float U;
+    float3 Normal;
+    float V;
+    float3 BoundsMin;
+    float3 BoundsMax;
+};
+
+uint GetLevelOffset(uint level)
+{
+    return ((1u << (2u * level)) - 1u) / 3u;
+}
+
+uint GetNodeIndex(uint level, uint2 xy)
+{
+    return GetLevelOffset(level) + (xy.y << level) + xy.x;
+}
+
+float GetLuminance(float3 rgb)
+{
+    return dot(rgb, float3(0.2126f, 0.7152f, 0.0722f));
+}
@@ -0,0 +1,138 @@
+#include "Common.hlsl"
+#include "RSMLightTree.hlsl"
+
+// CSLeaves summarizes LeafSize x LeafSize RSM texels per leaf, CSLevel then builds one level from the level below,
+// dispatched from the leaves up to the root (RSMLightTree::Build)
+
+Texture2D<float4> worldPosLSBuffer : register(t0);
+Texture2D<float4> normalLSBuffer : register(t1);
+Texture2D<float4> fluxLSBuffer : register(t2);
+
+RWStructuredBuffer<LightTreeNode> nodes : register(u0);
+
+cbuffer LightTreeBuildConstants : register(b0)
+{
+    uint Level;     // the level written, the leaf level for CSLeaves
+    uint LeafSize;  // RSM texels per leaf and axis
+};
+
+LightTreeNode BeginNode()
+{
+    LightTreeNode node;
+    node.Flux = 0.0f;
+    node.ConeCos = -1.0f;
+    node.Position = 0.0f;
+    node.U = 0.0f;
+    node.Normal = 0.0f;
+    node.V = 0.0f;
+    node.BoundsMin = 1e30f;
+    node.BoundsMax = -1e30f;
+    return node;
+}
+
+// flux weighted sums of the members
+void AddMember(inout LightTreeNode node, inout float weight, float3 flux, float3 position, float3 normal, float2 uv, float3 boundsMin, float3 boundsMax)
+{
+    float memberWeight = GetLuminance(flux);
+    if (memberWeight <= 0.0f)
+        return;
+    weight += memberWeight;
+    node.Flux += flux;
+    node.Position += memberWeight * position;
+    node.Normal += memberWeight * normal;
+    node.U += memberWeight * uv.x;
+    node.V += memberWeight * uv.y;
+    node.BoundsMin = min(node.BoundsMin, boundsMin);
+    node.BoundsMax = max(node.BoundsMax, boundsMax);
+}
+
+void FinishNode(inout LightTreeNode node, float weight)
+{
+    if (weight <= 0.0f)
+        return;
+    node.Position /= weight;
+    node.U /= weight;
+    node.V /= weight;
+    float normalLength = length(node.Normal);
+    if (normalLength > 0.0f)
+        node.Normal /= normalLength;
+}
+
+float ConeAngle(LightTreeNode node, float3 normal, float memberAngle)
+{
+    return min(acos(clamp(dot(node.Normal, normal), -1.0f, 1.0f)) + memberAngle, PI);
+}
+
+void SetCone(inout LightTreeNode node, float weight, float angle)
+{
+    if (weight > 0.0f)
+        node.ConeCos = angle >= PI ? -1.0f : cos(angle);
+}
+
+[numthreads(8, 8, 1)]
+void CSLeaves(uint3 DTid : SV_DispatchThreadID)
+{
+    uint dim = 1u << Level;
+    if (any(DTid.xy >= dim))
+        return;
+
+    uint rsmSize = dim * LeafSize;
+    float texel = 1.0f / (float)rsmSize;
+    uint2 origin = DTid.xy * LeafSize;
+
+    LightTreeNode node = BeginNode();
+    float weight = 0.0f;
+    for (uint y = 0; y < LeafSize; y++)
+    {
+        for (uint x = 0; x < LeafSize; x++)
+        {
+            uint3 coord = uint3(origin + uint2(x, y), 0);
+            float3 position = worldPosLSBuffer.Load(coord).rgb;
+            AddMember(node, weight, fluxLSBuffer.Load(coord).rgb, position, normalLSBuffer.Load(coord).rgb, (coord.xy + 0.5f) * texel, position, position);
+        }
+    }
+    FinishNode(node, weight);
+
+    float angle = 0.0f;
+    for (uint ty = 0; ty < LeafSize && weight > 0.0f; ty++)
+    {
+        for (uint tx = 0; tx < LeafSize; tx++)
+        {
+            uint3 coord = uint3(origin + uint2(tx, ty), 0);
+            if (GetLuminance(fluxLSBuffer.Load(coord).rgb) > 0.0f)
+                angle = max(angle, ConeAngle(node, normalLSBuffer.Load(coord).rgb, 0.0f));
+        }
+    }
+    SetCone(node, weight, angle);
+    nodes[GetNodeIndex(Level, DTid.xy)] = node;
+}
+
+[numthreads(8, 8, 1)]
+void CSLevel(uint3 DTid : SV_DispatchThreadID)
+{
+    uint dim = 1u << Level;
+    if (any(DTid.xy >= dim))
+        return;
+
+    LightTreeNode members[4];
+    [unroll]
+    for (uint i = 0; i < 4; i++)
+        members[i] = nodes[GetNodeIndex(Level + 1, DTid.xy * 2 + uint2(i & 1, i >> 1))];
+
+    LightTreeNode node = BeginNode();
+    float weight = 0.0f;
+    [unroll]
+    for (uint j = 0; j < 4; j++)
+        AddMember(node, weight, members[j].Flux, members[j].Position, members[j].Normal, float2(members[j].U, members[j].V), members[j].BoundsMin, members[j].BoundsMax);
+    FinishNode(node, weight);
+
+    float angle = 0.0f;
+    [unroll]
+    for (uint k = 0; k < 4; k++)
+    {
+        if (GetLuminance(members[k].Flux) > 0.0f)
+            angle = max(angle, ConeAngle(node, members[k].Normal, acos(clamp(members[k].ConeCos, -1.0f, 1.0f))));
+    }
+    SetCone(node, weight, angle);
+    nodes[GetNodeIndex(Level, DTid.xy)] = node;
+}
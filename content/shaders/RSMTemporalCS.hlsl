@@ -0,0 +1,127 @@
+// De-interleaves the interleaved RSM pass and accumulates it over frames, RSMInterleave::Resolve: per pixel the
+// InterleaveSize x InterleaveSize window (every sample subset once) weighted by geometry, then blended with the
+// bilinear history of the texels on the pixel's tangent plane. The history keeps the light and its clip w.
+
+#define RSM_INTERLEAVE_NORMAL_POWER 8.0f        // RSMInterleave::NORMAL_POWER
+#define RSM_INTERLEAVE_PLANE_TOLERANCE 0.005f   // RSMInterleave::PLANE_TOLERANCE
+
+Texture2D<float4> interleavedBuffer : register(t0);
+Texture2D<float4> worldPosWSBuffer : register(t1);   // world space
+Texture2D<float4> normalWSBuffer : register(t2);     // world space
+Texture2D<float4> historyBuffer : register(t3);
+
+RWTexture2D<float4> Output : register(u0);
+RWTexture2D<float4> HistoryOutput : register(u1);
+
+cbuffer RSMTemporalConstantBuffer : register(b0)
+{
+    float4x4 ViewProjection;
+    float4x4 PreviousViewProjection;
+    float4x4 PreviousInverseViewProjection;
+    float2 UpsampleRatio;
+    uint InterleaveSize;
+    uint UseHistory;        // temporal accumulation with last frame's history
+    float HistoryWeight;
+};
+
+bool HasGeometry(float3 normal)
+{
+    return any(normal != 0.0f);
+}
+
+float GeometryWeight(float3 pos, float3 normal, float depth, int2 other)
+{
+    float3 otherNormal = normalWSBuffer[other * UpsampleRatio].rgb;
+    float3 otherPos = worldPosWSBuffer[other * UpsampleRatio].rgb;
+    if (!HasGeometry(otherNormal) || abs(dot(normal, otherPos - pos)) > RSM_INTERLEAVE_PLANE_TOLERANCE * depth)
+        return 0.0f;
+    return pow(saturate(dot(normal, otherNormal)), RSM_INTERLEAVE_NORMAL_POWER);
+}
+
+// Position at depth on the ray through the center of a history texel; clip w is affine along the ray
+float3 Unproject(int2 texel, float depth, float2 size)
+{
+    float2 ndc = float2((texel.x + 0.5f) / size.x * 2.0f - 1.0f, 1.0f - (texel.y + 0.5f) / size.y * 2.0f);
+    float4 nearPoint = mul(PreviousInverseViewProjection, float4(ndc, 0.0f, 1.0f));
+    float4 farPoint = mul(PreviousInverseViewProjection, float4(ndc, 1.0f, 1.0f));
+    nearPoint.xyz /= nearPoint.w;
+    farPoint.xyz /= farPoint.w;
+    float nearDepth = mul(PreviousViewProjection, float4(nearPoint.xyz, 1.0f)).w;
+    float farDepth = mul(PreviousViewProjection, float4(farPoint.xyz, 1.0f)).w;
+    return lerp(nearPoint.xyz, farPoint.xyz, (depth - nearDepth) / (farDepth - nearDepth));
+}
+
+// RSMInterleave::SampleHistory
+bool SampleHistory(float3 pos, float3 normal, int2 size, out float3 result)
+{
+    result = 0.0f;
+    float4 clip = mul(PreviousViewProjection, float4(pos, 1.0f));
+    if (clip.w <= 0.0f)
+        return false;
+
+    float2 coord = (clip.xy / clip.w * float2(0.5f, -0.5f) + 0.5f) * size - 0.5f;
+    int2 origin = int2(floor(coord));
+    float2 fraction = coord - origin;
+    float weightSum = 0.0f;
+    [unroll]
+    for (uint tap = 0; tap < 4; tap++)
+    {
+        int2 texel = origin + int2(tap & 1, tap >> 1);
+        float weight = ((tap & 1) ? fraction.x : 1.0f - fraction.x) * ((tap >> 1) ? fraction.y : 1.0f - fraction.y);
+        if (weight <= 0.0f || any(texel < 0) || any(texel >= size))
+            continue;
+
+        float4 history = historyBuffer[texel];
+        if (history.a <= 0.0f || abs(dot(normal, Unproject(texel, history.a, size) - pos)) > RSM_INTERLEAVE_PLANE_TOLERANCE * clip.w)
+            continue;
+        result += weight * history.rgb;
+        weightSum += weight;
+    }
+    if (weightSum <= 0.0f)
+        return false;
+    result /= weightSum;
+    return true;
+}
+
+[numthreads(8, 8, 1)]
+void CSMain(uint3 DTid : SV_DispatchThreadID)
+{
+    int2 size;
+    Output.GetDimensions(size.x, size.y);
+    if (any(int2(DTid.xy) >= size))
+        return;
+
+    float3 normal = normalWSBuffer[DTid.xy * UpsampleRatio].rgb;
+    float3 pos = worldPosWSBuffer[DTid.xy * UpsampleRatio].rgb;
+    if (!HasGeometry(normal))
+    {
+        Output[DTid.xy] = float4(0.0f, 0.0f, 0.0f, 1.0f);
+        HistoryOutput[DTid.xy] = 0.0f;
+        return;
+    }
+    float depth = mul(ViewProjection, float4(pos, 1.0f)).w;
+
+    // the window is kept inside the target so that it still holds every subset
+    int tileSize = (int) InterleaveSize;
+    int2 start = max(min(int2(DTid.xy) - (tileSize - 1) / 2, size - tileSize), 0);
+    int2 end = min(start + tileSize, size);
+    float3 value = 0.0f;
+    float weightSum = 0.0f;
+    for (int y = start.y; y < end.y; y++)
+    {
+        for (int x = start.x; x < end.x; x++)
+        {
+            float weight = all(int2(x, y) == int2(DTid.xy)) ? 1.0f : GeometryWeight(pos, normal, depth, int2(x, y));
+            value += weight * interleavedBuffer[int2(x, y)].rgb;
+            weightSum += weight;
+        }
+    }
+    value /= weightSum;
+
+    float3 previous;
+    if (UseHistory && SampleHistory(pos, normal, size, previous))
+        value = lerp(previous, value, HistoryWeight);
+
+    HistoryOutput[DTid.xy] = float4(value, depth);
+    Output[DTid.xy] = saturate(float4(value, 1.0f));
+}
@@ -0,0 +1,163 @@
+#include "Common.hlsl"
+#include "RSMLightTree.hlsl"
+
+// Tile classification of the RSM pass (RSMTileClassifier): CSReset empties the tile lists, CSClassify sorts one tile
+// of the pass per group into them. Receivers are reduced over the group, then the light tree nodes overlapping their
+// discs (one per thread), then the receivers are tested against the box of the nodes with flux. The lists and their
+// D3D12_DISPATCH_ARGUMENTS drive the indirect dispatches of ReflectiveShadowMappingCS.hlsl.
+
+#define RSM_TILE_SIZE 8                         // RSMTileClassifier::TILE_SIZE
+#define RSM_TILE_MAX_NODES 64                   // RSMTileClassifier::MAX_NODES
+#define RSM_TILE_RECEIVER_TOLERANCE 0.001f      // RSMTileClassifier::RECEIVER_TOLERANCE
+#define RSM_TILE_CLASS_FULL 0
+#define RSM_TILE_CLASS_REDUCED 1
+#define RSM_TILE_CLASS_NONE 2
+#define RSM_TILE_CLASS_COUNT 3
+#define RSM_TILE_ARGUMENT_WORDS 3
+
+StructuredBuffer<LightTreeNode> nodes : register(t0);
+Texture2D<float4> worldPosWSBuffer : register(t1);   // world space
+Texture2D<float4> normalWSBuffer : register(t2);     // world space
+
+RWByteAddressBuffer tileLists : register(u0);
+
+cbuffer RSMTileClassifyConstantBuffer : register(b0)
+{
+    float4x4 ViewProjection;
+    float4x4 ShadowViewProjection;
+    float2 UpsampleRatio;
+    uint2 OutputSize;       // of the RSM pass
+    float RSMRMax;
+    float NormalVariance;
+    float PlaneDistance;
+    uint Level;             // RSMTileClassifier::GetLevel
+    uint TileCapacity;      // tiles per list
+};
+
+// every stage reduces the same four arrays: the first two by minimum, the others by sum
+groupshared float4 gsMinA[RSM_TILE_SIZE * RSM_TILE_SIZE];
+groupshared float4 gsMinB[RSM_TILE_SIZE * RSM_TILE_SIZE];
+groupshared float4 gsSumA[RSM_TILE_SIZE * RSM_TILE_SIZE];
+groupshared float4 gsSumB[RSM_TILE_SIZE * RSM_TILE_SIZE];
+
+void Reduce(uint index)
+{
+    GroupMemoryBarrierWithGroupSync();
+    [unroll]
+    for (uint stride = RSM_TILE_SIZE * RSM_TILE_SIZE / 2; stride > 0; stride >>= 1)
+    {
+        if (index < stride)
+        {
+            gsMinA[index] = min(gsMinA[index], gsMinA[index + stride]);
+            gsMinB[index] = min(gsMinB[index], gsMinB[index + stride]);
+            gsSumA[index] += gsSumA[index + stride];
+            gsSumB[index] += gsSumB[index + stride];
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+}
+
+// Nodes of level overlapping [lo, hi] in RSM uv, first in xy and last in zw
+int4 GetNodeRange(float2 lo, float2 hi, uint level)
+{
+    int dim = 1 << level;
+    return clamp(int4(floor(lo * dim), floor(hi * dim)), 0, dim - 1);
+}
+
+[numthreads(1, 1, 1)]
+void CSReset()
+{
+    [unroll]
+    for (uint tileClass = 0; tileClass < RSM_TILE_CLASS_COUNT; tileClass++)
+        tileLists.Store3(tileClass * RSM_TILE_ARGUMENT_WORDS * 4, uint3(0, 1, 1));
+}
+
+[numthreads(RSM_TILE_SIZE, RSM_TILE_SIZE, 1)]
+void CSClassify(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint GI : SV_GroupIndex)
+{
+    uint2 pixel = Gid.xy * RSM_TILE_SIZE + GTid.xy;
+    float3 normal = 0.0f;
+    float3 pos = 0.0f;
+    if (all(pixel < OutputSize))
+    {
+        normal = normalWSBuffer[pixel * UpsampleRatio].rgb;
+        pos = worldPosWSBuffer[pixel * UpsampleRatio].rgb;
+    }
+    bool geometry = any(normal != 0.0f);
+    if (!geometry)
+        pos = 0.0f;
+
+    // extent of the receivers in the RSM and their mean normal and position
+    float2 uv = 0.0f;
+    if (geometry)
+    {
+        float4 texSpacePos = mul(ShadowViewProjection, float4(pos, 1.0f));
+        uv = texSpacePos.xy / texSpacePos.w * float2(0.5f, -0.5f) + float2(0.5f, 0.5f);
+    }
+    gsMinA[GI] = geometry ? float4(uv, -uv) : 1e30f;
+    gsMinB[GI] = 1e30f;
+    gsSumA[GI] = float4(normal, geometry ? 1.0f : 0.0f);
+    gsSumB[GI] = float4(pos, 0.0f);
+    Reduce(GI);
+    float2 uvMin = gsMinA[0].xy;
+    float2 uvMax = -gsMinA[0].zw;
+    uint geometryPixels = (uint)gsSumA[0].w;
+    float3 meanNormal = geometryPixels > 0 ? gsSumA[0].xyz / (float)geometryPixels : 0.0f;
+    float3 meanPosition = geometryPixels > 0 ? gsSumB[0].xyz / (float)geometryPixels : 0.0f;
+
+    // the discs of every receiver; nodes with flux overlapping them bound the VPLs in reach, at a coarser level if
+    // there are more nodes than threads
+    float2 lo = uvMin - RSMRMax;
+    float2 hi = uvMax + RSMRMax;
+    bool inRSM = geometryPixels > 0 && all(hi >= 0.0f) && all(lo <= 1.0f);
+    uint level = Level;
+    int4 range = GetNodeRange(lo, hi, level);
+    while (level > 0 && (uint)((range.z - range.x + 1) * (range.w - range.y + 1)) > RSM_TILE_MAX_NODES)
+        range = GetNodeRange(lo, hi, --level);
+    uint rangeWidth = (uint)(range.z - range.x + 1);
+    uint nodeCount = inRSM ? rangeWidth * (uint)(range.w - range.y + 1) : 0;
+
+    GroupMemoryBarrierWithGroupSync();
+    gsMinA[GI] = 1e30f;
+    gsMinB[GI] = 1e30f;
+    gsSumA[GI] = 0.0f;
+    gsSumB[GI] = 0.0f;
+    if (GI < nodeCount)
+    {
+        LightTreeNode node = nodes[GetNodeIndex(level, uint2(range.xy) + uint2(GI % rangeWidth, GI / rangeWidth))];
+        if (GetLuminance(node.Flux) > 0.0f)
+        {
+            gsMinA[GI] = float4(node.BoundsMin, 0.0f);
+            gsMinB[GI] = float4(-node.BoundsMax, 0.0f);
+            gsSumA[GI] = float4(1.0f, 0.0f, 0.0f, 0.0f);
+        }
+    }
+    Reduce(GI);
+    float3 boundsMin = gsMinA[0].xyz;
+    float3 boundsMax = -gsMinB[0].xyz;
+    bool lit = gsSumA[0].x > 0.0f;
+
+    // a receiver only gathers VPLs in front of it, the box corner furthest along its normal is the best case
+    float depth = mul(ViewProjection, float4(pos, 1.0f)).w;
+    float meanLength = length(meanNormal);
+    bool receiving = geometry && lit && dot(normal, (normal > 0.0f ? boundsMax : boundsMin) - pos) > RSM_TILE_RECEIVER_TOLERANCE * depth;
+    float planeDistance = (geometry && meanLength > 0.0f && depth > 0.0f) ? abs(dot(meanNormal, pos - meanPosition)) / (meanLength * depth) : 0.0f;
+
+    GroupMemoryBarrierWithGroupSync();
+    gsMinA[GI] = float4(-planeDistance, 0.0f, 0.0f, 0.0f);
+    gsMinB[GI] = 1e30f;
+    gsSumA[GI] = float4(receiving ? 1.0f : 0.0f, 0.0f, 0.0f, 0.0f);
+    gsSumB[GI] = 0.0f;
+    Reduce(GI);
+
+    if (GI == 0)
+    {
+        uint tileClass = RSM_TILE_CLASS_NONE;
+        if (gsSumA[0].x > 0.0f)
+            tileClass = (1.0f - meanLength <= NormalVariance && -gsMinA[0].x <= PlaneDistance) ? RSM_TILE_CLASS_REDUCED : RSM_TILE_CLASS_FULL;
+
+        uint slot;
+        tileLists.InterlockedAdd(tileClass * RSM_TILE_ARGUMENT_WORDS * 4, 1, slot);
+        tileLists.Store((RSM_TILE_CLASS_COUNT * RSM_TILE_ARGUMENT_WORDS + tileClass * TileCapacity + slot) * 4, (Gid.y << 16) | Gid.x);
+    }
+}
@@ -11,6 +11,7 @@ cbuffer DXRConstantBuffer : register(b0)
     float2 ScreenResolution;
     float2 RTAORadiusPower;
     int FrameIndex;
+    float2 SampleRotation;
 }
 
 cbuffer LightsConstantBuffer : register(b1)
@@ -80,8 +81,7 @@ void AoRayGen()
     float3 worldPos = GBufferWorldPos.Load(int3(xy, 0)).rgb;
     float3 normals = normalize(GBufferNormals.Load(int3(xy, 0)).rgb);
     
-    uint randSeed = initRand(xy.x + xy.y * xy.x, FrameIndex);
-    float3 worldDir = GetCosHemisphereSample(randSeed, normals);
+    float3 worldDir = GetCosHemisphereSample(GetPixelSample(xy, SampleRotation), normals);
     
     Payload payload;
     payload.skipShading = false;
@@ -1,6 +1,12 @@
 #include "Common.hlsl"
 
-#define RSM_SAMPLES_COUNT 512
+// RSM_MAX_SAMPLES_COUNT sizes the sample buffer shared with C++, RSM_SAMPLES_COUNT is a permutation option
+#ifndef RSM_MAX_SAMPLES_COUNT
+#define RSM_MAX_SAMPLES_COUNT 512
+#endif
+#ifndef RSM_SAMPLES_COUNT
+#define RSM_SAMPLES_COUNT RSM_MAX_SAMPLES_COUNT
+#endif
 
 Texture2D<float4> worldPosLSBuffer : register(t0);   // light space
 Texture2D<float4> normalLSBuffer : register(t1);     // light space
@@ -9,6 +15,8 @@ Texture2D<float4> fluxLSBuffer : register(t2);       // light space
 Texture2D<float4> worldPosWSBuffer : register(t3);   // world space
 Texture2D<float4> normalWSBuffer : register(t4);     // world space
 
+ByteAddressBuffer tileLists : register(t5);          // RSMTileClassifyCS.hlsl, CSTiles and CSClearTiles only
+
 RWTexture2D<float4> Output : register(u0);
 
 SamplerState RSMSampler : register(s0);
@@ -19,13 +27,29 @@ cbuffer RSMConstantBuffer : register(b0)
     float RSMIntensity;
     float RSMRMax;
     float2 UpsampleRatio;
+    float2 SampleRotation;  // per frame toroidal shift of the samples, 0 when not rotating
+    uint InterleaveSize;    // pixels of an InterleaveSize^2 tile take disjoint subsets of the samples, 1 for all
+    uint InterleaveFrame;   // moves the pixels on to the next subset, 0 without temporal accumulation
 };
 cbuffer RSMConstantBuffer2 : register(b1)
 {
-    float4 xi[RSM_SAMPLES_COUNT];
+    float4 xi[RSM_MAX_SAMPLES_COUNT];
 }
+cbuffer RSMTileConstants : register(b2)
+{
+    uint TileListOffset;        // in words, RSMTileClassifier::GetListOffset
+    uint TileSampleDivisor;     // 1 for full tiles, RSMTileClassifier::REDUCED_SAMPLES_DIVISOR for reduced ones
+};
 
-float3 CalculateRSM(float3 pos, float3 normal)
+// RSMInterleave::GetSubset and GetSampleRange: aligned blocks of the Sobol set stay stratified
+uint GetSubset(uint2 pixel)
+{
+    uint2 tile = pixel % InterleaveSize;
+    return (tile.y * InterleaveSize + tile.x + InterleaveFrame) % (InterleaveSize * InterleaveSize);
+}
+
+// sampleDivisor keeps the start of the pixel's block of samples, which is still stratified
+float3 CalculateRSM(float3 pos, float3 normal, uint2 pixel, uint sampleDivisor)
 {
     float4 texSpacePos = mul(ShadowViewProjection, float4(pos, 1.0f));
     texSpacePos.rgb /= texSpacePos.w;
@@ -38,9 +62,13 @@ float3 CalculateRSM(float3 pos, float3 normal)
     uint nol = 0;
     normalLSBuffer.GetDimensions(0, width, height, nol);
     
-    for (int i = 0; i < RSM_SAMPLES_COUNT; i++)
+    uint count = RSM_SAMPLES_COUNT / (InterleaveSize * InterleaveSize);
+    uint first = GetSubset(pixel) * count;
+    count = max(count / sampleDivisor, 1u);
+    for (uint i = first; i < first + count; i++)
     {
-        float2 coord = texSpacePos.rg + RSMRMax * float2(xi[i].x * sin(2.0f * PI * xi[i].y), xi[i].x * cos(2.0f * PI * xi[i].y));
+        float2 rotated = frac(xi[i].xy + SampleRotation);
+        float2 coord = texSpacePos.rg + RSMRMax * float2(rotated.x * sin(2.0f * PI * rotated.y), rotated.x * cos(2.0f * PI * rotated.y));
         if (coord.x < 0.0f || coord.x > 1.0f || coord.y < 0.0f || coord.y > 1.0f)
             continue;
         
@@ -52,12 +80,13 @@ float3 CalculateRSM(float3 pos, float3 normal)
         float3 vplPosDir = (pos - vplPosWS);
 
         float3 res = flux * ((max(0.0, dot(vplNormalWS, vplPosDir)) * max(0.0, dot(normal, -vplPosDir))) / (dot(vplPosDir, vplPosDir) * dot(vplPosDir, vplPosDir)));
-        res *= xi[i].x * xi[i].x;
+        res *= rotated.x * rotated.x;
         
         indirectIllumination += res;
     }
     
-    return indirectIllumination;
+    // keep the estimate's brightness when fewer samples are taken
+    return indirectIllumination * ((float) RSM_MAX_SAMPLES_COUNT / (float) count);
 }
 
 [numthreads(8, 8, 1)]
@@ -66,5 +95,38 @@ void CSMain(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID, uint3 DTid :
     float4 normalWS = normalWSBuffer[DTid.xy * UpsampleRatio];
     float4 worldPosWS = worldPosWSBuffer[DTid.xy * UpsampleRatio];
     
-    Output[DTid.xy] = saturate(float4(CalculateRSM(worldPosWS.rgb, normalWS.rgb), 1.0f));
+    Output[DTid.xy] = saturate(float4(CalculateRSM(worldPosWS.rgb, normalWS.rgb, DTid.xy, 1), 1.0f));
+}
+
+// One group per tile of the list at TileListOffset, dispatched indirectly with the tile count
+uint2 GetTilePixel(uint3 Gid, uint3 GTid)
+{
+    uint tile = tileLists.Load((TileListOffset + Gid.x) * 4);
+    return uint2(tile & 0xFFFF, tile >> 16) * 8 + GTid.xy;
+}
+
+[numthreads(8, 8, 1)]
+void CSTiles(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID)
+{
+    uint2 pixel = GetTilePixel(Gid, GTid);
+    uint2 size;
+    Output.GetDimensions(size.x, size.y);
+    if (any(pixel >= size))
+        return;
+
+    float4 normalWS = normalWSBuffer[pixel * UpsampleRatio];
+    float4 worldPosWS = worldPosWSBuffer[pixel * UpsampleRatio];
+    float3 result = any(normalWS.rgb != 0.0f) ? CalculateRSM(worldPosWS.rgb, normalWS.rgb, pixel, TileSampleDivisor) : 0.0f;
+    Output[pixel] = saturate(float4(result, 1.0f));
+}
+
+// The tiles nothing reaches
+[numthreads(8, 8, 1)]
+void CSClearTiles(uint3 Gid : SV_GroupID, uint3 GTid : SV_GroupThreadID)
+{
+    uint2 pixel = GetTilePixel(Gid, GTid);
+    uint2 size;
+    Output.GetDimensions(size.x, size.y);
+    if (all(pixel < size))
+        Output[pixel] = float4(0.0f, 0.0f, 0.0f, 1.0f);
 }
@@ -0,0 +1,210 @@
+#include "Common.hlsl"
+#include "RSMLightTree.hlsl"
+
+// Gathers the RSM from the light tree built by RSMLightTreeBuildCS.hlsl instead of RSM_MAX_SAMPLES_COUNT samples,
+// RSMLightTree::Gather: the cut is a max heap on the error bound of its clusters
+
+#ifndef RSM_MAX_SAMPLES_COUNT
+#define RSM_MAX_SAMPLES_COUNT 512
+#endif
+#define LIGHTCUTS_MAX_CLUSTERS 256      // RSMLightTree::MAX_CLUSTERS
+#define LIGHTCUTS_START_NODES_PER_AXIS 4
+
+StructuredBuffer<LightTreeNode> nodes : register(t0);
+Texture2D<float4> worldPosWSBuffer : register(t1);   // world space
+Texture2D<float4> normalWSBuffer : register(t2);     // world space
+
+RWTexture2D<float4> Output : register(u0);
+
+cbuffer RSMConstantBuffer : register(b0)
+{
+    float4x4 ShadowViewProjection;
+    float RSMIntensity;
+    float RSMRMax;
+    float2 UpsampleRatio;
+    float2 SampleRotation;
+};
+cbuffer LightcutsConstants : register(b1)
+{
+    uint LeafLevel;
+    uint StartLevel;        // RSMLightTree::GetStartLevel
+    float ErrorThreshold;
+    uint MaxClusters;
+    uint RSMSize;
+};
+
+// Weight of a texel at rho in the converged sample estimator, without the cut at RSMRMax
+float RadialWeight(float rho)
+{
+    return (float)RSM_MAX_SAMPLES_COUNT * rho / (2.0f * PI * RSMRMax * RSMRMax * RSMRMax * (float)RSMSize * (float)RSMSize);
+}
+
+float Transfer(float3 vplPosition, float3 vplNormal, float3 pos, float3 normal)
+{
+    float3 direction = pos - vplPosition;
+    float distanceSquared = dot(direction, direction);
+    if (distanceSquared <= 0.0f)
+        return 0.0f;
+    return max(dot(vplNormal, direction), 0.0f) * max(-dot(normal, direction), 0.0f) / (distanceSquared * distanceSquared);
+}
+
+float3 Estimate(LightTreeNode node, float3 pos, float3 normal, float2 uv)
+{
+    float rho = length(float2(node.U, node.V) - uv);
+    return rho < RSMRMax ? node.Flux * Transfer(node.Position, node.Normal, pos, normal) * RadialWeight(rho) : 0.0f;
+}
+
+// Smallest and largest distance in RSM uv from uv to the square of a node
+float2 NodeDistances(uint level, uint2 xy, float2 uv)
+{
+    float size = 1.0f / (float)(1u << level);
+    float2 lo = xy * size - uv;
+    float2 hi = (xy + 1) * size - uv;
+    return float2(length(max(max(lo, -hi), 0.0f)), length(max(abs(lo), abs(hi))));
+}
+
+// Largest cosine between axis and a vector of the box [lo, hi], widened by a cone around axis, 0 if negative
+float CosineBound(float3 lo, float3 hi, float3 axis, float coneAngle)
+{
+    float sign = axis.z >= 0.0f ? 1.0f : -1.0f;
+    float a = -1.0f / (sign + axis.z);
+    float b = axis.x * axis.y * a;
+    float3 tangent = float3(1.0f + sign * axis.x * axis.x * a, sign * b, -sign * axis.x);
+    float3 bitangent = float3(b, sign + axis.y * axis.y * a, -axis.y);
+
+    float3 minimum = 1e30f;
+    float3 maximum = -1e30f;
+    [unroll]
+    for (uint corner = 0; corner < 8; corner++)
+    {
+        float3 v = float3((corner & 1) ? hi.x : lo.x, (corner & 2) ? hi.y : lo.y, (corner & 4) ? hi.z : lo.z);
+        float3 local = float3(dot(v, tangent), dot(v, bitangent), dot(v, axis));
+        minimum = min(minimum, local);
+        maximum = max(maximum, local);
+    }
+
+    float2 r = maximum.z > 0.0f ? max(max(minimum.xy, -maximum.xy), 0.0f) : max(-minimum.xy, maximum.xy);
+    float vectorLength = sqrt(maximum.z * maximum.z + dot(r, r));
+    float cosine = vectorLength > 0.0f ? maximum.z / vectorLength : 1.0f;
+    if (coneAngle <= 0.0f)
+        return max(cosine, 0.0f);
+    float angle = acos(clamp(cosine, -1.0f, 1.0f)) - coneAngle;
+    return angle <= 0.0f ? 1.0f : max(cos(angle), 0.0f);
+}
+
+float GetBound(LightTreeNode node, uint level, uint2 xy, float3 pos, float3 normal, float2 uv)
+{
+    float3 lo = pos - node.BoundsMax;
+    float3 hi = pos - node.BoundsMin;
+    float3 closest = min(max(0.0f, lo), hi);
+    float minDistanceSquared = dot(closest, closest);
+    if (minDistanceSquared <= 0.0f)
+        return 1e30f;
+
+    float vplCos = CosineBound(lo, hi, node.Normal, acos(clamp(node.ConeCos, -1.0f, 1.0f)));
+    float receiverCos = CosineBound(lo, hi, -normal, 0.0f);
+    float discWeight = RadialWeight(min(NodeDistances(level, xy, uv).y, RSMRMax));
+    return GetLuminance(node.Flux) * vplCos * receiverCos / minDistanceSquared * discWeight;
+}
+
+uint Pack(uint level, uint2 xy)
+{
+    return (level << 28) | (xy.y << 14) | xy.x;
+}
+
+// Adds (or with sign -1 removes the estimate of) a node overlapping the disc to the cut
+void AddCluster(inout float cutBounds[LIGHTCUTS_MAX_CLUSTERS], inout uint cutNodes[LIGHTCUTS_MAX_CLUSTERS], inout uint cutSize, inout float3 result,
+    uint level, uint2 xy, float sign, float3 pos, float3 normal, float2 uv)
+{
+    LightTreeNode node = nodes[GetNodeIndex(level, xy)];
+    if (GetLuminance(node.Flux) <= 0.0f || NodeDistances(level, xy, uv).x >= RSMRMax)
+        return;
+    result += sign * Estimate(node, pos, normal, uv);
+    if (sign < 0.0f || cutSize >= LIGHTCUTS_MAX_CLUSTERS)
+        return;
+
+    // leaves cannot be refined and bound nothing
+    float bound = level < LeafLevel ? GetBound(node, level, xy, pos, normal, uv) : 0.0f;
+    uint i = cutSize++;
+    while (i > 0)
+    {
+        uint parent = (i - 1) / 2;
+        if (cutBounds[parent] >= bound)
+            break;
+        cutBounds[i] = cutBounds[parent];
+        cutNodes[i] = cutNodes[parent];
+        i = parent;
+    }
+    cutBounds[i] = bound;
+    cutNodes[i] = Pack(level, xy);
+}
+
+uint PopCluster(inout float cutBounds[LIGHTCUTS_MAX_CLUSTERS], inout uint cutNodes[LIGHTCUTS_MAX_CLUSTERS], inout uint cutSize)
+{
+    uint top = cutNodes[0];
+    cutSize--;
+    float bound = cutBounds[cutSize];
+    uint packed = cutNodes[cutSize];
+    uint i = 0;
+    while (2 * i + 1 < cutSize)
+    {
+        uint child = 2 * i + 1;
+        if (child + 1 < cutSize && cutBounds[child + 1] > cutBounds[child])
+            child++;
+        if (cutBounds[child] <= bound)
+            break;
+        cutBounds[i] = cutBounds[child];
+        cutNodes[i] = cutNodes[child];
+        i = child;
+    }
+    cutBounds[i] = bound;
+    cutNodes[i] = packed;
+    return top;
+}
+
+float3 CalculateLightcuts(float3 pos, float3 normal)
+{
+    float4 texSpacePos = mul(ShadowViewProjection, float4(pos, 1.0f));
+    texSpacePos.rgb /= texSpacePos.w;
+    float2 uv = texSpacePos.rg * float2(0.5f, -0.5f) + float2(0.5f, 0.5f);
+
+    float cutBounds[LIGHTCUTS_MAX_CLUSTERS];
+    uint cutNodes[LIGHTCUTS_MAX_CLUSTERS];
+    uint cutSize = 0;
+    float3 result = 0.0f;
+    uint maxClusters = clamp(MaxClusters, LIGHTCUTS_START_NODES_PER_AXIS * LIGHTCUTS_START_NODES_PER_AXIS, LIGHTCUTS_MAX_CLUSTERS);
+
+    int dim = 1 << StartLevel;
+    int2 first = clamp(int2(floor((uv - RSMRMax) * dim)), 0, dim - 1);
+    int2 last = clamp(int2(floor((uv + RSMRMax) * dim)), 0, dim - 1);
+    for (int y = first.y; y <= last.y; y++)
+    {
+        for (int x = first.x; x <= last.x; x++)
+            AddCluster(cutBounds, cutNodes, cutSize, result, StartLevel, uint2(x, y), 1.0f, pos, normal, uv);
+    }
+
+    // refine the worst cluster until every bound is within the threshold of the running total; refining may add 3
+    // clusters, all of which must still fit in the budget
+    [loop]
+    while (cutSize > 0 && cutSize + 3 <= maxClusters && cutBounds[0] > ErrorThreshold * max(GetLuminance(result), 0.0f))
+    {
+        uint packed = PopCluster(cutBounds, cutNodes, cutSize);
+        uint level = packed >> 28;
+        uint2 xy = uint2(packed & 0x3FFF, (packed >> 14) & 0x3FFF);
+
+        AddCluster(cutBounds, cutNodes, cutSize, result, level, xy, -1.0f, pos, normal, uv);
+        [unroll]
+        for (uint child = 0; child < 4; child++)
+            AddCluster(cutBounds, cutNodes, cutSize, result, level + 1, xy * 2 + uint2(child & 1, child >> 1), 1.0f, pos, normal, uv);
+    }
+    return max(result, 0.0f);
+}
+
+[numthreads(8, 8, 1)]
+void CSMain(uint3 DTid : SV_DispatchThreadID)
+{
+    float4 normalWS = normalWSBuffer[DTid.xy * UpsampleRatio];
+    float4 worldPosWS = worldPosWSBuffer[DTid.xy * UpsampleRatio];
+
+    Output[DTid.xy] = saturate(float4(CalculateLightcuts(worldPosWS.rgb, normalWS.rgb), 1.0f));
+}
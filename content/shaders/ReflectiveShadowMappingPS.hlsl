@@ -1,6 +1,12 @@
 #include "Common.hlsl"
 
-#define RSM_SAMPLES_COUNT 512
+// RSM_MAX_SAMPLES_COUNT sizes the sample buffer shared with C++, RSM_SAMPLES_COUNT is a permutation option
+#ifndef RSM_MAX_SAMPLES_COUNT
+#define RSM_MAX_SAMPLES_COUNT 512
+#endif
+#ifndef RSM_SAMPLES_COUNT
+#define RSM_SAMPLES_COUNT RSM_MAX_SAMPLES_COUNT
+#endif
 
 Texture2D<float4> worldPosLSBuffer : register(t0);   // light space
 Texture2D<float4> normalLSBuffer : register(t1);     // light space
@@ -17,10 +23,11 @@ cbuffer RSMConstantBuffer : register(b0)
     float RSMIntensity;
     float RSMRMax;
     float2 UpsampleRatio;
+    float2 SampleRotation;  // per frame toroidal shift of the samples, 0 when not rotating
 };
 cbuffer RSMConstantBuffer2 : register(b1)
 {
-    float4 xi[RSM_SAMPLES_COUNT];
+    float4 xi[RSM_MAX_SAMPLES_COUNT];
 }
 
 struct VSInput
@@ -55,7 +62,8 @@ float3 CalculateRSM(float3 pos, float3 normal)
     
     for (int i = 0; i < RSM_SAMPLES_COUNT; i++)
     {
-        float2 coord = texSpacePos.rg + RSMRMax * float2(xi[i].x * sin(2.0f * PI * xi[i].y), xi[i].x * cos(2.0f * PI * xi[i].y));
+        float2 rotated = frac(xi[i].xy + SampleRotation);
+        float2 coord = texSpacePos.rg + RSMRMax * float2(rotated.x * sin(2.0f * PI * rotated.y), rotated.x * cos(2.0f * PI * rotated.y));
         
         float2 texcoord = coord * float2(width, height);
         float3 vplPosWS = worldPosLSBuffer.Load(uint3(uint2(texcoord), 0)).rgb;
@@ -65,12 +73,13 @@ float3 CalculateRSM(float3 pos, float3 normal)
         float3 vplPosDir = (pos - vplPosWS);
 
         float3 res = flux * ((max(0.0, dot(vplNormalWS, vplPosDir)) * max(0.0, dot(normal, -vplPosDir))) / (dot(vplPosDir, vplPosDir) * dot(vplPosDir, vplPosDir)));
-        res *= xi[i].x * xi[i].x;
+        res *= rotated.x * rotated.x;
         
         indirectIllumination += res;
     }
     
-    return indirectIllumination;
+    // keep the estimate's brightness when fewer samples are taken
+    return indirectIllumination * ((float) RSM_MAX_SAMPLES_COUNT / (float) RSM_SAMPLES_COUNT);
 }
 
 PSInput VSMain(VSInput input)
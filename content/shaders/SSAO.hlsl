@@ -1,6 +1,12 @@
 #include "Common.hlsl"
 
-#define SSAO_MAX_KERNEL_OFFSETS 16
+// SSAO_MAX_KERNEL sizes the kernel array shared with C++, SSAO_KERNEL_SIZE is a permutation option
+#ifndef SSAO_MAX_KERNEL
+#define SSAO_MAX_KERNEL 16
+#endif
+#ifndef SSAO_KERNEL_SIZE
+#define SSAO_KERNEL_SIZE SSAO_MAX_KERNEL
+#endif
 
 struct VSInput
 {
@@ -35,7 +41,7 @@ cbuffer SSAOCB : register(b0)
     float4x4 Proj;
     float4x4 InvView;
     float4x4 InvProj;
-    float4 KernelOffsets[SSAO_MAX_KERNEL_OFFSETS];
+    float4 KernelOffsets[SSAO_MAX_KERNEL];
     float4 Radius_Power_NoiseScale;
     float4 ScreenSize;
 };
@@ -63,7 +69,7 @@ PSOutput PSMain(PSInput input)
     float3x3 TBN = float3x3(tangent, bitangent, normal);
     
     float occlusion = 0.0f;
-    for (int i = 0; i < (int) SSAO_MAX_KERNEL_OFFSETS; i++)
+    for (int i = 0; i < (int) SSAO_KERNEL_SIZE; i++)
     {
         float3 samplePos = mul(KernelOffsets[i].xyz, TBN);
         samplePos = samplePos * Radius_Power_NoiseScale.x + viewPosition;
@@ -83,7 +89,7 @@ PSOutput PSMain(PSInput input)
         float range = smoothstep(0.0, 1.0, Radius_Power_NoiseScale.x / (abs(viewPosition.z - sampleD) + 0.00001f));
         occlusion += range * step(sampleD, samplePos.z) * factor;
     }
-    occlusion = 1.0 - (occlusion / SSAO_MAX_KERNEL_OFFSETS);
+    occlusion = 1.0 - (occlusion / SSAO_KERNEL_SIZE);
     occlusion = pow(occlusion, Radius_Power_NoiseScale.y);
     
     output.color = occlusion;
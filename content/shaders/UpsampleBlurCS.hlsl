@@ -29,7 +29,17 @@ float4 Blur9(float4 a, float4 b, float4 c, float4 d, float4 e, float4 f, float4
 {
     return Weights9[0] * e + Weights9[1] * (d + f) + Weights9[2] * (c + g) + Weights9[3] * (b + h) + Weights9[4] * (a + i);
 }
+// BLUR_TAPS is a permutation option: 5, 7 or 9
+#ifndef BLUR_TAPS
+#define BLUR_TAPS 9
+#endif
+#if BLUR_TAPS == 5
+#define BlurPixels Blur5
+#elif BLUR_TAPS == 7
+#define BlurPixels Blur7
+#else
 #define BlurPixels Blur9
+#endif
 
 // 16x16 pixels with an 8x8 center that we will be blurring writing out.  Each uint is two color channels packed together
 groupshared uint CacheR[128];
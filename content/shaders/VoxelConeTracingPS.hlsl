@@ -1,6 +1,9 @@
 #include "Common.hlsl"
 
+// NUM_CONES is a permutation option: 1 traces only the cone along the normal, 6 the full set below
+#ifndef NUM_CONES
 #define NUM_CONES 6
+#endif
 
 static const float coneAperture = 0.577f; // 6 cones, 60deg each, tan(30deg) = aperture
 static const float3 diffuseConeDirections[] =
@@ -175,9 +178,11 @@ float4 CalculateIndirectDiffuse(float3 worldPos, float3 normal, out float ao, ui
     
     float finalAo = 0.0f;
     float tempAo = 0.0f;
+    float weightSum = 0.0f;
     
     for (int i = 0; i < NUM_CONES; i++)
     {
+        weightSum += diffuseConeWeights[i];
         coneDirection = normal;
         coneDirection += diffuseConeDirections[i].x * right + diffuseConeDirections[i].z * up;
         coneDirection = normalize(coneDirection);
@@ -186,9 +191,10 @@ float4 CalculateIndirectDiffuse(float3 worldPos, float3 normal, out float ao, ui
         finalAo += tempAo * diffuseConeWeights[i];
     }
     
-    ao = finalAo;
+    // the full set of weights sums to 1, fewer cones are renormalized
+    ao = finalAo / weightSum;
     
-    return IndirectDiffuseStrength * result;
+    return IndirectDiffuseStrength * result / weightSum;
 }
 
 PS_OUT PSMain(PS_IN input)
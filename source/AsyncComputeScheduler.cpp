@@ -0,0 +1,396 @@
+#include "AsyncComputeScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+
+namespace
+{
+	const float LengthEpsilon = 1e-4f;
+	const char* QueueNames[] = { "Graphics", "Compute" };
+}
+
+AsyncComputeScheduler::PassId AsyncComputeScheduler::AddPass(const std::string& name, float graphicsCost, bool allowCompute, float computeCost)
+{
+	Pass pass;
+	pass.mName = name;
+	pass.mGraphicsCost = graphicsCost;
+	pass.mComputeCost = computeCost < 0.0f ? graphicsCost : computeCost;
+	pass.mAllowCompute = allowCompute;
+	mPasses.push_back(pass);
+	return static_cast<PassId>(mPasses.size() - 1);
+}
+
+bool AsyncComputeScheduler::AddDependency(PassId consumer, PassId producer, bool allowPreviousFrame, float historyCopyCost)
+{
+	// submission order is the topological order
+	if (consumer >= mPasses.size() || producer >= consumer)
+		return false;
+
+	Dependency dependency;
+	dependency.mProducer = producer;
+	dependency.mAllowPreviousFrame = allowPreviousFrame;
+	dependency.mHistoryCopyCost = historyCopyCost;
+	mPasses[consumer].mDependencies.push_back(dependency);
+	return true;
+}
+
+AsyncComputeScheduler::Evaluation AsyncComputeScheduler::Evaluate(const Candidate& candidate) const
+{
+	struct Location
+	{
+		Queue mQueue = GRAPHICS_QUEUE;
+		uint32_t mStep = 0;
+	};
+
+	Evaluation evaluation;
+	const size_t passCount = mPasses.size();
+
+	// producers read from the previous frame are copied before they run again
+	std::vector<bool> needsCopy(passCount, false);
+	std::vector<float> copyCost(passCount, 0.0f);
+	for (size_t consumer = 0; consumer < passCount; consumer++)
+	{
+		for (size_t i = 0; i < mPasses[consumer].mDependencies.size(); i++)
+		{
+			if (!candidate.mPreviousFrame[consumer][i])
+				continue;
+
+			const Dependency& dependency = mPasses[consumer].mDependencies[i];
+			needsCopy[dependency.mProducer] = true;
+			copyCost[dependency.mProducer] = std::max(copyCost[dependency.mProducer], dependency.mHistoryCopyCost);
+			evaluation.mPreviousFrameCount++;
+		}
+	}
+
+	// steps in execution order: history copies first, then the passes
+	std::vector<float> costs[QUEUE_COUNT];
+	std::vector<uint32_t> submissions[QUEUE_COUNT];
+	std::vector<Location> copyLocations(passCount);
+	std::vector<Location> passLocations(passCount);
+	auto addStep = [&](PassId pass, bool historyCopy, float cost) {
+		Queue queue = candidate.mQueues[pass];
+		Step step;
+		step.mPass = pass;
+		step.mHistoryCopy = historyCopy;
+
+		uint32_t submission = submissions[queue].empty() ? 0 : submissions[queue].back();
+		if (!historyCopy && mPasses[pass].mStartsSubmission && !evaluation.mSteps[queue].empty())
+			submission++;
+
+		Location location;
+		location.mQueue = queue;
+		location.mStep = static_cast<uint32_t>(evaluation.mSteps[queue].size());
+		evaluation.mSteps[queue].push_back(step);
+		costs[queue].push_back(cost);
+		submissions[queue].push_back(submission);
+		return location;
+	};
+
+	for (size_t pass = 0; pass < passCount; pass++)
+	{
+		if (needsCopy[pass])
+			copyLocations[pass] = addStep(static_cast<PassId>(pass), true, copyCost[pass]);
+	}
+	for (size_t pass = 0; pass < passCount; pass++)
+	{
+		Queue queue = candidate.mQueues[pass];
+		if (queue == COMPUTE_QUEUE)
+			evaluation.mComputeCount++;
+		passLocations[pass] = addStep(static_cast<PassId>(pass), false, queue == COMPUTE_QUEUE ? mPasses[pass].mComputeCost : mPasses[pass].mGraphicsCost);
+	}
+
+	// a signal can only follow the last step of a submission
+	auto signalStep = [&](Queue queue, uint32_t step) {
+		while (step + 1 < submissions[queue].size() && submissions[queue][step + 1] == submissions[queue][step])
+			step++;
+		return step;
+	};
+
+	// per step, the other queue's step it waits for (-1 for none). Waits go in front of the whole submission
+	// and the other queue's steps finish in order, so the latest required step covers the rest.
+	std::vector<int64_t> waits[QUEUE_COUNT];
+	for (int q = 0; q < QUEUE_COUNT; q++)
+	{
+		Queue queue = static_cast<Queue>(q);
+		Queue other = queue == GRAPHICS_QUEUE ? COMPUTE_QUEUE : GRAPHICS_QUEUE;
+		const std::vector<Step>& steps = evaluation.mSteps[queue];
+		waits[queue].assign(steps.size(), -1);
+
+		int64_t lastWaited = -1;
+		for (size_t first = 0; first < steps.size();)
+		{
+			size_t end = first;
+			int64_t required = -1;
+			for (; end < steps.size() && submissions[queue][end] == submissions[queue][first]; end++)
+			{
+				const Step& step = steps[end];
+				if (step.mHistoryCopy)
+					continue;
+
+				const std::vector<Dependency>& dependencies = mPasses[step.mPass].mDependencies;
+				for (size_t i = 0; i < dependencies.size(); i++)
+				{
+					PassId producer = dependencies[i].mProducer;
+					const Location& location = candidate.mPreviousFrame[step.mPass][i] ? copyLocations[producer] : passLocations[producer];
+					if (location.mQueue != queue)
+						required = std::max(required, static_cast<int64_t>(signalStep(other, location.mStep)));
+				}
+			}
+
+			if (required > lastWaited)
+			{
+				Fence fence;
+				fence.mSignalQueue = other;
+				fence.mSignalStep = static_cast<uint32_t>(required);
+				fence.mWaitQueue = queue;
+				fence.mWaitStep = static_cast<uint32_t>(first);
+				evaluation.mFences.push_back(fence);
+
+				waits[queue][first] = required;
+				lastWaited = required;
+			}
+			first = end;
+		}
+	}
+
+	// the frame is presented from the graphics queue, which has to see the end of the compute work
+	int64_t lastCompute = static_cast<int64_t>(evaluation.mSteps[COMPUTE_QUEUE].size()) - 1;
+	int64_t lastComputeWaited = -1;
+	for (auto& fence : evaluation.mFences)
+	{
+		if (fence.mWaitQueue == GRAPHICS_QUEUE)
+			lastComputeWaited = std::max(lastComputeWaited, static_cast<int64_t>(fence.mSignalStep));
+	}
+	bool joinAtEnd = lastCompute > lastComputeWaited;
+	if (joinAtEnd)
+	{
+		Fence fence;
+		fence.mSignalQueue = COMPUTE_QUEUE;
+		fence.mSignalStep = static_cast<uint32_t>(lastCompute);
+		fence.mWaitQueue = GRAPHICS_QUEUE;
+		fence.mWaitStep = END_OF_FRAME;
+		evaluation.mFences.push_back(fence);
+	}
+
+	// both queues run in order and stop at unresolved waits; no progress on either one means a deadlock
+	size_t next[QUEUE_COUNT] = {};
+	float cursor[QUEUE_COUNT] = {};
+	bool progress = true;
+	while (progress)
+	{
+		progress = false;
+		for (int q = 0; q < QUEUE_COUNT; q++)
+		{
+			Queue queue = static_cast<Queue>(q);
+			Queue other = queue == GRAPHICS_QUEUE ? COMPUTE_QUEUE : GRAPHICS_QUEUE;
+			std::vector<Step>& steps = evaluation.mSteps[queue];
+			while (next[queue] < steps.size())
+			{
+				size_t index = next[queue];
+				int64_t wait = waits[queue][index];
+				if (wait >= static_cast<int64_t>(next[other]))
+					break;
+
+				float start = cursor[queue];
+				if (wait >= 0)
+					start = std::max(start, evaluation.mSteps[other][static_cast<size_t>(wait)].mEnd) + mFenceCost;
+
+				steps[index].mStart = start;
+				steps[index].mEnd = start + costs[queue][index];
+				cursor[queue] = steps[index].mEnd;
+				next[queue]++;
+				progress = true;
+			}
+		}
+	}
+
+	for (int q = 0; q < QUEUE_COUNT; q++)
+	{
+		if (next[q] < evaluation.mSteps[q].size())
+			evaluation.mValid = false;
+	}
+
+	float length = cursor[GRAPHICS_QUEUE];
+	if (joinAtEnd)
+		length = std::max(length, cursor[COMPUTE_QUEUE]) + mFenceCost;
+	evaluation.mLength = length;
+	return evaluation;
+}
+
+bool AsyncComputeScheduler::IsBetter(const Evaluation& a, const Evaluation& b)
+{
+	if (a.mValid != b.mValid)
+		return a.mValid;
+	if (std::fabs(a.mLength - b.mLength) > LengthEpsilon)
+		return a.mLength < b.mLength;
+	if (a.mFences.size() != b.mFences.size())
+		return a.mFences.size() < b.mFences.size();
+	if (a.mPreviousFrameCount != b.mPreviousFrameCount)
+		return a.mPreviousFrameCount < b.mPreviousFrameCount;
+	return a.mComputeCount < b.mComputeCount;
+}
+
+bool AsyncComputeScheduler::Schedule()
+{
+	if (mPasses.empty())
+		return false;
+
+	Candidate candidate;
+	candidate.mQueues.assign(mPasses.size(), GRAPHICS_QUEUE);
+	candidate.mPreviousFrame.resize(mPasses.size());
+	for (size_t pass = 0; pass < mPasses.size(); pass++)
+		candidate.mPreviousFrame[pass].assign(mPasses[pass].mDependencies.size(), false);
+
+	// every yes/no decision of the schedule, flipped through Apply
+	struct Decision
+	{
+		PassId mPass;
+		int mDependency;    // -1 for the queue of the pass
+	};
+	std::vector<Decision> decisions;
+	for (size_t pass = 0; pass < mPasses.size(); pass++)
+	{
+		if (mPasses[pass].mAllowCompute)
+			decisions.push_back({ static_cast<PassId>(pass), -1 });
+		for (size_t i = 0; i < mPasses[pass].mDependencies.size(); i++)
+		{
+			if (mPasses[pass].mDependencies[i].mAllowPreviousFrame)
+				decisions.push_back({ static_cast<PassId>(pass), static_cast<int>(i) });
+		}
+	}
+
+	auto apply = [&candidate](const Decision& decision, bool value) {
+		if (decision.mDependency < 0)
+			candidate.mQueues[decision.mPass] = value ? COMPUTE_QUEUE : GRAPHICS_QUEUE;
+		else
+			candidate.mPreviousFrame[decision.mPass][decision.mDependency] = value;
+	};
+
+	Evaluation best = Evaluate(candidate);
+	mSerialLength = best.mLength;
+	Candidate bestCandidate = candidate;
+
+	if (decisions.size() <= MAX_EXHAUSTIVE_DECISIONS)
+	{
+		const uint32_t combinations = 1u << decisions.size();
+		for (uint32_t mask = 1; mask < combinations; mask++)
+		{
+			for (size_t i = 0; i < decisions.size(); i++)
+				apply(decisions[i], (mask >> i) & 1);
+
+			Evaluation evaluation = Evaluate(candidate);
+			if (IsBetter(evaluation, best))
+			{
+				best = evaluation;
+				bestCandidate = candidate;
+			}
+		}
+	}
+	else
+	{
+		// greedy: keep taking the single flip that helps most until none does
+		std::vector<bool> values(decisions.size(), false);
+		bool improved = true;
+		while (improved)
+		{
+			improved = false;
+			int bestFlip = -1;
+			for (size_t i = 0; i < decisions.size(); i++)
+			{
+				apply(decisions[i], !values[i]);
+				Evaluation evaluation = Evaluate(candidate);
+				apply(decisions[i], values[i]);
+
+				if (IsBetter(evaluation, best))
+				{
+					best = evaluation;
+					bestFlip = static_cast<int>(i);
+				}
+			}
+
+			if (bestFlip >= 0)
+			{
+				values[bestFlip] = !values[bestFlip];
+				apply(decisions[bestFlip], values[bestFlip]);
+				bestCandidate = candidate;
+				improved = true;
+			}
+		}
+	}
+
+	mPassQueues = bestCandidate.mQueues;
+	mPreviousFrame = bestCandidate.mPreviousFrame;
+	for (int queue = 0; queue < QUEUE_COUNT; queue++)
+		mSteps[queue] = best.mSteps[queue];
+	mFences = best.mFences;
+	mCriticalPathLength = best.mLength;
+	return true;
+}
+
+bool AsyncComputeScheduler::IsPreviousFrame(PassId consumer, PassId producer) const
+{
+	assert(consumer < mPreviousFrame.size());
+	const std::vector<Dependency>& dependencies = mPasses[consumer].mDependencies;
+	for (size_t i = 0; i < dependencies.size(); i++)
+	{
+		if (dependencies[i].mProducer == producer)
+			return mPreviousFrame[consumer][i];
+	}
+	return false;
+}
+
+AsyncComputeScheduler::PassId AsyncComputeScheduler::FindPass(const std::string& name) const
+{
+	for (size_t pass = 0; pass < mPasses.size(); pass++)
+	{
+		if (mPasses[pass].mName == name)
+			return static_cast<PassId>(pass);
+	}
+	return UINT32_MAX;
+}
+
+std::string AsyncComputeScheduler::GetScheduleString() const
+{
+	auto stepName = [this](Queue queue, uint32_t step) -> std::string {
+		if (step == END_OF_FRAME)
+			return "end of frame";
+		const Step& s = mSteps[queue][step];
+		return s.mHistoryCopy ? "copy of " + mPasses[s.mPass].mName : mPasses[s.mPass].mName;
+	};
+
+	std::string text;
+	for (int queue = 0; queue < QUEUE_COUNT; queue++)
+	{
+		text += QueueNames[queue];
+		text += ":";
+		for (uint32_t step = 0; step < mSteps[queue].size(); step++)
+			text += " " + stepName(static_cast<Queue>(queue), step);
+		text += "\n";
+	}
+
+	for (auto& fence : mFences)
+	{
+		text += std::string(QueueNames[fence.mWaitQueue]) + " waits before " + stepName(fence.mWaitQueue, fence.mWaitStep) +
+			" for " + QueueNames[fence.mSignalQueue] + " after " + stepName(fence.mSignalQueue, fence.mSignalStep) + "\n";
+	}
+
+	char length[128];
+	snprintf(length, sizeof(length), "Critical path: %.2f (serial %.2f)\n", mCriticalPathLength, mSerialLength);
+	text += length;
+	return text;
+}
+
+void AsyncComputeScheduler::Clear()
+{
+	mPasses.clear();
+	mPassQueues.clear();
+	mPreviousFrame.clear();
+	for (auto& steps : mSteps)
+		steps.clear();
+	mFences.clear();
+	mCriticalPathLength = 0.0f;
+	mSerialLength = 0.0f;
+}
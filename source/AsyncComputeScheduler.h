@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decides which passes of a frame run on the async compute queue, which cross-queue dependencies read the
+// previous frame's result, and where fences are needed.
+// Passes are added in submission order, and a pass may only depend on passes that were added before it.
+// Each queue executes its passes in that order. A dependency that allows the previous frame's result does not
+// wait for the producer. Instead the producer's output is copied at the start of the frame on the producer's
+// queue, before the producer overwrites it. The graphics queue joins the compute queue before the frame ends.
+// Queues only signal and wait between command list submissions. A pass can be marked as the start of a
+// new submission on its queue. A queue without marks submits all of its work at once.
+// The schedule with the shortest critical path (the estimated frame length on the GPU) wins. Ties prefer
+// fewer fences, then same-frame results, then fewer compute passes.
+// Only uses the standard library; costs are estimates supplied by the caller and only their ratios matter.
+class AsyncComputeScheduler
+{
+public:
+    typedef uint32_t PassId;
+
+    enum Queue
+    {
+        GRAPHICS_QUEUE = 0,
+        COMPUTE_QUEUE,
+        QUEUE_COUNT
+    };
+
+    // Step index used by fences that wait at the end of the frame (the graphics queue joining compute)
+    static constexpr uint32_t END_OF_FRAME = UINT32_MAX;
+    // Above this many decisions the search falls back from exhaustive to greedy
+    static constexpr uint32_t MAX_EXHAUSTIVE_DECISIONS = 16;
+
+    struct Step
+    {
+        PassId mPass = 0;
+        bool mHistoryCopy = false;  // copy of the pass' previous-frame output, not the pass itself
+        float mStart = 0.0f;
+        float mEnd = 0.0f;
+    };
+
+    // mWaitQueue waits before mWaitStep until mSignalQueue has executed mSignalStep (indices into GetSteps).
+    // Both are submission boundaries: mWaitStep starts a submission and mSignalStep ends one.
+    struct Fence
+    {
+        Queue mSignalQueue = GRAPHICS_QUEUE;
+        uint32_t mSignalStep = 0;
+        Queue mWaitQueue = COMPUTE_QUEUE;
+        uint32_t mWaitStep = 0;
+    };
+
+    // computeCost < 0 uses the graphics cost, passes that cannot use the compute queue ignore it
+    PassId AddPass(const std::string& name, float graphicsCost, bool allowCompute = false, float computeCost = -1.0f);
+    // historyCopyCost is paid once per producer if any of its consumers reads the previous frame's output
+    bool AddDependency(PassId consumer, PassId producer, bool allowPreviousFrame = false, float historyCopyCost = 0.0f);
+    // The pass starts a new command list submission on whichever queue it ends up on
+    void SetSubmissionStart(PassId pass) { mPasses[pass].mStartsSubmission = true; }
+    // Estimated cost of a cross-queue wait
+    void SetFenceCost(float cost) { mFenceCost = cost; }
+
+    // Returns false if nothing was added. A candidate whose submissions would wait on each other is never chosen.
+    bool Schedule();
+
+    Queue GetQueue(PassId pass) const { return mPassQueues[pass]; }
+    // True if the consumer reads the producer's result from the previous frame
+    bool IsPreviousFrame(PassId consumer, PassId producer) const;
+    const std::vector<Step>& GetSteps(Queue queue) const { return mSteps[queue]; }
+    const std::vector<Fence>& GetFences() const { return mFences; }
+
+    // Estimated GPU frame length of the chosen schedule
+    float GetCriticalPathLength() const { return mCriticalPathLength; }
+    // Everything on the graphics queue with same-frame results, the baseline the schedule is compared to
+    float GetSerialLength() const { return mSerialLength; }
+
+    PassId FindPass(const std::string& name) const;
+    const std::string& GetPassName(PassId pass) const { return mPasses[pass].mName; }
+    uint32_t GetPassCount() const { return static_cast<uint32_t>(mPasses.size()); }
+    std::string GetScheduleString() const;
+
+    void Clear();
+
+private:
+    struct Dependency
+    {
+        PassId mProducer = 0;
+        bool mAllowPreviousFrame = false;
+        float mHistoryCopyCost = 0.0f;
+    };
+
+    struct Pass
+    {
+        std::string mName;
+        float mGraphicsCost = 0.0f;
+        float mComputeCost = 0.0f;
+        bool mAllowCompute = false;
+        bool mStartsSubmission = false;
+        std::vector<Dependency> mDependencies;
+    };
+
+    // One candidate: queue per pass, previous-frame flag per dependency (in pass, then dependency order)
+    struct Candidate
+    {
+        std::vector<Queue> mQueues;
+        std::vector<std::vector<bool>> mPreviousFrame;
+    };
+
+    struct Evaluation
+    {
+        std::vector<Step> mSteps[QUEUE_COUNT];
+        std::vector<Fence> mFences;
+        float mLength = 0.0f;
+        bool mValid = true;         // false if two submissions wait on each other
+        uint32_t mPreviousFrameCount = 0;
+        uint32_t mComputeCount = 0;
+    };
+
+    Evaluation Evaluate(const Candidate& candidate) const;
+    static bool IsBetter(const Evaluation& a, const Evaluation& b);
+
+    std::vector<Pass> mPasses;
+    float mFenceCost = 0.0f;
+
+    std::vector<Queue> mPassQueues;
+    std::vector<std::vector<bool>> mPreviousFrame;
+    std::vector<Step> mSteps[QUEUE_COUNT];
+    std::vector<Fence> mFences;
+    float mCriticalPathLength = 0.0f;
+    float mSerialLength = 0.0f;
+};
@@ -0,0 +1,159 @@
+#include "BenchmarkRunner.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+BenchmarkRunner::BenchmarkRunner(const BenchmarkScenario& scenario)
+	: mScenario(scenario)
+{
+	if (!IsFinished())
+		mCurrent.mRun = GetRun();
+}
+
+double BenchmarkRunner::GetCameraTime() const
+{
+	if (!IsMeasuring())
+		return 0.0;
+	return double(mFrame - mScenario.GetWarmupFrameCount()) * mScenario.GetTimeStep();
+}
+
+void BenchmarkRunner::GetCamera(BenchmarkScenario::Vector3& position, BenchmarkScenario::Vector3& target) const
+{
+	mScenario.EvaluateCamera(GetCameraTime(), position, target);
+}
+
+void BenchmarkRunner::EndFrame(double frameMs)
+{
+	if (IsFinished())
+		return;
+
+	if (IsMeasuring())
+		mCurrent.mFrameMs.push_back(frameMs);
+
+	mFrame++;
+	if (mFrame >= mScenario.GetWarmupFrameCount() + mScenario.GetFrameCount())
+		FinishRun();
+}
+
+void BenchmarkRunner::AddGpuTimes(double graphicsMs, double computeMs)
+{
+	if (IsFinished() || !IsMeasuring())
+		return;
+
+	mCurrent.mGraphicsMs.push_back(graphicsMs);
+	mCurrent.mComputeMs.push_back(computeMs);
+}
+
+void BenchmarkRunner::FinishRun()
+{
+	mCurrent.mFrame = Summarize(mCurrent.mFrameMs);
+	mCurrent.mGraphics = Summarize(mCurrent.mGraphicsMs);
+	mCurrent.mCompute = Summarize(mCurrent.mComputeMs);
+	mResults.push_back(mCurrent);
+
+	mRunIndex++;
+	mFrame = 0;
+	mCurrent = RunResult();
+	if (!IsFinished())
+		mCurrent.mRun = GetRun();
+}
+
+BenchmarkRunner::Summary BenchmarkRunner::Summarize(const std::vector<double>& samples)
+{
+	return FrameTimeStats::Summarize(samples);
+}
+
+std::string BenchmarkRunner::ExportCSV() const
+{
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(6);
+	stream << "run,techniques,async,rsm_ratio,vct_ratio,frames,min_ms,avg_ms,p50_ms,p95_ms,p99_ms,max_ms,stddev_ms,jitter_ms,hitches,"
+		"gpu_frames,gpu_graphics_avg_ms,gpu_graphics_p95_ms,gpu_graphics_p99_ms,gpu_compute_avg_ms\n";
+	for (auto& result : mResults)
+	{
+		const BenchmarkScenario::Run& run = result.mRun;
+		stream << "\"" << run.mName << "\"," << BenchmarkScenario::GetTechniquesString(run.mTechniques) << ","
+			<< (run.mAsyncCompute ? "on" : "off") << "," << run.mRSMRatio << "," << run.mVCTRatio << ","
+			<< result.mFrame.mCount << "," << result.mFrame.mMinMs << "," << result.mFrame.mAverageMs << ","
+			<< result.mFrame.mP50Ms << "," << result.mFrame.mP95Ms << "," << result.mFrame.mP99Ms << "," << result.mFrame.mMaxMs << ","
+			<< result.mFrame.mStdDevMs << "," << result.mFrame.mJitterMs << "," << result.mFrame.mHitchCount << ","
+			<< result.mGraphics.mCount << "," << result.mGraphics.mAverageMs << "," << result.mGraphics.mP95Ms << ","
+			<< result.mGraphics.mP99Ms << "," << result.mCompute.mAverageMs << "\n";
+	}
+	return stream.str();
+}
+
+std::string BenchmarkRunner::ExportJSON() const
+{
+	auto escape = [](const std::string& text) {
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	};
+	auto writeSummary = [](std::ostringstream& stream, const Summary& summary) {
+		stream << "{ \"count\": " << summary.mCount << ", \"minMs\": " << summary.mMinMs << ", \"avgMs\": " << summary.mAverageMs
+			<< ", \"p50Ms\": " << summary.mP50Ms << ", \"p95Ms\": " << summary.mP95Ms << ", \"p99Ms\": " << summary.mP99Ms
+			<< ", \"maxMs\": " << summary.mMaxMs << ", \"stdDevMs\": " << summary.mStdDevMs << ", \"jitterMs\": " << summary.mJitterMs
+			<< ", \"hitches\": " << summary.mHitchCount << " }";
+	};
+	auto writeSamples = [](std::ostringstream& stream, const std::vector<double>& samples) {
+		stream << "[";
+		for (size_t i = 0; i < samples.size(); i++)
+			stream << (i > 0 ? ", " : "") << samples[i];
+		stream << "]";
+	};
+
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(4);
+	stream << "{\n  \"name\": \"" << escape(mScenario.GetName()) << "\",\n  \"frames\": " << mScenario.GetFrameCount()
+		<< ",\n  \"warmupFrames\": " << mScenario.GetWarmupFrameCount() << ",\n  \"timestep\": " << std::setprecision(6)
+		<< mScenario.GetTimeStep() << std::setprecision(4) << ",\n  \"runs\": [";
+
+	for (size_t i = 0; i < mResults.size(); i++)
+	{
+		const RunResult& result = mResults[i];
+		const BenchmarkScenario::Run& run = result.mRun;
+		stream << (i > 0 ? ",\n" : "\n");
+		stream << "    {\n      \"name\": \"" << escape(run.mName) << "\", \"techniques\": \"" << BenchmarkScenario::GetTechniquesString(run.mTechniques)
+			<< "\", \"async\": " << (run.mAsyncCompute ? "true" : "false") << ", \"rsmRatio\": " << run.mRSMRatio
+			<< ", \"vctRatio\": " << run.mVCTRatio << ",\n      \"frame\": ";
+		writeSummary(stream, result.mFrame);
+		stream << ",\n      \"gpuGraphics\": ";
+		writeSummary(stream, result.mGraphics);
+		stream << ",\n      \"gpuCompute\": ";
+		writeSummary(stream, result.mCompute);
+		stream << ",\n      \"frameMs\": ";
+		writeSamples(stream, result.mFrameMs);
+		stream << ",\n      \"gpuGraphicsMs\": ";
+		writeSamples(stream, result.mGraphicsMs);
+		stream << ",\n      \"gpuComputeMs\": ";
+		writeSamples(stream, result.mComputeMs);
+		stream << "\n    }";
+	}
+	stream << "\n  ]\n}\n";
+	return stream.str();
+}
+
+bool BenchmarkRunner::WriteCSV(const std::filesystem::path& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	file << ExportCSV();
+	return bool(file);
+}
+
+bool BenchmarkRunner::WriteJSON(const std::filesystem::path& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	file << ExportJSON();
+	return bool(file);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "BenchmarkScenario.h"
+#include "FrameTimeStats.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Steps through the runs of a scenario and collects their frame times.
+// Every run renders the warmup frames with the camera at the start of the path, then the measured frames
+// along the path with the scenario's timestep. The caller applies GetRun() when IsRunStart() is true,
+// places the camera at GetCameraTime() and reports the frame with EndFrame. GPU times arrive once a frame
+// has been read back, frames in flight later, and only count while the run is measuring.
+// Summaries come from FrameTimeStats: nearest rank percentiles like the CPU profiler, pacing and hitches.
+// Only uses the standard library; frame times come from the caller, so recorded or synthetic ones work too.
+class BenchmarkRunner
+{
+public:
+    // Count, min, average, percentiles, pacing (standard deviation, jitter) and hitches
+    typedef FrameTimeStats::Summary Summary;
+
+    struct RunResult
+    {
+        BenchmarkScenario::Run mRun;
+        std::vector<double> mFrameMs;       // wall clock time of every measured frame
+        std::vector<double> mGraphicsMs;    // GPU time of the graphics queue per read back frame
+        std::vector<double> mComputeMs;     // GPU time of the compute queue per read back frame
+        Summary mFrame;
+        Summary mGraphics;
+        Summary mCompute;
+    };
+
+    explicit BenchmarkRunner(const BenchmarkScenario& scenario);
+
+    bool IsFinished() const { return mRunIndex >= mScenario.GetRuns().size(); }
+    uint32_t GetRunIndex() const { return mRunIndex; }
+    uint32_t GetRunCount() const { return static_cast<uint32_t>(mScenario.GetRuns().size()); }
+    const BenchmarkScenario::Run& GetRun() const { return mScenario.GetRuns()[mRunIndex]; }
+    const BenchmarkScenario& GetScenario() const { return mScenario; }
+
+    // First frame of a run, the run's settings have to be applied before it renders
+    bool IsRunStart() const { return mFrame == 0; }
+    bool IsMeasuring() const { return mFrame >= mScenario.GetWarmupFrameCount(); }
+    // Frame within the run, warmup frames included
+    uint32_t GetFrame() const { return mFrame; }
+    // Path time of the current frame, 0 during warmup
+    double GetCameraTime() const;
+    void GetCamera(BenchmarkScenario::Vector3& position, BenchmarkScenario::Vector3& target) const;
+
+    // Records the current frame if the run is measuring and moves on to the next frame
+    void EndFrame(double frameMs);
+    void AddGpuTimes(double graphicsMs, double computeMs);
+
+    // Finished runs in scenario order
+    const std::vector<RunResult>& GetResults() const { return mResults; }
+
+    static Summary Summarize(const std::vector<double>& samples);
+
+    // run,techniques,async,rsm_ratio,vct_ratio,frames,min_ms,avg_ms,p50_ms,p95_ms,p99_ms,max_ms,stddev_ms,jitter_ms,
+    // hitches,gpu_frames,gpu_graphics_avg_ms,gpu_graphics_p95_ms,gpu_graphics_p99_ms,gpu_compute_avg_ms
+    std::string ExportCSV() const;
+    // Summaries plus the frame times of every run
+    std::string ExportJSON() const;
+    bool WriteCSV(const std::filesystem::path& path) const;
+    bool WriteJSON(const std::filesystem::path& path) const;
+
+private:
+    void FinishRun();
+
+    BenchmarkScenario mScenario;
+    uint32_t mRunIndex = 0;
+    uint32_t mFrame = 0;
+    RunResult mCurrent;
+    std::vector<RunResult> mResults;
+};
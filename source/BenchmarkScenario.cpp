@@ -0,0 +1,338 @@
+#include "BenchmarkScenario.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	bool ParseDouble(const std::string& token, double& value)
+	{
+		try
+		{
+			size_t length = 0;
+			value = std::stod(token, &length);
+			return length == token.size() && std::isfinite(value);
+		}
+		catch (...)
+		{
+			return false;
+		}
+	}
+
+	bool ParseCount(const std::string& token, uint32_t& value)
+	{
+		if (token.empty() || token.find_first_not_of("0123456789") != std::string::npos || token.size() > 9)
+			return false;
+		value = static_cast<uint32_t>(std::stoul(token));
+		return true;
+	}
+
+	bool ParseTechniques(const std::string& token, uint32_t& techniques)
+	{
+		techniques = 0;
+		if (token == "none")
+			return true;
+		// getline does not report the empty name after a trailing '+'
+		if (token.back() == '+')
+			return false;
+
+		std::stringstream stream(token);
+		std::string name;
+		while (std::getline(stream, name, '+'))
+		{
+			if (name == "rsm")
+				techniques |= BenchmarkScenario::TECHNIQUE_RSM;
+			else if (name == "lpv")
+				techniques |= BenchmarkScenario::TECHNIQUE_LPV;
+			else if (name == "vct")
+				techniques |= BenchmarkScenario::TECHNIQUE_VCT;
+			else
+				return false;
+		}
+		return techniques != 0;
+	}
+
+	// Hermite segment with tangents scaled to the segment length
+	float Hermite(float p0, float p1, float m0, float m1, double t, double length)
+	{
+		double t2 = t * t;
+		double t3 = t2 * t;
+		double h00 = 2.0 * t3 - 3.0 * t2 + 1.0;
+		double h10 = t3 - 2.0 * t2 + t;
+		double h01 = -2.0 * t3 + 3.0 * t2;
+		double h11 = t3 - t2;
+		return static_cast<float>(h00 * p0 + h10 * length * m0 + h01 * p1 + h11 * length * m1);
+	}
+}
+
+bool BenchmarkScenario::Parse(const std::string& text, std::string& error)
+{
+	Clear();
+
+	std::vector<uint32_t> techniques;
+	std::vector<bool> async;
+	std::vector<float> rsmRatios;
+	std::vector<float> vctRatios;
+
+	auto fail = [&](uint32_t line, const std::string& message) {
+		error = "line " + std::to_string(line) + ": " + message;
+		Clear();
+		return false;
+	};
+
+	std::stringstream lines(text);
+	std::string line;
+	uint32_t lineNumber = 0;
+	while (std::getline(lines, line))
+	{
+		lineNumber++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos)
+			line.erase(comment);
+
+		std::stringstream stream(line);
+		std::string directive;
+		if (!(stream >> directive))
+			continue;
+
+		std::vector<std::string> args;
+		std::string arg;
+		while (stream >> arg)
+			args.push_back(arg);
+		if (args.empty())
+			return fail(lineNumber, "'" + directive + "' needs a value");
+
+		if (directive == "name")
+		{
+			mName = args[0];
+			for (size_t i = 1; i < args.size(); i++)
+				mName += " " + args[i];
+		}
+		else if (directive == "frames" || directive == "warmup")
+		{
+			uint32_t count = 0;
+			if (args.size() != 1 || !ParseCount(args[0], count))
+				return fail(lineNumber, "'" + directive + "' takes one frame count");
+			if (directive == "frames")
+			{
+				if (count == 0)
+					return fail(lineNumber, "'frames' has to be at least 1");
+				mFrameCount = count;
+			}
+			else
+				mWarmupFrameCount = count;
+		}
+		else if (directive == "timestep")
+		{
+			if (args.size() != 1 || !ParseDouble(args[0], mTimeStep) || mTimeStep <= 0.0)
+				return fail(lineNumber, "'timestep' takes one positive number of seconds");
+		}
+		else if (directive == "camera")
+		{
+			double values[7];
+			if (args.size() != 7)
+				return fail(lineNumber, "'camera' takes a time, a position and a target");
+			for (size_t i = 0; i < 7; i++)
+			{
+				if (!ParseDouble(args[i], values[i]))
+					return fail(lineNumber, "'" + args[i] + "' is not a number");
+			}
+
+			Keyframe keyframe;
+			keyframe.mTime = values[0];
+			keyframe.mPosition = { float(values[1]), float(values[2]), float(values[3]) };
+			keyframe.mTarget = { float(values[4]), float(values[5]), float(values[6]) };
+			for (auto& other : mKeyframes)
+			{
+				if (other.mTime == keyframe.mTime)
+					return fail(lineNumber, "two camera keyframes at time " + args[0]);
+			}
+			mKeyframes.push_back(keyframe);
+		}
+		else if (directive == "gi")
+		{
+			for (auto& token : args)
+			{
+				uint32_t set = 0;
+				if (!ParseTechniques(token, set))
+					return fail(lineNumber, "unknown technique set '" + token + "', use none or rsm, lpv and vct joined by '+'");
+				techniques.push_back(set);
+			}
+		}
+		else if (directive == "async")
+		{
+			for (auto& token : args)
+			{
+				if (token != "on" && token != "off")
+					return fail(lineNumber, "'async' takes on or off");
+				async.push_back(token == "on");
+			}
+		}
+		else if (directive == "rsm_ratio" || directive == "vct_ratio")
+		{
+			for (auto& token : args)
+			{
+				double ratio = 0.0;
+				if (!ParseDouble(token, ratio) || ratio <= 0.0 || ratio > 1.0)
+					return fail(lineNumber, "'" + directive + "' takes ratios in (0, 1]");
+				(directive == "rsm_ratio" ? rsmRatios : vctRatios).push_back(float(ratio));
+			}
+		}
+		else
+			return fail(lineNumber, "unknown directive '" + directive + "'");
+	}
+
+	if (mKeyframes.empty())
+	{
+		error = "the scenario has no camera keyframes";
+		Clear();
+		return false;
+	}
+
+	std::stable_sort(mKeyframes.begin(), mKeyframes.end(), [](const Keyframe& a, const Keyframe& b) { return a.mTime < b.mTime; });
+
+	if (techniques.empty())
+		techniques.push_back(0);
+	if (async.empty())
+		async.push_back(false);
+	if (rsmRatios.empty())
+		rsmRatios.push_back(DEFAULT_RSM_RATIO);
+	if (vctRatios.empty())
+		vctRatios.push_back(DEFAULT_VCT_RATIO);
+	ExpandRuns(techniques, async, rsmRatios, vctRatios);
+
+	if (mName.empty())
+		mName = "benchmark";
+	error.clear();
+	return true;
+}
+
+bool BenchmarkScenario::Load(const std::filesystem::path& path, std::string& error)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		Clear();
+		error = "cannot open " + path.string();
+		return false;
+	}
+
+	std::stringstream stream;
+	stream << file.rdbuf();
+	if (!Parse(stream.str(), error))
+	{
+		error = path.string() + ", " + error;
+		return false;
+	}
+	return true;
+}
+
+void BenchmarkScenario::ExpandRuns(const std::vector<uint32_t>& techniques, const std::vector<bool>& async,
+	const std::vector<float>& rsmRatios, const std::vector<float>& vctRatios)
+{
+	for (uint32_t set : techniques)
+	{
+		for (bool asyncCompute : async)
+		{
+			// a ratio only matters when its technique renders, otherwise the first one stands in for all
+			size_t rsmCount = (set & TECHNIQUE_RSM) ? rsmRatios.size() : 1;
+			size_t vctCount = (set & TECHNIQUE_VCT) ? vctRatios.size() : 1;
+			for (size_t rsm = 0; rsm < rsmCount; rsm++)
+			{
+				for (size_t vct = 0; vct < vctCount; vct++)
+				{
+					Run run;
+					run.mTechniques = set;
+					run.mAsyncCompute = asyncCompute;
+					run.mRSMRatio = rsmRatios[rsm];
+					run.mVCTRatio = vctRatios[vct];
+
+					std::ostringstream name;
+					name << GetTechniquesString(set) << (asyncCompute ? " async" : "");
+					if (set & TECHNIQUE_RSM)
+						name << " rsm_ratio=" << run.mRSMRatio;
+					if (set & TECHNIQUE_VCT)
+						name << " vct_ratio=" << run.mVCTRatio;
+					run.mName = name.str();
+
+					// the same set listed twice would only repeat a run
+					bool duplicate = false;
+					for (auto& other : mRuns)
+						duplicate |= other.mName == run.mName;
+					if (!duplicate)
+						mRuns.push_back(run);
+				}
+			}
+		}
+	}
+}
+
+void BenchmarkScenario::EvaluateCamera(double time, Vector3& position, Vector3& target) const
+{
+	if (mKeyframes.empty())
+	{
+		position = target = Vector3();
+		return;
+	}
+
+	time = std::min(std::max(time + mKeyframes.front().mTime, mKeyframes.front().mTime), mKeyframes.back().mTime);
+	size_t segment = 0;
+	while (segment + 2 < mKeyframes.size() && mKeyframes[segment + 1].mTime <= time)
+		segment++;
+
+	const Keyframe& k1 = mKeyframes[segment];
+	if (mKeyframes.size() == 1)
+	{
+		position = k1.mPosition;
+		target = k1.mTarget;
+		return;
+	}
+
+	const Keyframe& k0 = mKeyframes[segment > 0 ? segment - 1 : segment];
+	const Keyframe& k2 = mKeyframes[segment + 1];
+	const Keyframe& k3 = mKeyframes[segment + 2 < mKeyframes.size() ? segment + 2 : segment + 1];
+
+	double length = k2.mTime - k1.mTime;
+	double t = (time - k1.mTime) / length;
+
+	// Catmull-Rom tangents from the neighbouring keyframes, one-sided at the ends of the path
+	auto evaluate = [&](Vector3 Keyframe::* member) {
+		auto component = [&](float Vector3::* axis) {
+			float p0 = (k0.*member).*axis;
+			float p1 = (k1.*member).*axis;
+			float p2 = (k2.*member).*axis;
+			float p3 = (k3.*member).*axis;
+			float m1 = float((p2 - p0) / (k2.mTime - k0.mTime));
+			float m2 = float((p3 - p1) / (k3.mTime - k1.mTime));
+			return Hermite(p1, p2, m1, m2, t, length);
+		};
+		return Vector3{ component(&Vector3::x), component(&Vector3::y), component(&Vector3::z) };
+	};
+
+	position = evaluate(&Keyframe::mPosition);
+	target = evaluate(&Keyframe::mTarget);
+}
+
+std::string BenchmarkScenario::GetTechniquesString(uint32_t techniques)
+{
+	std::string names;
+	if (techniques & TECHNIQUE_RSM)
+		names += "rsm";
+	if (techniques & TECHNIQUE_LPV)
+		names += names.empty() ? "lpv" : "+lpv";
+	if (techniques & TECHNIQUE_VCT)
+		names += names.empty() ? "vct" : "+vct";
+	return names.empty() ? "none" : names;
+}
+
+void BenchmarkScenario::Clear()
+{
+	mName.clear();
+	mFrameCount = DEFAULT_FRAMES;
+	mWarmupFrameCount = DEFAULT_WARMUP_FRAMES;
+	mTimeStep = DEFAULT_TIME_STEP;
+	mKeyframes.clear();
+	mRuns.clear();
+}
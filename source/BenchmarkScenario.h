@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Benchmark description loaded from a text file: a camera path, the number of frames every run renders with a
+// fixed timestep, and a matrix of renderer settings that is expanded into one run per combination.
+// One directive per line, '#' starts a comment:
+//   name <text>
+//   frames <count>              measured frames per run
+//   warmup <count>              frames rendered at the start of the path before measuring
+//   timestep <seconds>          simulation step of every frame
+//   camera <time> <px py pz> <tx ty tz>     keyframe with position and look-at target
+//   gi <set> ...                technique sets, "none" or techniques joined by '+' (rsm+lpv, vct)
+//   async <on|off> ...
+//   rsm_ratio <ratio> ...       RSM and VCT render target size relative to the screen, in (0, 1]
+//   vct_ratio <ratio> ...
+// Missing axes use the scene defaults (no GI, no async compute, ratios 1/3 and 1/2). The ratio of a technique
+// that is off in a run does not multiply the runs.
+// Only uses the standard library; the runs and the camera path are plain data the renderer applies.
+class BenchmarkScenario
+{
+public:
+    enum Technique
+    {
+        TECHNIQUE_RSM = 1 << 0,
+        TECHNIQUE_LPV = 1 << 1,
+        TECHNIQUE_VCT = 1 << 2
+    };
+
+    struct Vector3
+    {
+        float x = 0.0f;
+        float y = 0.0f;
+        float z = 0.0f;
+    };
+
+    struct Keyframe
+    {
+        double mTime = 0.0;
+        Vector3 mPosition;
+        Vector3 mTarget;
+    };
+
+    struct Run
+    {
+        std::string mName;
+        uint32_t mTechniques = 0;
+        bool mAsyncCompute = false;
+        float mRSMRatio = 0.0f;
+        float mVCTRatio = 0.0f;
+    };
+
+    static constexpr uint32_t DEFAULT_FRAMES = 300;
+    static constexpr uint32_t DEFAULT_WARMUP_FRAMES = 30;
+    static constexpr double DEFAULT_TIME_STEP = 1.0 / 60.0;
+    static constexpr float DEFAULT_RSM_RATIO = 0.33333f;
+    static constexpr float DEFAULT_VCT_RATIO = 0.5f;
+
+    // On failure the error names the line and the scenario is left empty
+    bool Parse(const std::string& text, std::string& error);
+    bool Load(const std::filesystem::path& path, std::string& error);
+
+    const std::string& GetName() const { return mName; }
+    uint32_t GetFrameCount() const { return mFrameCount; }
+    uint32_t GetWarmupFrameCount() const { return mWarmupFrameCount; }
+    double GetTimeStep() const { return mTimeStep; }
+
+    // Sorted by time
+    const std::vector<Keyframe>& GetKeyframes() const { return mKeyframes; }
+    double GetDuration() const { return mKeyframes.empty() ? 0.0 : mKeyframes.back().mTime - mKeyframes.front().mTime; }
+    // Time is relative to the first keyframe and clamped to the path. Position and target follow Catmull-Rom
+    // splines through the keyframes, so a path with uneven keyframe spacing keeps a continuous velocity.
+    void EvaluateCamera(double time, Vector3& position, Vector3& target) const;
+
+    // In matrix order: technique sets, then async, then RSM ratio, then VCT ratio
+    const std::vector<Run>& GetRuns() const { return mRuns; }
+
+    // "none" or the techniques joined by '+'
+    static std::string GetTechniquesString(uint32_t techniques);
+
+    void Clear();
+
+private:
+    void ExpandRuns(const std::vector<uint32_t>& techniques, const std::vector<bool>& async,
+        const std::vector<float>& rsmRatios, const std::vector<float>& vctRatios);
+
+    std::string mName;
+    uint32_t mFrameCount = DEFAULT_FRAMES;
+    uint32_t mWarmupFrameCount = DEFAULT_WARMUP_FRAMES;
+    double mTimeStep = DEFAULT_TIME_STEP;
+    std::vector<Keyframe> mKeyframes;
+    std::vector<Run> mRuns;
+};
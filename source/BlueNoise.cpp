@@ -0,0 +1,298 @@
+#include "BlueNoise.h"
+#include "CpuProfiler.h"
+#include "Sampling.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+
+namespace
+{
+	// Reusable barrier for the threads of one layer, waited on once per step. Steps take microseconds, so it spins
+	// before it yields instead of sleeping on a condition variable.
+	class SpinBarrier
+	{
+	public:
+		explicit SpinBarrier(uint32_t count) : mCount(count) {}
+
+		void Wait()
+		{
+			uint32_t generation = mGeneration.load(std::memory_order_acquire);
+			if (mArrived.fetch_add(1, std::memory_order_acq_rel) + 1 == mCount)
+			{
+				mArrived.store(0, std::memory_order_relaxed);
+				mGeneration.store(generation + 1, std::memory_order_release);
+				return;
+			}
+			for (uint32_t spin = 0; mGeneration.load(std::memory_order_acquire) == generation; spin++)
+			{
+				if (spin >= 64)
+					std::this_thread::yield();
+			}
+		}
+
+	private:
+		const uint32_t mCount;
+		std::atomic<uint32_t> mArrived{ 0 };
+		std::atomic<uint32_t> mGeneration{ 0 };
+	};
+
+	// The state of one tile, shared by the threads generating it. Every thread owns a band of rows: it updates the
+	// energies, the pattern and the row caches of its band only and finds the best candidate of its band, so a step
+	// needs a single barrier, after which every thread picks the same pixel from the candidates of all bands.
+	class VoidAndCluster
+	{
+	public:
+		VoidAndCluster(uint32_t size, uint32_t threadCount)
+			: mSize(int(size))
+			// 2 * radius + 1 <= size, so no pixel is reached twice around the torus
+			, mRadius(std::min(int(std::ceil(4.0f * BlueNoise::SIGMA)), (int(size) - 1) / 2))
+			, mThreadCount(int(threadCount))
+			, mPattern(size_t(size) * size)
+			, mEnergy(size_t(size) * size)
+			, mRowCluster(size)
+			, mRowVoid(size)
+			, mBarrier(threadCount)
+		{
+			int width = 2 * mRadius + 1;
+			mWeights.resize(size_t(width) * width);
+			for (int y = -mRadius; y <= mRadius; y++)
+				for (int x = -mRadius; x <= mRadius; x++)
+					mWeights[(y + mRadius) * width + x + mRadius] = std::exp(-float(x * x + y * y) / (2.0f * BlueNoise::SIGMA * BlueNoise::SIGMA));
+			for (auto& candidates : mCandidates)
+				candidates.resize(threadCount);
+		}
+
+		// Called by each of the threadCount threads with its index, the ranks are written by thread 0
+		void Generate(uint32_t thread, uint64_t seed, uint64_t stream, uint32_t* ranks)
+		{
+			Worker worker(*this, int(thread));
+			const int pixelCount = mSize * mSize;
+			const size_t bandBegin = size_t(worker.mBegin) * mSize;
+			const size_t bandEnd = size_t(worker.mEnd) * mSize;
+			std::fill(mPattern.begin() + bandBegin, mPattern.begin() + bandEnd, uint8_t(0));
+			std::fill(mEnergy.begin() + bandBegin, mEnergy.begin() + bandEnd, 0.0f);
+			for (int y = worker.mBegin; y < worker.mEnd; y++)
+				RefreshRow(y);
+
+			// every thread draws the same pixels and splats them into its band
+			PCG32 random(seed, stream);
+			std::vector<uint8_t> initialPattern(pixelCount, 0);
+			int initial = std::max(pixelCount * int(BlueNoise::INITIAL_PERCENT) / 100, 1);
+			while (worker.mOnes < initial)
+			{
+				int pixel = int(random.NextBounded(uint32_t(pixelCount)));
+				if (!initialPattern[pixel])
+				{
+					initialPattern[pixel] = 1;
+					worker.Set(pixel, true);
+				}
+			}
+
+			// relax; float drift could make a move undo itself forever, so the moves are capped
+			for (int move = 0; move < pixelCount; move++)
+			{
+				int cluster = worker.TightestCluster();
+				worker.Set(cluster, false);
+				int largestVoid = worker.LargestVoid();
+				worker.Set(largestVoid, true);
+				if (largestVoid == cluster)
+					break;
+			}
+
+			std::vector<uint8_t> pattern(mPattern.begin() + bandBegin, mPattern.begin() + bandEnd);
+			std::vector<float> energy(mEnergy.begin() + bandBegin, mEnergy.begin() + bandEnd);
+			std::vector<int> rowCluster(mRowCluster.begin() + worker.mBegin, mRowCluster.begin() + worker.mEnd);
+			std::vector<int> rowVoid(mRowVoid.begin() + worker.mBegin, mRowVoid.begin() + worker.mEnd);
+			int ones = worker.mOnes;
+
+			while (worker.mOnes > 0)
+			{
+				int cluster = worker.TightestCluster();
+				worker.Set(cluster, false);
+				if (thread == 0)
+					ranks[cluster] = uint32_t(worker.mOnes);
+			}
+
+			std::copy(pattern.begin(), pattern.end(), mPattern.begin() + bandBegin);
+			std::copy(energy.begin(), energy.end(), mEnergy.begin() + bandBegin);
+			std::copy(rowCluster.begin(), rowCluster.end(), mRowCluster.begin() + worker.mBegin);
+			std::copy(rowVoid.begin(), rowVoid.end(), mRowVoid.begin() + worker.mBegin);
+			worker.mOnes = ones;
+
+			// filling the largest voids of the minority pixels is removing the tightest clusters of the majority, so
+			// the last phase of the method is this one continued
+			while (worker.mOnes < pixelCount)
+			{
+				int largestVoid = worker.LargestVoid();
+				if (thread == 0)
+					ranks[largestVoid] = uint32_t(worker.mOnes);
+				worker.Set(largestVoid, true);
+			}
+
+			// the next layer of the group starts over with the first candidate slot
+			mBarrier.Wait();
+		}
+
+	private:
+		struct Candidate
+		{
+			int mPixel;
+			float mEnergy;
+		};
+
+		// The view of one thread: its band of rows, its step count and its copy of the number of ones
+		struct Worker
+		{
+			Worker(VoidAndCluster& generator, int thread)
+				: mGenerator(generator)
+				, mThread(thread)
+				, mBegin(generator.mSize * thread / generator.mThreadCount)
+				, mEnd(generator.mSize * (thread + 1) / generator.mThreadCount)
+			{
+			}
+
+			void Set(int pixel, bool value)
+			{
+				mOnes += value ? 1 : -1;
+				mGenerator.Splat(pixel, value, mBegin, mEnd);
+			}
+
+			int TightestCluster() { return Select(true); }
+			int LargestVoid() { return Select(false); }
+
+			// The best candidate of the band, then the best of the bands in row order, as a single thread would
+			// pick it. The candidates alternate between two slots, so one thread's next step can't overwrite the
+			// slot another thread still reads.
+			int Select(bool cluster)
+			{
+				std::vector<Candidate>& candidates = mGenerator.mCandidates[mStep++ & 1];
+				candidates[mThread] = mGenerator.FindCandidate(cluster, mBegin, mEnd);
+				if (mGenerator.mThreadCount > 1)
+					mGenerator.mBarrier.Wait();
+
+				Candidate best = { -1, 0.0f };
+				for (const Candidate& candidate : candidates)
+				{
+					if (candidate.mPixel >= 0 && (best.mPixel < 0 || (cluster ? candidate.mEnergy > best.mEnergy : candidate.mEnergy < best.mEnergy)))
+						best = candidate;
+				}
+				return best.mPixel;
+			}
+
+			VoidAndCluster& mGenerator;
+			const int mThread;
+			const int mBegin, mEnd;
+			uint32_t mStep = 0;
+			int mOnes = 0;
+		};
+
+		// Adds or removes the energy of pixel in the rows [begin, end) and rescans those rows
+		void Splat(int pixel, bool value, int begin, int end)
+		{
+			int px = pixel % mSize;
+			int py = pixel / mSize;
+			if (py >= begin && py < end)
+				mPattern[pixel] = value ? 1 : 0;
+			float sign = value ? 1.0f : -1.0f;
+
+			int width = 2 * mRadius + 1;
+			for (int dy = -mRadius; dy <= mRadius; dy++)
+			{
+				int y = (py + dy + mSize) % mSize;
+				if (y < begin || y >= end)
+					continue;
+				float* row = &mEnergy[size_t(y) * mSize];
+				const float* weights = &mWeights[(dy + mRadius) * width + mRadius];
+				for (int dx = -mRadius; dx <= mRadius; dx++)
+					row[(px + dx + mSize) % mSize] += sign * weights[dx];
+				RefreshRow(y);
+			}
+		}
+
+		void RefreshRow(int y)
+		{
+			int cluster = -1;
+			int largestVoid = -1;
+			const int begin = y * mSize;
+			for (int pixel = begin; pixel < begin + mSize; pixel++)
+			{
+				if (mPattern[pixel])
+				{
+					if (cluster < 0 || mEnergy[pixel] > mEnergy[cluster])
+						cluster = pixel;
+				}
+				else if (largestVoid < 0 || mEnergy[pixel] < mEnergy[largestVoid])
+					largestVoid = pixel;
+			}
+			mRowCluster[y] = cluster;
+			mRowVoid[y] = largestVoid;
+		}
+
+		// The tightest cluster or largest void of the rows [begin, end), -1 if there is none
+		Candidate FindCandidate(bool cluster, int begin, int end) const
+		{
+			const std::vector<int>& rowCandidates = cluster ? mRowCluster : mRowVoid;
+			Candidate best = { -1, 0.0f };
+			for (int y = begin; y < end; y++)
+			{
+				int candidate = rowCandidates[y];
+				if (candidate >= 0 && (best.mPixel < 0 || (cluster ? mEnergy[candidate] > best.mEnergy : mEnergy[candidate] < best.mEnergy)))
+					best = { candidate, mEnergy[candidate] };
+			}
+			return best;
+		}
+
+		int mSize;
+		int mRadius;
+		int mThreadCount;
+		std::vector<float> mWeights;
+		std::vector<uint8_t> mPattern;
+		std::vector<float> mEnergy;
+		std::vector<int> mRowCluster;	// per row, -1 if it has no ones
+		std::vector<int> mRowVoid;		// per row, -1 if it has no zeros
+		std::vector<Candidate> mCandidates[2];	// per thread, of the last two steps
+		SpinBarrier mBarrier;
+	};
+}
+
+void BlueNoise::Generate(uint32_t size, uint32_t layerCount, uint64_t seed, uint32_t threadCount, std::vector<uint32_t>& ranks)
+{
+	CPU_PROFILE_SCOPE("Blue noise");
+
+	const size_t pixelCount = size_t(size) * size;
+	ranks.assign(pixelCount * layerCount, 0);
+	if (size == 0 || layerCount == 0)
+		return;
+
+	// layers go to groups of threads, the threads of a group split the rows of its layer; a band of fewer rows than
+	// MIN_BAND_ROWS costs more in barriers than it saves
+	threadCount = std::max(threadCount, 1u);
+	const uint32_t groupCount = std::min(threadCount, layerCount);
+	const uint32_t groupSize = std::max(std::min(threadCount / groupCount, size / MIN_BAND_ROWS), 1u);
+
+	// layer l is generated from stream l of the seed and a step picks the same pixel whatever the band, so the ranks
+	// don't depend on the thread count
+	std::vector<std::unique_ptr<VoidAndCluster>> generators;
+	for (uint32_t group = 0; group < groupCount; group++)
+		generators.push_back(std::make_unique<VoidAndCluster>(size, groupSize));
+	auto run = [&](uint32_t group, uint32_t thread) {
+		for (uint32_t layer = group; layer < layerCount; layer += groupCount)
+			generators[group]->Generate(thread, seed, layer, &ranks[layer * pixelCount]);
+	};
+
+	std::vector<std::thread> threads;
+	for (uint32_t group = 0; group < groupCount; group++)
+	{
+		for (uint32_t thread = 0; thread < groupSize; thread++)
+		{
+			if (group != 0 || thread != 0)
+				threads.emplace_back(run, group, thread);
+		}
+	}
+	run(0, 0);
+	for (std::thread& thread : threads)
+		thread.join();
+}
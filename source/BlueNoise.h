@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Tileable blue noise by Ulichney's void-and-cluster method: a random initial pattern of 10% of the pixels is relaxed
+// by moving the tightest cluster into the largest void until that no longer changes anything, then pixels are ranked
+// by removing the tightest clusters from it and by filling the largest voids until the tile is full. Thresholding the
+// ranks at any level gives evenly spread pixels, so the noise has no low frequencies.
+// Energy is a Gaussian of sigma 1.5 over toroidal distances, cut off at 4 sigma. Every row caches its tightest
+// cluster and largest void, so a step updates the energies around one pixel and rescans only the rows the filter
+// touched: O(size) instead of O(size^2) per pixel. Layers (e.g. texture channels) are independent tiles and are
+// generated in parallel; threads beyond the layer count split the rows of a layer, each splatting into and searching
+// its own band, with one barrier per step.
+// Only uses the standard library.
+class BlueNoise
+{
+public:
+    static constexpr float SIGMA = 1.5f;
+    static constexpr uint32_t INITIAL_PERCENT = 10;
+    static constexpr uint32_t MIN_BAND_ROWS = 8;
+
+    // Ranks 0 .. size^2 - 1 of size x size pixels per layer, row after row and layer after layer. A thread count of
+    // 0 generates on the calling thread, layers are split over the others and the rows of a layer over the threads
+    // left, in bands of at least MIN_BAND_ROWS rows. The ranks are the same for any thread count.
+    static void Generate(uint32_t size, uint32_t layerCount, uint64_t seed, uint32_t threadCount, std::vector<uint32_t>& ranks);
+    // (rank + 0.5) / size^2, uniform in (0, 1)
+    static float ToUnit(uint32_t rank, uint32_t size) { return (float(rank) + 0.5f) / (float(size) * float(size)); }
+};
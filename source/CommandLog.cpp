@@ -0,0 +1,233 @@
+#include "CommandLog.h"
+#include "Hash.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+	const char LOG_MAGIC[8] = { 'D', 'X', 'R', 'S', 'C', 'M', 'D', 'L' };
+
+	bool ReadVarint(const std::vector<uint8_t>& data, size_t& offset, uint64_t& value)
+	{
+		value = 0;
+		for (uint32_t shift = 0; shift < 64; shift += 7)
+		{
+			if (offset >= data.size())
+				return false;
+			uint8_t byte = data[offset++];
+			value |= uint64_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+}
+
+void CommandLog::Clear()
+{
+	mData.assign(LOG_MAGIC, LOG_MAGIC + sizeof(LOG_MAGIC));
+	WriteVarint(VERSION);
+	mRecordCount = 0;
+	mCurrentList = INVALID_LIST;
+	mCurrentListType = 0;
+}
+
+void CommandLog::BeginFrame(uint64_t frame)
+{
+	WriteRecord(OP_FRAME, { frame });
+	// the lists are reset by the new frame, the next command selects its list again
+	mCurrentList = INVALID_LIST;
+}
+
+void CommandLog::Add(uint32_t list, uint32_t listType, Op op, std::initializer_list<uint64_t> args)
+{
+	SelectList(list, listType);
+	WriteRecord(op, args);
+}
+
+void CommandLog::BeginPass(uint32_t list, uint32_t listType, const std::string& name)
+{
+	SelectList(list, listType);
+	WriteRecord(OP_BEGIN_PASS, {}, &name);
+}
+
+void CommandLog::EndPass(uint32_t list, uint32_t listType)
+{
+	SelectList(list, listType);
+	WriteRecord(OP_END_PASS, {});
+}
+
+void CommandLog::AddToCurrentList(Op op, std::initializer_list<uint64_t> args)
+{
+	if (mCurrentList != INVALID_LIST)
+		WriteRecord(op, args);
+}
+
+bool CommandLog::Write(const std::filesystem::path& path) const
+{
+	std::error_code ec;
+	if (path.has_parent_path())
+		std::filesystem::create_directories(path.parent_path(), ec);
+
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(mData.data()), std::streamsize(mData.size()));
+	return bool(file);
+}
+
+bool CommandLog::Parse(const std::vector<uint8_t>& data, std::vector<Command>& commands, std::string& error)
+{
+	commands.clear();
+	if (data.size() < sizeof(LOG_MAGIC) || std::memcmp(data.data(), LOG_MAGIC, sizeof(LOG_MAGIC)) != 0)
+	{
+		error = "not a command log";
+		return false;
+	}
+
+	size_t offset = sizeof(LOG_MAGIC);
+	uint64_t version = 0;
+	if (!ReadVarint(data, offset, version) || version != VERSION)
+	{
+		error = "unsupported command log version " + std::to_string(version);
+		return false;
+	}
+
+	uint32_t list = INVALID_LIST;
+	uint32_t listType = 0;
+	while (offset < data.size())
+	{
+		size_t recordOffset = offset;
+		auto fail = [&](const std::string& message) {
+			error = "offset " + std::to_string(recordOffset) + ": " + message;
+			commands.clear();
+			return false;
+		};
+
+		Command command;
+		uint8_t op = data[offset++];
+		if (op >= OP_COUNT)
+			return fail("unknown op " + std::to_string(op));
+		command.mOp = Op(op);
+
+		uint64_t argCount = 0;
+		if (!ReadVarint(data, offset, argCount) || argCount > data.size() - offset)
+			return fail("truncated record");
+		command.mArgs.resize(size_t(argCount));
+		for (uint64_t& arg : command.mArgs)
+		{
+			if (!ReadVarint(data, offset, arg))
+				return fail("truncated record");
+		}
+
+		if (command.mOp == OP_BEGIN_PASS)
+		{
+			uint64_t length = 0;
+			if (!ReadVarint(data, offset, length) || length > data.size() - offset)
+				return fail("truncated pass name");
+			command.mName.assign(reinterpret_cast<const char*>(data.data() + offset), size_t(length));
+			offset += size_t(length);
+		}
+
+		if (command.mOp == OP_LIST)
+		{
+			if (command.mArgs.size() < 2)
+				return fail("list record without list and type");
+			list = uint32_t(command.mArgs[0]);
+			listType = uint32_t(command.mArgs[1]);
+		}
+		else if (command.mOp == OP_FRAME)
+			list = INVALID_LIST;
+		else if (list == INVALID_LIST)
+			return fail(std::string(GetOpName(command.mOp)) + " before any list");
+
+		command.mList = list;
+		command.mListType = listType;
+		commands.push_back(std::move(command));
+	}
+	return true;
+}
+
+bool CommandLog::Load(const std::filesystem::path& path, std::vector<Command>& commands, std::string& error)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		error = "cannot open " + path.string();
+		return false;
+	}
+
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (!Parse(data, commands, error))
+	{
+		error = path.string() + ": " + error;
+		return false;
+	}
+	return true;
+}
+
+const char* CommandLog::GetOpName(Op op)
+{
+	static const char* names[OP_COUNT] =
+	{
+		"Frame", "List", "Reset", "Close", "BeginPass", "EndPass",
+		"SetPipelineState", "SetRootSignature", "SetRootDescriptorTable", "SetRoot32BitConstants", "SetRootView",
+		"SetDescriptorHeaps", "RSSetViewports", "RSSetScissorRects", "IASetPrimitiveTopology", "IASetVertexBuffers",
+		"IASetIndexBuffer", "OMSetRenderTargets", "OMSetBlendFactor", "OMSetStencilRef",
+		"ResourceBarrier", "Clear", "DrawInstanced", "DrawIndexedInstanced", "Dispatch", "ExecuteIndirect", "ExecuteBundle",
+		"Copy", "Query", "CopyDescriptors", "Other"
+	};
+	return op < OP_COUNT ? names[op] : "Unknown";
+}
+
+const char* CommandLog::GetListTypeName(uint32_t listType)
+{
+	// D3D12_COMMAND_LIST_TYPE
+	switch (listType)
+	{
+	case 0: return "direct";
+	case 1: return "bundle";
+	case 2: return "compute";
+	case 3: return "copy";
+	default: return "other";
+	}
+}
+
+uint64_t CommandLog::Hash(const void* data, size_t size)
+{
+	return Utility::HashRange(data, size);
+}
+
+void CommandLog::SelectList(uint32_t list, uint32_t listType)
+{
+	if (list == mCurrentList && listType == mCurrentListType)
+		return;
+
+	mCurrentList = list;
+	mCurrentListType = listType;
+	WriteRecord(OP_LIST, { list, listType });
+}
+
+void CommandLog::WriteRecord(Op op, std::initializer_list<uint64_t> args, const std::string* name)
+{
+	mData.push_back(op);
+	WriteVarint(args.size());
+	for (uint64_t arg : args)
+		WriteVarint(arg);
+	if (name)
+	{
+		WriteVarint(name->size());
+		mData.insert(mData.end(), name->begin(), name->end());
+	}
+	mRecordCount++;
+}
+
+void CommandLog::WriteVarint(uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		mData.push_back(uint8_t(value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	mData.push_back(uint8_t(value));
+}
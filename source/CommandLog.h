@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// Compact binary log of the commands recorded into command lists, for analyzing the CPU side of recording
+// offline. The log starts with "DXRSCMDL" and a format version, followed by records: an op byte, the number
+// of operands and the operands as LEB128 varints, then a length prefixed name for the ops that carry one.
+// Commands apply to the list selected by the last OP_LIST record, which the writer emits whenever the
+// recording list changes. Values are only kept as far as telling a repeated state from a new one needs:
+// objects by address, arrays (viewports, render targets, root constants) by hash and count.
+// Only uses the standard library; the D3D12 side lives in RecordingCommandList.
+class CommandLog
+{
+public:
+    enum Op : uint8_t
+    {
+        OP_FRAME = 0,               // frame; every list starts over with no state
+        OP_LIST,                    // list, type (D3D12_COMMAND_LIST_TYPE)
+        OP_RESET,
+        OP_CLOSE,
+        OP_BEGIN_PASS,              // name
+        OP_END_PASS,
+        OP_SET_PIPELINE_STATE,      // pipeline state
+        OP_SET_ROOT_SIGNATURE,      // bind point, root signature
+        OP_SET_ROOT_TABLE,          // bind point, slot, GPU descriptor handle
+        OP_SET_ROOT_CONSTANTS,      // bind point, slot, offset, count, hash
+        OP_SET_ROOT_VIEW,           // bind point, slot, view type, GPU address
+        OP_SET_DESCRIPTOR_HEAPS,    // count, hash
+        OP_SET_VIEWPORTS,           // count, hash
+        OP_SET_SCISSOR_RECTS,       // count, hash
+        OP_SET_PRIMITIVE_TOPOLOGY,  // topology
+        OP_SET_VERTEX_BUFFERS,      // start slot, count, hash
+        OP_SET_INDEX_BUFFER,        // hash
+        OP_SET_RENDER_TARGETS,      // count, hash (depth stencil included)
+        OP_SET_BLEND_FACTOR,        // hash
+        OP_SET_STENCIL_REF,         // reference
+        OP_BARRIER,                 // transitions, aliasing, UAV barriers
+        OP_CLEAR,                   // clear type
+        OP_DRAW,                    // vertices per instance, instances
+        OP_DRAW_INDEXED,            // indices per instance, instances
+        OP_DISPATCH,                // x, y, z
+        OP_EXECUTE_INDIRECT,        // max commands
+        OP_EXECUTE_BUNDLE,          // bundle
+        OP_COPY,                    // copy type
+        OP_QUERY,                   // query operation
+        OP_DESCRIPTOR_COPY,         // descriptors
+        OP_OTHER,                   // other type
+        OP_COUNT
+    };
+
+    enum BindPoint
+    {
+        BIND_GRAPHICS = 0,
+        BIND_COMPUTE
+    };
+
+    enum ViewType
+    {
+        VIEW_CBV = 0,
+        VIEW_SRV,
+        VIEW_UAV
+    };
+
+    enum ClearType
+    {
+        CLEAR_RTV = 0,
+        CLEAR_DSV,
+        CLEAR_UAV_UINT,
+        CLEAR_UAV_FLOAT
+    };
+
+    enum CopyType
+    {
+        COPY_RESOURCE = 0,
+        COPY_BUFFER_REGION,
+        COPY_TEXTURE_REGION,
+        COPY_TILES,
+        COPY_RESOLVE
+    };
+
+    enum QueryOperation
+    {
+        QUERY_BEGIN = 0,
+        QUERY_END,
+        QUERY_RESOLVE
+    };
+
+    enum OtherType
+    {
+        OTHER_CLEAR_STATE = 0,
+        OTHER_SO_TARGETS,
+        OTHER_DISCARD,
+        OTHER_PREDICATION,
+        OTHER_MARKER,
+        OTHER_BEGIN_EVENT,
+        OTHER_END_EVENT
+    };
+
+    struct Command
+    {
+        Op mOp = OP_FRAME;
+        uint32_t mList = 0;
+        uint32_t mListType = 0;
+        std::vector<uint64_t> mArgs;
+        std::string mName;          // OP_BEGIN_PASS only
+    };
+
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t INVALID_LIST = ~0u;
+
+    CommandLog() { Clear(); }
+
+    // Drops every record and starts over with the header
+    void Clear();
+
+    void BeginFrame(uint64_t frame);
+    void Add(uint32_t list, uint32_t listType, Op op, std::initializer_list<uint64_t> args);
+    void BeginPass(uint32_t list, uint32_t listType, const std::string& name);
+    void EndPass(uint32_t list, uint32_t listType);
+    // For device calls that feed the recording, like descriptor copies; they go to the list recorded last
+    void AddToCurrentList(Op op, std::initializer_list<uint64_t> args);
+
+    const std::vector<uint8_t>& GetData() const { return mData; }
+    uint64_t GetRecordCount() const { return mRecordCount; }
+    bool Write(const std::filesystem::path& path) const;
+
+    // On failure the error names the byte offset and the commands are left empty
+    static bool Parse(const std::vector<uint8_t>& data, std::vector<Command>& commands, std::string& error);
+    static bool Load(const std::filesystem::path& path, std::vector<Command>& commands, std::string& error);
+
+    static const char* GetOpName(Op op);
+    static const char* GetListTypeName(uint32_t listType);
+    static uint64_t Hash(const void* data, size_t size);
+
+private:
+    void SelectList(uint32_t list, uint32_t listType);
+    void WriteRecord(Op op, std::initializer_list<uint64_t> args, const std::string* name = nullptr);
+    void WriteVarint(uint64_t value);
+
+    std::vector<uint8_t> mData;
+    uint64_t mRecordCount = 0;
+    uint32_t mCurrentList = INVALID_LIST;
+    uint32_t mCurrentListType = 0;
+};
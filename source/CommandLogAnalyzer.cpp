@@ -0,0 +1,256 @@
+#include "CommandLogAnalyzer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+	// root tables, constants and views share the slots of a root signature
+	const uint64_t ROOT_ARGUMENT_KEY = 0xff;
+
+	uint64_t GetArg(const CommandLog::Command& command, size_t index)
+	{
+		return index < command.mArgs.size() ? command.mArgs[index] : 0;
+	}
+}
+
+void CommandLogAnalyzer::Analyze(const std::vector<CommandLog::Command>& commands)
+{
+	mPasses.clear();
+	mPassIndices.clear();
+	std::fill(std::begin(mOps), std::end(mOps), OpStats());
+	mFrameCount = 0;
+	mCommandCount = 0;
+	mUnbalancedPasses = 0;
+
+	std::map<uint32_t, ListState> lists;
+	for (const CommandLog::Command& command : commands)
+	{
+		if (command.mOp == CommandLog::OP_FRAME)
+		{
+			for (auto& list : lists)
+				mUnbalancedPasses += list.second.mPasses.size();
+			lists.clear();
+			mFrameCount++;
+			continue;
+		}
+		if (command.mOp == CommandLog::OP_LIST)
+			continue;
+
+		ListState& list = lists[command.mList];
+		if (command.mOp == CommandLog::OP_BEGIN_PASS)
+		{
+			std::string name = list.mPasses.empty() ? command.mName : mPasses[list.mPasses.back()].mName + "/" + command.mName;
+			size_t pass = GetPass(name, command.mListType, uint32_t(list.mPasses.size()));
+			mPasses[pass].mInstances++;
+			list.mPasses.push_back(pass);
+			continue;
+		}
+		if (command.mOp == CommandLog::OP_END_PASS)
+		{
+			if (list.mPasses.empty())
+				mUnbalancedPasses++;
+			else
+				list.mPasses.pop_back();
+			continue;
+		}
+
+		size_t passIndex = list.mPasses.empty() ? GetPass("(no pass)", command.mListType, 0) : list.mPasses.back();
+		OpStats& op = mOps[command.mOp];
+		op.mCount++;
+		mCommandCount++;
+
+		PassStats& pass = mPasses[passIndex];
+		pass.mCommands++;
+		switch (command.mOp)
+		{
+		case CommandLog::OP_RESET:
+			mUnbalancedPasses += list.mPasses.size();
+			list = ListState();
+			break;
+		case CommandLog::OP_DRAW:
+		case CommandLog::OP_DRAW_INDEXED:
+		case CommandLog::OP_EXECUTE_INDIRECT:
+			pass.mDraws++;
+			break;
+		case CommandLog::OP_DISPATCH:
+			pass.mDispatches++;
+			break;
+		case CommandLog::OP_BARRIER:
+			pass.mBarrierCalls++;
+			pass.mBarriers += GetArg(command, 0) + GetArg(command, 1) + GetArg(command, 2);
+			break;
+		case CommandLog::OP_DESCRIPTOR_COPY:
+			pass.mDescriptorCopies += GetArg(command, 0);
+			break;
+		case CommandLog::OP_CLEAR:
+			pass.mClears++;
+			break;
+		case CommandLog::OP_COPY:
+			pass.mCopies++;
+			break;
+		case CommandLog::OP_EXECUTE_BUNDLE:
+			// bundles cannot set viewports, scissors, render targets, blend factor or stencil reference
+			// and only use the heaps already set, whatever else they set stays behind
+			for (auto state = list.mState.begin(); state != list.mState.end();)
+			{
+				uint64_t stateOp = state->first & 0xff;
+				if (stateOp == ROOT_ARGUMENT_KEY || stateOp == CommandLog::OP_SET_PIPELINE_STATE || stateOp == CommandLog::OP_SET_ROOT_SIGNATURE ||
+					stateOp == CommandLog::OP_SET_PRIMITIVE_TOPOLOGY || stateOp == CommandLog::OP_SET_VERTEX_BUFFERS || stateOp == CommandLog::OP_SET_INDEX_BUFFER)
+					state = list.mState.erase(state);
+				else
+					++state;
+			}
+			break;
+		case CommandLog::OP_OTHER:
+			if (GetArg(command, 0) == CommandLog::OTHER_CLEAR_STATE)
+				list.mState.clear();
+			break;
+		default:
+			if (IsStateOp(command.mOp))
+			{
+				pass.mStateSets++;
+				if (ApplyState(list, command))
+				{
+					pass.mRedundantStateSets++;
+					op.mRedundant++;
+				}
+			}
+			break;
+		}
+	}
+
+	for (auto& list : lists)
+		mUnbalancedPasses += list.second.mPasses.size();
+}
+
+bool CommandLogAnalyzer::IsStateOp(CommandLog::Op op)
+{
+	return op >= CommandLog::OP_SET_PIPELINE_STATE && op <= CommandLog::OP_SET_STENCIL_REF;
+}
+
+size_t CommandLogAnalyzer::GetPass(const std::string& name, uint32_t listType, uint32_t depth)
+{
+	auto it = mPassIndices.find(std::make_pair(listType, name));
+	if (it != mPassIndices.end())
+		return it->second;
+
+	PassStats pass;
+	pass.mName = name;
+	pass.mListType = listType;
+	pass.mDepth = depth;
+	mPasses.push_back(pass);
+	mPassIndices[std::make_pair(listType, name)] = mPasses.size() - 1;
+	return mPasses.size() - 1;
+}
+
+bool CommandLogAnalyzer::ApplyState(ListState& list, const CommandLog::Command& command)
+{
+	uint64_t key = command.mOp;
+	std::vector<uint64_t> value = command.mArgs;
+	switch (command.mOp)
+	{
+	case CommandLog::OP_SET_ROOT_SIGNATURE:
+		key |= GetArg(command, 0) << 8;
+		break;
+	case CommandLog::OP_SET_ROOT_TABLE:
+	case CommandLog::OP_SET_ROOT_CONSTANTS:
+	case CommandLog::OP_SET_ROOT_VIEW:
+		// the op stays in the value, a table replacing constants in the same slot is a change
+		key = ROOT_ARGUMENT_KEY | (GetArg(command, 0) << 8) | (GetArg(command, 1) << 16);
+		value.insert(value.begin(), command.mOp);
+		break;
+	case CommandLog::OP_SET_VERTEX_BUFFERS:
+		key |= GetArg(command, 0) << 8;
+		break;
+	default:
+		break;
+	}
+
+	auto it = list.mState.find(key);
+	if (it != list.mState.end() && it->second == value)
+		return true;
+
+	if (command.mOp == CommandLog::OP_SET_ROOT_SIGNATURE)
+	{
+		// a new root signature leaves the root arguments of its bind point undefined
+		uint64_t bindPoint = ROOT_ARGUMENT_KEY | (GetArg(command, 0) << 8);
+		for (auto argument = list.mState.begin(); argument != list.mState.end();)
+		{
+			if ((argument->first & 0xffff) == bindPoint)
+				argument = list.mState.erase(argument);
+			else
+				++argument;
+		}
+	}
+	list.mState[key] = value;
+	return false;
+}
+
+std::string CommandLogAnalyzer::FormatReport() const
+{
+	std::ostringstream stream;
+	stream << mFrameCount << " frame(s), " << mCommandCount << " commands";
+	if (mFrameCount > 1)
+		stream << " (" << std::fixed << std::setprecision(1) << double(mCommandCount) / double(mFrameCount) << " per frame)";
+	stream << "\n";
+	if (mUnbalancedPasses > 0)
+		stream << "warning: " << mUnbalancedPasses << " unbalanced pass(es)\n";
+	stream << "\n";
+
+	char line[256];
+	std::snprintf(line, sizeof(line), "%-44s %-8s %6s %7s %6s %6s %9s %7s %9s %9s\n", "Pass", "Queue", "Count", "Cmds", "Draws",
+		"Disp", "Barriers", "State", "Redundant", "DescCopy");
+	stream << line;
+	for (const PassStats& pass : mPasses)
+	{
+		std::string name = std::string(pass.mDepth * 2, ' ') + pass.mName.substr(pass.mName.rfind('/') + 1);
+		if (name.size() > 44)
+			name = name.substr(0, 41) + "...";
+		std::snprintf(line, sizeof(line), "%-44s %-8s %6llu %7llu %6llu %6llu %9llu %7llu %9llu %9llu\n", name.c_str(),
+			CommandLog::GetListTypeName(pass.mListType), (unsigned long long)pass.mInstances, (unsigned long long)pass.mCommands,
+			(unsigned long long)pass.mDraws, (unsigned long long)pass.mDispatches, (unsigned long long)pass.mBarriers,
+			(unsigned long long)pass.mStateSets, (unsigned long long)pass.mRedundantStateSets, (unsigned long long)pass.mDescriptorCopies);
+		stream << line;
+	}
+
+	stream << "\nRedundant state changes\n";
+	bool any = false;
+	for (int op = CommandLog::OP_SET_PIPELINE_STATE; op <= CommandLog::OP_SET_STENCIL_REF; op++)
+	{
+		const OpStats& stats = mOps[op];
+		if (stats.mCount == 0)
+			continue;
+		std::snprintf(line, sizeof(line), "  %-28s %7llu of %7llu (%5.1f%%)\n", CommandLog::GetOpName(CommandLog::Op(op)),
+			(unsigned long long)stats.mRedundant, (unsigned long long)stats.mCount, 100.0 * double(stats.mRedundant) / double(stats.mCount));
+		stream << line;
+		any = true;
+	}
+	if (!any)
+		stream << "  none recorded\n";
+	return stream.str();
+}
+
+std::string CommandLogAnalyzer::ExportCSV() const
+{
+	auto quote = [](const std::string& text) {
+		std::string quoted = "\"";
+		for (char c : text)
+			quoted += c == '"' ? std::string("\"\"") : std::string(1, c);
+		return quoted + "\"";
+	};
+
+	std::ostringstream stream;
+	stream << "queue,pass,depth,instances,commands,draws,dispatches,barrier_calls,barriers,state_sets,redundant_state_sets,"
+		"descriptor_copies,clears,copies\n";
+	for (const PassStats& pass : mPasses)
+	{
+		stream << CommandLog::GetListTypeName(pass.mListType) << "," << quote(pass.mName) << "," << pass.mDepth << ","
+			<< pass.mInstances << "," << pass.mCommands << "," << pass.mDraws << "," << pass.mDispatches << ","
+			<< pass.mBarrierCalls << "," << pass.mBarriers << "," << pass.mStateSets << "," << pass.mRedundantStateSets << ","
+			<< pass.mDescriptorCopies << "," << pass.mClears << "," << pass.mCopies << "\n";
+	}
+	return stream.str();
+}
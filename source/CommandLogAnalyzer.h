@@ -0,0 +1,79 @@
+#pragma once
+
+#include "CommandLog.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Replays a command log and counts what every pass records: draws, dispatches, barriers, descriptor copies
+// and state changes. Each list tracks the state it has set since its last reset, a state change that sets
+// the value already there is redundant. A new root signature drops the root arguments of its bind point,
+// bundles drop the state they are allowed to set and ClearState drops everything, since what they leave
+// behind is not in the log.
+// Commands count toward the innermost pass only; commands outside of any pass go to "(no pass)".
+// Only uses the standard library.
+class CommandLogAnalyzer
+{
+public:
+    struct PassStats
+    {
+        std::string mName;              // nested passes are joined with '/'
+        uint32_t mListType = 0;
+        uint32_t mDepth = 0;
+        uint64_t mInstances = 0;        // times the pass was recorded
+        uint64_t mCommands = 0;
+        uint64_t mDraws = 0;
+        uint64_t mDispatches = 0;
+        uint64_t mBarrierCalls = 0;
+        uint64_t mBarriers = 0;         // transitions, aliasing and UAV barriers of those calls
+        uint64_t mStateSets = 0;
+        uint64_t mRedundantStateSets = 0;
+        uint64_t mDescriptorCopies = 0;
+        uint64_t mClears = 0;
+        uint64_t mCopies = 0;
+    };
+
+    struct OpStats
+    {
+        uint64_t mCount = 0;
+        uint64_t mRedundant = 0;
+    };
+
+    void Analyze(const std::vector<CommandLog::Command>& commands);
+
+    // In the order they were first recorded
+    const std::vector<PassStats>& GetPasses() const { return mPasses; }
+    const OpStats& GetOpStats(CommandLog::Op op) const { return mOps[op < CommandLog::OP_COUNT ? op : 0]; }
+    uint64_t GetFrameCount() const { return mFrameCount; }
+    uint64_t GetCommandCount() const { return mCommandCount; }
+    // EndPass without BeginPass, and passes still open at the end of a frame
+    uint64_t GetUnbalancedPassCount() const { return mUnbalancedPasses; }
+
+    // Totals over all frames, passes then redundant state changes per call
+    std::string FormatReport() const;
+    // queue,pass,depth,instances,commands,draws,dispatches,barrier_calls,barriers,state_sets,
+    // redundant_state_sets,descriptor_copies,clears,copies
+    std::string ExportCSV() const;
+
+    static bool IsStateOp(CommandLog::Op op);
+
+private:
+    struct ListState
+    {
+        std::map<uint64_t, std::vector<uint64_t>> mState;
+        std::vector<size_t> mPasses;    // open passes, innermost last
+    };
+
+    size_t GetPass(const std::string& name, uint32_t listType, uint32_t depth);
+    // Returns true if the command set a value that was already there
+    bool ApplyState(ListState& list, const CommandLog::Command& command);
+
+    std::vector<PassStats> mPasses;
+    std::map<std::pair<uint32_t, std::string>, size_t> mPassIndices;
+    OpStats mOps[CommandLog::OP_COUNT];
+    uint64_t mFrameCount = 0;
+    uint64_t mCommandCount = 0;
+    uint64_t mUnbalancedPasses = 0;
+};
@@ -21,6 +21,8 @@
 #include <system_error>
 #include <cmath>
 
+#include "Sampling.h"
+
 #include "Audio.h"
 #include "CommonStates.h"
 #include "DirectXHelpers.h"
@@ -61,11 +63,10 @@ inline void ThrowIfFailed(HRESULT hr)
     }
 }
 
+// PCG32 per thread instead of rand(): no shared state, 24 bits, and the same sequence on every run
 inline float RandomFloat(float a, float b) {
-	float random = ((float)rand()) / (float)RAND_MAX;
-	float diff = b - a;
-	float r = random * diff;
-	return a + r;
+	static thread_local PCG32 random;
+	return random.NextFloat(a, b);
 }
 
 inline float Lerp(float a, float b, float f)
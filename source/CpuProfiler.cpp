@@ -0,0 +1,298 @@
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+namespace
+{
+	std::atomic<uint64_t> gNextProfilerId{ 1 };
+
+	// the buffer of the calling thread for the profiler that last recorded on it
+	struct ThreadCache
+	{
+		uint64_t mProfilerId = 0;
+		void* mBuffer = nullptr;
+	};
+	thread_local ThreadCache tThreadCache;
+
+	int64_t GetSteadyNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	uint32_t RoundUpToPowerOfTwo(uint32_t value)
+	{
+		uint32_t result = 1;
+		while (result < value && result < (1u << 31))
+			result <<= 1;
+		return result;
+	}
+}
+
+CpuProfiler::Scope::Scope(CpuProfiler& profiler, const char* name)
+	: mProfiler(profiler)
+	, mBuffer(nullptr)
+	, mName(name)
+	, mBeginNs(0)
+	, mActive(profiler.IsEnabled())
+{
+	if (mActive)
+	{
+		mBuffer = mProfiler.GetThreadBuffer();
+		mBuffer->mDepth++;
+		mBeginNs = mProfiler.GetTimeNs();
+	}
+}
+
+CpuProfiler::Scope::~Scope()
+{
+	if (mActive)
+	{
+		uint64_t endNs = mProfiler.GetTimeNs();
+		mBuffer->mDepth--;
+		mProfiler.Record(mBuffer, mName, mBeginNs, endNs);
+	}
+}
+
+CpuProfiler::CpuProfiler(uint32_t eventsPerThread)
+	: mId(gNextProfilerId.fetch_add(1))
+	, mCapacity(RoundUpToPowerOfTwo(std::max(eventsPerThread, 2u)))
+	, mStartNs(GetSteadyNs())
+{
+}
+
+CpuProfiler::~CpuProfiler()
+{
+}
+
+CpuProfiler& CpuProfiler::Get()
+{
+	static CpuProfiler profiler;
+	return profiler;
+}
+
+uint64_t CpuProfiler::GetTimeNs() const
+{
+	return static_cast<uint64_t>(GetSteadyNs() - mStartNs);
+}
+
+CpuProfiler::ThreadBuffer* CpuProfiler::GetThreadBuffer()
+{
+	if (tThreadCache.mProfilerId == mId)
+		return static_cast<ThreadBuffer*>(tThreadCache.mBuffer);
+
+	// first scope of the thread on this profiler (or the thread alternates between profilers)
+	std::lock_guard<std::mutex> lock(mThreadsMutex);
+	ThreadBuffer* buffer = nullptr;
+	std::thread::id threadId = std::this_thread::get_id();
+	for (auto& thread : mThreads)
+	{
+		if (thread->mThreadId == threadId)
+			buffer = thread.get();
+	}
+
+	if (!buffer)
+	{
+		mThreads.push_back(std::make_unique<ThreadBuffer>(mCapacity));
+		buffer = mThreads.back().get();
+		buffer->mThreadId = threadId;
+		buffer->mIndex = static_cast<uint32_t>(mThreads.size() - 1);
+		buffer->mName = "Thread " + std::to_string(buffer->mIndex);
+	}
+
+	tThreadCache.mProfilerId = mId;
+	tThreadCache.mBuffer = buffer;
+	return buffer;
+}
+
+void CpuProfiler::Record(ThreadBuffer* buffer, const char* name, uint64_t beginNs, uint64_t endNs)
+{
+	uint64_t head = buffer->mHead.load(std::memory_order_relaxed);
+	Slot& slot = buffer->mSlots[head & (mCapacity - 1)];
+	// a reader that sees any of the slot stores below also sees that the slot is being written
+	buffer->mWriteHead.store(head + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.mName.store(name, std::memory_order_relaxed);
+	slot.mBeginNs.store(beginNs, std::memory_order_relaxed);
+	slot.mEndNs.store(endNs, std::memory_order_relaxed);
+	slot.mDepth.store(buffer->mDepth, std::memory_order_relaxed);
+	buffer->mHead.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::BeginScope(const char* name)
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+	uint32_t index = buffer->mOpenScopeCount++;
+	if (index >= MAX_OPEN_SCOPES)
+		return;
+
+	// pushed even when disabled, so the matching EndScope pops the right entry
+	OpenScope& scope = buffer->mOpenScopes[index];
+	scope.mName = name;
+	scope.mActive = IsEnabled();
+	if (scope.mActive)
+	{
+		buffer->mDepth++;
+		scope.mBeginNs = GetTimeNs();
+	}
+}
+
+void CpuProfiler::EndScope()
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+	if (buffer->mOpenScopeCount == 0)
+		return;
+
+	uint32_t index = --buffer->mOpenScopeCount;
+	if (index >= MAX_OPEN_SCOPES || !buffer->mOpenScopes[index].mActive)
+		return;
+
+	uint64_t endNs = GetTimeNs();
+	buffer->mDepth--;
+	Record(buffer, buffer->mOpenScopes[index].mName, buffer->mOpenScopes[index].mBeginNs, endNs);
+}
+
+void CpuProfiler::SetThreadName(const std::string& name)
+{
+	ThreadBuffer* buffer = GetThreadBuffer();
+	std::lock_guard<std::mutex> lock(mThreadsMutex);
+	buffer->mName = name;
+}
+
+std::vector<CpuProfiler::ThreadCapture> CpuProfiler::Capture() const
+{
+	std::lock_guard<std::mutex> lock(mThreadsMutex);
+
+	std::vector<ThreadCapture> capture;
+	for (auto& thread : mThreads)
+	{
+		ThreadCapture threadCapture;
+		threadCapture.mThreadIndex = thread->mIndex;
+		threadCapture.mThreadName = thread->mName;
+
+		uint64_t head = thread->mHead.load(std::memory_order_acquire);
+		uint64_t readStart = thread->mReadStart.load(std::memory_order_relaxed);
+		uint64_t first = std::max(readStart, head > mCapacity ? head - mCapacity : 0);
+
+		std::vector<Event> events;
+		events.reserve(static_cast<size_t>(head - first));
+		for (uint64_t i = first; i < head; i++)
+		{
+			const Slot& slot = thread->mSlots[i & (mCapacity - 1)];
+			Event event;
+			event.mName = slot.mName.load(std::memory_order_relaxed);
+			event.mBeginNs = slot.mBeginNs.load(std::memory_order_relaxed);
+			event.mEndNs = slot.mEndNs.load(std::memory_order_relaxed);
+			event.mDepth = slot.mDepth.load(std::memory_order_relaxed);
+			events.push_back(event);
+		}
+
+		// the owner kept writing while we copied, everything it may have reached is unreliable, including the
+		// slot of an event it has not published yet
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t headAfter = thread->mWriteHead.load(std::memory_order_relaxed);
+		uint64_t valid = headAfter > mCapacity ? headAfter - mCapacity : 0;
+		size_t skip = valid > first ? static_cast<size_t>(std::min(valid - first, head - first)) : 0;
+		threadCapture.mEvents.assign(events.begin() + skip, events.end());
+		threadCapture.mDroppedCount = (first - readStart) + skip;
+
+		capture.push_back(std::move(threadCapture));
+	}
+	return capture;
+}
+
+void CpuProfiler::Clear()
+{
+	std::lock_guard<std::mutex> lock(mThreadsMutex);
+	for (auto& thread : mThreads)
+		thread->mReadStart.store(thread->mHead.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+std::vector<CpuProfiler::ScopeSummary> CpuProfiler::Summarize(const std::vector<ThreadCapture>& capture)
+{
+	// scopes are keyed by name, the same name on several threads is one row
+	std::map<std::string, std::vector<uint64_t>> durations;
+	for (auto& thread : capture)
+	{
+		for (auto& event : thread.mEvents)
+			durations[event.mName ? event.mName : ""].push_back(event.mEndNs - event.mBeginNs);
+	}
+
+	auto percentile = [](const std::vector<uint64_t>& sorted, double p) {
+		// nearest rank
+		size_t rank = static_cast<size_t>(p * double(sorted.size()) + 0.999999);
+		rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+		return double(sorted[rank - 1]) * 1e-6;
+	};
+
+	std::vector<ScopeSummary> summaries;
+	for (auto& entry : durations)
+	{
+		std::vector<uint64_t>& samples = entry.second;
+		std::sort(samples.begin(), samples.end());
+
+		ScopeSummary summary;
+		summary.mName = entry.first;
+		summary.mCount = samples.size();
+		for (uint64_t sample : samples)
+			summary.mTotalMs += double(sample) * 1e-6;
+		summary.mMeanMs = summary.mTotalMs / double(samples.size());
+		summary.mP50Ms = percentile(samples, 0.50);
+		summary.mP90Ms = percentile(samples, 0.90);
+		summary.mP99Ms = percentile(samples, 0.99);
+		summary.mMaxMs = double(samples.back()) * 1e-6;
+		summaries.push_back(summary);
+	}
+
+	std::sort(summaries.begin(), summaries.end(), [](const ScopeSummary& a, const ScopeSummary& b) { return a.mTotalMs > b.mTotalMs; });
+	return summaries;
+}
+
+std::string CpuProfiler::ExportChromeTrace(const std::vector<ThreadCapture>& capture)
+{
+	auto escape = [](const std::string& text) {
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	};
+
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(3);
+	stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+	bool first = true;
+	for (auto& thread : capture)
+	{
+		stream << (first ? "\n" : ",\n");
+		stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread.mThreadIndex
+			<< ",\"args\":{\"name\":\"" << escape(thread.mThreadName) << "\"}}";
+		first = false;
+
+		// complete events, timestamps and durations in microseconds
+		for (auto& event : thread.mEvents)
+		{
+			stream << ",\n{\"name\":\"" << escape(event.mName ? event.mName : "") << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.mThreadIndex
+				<< ",\"ts\":" << double(event.mBeginNs) * 1e-3 << ",\"dur\":" << double(event.mEndNs - event.mBeginNs) * 1e-3 << "}";
+		}
+	}
+	stream << "\n]}\n";
+	return stream.str();
+}
+
+bool CpuProfiler::WriteChromeTrace(const std::filesystem::path& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	file << ExportChromeTrace(Capture());
+	return bool(file);
+}
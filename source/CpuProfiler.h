@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CPU_PROFILE_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing block; name has to be a string literal (or live as long as the profiler)
+#define CPU_PROFILE_SCOPE(name) CpuProfiler::Scope CPU_PROFILE_CONCAT(cpuProfileScope, __LINE__)(CpuProfiler::Get(), name)
+
+// Hierarchical CPU timings from scoped markers.
+// Every thread that records gets its own ring of the most recent scopes, written without locks or allocations:
+// a scope stores its name pointer, nanosecond begin/end and nesting depth when it ends, then publishes the
+// slot by advancing the ring's head. Readers copy the rings at any time and drop the slots that were
+// overwritten while they copied. The first scope of a thread registers its ring under a mutex.
+// Captures are exported as Chrome trace JSON (chrome://tracing, ui.perfetto.dev) or summarized per scope.
+// Only uses the standard library.
+class CpuProfiler
+{
+    struct ThreadBuffer;
+
+public:
+    static constexpr uint32_t DEFAULT_EVENTS_PER_THREAD = 16384;
+    // Nesting limit of BeginScope/EndScope pairs per thread, deeper ones are not recorded
+    static constexpr uint32_t MAX_OPEN_SCOPES = 64;
+
+    struct Event
+    {
+        const char* mName = nullptr;
+        uint64_t mBeginNs = 0;      // since the profiler was created
+        uint64_t mEndNs = 0;
+        uint32_t mDepth = 0;
+    };
+
+    struct ThreadCapture
+    {
+        uint32_t mThreadIndex = 0;  // in registration order
+        std::string mThreadName;
+        std::vector<Event> mEvents; // oldest first, a parent ends (and is stored) after its children
+        uint64_t mDroppedCount = 0; // scopes lost to ring wrap-around since the last Clear
+    };
+
+    struct ScopeSummary
+    {
+        std::string mName;
+        uint64_t mCount = 0;
+        double mTotalMs = 0.0;
+        double mMeanMs = 0.0;
+        double mP50Ms = 0.0;
+        double mP90Ms = 0.0;
+        double mP99Ms = 0.0;
+        double mMaxMs = 0.0;
+    };
+
+    class Scope
+    {
+    public:
+        Scope(CpuProfiler& profiler, const char* name);
+        ~Scope();
+
+    private:
+        CpuProfiler& mProfiler;
+        ThreadBuffer* mBuffer;
+        const char* mName;
+        uint64_t mBeginNs;
+        bool mActive;
+    };
+
+    // eventsPerThread is rounded up to a power of two
+    explicit CpuProfiler(uint32_t eventsPerThread = DEFAULT_EVENTS_PER_THREAD);
+    ~CpuProfiler();
+
+    // Instance used by CPU_PROFILE_SCOPE
+    static CpuProfiler& Get();
+
+    // Disabled scopes cost one relaxed load
+    void SetEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+    bool IsEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+
+    // For scopes that do not follow a C++ block (e.g. begin/end event pairs), EndScope closes the innermost one
+    void BeginScope(const char* name);
+    void EndScope();
+
+    // Name of the calling thread in captures and traces
+    void SetThreadName(const std::string& name);
+    uint64_t GetTimeNs() const;
+
+    // Copies the events recorded since the last Clear, safe while other threads keep recording
+    std::vector<ThreadCapture> Capture() const;
+    // Forgets the recorded events; scopes that are open keep going
+    void Clear();
+
+    // Sorted by total time, longest first
+    static std::vector<ScopeSummary> Summarize(const std::vector<ThreadCapture>& capture);
+    static std::string ExportChromeTrace(const std::vector<ThreadCapture>& capture);
+    bool WriteChromeTrace(const std::filesystem::path& path) const;
+
+private:
+    struct Slot
+    {
+        // relaxed atomics: a reader may look at a slot while its owner overwrites it, the head check discards it
+        std::atomic<const char*> mName{ nullptr };
+        std::atomic<uint64_t> mBeginNs{ 0 };
+        std::atomic<uint64_t> mEndNs{ 0 };
+        std::atomic<uint32_t> mDepth{ 0 };
+    };
+
+    struct OpenScope
+    {
+        const char* mName = nullptr;
+        uint64_t mBeginNs = 0;
+        bool mActive = false;
+    };
+
+    struct ThreadBuffer
+    {
+        explicit ThreadBuffer(uint32_t capacity) : mSlots(new Slot[capacity]) {}
+
+        std::unique_ptr<Slot[]> mSlots;
+        std::atomic<uint64_t> mHead{ 0 };       // slots written so far, only the owner writes it
+        std::atomic<uint64_t> mWriteHead{ 0 };  // mHead + 1 while the owner writes a slot, else mHead
+        std::atomic<uint64_t> mReadStart{ 0 };  // first slot after the last Clear
+        uint32_t mDepth = 0;                    // open scopes, owner only
+        OpenScope mOpenScopes[MAX_OPEN_SCOPES]; // BeginScope stack, owner only
+        uint32_t mOpenScopeCount = 0;
+        uint32_t mIndex = 0;
+        std::thread::id mThreadId;
+        std::string mName;
+    };
+
+    ThreadBuffer* GetThreadBuffer();
+    void Record(ThreadBuffer* buffer, const char* name, uint64_t beginNs, uint64_t endNs);
+
+    const uint64_t mId;                         // tells instances apart in the thread-local cache
+    const uint32_t mCapacity;
+    const int64_t mStartNs;
+    std::atomic<bool> mEnabled{ true };
+
+    mutable std::mutex mThreadsMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> mThreads;
+};
@@ -3,6 +3,7 @@
 #include "Common.h"
 
 #include <Dbt.h>
+#include <shellapi.h>
 
 using namespace DirectX;
 
@@ -36,6 +37,18 @@ int WINAPI wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance,
     //gSample = std::make_unique<DXRSExampleRTScene>();
     gSample = std::make_unique<DXRSExampleGIScene>();
 
+    // -benchmark <scenario> runs the scenario (relative paths start at the repository root) and quits
+    {
+        int argc = 0;
+        LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+        for (int i = 1; argv && i + 1 < argc; i++)
+        {
+            if (_wcsicmp(argv[i], L"-benchmark") == 0)
+                gSample->SetBenchmarkScenario(argv[++i]);
+        }
+        LocalFree(argv);
+    }
+
     // Register class and create window
     {
         // Register class
@@ -52,6 +52,7 @@ public:
 
 	DXRS::DescriptorHandle& GetSRV() { return mDescriptorSRV; }
 	DXRS::DescriptorHandle& GetCBV() { return mDescriptorCBV; }
+	D3D12_GPU_VIRTUAL_ADDRESS GetGPUVirtualAddress() { return mBuffer->GetGPUVirtualAddress(); }
 
 	unsigned char* Map()
 	{
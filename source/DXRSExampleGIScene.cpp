@@ -1,17 +1,48 @@
 #include "DXRSExampleGIScene.h"
 
 #include "DescriptorHeap.h"
+#include "Hash.h"
+#include "RSMCapture.h"
 
 #include "imgui.h"
 #include "imgui_impl_win32.h"
 #include "imgui_impl_dx12.h"
 
+#include <DirectXPackedVector.h>
+#include <set>
+#include <thread>
+
 namespace {
 	D3D12_HEAP_PROPERTIES UploadHeapProps = { D3D12_HEAP_TYPE_UPLOAD, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 0, 0 };
 	D3D12_HEAP_PROPERTIES DefaultHeapProps = { D3D12_HEAP_TYPE_DEFAULT, D3D12_CPU_PAGE_PROPERTY_UNKNOWN, D3D12_MEMORY_POOL_UNKNOWN, 0, 0 };
 
 	static const float clearColorBlack[] = { 0.0f, 0.0f, 0.0f, 0.0f };
 	static const float clearColorWhite[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	struct QualityTier
+	{
+		int mRSMSamplesCount;
+		int mSSAOKernelSize;
+		int mVCTConesCount;
+		int mBlurTaps;
+	};
+	// Low, Medium, High - every value has to be part of the matching permutation space
+	static const QualityTier QualityTiers[] = {
+		{ 64, 4, 1, 5 },
+		{ 256, 8, 6, 7 },
+		{ RSM_MAX_SAMPLES_COUNT, SSAO_MAX_KERNEL, 6, 9 },
+	};
+
+	// Render target format of an LPVSHCodec encoding
+	DXGI_FORMAT GetLPVSHFormat(int encoding)
+	{
+		switch (encoding)
+		{
+		case LPVSHCodec::ENCODING_FLOAT16: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case LPVSHCodec::ENCODING_SNORM8_SCALED: return DXGI_FORMAT_R8G8B8A8_SNORM;
+		default: return DXGI_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
 }
 
 DXRSExampleGIScene::DXRSExampleGIScene()
@@ -23,6 +54,8 @@ DXRSExampleGIScene::~DXRSExampleGIScene()
 {
 	if (mSandboxFramework)
 		mSandboxFramework->WaitForGpu();
+	// the cache is a member, PSOs finalized after the scene must not reach it
+	PSO::SetPipelineCache(nullptr);
 
 	delete mLightingCB;
 	delete mLightsInfoCB;
@@ -38,6 +71,7 @@ void DXRSExampleGIScene::Init(HWND window, int width, int height)
 	mMouse = std::make_unique<DirectX::Mouse>();
 	mMouse->SetWindow(window);
 	mSandboxFramework->SetWindow(window, width, height);
+	CpuProfiler::Get().SetThreadName("Main");
 
 	mSandboxFramework->CreateResources();
 	mSandboxFramework->CreateFullscreenQuadBuffers();
@@ -102,7 +136,8 @@ void DXRSExampleGIScene::Init(HWND window, int width, int height)
 	desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
 	ThrowIfFailed(device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&mUIDescriptorHeap)));
-	ImGui_ImplDX12_Init(device, 3, DXGI_FORMAT_R8G8B8A8_UNORM, mUIDescriptorHeap.Get(), mUIDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mUIDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	// the backend cycles its vertex and index buffers per frame, one set for every frame the slider allows in flight
+	ImGui_ImplDX12_Init(device, DXRSGraphics::MAX_FRAMES_IN_FLIGHT, DXGI_FORMAT_R8G8B8A8_UNORM, mUIDescriptorHeap.Get(), mUIDescriptorHeap->GetCPUDescriptorHandleForHeapStart(), mUIDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
 
 #pragma endregion
 
@@ -231,15 +266,91 @@ void DXRSExampleGIScene::Init(HWND window, int width, int height)
 	ubData.Upsample = false;
 	memcpy(mDXRBlurBuffer->Map(), &ubData, sizeof(ubData));
 
-	InitGbuffer(device, descriptorManager);
-	InitShadowMapping(device, descriptorManager);
-	InitReflectiveShadowMapping(device, descriptorManager);
-	InitLightPropagationVolume(device, descriptorManager);
-	InitVoxelConeTracing(device, descriptorManager);
-	InitDXRPasses(device, descriptorHeapManager);
-	InitLighting(device, descriptorManager);
-	InitSSAO(device, descriptorManager);
-	InitComposite(device, descriptorManager);
+	// warm starts feed driver blobs from the previous run back into PSO creation
+	mPipelineCache.Load(mSandboxFramework->GetFilePath(L"cache\\pipelines.bin"));
+	PSO::SetPipelineCache(&mPipelineCache);
+
+	// sizes shared between C++ structures and HLSL, defined once in DXRSExampleGIScene.h
+	mSandboxFramework->SetGlobalShaderDefine("LPV_DIM", std::to_string(LPV_DIM));
+	mSandboxFramework->SetGlobalShaderDefine("LPV_CASCADES", std::to_string(LPV_CASCADES));
+	mSandboxFramework->SetGlobalShaderDefine("RSM_MAX_SAMPLES_COUNT", std::to_string(RSM_MAX_SAMPLES_COUNT));
+	mSandboxFramework->SetGlobalShaderDefine("SSAO_MAX_KERNEL", std::to_string(SSAO_MAX_KERNEL));
+
+	RegisterPSOShaders();
+
+	// Every shader used by the Init* passes is gathered up front and compiled on worker threads.
+	// The passes run on this thread once their shaders are in, in their original order (later passes
+	// copy PSOs and reuse resources of earlier ones); their CompileShader calls then hit the in-memory cache.
+	ShaderCompileQueue compileQueue;
+	std::set<std::string> queuedStages;
+	auto addPass = [&](const char* name, std::vector<ShaderCompileQueue::Handle> dependencies, std::function<void()> init) {
+		for (auto& pso : mPSOShaders)
+		{
+			if (strcmp(pso.mPass, name) != 0)
+				continue;
+
+			for (auto& stage : pso.mStages)
+			{
+				std::string stageName = std::filesystem::path(stage.mFile).filename().string() + ":" + stage.mEntryPoint;
+				if (!queuedStages.insert(stageName + ":" + std::to_string(stage.mExtraFlags)).second)
+					continue;
+
+				dependencies.push_back(compileQueue.AddCompile(stageName, [this, stage](std::string& error) {
+					ComPtr<ID3DBlob> code;
+					ComPtr<ID3DBlob> errors;
+					if (SUCCEEDED(CompileShaderStage(stage, &code, &errors)))
+						return true;
+					if (errors)
+						error = static_cast<const char*>(errors->GetBufferPointer());
+					return false;
+				}));
+			}
+		}
+		return compileQueue.AddContinuation(name, dependencies, init);
+	};
+
+	ShaderCompileQueue::Handle pass;
+	pass = addPass("Gbuffer", {}, [&]() { InitGbuffer(device, descriptorManager); });
+	pass = addPass("ShadowMapping", { pass }, [&]() { InitShadowMapping(device, descriptorManager); });
+	pass = addPass("ReflectiveShadowMapping", { pass }, [&]() { InitReflectiveShadowMapping(device, descriptorManager); });
+	pass = addPass("LightPropagationVolume", { pass }, [&]() { InitLightPropagationVolume(device, descriptorManager); });
+	pass = addPass("VoxelConeTracing", { pass }, [&]() { InitVoxelConeTracing(device, descriptorManager); });
+	pass = addPass("DXRPasses", { pass }, [&]() { InitDXRPasses(device, descriptorHeapManager); });
+	pass = addPass("Lighting", { pass }, [&]() { InitLighting(device, descriptorManager); });
+	pass = addPass("SSAO", { pass }, [&]() { InitSSAO(device, descriptorManager); });
+	pass = addPass("Composite", { pass }, [&]() { InitComposite(device, descriptorManager); });
+
+	// the passes of a failed shader are skipped, so nothing runs with missing bytecode
+	std::vector<std::string> errors = compileQueue.Run(mShaderCompileThreadCount);
+	OutputDebugStringA(compileQueue.GetStatsString().c_str());
+	mSandboxFramework->ReleaseCompiledShaders();
+	if (!errors.empty())
+	{
+		std::string message = "Startup shader compilation failed:";
+		for (auto& error : errors)
+			message += "\n" + error;
+		OutputDebugStringA((message + "\n").c_str());
+		throw std::runtime_error(message);
+	}
+
+	// hot reload watches every shader file and everything it includes
+	for (auto& pso : mPSOShaders)
+	{
+		for (auto& stage : pso.mStages)
+			mShaderDependencies.AddRoot(mSandboxFramework->GetFilePath(stage.mFile));
+	}
+	for (auto& file : mShaderDependencies.GetFiles())
+		mShaderWatcher.Watch(file);
+
+	if (mPipelineCache.IsDirty())
+		mPipelineCache.Save(mSandboxFramework->GetFilePath(L"cache\\pipelines.bin"));
+
+	char pipelineCacheStats[128];
+	sprintf_s(pipelineCacheStats, "Pipeline cache: %u hits, %u misses\n", mPipelineCache.mHits.load(), mPipelineCache.mMisses.load());
+	OutputDebugStringA(pipelineCacheStats);
+
+	if (!mBenchmarkScenarioPath.empty())
+		StartBenchmark();
 }
 
 void DXRSExampleGIScene::Clear(ID3D12GraphicsCommandList* cmdList)
@@ -259,30 +370,49 @@ void DXRSExampleGIScene::Clear(ID3D12GraphicsCommandList* cmdList)
 
 void DXRSExampleGIScene::Run()
 {
-	mTimer.Run([&]()
+	if (mBenchmark)
+	{
+		BeginBenchmarkFrame();
+		// one simulation step per rendered frame, however long the frame takes
+		mTimer.Step([&]()
+		{
+			Update(mTimer);
+		});
+	}
+	else
 	{
-		Update(mTimer);
-	});
+		mTimer.Run([&]()
+		{
+			Update(mTimer);
+		});
+	}
 
 	if (mUseAsyncCompute)
 		RenderAsync();
 	else
 		RenderSync();
+
+	if (mBenchmark)
+		EndBenchmarkFrame();
 }
 
 void DXRSExampleGIScene::RenderAsync()
 {
+	CPU_PROFILE_SCOPE("Record frame (async)");
+
 	if (mTimer.GetFrameCount() == 0)
 		return;
 
 	mSandboxFramework->Prepare(D3D12_RESOURCE_STATE_PRESENT, mUseAsyncCompute ? (mTimer.GetFrameCount() == 1) : true);
+	mPerDrawBinds = 0;
 
-	auto commandListGraphics = mSandboxFramework->GetCommandListGraphics(0);
-	auto commandListGraphics2 = mSandboxFramework->GetCommandListGraphics(1);
-	auto commandListCompute = mSandboxFramework->GetCommandListCompute();
+	// the recording wrappers while a command capture runs, the queues get the real lists
+	auto commandListGraphics = mSandboxFramework->RecordCommands(mSandboxFramework->GetCommandListGraphics(0));
+	auto commandListGraphics2 = mSandboxFramework->RecordCommands(mSandboxFramework->GetCommandListGraphics(1));
+	auto commandListCompute = mSandboxFramework->RecordCommands(mSandboxFramework->GetCommandListCompute());
 
-	ID3D12CommandList* ppCommandLists[] = { commandListGraphics };
-	ID3D12CommandList* ppCommandLists2[] = { commandListGraphics2 };
+	ID3D12CommandList* ppCommandLists[] = { mSandboxFramework->GetCommandListGraphics(0) };
+	ID3D12CommandList* ppCommandLists2[] = { mSandboxFramework->GetCommandListGraphics(1) };
 
 	Clear(commandListGraphics);
 
@@ -303,22 +433,29 @@ void DXRSExampleGIScene::RenderAsync()
 	// 																									//
 	//////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	//process compute command list - async during the frame (GI)
+	//process compute command list - async during the frame (GI), the passes are placed by ScheduleAsyncCompute
 	{
 		if (mTimer.GetFrameCount() > 1) {
 			commandListCompute->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
 
-			RenderReflectiveShadowMapping(device, commandListCompute, gpuDescriptorHeap, COMPUTE_QUEUE, true);
+			if (mRSMOnAsyncCompute)
+				RenderReflectiveShadowMapping(device, commandListCompute, gpuDescriptorHeap, COMPUTE_QUEUE, true);
 			//RenderLightPropagationVolume(device, commandListCompute, gpuDescriptorHeap); // nothing to do for compute queue in LPV...
-			RenderVoxelConeTracing(device, commandListCompute, gpuDescriptorHeap, COMPUTE_QUEUE, true);
+			if (mVCTOnAsyncCompute)
+				RenderVoxelConeTracing(device, commandListCompute, gpuDescriptorHeap, COMPUTE_QUEUE, true);
 
 			mSandboxFramework->ResourceBarriersBegin(mBarriers);
-			mRSMRT->TransitionTo(mBarriers, commandListCompute, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-			mRSMUpsampleAndBlurRT->TransitionTo(mBarriers, commandListCompute, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-			mVCTMainRT->TransitionTo(mBarriers, commandListCompute, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-			mVCTMainUpsampleAndBlurRT->TransitionTo(mBarriers, commandListCompute, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			if (mRSMOnAsyncCompute) {
+				mRSMRT->TransitionTo(mBarriers, commandListCompute, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+				mRSMUpsampleAndBlurRT->TransitionTo(mBarriers, commandListCompute, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			}
+			if (mVCTOnAsyncCompute) {
+				mVCTMainRT->TransitionTo(mBarriers, commandListCompute, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+				mVCTMainUpsampleAndBlurRT->TransitionTo(mBarriers, commandListCompute, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			}
 			mSandboxFramework->ResourceBarriersEnd(mBarriers, commandListCompute);
 
+			// waits for the next graphics fence #2 signal, after command list #1 or #2
 			mSandboxFramework->WaitForGraphicsFence2ToFinish(mSandboxFramework->GetCommandQueueCompute());
 			mSandboxFramework->PresentCompute(); //execute compute queue and signal graphics queue to continue its' execution
 		}
@@ -333,8 +470,11 @@ void DXRSExampleGIScene::RenderAsync()
 		commandListGraphics->RSSetViewports(1, &viewport);
 		commandListGraphics->RSSetScissorRects(1, &rect);
 
-		if (mTimer.GetFrameCount() > 1) {
-			PIXBeginEvent(commandListGraphics, 0, "Copy buffers for async");
+		// only the inputs that the compute queue reads from the previous frame are copied
+		bool copyRSMBuffers = mRSMOnAsyncCompute && mRSMAsyncPreviousFrame;
+		bool copyVCTVoxels = mVCTOnAsyncCompute && mVCTAsyncPreviousFrame;
+		if (mTimer.GetFrameCount() > 1 && (copyRSMBuffers || copyVCTVoxels)) {
+			mSandboxFramework->BeginGpuEvent(commandListGraphics, "Copy buffers for async");
 			{
 				auto stateRSMbuffer0 = mRSMBuffersRTs[0]->GetCurrentState();
 				auto stateRSMbuffer1 = mRSMBuffersRTs[1]->GetCurrentState();
@@ -342,33 +482,44 @@ void DXRSExampleGIScene::RenderAsync()
 				auto stateVCT3D = mVCTVoxelization3DRT->GetCurrentState();
 
 				mSandboxFramework->ResourceBarriersBegin(mBarriers);
-				mRSMBuffersRTs[0]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_SOURCE);
-				mRSMBuffersRTs[1]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_SOURCE);
-				mRSMBuffersRTs[2]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_SOURCE);
-				mRSMBuffersRTs_CopiesForAsync[0]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_DEST);
-				mRSMBuffersRTs_CopiesForAsync[1]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_DEST);
-				mRSMBuffersRTs_CopiesForAsync[2]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_DEST);
-				mVCTVoxelization3DRT->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_SOURCE);
-				mVCTVoxelization3DRT_CopyForAsync->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_DEST);
+				if (copyRSMBuffers) {
+					mRSMBuffersRTs[0]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_SOURCE);
+					mRSMBuffersRTs[1]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_SOURCE);
+					mRSMBuffersRTs[2]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_SOURCE);
+					mRSMBuffersRTs_CopiesForAsync[0]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_DEST);
+					mRSMBuffersRTs_CopiesForAsync[1]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_DEST);
+					mRSMBuffersRTs_CopiesForAsync[2]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_DEST);
+				}
+				if (copyVCTVoxels) {
+					mVCTVoxelization3DRT->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_SOURCE);
+					mVCTVoxelization3DRT_CopyForAsync->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COPY_DEST);
+				}
 				mSandboxFramework->ResourceBarriersEnd(mBarriers, commandListGraphics);
 
-				commandListGraphics->CopyResource(mRSMBuffersRTs_CopiesForAsync[0]->GetResource(), mRSMBuffersRTs[0]->GetResource());
-				commandListGraphics->CopyResource(mRSMBuffersRTs_CopiesForAsync[1]->GetResource(), mRSMBuffersRTs[1]->GetResource());
-				commandListGraphics->CopyResource(mRSMBuffersRTs_CopiesForAsync[2]->GetResource(), mRSMBuffersRTs[2]->GetResource());
-				commandListGraphics->CopyResource(mVCTVoxelization3DRT_CopyForAsync->GetResource(), mVCTVoxelization3DRT->GetResource());
+				if (copyRSMBuffers) {
+					commandListGraphics->CopyResource(mRSMBuffersRTs_CopiesForAsync[0]->GetResource(), mRSMBuffersRTs[0]->GetResource());
+					commandListGraphics->CopyResource(mRSMBuffersRTs_CopiesForAsync[1]->GetResource(), mRSMBuffersRTs[1]->GetResource());
+					commandListGraphics->CopyResource(mRSMBuffersRTs_CopiesForAsync[2]->GetResource(), mRSMBuffersRTs[2]->GetResource());
+				}
+				if (copyVCTVoxels)
+					commandListGraphics->CopyResource(mVCTVoxelization3DRT_CopyForAsync->GetResource(), mVCTVoxelization3DRT->GetResource());
 
 				mSandboxFramework->ResourceBarriersBegin(mBarriers);
-				mRSMBuffersRTs[0]->TransitionTo(mBarriers, commandListGraphics, stateRSMbuffer0);
-				mRSMBuffersRTs[1]->TransitionTo(mBarriers, commandListGraphics, stateRSMbuffer1);
-				mRSMBuffersRTs[2]->TransitionTo(mBarriers, commandListGraphics, stateRSMbuffer2);
-				mVCTVoxelization3DRT->TransitionTo(mBarriers, commandListGraphics, stateVCT3D);
-				mRSMBuffersRTs_CopiesForAsync[0]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				mRSMBuffersRTs_CopiesForAsync[1]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				mRSMBuffersRTs_CopiesForAsync[2]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				mVCTVoxelization3DRT_CopyForAsync->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+				if (copyRSMBuffers) {
+					mRSMBuffersRTs[0]->TransitionTo(mBarriers, commandListGraphics, stateRSMbuffer0);
+					mRSMBuffersRTs[1]->TransitionTo(mBarriers, commandListGraphics, stateRSMbuffer1);
+					mRSMBuffersRTs[2]->TransitionTo(mBarriers, commandListGraphics, stateRSMbuffer2);
+					mRSMBuffersRTs_CopiesForAsync[0]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					mRSMBuffersRTs_CopiesForAsync[1]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					mRSMBuffersRTs_CopiesForAsync[2]->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+				}
+				if (copyVCTVoxels) {
+					mVCTVoxelization3DRT->TransitionTo(mBarriers, commandListGraphics, stateVCT3D);
+					mVCTVoxelization3DRT_CopyForAsync->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+				}
 				mSandboxFramework->ResourceBarriersEnd(mBarriers, commandListGraphics);
 			}
-			PIXEndEvent(commandListGraphics);
+			mSandboxFramework->EndGpuEvent(commandListGraphics);
 		}
 		RenderGbuffer(device, commandListGraphics, gpuDescriptorHeap);
 		if (mTimer.GetFrameCount() > 1) {
@@ -383,7 +534,8 @@ void DXRSExampleGIScene::RenderAsync()
 
 		commandListGraphics->Close();
 		mSandboxFramework->GetCommandQueueGraphics()->ExecuteCommandLists(1, ppCommandLists);
-		mSandboxFramework->SignalGraphicsFence2();
+		if (!mAsyncComputeWaitsForGraphics2)
+			mSandboxFramework->SignalGraphicsFence2();
 	}
 
 	//process graphics command list 2 - middle of the frame (Shadows, GI) 
@@ -395,7 +547,7 @@ void DXRSExampleGIScene::RenderAsync()
 			RenderShadowMapping(device, commandListGraphics2, gpuDescriptorHeap);
 
 			//copy depth-stencil to custom depth
-			PIXBeginEvent(commandListGraphics2, 0, "Copy Depth-Stencil to texture");
+			mSandboxFramework->BeginGpuEvent(commandListGraphics2, "Copy Depth-Stencil to texture");
 			{
 				D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(mSandboxFramework->GetDepthStencil(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_COPY_SOURCE);
 				commandListGraphics2->ResourceBarrier(1, &barrier);
@@ -403,17 +555,38 @@ void DXRSExampleGIScene::RenderAsync()
 				barrier = CD3DX12_RESOURCE_BARRIER::Transition(mSandboxFramework->GetDepthStencil(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE);
 				commandListGraphics2->ResourceBarrier(1, &barrier);
 			}
-			PIXEndEvent(commandListGraphics2);
+			mSandboxFramework->EndGpuEvent(commandListGraphics2);
 
 			RenderReflectiveShadowMapping(device, commandListGraphics2, gpuDescriptorHeap, GRAPHICS_QUEUE, true); //only rsm textures generation which cant go to compute
+			if (mRSMCaptureRequested)
+				CopyRSMCapture(commandListGraphics2);
 			RenderLightPropagationVolume(device, commandListGraphics2, gpuDescriptorHeap);
 			RenderVoxelConeTracing(device, commandListGraphics2, gpuDescriptorHeap, GRAPHICS_QUEUE, true);//only voxelization there which cant go to compute
 
+			// passes reading this frame's RSM buffers and voxels, either right here or on the compute queue
+			mSandboxFramework->ResourceBarriersBegin(mBarriers);
+			if (!mRSMAsyncPreviousFrame) {
+				mRSMBuffersRTs[0]->TransitionTo(mBarriers, commandListGraphics2, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+				mRSMBuffersRTs[1]->TransitionTo(mBarriers, commandListGraphics2, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+				mRSMBuffersRTs[2]->TransitionTo(mBarriers, commandListGraphics2, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			}
+			if (!mVCTAsyncPreviousFrame)
+				mVCTVoxelization3DRT->TransitionTo(mBarriers, commandListGraphics2, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			mSandboxFramework->ResourceBarriersEnd(mBarriers, commandListGraphics2);
+
+			// the compute parts the scheduler kept on the graphics queue
+			if (!mRSMOnAsyncCompute)
+				RenderReflectiveShadowMapping(device, commandListGraphics2, gpuDescriptorHeap, COMPUTE_QUEUE, true);
+			if (!mVCTOnAsyncCompute)
+				RenderVoxelConeTracing(device, commandListGraphics2, gpuDescriptorHeap, COMPUTE_QUEUE, true);
+
 			mSandboxFramework->WaitForGraphicsFence2ToFinish(mSandboxFramework->GetCommandQueueGraphics(), true);
 
 			commandListGraphics2->Close();
 			mSandboxFramework->GetCommandQueueGraphics()->ExecuteCommandLists(1, ppCommandLists2);
 		}
+		if (mAsyncComputeWaitsForGraphics2)
+			mSandboxFramework->SignalGraphicsFence2();
 	}
 
 	//process graphics command list 1 - end of the frame (Lighting, Composite, UI)
@@ -452,7 +625,7 @@ void DXRSExampleGIScene::RenderAsync()
 		RenderComposite(device, commandListGraphics, gpuDescriptorHeap);
 
 		//draw imgui 
-		PIXBeginEvent(commandListGraphics, 0, "ImGui");
+		mSandboxFramework->BeginGpuEvent(commandListGraphics, "ImGui");
 		{
 			D3D12_CPU_DESCRIPTOR_HANDLE rtvHandlesFinal[] =
 			{
@@ -466,7 +639,7 @@ void DXRSExampleGIScene::RenderAsync()
 			ImGui::Render();
 			ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), commandListGraphics);
 		}
-		PIXEndEvent(commandListGraphics);
+		mSandboxFramework->EndGpuEvent(commandListGraphics);
 
 		mSandboxFramework->ResourceBarriersBegin(mBarriers);
 		mRSMRT->TransitionTo(mBarriers, commandListGraphics, D3D12_RESOURCE_STATE_COMMON);
@@ -483,13 +656,16 @@ void DXRSExampleGIScene::RenderAsync()
 
 void DXRSExampleGIScene::RenderSync()
 {
+	CPU_PROFILE_SCOPE("Record frame");
+
 	if (mTimer.GetFrameCount() == 0)
 		return;
 
 	// Prepare the command list to render a new frame.
 	mSandboxFramework->Prepare(D3D12_RESOURCE_STATE_PRESENT, true);
+	mPerDrawBinds = 0;
 
-	auto commandListGraphics = mSandboxFramework->GetCommandListGraphics();
+	auto commandListGraphics = mSandboxFramework->RecordCommands(mSandboxFramework->GetCommandListGraphics());
 
 	Clear(commandListGraphics);
 
@@ -511,7 +687,7 @@ void DXRSExampleGIScene::RenderSync()
 	RenderShadowMapping(device, commandListGraphics, gpuDescriptorHeap);
 
 	//copy depth-stencil to custom depth
-	PIXBeginEvent(commandListGraphics, 0, "Copy Depth-Stencil to texture");
+	mSandboxFramework->BeginGpuEvent(commandListGraphics, "Copy Depth-Stencil to texture");
 	{
 		D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(mSandboxFramework->GetDepthStencil(), D3D12_RESOURCE_STATE_DEPTH_WRITE, D3D12_RESOURCE_STATE_COPY_SOURCE);
 		commandListGraphics->ResourceBarrier(1, &barrier);
@@ -519,9 +695,11 @@ void DXRSExampleGIScene::RenderSync()
 		barrier = CD3DX12_RESOURCE_BARRIER::Transition(mSandboxFramework->GetDepthStencil(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE);
 		commandListGraphics->ResourceBarrier(1, &barrier);
 	}
-	PIXEndEvent(commandListGraphics);
+	mSandboxFramework->EndGpuEvent(commandListGraphics);
 
 	RenderReflectiveShadowMapping(device, commandListGraphics, gpuDescriptorHeap);
+	if (mRSMCaptureRequested)
+		CopyRSMCapture(commandListGraphics);
 	RenderLightPropagationVolume(device, commandListGraphics, gpuDescriptorHeap);
 	RenderVoxelConeTracing(device, commandListGraphics, gpuDescriptorHeap);
 	RenderSSAO(device, commandListGraphics, gpuDescriptorHeap);
@@ -552,7 +730,7 @@ void DXRSExampleGIScene::RenderSync()
 	RenderComposite(device, commandListGraphics, gpuDescriptorHeap);
 
 	//draw imgui 
-	PIXBeginEvent(commandListGraphics, 0, "ImGui");
+	mSandboxFramework->BeginGpuEvent(commandListGraphics, "ImGui");
 	{
 		ID3D12DescriptorHeap* ppHeaps[] = { mUIDescriptorHeap.Get() };
 		commandListGraphics->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
@@ -560,7 +738,7 @@ void DXRSExampleGIScene::RenderSync()
 		ImGui::Render();
 		ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), commandListGraphics);
 	}
-	PIXEndEvent(commandListGraphics);
+	mSandboxFramework->EndGpuEvent(commandListGraphics);
 
 	mSandboxFramework->Present();
 	mGraphicsMemory->Commit(mSandboxFramework->GetCommandQueueGraphics());
@@ -568,15 +746,48 @@ void DXRSExampleGIScene::RenderSync()
 
 void DXRSExampleGIScene::Update(DXRSTimer const& timer)
 {
+	CPU_PROFILE_SCOPE("Update");
+
+	// tier changes from the UI and shader edits are applied at the frame boundary
+	if (mQualityTier != mAppliedQualityTier)
+		ApplyQualityTier(mQualityTier);
+	if (mLPVSHEncoding != mAppliedLPVSHEncoding)
+		ApplyLPVSHEncoding(mLPVSHEncoding);
+	if (mPerDrawData != mAppliedPerDrawData)
+		ApplyPerDrawData(mPerDrawData);
+	if (mFramesInFlight != static_cast<int>(mSandboxFramework->GetFramesInFlight()))
+		mSandboxFramework->SetFramesInFlight(mFramesInFlight);
+	if (mRSMCapturePending)
+		WriteRSMCapture();
+	// the pass costs follow the GI toggles, rescheduling is a handful of evaluations of a 9 pass graph
+	if (mUseAsyncCompute)
+		ScheduleAsyncCompute();
+
+	if (mUseShaderHotReload)
+	{
+		mShaderHotReloadPollTime -= static_cast<float>(timer.GetElapsedSeconds());
+		if (mShaderHotReloadPollTime <= 0.0f)
+		{
+			mShaderHotReloadPollTime = 0.5f;
+			std::vector<std::filesystem::path> changedFiles = mShaderWatcher.Poll();
+			if (!changedFiles.empty())
+				ReloadShaders(changedFiles);
+		}
+	}
+
 	UpdateCamera(timer);
 	UpdateLights(timer);
 	UpdateBuffers(timer);
 	UpdateImGui();
 	UpdateTransforms(timer);
+	UpdateLPVGeometryVolume();
+	UpdateLPVPropagationSchedule();
 }
 
 void DXRSExampleGIScene::UpdateTransforms(DXRSTimer const& timer) 
 {
+	CPU_PROFILE_SCOPE("UpdateTransforms");
+
 	if (mUseDynamicObjects && !mStopDynamicObjects) {
 		for (auto& model : mRenderableObjects) {
 			if (model->GetIsDynamic())
@@ -594,8 +805,12 @@ void DXRSExampleGIScene::UpdateTransforms(DXRSTimer const& timer)
 
 void DXRSExampleGIScene::UpdateBuffers(DXRSTimer const& timer)
 {
+	CPU_PROFILE_SCOPE("UpdateBuffers");
+
 	float width = mSandboxFramework->GetOutputSize().right;
 	float height = mSandboxFramework->GetOutputSize().bottom;
+	mSampleFrame++;
+
 	GBufferCBData gbufferPassData;
 	gbufferPassData.ViewProjection = mCameraView * mCameraProjection;
 	gbufferPassData.InvViewProjection = XMMatrixInverse(nullptr, gbufferPassData.ViewProjection);
@@ -652,6 +867,10 @@ void DXRSExampleGIScene::UpdateBuffers(DXRSTimer const& timer)
 	rsmPassData.RSMIntensity = mRSMIntensity;
 	rsmPassData.RSMRMax = mRSMRMax;
 	rsmPassData.UpsampleRatio = XMFLOAT2(mGbufferRTs[0]->GetWidth() / mRSMRT->GetWidth(), mGbufferRTs[0]->GetHeight() / mRSMRT->GetHeight());
+	if (mRSMRotateSamples)
+		Sampling::GetFrameRotation(mSampleFrame, &rsmPassData.SampleRotation.x);
+	rsmPassData.InterleaveSize = UINT(mRSMInterleaveSize);
+	rsmPassData.InterleaveFrame = mRSMTemporalAccumulation ? mSampleFrame : 0;
 	memcpy(mRSMCB->Map(), &rsmPassData, sizeof(rsmPassData));
 
 	RSMCBDataDownsample rsmDownsamplePassData = {};
@@ -659,11 +878,36 @@ void DXRSExampleGIScene::UpdateBuffers(DXRSTimer const& timer)
 	rsmDownsamplePassData.ScaleSize = mRSMDownsampleScaleSize;
 	memcpy(mRSMDownsampleCB->Map(), &rsmDownsamplePassData, sizeof(rsmDownsamplePassData));
 
+	if (mLPVCascades.GetCascadeCount() != uint32_t(mLPVCascadeCount) || mLPVCascades.GetCascade(0).mCellSize != mLPVCascadeCellSize)
+		mLPVCascades = LPVCascades(mLPVCascadeCount, LPV_DIM, mLPVCascadeCellSize);
+	mLPVCascades.SetMargin(mLPVCascadeMargin);
+	mLPVCascades.SetBlend(mLPVCascadeBlend);
+	mLPVCascades.SetInjectCoarser(mLPVInjectCoarser);
+	float lpvCenter[3] = { 0.0f, 0.0f, 0.0f };
+	if (mLPVCascadesFollowCamera)
+	{
+		lpvCenter[0] = mCameraEye.x;
+		lpvCenter[1] = mCameraEye.y;
+		lpvCenter[2] = mCameraEye.z;
+	}
+	mLPVCascades.Update(lpvCenter);
+
 	LPVCBData lpvData = {};
 	lpvData.worldToLPV = mWorldToLPV;
 	lpvData.LPVCutoff = mLPVCutoff;
 	lpvData.LPVPower = mLPVPower;
 	lpvData.LPVAttenuation = mLPVAttenuation;
+	lpvData.LPVCascadeCount = int(mLPVCascades.GetCascadeCount());
+	for (uint32_t cascade = 0; cascade < mLPVCascades.GetCascadeCount(); cascade++)
+	{
+		float scale, offset[3];
+		mLPVCascades.GetCellTransform(cascade, scale, offset);
+		lpvData.LPVCascadeTransforms[cascade] = XMFLOAT4(offset[0], offset[1], offset[2], scale);
+	}
+	lpvData.LPVCascadeMargin = mLPVCascades.GetMargin();
+	lpvData.LPVCascadeBlend = mLPVCascades.GetBlend();
+	lpvData.LPVInjectCoarser = mLPVInjectCoarser ? 1 : 0;
+	lpvData.LPVStorageScale = mAppliedLPVSHEncoding == LPVSHCodec::ENCODING_SNORM8_SCALED ? std::max(mLPVStorageRange, 1e-3f) : 1.0f;
 	memcpy(mLPVCB->Map(), &lpvData, sizeof(lpvData));
 
 	VCTVoxelizationCBData voxelData = {};
@@ -692,7 +936,7 @@ void DXRSExampleGIScene::UpdateBuffers(DXRSTimer const& timer)
 	ssaoData.InvProjection = XMMatrixInverse(nullptr, mCameraProjection);
 	for (int i = 0; i < SSAO_MAX_KERNEL; i++)
 		ssaoData.KernelOffsets[i] = mSSAOKernelOffsets[i];
-	ssaoData.Radius_Power_NoiseScale = XMFLOAT4(mSSAORadius, mSSAOPower, mSSAORT->GetWidth() / 8.0f, mSSAORT->GetHeight() / 8.0f);
+	ssaoData.Radius_Power_NoiseScale = XMFLOAT4(mSSAORadius, mSSAOPower, mSSAORT->GetWidth() / float(SSAO_NOISE_SIZE), mSSAORT->GetHeight() / float(SSAO_NOISE_SIZE));
 	ssaoData.ScreenSize = { width, height, 1.0f / width, 1.0f / height };
 	memcpy(mSSAOCB->Map(), &ssaoData, sizeof(ssaoData));
 
@@ -706,11 +950,14 @@ void DXRSExampleGIScene::UpdateBuffers(DXRSTimer const& timer)
 	dxrData.ScreenResolution = XMFLOAT2(width, height);
 	dxrData.RTAORadiusPower = XMFLOAT2(mDXRAORadius, mDXRAOPower);
 	dxrData.FrameIndex = mSandboxFramework->GetCurrentFrameIndex();
+	Sampling::GetFrameRotation(mSampleFrame, &dxrData.SampleRotation.x);
 	memcpy(mDXRCB->Map(), &dxrData, sizeof(dxrData));
 }
 
 void DXRSExampleGIScene::UpdateImGui()
 {
+	CPU_PROFILE_SCOPE("UpdateImGui");
+
 	//capture mouse clicks
 	ImGui::GetIO().MouseDown[0] = (GetKeyState(VK_LBUTTON) & 0x8000) != 0;
 	ImGui::GetIO().MouseDown[1] = (GetKeyState(VK_RBUTTON) & 0x8000) != 0;
@@ -724,6 +971,9 @@ void DXRSExampleGIScene::UpdateImGui()
 		ImGui::Begin("DirectX GI Sandbox");
 		ImGui::TextColored(ImVec4(0.95f, 0.5f, 0.0f, 1), "FPS: (%.1f FPS), %.3f ms/frame", ImGui::GetIO().Framerate, 1000.0f / ImGui::GetIO().Framerate);
 		ImGui::Text("Camera pos: %f, %f, %f", mCameraEye.x, mCameraEye.y, mCameraEye.z);
+		if (mBenchmark && !mBenchmark->IsFinished())
+			ImGui::TextColored(ImVec4(0.95f, 0.5f, 0.0f, 1), "Benchmark run %u/%u: %s, frame %u", mBenchmark->GetRunIndex() + 1, mBenchmark->GetRunCount(),
+				mBenchmark->GetRun().mName.c_str(), mBenchmark->GetFrame());
 		ImGui::Checkbox("Lock camera", &mLockCamera);
 		mCamera->SetLock(mLockCamera);
 		if (mLockCamera) {
@@ -755,6 +1005,9 @@ void DXRSExampleGIScene::UpdateImGui()
 
 		ImGui::Separator();
 
+		ImGui::Combo("Quality", &mQualityTier, "Low\0Medium\0High\0");
+		ImGui::Separator();
+
 		ImGui::Checkbox("Direct Light", &mUseDirectLight);
 		ImGui::Checkbox("Direct Shadows", &mUseShadows);
 		ImGui::Separator();
@@ -780,6 +1033,38 @@ void DXRSExampleGIScene::UpdateImGui()
 				ImGui::Checkbox("Upsample & blur RSM result in CS", &mRSMUseUpsampleAndBlur);
 				ImGui::Separator();
 				ImGui::SliderFloat("RSM Rmax", &mRSMRMax, 0.0f, 1.0f);
+				ImGui::Checkbox("Rotate RSM samples per frame", &mRSMRotateSamples);
+				ImGui::Separator();
+				ImGui::Checkbox("Lightcuts gather (CS)", &mRSMUseLightcuts);
+				if (mRSMUseLightcuts)
+				{
+					ImGui::SliderFloat("Lightcuts error threshold", &mRSMLightcutsThreshold, 0.001f, 0.2f);
+					ImGui::SliderInt("Lightcuts max clusters", &mRSMLightcutsMaxClusters,
+						RSMLightTree::START_NODES_PER_AXIS * RSMLightTree::START_NODES_PER_AXIS, RSMLightTree::MAX_CLUSTERS);
+				}
+				// analyzed offline with tools/RSMLightcutsBench
+				ImGui::Separator();
+				// interleaving and accumulation apply to the sample gather (CS), tools/RSMInterleaveBench
+				int interleaveIndex = mRSMInterleaveSize >= 4 ? 2 : mRSMInterleaveSize - 1;
+				if (ImGui::Combo("Interleave tile", &interleaveIndex, "None\0" "2x2\0" "4x4\0"))
+					mRSMInterleaveSize = 1 << interleaveIndex;
+				ImGui::Checkbox("Temporal accumulation", &mRSMTemporalAccumulation);
+				if (mRSMTemporalAccumulation)
+					ImGui::SliderFloat("History weight", &mRSMHistoryWeight, 0.02f, 1.0f);
+				// sky, unlit and smooth tiles of the sample gather (CS), tools/RSMTileBench
+				ImGui::Checkbox("Tile classification (CS)", &mRSMUseTileClassification);
+				if (mRSMUseTileClassification)
+				{
+					ImGui::SliderFloat("Tile normal variance", &mRSMTileNormalVariance, 0.0f, 0.2f);
+					ImGui::SliderFloat("Tile plane distance", &mRSMTilePlaneDistance, 0.0f, 0.1f);
+				}
+				if (ImGui::Button("Capture RSM"))
+					mRSMCaptureRequested = true;
+				if (!mRSMCaptureStatus.empty())
+				{
+					ImGui::SameLine();
+					ImGui::Text("%s", mRSMCaptureStatus.c_str());
+				}
 				//ImGui::SliderInt("RSM Samples Count", &mRSMSamplesCount, 1, 1000);
 			}
 			if (ImGui::CollapsingHeader("LPV")) {
@@ -793,17 +1078,40 @@ void DXRSExampleGIScene::UpdateImGui()
 				ImGui::SliderFloat("Power", &mLPVPower, 0.0f, 2.0f);
 				ImGui::SliderFloat("Attenuation", &mLPVAttenuation, 0.0f, 5.0f);
 				ImGui::Separator();
+				// the bundles record the instance count of the propagation draw
+				if (ImGui::SliderInt("Cascades", &mLPVCascadeCount, 1, LPV_CASCADES))
+					ResetLPVPropagationBundles();
+				ImGui::SliderFloat("Finest cell size", &mLPVCascadeCellSize, 0.5f, 8.0f);
+				ImGui::Checkbox("Follow camera", &mLPVCascadesFollowCamera);
+				ImGui::SameLine();
+				ImGui::Checkbox("Inject into coarser cascades", &mLPVInjectCoarser);
+				ImGui::SliderFloat("Cascade margin (cells)", &mLPVCascadeMargin, 0.0f, 4.0f);
+				ImGui::SliderFloat("Cascade blend (cells)", &mLPVCascadeBlend, 0.0f, 8.0f);
+				ImGui::Separator();
+				ImGui::Checkbox("Geometry volume occlusion (static models)", &mUseLPVGeometryVolume);
+				ImGui::Separator();
+				ImGui::Combo("SH storage", &mLPVSHEncoding, "UNORM8 (clamped)\0FLOAT16\0SNORM8 scaled\0");
+				if (mLPVSHEncoding == LPVSHCodec::ENCODING_SNORM8_SCALED)
+					ImGui::SliderFloat("Storage range", &mLPVStorageRange, 0.1f, 64.0f, "%.2f", 2.0f);
+				ImGui::Text("SH volumes: %.2f MB", double(LPV_DIM) * LPV_DIM * LPV_DIM * LPV_CASCADES * 6.0 *
+					LPVSHCodec::GetBytesPerCell(LPVSHCodec::Encoding(mAppliedLPVSHEncoding)) / (1024.0 * 1024.0));
+				ImGui::Separator();
+				ImGui::Checkbox("Amortize propagation", &mLPVAmortize);
+				if (mLPVAmortize)
+				{
+					ImGui::SliderInt("Steps per frame", &mLPVStepsPerFrame, 0, 50);
+					ImGui::SliderFloat("Restart threshold", &mLPVRestartThreshold, 0.0f, 0.1f);
+					const LPVPropagationScheduler::Stats& stats = mLPVScheduler.GetStats();
+					ImGui::Text("%u/%d steps, %llu restarts, %llu of %llu frames skipped", mLPVScheduler.GetCompletedSteps(), mLPVPropagationSteps,
+						(unsigned long long)stats.mRestarts, (unsigned long long)stats.mSkippedFrames, (unsigned long long)stats.mFrames);
+				}
+				ImGui::Separator();
 				ImGui::Checkbox("DX12 bundles for propagation", &mUseBundleForLPVPropagation);
 				if (mUseBundleForLPVPropagation)
 				{
 					ImGui::SameLine();
-					if (ImGui::Button("Update")) {
-						mLPVPropagationBundle1Closed = false;
-						mLPVPropagationBundle2Closed = false;
-						mLPVPropagationBundlesClosed = false;
-						mLPVPropagationBundle1->Reset(mLPVPropagationBundle1Allocator.Get(), nullptr);
-						mLPVPropagationBundle2->Reset(mLPVPropagationBundle2Allocator.Get(), nullptr);
-					}
+					if (ImGui::Button("Update"))
+						ResetLPVPropagationBundles();
 				}
 			}
 			if (ImGui::CollapsingHeader("VCT")) {
@@ -826,6 +1134,17 @@ void DXRSExampleGIScene::UpdateImGui()
 		
 		if (ImGui::CollapsingHeader("Extras")) {
 			ImGui::Checkbox("DX12 Asynchronous Compute", &mUseAsyncCompute);
+			ImGui::SliderInt("Frames in flight", &mFramesInFlight, 1, DXRSGraphics::MAX_FRAMES_IN_FLIGHT);
+			ImGui::SameLine();
+			ImGui::Text("(%llu CPU stalls)", mSandboxFramework->GetFrameTimeline().GetStats().mStallCount);
+			const UploadManager::Stats& uploadStats = mSandboxFramework->GetUploadManager().GetStats();
+			ImGui::Text("Copy queue uploads: %.2f MB in %llu batches (%llu ring stalls)", uploadStats.mUploadedBytes / (1024.0 * 1024.0), uploadStats.mSubmissionCount, uploadStats.mStallCount);
+			if (mUseAsyncCompute)
+			{
+				ImGui::Text("Async compute: RSM %s, VCT %s", mRSMOnAsyncCompute ? (mRSMAsyncPreviousFrame ? "compute (1 frame late)" : "compute") : "graphics",
+					mVCTOnAsyncCompute ? (mVCTAsyncPreviousFrame ? "compute (1 frame late)" : "compute") : "graphics");
+				ImGui::Text("Estimated critical path: %.2f (graphics only: %.2f)", mAsyncComputeScheduler.GetCriticalPathLength(), mAsyncComputeScheduler.GetSerialLength());
+			}
 			ImGui::Checkbox("DXR Reflections", &mUseDXRReflections);
 			if (mUseDXRReflections)
 			{
@@ -843,12 +1162,379 @@ void DXRSExampleGIScene::UpdateImGui()
 				ImGui::SliderFloat("RTAO power", &mDXRAOPower, 0.01f, 15.0f);
 				ImGui::Checkbox("RTAO Blur", &mDXRBlurAo);
 			}
+			// both replace a 2 descriptor block allocation + 2 descriptor copies per draw; the recording time of the
+			// draw loops is in CPU Timings ("... draws"), the pass times in GPU Timings
+			ImGui::Combo("Per-draw data", &mPerDrawData, "Root constants\0Root CBV\0");
+			ImGui::Text("Per-draw binds: %u (descriptor copies saved: %u)", mPerDrawBinds, mPerDrawBinds * 2);
+			ImGui::Checkbox("Shader hot reload", &mUseShaderHotReload);
+			ImGui::SameLine();
+			ImGui::Text("(%u files, %u PSOs reloaded)", (UINT)mShaderWatcher.GetWatchedCount(), mShaderReloadedPSOCount);
+			if (!mShaderReloadError.empty())
+				ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s", mShaderReloadError.c_str());
+		}
+
+		if (ImGui::CollapsingHeader("Frame Times")) {
+			FrameTimeStats& frameTimes = mTimer.GetFrameTimeStats();
+			FrameTimeStats::Summary summary = frameTimes.GetSummary();
+			std::vector<float> frames = frameTimes.GetFrameTimes();
+			ImGui::PlotLines("##FrameTimes", frames.data(), static_cast<int>(frames.size()), 0, "Frame ms", 0.0f, static_cast<float>(summary.mP99Ms * 1.5), ImVec2(0, 60));
+
+			const std::vector<uint32_t>& histogram = frameTimes.GetHistogram();
+			std::vector<float> buckets(histogram.begin(), histogram.end());
+			ImGui::PlotHistogram("##FrameTimeHistogram", buckets.data(), static_cast<int>(buckets.size()), 0, "Histogram", 0.0f, FLT_MAX, ImVec2(0, 60));
+			ImGui::Text("%.1f ms buckets, last one collects everything above %.1f ms", frameTimes.GetBucketMs(), frameTimes.GetBucketMs() * (buckets.size() - 1));
+
+			ImGui::Text("Last %u frames: avg %.3f, p50 %.3f, p95 %.3f, p99 %.3f, max %.3f ms", static_cast<uint32_t>(summary.mCount),
+				summary.mAverageMs, summary.mP50Ms, summary.mP95Ms, summary.mP99Ms, summary.mMaxMs);
+			ImGui::Text("Pacing: std dev %.3f ms, jitter %.3f ms", summary.mStdDevMs, summary.mJitterMs);
+			ImGui::Text("Hitches: %llu in window, %llu total", summary.mHitchCount, frameTimes.GetHitchCount());
+			for (auto it = frameTimes.GetRecentHitches().rbegin(); it != frameTimes.GetRecentHitches().rend(); ++it)
+				ImGui::Text("  frame %llu: %.3f ms (median %.3f ms)", it->mFrame, it->mMs, it->mMedianMs);
+
+			if (ImGui::Button("Reset##FrameTimes"))
+				frameTimes.Clear();
+		}
+
+		if (ImGui::CollapsingHeader("GPU Timings")) {
+			GpuProfiler& gpuProfiler = mSandboxFramework->GetGpuProfiler();
+			for (GpuProfiler::QueueId queue = 0; queue < gpuProfiler.GetQueueCount(); queue++)
+				ImGui::Text("%s queue: %.3f ms", gpuProfiler.GetQueueName(queue).c_str(), gpuProfiler.GetQueueTimeMs(queue));
+
+			ImGui::Separator();
+			for (auto& pass : gpuProfiler.GetPasses())
+			{
+				// only the passes of the last resolved frame, the rest keep their old numbers
+				if (pass.mLastFrame != gpuProfiler.GetResolvedFrameCount() || pass.mSampleCount == 0)
+					continue;
+
+				ImGui::Text("%*s%s (%s): %.3f ms [%.3f - %.3f]", pass.mDepth * 2, "", pass.mName.substr(pass.mName.rfind('/') + 1).c_str(),
+					gpuProfiler.GetQueueName(pass.mQueue).c_str(), pass.mAverageMs, pass.mMinMs, pass.mMaxMs);
+			}
+
+			if (ImGui::Button("Export CSV/JSON"))
+			{
+				gpuProfiler.WriteCSV(mSandboxFramework->GetFilePath("profiling\\gpu_timings.csv"));
+				gpuProfiler.WriteJSON(mSandboxFramework->GetFilePath("profiling\\gpu_timings.json"));
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Reset"))
+				gpuProfiler.ResetStats();
+		}
+
+		if (ImGui::CollapsingHeader("CPU Timings")) {
+			CpuProfiler& cpuProfiler = CpuProfiler::Get();
+			if (ImGui::Checkbox("Record CPU scopes", &mUseCpuProfiler))
+				cpuProfiler.SetEnabled(mUseCpuProfiler);
+
+			// summarizing sorts every recorded event, once every 30 frames is plenty
+			if (mCpuProfileRefreshFrames++ % 30 == 0)
+			{
+				mCpuProfileSummary = CpuProfiler::Summarize(cpuProfiler.Capture());
+				cpuProfiler.Clear();
+			}
+
+			ImGui::Text("%-32s %6s %8s %8s %8s %8s", "Scope", "Count", "Mean", "P50", "P90", "P99");
+			for (auto& scope : mCpuProfileSummary)
+				ImGui::Text("%-32s %6llu %8.3f %8.3f %8.3f %8.3f", scope.mName.c_str(), scope.mCount, scope.mMeanMs, scope.mP50Ms, scope.mP90Ms, scope.mP99Ms);
+
+			if (ImGui::Button("Write Chrome trace"))
+				cpuProfiler.WriteChromeTrace(mSandboxFramework->GetFilePath("profiling\\cpu_trace.json"));
+
+			// analyzed offline with tools/CommandReplay
+			ImGui::Separator();
+			ImGui::SliderInt("Frames##CommandCapture", &mCommandCaptureFrames, 1, 60);
+			if (mSandboxFramework->IsCapturingCommands())
+				ImGui::Text("Capturing commands...");
+			else if (ImGui::Button("Capture command log"))
+				mSandboxFramework->CaptureCommands(UINT(mCommandCaptureFrames), mSandboxFramework->GetFilePath("profiling\\command_log.bin"));
 		}
 
 		ImGui::End();
 	}
 }
 
+void DXRSExampleGIScene::UpdateLPVPropagationSchedule()
+{
+	if (!mUseLPV || !mLPVAmortize)
+	{
+		mLPVScheduler.Invalidate();
+		return;
+	}
+
+	LPVPropagationScheduler::Settings settings;
+	settings.mMaxSteps = uint32_t(mLPVPropagationSteps);
+	settings.mStepsPerFrame = uint32_t(mLPVStepsPerFrame);
+	settings.mRestartThreshold = mLPVRestartThreshold;
+	// the grid is never read back, so there are no step energies and propagation runs up to the step limit
+	settings.mConvergenceEpsilon = 0.0f;
+	mLPVScheduler.SetSettings(settings);
+
+	// the injected flux follows the light, small changes keep the propagated volume
+	std::vector<float> inputs;
+	for (int i = 0; i < 3; i++)
+		inputs.push_back(mDirectionalLightDir[i]);
+	for (int i = 0; i < 3; i++)
+		inputs.push_back(mDirectionalLightColor[i] * mDirectionalLightIntensity);
+
+	// where the VPLs land does not change a little, so any change restarts
+	struct
+	{
+		float mTransforms[LPV_CASCADES][4];
+		float mStorageScale;
+		int mCascadeCount;
+		int mInjectCoarser;
+		int mDownsample;
+		int mDownsampleScale;
+		int mDynamicObjectsMoving;
+		int mGeometryVolume;
+	} signature = {};
+	for (uint32_t cascade = 0; cascade < mLPVCascades.GetCascadeCount(); cascade++)
+		mLPVCascades.GetCellTransform(cascade, signature.mTransforms[cascade][3], signature.mTransforms[cascade]);
+	signature.mCascadeCount = int(mLPVCascades.GetCascadeCount());
+	signature.mStorageScale = mLPVStorageRange;
+	signature.mInjectCoarser = mLPVInjectCoarser ? 1 : 0;
+	signature.mDownsample = mRSMDownsampleForLPV ? 1 : 0;
+	signature.mDownsampleScale = int(mRSMDownsampleScaleSize);
+	signature.mDynamicObjectsMoving = (mUseDynamicObjects && !mStopDynamicObjects) ? 1 : 0;
+	signature.mGeometryVolume = mLPVGeometryVolumeSignature != 0 ? 1 : 0;
+	uint64_t signatureHash = Utility::HashRange(&signature, sizeof(signature));
+
+	float change = -1.0f;
+	if (signatureHash == mLPVRestartSignature && !signature.mDynamicObjectsMoving && mLPVRestartInputs.size() == inputs.size())
+		change = LPVPropagationScheduler::RelativeChange(mLPVRestartInputs.data(), inputs.data(), inputs.size());
+
+	if (mLPVScheduler.BeginFrame(change) == LPVPropagationScheduler::ACTION_RESTART)
+	{
+		mLPVRestartInputs = inputs;
+		mLPVRestartSignature = signatureHash;
+	}
+}
+
+void DXRSExampleGIScene::UpdateLPVGeometryVolume()
+{
+	CPU_PROFILE_SCOPE("UpdateLPVGeometryVolume");
+
+	// the occluders are static, so only the cascades moving rebuild the volume
+	uint64_t signature = 0;
+	if (mUseLPV && mUseLPVGeometryVolume)
+	{
+		float transforms[LPV_CASCADES][4] = {};
+		for (uint32_t cascade = 0; cascade < mLPVCascades.GetCascadeCount(); cascade++)
+			mLPVCascades.GetCellTransform(cascade, transforms[cascade][3], transforms[cascade]);
+		signature = Utility::HashRange(transforms, sizeof(transforms)) | 1;
+	}
+	if (mLPVGeometryVolumeResource && signature == mLPVGeometryVolumeSignature)
+		return;
+	mLPVGeometryVolumeSignature = signature;
+
+	// cascades stacked along z like the SH render targets, unused ones and a disabled volume stay empty
+	const size_t cascadeSize = size_t(LPV_DIM) * LPV_DIM * LPV_DIM * 4;
+	std::vector<float> occlusion(cascadeSize * LPV_CASCADES, 0.0f);
+	if (signature != 0)
+	{
+		LPVGeometryVolume volume(LPV_DIM);
+		for (uint32_t cascade = 0; cascade < mLPVCascades.GetCascadeCount(); cascade++)
+		{
+			float scale, offset[3];
+			mLPVCascades.GetCellTransform(cascade, scale, offset);
+			volume.SetCellTransform(scale, offset);
+			volume.Clear();
+			for (auto& model : mRenderableObjects)
+			{
+				// dynamic objects move every frame and would rebuild it every frame
+				if (model->GetIsDynamic())
+					continue;
+
+				XMFLOAT4X4 world;
+				XMStoreFloat4x4(&world, model->GetWorldMatrix());
+				for (const DXRSMesh* mesh : model->Meshes())
+				{
+					const std::vector<XMFLOAT3>& positions = mesh->Vertices();
+					const std::vector<XMFLOAT3>& normals = mesh->Normals();
+					const std::vector<UINT>& indices = mesh->Indices();
+					if (positions.empty())
+						continue;
+					volume.AddMesh(&positions[0].x, normals.size() == positions.size() ? &normals[0].x : nullptr, positions.size(),
+						indices.data(), indices.size(), &world.m[0][0]);
+				}
+			}
+			std::copy(volume.GetData().begin(), volume.GetData().end(), occlusion.begin() + cascade * cascadeSize);
+		}
+	}
+
+	// a new texture each time, the previous one can still be read by frames in flight
+	ID3D12Device* device = mSandboxFramework->GetD3DDevice();
+	if (mLPVGeometryVolumeResource)
+		mSandboxFramework->DeferRelease(mLPVGeometryVolumeResource);
+	else
+		mLPVGeometryVolumeDescriptorHandleCPU = mSandboxFramework->GetDescriptorHeapManager()->CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	D3D12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex3D(DXGI_FORMAT_R32G32B32A32_FLOAT, LPV_DIM, LPV_DIM, LPV_DIM * LPV_CASCADES, 1);
+	ThrowIfFailed(device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE, &texDesc,
+		D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(mLPVGeometryVolumeResource.ReleaseAndGetAddressOf())));
+	mLPVGeometryVolumeResource->SetName(L"LPV geometry volume");
+
+	D3D12_SUBRESOURCE_DATA data = {};
+	data.pData = occlusion.data();
+	data.RowPitch = LPV_DIM * 4 * sizeof(float);
+	data.SlicePitch = data.RowPitch * LPV_DIM;
+	UploadManager& uploadManager = mSandboxFramework->GetUploadManager();
+	uploadManager.UploadTexture(mLPVGeometryVolumeResource.Get(), 0, 1, &data);
+	uploadManager.WaitOnQueue(mSandboxFramework->GetCommandQueueGraphics(), uploadManager.Submit());
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+	srvDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	srvDesc.Texture3D.MostDetailedMip = 0;
+	srvDesc.Texture3D.MipLevels = 1;
+	device->CreateShaderResourceView(mLPVGeometryVolumeResource.Get(), &srvDesc, mLPVGeometryVolumeDescriptorHandleCPU.GetCPUHandle());
+
+	// recorded bundles copied the previous descriptor
+	ResetLPVPropagationBundles();
+}
+
+void DXRSExampleGIScene::SelectLPVSHRenderTargets(int encoding)
+{
+	std::vector<DXRSRenderTarget*>& targets = mLPVEncodingRTs[encoding];
+	if (targets.empty())
+	{
+		ID3D12Device* device = mSandboxFramework->GetD3DDevice();
+		DXRS::DescriptorHeapManager* descriptorManager = mSandboxFramework->GetDescriptorHeapManager();
+		DXGI_FORMAT format = GetLPVSHFormat(encoding);
+		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+		targets.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Red SH LPV", LPV_DIM * LPV_CASCADES));
+		targets.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Green SH LPV", LPV_DIM * LPV_CASCADES));
+		targets.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Blue SH LPV", LPV_DIM * LPV_CASCADES));
+		targets.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Accumulation Red SH LPV", LPV_DIM * LPV_CASCADES));
+		targets.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Accumulation Green SH LPV", LPV_DIM * LPV_CASCADES));
+		targets.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Accumulation Blue SH LPV", LPV_DIM * LPV_CASCADES));
+	}
+
+	mLPVSHColorsRTs.assign(targets.begin(), targets.begin() + 3);
+	mLPVAccumulationSHColorsRTs.assign(targets.begin() + 3, targets.end());
+}
+
+void DXRSExampleGIScene::ApplyLPVSHEncoding(int encoding)
+{
+	mAppliedLPVSHEncoding = encoding;
+	SelectLPVSHRenderTargets(encoding);
+
+	// GraphicsPSO keeps its description but not the bytecode, so the pipelines are rebuilt from their shaders; the
+	// previous ones stay alive for the frames in flight
+	DXGI_FORMAT formats[6];
+	std::fill(std::begin(formats), std::end(formats), GetLPVSHFormat(encoding));
+	mLPVInjectionPSO.SetRenderTargetFormats(3, formats, DXGI_FORMAT_D32_FLOAT);
+	mLPVPropagationPSO.SetRenderTargetFormats(6, formats, DXGI_FORMAT_D32_FLOAT);
+	for (auto& desc : mPSOShaders)
+	{
+		std::string error;
+		if ((desc.mGraphicsPSO == &mLPVInjectionPSO || desc.mGraphicsPSO == &mLPVPropagationPSO) && !RebuildPSO(desc, error))
+			throw std::runtime_error(error.c_str());
+	}
+
+	// the new targets hold nothing yet
+	ResetLPVPropagationBundles();
+	mLPVScheduler.Invalidate();
+
+	if (mPipelineCache.IsDirty())
+		mPipelineCache.Save(mSandboxFramework->GetFilePath(L"cache\\pipelines.bin"));
+}
+
+void DXRSExampleGIScene::InitPerDrawRootSignature(ID3D12Device* device, PerDrawBinding::Pass pass)
+{
+	D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
+		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS;
+
+	RootSignature* rootSignature = nullptr;
+	const wchar_t* name = nullptr;
+	D3D12_SAMPLER_DESC sampler = {};
+	sampler.MaxLOD = D3D12_FLOAT32_MAX;
+	switch (pass)
+	{
+	case PerDrawBinding::PASS_GBUFFER:
+		rootSignature = &mGbufferRS;
+		name = L"GPrepassRS";
+		rootSignatureFlags |= D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
+		sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+		sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+		sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+		sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+		sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
+		break;
+	case PerDrawBinding::PASS_SHADOWS:
+		rootSignature = &mShadowMappingRS;
+		name = L"Shadow Mapping pass RS";
+		rootSignatureFlags |= D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
+		break;
+	case PerDrawBinding::PASS_RSM_BUFFERS:
+		rootSignature = &mRSMBuffersRS;
+		name = L"RSM Buffers RS";
+		rootSignatureFlags |= D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
+		break;
+	case PerDrawBinding::PASS_VOXELIZATION:
+		rootSignature = &mVCTVoxelizationRS;
+		name = L"VCT voxelization pass RS";
+		rootSignatureFlags |= D3D12_ROOT_SIGNATURE_FLAG_ALLOW_STREAM_OUTPUT;
+		// shadow map comparison
+		sampler.Filter = D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+		sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
+		sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
+		sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+		sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
+		sampler.MaxAnisotropy = 16;
+		std::fill(std::begin(sampler.BorderColor), std::end(sampler.BorderColor), 1.0f);
+		break;
+	default:
+		assert(false);
+		return;
+	}
+
+	RootSignatureLayout layout = PerDrawBinding::GetLayout(pass, PerDrawBinding::Data(mAppliedPerDrawData));
+	rootSignature->Reset(layout);
+	for (auto& staticSampler : layout.GetStaticSamplers())
+		rootSignature->InitStaticSampler(staticSampler.mRegister, sampler, D3D12_SHADER_VISIBILITY(staticSampler.mVisibility));
+	rootSignature->Finalize(device, name, rootSignatureFlags);
+}
+
+void DXRSExampleGIScene::ApplyPerDrawData(int data)
+{
+	static_assert(sizeof(DXRSModel::ModelConstantBuffer) == PerDrawBinding::OBJECT_CONSTANT_DWORDS * 4, "perModelInstanceCB");
+
+	mAppliedPerDrawData = data;
+
+	// the PSOs point at the root signatures, so rebuilding them picks up the new layouts
+	ID3D12Device* device = mSandboxFramework->GetD3DDevice();
+	for (int pass = 0; pass < PerDrawBinding::PASS_COUNT; pass++)
+		InitPerDrawRootSignature(device, PerDrawBinding::Pass(pass));
+
+	for (auto& desc : mPSOShaders)
+	{
+		if (desc.mGraphicsPSO != &mGbufferPSO && desc.mGraphicsPSO != &mShadowMappingPSO &&
+			desc.mGraphicsPSO != &mRSMBuffersPSO && desc.mGraphicsPSO != &mVCTVoxelizationPSO)
+			continue;
+
+		std::string error;
+		if (!RebuildPSO(desc, error))
+			throw std::runtime_error(error.c_str());
+	}
+
+	if (mPipelineCache.IsDirty())
+		mPipelineCache.Save(mSandboxFramework->GetFilePath(L"cache\\pipelines.bin"));
+}
+
+void DXRSExampleGIScene::BindPerDrawData(ID3D12GraphicsCommandList* commandList, DXRSModel& model)
+{
+	if (mAppliedPerDrawData == PerDrawBinding::DATA_ROOT_CONSTANTS)
+		commandList->SetGraphicsRoot32BitConstants(PerDrawBinding::OBJECT_PARAMETER, PerDrawBinding::OBJECT_CONSTANT_DWORDS, &model.GetConstants(), 0);
+	else
+		commandList->SetGraphicsRootConstantBufferView(PerDrawBinding::OBJECT_PARAMETER, model.GetCB()->GetGPUVirtualAddress());
+	mPerDrawBinds++;
+}
+
 void DXRSExampleGIScene::UpdateLights(DXRSTimer const& timer)
 {
 	if (mDynamicDirectionalLight)
@@ -864,7 +1550,23 @@ void DXRSExampleGIScene::UpdateLights(DXRSTimer const& timer)
 
 void DXRSExampleGIScene::UpdateCamera(DXRSTimer const& timer)
 {
-	mCamera->Update(timer, mMouse, mKeyboard);
+	if (mBenchmark)
+	{
+		BenchmarkScenario::Vector3 position, target;
+		mBenchmark->GetCamera(position, target);
+		XMVECTOR eye = XMVectorSet(position.x, position.y, position.z, 1.0f);
+		XMVECTOR direction = XMVectorSubtract(XMVectorSet(target.x, target.y, target.z, 1.0f), eye);
+		mCamera->SetPosition(eye);
+		if (XMVectorGetX(XMVector3LengthSq(direction)) > 0.0f)
+		{
+			XMFLOAT3 normalized;
+			XMStoreFloat3(&normalized, XMVector3Normalize(direction));
+			mCamera->SetDirection(normalized);
+		}
+		mCamera->UpdateViewMatrix();
+	}
+	else
+		mCamera->Update(timer, mMouse, mKeyboard);
 
 	mCameraView = mCamera->ViewMatrix();
 	mCameraProjection = mCamera->ProjectionMatrix();
@@ -901,17 +1603,6 @@ void DXRSExampleGIScene::RenderObject(U_PTR<DXRSModel>& aModel, std::function<vo
 
 void DXRSExampleGIScene::InitGbuffer(ID3D12Device* device, DXRS::DescriptorHeapManager* descriptorManager)
 {
-	D3D12_SAMPLER_DESC sampler = {};
-	sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
-	sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-	sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-	sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-	sampler.MipLODBias = 0;
-	sampler.MaxAnisotropy = 0;
-	sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
-	sampler.MinLOD = 0.0f;
-	sampler.MaxLOD = D3D12_FLOAT32_MAX;
-
 	DXGI_FORMAT rtFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
 	D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET;
 
@@ -923,17 +1614,7 @@ void DXRSExampleGIScene::InitGbuffer(ID3D12Device* device, DXRS::DescriptorHeapM
 	rtFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
 	mGbufferRTs[2] = new DXRSRenderTarget(device, descriptorManager, MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT, rtFormat, flags, L"World Positions");
 
-	// root signature
-	D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
-		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
-
-	mGbufferRS.Reset(1, 1);
-	mGbufferRS.InitStaticSampler(0, sampler, D3D12_SHADER_VISIBILITY_PIXEL);
-	mGbufferRS[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 0, 2, D3D12_SHADER_VISIBILITY_ALL);
-	mGbufferRS.Finalize(device, L"GPrepassRS", rootSignatureFlags);
+	InitPerDrawRootSignature(device, PerDrawBinding::PASS_GBUFFER);
 
 	//Create Pipeline State Object
 	ComPtr<ID3DBlob> vertexShader;
@@ -948,11 +1629,11 @@ void DXRSExampleGIScene::InitGbuffer(ID3D12Device* device, DXRS::DescriptorHeapM
 
 	ID3DBlob* errorBlob = nullptr;
 
-	ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\GBuffer.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_1", compileFlags, 0, &vertexShader, nullptr));
+	ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\GBuffer.hlsl").c_str(), nullptr, "VSMain", "vs_5_1", compileFlags, &vertexShader, nullptr));
 
 	compileFlags |= D3DCOMPILE_ENABLE_UNBOUNDED_DESCRIPTOR_TABLES;
 
-	ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\GBuffer.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_1", compileFlags, 0, &pixelShader, &errorBlob));
+	ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\GBuffer.hlsl").c_str(), nullptr, "PSMain", "ps_5_1", compileFlags, &pixelShader, &errorBlob));
 
 	// Define the vertex input layout.
 	D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
@@ -993,7 +1674,7 @@ void DXRSExampleGIScene::RenderGbuffer(ID3D12Device* device, ID3D12GraphicsComma
 	CD3DX12_VIEWPORT viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, mSandboxFramework->GetOutputSize().right, mSandboxFramework->GetOutputSize().bottom);
 	CD3DX12_RECT rect = CD3DX12_RECT(0.0f, 0.0f, mSandboxFramework->GetOutputSize().right, mSandboxFramework->GetOutputSize().bottom);
 
-	PIXBeginEvent(commandList, 0, "GBuffer");
+	mSandboxFramework->BeginGpuEvent(commandList, "GBuffer");
 	{
 		commandList->RSSetViewports(1, &viewport);
 		commandList->RSSetScissorRects(1, &rect);
@@ -1023,20 +1704,18 @@ void DXRSExampleGIScene::RenderGbuffer(ID3D12Device* device, ID3D12GraphicsComma
 		commandList->ClearRenderTargetView(rtvHandles[2], clearColorBlack, 0, nullptr);
 		commandList->ClearRenderTargetView(rtvHandles[3], clearColorBlack, 0, nullptr);
 
-		DXRS::DescriptorHandle cbvHandle;
+		// per-pass CB is bound once, per-object data goes straight into the root arguments (no descriptor copies)
+		commandList->SetGraphicsRootConstantBufferView(PerDrawBinding::PASS_PARAMETER, mGbufferCB->GetGPUVirtualAddress());
 
+		CPU_PROFILE_SCOPE("GBuffer draws");
 		for (auto& model : mRenderableObjects) {
-			RenderObject(model, [this, gpuDescriptorHeap, commandList, &cbvHandle, device](U_PTR<DXRSModel>& anObject) {
-				cbvHandle = gpuDescriptorHeap->GetHandleBlock(2);
-				gpuDescriptorHeap->AddToHandle(device, cbvHandle, mGbufferCB->GetCBV());
-				gpuDescriptorHeap->AddToHandle(device, cbvHandle, anObject->GetCB()->GetCBV());
-
-				commandList->SetGraphicsRootDescriptorTable(0, cbvHandle.GetGPUHandle());
+			RenderObject(model, [this, commandList](U_PTR<DXRSModel>& anObject) {
+				BindPerDrawData(commandList, *anObject);
 				anObject->Render(commandList);
 			});
 		}
 	}
-	PIXEndEvent(commandList);
+	mSandboxFramework->EndGpuEvent(commandList);
 }
 
 void DXRSExampleGIScene::InitShadowMapping(ID3D12Device* device, DXRS::DescriptorHeapManager* descriptorManager)
@@ -1044,16 +1723,7 @@ void DXRSExampleGIScene::InitShadowMapping(ID3D12Device* device, DXRS::Descripto
 {
 	mShadowDepth = new DXRSDepthBuffer(device, descriptorManager, SHADOWMAP_SIZE, SHADOWMAP_SIZE, DXGI_FORMAT_D32_FLOAT);
 
-	//create root signature
-	D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
-		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
-		D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
-
-	mShadowMappingRS.Reset(1, 0);
-	mShadowMappingRS[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 0, 2, D3D12_SHADER_VISIBILITY_VERTEX);
-	mShadowMappingRS.Finalize(device, L"Shadow Mapping pass RS", rootSignatureFlags);
+	InitPerDrawRootSignature(device, PerDrawBinding::PASS_SHADOWS);
 
 	ComPtr<ID3DBlob> vertexShader;
 	//ComPtr<ID3DBlob> pixelShader;
@@ -1067,7 +1737,7 @@ void DXRSExampleGIScene::InitShadowMapping(ID3D12Device* device, DXRS::Descripto
 
 	ID3DBlob* errorBlob = nullptr;
 
-	HRESULT res = D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\ShadowMapping.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSOnlyMain", "vs_5_1", compileFlags, 0, &vertexShader, &errorBlob);
+	HRESULT res = mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\ShadowMapping.hlsl").c_str(), nullptr, "VSOnlyMain", "vs_5_1", compileFlags, &vertexShader, &errorBlob);
 
 	//if (errorBlob) {
 	//	std::string resultMessasge;
@@ -1107,7 +1777,7 @@ void DXRSExampleGIScene::RenderShadowMapping(ID3D12Device* device, ID3D12Graphic
 	CD3DX12_VIEWPORT viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, mSandboxFramework->GetOutputSize().right, mSandboxFramework->GetOutputSize().bottom);
 	CD3DX12_RECT rect = CD3DX12_RECT(0.0f, 0.0f, mSandboxFramework->GetOutputSize().right, mSandboxFramework->GetOutputSize().bottom);
 
-	PIXBeginEvent(commandList, 0, "Shadows");
+	mSandboxFramework->BeginGpuEvent(commandList, "Shadows");
 	{
 		CD3DX12_VIEWPORT shadowMapViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, mShadowDepth->GetWidth(), mShadowDepth->GetHeight());
 		CD3DX12_RECT shadowRect = CD3DX12_RECT(0.0f, 0.0f, mShadowDepth->GetWidth(), mShadowDepth->GetHeight());
@@ -1124,15 +1794,12 @@ void DXRSExampleGIScene::RenderShadowMapping(ID3D12Device* device, ID3D12Graphic
 		commandList->OMSetRenderTargets(0, nullptr, FALSE, &mShadowDepth->GetDSV().GetCPUHandle());
 		commandList->ClearDepthStencilView(mShadowDepth->GetDSV().GetCPUHandle(), D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
-		DXRS::DescriptorHandle cbvHandle;
+		commandList->SetGraphicsRootConstantBufferView(PerDrawBinding::PASS_PARAMETER, mShadowMappingCB->GetGPUVirtualAddress());
 
+		CPU_PROFILE_SCOPE("Shadows draws");
 		for (auto& model : mRenderableObjects) {
-			RenderObject(model, [this, gpuDescriptorHeap, commandList, &cbvHandle, device](U_PTR<DXRSModel>& anObject) {
-				cbvHandle = gpuDescriptorHeap->GetHandleBlock(2);
-				gpuDescriptorHeap->AddToHandle(device, cbvHandle, mShadowMappingCB->GetCBV());
-				gpuDescriptorHeap->AddToHandle(device, cbvHandle, anObject->GetCB()->GetCBV());
-
-				commandList->SetGraphicsRootDescriptorTable(0, cbvHandle.GetGPUHandle());
+			RenderObject(model, [this, commandList](U_PTR<DXRSModel>& anObject) {
+				BindPerDrawData(commandList, *anObject);
 				anObject->Render(commandList);
 			});
 		}
@@ -1141,7 +1808,7 @@ void DXRSExampleGIScene::RenderShadowMapping(ID3D12Device* device, ID3D12Graphic
 		commandList->RSSetViewports(1, &viewport);
 		commandList->RSSetScissorRects(1, &rect);
 	}
-	PIXEndEvent(commandList);
+	mSandboxFramework->EndGpuEvent(commandList);
 }
 
 void DXRSExampleGIScene::InitReflectiveShadowMapping(ID3D12Device* device, DXRS::DescriptorHeapManager* descriptorManager)
@@ -1158,16 +1825,7 @@ void DXRSExampleGIScene::InitReflectiveShadowMapping(ID3D12Device* device, DXRS:
 		mRSMBuffersRTs_CopiesForAsync.push_back(new DXRSRenderTarget(device, descriptorManager, RSM_SIZE, RSM_SIZE, DXGI_FORMAT_R16G16B16A16_FLOAT, flags, L"C RSM Normals"));
 		mRSMBuffersRTs_CopiesForAsync.push_back(new DXRSRenderTarget(device, descriptorManager, RSM_SIZE, RSM_SIZE, DXGI_FORMAT_R8G8B8A8_UNORM, flags, L"C RSM Flux"));
 
-		// root signature
-		D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
-			D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
-			D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
-			D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
-			D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
-
-		mRSMBuffersRS.Reset(1, 0);
-		mRSMBuffersRS[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 0, 2, D3D12_SHADER_VISIBILITY_ALL);
-		mRSMBuffersRS.Finalize(device, L"RSM Buffers RS", rootSignatureFlags);
+		InitPerDrawRootSignature(device, PerDrawBinding::PASS_RSM_BUFFERS);
 
 		//Create Pipeline State Object
 		ComPtr<ID3DBlob> vertexShader;
@@ -1182,11 +1840,11 @@ void DXRSExampleGIScene::InitReflectiveShadowMapping(ID3D12Device* device, DXRS:
 
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\ShadowMapping.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_1", compileFlags, 0, &vertexShader, nullptr));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\ShadowMapping.hlsl").c_str(), nullptr, "VSMain", "vs_5_1", compileFlags, &vertexShader, nullptr));
 
 		compileFlags |= D3DCOMPILE_ENABLE_UNBOUNDED_DESCRIPTOR_TABLES;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\ShadowMapping.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSRSM", "ps_5_1", compileFlags, 0, &pixelShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\ShadowMapping.hlsl").c_str(), nullptr, "PSRSM", "ps_5_1", compileFlags, &pixelShader, &errorBlob));
 
 		// Define the vertex input layout.
 		D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
@@ -1267,14 +1925,14 @@ void DXRSExampleGIScene::InitReflectiveShadowMapping(ID3D12Device* device, DXRS:
 #endif
 			ID3DBlob* errorBlob = nullptr;
 
-			ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\ReflectiveShadowMappingPS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, &errorBlob));
+			ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\ReflectiveShadowMappingPS.hlsl", mRSMPermutations, "VSMain", "vs_5_0", compileFlags, &vertexShader, &errorBlob));
 			if (errorBlob)
 			{
 				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
 				errorBlob->Release();
 			}
 
-			ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\ReflectiveShadowMappingPS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, &errorBlob));
+			ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\ReflectiveShadowMappingPS.hlsl", mRSMPermutations, "PSMain", "ps_5_0", compileFlags, &pixelShader, &errorBlob));
 			if (errorBlob)
 			{
 				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -1315,7 +1973,7 @@ void DXRSExampleGIScene::InitReflectiveShadowMapping(ID3D12Device* device, DXRS:
 #endif
 			ID3DBlob* errorBlob = nullptr;
 
-			ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\ReflectiveShadowMappingCS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "CSMain", "cs_5_0", compileFlags, 0, &computeShader, &errorBlob));
+			ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\ReflectiveShadowMappingCS.hlsl", mRSMPermutations, "CSMain", "cs_5_0", compileFlags, &computeShader, &errorBlob));
 			if (errorBlob)
 			{
 				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -1327,6 +1985,225 @@ void DXRSExampleGIScene::InitReflectiveShadowMapping(ID3D12Device* device, DXRS:
 			mRSMPSO_Compute.Finalize(device);
 		}
 
+		// lightcuts version: light tree build and gather
+		{
+			static_assert((RSM_SIZE / RSM_LIGHT_TREE_LEAF_SIZE & (RSM_SIZE / RSM_LIGHT_TREE_LEAF_SIZE - 1)) == 0, "RSM light tree leaves must form a power of two grid");
+			mRSMLightTreeLeafLevel = 0;
+			while ((1u << mRSMLightTreeLeafLevel) < RSM_SIZE / RSM_LIGHT_TREE_LEAF_SIZE)
+				mRSMLightTreeLeafLevel++;
+
+			UINT64 nodeCount = RSMLightTree::GetNodeCount(mRSMLightTreeLeafLevel);
+			D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(nodeCount * sizeof(RSMLightTree::Node), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+			ThrowIfFailed(device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE, &bufferDesc,
+				D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr, IID_PPV_ARGS(mRSMLightTreeResource.ReleaseAndGetAddressOf())));
+			mRSMLightTreeResource->SetName(L"RSM light tree");
+
+			mRSMLightTreeUAVDescriptorHandleCPU = descriptorManager->CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+			D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+			uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+			uavDesc.Format = DXGI_FORMAT_UNKNOWN;
+			uavDesc.Buffer.NumElements = UINT(nodeCount);
+			uavDesc.Buffer.StructureByteStride = sizeof(RSMLightTree::Node);
+			device->CreateUnorderedAccessView(mRSMLightTreeResource.Get(), nullptr, &uavDesc, mRSMLightTreeUAVDescriptorHandleCPU.GetCPUHandle());
+
+			mRSMLightTreeSRVDescriptorHandleCPU = descriptorManager->CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+			D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+			srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+			srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+			srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+			srvDesc.Buffer.NumElements = UINT(nodeCount);
+			srvDesc.Buffer.StructureByteStride = sizeof(RSMLightTree::Node);
+			device->CreateShaderResourceView(mRSMLightTreeResource.Get(), &srvDesc, mRSMLightTreeSRVDescriptorHandleCPU.GetCPUHandle());
+
+			mRSMLightTreeBuildRS.Reset(3, 0);
+			mRSMLightTreeBuildRS[0].InitAsConstants(0, 2, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMLightTreeBuildRS[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 3, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMLightTreeBuildRS[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 1, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMLightTreeBuildRS.Finalize(device, L"RSM light tree build pass RS", rootSignatureFlags);
+
+			mRSMLightcutsRS.Reset(4, 0);
+			mRSMLightcutsRS[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 0, 1, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMLightcutsRS[1].InitAsConstants(1, sizeof(RSMLightcutsConstants) / 4, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMLightcutsRS[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 3, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMLightcutsRS[3].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 1, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMLightcutsRS.Finalize(device, L"RSM lightcuts pass RS", rootSignatureFlags);
+
+			ComPtr<ID3DBlob> leavesShader;
+			ComPtr<ID3DBlob> levelShader;
+			ComPtr<ID3DBlob> gatherShader;
+
+#if defined(_DEBUG)
+			// Enable better shader debugging with the graphics debugging tools.
+			UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+			UINT compileFlags = 0;
+#endif
+			ID3DBlob* errorBlob = nullptr;
+
+			ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\RSMLightTreeBuildCS.hlsl").c_str(), nullptr, "CSLeaves", "cs_5_0", compileFlags, &leavesShader, &errorBlob));
+			if (errorBlob)
+			{
+				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+				errorBlob->Release();
+			}
+			ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\RSMLightTreeBuildCS.hlsl").c_str(), nullptr, "CSLevel", "cs_5_0", compileFlags, &levelShader, &errorBlob));
+			if (errorBlob)
+			{
+				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+				errorBlob->Release();
+			}
+			ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\ReflectiveShadowMappingLightcutsCS.hlsl").c_str(), nullptr, "CSMain", "cs_5_0", compileFlags, &gatherShader, &errorBlob));
+			if (errorBlob)
+			{
+				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+				errorBlob->Release();
+			}
+
+			mRSMLightTreeLeavesPSO.SetRootSignature(mRSMLightTreeBuildRS);
+			mRSMLightTreeLeavesPSO.SetComputeShader(leavesShader->GetBufferPointer(), leavesShader->GetBufferSize());
+			mRSMLightTreeLeavesPSO.Finalize(device);
+			mRSMLightTreeLevelPSO.SetRootSignature(mRSMLightTreeBuildRS);
+			mRSMLightTreeLevelPSO.SetComputeShader(levelShader->GetBufferPointer(), levelShader->GetBufferSize());
+			mRSMLightTreeLevelPSO.Finalize(device);
+			mRSMLightcutsPSO.SetRootSignature(mRSMLightcutsRS);
+			mRSMLightcutsPSO.SetComputeShader(gatherShader->GetBufferPointer(), gatherShader->GetBufferSize());
+			mRSMLightcutsPSO.Finalize(device);
+		}
+
+		// interleaved sampling: de-interleave and temporal accumulation, the targets are created by GetRSMTemporalTargets
+		{
+			mRSMTemporalRS.Reset(3, 0);
+			mRSMTemporalRS[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 0, 1, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMTemporalRS[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 4, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMTemporalRS[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 2, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMTemporalRS.Finalize(device, L"RSM de-interleave & temporal pass RS", rootSignatureFlags);
+
+			ComPtr<ID3DBlob> computeShader;
+
+#if defined(_DEBUG)
+			// Enable better shader debugging with the graphics debugging tools.
+			UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+			UINT compileFlags = 0;
+#endif
+			ID3DBlob* errorBlob = nullptr;
+
+			ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\RSMTemporalCS.hlsl").c_str(), nullptr, "CSMain", "cs_5_0", compileFlags, &computeShader, &errorBlob));
+			if (errorBlob)
+			{
+				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+				errorBlob->Release();
+			}
+
+			mRSMTemporalPSO.SetRootSignature(mRSMTemporalRS);
+			mRSMTemporalPSO.SetComputeShader(computeShader->GetBufferPointer(), computeShader->GetBufferSize());
+			mRSMTemporalPSO.Finalize(device);
+		}
+
+		// tile classification: the tile lists with their dispatch arguments and the indirect versions of the CS pass
+		{
+			mRSMTileCapacity = RSMTileClassifier::GetTilesX(MAX_SCREEN_WIDTH) * RSMTileClassifier::GetTilesY(MAX_SCREEN_HEIGHT);
+			UINT words = RSMTileClassifier::GetBufferWords(mRSMTileCapacity);
+			D3D12_RESOURCE_DESC bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(UINT64(words) * sizeof(UINT), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+			ThrowIfFailed(device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE, &bufferDesc,
+				D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr, IID_PPV_ARGS(mRSMTileListsResource.ReleaseAndGetAddressOf())));
+			mRSMTileListsResource->SetName(L"RSM tile lists");
+
+			mRSMTileListsUAVDescriptorHandleCPU = descriptorManager->CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+			D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+			uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+			uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+			uavDesc.Buffer.NumElements = words;
+			uavDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+			device->CreateUnorderedAccessView(mRSMTileListsResource.Get(), nullptr, &uavDesc, mRSMTileListsUAVDescriptorHandleCPU.GetCPUHandle());
+
+			mRSMTileListsSRVDescriptorHandleCPU = descriptorManager->CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+			D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+			srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+			srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+			srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+			srvDesc.Buffer.NumElements = words;
+			srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+			device->CreateShaderResourceView(mRSMTileListsResource.Get(), &srvDesc, mRSMTileListsSRVDescriptorHandleCPU.GetCPUHandle());
+
+			D3D12_INDIRECT_ARGUMENT_DESC dispatchArgument = {};
+			dispatchArgument.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH;
+			D3D12_COMMAND_SIGNATURE_DESC signatureDesc = {};
+			signatureDesc.ByteStride = sizeof(D3D12_DISPATCH_ARGUMENTS);
+			signatureDesc.NumArgumentDescs = 1;
+			signatureDesc.pArgumentDescs = &dispatchArgument;
+			ThrowIfFailed(device->CreateCommandSignature(&signatureDesc, nullptr, IID_PPV_ARGS(mRSMTileDispatchSignature.ReleaseAndGetAddressOf())));
+
+			mRSMTileClassifyRS.Reset(3, 0);
+			mRSMTileClassifyRS[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 0, 1, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMTileClassifyRS[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 3, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMTileClassifyRS[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 1, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMTileClassifyRS.Finalize(device, L"RSM tile classification pass RS", rootSignatureFlags);
+
+			// mRSMRS_Compute with the tile lists and the list constants
+			mRSMTilesRS.Reset(4, 1);
+			mRSMTilesRS.InitStaticSampler(0, rsmSampler, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMTilesRS[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 0, 2, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMTilesRS[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 6, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMTilesRS[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 1, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMTilesRS[3].InitAsConstants(2, sizeof(RSMTileConstants) / 4, D3D12_SHADER_VISIBILITY_ALL);
+			mRSMTilesRS.Finalize(device, L"RSM tiled compute shader pass RS", rootSignatureFlags);
+
+			ComPtr<ID3DBlob> resetShader;
+			ComPtr<ID3DBlob> classifyShader;
+			ComPtr<ID3DBlob> tilesShader;
+			ComPtr<ID3DBlob> clearShader;
+
+#if defined(_DEBUG)
+			// Enable better shader debugging with the graphics debugging tools.
+			UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+			UINT compileFlags = 0;
+#endif
+			ID3DBlob* errorBlob = nullptr;
+
+			ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\RSMTileClassifyCS.hlsl").c_str(), nullptr, "CSReset", "cs_5_0", compileFlags, &resetShader, &errorBlob));
+			if (errorBlob)
+			{
+				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+				errorBlob->Release();
+			}
+			ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\RSMTileClassifyCS.hlsl").c_str(), nullptr, "CSClassify", "cs_5_0", compileFlags, &classifyShader, &errorBlob));
+			if (errorBlob)
+			{
+				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+				errorBlob->Release();
+			}
+			ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\ReflectiveShadowMappingCS.hlsl", mRSMPermutations, "CSTiles", "cs_5_0", compileFlags, &tilesShader, &errorBlob));
+			if (errorBlob)
+			{
+				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+				errorBlob->Release();
+			}
+			ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\ReflectiveShadowMappingCS.hlsl").c_str(), nullptr, "CSClearTiles", "cs_5_0", compileFlags, &clearShader, &errorBlob));
+			if (errorBlob)
+			{
+				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+				errorBlob->Release();
+			}
+
+			mRSMTileResetPSO.SetRootSignature(mRSMTileClassifyRS);
+			mRSMTileResetPSO.SetComputeShader(resetShader->GetBufferPointer(), resetShader->GetBufferSize());
+			mRSMTileResetPSO.Finalize(device);
+
+			mRSMTileClassifyPSO.SetRootSignature(mRSMTileClassifyRS);
+			mRSMTileClassifyPSO.SetComputeShader(classifyShader->GetBufferPointer(), classifyShader->GetBufferSize());
+			mRSMTileClassifyPSO.Finalize(device);
+
+			mRSMTilesPSO.SetRootSignature(mRSMTilesRS);
+			mRSMTilesPSO.SetComputeShader(tilesShader->GetBufferPointer(), tilesShader->GetBufferSize());
+			mRSMTilesPSO.Finalize(device);
+
+			mRSMClearTilesPSO.SetRootSignature(mRSMTilesRS);
+			mRSMClearTilesPSO.SetComputeShader(clearShader->GetBufferPointer(), clearShader->GetBufferSize());
+			mRSMClearTilesPSO.Finalize(device);
+		}
+
 		//CB
 		DXRSBuffer::Description cbDesc;
 		cbDesc.mElementSize = sizeof(RSMCBData);
@@ -1338,11 +2215,20 @@ void DXRSExampleGIScene::InitReflectiveShadowMapping(ID3D12Device* device, DXRS:
 		cbDesc.mElementSize = sizeof(RSMCBDataRandomValues);
 		mRSMCB2 = new DXRSBuffer(device, descriptorManager, mSandboxFramework->GetCommandListGraphics(), cbDesc, L"RSM Pass CB 2");
 
+		cbDesc.mElementSize = sizeof(RSMTemporalCBData);
+		mRSMTemporalCB = new DXRSBuffer(device, descriptorManager, mSandboxFramework->GetCommandListGraphics(), cbDesc, L"RSM Temporal CB");
+
+		cbDesc.mElementSize = sizeof(RSMTileClassifyCBData);
+		mRSMTileClassifyCB = new DXRSBuffer(device, descriptorManager, mSandboxFramework->GetCommandListGraphics(), cbDesc, L"RSM Tile Classify CB");
+
+		// scrambled Sobol: the first RSM_SAMPLES_COUNT samples of every quality tier are stratified too
+		std::vector<float> xi;
+		RSMLightTree::MakeSamples(RSM_MAX_SAMPLES_COUNT, xi);
 		RSMCBDataRandomValues rsmPassData2 = {};
-		for (int i = 0; i < RSM_SAMPLES_COUNT; i++)
+		for (int i = 0; i < RSM_MAX_SAMPLES_COUNT; i++)
 		{
-			rsmPassData2.xi[i].x = RandomFloat(0.0f, 1.0f);
-			rsmPassData2.xi[i].y = RandomFloat(0.0f, 1.0f);
+			rsmPassData2.xi[i].x = xi[i * 2];
+			rsmPassData2.xi[i].y = xi[i * 2 + 1];
 			rsmPassData2.xi[i].z = 0.0f;
 			rsmPassData2.xi[i].w = 0.0f;
 		}
@@ -1379,7 +2265,7 @@ void DXRSExampleGIScene::InitReflectiveShadowMapping(ID3D12Device* device, DXRS:
 #endif
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\UpsampleBlurCS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "CSMain", "cs_5_0", compileFlags, 0, &computeShader, &errorBlob));
+		ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\UpsampleBlurCS.hlsl", mBlurPermutations, "CSMain", "cs_5_0", compileFlags, &computeShader, &errorBlob));
 		if (errorBlob)
 		{
 			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -1424,11 +2310,11 @@ void DXRSExampleGIScene::InitReflectiveShadowMapping(ID3D12Device* device, DXRS:
 
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\RSMDownsamplePS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_1", compileFlags, 0, &vertexShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\RSMDownsamplePS.hlsl").c_str(), nullptr, "VSMain", "vs_5_1", compileFlags, &vertexShader, &errorBlob));
 
 		compileFlags |= D3DCOMPILE_ENABLE_UNBOUNDED_DESCRIPTOR_TABLES;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\RSMDownsamplePS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_1", compileFlags, 0, &pixelShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\RSMDownsamplePS.hlsl").c_str(), nullptr, "PSMain", "ps_5_1", compileFlags, &pixelShader, &errorBlob));
 
 		// Define the vertex input layout.
 		D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
@@ -1485,7 +2371,7 @@ void DXRSExampleGIScene::InitReflectiveShadowMapping(ID3D12Device* device, DXRS:
 #endif
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\RSMDownsampleCS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "CSMain", "cs_5_0", compileFlags, 0, &computeShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\RSMDownsampleCS.hlsl").c_str(), nullptr, "CSMain", "cs_5_0", compileFlags, &computeShader, &errorBlob));
 		if (errorBlob)
 		{
 			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -1528,7 +2414,7 @@ void DXRSExampleGIScene::RenderReflectiveShadowMapping(ID3D12Device* device, ID3
 	if (mUseRSM || mUseLPV) {
 		if (!useAsyncCompute || (useAsyncCompute && aQueue == GRAPHICS_QUEUE)) {
 			// buffers generation (pos, normals, flux)
-			PIXBeginEvent(commandList, 0, "RSM buffers generation");
+			mSandboxFramework->BeginGpuEvent(commandList, "RSM buffers generation");
 			{
 				CD3DX12_VIEWPORT rsmBuffersViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, mRSMBuffersRTs[0]->GetWidth(), mRSMBuffersRTs[0]->GetHeight());
 				CD3DX12_RECT rsmRect = CD3DX12_RECT(0.0f, 0.0f, mRSMBuffersRTs[0]->GetWidth(), mRSMBuffersRTs[0]->GetHeight());
@@ -1557,15 +2443,12 @@ void DXRSExampleGIScene::RenderReflectiveShadowMapping(ID3D12Device* device, ID3
 				commandList->ClearRenderTargetView(rtvHandles[1], clearColorBlack, 0, nullptr);
 				commandList->ClearRenderTargetView(rtvHandles[2], clearColorBlack, 0, nullptr);
 
-				DXRS::DescriptorHandle cbvHandle;
+				commandList->SetGraphicsRootConstantBufferView(PerDrawBinding::PASS_PARAMETER, mShadowMappingCB->GetGPUVirtualAddress());
 
+				CPU_PROFILE_SCOPE("RSM buffers draws");
 				for (auto& model : mRenderableObjects) {
-					RenderObject(model, [this, gpuDescriptorHeap, commandList, &cbvHandle, device](U_PTR<DXRSModel>& anObject) {
-						cbvHandle = gpuDescriptorHeap->GetHandleBlock(2);
-						gpuDescriptorHeap->AddToHandle(device, cbvHandle, mShadowMappingCB->GetCBV());
-						gpuDescriptorHeap->AddToHandle(device, cbvHandle, anObject->GetCB()->GetCBV());
-
-						commandList->SetGraphicsRootDescriptorTable(0, cbvHandle.GetGPUHandle());
+					RenderObject(model, [this, commandList](U_PTR<DXRSModel>& anObject) {
+						BindPerDrawData(commandList, *anObject);
 						anObject->Render(commandList);
 					});
 				}
@@ -1574,12 +2457,12 @@ void DXRSExampleGIScene::RenderReflectiveShadowMapping(ID3D12Device* device, ID3
 				commandList->RSSetViewports(1, &viewport);
 				commandList->RSSetScissorRects(1, &rect);
 			}
-			PIXEndEvent(commandList);
+			mSandboxFramework->EndGpuEvent(commandList);
 		}
 		// downsample for LPV
 		if (mRSMDownsampleForLPV) {
 			if ((!useAsyncCompute || (useAsyncCompute && aQueue == GRAPHICS_QUEUE)) && !mRSMDownsampleUseCS) {
-				PIXBeginEvent(commandList, 0, "RSM downsample PS for LPV");
+				mSandboxFramework->BeginGpuEvent(commandList, "RSM downsample PS for LPV");
 				{
 					CD3DX12_VIEWPORT rsmDownsampleResViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, RSM_SIZE / mRSMDownsampleScaleSize, RSM_SIZE / mRSMDownsampleScaleSize);
 					CD3DX12_RECT rsmDownsampleRect = CD3DX12_RECT(0.0f, 0.0f, RSM_SIZE / mRSMDownsampleScaleSize, RSM_SIZE / mRSMDownsampleScaleSize);
@@ -1625,10 +2508,10 @@ void DXRSExampleGIScene::RenderReflectiveShadowMapping(ID3D12Device* device, ID3
 					commandList->RSSetViewports(1, &viewport);
 					commandList->RSSetScissorRects(1, &rect);
 				}
-				PIXEndEvent(commandList);
+				mSandboxFramework->EndGpuEvent(commandList);
 			}
 			else if ((!useAsyncCompute || (useAsyncCompute && aQueue == GRAPHICS_QUEUE)) && mRSMDownsampleUseCS) {
-				PIXBeginEvent(commandList, 0, "RSM downsample CS for LPV");
+				mSandboxFramework->BeginGpuEvent(commandList, "RSM downsample CS for LPV");
 				{
 					commandList->SetPipelineState(mRSMDownsamplePSO_Compute.GetPipelineStateObject());
 					commandList->SetComputeRootSignature(mRSMDownsampleRS_Compute.GetSignature());
@@ -1658,7 +2541,7 @@ void DXRSExampleGIScene::RenderReflectiveShadowMapping(ID3D12Device* device, ID3
 
 					commandList->Dispatch(DivideByMultiple(static_cast<UINT>(RSM_SIZE / mRSMDownsampleScaleSize), 8u), DivideByMultiple(static_cast<UINT>(RSM_SIZE / mRSMDownsampleScaleSize), 8u), 1u);
 				}
-				PIXEndEvent(commandList);
+				mSandboxFramework->EndGpuEvent(commandList);
 			}
 		}
 	}
@@ -1666,7 +2549,7 @@ void DXRSExampleGIScene::RenderReflectiveShadowMapping(ID3D12Device* device, ID3
 	if (mUseRSM) {
 		// calculation
 		if ((!useAsyncCompute || (useAsyncCompute && aQueue == GRAPHICS_QUEUE)) && !mRSMComputeVersion) {
-			PIXBeginEvent(commandList, 0, "RSM main calculation PS");
+			mSandboxFramework->BeginGpuEvent(commandList, "RSM main calculation PS");
 			{
 				CD3DX12_VIEWPORT rsmResViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, mRSMRT->GetWidth(), mRSMRT->GetHeight());
 				CD3DX12_RECT rsmRect = CD3DX12_RECT(0.0f, 0.0f, mRSMRT->GetWidth(), mRSMRT->GetHeight());
@@ -1689,48 +2572,247 @@ void DXRSExampleGIScene::RenderReflectiveShadowMapping(ID3D12Device* device, ID3
 				commandList->SetGraphicsRootDescriptorTable(0, cbvHandleRSM.GetGPUHandle());
 				commandList->SetGraphicsRootDescriptorTable(1, srvHandleRSM.GetGPUHandle());
 
-				commandList->IASetVertexBuffers(0, 1, &mSandboxFramework->GetFullscreenQuadBufferView());
-				commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-				commandList->DrawInstanced(4, 1, 0, 0);
+				commandList->IASetVertexBuffers(0, 1, &mSandboxFramework->GetFullscreenQuadBufferView());
+				commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+				commandList->DrawInstanced(4, 1, 0, 0);
+
+				//reset back
+				commandList->RSSetViewports(1, &viewport);
+				commandList->RSSetScissorRects(1, &rect);
+			}
+			mSandboxFramework->EndGpuEvent(commandList);
+			mRSMHistoryValid = false;
+		}
+		else if ((!useAsyncCompute || (useAsyncCompute && aQueue == COMPUTE_QUEUE)) && mRSMComputeVersion && mRSMUseLightcuts) {
+			std::vector<DXRSRenderTarget*>& rsmBuffers = (useAsyncCompute && mRSMAsyncPreviousFrame) ? mRSMBuffersRTs_CopiesForAsync : mRSMBuffersRTs;
+
+			RenderRSMLightTree(device, commandList, gpuDescriptorHeap, rsmBuffers);
+
+			mSandboxFramework->BeginGpuEvent(commandList, "RSM main calculation lightcuts CS");
+			{
+				commandList->SetPipelineState(mRSMLightcutsPSO.GetPipelineStateObject());
+				commandList->SetComputeRootSignature(mRSMLightcutsRS.GetSignature());
+
+				DXRS::DescriptorHandle cbvHandleRSM = gpuDescriptorHeap->GetHandleBlock(1);
+				gpuDescriptorHeap->AddToHandle(device, cbvHandleRSM, mRSMCB->GetCBV());
+
+				DXRS::DescriptorHandle srvHandleRSM = gpuDescriptorHeap->GetHandleBlock(3);
+				gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, mRSMLightTreeSRVDescriptorHandleCPU);
+				gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, mGbufferRTs[2]->GetSRV());
+				gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, mGbufferRTs[1]->GetSRV());
+
+				DXRS::DescriptorHandle uavHandleRSM = gpuDescriptorHeap->GetHandleBlock(1);
+				gpuDescriptorHeap->AddToHandle(device, uavHandleRSM, mRSMRT->GetUAV());
+
+				RSMLightcutsConstants constants = {};
+				constants.LeafLevel = mRSMLightTreeLeafLevel;
+				constants.StartLevel = RSMLightTree::GetStartLevel(mRSMRMax, mRSMLightTreeLeafLevel);
+				constants.ErrorThreshold = mRSMLightcutsThreshold;
+				constants.MaxClusters = UINT(mRSMLightcutsMaxClusters);
+				constants.RSMSize = RSM_SIZE;
+
+				commandList->SetComputeRootDescriptorTable(0, cbvHandleRSM.GetGPUHandle());
+				commandList->SetComputeRoot32BitConstants(1, sizeof(constants) / 4, &constants, 0);
+				commandList->SetComputeRootDescriptorTable(2, srvHandleRSM.GetGPUHandle());
+				commandList->SetComputeRootDescriptorTable(3, uavHandleRSM.GetGPUHandle());
+
+				commandList->Dispatch(DivideByMultiple(static_cast<UINT>(mRSMRT->GetWidth()), 8u), DivideByMultiple(static_cast<UINT>(mRSMRT->GetHeight()), 8u), 1u);
+			}
+			mSandboxFramework->EndGpuEvent(commandList);
+			mRSMHistoryValid = false;
+		}
+		else if ((!useAsyncCompute || (useAsyncCompute && aQueue == COMPUTE_QUEUE)) && mRSMComputeVersion) {
+			// interleaved or accumulated: the pass writes the interleaved target, resolved into mRSMRT below
+			bool resolveRSM = mRSMInterleaveSize > 1 || mRSMTemporalAccumulation;
+			RSMTemporalTargets* temporalTargets = resolveRSM ? &GetRSMTemporalTargets() : nullptr;
+			DXRSRenderTarget* rsmOutput = resolveRSM ? temporalTargets->mInterleaved : mRSMRT;
+			if (resolveRSM) {
+				// filled here rather than in UpdateBuffers: the UI, a ratio change or new targets may invalidate the history after it
+				RSMTemporalCBData rsmTemporalPassData = {};
+				rsmTemporalPassData.ViewProjection = mCameraView * mCameraProjection;
+				rsmTemporalPassData.PreviousViewProjection = mRSMHistoryValid ? mRSMPreviousViewProjection : rsmTemporalPassData.ViewProjection;
+				rsmTemporalPassData.PreviousInverseViewProjection = XMMatrixInverse(nullptr, rsmTemporalPassData.PreviousViewProjection);
+				rsmTemporalPassData.UpsampleRatio = XMFLOAT2(mGbufferRTs[0]->GetWidth() / mRSMRT->GetWidth(), mGbufferRTs[0]->GetHeight() / mRSMRT->GetHeight());
+				rsmTemporalPassData.InterleaveSize = UINT(mRSMInterleaveSize);
+				rsmTemporalPassData.UseHistory = (mRSMTemporalAccumulation && mRSMHistoryValid) ? 1 : 0;
+				rsmTemporalPassData.HistoryWeight = mRSMHistoryWeight;
+				memcpy(mRSMTemporalCB->Map(), &rsmTemporalPassData, sizeof(rsmTemporalPassData));
+				mRSMPreviousViewProjection = rsmTemporalPassData.ViewProjection;
+			}
+
+			if (resolveRSM) {
+				mSandboxFramework->ResourceBarriersBegin(mBarriers);
+				rsmOutput->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+				mSandboxFramework->ResourceBarriersEnd(mBarriers, commandList);
+			}
+
+			if (mRSMUseTileClassification) {
+				std::vector<DXRSRenderTarget*>& rsmBuffers = (useAsyncCompute && mRSMAsyncPreviousFrame) ? mRSMBuffersRTs_CopiesForAsync : mRSMBuffersRTs;
+				RenderRSMLightTree(device, commandList, gpuDescriptorHeap, rsmBuffers);
+
+				mSandboxFramework->BeginGpuEvent(commandList, "RSM tile classification CS");
+				{
+					RSMTileClassifyCBData classifyData = {};
+					classifyData.ViewProjection = mCameraView * mCameraProjection;
+					classifyData.ShadowViewProjection = mLightViewProjection;
+					classifyData.UpsampleRatio = XMFLOAT2(mGbufferRTs[0]->GetWidth() / mRSMRT->GetWidth(), mGbufferRTs[0]->GetHeight() / mRSMRT->GetHeight());
+					classifyData.OutputWidth = static_cast<UINT>(mRSMRT->GetWidth());
+					classifyData.OutputHeight = static_cast<UINT>(mRSMRT->GetHeight());
+					classifyData.RSMRMax = mRSMRMax;
+					classifyData.NormalVariance = mRSMTileNormalVariance;
+					classifyData.PlaneDistance = mRSMTilePlaneDistance;
+					classifyData.Level = RSMTileClassifier::GetLevel(mRSMRMax, mRSMLightTreeLeafLevel);
+					classifyData.TileCapacity = mRSMTileCapacity;
+					memcpy(mRSMTileClassifyCB->Map(), &classifyData, sizeof(classifyData));
+
+					D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(mRSMTileListsResource.Get(),
+						D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+					commandList->ResourceBarrier(1, &barrier);
+
+					commandList->SetComputeRootSignature(mRSMTileClassifyRS.GetSignature());
+
+					DXRS::DescriptorHandle cbvHandleClassify = gpuDescriptorHeap->GetHandleBlock(1);
+					gpuDescriptorHeap->AddToHandle(device, cbvHandleClassify, mRSMTileClassifyCB->GetCBV());
+
+					DXRS::DescriptorHandle srvHandleClassify = gpuDescriptorHeap->GetHandleBlock(3);
+					gpuDescriptorHeap->AddToHandle(device, srvHandleClassify, mRSMLightTreeSRVDescriptorHandleCPU);
+					gpuDescriptorHeap->AddToHandle(device, srvHandleClassify, mGbufferRTs[2]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleClassify, mGbufferRTs[1]->GetSRV());
+
+					DXRS::DescriptorHandle uavHandleClassify = gpuDescriptorHeap->GetHandleBlock(1);
+					gpuDescriptorHeap->AddToHandle(device, uavHandleClassify, mRSMTileListsUAVDescriptorHandleCPU);
+
+					commandList->SetComputeRootDescriptorTable(0, cbvHandleClassify.GetGPUHandle());
+					commandList->SetComputeRootDescriptorTable(1, srvHandleClassify.GetGPUHandle());
+					commandList->SetComputeRootDescriptorTable(2, uavHandleClassify.GetGPUHandle());
+
+					commandList->SetPipelineState(mRSMTileResetPSO.GetPipelineStateObject());
+					commandList->Dispatch(1u, 1u, 1u);
+
+					barrier = CD3DX12_RESOURCE_BARRIER::UAV(mRSMTileListsResource.Get());
+					commandList->ResourceBarrier(1, &barrier);
+
+					commandList->SetPipelineState(mRSMTileClassifyPSO.GetPipelineStateObject());
+					commandList->Dispatch(RSMTileClassifier::GetTilesX(classifyData.OutputWidth), RSMTileClassifier::GetTilesY(classifyData.OutputHeight), 1u);
+
+					barrier = CD3DX12_RESOURCE_BARRIER::Transition(mRSMTileListsResource.Get(),
+						D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					commandList->ResourceBarrier(1, &barrier);
+				}
+				mSandboxFramework->EndGpuEvent(commandList);
+
+				mSandboxFramework->BeginGpuEvent(commandList, "RSM main calculation tiled CS");
+				{
+					commandList->SetComputeRootSignature(mRSMTilesRS.GetSignature());
+
+					DXRS::DescriptorHandle cbvHandleRSM = gpuDescriptorHeap->GetHandleBlock(2);
+					gpuDescriptorHeap->AddToHandle(device, cbvHandleRSM, mRSMCB->GetCBV());
+					gpuDescriptorHeap->AddToHandle(device, cbvHandleRSM, mRSMCB2->GetCBV());
+
+					DXRS::DescriptorHandle srvHandleRSM = gpuDescriptorHeap->GetHandleBlock(6);
+					gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, rsmBuffers[0]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, rsmBuffers[1]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, rsmBuffers[2]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, mGbufferRTs[2]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, mGbufferRTs[1]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, mRSMTileListsSRVDescriptorHandleCPU);
+
+					DXRS::DescriptorHandle uavHandleRSM = gpuDescriptorHeap->GetHandleBlock(1);
+					gpuDescriptorHeap->AddToHandle(device, uavHandleRSM, rsmOutput->GetUAV());
+
+					commandList->SetComputeRootDescriptorTable(0, cbvHandleRSM.GetGPUHandle());
+					commandList->SetComputeRootDescriptorTable(1, srvHandleRSM.GetGPUHandle());
+					commandList->SetComputeRootDescriptorTable(2, uavHandleRSM.GetGPUHandle());
+
+					// one indirect dispatch per list: full and reduced tiles gather, the rest is cleared
+					for (UINT tileClass = 0; tileClass < RSMTileClassifier::CLASS_COUNT; tileClass++)
+					{
+						RSMTileClassifier::Class listClass = RSMTileClassifier::Class(tileClass);
+						commandList->SetPipelineState(listClass == RSMTileClassifier::CLASS_NONE ? mRSMClearTilesPSO.GetPipelineStateObject() : mRSMTilesPSO.GetPipelineStateObject());
+
+						RSMTileConstants constants = {};
+						constants.TileListOffset = RSMTileClassifier::GetListOffset(listClass, mRSMTileCapacity);
+						constants.TileSampleDivisor = listClass == RSMTileClassifier::CLASS_REDUCED ? RSMTileClassifier::REDUCED_SAMPLES_DIVISOR : 1;
+						commandList->SetComputeRoot32BitConstants(3, sizeof(constants) / 4, &constants, 0);
+						commandList->ExecuteIndirect(mRSMTileDispatchSignature.Get(), 1, mRSMTileListsResource.Get(),
+							UINT64(RSMTileClassifier::GetArgumentsOffset(listClass)) * sizeof(UINT), nullptr, 0);
+					}
+				}
+				mSandboxFramework->EndGpuEvent(commandList);
+			}
+			else {
+				mSandboxFramework->BeginGpuEvent(commandList, "RSM main calculation CS");
+				{
+					commandList->SetPipelineState(mRSMPSO_Compute.GetPipelineStateObject());
+					commandList->SetComputeRootSignature(mRSMRS_Compute.GetSignature());
+
+					DXRS::DescriptorHandle cbvHandleRSM = gpuDescriptorHeap->GetHandleBlock(2);
+					gpuDescriptorHeap->AddToHandle(device, cbvHandleRSM, mRSMCB->GetCBV());
+					gpuDescriptorHeap->AddToHandle(device, cbvHandleRSM, mRSMCB2->GetCBV());
+
+					DXRS::DescriptorHandle srvHandleRSM = gpuDescriptorHeap->GetHandleBlock(5);
+					gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, (useAsyncCompute && mRSMAsyncPreviousFrame) ? mRSMBuffersRTs_CopiesForAsync[0]->GetSRV() : mRSMBuffersRTs[0]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, (useAsyncCompute && mRSMAsyncPreviousFrame) ? mRSMBuffersRTs_CopiesForAsync[1]->GetSRV() : mRSMBuffersRTs[1]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, (useAsyncCompute && mRSMAsyncPreviousFrame) ? mRSMBuffersRTs_CopiesForAsync[2]->GetSRV() : mRSMBuffersRTs[2]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, mGbufferRTs[2]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, mGbufferRTs[1]->GetSRV());
+
+					DXRS::DescriptorHandle uavHandleRSM = gpuDescriptorHeap->GetHandleBlock(1);
+					gpuDescriptorHeap->AddToHandle(device, uavHandleRSM, rsmOutput->GetUAV());
+
+					commandList->SetComputeRootDescriptorTable(0, cbvHandleRSM.GetGPUHandle());
+					commandList->SetComputeRootDescriptorTable(1, srvHandleRSM.GetGPUHandle());
+					commandList->SetComputeRootDescriptorTable(2, uavHandleRSM.GetGPUHandle());
+
+					commandList->Dispatch(DivideByMultiple(static_cast<UINT>(mRSMRT->GetWidth()), 8u), DivideByMultiple(static_cast<UINT>(mRSMRT->GetHeight()), 8u), 1u);
+				}
+				mSandboxFramework->EndGpuEvent(commandList);
+			}
+
+			if (resolveRSM) {
+				mSandboxFramework->BeginGpuEvent(commandList, "RSM de-interleave & temporal CS");
+				{
+					DXRSRenderTarget* history = temporalTargets->mHistory[mRSMHistoryIndex];
+					DXRSRenderTarget* newHistory = temporalTargets->mHistory[1 - mRSMHistoryIndex];
+
+					mSandboxFramework->ResourceBarriersBegin(mBarriers);
+					rsmOutput->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					history->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					newHistory->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+					mSandboxFramework->ResourceBarriersEnd(mBarriers, commandList);
 
-				//reset back
-				commandList->RSSetViewports(1, &viewport);
-				commandList->RSSetScissorRects(1, &rect);
-			}
-			PIXEndEvent(commandList);
-		}
-		else if ((!useAsyncCompute || (useAsyncCompute && aQueue == COMPUTE_QUEUE)) && mRSMComputeVersion) {
-			PIXBeginEvent(commandList, 0, "RSM main calculation CS");
-			{
-				commandList->SetPipelineState(mRSMPSO_Compute.GetPipelineStateObject());
-				commandList->SetComputeRootSignature(mRSMRS_Compute.GetSignature());
+					commandList->SetPipelineState(mRSMTemporalPSO.GetPipelineStateObject());
+					commandList->SetComputeRootSignature(mRSMTemporalRS.GetSignature());
 
-				DXRS::DescriptorHandle cbvHandleRSM = gpuDescriptorHeap->GetHandleBlock(2);
-				gpuDescriptorHeap->AddToHandle(device, cbvHandleRSM, mRSMCB->GetCBV());
-				gpuDescriptorHeap->AddToHandle(device, cbvHandleRSM, mRSMCB2->GetCBV());
+					DXRS::DescriptorHandle cbvHandleTemporal = gpuDescriptorHeap->GetHandleBlock(1);
+					gpuDescriptorHeap->AddToHandle(device, cbvHandleTemporal, mRSMTemporalCB->GetCBV());
 
-				DXRS::DescriptorHandle srvHandleRSM = gpuDescriptorHeap->GetHandleBlock(5);
-				gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, useAsyncCompute ? mRSMBuffersRTs_CopiesForAsync[0]->GetSRV() : mRSMBuffersRTs[0]->GetSRV());
-				gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, useAsyncCompute ? mRSMBuffersRTs_CopiesForAsync[1]->GetSRV() : mRSMBuffersRTs[1]->GetSRV());
-				gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, useAsyncCompute ? mRSMBuffersRTs_CopiesForAsync[2]->GetSRV() : mRSMBuffersRTs[2]->GetSRV());
-				gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, mGbufferRTs[2]->GetSRV());
-				gpuDescriptorHeap->AddToHandle(device, srvHandleRSM, mGbufferRTs[1]->GetSRV());
+					DXRS::DescriptorHandle srvHandleTemporal = gpuDescriptorHeap->GetHandleBlock(4);
+					gpuDescriptorHeap->AddToHandle(device, srvHandleTemporal, rsmOutput->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleTemporal, mGbufferRTs[2]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleTemporal, mGbufferRTs[1]->GetSRV());
+					gpuDescriptorHeap->AddToHandle(device, srvHandleTemporal, history->GetSRV());
 
-				DXRS::DescriptorHandle uavHandleRSM = gpuDescriptorHeap->GetHandleBlock(1);
-				gpuDescriptorHeap->AddToHandle(device, uavHandleRSM, mRSMRT->GetUAV());
+					DXRS::DescriptorHandle uavHandleTemporal = gpuDescriptorHeap->GetHandleBlock(2);
+					gpuDescriptorHeap->AddToHandle(device, uavHandleTemporal, mRSMRT->GetUAV());
+					gpuDescriptorHeap->AddToHandle(device, uavHandleTemporal, newHistory->GetUAV());
 
-				commandList->SetComputeRootDescriptorTable(0, cbvHandleRSM.GetGPUHandle());
-				commandList->SetComputeRootDescriptorTable(1, srvHandleRSM.GetGPUHandle());
-				commandList->SetComputeRootDescriptorTable(2, uavHandleRSM.GetGPUHandle());
+					commandList->SetComputeRootDescriptorTable(0, cbvHandleTemporal.GetGPUHandle());
+					commandList->SetComputeRootDescriptorTable(1, srvHandleTemporal.GetGPUHandle());
+					commandList->SetComputeRootDescriptorTable(2, uavHandleTemporal.GetGPUHandle());
 
-				commandList->Dispatch(DivideByMultiple(static_cast<UINT>(mRSMRT->GetWidth()), 8u), DivideByMultiple(static_cast<UINT>(mRSMRT->GetHeight()), 8u), 1u);
+					commandList->Dispatch(DivideByMultiple(static_cast<UINT>(mRSMRT->GetWidth()), 8u), DivideByMultiple(static_cast<UINT>(mRSMRT->GetHeight()), 8u), 1u);
+				}
+				mSandboxFramework->EndGpuEvent(commandList);
+
+				mRSMHistoryIndex = 1 - mRSMHistoryIndex;
 			}
-			PIXEndEvent(commandList);
+			mRSMHistoryValid = resolveRSM;
 		}
 
 		if ((!useAsyncCompute || (useAsyncCompute && aQueue == COMPUTE_QUEUE)) && mRSMUseUpsampleAndBlur) {
 			// upsample & blur
-			PIXBeginEvent(commandList, 0, "RSM upsample & blur CS");
+			mSandboxFramework->BeginGpuEvent(commandList, "RSM upsample & blur CS");
 			{
 				commandList->SetPipelineState(mRSMUpsampleAndBlurPSO.GetPipelineStateObject());
 				commandList->SetComputeRootSignature(mRSMUpsampleAndBlurRS.GetSignature());
@@ -1754,24 +2836,123 @@ void DXRSExampleGIScene::RenderReflectiveShadowMapping(ID3D12Device* device, ID3
 
 				commandList->Dispatch(DivideByMultiple(static_cast<UINT>(mRSMUpsampleAndBlurRT->GetWidth()), 8u), DivideByMultiple(static_cast<UINT>(mRSMUpsampleAndBlurRT->GetHeight()), 8u), 1u);
 			}
-			PIXEndEvent(commandList);
+			mSandboxFramework->EndGpuEvent(commandList);
 		}
 	}
+	else
+		mRSMHistoryValid = false;
 	//else if (!useAsyncCompute && !computeOnly) //TODO fix for UAV clear
 	//	clearRSMRT();
 }
 
+void DXRSExampleGIScene::CopyRSMCapture(ID3D12GraphicsCommandList* commandList)
+{
+	ID3D12Device* device = mSandboxFramework->GetD3DDevice();
+	DXRSRenderTarget* targets[RSM_CAPTURE_TARGETS] = { mRSMBuffersRTs[0], mRSMBuffersRTs[1], mRSMBuffersRTs[2], mGbufferRTs[2], mGbufferRTs[1] };
+	D3D12_RESOURCE_STATES states[RSM_CAPTURE_TARGETS];
+
+	mSandboxFramework->BeginGpuEvent(commandList, "Copy RSM capture");
+	{
+		mSandboxFramework->ResourceBarriersBegin(mBarriers);
+		for (int i = 0; i < RSM_CAPTURE_TARGETS; i++)
+		{
+			states[i] = targets[i]->GetCurrentState();
+			targets[i]->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_COPY_SOURCE);
+		}
+		mSandboxFramework->ResourceBarriersEnd(mBarriers, commandList);
+
+		for (int i = 0; i < RSM_CAPTURE_TARGETS; i++)
+		{
+			D3D12_RESOURCE_DESC desc = targets[i]->GetResource()->GetDesc();
+			UINT64 size = 0;
+			device->GetCopyableFootprints(&desc, 0, 1, 0, &mRSMCaptureFootprints[i], nullptr, nullptr, &size);
+			ThrowIfFailed(device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK), D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(size),
+				D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(mRSMCaptureReadbacks[i].ReleaseAndGetAddressOf())));
+			mRSMCaptureReadbacks[i]->SetName(L"RSM capture readback");
+
+			CD3DX12_TEXTURE_COPY_LOCATION destination(mRSMCaptureReadbacks[i].Get(), mRSMCaptureFootprints[i]);
+			CD3DX12_TEXTURE_COPY_LOCATION source(targets[i]->GetResource(), 0);
+			commandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+		}
+
+		mSandboxFramework->ResourceBarriersBegin(mBarriers);
+		for (int i = 0; i < RSM_CAPTURE_TARGETS; i++)
+			targets[i]->TransitionTo(mBarriers, commandList, states[i]);
+		mSandboxFramework->ResourceBarriersEnd(mBarriers, commandList);
+	}
+	mSandboxFramework->EndGpuEvent(commandList);
+
+	mRSMCaptureShadowViewProjection = mLightViewProjection;
+	mRSMCaptureRMax = mRSMRMax;
+	mRSMCaptureRequested = false;
+	mRSMCapturePending = true;
+}
+
+void DXRSExampleGIScene::WriteRSMCapture()
+{
+	CPU_PROFILE_SCOPE("RSM capture");
+
+	// a one off stall, the copies were recorded last frame
+	mSandboxFramework->WaitForGpu();
+	mRSMCapturePending = false;
+
+	RSMCapture capture;
+	capture.mRSMSize = RSM_SIZE;
+	capture.mWidth = UINT(mRSMCaptureFootprints[3].Footprint.Width);
+	capture.mHeight = mRSMCaptureFootprints[3].Footprint.Height;
+	XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(capture.mShadowViewProjection), mRSMCaptureShadowViewProjection);
+	capture.mRMax = mRSMCaptureRMax;
+
+	std::vector<float>* outputs[RSM_CAPTURE_TARGETS] = { &capture.mRSMPositions, &capture.mRSMNormals, &capture.mRSMFlux, &capture.mPositions, &capture.mNormals };
+	for (int i = 0; i < RSM_CAPTURE_TARGETS; i++)
+	{
+		const D3D12_SUBRESOURCE_FOOTPRINT& footprint = mRSMCaptureFootprints[i].Footprint;
+		outputs[i]->resize(size_t(footprint.Width) * footprint.Height * 4);
+
+		void* mapped = nullptr;
+		ThrowIfFailed(mRSMCaptureReadbacks[i]->Map(0, nullptr, &mapped));
+		const uint8_t* data = static_cast<const uint8_t*>(mapped);
+		for (UINT y = 0; y < footprint.Height; y++)
+		{
+			const uint8_t* row = data + mRSMCaptureFootprints[i].Offset + size_t(y) * footprint.RowPitch;
+			float* texels = outputs[i]->data() + size_t(y) * footprint.Width * 4;
+			for (UINT x = 0; x < footprint.Width * 4; x++)
+			{
+				switch (footprint.Format)
+				{
+				case DXGI_FORMAT_R32G32B32A32_FLOAT:
+					texels[x] = reinterpret_cast<const float*>(row)[x];
+					break;
+				case DXGI_FORMAT_R16G16B16A16_FLOAT:
+					texels[x] = PackedVector::XMConvertHalfToFloat(reinterpret_cast<const PackedVector::HALF*>(row)[x]);
+					break;
+				case DXGI_FORMAT_R16G16B16A16_SNORM:
+					texels[x] = std::max(reinterpret_cast<const int16_t*>(row)[x] / 32767.0f, -1.0f);
+					break;
+				default:	// DXGI_FORMAT_R8G8B8A8_UNORM
+					texels[x] = row[x] / 255.0f;
+					break;
+				}
+			}
+		}
+		D3D12_RANGE written = { 0, 0 };
+		mRSMCaptureReadbacks[i]->Unmap(0, &written);
+		mRSMCaptureReadbacks[i].Reset();
+	}
+
+	std::string error;
+	if (capture.Save(mSandboxFramework->GetFilePath("profiling\\rsm_capture.bin"), error))
+		mRSMCaptureStatus = "written to profiling\\rsm_capture.bin";
+	else
+		mRSMCaptureStatus = error;
+}
+
 void DXRSExampleGIScene::InitLightPropagationVolume(ID3D12Device* device, DXRS::DescriptorHeapManager* descriptorManager)
 {
 	// injection
 	{
-		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-
-		//red
-		mLPVSHColorsRTs.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Red SH LPV", LPV_DIM));
-		mLPVSHColorsRTs.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Green SH LPV", LPV_DIM));
-		mLPVSHColorsRTs.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Blue SH LPV", LPV_DIM));
+		DXGI_FORMAT format = GetLPVSHFormat(mLPVSHEncoding);
+		SelectLPVSHRenderTargets(mLPVSHEncoding);
 
 		//create root signature
 		D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
@@ -1798,9 +2979,9 @@ void DXRSExampleGIScene::InitLightPropagationVolume(ID3D12Device* device, DXRS::
 
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVInjection.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_1", compileFlags, 0, &vertexShader, &errorBlob));
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVInjection.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "GSMain", "gs_5_1", compileFlags, 0, &geometryShader, &errorBlob));
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVInjection.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_1", compileFlags, 0, &pixelShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVInjection.hlsl").c_str(), nullptr, "VSMain", "vs_5_1", compileFlags, &vertexShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVInjection.hlsl").c_str(), nullptr, "GSMain", "gs_5_1", compileFlags, &geometryShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVInjection.hlsl").c_str(), nullptr, "PSMain", "ps_5_1", compileFlags, &pixelShader, &errorBlob));
 
 		DXGI_FORMAT formats[3];
 		formats[0] = formats[1] = formats[2] = format;
@@ -1851,13 +3032,7 @@ void DXRSExampleGIScene::InitLightPropagationVolume(ID3D12Device* device, DXRS::
 			ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_BUNDLE, mLPVPropagationBundle2Allocator.Get(), nullptr, IID_PPV_ARGS(&mLPVPropagationBundle2)));
 		}
 
-		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-
-		//red
-		mLPVAccumulationSHColorsRTs.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Accumulation Red SH LPV", LPV_DIM));
-		mLPVAccumulationSHColorsRTs.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Accumulation Green SH LPV", LPV_DIM));
-		mLPVAccumulationSHColorsRTs.push_back(new DXRSRenderTarget(device, descriptorManager, LPV_DIM, LPV_DIM, format, flags, L"Accumulation Blue SH LPV", LPV_DIM));
+		DXGI_FORMAT format = GetLPVSHFormat(mLPVSHEncoding);
 
 		//create root signature
 		D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
@@ -1867,7 +3042,7 @@ void DXRSExampleGIScene::InitLightPropagationVolume(ID3D12Device* device, DXRS::
 			D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS;
 
 		mLPVPropagationRS.Reset(1, 0);
-		mLPVPropagationRS[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 3, D3D12_SHADER_VISIBILITY_ALL);
+		mLPVPropagationRS[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 4, D3D12_SHADER_VISIBILITY_ALL);
 		mLPVPropagationRS.Finalize(device, L"LPV Propagation pass RS", rootSignatureFlags);
 
 		ComPtr<ID3DBlob> vertexShader;
@@ -1883,9 +3058,9 @@ void DXRSExampleGIScene::InitLightPropagationVolume(ID3D12Device* device, DXRS::
 
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVPropagation.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_1", compileFlags, 0, &vertexShader, &errorBlob));
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVPropagation.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "GSMain", "gs_5_1", compileFlags, 0, &geometryShader, &errorBlob));
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVPropagation.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_1", compileFlags, 0, &pixelShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVPropagation.hlsl").c_str(), nullptr, "VSMain", "vs_5_1", compileFlags, &vertexShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVPropagation.hlsl").c_str(), nullptr, "GSMain", "gs_5_1", compileFlags, &geometryShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\LPVPropagation.hlsl").c_str(), nullptr, "PSMain", "ps_5_1", compileFlags, &pixelShader, &errorBlob));
 
 		DXGI_FORMAT formats[6];
 		formats[0] = formats[1] = formats[2] = formats[3] = formats[4] = formats[5] = format;
@@ -1908,61 +3083,68 @@ void DXRSExampleGIScene::RenderLightPropagationVolume(ID3D12Device* device, ID3D
 	CD3DX12_VIEWPORT viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, mSandboxFramework->GetOutputSize().right, mSandboxFramework->GetOutputSize().bottom);
 	CD3DX12_RECT rect = CD3DX12_RECT(0.0f, 0.0f, mSandboxFramework->GetOutputSize().right, mSandboxFramework->GetOutputSize().bottom);
 
-	if (mUseLPV) {
-		PIXBeginEvent(commandList, 0, "LPV Injection");
-		{
-			CD3DX12_VIEWPORT lpvBuffersViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, LPV_DIM, LPV_DIM);
-			CD3DX12_RECT lpvRect = CD3DX12_RECT(0.0f, 0.0f, LPV_DIM, LPV_DIM);
-			commandList->RSSetViewports(1, &lpvBuffersViewport);
-			commandList->RSSetScissorRects(1, &lpvRect);
+	// amortized frames continue the propagation of the previous ones, or skip it once it ran all steps
+	LPVPropagationScheduler::Action action = mLPVAmortize ? mLPVScheduler.GetAction() : LPVPropagationScheduler::ACTION_RESTART;
+	bool restart = action == LPVPropagationScheduler::ACTION_RESTART;
 
-			commandList->SetPipelineState(mLPVInjectionPSO.GetPipelineStateObject());
-			commandList->SetGraphicsRootSignature(mLPVInjectionRS.GetSignature());
+	if (mUseLPV && action != LPVPropagationScheduler::ACTION_SKIP) {
+		if (restart) {
+			// one point per RSM texel, VPLs are not clustered per cell on the GPU (LPVClustering is a CPU reference)
+			mSandboxFramework->BeginGpuEvent(commandList, "LPV Injection");
+			{
+				CD3DX12_VIEWPORT lpvBuffersViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, LPV_DIM, LPV_DIM);
+				CD3DX12_RECT lpvRect = CD3DX12_RECT(0.0f, 0.0f, LPV_DIM, LPV_DIM);
+				commandList->RSSetViewports(1, &lpvBuffersViewport);
+				commandList->RSSetScissorRects(1, &lpvRect);
 
-			mSandboxFramework->ResourceBarriersBegin(mBarriers);
-			mLPVSHColorsRTs[0]->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_RENDER_TARGET);
-			mLPVSHColorsRTs[1]->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_RENDER_TARGET);
-			mLPVSHColorsRTs[2]->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_RENDER_TARGET);
-			mSandboxFramework->ResourceBarriersEnd(mBarriers, commandList);
+				commandList->SetPipelineState(mLPVInjectionPSO.GetPipelineStateObject());
+				commandList->SetGraphicsRootSignature(mLPVInjectionRS.GetSignature());
 
-			D3D12_CPU_DESCRIPTOR_HANDLE rtvHandlesLPVInjection[] =
-			{
-				mLPVSHColorsRTs[0]->GetRTV().GetCPUHandle(),
-				mLPVSHColorsRTs[1]->GetRTV().GetCPUHandle(),
-				mLPVSHColorsRTs[2]->GetRTV().GetCPUHandle()
-			};
+				mSandboxFramework->ResourceBarriersBegin(mBarriers);
+				mLPVSHColorsRTs[0]->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_RENDER_TARGET);
+				mLPVSHColorsRTs[1]->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_RENDER_TARGET);
+				mLPVSHColorsRTs[2]->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_RENDER_TARGET);
+				mSandboxFramework->ResourceBarriersEnd(mBarriers, commandList);
 
-			commandList->OMSetRenderTargets(_countof(rtvHandlesLPVInjection), rtvHandlesLPVInjection, FALSE, nullptr);
-			commandList->ClearRenderTargetView(rtvHandlesLPVInjection[0], clearColorBlack, 0, nullptr);
-			commandList->ClearRenderTargetView(rtvHandlesLPVInjection[1], clearColorBlack, 0, nullptr);
-			commandList->ClearRenderTargetView(rtvHandlesLPVInjection[2], clearColorBlack, 0, nullptr);
+				D3D12_CPU_DESCRIPTOR_HANDLE rtvHandlesLPVInjection[] =
+				{
+					mLPVSHColorsRTs[0]->GetRTV().GetCPUHandle(),
+					mLPVSHColorsRTs[1]->GetRTV().GetCPUHandle(),
+					mLPVSHColorsRTs[2]->GetRTV().GetCPUHandle()
+				};
 
-			DXRS::DescriptorHandle cbvHandleLPVInjection = gpuDescriptorHeap->GetHandleBlock(2);
-			gpuDescriptorHeap->AddToHandle(device, cbvHandleLPVInjection, mLPVCB->GetCBV());
-			gpuDescriptorHeap->AddToHandle(device, cbvHandleLPVInjection, mRSMDownsampleCB->GetCBV());
+				commandList->OMSetRenderTargets(_countof(rtvHandlesLPVInjection), rtvHandlesLPVInjection, FALSE, nullptr);
+				commandList->ClearRenderTargetView(rtvHandlesLPVInjection[0], clearColorBlack, 0, nullptr);
+				commandList->ClearRenderTargetView(rtvHandlesLPVInjection[1], clearColorBlack, 0, nullptr);
+				commandList->ClearRenderTargetView(rtvHandlesLPVInjection[2], clearColorBlack, 0, nullptr);
 
-			DXRS::DescriptorHandle srvHandleLPVInjection = gpuDescriptorHeap->GetHandleBlock(3);
-			gpuDescriptorHeap->AddToHandle(device, srvHandleLPVInjection, (mRSMDownsampleForLPV) ? mRSMDownsampledBuffersRTs[0]->GetSRV() : mRSMBuffersRTs[0]->GetSRV());
-			gpuDescriptorHeap->AddToHandle(device, srvHandleLPVInjection, (mRSMDownsampleForLPV) ? mRSMDownsampledBuffersRTs[1]->GetSRV() : mRSMBuffersRTs[1]->GetSRV());
-			gpuDescriptorHeap->AddToHandle(device, srvHandleLPVInjection, (mRSMDownsampleForLPV) ? mRSMDownsampledBuffersRTs[2]->GetSRV() : mRSMBuffersRTs[2]->GetSRV());
+				DXRS::DescriptorHandle cbvHandleLPVInjection = gpuDescriptorHeap->GetHandleBlock(2);
+				gpuDescriptorHeap->AddToHandle(device, cbvHandleLPVInjection, mLPVCB->GetCBV());
+				gpuDescriptorHeap->AddToHandle(device, cbvHandleLPVInjection, mRSMDownsampleCB->GetCBV());
 
-			commandList->SetGraphicsRootDescriptorTable(0, cbvHandleLPVInjection.GetGPUHandle());
-			commandList->SetGraphicsRootDescriptorTable(1, srvHandleLPVInjection.GetGPUHandle());
+				DXRS::DescriptorHandle srvHandleLPVInjection = gpuDescriptorHeap->GetHandleBlock(3);
+				gpuDescriptorHeap->AddToHandle(device, srvHandleLPVInjection, (mRSMDownsampleForLPV) ? mRSMDownsampledBuffersRTs[0]->GetSRV() : mRSMBuffersRTs[0]->GetSRV());
+				gpuDescriptorHeap->AddToHandle(device, srvHandleLPVInjection, (mRSMDownsampleForLPV) ? mRSMDownsampledBuffersRTs[1]->GetSRV() : mRSMBuffersRTs[1]->GetSRV());
+				gpuDescriptorHeap->AddToHandle(device, srvHandleLPVInjection, (mRSMDownsampleForLPV) ? mRSMDownsampledBuffersRTs[2]->GetSRV() : mRSMBuffersRTs[2]->GetSRV());
 
-			commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_POINTLIST);
+				commandList->SetGraphicsRootDescriptorTable(0, cbvHandleLPVInjection.GetGPUHandle());
+				commandList->SetGraphicsRootDescriptorTable(1, srvHandleLPVInjection.GetGPUHandle());
 
-			if (!mRSMDownsampleForLPV)
-				commandList->DrawInstanced(RSM_SIZE * RSM_SIZE, 1, 0, 0);
-			else
-				commandList->DrawInstanced(RSM_SIZE * RSM_SIZE / (mRSMDownsampleScaleSize * mRSMDownsampleScaleSize), 1, 0, 0);
+				commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_POINTLIST);
 
-			//reset back
-			commandList->RSSetViewports(1, &viewport);
-			commandList->RSSetScissorRects(1, &rect);
+				if (!mRSMDownsampleForLPV)
+					commandList->DrawInstanced(RSM_SIZE * RSM_SIZE, 1, 0, 0);
+				else
+					commandList->DrawInstanced(RSM_SIZE * RSM_SIZE / (mRSMDownsampleScaleSize * mRSMDownsampleScaleSize), 1, 0, 0);
+
+				//reset back
+				commandList->RSSetViewports(1, &viewport);
+				commandList->RSSetScissorRects(1, &rect);
+			}
+			mSandboxFramework->EndGpuEvent(commandList);
 		}
-		PIXEndEvent(commandList);
 
-		PIXBeginEvent(commandList, 0, "LPV Propagation");
+		mSandboxFramework->BeginGpuEvent(commandList, "LPV Propagation");
 		{
 			D3D12_CPU_DESCRIPTOR_HANDLE rtvHandlesLPVPropagation[] =
 			{
@@ -1989,14 +3171,19 @@ void DXRSExampleGIScene::RenderLightPropagationVolume(ID3D12Device* device, ID3D
 
 			commandList->OMSetRenderTargets(_countof(rtvHandlesLPVPropagation), rtvHandlesLPVPropagation, FALSE, nullptr);
 			commandList->OMSetBlendFactor(clearColorWhite);
-			commandList->ClearRenderTargetView(rtvHandlesLPVPropagation[3], clearColorBlack, 0, nullptr);
-			commandList->ClearRenderTargetView(rtvHandlesLPVPropagation[4], clearColorBlack, 0, nullptr);
-			commandList->ClearRenderTargetView(rtvHandlesLPVPropagation[5], clearColorBlack, 0, nullptr);
+			if (restart) {
+				commandList->ClearRenderTargetView(rtvHandlesLPVPropagation[3], clearColorBlack, 0, nullptr);
+				commandList->ClearRenderTargetView(rtvHandlesLPVPropagation[4], clearColorBlack, 0, nullptr);
+				commandList->ClearRenderTargetView(rtvHandlesLPVPropagation[5], clearColorBlack, 0, nullptr);
+			}
 
 			// if bundles are used, record 1, then record 2, then use 1, then use 2, etc.
 			// we need 2 bundles since GPU descriptor heap is double buffered and a bundle has to share the same GPU descriptor heap with a parent command list
+			// amortized frames run a varying number of steps, they record them directly
+			bool useBundle = mUseBundleForLPVPropagation && !mLPVAmortize;
+			int steps = mLPVAmortize ? int(mLPVScheduler.GetStepBudget()) : mLPVPropagationSteps;
 			ID3D12GraphicsCommandList* commandListPropagation = commandList;
-			if (mUseBundleForLPVPropagation && !mLPVPropagationBundlesClosed) {
+			if (useBundle && !mLPVPropagationBundlesClosed) {
 				if (!mLPVPropagationBundle1Closed) 
 					commandListPropagation = mLPVPropagationBundle1.Get();
 				else if (!mLPVPropagationBundle2Closed) 
@@ -2010,22 +3197,23 @@ void DXRSExampleGIScene::RenderLightPropagationVolume(ID3D12Device* device, ID3D
 			commandListPropagation->SetPipelineState(mLPVPropagationPSO.GetPipelineStateObject());
 			commandListPropagation->SetGraphicsRootSignature(mLPVPropagationRS.GetSignature());
 
-			auto srvHandleLPVInjection = gpuDescriptorHeap->GetHandleBlock(3);
+			auto srvHandleLPVInjection = gpuDescriptorHeap->GetHandleBlock(4);
 			gpuDescriptorHeap->AddToHandle(device, srvHandleLPVInjection, mLPVSHColorsRTs[0]->GetSRV());
 			gpuDescriptorHeap->AddToHandle(device, srvHandleLPVInjection, mLPVSHColorsRTs[1]->GetSRV());
 			gpuDescriptorHeap->AddToHandle(device, srvHandleLPVInjection, mLPVSHColorsRTs[2]->GetSRV());
+			gpuDescriptorHeap->AddToHandle(device, srvHandleLPVInjection, mLPVGeometryVolumeDescriptorHandleCPU);
 			commandListPropagation->SetGraphicsRootDescriptorTable(0, srvHandleLPVInjection.GetGPUHandle());
 
 			//recording a bundle (or just normal command list)
-			if (!mUseBundleForLPVPropagation || (mUseBundleForLPVPropagation && !mLPVPropagationBundlesClosed)) {
-				for (int step = 0; step < mLPVPropagationSteps; step++) {
+			if (!useBundle || (useBundle && !mLPVPropagationBundlesClosed)) {
+				for (int step = 0; step < steps; step++) {
 					commandListPropagation->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-					commandListPropagation->DrawInstanced(3, LPV_DIM, 0, 0);
+					commandListPropagation->DrawInstanced(3, LPV_DIM * mLPVCascades.GetCascadeCount(), 0, 0);
 				}
 			}
 
 			//executing a bundle depending on the frame index
-			if (mUseBundleForLPVPropagation) {
+			if (useBundle) {
 				if (!mLPVPropagationBundlesClosed && !mLPVPropagationBundle1Closed) {
 					mLPVPropagationBundle1.Get()->Close();
 					mLPVPropagationBundle1Closed = true;
@@ -2042,8 +3230,11 @@ void DXRSExampleGIScene::RenderLightPropagationVolume(ID3D12Device* device, ID3D
 				else if (mLPVPropagationBundle2UsedGPUHeap == gpuDescriptorHeap) 
 					commandList->ExecuteBundle(mLPVPropagationBundle2.Get());
 			}
+
+			if (mLPVAmortize)
+				mLPVScheduler.EndSteps(uint32_t(steps));
 		}
-		PIXEndEvent(commandList);
+		mSandboxFramework->EndGpuEvent(commandList);
 
 		//reset back
 		commandList->RSSetViewports(1, &viewport);
@@ -2051,44 +3242,29 @@ void DXRSExampleGIScene::RenderLightPropagationVolume(ID3D12Device* device, ID3D
 	}
 }
 
+void DXRSExampleGIScene::ResetLPVPropagationBundles()
+{
+	// a bundle that is still open has not recorded anything yet
+	if (mLPVPropagationBundle1Closed)
+		mLPVPropagationBundle1->Reset(mLPVPropagationBundle1Allocator.Get(), nullptr);
+	if (mLPVPropagationBundle2Closed)
+		mLPVPropagationBundle2->Reset(mLPVPropagationBundle2Allocator.Get(), nullptr);
+	mLPVPropagationBundle1Closed = false;
+	mLPVPropagationBundle2Closed = false;
+	mLPVPropagationBundlesClosed = false;
+}
+
 void DXRSExampleGIScene::InitVoxelConeTracing(ID3D12Device* device, DXRS::DescriptorHeapManager* descriptorManager)
 {
 	// voxelization
 	{
-		D3D12_SAMPLER_DESC shadowSampler = {};
-		shadowSampler.Filter = D3D12_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
-		shadowSampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
-		shadowSampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
-		shadowSampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-		shadowSampler.ComparisonFunc = D3D12_COMPARISON_FUNC_LESS_EQUAL;
-		shadowSampler.MipLODBias = 0;
-		shadowSampler.MaxAnisotropy = 16;
-		shadowSampler.MinLOD = 0.0f;
-		shadowSampler.MaxLOD = D3D12_FLOAT32_MAX;
-		shadowSampler.BorderColor[0] = 1.0f;
-		shadowSampler.BorderColor[1] = 1.0f;
-		shadowSampler.BorderColor[2] = 1.0f;
-		shadowSampler.BorderColor[3] = 1.0f;
-
 		DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
 		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
 
 		mVCTVoxelization3DRT = new DXRSRenderTarget(device, descriptorManager, VCT_SCENE_VOLUME_SIZE, VCT_SCENE_VOLUME_SIZE, format, flags, L"Voxelization Scene Data 3D", VCT_SCENE_VOLUME_SIZE);
 		mVCTVoxelization3DRT_CopyForAsync = new DXRSRenderTarget(device, descriptorManager, VCT_SCENE_VOLUME_SIZE, VCT_SCENE_VOLUME_SIZE, format, flags, L"Voxelization Scene Data 3D Copy", VCT_SCENE_VOLUME_SIZE);
 
-		//create root signature
-		D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
-			D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
-			D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
-			D3D12_ROOT_SIGNATURE_FLAG_ALLOW_STREAM_OUTPUT |
-			D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS;
-
-		mVCTVoxelizationRS.Reset(3, 1);
-		mVCTVoxelizationRS.InitStaticSampler(0, shadowSampler, D3D12_SHADER_VISIBILITY_PIXEL);
-		mVCTVoxelizationRS[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 0, 2, D3D12_SHADER_VISIBILITY_ALL);
-		mVCTVoxelizationRS[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 1, D3D12_SHADER_VISIBILITY_ALL);
-		mVCTVoxelizationRS[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 1, D3D12_SHADER_VISIBILITY_ALL);
-		mVCTVoxelizationRS.Finalize(device, L"VCT voxelization pass RS", rootSignatureFlags);
+		InitPerDrawRootSignature(device, PerDrawBinding::PASS_VOXELIZATION);
 
 		ComPtr<ID3DBlob> vertexShader;
 		ComPtr<ID3DBlob> geometryShader;
@@ -2103,19 +3279,19 @@ void DXRSExampleGIScene::InitVoxelConeTracing(ID3D12Device* device, DXRS::Descri
 
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelization.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_1", compileFlags, 0, &vertexShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelization.hlsl").c_str(), nullptr, "VSMain", "vs_5_1", compileFlags, &vertexShader, &errorBlob));
 		if (errorBlob)
 		{
 			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
 			errorBlob->Release();
 		}
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelization.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "GSMain", "gs_5_1", compileFlags, 0, &geometryShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelization.hlsl").c_str(), nullptr, "GSMain", "gs_5_1", compileFlags, &geometryShader, &errorBlob));
 		if (errorBlob)
 		{
 			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
 			errorBlob->Release();
 		}
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelization.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_1", compileFlags, 0, &pixelShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelization.hlsl").c_str(), nullptr, "PSMain", "ps_5_1", compileFlags, &pixelShader, &errorBlob));
 		if (errorBlob)
 		{
 			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -2191,9 +3367,9 @@ void DXRSExampleGIScene::InitVoxelConeTracing(ID3D12Device* device, DXRS::Descri
 
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelizationDebug.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_1", compileFlags, 0, &vertexShader, &errorBlob));
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelizationDebug.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "GSMain", "gs_5_1", compileFlags, 0, &geometryShader, &errorBlob));
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelizationDebug.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_1", compileFlags, 0, &pixelShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelizationDebug.hlsl").c_str(), nullptr, "VSMain", "vs_5_1", compileFlags, &vertexShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelizationDebug.hlsl").c_str(), nullptr, "GSMain", "gs_5_1", compileFlags, &geometryShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingVoxelizationDebug.hlsl").c_str(), nullptr, "PSMain", "ps_5_1", compileFlags, &pixelShader, &errorBlob));
 
 		DXGI_FORMAT formats[1];
 		formats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -2246,7 +3422,7 @@ void DXRSExampleGIScene::InitVoxelConeTracing(ID3D12Device* device, DXRS::Descri
 #endif
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingAnisoMipmapPrepareCS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "CSMain", "cs_5_0", compileFlags, 0, &computeShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingAnisoMipmapPrepareCS.hlsl").c_str(), nullptr, "CSMain", "cs_5_0", compileFlags, &computeShader, &errorBlob));
 		if (errorBlob)
 		{
 			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -2299,7 +3475,7 @@ void DXRSExampleGIScene::InitVoxelConeTracing(ID3D12Device* device, DXRS::Descri
 #endif
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingAnisoMipmapMainCS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "CSMain", "cs_5_0", compileFlags, 0, &computeShader, &errorBlob));
+		ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingAnisoMipmapMainCS.hlsl").c_str(), nullptr, "CSMain", "cs_5_0", compileFlags, &computeShader, &errorBlob));
 		if (errorBlob)
 		{
 			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -2365,13 +3541,13 @@ void DXRSExampleGIScene::InitVoxelConeTracing(ID3D12Device* device, DXRS::Descri
 
 			ID3DBlob* errorBlob = nullptr;
 
-			ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingPS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_1", compileFlags, 0, &vertexShader, &errorBlob));
+			ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\VoxelConeTracingPS.hlsl", mVCTPermutations, "VSMain", "vs_5_1", compileFlags, &vertexShader, &errorBlob));
 			if (errorBlob)
 			{
 				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
 				errorBlob->Release();
 			}
-			ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingPS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_1", compileFlags, 0, &pixelShader, &errorBlob));
+			ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\VoxelConeTracingPS.hlsl", mVCTPermutations, "PSMain", "ps_5_1", compileFlags, &pixelShader, &errorBlob));
 			if (errorBlob)
 			{
 				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -2417,7 +3593,7 @@ void DXRSExampleGIScene::InitVoxelConeTracing(ID3D12Device* device, DXRS::Descri
 #endif
 			ID3DBlob* errorBlob = nullptr;
 
-			ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\VoxelConeTracingCS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "CSMain", "cs_5_0", compileFlags, 0, &computeShader, &errorBlob));
+			ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\VoxelConeTracingCS.hlsl", mVCTPermutations, "CSMain", "cs_5_0", compileFlags, &computeShader, &errorBlob));
 			if (errorBlob)
 			{
 				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -2460,7 +3636,7 @@ void DXRSExampleGIScene::InitVoxelConeTracing(ID3D12Device* device, DXRS::Descri
 #endif
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\UpsampleBlurCS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "CSMain", "cs_5_0", compileFlags, 0, &computeShader, &errorBlob));
+		ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\UpsampleBlurCS.hlsl", mBlurPermutations, "CSMain", "cs_5_0", compileFlags, &computeShader, &errorBlob));
 		if (errorBlob)
 		{
 			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -2497,7 +3673,7 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 	};
 
 	if (!useAsyncCompute || (useAsyncCompute && aQueue == GRAPHICS_QUEUE)) {
-		PIXBeginEvent(commandList, 0, "VCT Voxelization");
+		mSandboxFramework->BeginGpuEvent(commandList, "VCT Voxelization");
 		{
 			CD3DX12_VIEWPORT vctViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, VCT_SCENE_VOLUME_SIZE, VCT_SCENE_VOLUME_SIZE);
 			CD3DX12_RECT vctRect = CD3DX12_RECT(0.0f, 0.0f, VCT_SCENE_VOLUME_SIZE, VCT_SCENE_VOLUME_SIZE);
@@ -2512,7 +3688,6 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 			mVCTVoxelization3DRT->TransitionTo(mBarriers, commandList, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 			mSandboxFramework->ResourceBarriersEnd(mBarriers, commandList);
 
-			DXRS::DescriptorHandle cbvHandle;
 			DXRS::DescriptorHandle uavHandle;
 			DXRS::DescriptorHandle srvHandle;
 			uavHandle = gpuDescriptorHeap->GetHandleBlock(1);
@@ -2523,16 +3698,14 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 			srvHandle = gpuDescriptorHeap->GetHandleBlock(1);
 			gpuDescriptorHeap->AddToHandle(device, srvHandle, mShadowDepth->GetSRV());
 
-			for (auto& model : mRenderableObjects) {
-				RenderObject(model, [this, gpuDescriptorHeap, commandList, &cbvHandle, &uavHandle, &srvHandle, device](U_PTR<DXRSModel>& anObject) {
-					cbvHandle = gpuDescriptorHeap->GetHandleBlock(2);
-					gpuDescriptorHeap->AddToHandle(device, cbvHandle, mVCTVoxelizationCB->GetCBV());
-					gpuDescriptorHeap->AddToHandle(device, cbvHandle, anObject->GetCB()->GetCBV());
-
-					commandList->SetGraphicsRootDescriptorTable(0, cbvHandle.GetGPUHandle());
-					commandList->SetGraphicsRootDescriptorTable(1, srvHandle.GetGPUHandle());
-					commandList->SetGraphicsRootDescriptorTable(2, uavHandle.GetGPUHandle());
+			commandList->SetGraphicsRootConstantBufferView(PerDrawBinding::PASS_PARAMETER, mVCTVoxelizationCB->GetGPUVirtualAddress());
+			commandList->SetGraphicsRootDescriptorTable(2, srvHandle.GetGPUHandle());
+			commandList->SetGraphicsRootDescriptorTable(3, uavHandle.GetGPUHandle());
 
+			CPU_PROFILE_SCOPE("Voxelization draws");
+			for (auto& model : mRenderableObjects) {
+				RenderObject(model, [this, commandList](U_PTR<DXRSModel>& anObject) {
+					BindPerDrawData(commandList, *anObject);
 					anObject->Render(commandList);
 				});
 			}
@@ -2541,10 +3714,10 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 			commandList->RSSetViewports(1, &viewport);
 			commandList->RSSetScissorRects(1, &rect);
 		}
-		PIXEndEvent(commandList);
+		mSandboxFramework->EndGpuEvent(commandList);
 
 		if (mVCTRenderDebug) {
-			PIXBeginEvent(commandList, 0, "VCT Voxelization Debug");
+			mSandboxFramework->BeginGpuEvent(commandList, "VCT Voxelization Debug");
 			{
 				commandList->SetPipelineState(mVCTVoxelizationDebugPSO.GetPipelineStateObject());
 				commandList->SetGraphicsRootSignature(mVCTVoxelizationDebugRS.GetSignature());
@@ -2577,13 +3750,13 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 				commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_POINTLIST);
 				commandList->DrawInstanced(VCT_SCENE_VOLUME_SIZE * VCT_SCENE_VOLUME_SIZE * VCT_SCENE_VOLUME_SIZE, 1, 0, 0);
 			}
-			PIXEndEvent(commandList);
+			mSandboxFramework->EndGpuEvent(commandList);
 		}
 	
 	}
 
 	if (!useAsyncCompute || (useAsyncCompute && aQueue == COMPUTE_QUEUE)) {
-		PIXBeginEvent(commandList, 0, "VCT Mipmapping prepare CS");
+		mSandboxFramework->BeginGpuEvent(commandList, "VCT Mipmapping prepare CS");
 		{
 			commandList->SetPipelineState(mVCTAnisoMipmappingPreparePSO.GetPipelineStateObject());
 			commandList->SetComputeRootSignature(mVCTAnisoMipmappingPrepareRS.GetSignature());
@@ -2605,7 +3778,7 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 			gpuDescriptorHeap->AddToHandle(device, cbvHandle, mVCTAnisoMipmappingCB->GetCBV());
 		
 			DXRS::DescriptorHandle srvHandle = gpuDescriptorHeap->GetHandleBlock(1);
-			gpuDescriptorHeap->AddToHandle(device, srvHandle, useAsyncCompute ? mVCTVoxelization3DRT_CopyForAsync->GetSRV() : mVCTVoxelization3DRT->GetSRV());
+			gpuDescriptorHeap->AddToHandle(device, srvHandle, (useAsyncCompute && mVCTAsyncPreviousFrame) ? mVCTVoxelization3DRT_CopyForAsync->GetSRV() : mVCTVoxelization3DRT->GetSRV());
 		
 			DXRS::DescriptorHandle uavHandle = gpuDescriptorHeap->GetHandleBlock(6);
 			gpuDescriptorHeap->AddToHandle(device, uavHandle, mVCTAnisoMipmappinPrepare3DRTs[0]->GetUAV());
@@ -2621,9 +3794,9 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 		
 			commandList->Dispatch(DivideByMultiple(static_cast<UINT>(cbData.MipDimension), 8u), DivideByMultiple(static_cast<UINT>(cbData.MipDimension), 8u), DivideByMultiple(static_cast<UINT>(cbData.MipDimension), 8u));
 		}
-		PIXEndEvent(commandList);
+		mSandboxFramework->EndGpuEvent(commandList);
 
-		PIXBeginEvent(commandList, 0, "VCT Mipmapping main CS");
+		mSandboxFramework->BeginGpuEvent(commandList, "VCT Mipmapping main CS");
 		{
 			commandList->SetPipelineState(mVCTAnisoMipmappingMainPSO.GetPipelineStateObject());
 			commandList->SetComputeRootSignature(mVCTAnisoMipmappingMainRS.GetSignature());
@@ -2686,10 +3859,10 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 				mipDimension >>= 1;
 			}
 		}
-		PIXEndEvent(commandList);
+		mSandboxFramework->EndGpuEvent(commandList);
 
 		if (!mVCTUseMainCompute && !useAsyncCompute) {
-			PIXBeginEvent(commandList, 0, "VCT Main PS");
+			mSandboxFramework->BeginGpuEvent(commandList, "VCT Main PS");
 			{
 				CD3DX12_VIEWPORT vctResViewport = CD3DX12_VIEWPORT(0.0f, 0.0f, mVCTMainRT->GetWidth(), mVCTMainRT->GetHeight());
 				CD3DX12_RECT vctRect = CD3DX12_RECT(0.0f, 0.0f, mVCTMainRT->GetWidth(), mVCTMainRT->GetHeight());
@@ -2739,10 +3912,10 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 				commandList->RSSetViewports(1, &viewport);
 				commandList->RSSetScissorRects(1, &rect);
 			}
-			PIXEndEvent(commandList);
+			mSandboxFramework->EndGpuEvent(commandList);
 		}
 		else {
-			PIXBeginEvent(commandList, 0, "VCT Main CS");
+			mSandboxFramework->BeginGpuEvent(commandList, "VCT Main CS");
 			{
 				commandList->SetPipelineState(mVCTMainPSO_Compute.GetPipelineStateObject());
 				commandList->SetComputeRootSignature(mVCTMainRS_Compute.GetSignature());
@@ -2765,7 +3938,7 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 				gpuDescriptorHeap->AddToHandle(device, srvHandle, mVCTAnisoMipmappinMain3DRTs[3]->GetSRV());
 				gpuDescriptorHeap->AddToHandle(device, srvHandle, mVCTAnisoMipmappinMain3DRTs[4]->GetSRV());
 				gpuDescriptorHeap->AddToHandle(device, srvHandle, mVCTAnisoMipmappinMain3DRTs[5]->GetSRV());
-				gpuDescriptorHeap->AddToHandle(device, srvHandle, useAsyncCompute ? mVCTVoxelization3DRT_CopyForAsync->GetSRV() : mVCTVoxelization3DRT->GetSRV());
+				gpuDescriptorHeap->AddToHandle(device, srvHandle, (useAsyncCompute && mVCTAsyncPreviousFrame) ? mVCTVoxelization3DRT_CopyForAsync->GetSRV() : mVCTVoxelization3DRT->GetSRV());
 
 				DXRS::DescriptorHandle cbvHandle = gpuDescriptorHeap->GetHandleBlock(2);
 				gpuDescriptorHeap->AddToHandle(device, cbvHandle, mVCTVoxelizationCB->GetCBV());
@@ -2777,12 +3950,12 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 
 				commandList->Dispatch(DivideByMultiple(static_cast<UINT>(mVCTMainRT->GetWidth()), 8u), DivideByMultiple(static_cast<UINT>(mVCTMainRT->GetHeight()), 8u), 1u);
 			}
-			PIXEndEvent(commandList);
+			mSandboxFramework->EndGpuEvent(commandList);
 		}
 
 		// upsample and blur
 		if (mVCTMainRTUseUpsampleAndBlur) {
-			PIXBeginEvent(commandList, 0, "VCT Main RT upsample & blur CS");
+			mSandboxFramework->BeginGpuEvent(commandList, "VCT Main RT upsample & blur CS");
 			{
 				commandList->SetPipelineState(mVCTMainUpsampleAndBlurPSO.GetPipelineStateObject());
 				commandList->SetComputeRootSignature(mVCTMainUpsampleAndBlurRS.GetSignature());
@@ -2806,7 +3979,7 @@ void DXRSExampleGIScene::RenderVoxelConeTracing(ID3D12Device* device, ID3D12Grap
 
 				commandList->Dispatch(DivideByMultiple(static_cast<UINT>(mVCTMainUpsampleAndBlurRT->GetWidth()), 8u), DivideByMultiple(static_cast<UINT>(mVCTMainUpsampleAndBlurRT->GetHeight()), 8u), 1u);
 			}
-			PIXEndEvent(commandList);
+			mSandboxFramework->EndGpuEvent(commandList);
 		}
 	}
 }
@@ -2820,8 +3993,8 @@ void DXRSExampleGIScene::CreateSSAORandomTexture()
 	ZeroMemory(&texDesc, sizeof(D3D12_RESOURCE_DESC));
 	texDesc.Dimension = D3D12_RESOURCE_DIMENSION_TEXTURE2D;
 	texDesc.Alignment = 0;
-	texDesc.Width = 8;
-	texDesc.Height = 8;
+	texDesc.Width = SSAO_NOISE_SIZE;
+	texDesc.Height = SSAO_NOISE_SIZE;
 	texDesc.DepthOrArraySize = 1;
 	texDesc.MipLevels = 1;
 	texDesc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
@@ -2830,27 +4003,27 @@ void DXRSExampleGIScene::CreateSSAORandomTexture()
 	texDesc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
 	texDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
 
+	// filled by the copy queue, shader reads promote the texture from COMMON
 	ThrowIfFailed(device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT), D3D12_HEAP_FLAG_NONE, &texDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&mRandomVectorSSAOResource)));
-
-	const UINT num2DSubresources = 1;
-	const UINT64 uploadBufferSize = GetRequiredIntermediateSize(mRandomVectorSSAOResource.Get(), 0, num2DSubresources);
-
-	ThrowIfFailed(device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize),
-		D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(mRandomVectorSSAOUploadBuffer.GetAddressOf())));
-
-	XMFLOAT3 initData[64];
-	for (int i = 0; i < 64; ++i)
-		initData[i] = XMFLOAT3(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), 0.0f);
+		D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&mRandomVectorSSAOResource)));
+
+	// kernel rotations by blue noise angles: neighbouring pixels get different rotations and the leftover noise is
+	// high frequency only
+	std::vector<uint32_t> ranks;
+	BlueNoise::Generate(SSAO_NOISE_SIZE, 1, 0x5EED, 0, ranks);
+	std::vector<XMFLOAT3> initData(ranks.size());
+	for (size_t i = 0; i < ranks.size(); ++i)
+	{
+		float angle = XM_2PI * BlueNoise::ToUnit(ranks[i], SSAO_NOISE_SIZE);
+		initData[i] = XMFLOAT3(cosf(angle), sinf(angle), 0.0f);
+	}
 
 	D3D12_SUBRESOURCE_DATA data = {};
-	data.pData = initData;
-	data.RowPitch = 8 * sizeof(XMFLOAT3);
+	data.pData = initData.data();
+	data.RowPitch = SSAO_NOISE_SIZE * sizeof(XMFLOAT3);
 	data.SlicePitch = 0;
 
-	mSandboxFramework->GetCommandListGraphics()->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mRandomVectorSSAOResource.Get(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_RESOURCE_STATE_COPY_DEST));
-	UpdateSubresources(mSandboxFramework->GetCommandListGraphics(), mRandomVectorSSAOResource.Get(), mRandomVectorSSAOUploadBuffer.Get(), 0, 0, 1, &data);
-	mSandboxFramework->GetCommandListGraphics()->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mRandomVectorSSAOResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+	mSandboxFramework->GetUploadManager().UploadTexture(mRandomVectorSSAOResource.Get(), 0, 1, &data);
 
 	mRandomVectorSSAODescriptorHandleCPU = mSandboxFramework->GetDescriptorHeapManager()->CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
@@ -2863,6 +4036,474 @@ void DXRSExampleGIScene::CreateSSAORandomTexture()
 	device->CreateShaderResourceView(mRandomVectorSSAOResource.Get(), &srvDesc, mRandomVectorSSAODescriptorHandleCPU.GetCPUHandle());
 }
 
+void DXRSExampleGIScene::GenerateSSAOKernel(int kernelSize)
+{
+	// offsets are spread over the active kernel only, unused entries of the CB array stay zero
+	for (int i = 0; i < SSAO_MAX_KERNEL; i++)
+	{
+		if (i >= kernelSize)
+		{
+			mSSAOKernelOffsets[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+			continue;
+		}
+
+		// Halton points cover the half cube evenly for any kernel size
+		XMFLOAT4 value = XMFLOAT4(2.0f * Sampling::Halton(i + 1, 0) - 1.0f, 2.0f * Sampling::Halton(i + 1, 1) - 1.0f, Sampling::Halton(i + 1, 2), 0.0f);
+		float scale = static_cast<float>(i) / static_cast<float>(kernelSize);
+		float scaleFactor = Lerp(0.1f, 1.0f, scale * scale);
+		mSSAOKernelOffsets[i] = XMFLOAT4(value.x * scaleFactor, value.y * scaleFactor, value.z * scaleFactor,1.0);
+	}
+}
+
+ShaderPermutationSpace::Settings DXRSExampleGIScene::GetQualitySettings(int tier) const
+{
+	const QualityTier& quality = QualityTiers[tier];
+
+	ShaderPermutationSpace::Settings settings;
+	settings["RSM_SAMPLES_COUNT"] = quality.mRSMSamplesCount;
+	settings["SSAO_KERNEL_SIZE"] = quality.mSSAOKernelSize;
+	settings["NUM_CONES"] = quality.mVCTConesCount;
+	settings["BLUR_TAPS"] = quality.mBlurTaps;
+	return settings;
+}
+
+HRESULT DXRSExampleGIScene::CompileShaderVariant(LPCWSTR fileName, const ShaderPermutationSpace& permutations, LPCSTR entryPoint, LPCSTR target, UINT flags, ID3DBlob** code, ID3DBlob** errors)
+{
+	ShaderPermutationSpace::Key key = 0;
+	if (!permutations.MakeKey(GetQualitySettings(mAppliedQualityTier), key))
+		return E_INVALIDARG;
+
+	std::vector<std::pair<std::string, std::string>> defines = permutations.GetDefines(key);
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (auto& define : defines)
+		macros.push_back({ define.first.c_str(), define.second.c_str() });
+	macros.push_back({ nullptr, nullptr });
+
+	// variants are compiled on first use, the defines are part of the shader cache key
+	return mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(fileName).c_str(), macros.data(), entryPoint, target, flags, code, errors);
+}
+
+void DXRSExampleGIScene::RegisterPSOShaders()
+{
+	const UINT unboundedTables = D3DCOMPILE_ENABLE_UNBOUNDED_DESCRIPTOR_TABLES;
+
+	mPSOShaders = {
+		{ "Gbuffer", &mGbufferPSO, nullptr, {
+			{ L"content\\shaders\\GBuffer.hlsl", "VSMain", "vs_5_1" },
+			{ L"content\\shaders\\GBuffer.hlsl", "PSMain", "ps_5_1", unboundedTables } } },
+		{ "ShadowMapping", &mShadowMappingPSO, nullptr, {
+			{ L"content\\shaders\\ShadowMapping.hlsl", "VSOnlyMain", "vs_5_1" } } },
+		{ "ReflectiveShadowMapping", &mRSMBuffersPSO, nullptr, {
+			{ L"content\\shaders\\ShadowMapping.hlsl", "VSMain", "vs_5_1" },
+			{ L"content\\shaders\\ShadowMapping.hlsl", "PSRSM", "ps_5_1", unboundedTables } } },
+		{ "ReflectiveShadowMapping", &mRSMPSO, nullptr, {
+			{ L"content\\shaders\\ReflectiveShadowMappingPS.hlsl", "VSMain", "vs_5_0", 0, &mRSMPermutations },
+			{ L"content\\shaders\\ReflectiveShadowMappingPS.hlsl", "PSMain", "ps_5_0", 0, &mRSMPermutations } } },
+		{ "ReflectiveShadowMapping", nullptr, &mRSMPSO_Compute, {
+			{ L"content\\shaders\\ReflectiveShadowMappingCS.hlsl", "CSMain", "cs_5_0", 0, &mRSMPermutations } } },
+		{ "ReflectiveShadowMapping", nullptr, &mRSMLightTreeLeavesPSO, {
+			{ L"content\\shaders\\RSMLightTreeBuildCS.hlsl", "CSLeaves", "cs_5_0" } } },
+		{ "ReflectiveShadowMapping", nullptr, &mRSMLightTreeLevelPSO, {
+			{ L"content\\shaders\\RSMLightTreeBuildCS.hlsl", "CSLevel", "cs_5_0" } } },
+		{ "ReflectiveShadowMapping", nullptr, &mRSMLightcutsPSO, {
+			{ L"content\\shaders\\ReflectiveShadowMappingLightcutsCS.hlsl", "CSMain", "cs_5_0" } } },
+		{ "ReflectiveShadowMapping", nullptr, &mRSMTemporalPSO, {
+			{ L"content\\shaders\\RSMTemporalCS.hlsl", "CSMain", "cs_5_0" } } },
+		{ "ReflectiveShadowMapping", nullptr, &mRSMTileResetPSO, {
+			{ L"content\\shaders\\RSMTileClassifyCS.hlsl", "CSReset", "cs_5_0" } } },
+		{ "ReflectiveShadowMapping", nullptr, &mRSMTileClassifyPSO, {
+			{ L"content\\shaders\\RSMTileClassifyCS.hlsl", "CSClassify", "cs_5_0" } } },
+		{ "ReflectiveShadowMapping", nullptr, &mRSMTilesPSO, {
+			{ L"content\\shaders\\ReflectiveShadowMappingCS.hlsl", "CSTiles", "cs_5_0", 0, &mRSMPermutations } } },
+		{ "ReflectiveShadowMapping", nullptr, &mRSMClearTilesPSO, {
+			{ L"content\\shaders\\ReflectiveShadowMappingCS.hlsl", "CSClearTiles", "cs_5_0" } } },
+		{ "ReflectiveShadowMapping", nullptr, &mRSMUpsampleAndBlurPSO, {
+			{ L"content\\shaders\\UpsampleBlurCS.hlsl", "CSMain", "cs_5_0", 0, &mBlurPermutations } } },
+		{ "ReflectiveShadowMapping", &mRSMDownsamplePSO, nullptr, {
+			{ L"content\\shaders\\RSMDownsamplePS.hlsl", "VSMain", "vs_5_1" },
+			{ L"content\\shaders\\RSMDownsamplePS.hlsl", "PSMain", "ps_5_1", unboundedTables } } },
+		{ "ReflectiveShadowMapping", nullptr, &mRSMDownsamplePSO_Compute, {
+			{ L"content\\shaders\\RSMDownsampleCS.hlsl", "CSMain", "cs_5_0" } } },
+		{ "LightPropagationVolume", &mLPVInjectionPSO, nullptr, {
+			{ L"content\\shaders\\LPVInjection.hlsl", "VSMain", "vs_5_1" },
+			{ L"content\\shaders\\LPVInjection.hlsl", "GSMain", "gs_5_1" },
+			{ L"content\\shaders\\LPVInjection.hlsl", "PSMain", "ps_5_1" } } },
+		{ "LightPropagationVolume", &mLPVPropagationPSO, nullptr, {
+			{ L"content\\shaders\\LPVPropagation.hlsl", "VSMain", "vs_5_1" },
+			{ L"content\\shaders\\LPVPropagation.hlsl", "GSMain", "gs_5_1" },
+			{ L"content\\shaders\\LPVPropagation.hlsl", "PSMain", "ps_5_1" } } },
+		{ "VoxelConeTracing", &mVCTVoxelizationPSO, nullptr, {
+			{ L"content\\shaders\\VoxelConeTracingVoxelization.hlsl", "VSMain", "vs_5_1" },
+			{ L"content\\shaders\\VoxelConeTracingVoxelization.hlsl", "GSMain", "gs_5_1" },
+			{ L"content\\shaders\\VoxelConeTracingVoxelization.hlsl", "PSMain", "ps_5_1" } } },
+		{ "VoxelConeTracing", &mVCTVoxelizationDebugPSO, nullptr, {
+			{ L"content\\shaders\\VoxelConeTracingVoxelizationDebug.hlsl", "VSMain", "vs_5_1" },
+			{ L"content\\shaders\\VoxelConeTracingVoxelizationDebug.hlsl", "GSMain", "gs_5_1" },
+			{ L"content\\shaders\\VoxelConeTracingVoxelizationDebug.hlsl", "PSMain", "ps_5_1" } } },
+		{ "VoxelConeTracing", nullptr, &mVCTAnisoMipmappingPreparePSO, {
+			{ L"content\\shaders\\VoxelConeTracingAnisoMipmapPrepareCS.hlsl", "CSMain", "cs_5_0" } } },
+		{ "VoxelConeTracing", nullptr, &mVCTAnisoMipmappingMainPSO, {
+			{ L"content\\shaders\\VoxelConeTracingAnisoMipmapMainCS.hlsl", "CSMain", "cs_5_0" } } },
+		{ "VoxelConeTracing", &mVCTMainPSO, nullptr, {
+			{ L"content\\shaders\\VoxelConeTracingPS.hlsl", "VSMain", "vs_5_1", 0, &mVCTPermutations },
+			{ L"content\\shaders\\VoxelConeTracingPS.hlsl", "PSMain", "ps_5_1", 0, &mVCTPermutations } } },
+		{ "VoxelConeTracing", nullptr, &mVCTMainPSO_Compute, {
+			{ L"content\\shaders\\VoxelConeTracingCS.hlsl", "CSMain", "cs_5_0", 0, &mVCTPermutations } } },
+		{ "VoxelConeTracing", nullptr, &mVCTMainUpsampleAndBlurPSO, {
+			{ L"content\\shaders\\UpsampleBlurCS.hlsl", "CSMain", "cs_5_0", 0, &mBlurPermutations } } },
+		{ "DXRPasses", nullptr, &mRaytracingBlurPSO, {
+			{ L"content\\shaders\\UpsampleBlurCS.hlsl", "CSMain", "cs_5_0", 0, &mBlurPermutations } } },
+		{ "Lighting", &mLightingPSO, nullptr, {
+			{ L"content\\shaders\\Lighting.hlsl", "VSMain", "vs_5_0" },
+			{ L"content\\shaders\\Lighting.hlsl", "PSMain", "ps_5_0" } } },
+		{ "SSAO", &mSSAOPSO, nullptr, {
+			{ L"content\\shaders\\SSAO.hlsl", "VSMain", "vs_5_0", 0, &mSSAOPermutations },
+			{ L"content\\shaders\\SSAO.hlsl", "PSMain", "ps_5_0", 0, &mSSAOPermutations } } },
+		{ "Composite", &mCompositePSO, nullptr, {
+			{ L"content\\shaders\\Composite.hlsl", "VSMain", "vs_5_0" },
+			{ L"content\\shaders\\Composite.hlsl", "PSMain", "ps_5_0" } } },
+	};
+}
+
+HRESULT DXRSExampleGIScene::CompileShaderStage(const ShaderStageDesc& stage, ID3DBlob** code, ID3DBlob** errors)
+{
+#if defined(_DEBUG)
+	// Enable better shader debugging with the graphics debugging tools.
+	UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+	UINT compileFlags = 0;
+#endif
+	compileFlags |= stage.mExtraFlags;
+
+	if (stage.mPermutations)
+		return CompileShaderVariant(stage.mFile, *stage.mPermutations, stage.mEntryPoint, stage.mTarget, compileFlags, code, errors);
+
+	return mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(stage.mFile).c_str(), nullptr, stage.mEntryPoint, stage.mTarget, compileFlags, code, errors);
+}
+
+bool DXRSExampleGIScene::RebuildPSO(const PSOShadersDesc& desc, std::string& error)
+{
+	// compile everything first so a broken shader leaves the PSO untouched
+	std::vector<ComPtr<ID3DBlob>> blobs(desc.mStages.size());
+	for (size_t i = 0; i < desc.mStages.size(); i++)
+	{
+		ComPtr<ID3DBlob> errors;
+		if (FAILED(CompileShaderStage(desc.mStages[i], &blobs[i], &errors)))
+		{
+			error = std::filesystem::path(desc.mStages[i].mFile).filename().string() + ":" + desc.mStages[i].mEntryPoint + " failed to compile";
+			if (errors)
+				error += std::string("\n") + static_cast<const char*>(errors->GetBufferPointer());
+			return false;
+		}
+	}
+
+	// GraphicsPSO/ComputePSO keep their description, so only the shaders are swapped before Finalize.
+	// All stages are set again because the bytecode the PSO was created with is gone by now.
+	ID3D12Device* device = mSandboxFramework->GetD3DDevice();
+	for (size_t i = 0; i < desc.mStages.size(); i++)
+	{
+		const void* bytecode = blobs[i]->GetBufferPointer();
+		size_t size = blobs[i]->GetBufferSize();
+		switch (desc.mStages[i].mTarget[0])
+		{
+		case 'v': desc.mGraphicsPSO->SetVertexShader(bytecode, size); break;
+		case 'g': desc.mGraphicsPSO->SetGeometryShader(bytecode, size); break;
+		case 'p': desc.mGraphicsPSO->SetPixelShader(bytecode, size); break;
+		case 'c': desc.mComputePSO->SetComputeShader(bytecode, size); break;
+		default: assert(false); break;
+		}
+	}
+
+	PSO* pso = desc.mGraphicsPSO ? static_cast<PSO*>(desc.mGraphicsPSO) : desc.mComputePSO;
+	ComPtr<ID3D12PipelineState> previous = pso->GetPipelineStateObject();
+	uint64_t previousHash = pso->GetHash();
+
+	if (desc.mGraphicsPSO)
+		desc.mGraphicsPSO->Finalize(device);
+	else
+		desc.mComputePSO->Finalize(device);
+
+	// the replaced pipeline leaves the hash map and lives until the frames in flight that use it are done
+	if (previous && pso->GetHash() != previousHash)
+	{
+		mSandboxFramework->DeferRelease(previous);
+		PSO::Evict(previousHash);
+	}
+
+	return true;
+}
+
+void DXRSExampleGIScene::ApplyQualityTier(int tier)
+{
+	mAppliedQualityTier = tier;
+
+	// going back to a tier hits the shader cache and the on-disk pipeline cache instead of recompiling
+	for (auto& desc : mPSOShaders)
+	{
+		bool permuted = false;
+		for (auto& stage : desc.mStages)
+			permuted |= stage.mPermutations != nullptr;
+
+		std::string error;
+		if (permuted && !RebuildPSO(desc, error))
+			throw std::runtime_error(error.c_str());
+	}
+
+	GenerateSSAOKernel(QualityTiers[tier].mSSAOKernelSize);
+
+	if (mPipelineCache.IsDirty())
+		mPipelineCache.Save(mSandboxFramework->GetFilePath(L"cache\\pipelines.bin"));
+}
+
+void DXRSExampleGIScene::ScheduleAsyncCompute()
+{
+	const QualityTier& tier = QualityTiers[mAppliedQualityTier];
+	GIPassGraph::Settings settings;
+	settings.mUseRSM = mUseRSM;
+	settings.mUseLPV = mUseLPV;
+	settings.mUseVCT = mUseVCT;
+	settings.mRSMComputeVersion = mRSMComputeVersion;
+	settings.mRSMUseUpsampleAndBlur = mRSMUseUpsampleAndBlur;
+	settings.mRSMUseLightcuts = mRSMUseLightcuts;
+	settings.mRSMLightcutsMaxClusters = mRSMLightcutsMaxClusters;
+	settings.mRSMUseTileClassification = mRSMUseTileClassification;
+	settings.mRSMInterleaveSize = mRSMInterleaveSize;
+	settings.mRSMTemporalAccumulation = mRSMTemporalAccumulation;
+	settings.mRSMSamplesCount = tier.mRSMSamplesCount;
+	settings.mRSMMaxSamplesCount = RSM_MAX_SAMPLES_COUNT;
+	settings.mVCTConesCount = tier.mVCTConesCount;
+
+	AsyncComputeScheduler& scheduler = mAsyncComputeScheduler;
+	GIPassGraph::Passes passes = GIPassGraph::Build(scheduler, settings);
+	scheduler.Schedule();
+
+	mRSMOnAsyncCompute = scheduler.GetQueue(passes.mRSM) == AsyncComputeScheduler::COMPUTE_QUEUE;
+	mVCTOnAsyncCompute = scheduler.GetQueue(passes.mVCT) == AsyncComputeScheduler::COMPUTE_QUEUE;
+	mRSMAsyncPreviousFrame = mRSMOnAsyncCompute && scheduler.IsPreviousFrame(passes.mRSM, passes.mRSMBuffers);
+	mVCTAsyncPreviousFrame = mVCTOnAsyncCompute && scheduler.IsPreviousFrame(passes.mVCT, passes.mVoxelization);
+
+	// the compute work is one submission, so it waits once: after list #1 unless it needs something from list #2
+	mAsyncComputeWaitsForGraphics2 = false;
+	const std::vector<AsyncComputeScheduler::Step>& graphicsSteps = scheduler.GetSteps(AsyncComputeScheduler::GRAPHICS_QUEUE);
+	for (auto& fence : scheduler.GetFences())
+	{
+		if (fence.mWaitQueue != AsyncComputeScheduler::COMPUTE_QUEUE)
+			continue;
+
+		const AsyncComputeScheduler::Step& step = graphicsSteps[fence.mSignalStep];
+		if (!step.mHistoryCopy && step.mPass != passes.mGBuffer)
+			mAsyncComputeWaitsForGraphics2 = true;
+	}
+}
+
+void DXRSExampleGIScene::SetGIRenderTargetRatios(float rsmRatio, float vctRatio)
+{
+	if (rsmRatio == mRSMRTRatio && vctRatio == mVCTRTRatio)
+		return;
+
+	// the targets are only read through their descriptors while recording, so swapping the pointers is enough
+	auto device = mSandboxFramework->GetD3DDevice();
+	auto descriptorManager = mSandboxFramework->GetDescriptorHeapManager();
+	if (mRSMRTsByRatio.empty())
+	{
+		mRSMRTsByRatio[mRSMRTRatio] = mRSMRT;
+		mVCTMainRTsByRatio[mVCTRTRatio] = mVCTMainRT;
+	}
+
+	DXRSRenderTarget*& rsmRT = mRSMRTsByRatio[rsmRatio];
+	if (!rsmRT)
+		rsmRT = new DXRSRenderTarget(device, descriptorManager, MAX_SCREEN_WIDTH * rsmRatio, MAX_SCREEN_HEIGHT * rsmRatio,
+			DXGI_FORMAT_R8G8B8A8_UNORM, D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, L"RSM Indirect Illumination");
+
+	DXRSRenderTarget*& vctRT = mVCTMainRTsByRatio[vctRatio];
+	if (!vctRT)
+		vctRT = new DXRSRenderTarget(device, descriptorManager, MAX_SCREEN_WIDTH * vctRatio, MAX_SCREEN_HEIGHT * vctRatio, DXGI_FORMAT_R8G8B8A8_UNORM,
+			D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, L"VCT Final Output", -1, 1, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+
+	if (rsmRatio != mRSMRTRatio)
+		mRSMHistoryValid = false;
+	mRSMRT = rsmRT;
+	mVCTMainRT = vctRT;
+	mRSMRTRatio = rsmRatio;
+	mVCTRTRatio = vctRatio;
+}
+
+// Light tree over the RSM, RSMLightTree::Build: the leaves, then every level from the one below it up to the root
+void DXRSExampleGIScene::RenderRSMLightTree(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, DXRS::GPUDescriptorHeap* gpuDescriptorHeap, std::vector<DXRSRenderTarget*>& rsmBuffers)
+{
+	mSandboxFramework->BeginGpuEvent(commandList, "RSM light tree build CS");
+	{
+		commandList->SetPipelineState(mRSMLightTreeLeavesPSO.GetPipelineStateObject());
+		commandList->SetComputeRootSignature(mRSMLightTreeBuildRS.GetSignature());
+
+		DXRS::DescriptorHandle srvHandleTree = gpuDescriptorHeap->GetHandleBlock(3);
+		gpuDescriptorHeap->AddToHandle(device, srvHandleTree, rsmBuffers[0]->GetSRV());
+		gpuDescriptorHeap->AddToHandle(device, srvHandleTree, rsmBuffers[1]->GetSRV());
+		gpuDescriptorHeap->AddToHandle(device, srvHandleTree, rsmBuffers[2]->GetSRV());
+
+		DXRS::DescriptorHandle uavHandleTree = gpuDescriptorHeap->GetHandleBlock(1);
+		gpuDescriptorHeap->AddToHandle(device, uavHandleTree, mRSMLightTreeUAVDescriptorHandleCPU);
+
+		D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(mRSMLightTreeResource.Get(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		commandList->ResourceBarrier(1, &barrier);
+
+		UINT buildConstants[2] = { mRSMLightTreeLeafLevel, RSM_LIGHT_TREE_LEAF_SIZE };
+		commandList->SetComputeRoot32BitConstants(0, _countof(buildConstants), buildConstants, 0);
+		commandList->SetComputeRootDescriptorTable(1, srvHandleTree.GetGPUHandle());
+		commandList->SetComputeRootDescriptorTable(2, uavHandleTree.GetGPUHandle());
+		commandList->Dispatch(DivideByMultiple(1u << mRSMLightTreeLeafLevel, 8u), DivideByMultiple(1u << mRSMLightTreeLeafLevel, 8u), 1u);
+
+		// every level reads the one written before it
+		commandList->SetPipelineState(mRSMLightTreeLevelPSO.GetPipelineStateObject());
+		for (UINT level = mRSMLightTreeLeafLevel; level-- > 0;)
+		{
+			barrier = CD3DX12_RESOURCE_BARRIER::UAV(mRSMLightTreeResource.Get());
+			commandList->ResourceBarrier(1, &barrier);
+			commandList->SetComputeRoot32BitConstant(0, level, 0);
+			commandList->Dispatch(DivideByMultiple(1u << level, 8u), DivideByMultiple(1u << level, 8u), 1u);
+		}
+
+		barrier = CD3DX12_RESOURCE_BARRIER::Transition(mRSMLightTreeResource.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+		commandList->ResourceBarrier(1, &barrier);
+	}
+	mSandboxFramework->EndGpuEvent(commandList);
+}
+
+DXRSExampleGIScene::RSMTemporalTargets& DXRSExampleGIScene::GetRSMTemporalTargets()
+{
+	RSMTemporalTargets& targets = mRSMTemporalTargetsByRatio[mRSMRTRatio];
+	if (!targets.mInterleaved)
+	{
+		auto device = mSandboxFramework->GetD3DDevice();
+		auto descriptorManager = mSandboxFramework->GetDescriptorHeapManager();
+		int width = int(mRSMRT->GetWidth());
+		int height = int(mRSMRT->GetHeight());
+		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_ALLOW_RENDER_TARGET | D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+		targets.mInterleaved = new DXRSRenderTarget(device, descriptorManager, width, height, DXGI_FORMAT_R16G16B16A16_FLOAT, flags, L"RSM Interleaved", -1, 1,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		targets.mHistory[0] = new DXRSRenderTarget(device, descriptorManager, width, height, DXGI_FORMAT_R16G16B16A16_FLOAT, flags, L"RSM History 0", -1, 1,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		targets.mHistory[1] = new DXRSRenderTarget(device, descriptorManager, width, height, DXGI_FORMAT_R16G16B16A16_FLOAT, flags, L"RSM History 1", -1, 1,
+			D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		mRSMHistoryValid = false;
+	}
+	return targets;
+}
+
+void DXRSExampleGIScene::StartBenchmark()
+{
+	std::filesystem::path path = mBenchmarkScenarioPath;
+	if (path.is_relative())
+		path = mSandboxFramework->GetFilePath(mBenchmarkScenarioPath);
+
+	BenchmarkScenario scenario;
+	std::string error;
+	if (!scenario.Load(path, error))
+	{
+		OutputDebugStringA(("Benchmark: " + error + "\n").c_str());
+		PostQuitMessage(1);
+		return;
+	}
+
+	mBenchmark = std::make_unique<BenchmarkRunner>(scenario);
+	mTimer.SetFixedTimeStep(true);
+	mTimer.SetTargetElapsedSeconds(scenario.GetTimeStep());
+	mSandboxFramework->SetVSync(false);
+	mCamera->Reset();
+	mBenchmarkLastFrameTime = std::chrono::steady_clock::now();
+	mBenchmarkResolvedGpuFrames = mSandboxFramework->GetGpuProfiler().GetResolvedFrameCount();
+}
+
+void DXRSExampleGIScene::BeginBenchmarkFrame()
+{
+	if (!mBenchmark->IsRunStart())
+		return;
+
+	// settings change between frames, the warmup frames absorb shader and render target creation
+	const BenchmarkScenario::Run& run = mBenchmark->GetRun();
+	mUseRSM = (run.mTechniques & BenchmarkScenario::TECHNIQUE_RSM) != 0;
+	mUseLPV = (run.mTechniques & BenchmarkScenario::TECHNIQUE_LPV) != 0;
+	mUseVCT = (run.mTechniques & BenchmarkScenario::TECHNIQUE_VCT) != 0;
+	mUseAsyncCompute = run.mAsyncCompute;
+	SetGIRenderTargetRatios(run.mRSMRatio, run.mVCTRatio);
+
+	char message[256];
+	sprintf_s(message, "Benchmark run %u/%u: %s\n", mBenchmark->GetRunIndex() + 1, mBenchmark->GetRunCount(), run.mName.c_str());
+	OutputDebugStringA(message);
+}
+
+void DXRSExampleGIScene::EndBenchmarkFrame()
+{
+	// GPU times show up once the frame is read back, a few frames later; the warmup covers that lag
+	GpuProfiler& gpuProfiler = mSandboxFramework->GetGpuProfiler();
+	if (gpuProfiler.GetResolvedFrameCount() != mBenchmarkResolvedGpuFrames)
+	{
+		mBenchmarkResolvedGpuFrames = gpuProfiler.GetResolvedFrameCount();
+		mBenchmark->AddGpuTimes(gpuProfiler.GetQueueLastTimeMs(mSandboxFramework->GetGpuProfilerGraphicsQueue()),
+			gpuProfiler.GetQueueLastTimeMs(mSandboxFramework->GetGpuProfilerComputeQueue()));
+	}
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	mBenchmark->EndFrame(std::chrono::duration<double, std::milli>(now - mBenchmarkLastFrameTime).count());
+	mBenchmarkLastFrameTime = now;
+
+	if (!mBenchmark->IsFinished())
+		return;
+
+	std::string name = mBenchmark->GetScenario().GetName();
+	for (char& c : name)
+	{
+		if (!isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_')
+			c = '_';
+	}
+	bool written = mBenchmark->WriteCSV(mSandboxFramework->GetFilePath("profiling\\benchmark_" + name + ".csv"));
+	written &= mBenchmark->WriteJSON(mSandboxFramework->GetFilePath("profiling\\benchmark_" + name + ".json"));
+	OutputDebugStringA(mBenchmark->ExportCSV().c_str());
+
+	mBenchmark.reset();
+	mSandboxFramework->SetVSync(true);
+	mTimer.SetFixedTimeStep(false);
+	PostQuitMessage(written ? 0 : 1);
+}
+
+void DXRSExampleGIScene::ReloadShaders(const std::vector<std::filesystem::path>& changedFiles)
+{
+	std::set<std::filesystem::path> affectedRoots;
+	for (auto& file : changedFiles)
+	{
+		mSandboxFramework->GetShaderCache().InvalidateFile(file);
+		for (auto& root : mShaderDependencies.OnFileChanged(file))
+			affectedRoots.insert(root);
+	}
+
+	// edits may have added includes
+	for (auto& file : mShaderDependencies.GetFiles())
+		mShaderWatcher.Watch(file);
+
+	mShaderReloadError.clear();
+	for (auto& desc : mPSOShaders)
+	{
+		bool affected = false;
+		for (auto& stage : desc.mStages)
+			affected |= affectedRoots.count(std::filesystem::path(mSandboxFramework->GetFilePath(stage.mFile)).lexically_normal()) > 0;
+		if (!affected)
+			continue;
+
+		// a broken edit keeps the previous PSO running and is reported in the UI
+		std::string error;
+		if (RebuildPSO(desc, error))
+			mShaderReloadedPSOCount++;
+		else
+		{
+			OutputDebugStringA((error + "\n").c_str());
+			mShaderReloadError = error;
+		}
+	}
+
+	if (mPipelineCache.IsDirty())
+		mPipelineCache.Save(mSandboxFramework->GetFilePath(L"cache\\pipelines.bin"));
+}
+
 void DXRSExampleGIScene::InitSSAO(ID3D12Device* device, DXRS::DescriptorHeapManager* descriptorManager)
 {
 	mSSAORT = new DXRSRenderTarget(device, descriptorManager, MAX_SCREEN_WIDTH, MAX_SCREEN_HEIGHT,
@@ -2904,14 +4545,14 @@ void DXRSExampleGIScene::InitSSAO(ID3D12Device* device, DXRS::DescriptorHeapMana
 #endif
 	ID3DBlob* errorBlob = nullptr;
 
-	ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\SSAO.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, &errorBlob));
+	ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\SSAO.hlsl", mSSAOPermutations, "VSMain", "vs_5_0", compileFlags, &vertexShader, &errorBlob));
 	if (errorBlob)
 	{
 		OutputDebugStringA((char*)errorBlob->GetBufferPointer());
 		errorBlob->Release();
 	}
 
-	ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\SSAO.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, &errorBlob));
+	ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\SSAO.hlsl", mSSAOPermutations, "PSMain", "ps_5_0", compileFlags, &pixelShader, &errorBlob));
 	if (errorBlob)
 	{
 		OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -2932,13 +4573,7 @@ void DXRSExampleGIScene::InitSSAO(ID3D12Device* device, DXRS::DescriptorHeapMana
 	mSSAOPSO.SetPixelShader(pixelShader->GetBufferPointer(), pixelShader->GetBufferSize());
 	mSSAOPSO.Finalize(device);
 	 
-	for (int i = 0; i < SSAO_MAX_KERNEL; i++)
-	{
-		XMFLOAT4 value = XMFLOAT4(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(0.0f, 1.0f), 0.0f);
-		float scale = static_cast<float>(i) / static_cast<float>(SSAO_MAX_KERNEL);
-		float scaleFactor = Lerp(0.1f, 1.0f, scale * scale);
-		mSSAOKernelOffsets[i] = XMFLOAT4(value.x * scaleFactor, value.y * scaleFactor, value.z * scaleFactor,1.0);
-	}
+	GenerateSSAOKernel(QualityTiers[mAppliedQualityTier].mSSAOKernelSize);
 
 	//CB
 	DXRSBuffer::Description cbDesc;
@@ -2954,7 +4589,7 @@ void DXRSExampleGIScene::RenderSSAO(ID3D12Device* device, ID3D12GraphicsCommandL
 	if (!mUseSSAO)
 		return;
 
-	PIXBeginEvent(commandList, 0, "SSAO");
+	mSandboxFramework->BeginGpuEvent(commandList, "SSAO");
 	{
 		D3D12_CPU_DESCRIPTOR_HANDLE rtvHandlesSSAO[] =
 		{
@@ -2991,10 +4626,10 @@ void DXRSExampleGIScene::RenderSSAO(ID3D12Device* device, ID3D12GraphicsCommandL
 		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 		commandList->DrawInstanced(4, 1, 0, 0);
 	}
-	PIXEndEvent(commandList);
+	mSandboxFramework->EndGpuEvent(commandList);
 
 	// upsample & blur
-	PIXBeginEvent(commandList, 0, "SSAO upsample & blur CS");
+	mSandboxFramework->BeginGpuEvent(commandList, "SSAO upsample & blur CS");
 	{
 		commandList->SetPipelineState(mRSMUpsampleAndBlurPSO.GetPipelineStateObject());
 		commandList->SetComputeRootSignature(mRSMUpsampleAndBlurRS.GetSignature());
@@ -3018,7 +4653,7 @@ void DXRSExampleGIScene::RenderSSAO(ID3D12Device* device, ID3D12GraphicsCommandL
 
 		commandList->Dispatch(DivideByMultiple(static_cast<UINT>(mSSAOFinalRT->GetWidth()), 8u), DivideByMultiple(static_cast<UINT>(mSSAOFinalRT->GetHeight()), 8u), 1u);
 	}
-	PIXEndEvent(commandList);
+	mSandboxFramework->EndGpuEvent(commandList);
 }
 
 void DXRSExampleGIScene::InitLighting(ID3D12Device* device, DXRS::DescriptorHeapManager* descriptorManager)
@@ -3090,14 +4725,14 @@ void DXRSExampleGIScene::InitLighting(ID3D12Device* device, DXRS::DescriptorHeap
 #endif
 	ID3DBlob* errorBlob = nullptr;
 
-	ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\Lighting.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, &errorBlob));
+	ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\Lighting.hlsl").c_str(), nullptr, "VSMain", "vs_5_0", compileFlags, &vertexShader, &errorBlob));
 	if (errorBlob)
 	{
 		OutputDebugStringA((char*)errorBlob->GetBufferPointer());
 		errorBlob->Release();
 	}
 
-	ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\Lighting.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, &errorBlob));
+	ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\Lighting.hlsl").c_str(), nullptr, "PSMain", "ps_5_0", compileFlags, &pixelShader, &errorBlob));
 	if (errorBlob)
 	{
 		OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -3137,7 +4772,7 @@ void DXRSExampleGIScene::RenderLighting(ID3D12Device* device, ID3D12GraphicsComm
 	CD3DX12_VIEWPORT viewport = CD3DX12_VIEWPORT(0.0f, 0.0f, mSandboxFramework->GetOutputSize().right, mSandboxFramework->GetOutputSize().bottom);
 	CD3DX12_RECT rect = CD3DX12_RECT(0.0f, 0.0f, mSandboxFramework->GetOutputSize().right, mSandboxFramework->GetOutputSize().bottom);
 
-	PIXBeginEvent(commandList, 0, "Lighting");
+	mSandboxFramework->BeginGpuEvent(commandList, "Lighting");
 	{
 		commandList->RSSetViewports(1, &viewport);
 		commandList->RSSetScissorRects(1, &rect);
@@ -3192,7 +4827,7 @@ void DXRSExampleGIScene::RenderLighting(ID3D12Device* device, ID3D12GraphicsComm
 		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 		commandList->DrawInstanced(4, 1, 0, 0);
 	}
-	PIXEndEvent(commandList);
+	mSandboxFramework->EndGpuEvent(commandList);
 }
 
 void DXRSExampleGIScene::InitComposite(ID3D12Device* device, DXRS::DescriptorHeapManager* descriptorManager)
@@ -3222,14 +4857,14 @@ void DXRSExampleGIScene::InitComposite(ID3D12Device* device, DXRS::DescriptorHea
 #endif
 	ID3DBlob* errorBlob = nullptr;
 
-	ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\Composite.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, &errorBlob));
+	ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\Composite.hlsl").c_str(), nullptr, "VSMain", "vs_5_0", compileFlags, &vertexShader, &errorBlob));
 	if (errorBlob)
 	{
 		OutputDebugStringA((char*)errorBlob->GetBufferPointer());
 		errorBlob->Release();
 	}
 
-	ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\Composite.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, &errorBlob));
+	ThrowIfFailed(mSandboxFramework->CompileShader(mSandboxFramework->GetFilePath(L"content\\shaders\\Composite.hlsl").c_str(), nullptr, "PSMain", "ps_5_0", compileFlags, &pixelShader, &errorBlob));
 
 	mCompositePSO = mLightingPSO;
 
@@ -3242,7 +4877,7 @@ void DXRSExampleGIScene::InitComposite(ID3D12Device* device, DXRS::DescriptorHea
 
 void DXRSExampleGIScene::RenderComposite(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, DXRS::GPUDescriptorHeap* gpuDescriptorHeap)
 {
-	PIXBeginEvent(commandList, 0, "Composite");
+	mSandboxFramework->BeginGpuEvent(commandList, "Composite");
 	{
 		commandList->SetPipelineState(mCompositePSO.GetPipelineStateObject());
 		commandList->SetGraphicsRootSignature(mCompositeRS.GetSignature());
@@ -3263,7 +4898,7 @@ void DXRSExampleGIScene::RenderComposite(ID3D12Device* device, ID3D12GraphicsCom
 		commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 		commandList->DrawInstanced(4, 1, 0, 0);
 	}
-	PIXEndEvent(commandList);
+	mSandboxFramework->EndGpuEvent(commandList);
 }
 
 void DXRSExampleGIScene::InitDXRPasses(ID3D12Device* device, DXRS::DescriptorHeapManager* descriptorManager)
@@ -3315,7 +4950,7 @@ void DXRSExampleGIScene::InitDXRPasses(ID3D12Device* device, DXRS::DescriptorHea
 #endif
 		ID3DBlob* errorBlob = nullptr;
 
-		ThrowIfFailed(D3DCompileFromFile(mSandboxFramework->GetFilePath(L"content\\shaders\\UpsampleBlurCS.hlsl").c_str(), nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "CSMain", "cs_5_0", compileFlags, 0, &computeShader, &errorBlob));
+		ThrowIfFailed(CompileShaderVariant(L"content\\shaders\\UpsampleBlurCS.hlsl", mBlurPermutations, "CSMain", "cs_5_0", compileFlags, &computeShader, &errorBlob));
 		if (errorBlob)
 		{
 			OutputDebugStringA((char*)errorBlob->GetBufferPointer());
@@ -3399,6 +5034,8 @@ void DXRSExampleGIScene::CreateRaytracingPSO()
 }
 void DXRSExampleGIScene::CreateRaytracingAccelerationStructures(bool toUpdateTLAS)
 {
+	CPU_PROFILE_SCOPE(toUpdateTLAS ? "TLAS update" : "Acceleration structures build");
+
 	ID3D12Device5* device = mSandboxFramework->GetDXRDevice();
 	ID3D12GraphicsCommandList4* commandList = (ID3D12GraphicsCommandList4*)mSandboxFramework->GetCommandListGraphics();
 
@@ -3773,9 +5410,11 @@ void DXRSExampleGIScene::RenderDXR(ID3D12Device* device, ID3D12GraphicsCommandLi
 		return;
 
 	//DXR pass
-	PIXBeginEvent(commandList, 0, "DXR");
+	mSandboxFramework->BeginGpuEvent(commandList, "DXR");
 	{
-		ID3D12GraphicsCommandList4* commandListDXR = (ID3D12GraphicsCommandList4*)commandList;
+		// through QueryInterface, commandList may be the recording wrapper of the real list
+		ComPtr<ID3D12GraphicsCommandList4> commandListDXR;
+		ThrowIfFailed(commandList->QueryInterface(IID_PPV_ARGS(&commandListDXR)));
 		ID3D12DescriptorHeap* heaps[] = { mRaytracingDescriptorHeap.Get() };
 		commandListDXR->SetDescriptorHeaps(_countof(heaps), heaps);
 
@@ -3792,8 +5431,8 @@ void DXRSExampleGIScene::RenderDXR(ID3D12Device* device, ID3D12GraphicsCommandLi
 		//commandListDXR->SetComputeRootShaderResourceView(6, mShadowDepth->GetResource()->GetGPUVirtualAddress());
 
 		mSandboxFramework->ResourceBarriersBegin(mBarriers);
-		mDXRReflectionsRT->TransitionTo(mBarriers, commandListDXR, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		mDXRAmbientOcclusionRT->TransitionTo(mBarriers, commandListDXR, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		mDXRReflectionsRT->TransitionTo(mBarriers, commandListDXR.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		mDXRAmbientOcclusionRT->TransitionTo(mBarriers, commandListDXR.Get(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 		mSandboxFramework->ResourceBarriersEnd(mBarriers, commandList);
 
 		if (mUseDXRReflections)
@@ -3853,7 +5492,7 @@ void DXRSExampleGIScene::RenderDXR(ID3D12Device* device, ID3D12GraphicsCommandLi
 			commandListDXR->DispatchRays(&desc);
 		}
 	}
-	PIXEndEvent(commandList);
+	mSandboxFramework->EndGpuEvent(commandList);
 
 	ID3D12DescriptorHeap* ppHeaps[] = { gpuDescriptorHeap->GetHeap() };
 	commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
@@ -3861,7 +5500,7 @@ void DXRSExampleGIScene::RenderDXR(ID3D12Device* device, ID3D12GraphicsCommandLi
 	// upsample and blur
 	if (mUseDXRReflections && mDXRBlurReflections) 
 	{
-		PIXBeginEvent(commandList, 0, "DXR reflections blur CS");
+		mSandboxFramework->BeginGpuEvent(commandList, "DXR reflections blur CS");
 		for (int i = 0; i < mDXRBlurPasses; i++)
 		{
 			if (i > 0) {
@@ -3900,13 +5539,13 @@ void DXRSExampleGIScene::RenderDXR(ID3D12Device* device, ID3D12GraphicsCommandLi
 
 			commandList->Dispatch(DivideByMultiple(static_cast<UINT>(mDXRReflectionsBlurredRT->GetWidth()), 8u), DivideByMultiple(static_cast<UINT>(mDXRReflectionsBlurredRT->GetHeight()), 8u), 1u);
 		}
-		PIXEndEvent(commandList);
+		mSandboxFramework->EndGpuEvent(commandList);
 	}
 
 	if (mUseDXRAmbientOcclusion && mDXRBlurAo)
 	{
 		// upsample & blur
-		PIXBeginEvent(commandList, 0, "RTAO upsample & blur CS");
+		mSandboxFramework->BeginGpuEvent(commandList, "RTAO upsample & blur CS");
 		{
 			commandList->SetPipelineState(mRSMUpsampleAndBlurPSO.GetPipelineStateObject());
 			commandList->SetComputeRootSignature(mRSMUpsampleAndBlurRS.GetSignature());
@@ -3930,6 +5569,6 @@ void DXRSExampleGIScene::RenderDXR(ID3D12Device* device, ID3D12GraphicsCommandLi
 
 			commandList->Dispatch(DivideByMultiple(static_cast<UINT>(mDXRAmbientOcclusionBlurredRT->GetWidth()), 8u), DivideByMultiple(static_cast<UINT>(mDXRAmbientOcclusionBlurredRT->GetHeight()), 8u), 1u);
 		}
-		PIXEndEvent(commandList);
+		mSandboxFramework->EndGpuEvent(commandList);
 	}
 }
\ No newline at end of file
@@ -10,19 +10,45 @@
 
 #include "RootSignature.h"
 #include "PipelineStateObject.h"
+#include "PipelineStateCache.h"
+#include "PerDrawBinding.h"
+#include "ShaderCompileQueue.h"
+#include "ShaderPermutation.h"
+#include "ShaderDependencyGraph.h"
+#include "FileWatcher.h"
+#include "AsyncComputeScheduler.h"
+#include "GIPassGraph.h"
+#include "BenchmarkRunner.h"
+#include "LPVCascades.h"
+#include "LPVGeometryVolume.h"
+#include "LPVPropagationScheduler.h"
+#include "LPVSHCodec.h"
+#include "BlueNoise.h"
+#include "RSMInterleave.h"
+#include "RSMLightTree.h"
+#include "RSMTileClassifier.h"
+#include "Sampling.h"
 
 #include "RaytracingPipelineGenerator.h"
 #include "ShaderBindingTableGenerator.h"
 
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <thread>
+
 #define SHADOWMAP_SIZE 2048
 #define RSM_SIZE 2048
-#define RSM_SAMPLES_COUNT 512
+#define RSM_MAX_SAMPLES_COUNT 512
+#define RSM_LIGHT_TREE_LEAF_SIZE 4
 #define LPV_DIM 32
+#define LPV_CASCADES 3
 #define VCT_SCENE_VOLUME_SIZE 256
 #define VCT_MIPS 6
 #define LOCKED_CAMERA_VIEWS 3
 #define NUM_DYNAMIC_OBJECTS 40
 #define SSAO_MAX_KERNEL 16
+#define SSAO_NOISE_SIZE 64
 
 class DXRSExampleGIScene
 {
@@ -39,6 +65,8 @@ public:
 	void Clear(ID3D12GraphicsCommandList* cmdList);
 	void Run();
 	void OnWindowSizeChanged(int width, int height);
+	// Runs the scenario after Init instead of taking input, writes the reports to profiling\ and quits
+	void SetBenchmarkScenario(const std::wstring& path) { mBenchmarkScenarioPath = path; }
 
 private:
 	void Update(DXRSTimer const& timer);
@@ -47,6 +75,13 @@ private:
 	void UpdateLights(DXRSTimer const& timer);
 	void UpdateCamera(DXRSTimer const& timer);
 	void UpdateImGui();
+	void UpdateLPVPropagationSchedule();
+	void UpdateLPVGeometryVolume();
+	void SelectLPVSHRenderTargets(int encoding);
+	void ApplyLPVSHEncoding(int encoding);
+	void InitPerDrawRootSignature(ID3D12Device* device, PerDrawBinding::Pass pass);
+	void ApplyPerDrawData(int data);
+	void BindPerDrawData(ID3D12GraphicsCommandList* commandList, DXRSModel& model);
 	
 	void InitGbuffer(ID3D12Device* device, DXRS::DescriptorHeapManager* descriptorManager);
 	void InitShadowMapping(ID3D12Device* device, DXRS::DescriptorHeapManager* descriptorManager);
@@ -79,6 +114,44 @@ private:
 	void CreateRaytracingResourceHeap();
 
 	void CreateSSAORandomTexture();
+	void GenerateSSAOKernel(int kernelSize);
+	void ResetLPVPropagationBundles();
+	void CopyRSMCapture(ID3D12GraphicsCommandList* commandList);
+	void WriteRSMCapture();
+	struct RSMTemporalTargets;
+	RSMTemporalTargets& GetRSMTemporalTargets();
+	void RenderRSMLightTree(ID3D12Device* device, ID3D12GraphicsCommandList* commandList, DXRS::GPUDescriptorHeap* gpuDescriptorHeap, std::vector<DXRSRenderTarget*>& rsmBuffers);
+
+	// Shaders of every PSO built from HLSL, drives the startup compile queue, quality tiers and hot reload
+	struct ShaderStageDesc
+	{
+		const wchar_t* mFile;
+		const char* mEntryPoint;
+		const char* mTarget; // the first letter selects the stage: vs, gs, ps or cs
+		UINT mExtraFlags = 0;
+		const ShaderPermutationSpace* mPermutations = nullptr;
+	};
+	struct PSOShadersDesc
+	{
+		const char* mPass;
+		GraphicsPSO* mGraphicsPSO;
+		ComputePSO* mComputePSO;
+		std::vector<ShaderStageDesc> mStages;
+	};
+	void RegisterPSOShaders();
+	HRESULT CompileShaderStage(const ShaderStageDesc& stage, ID3DBlob** code, ID3DBlob** errors);
+	bool RebuildPSO(const PSOShadersDesc& desc, std::string& error);
+	void ReloadShaders(const std::vector<std::filesystem::path>& changedFiles);
+
+	ShaderPermutationSpace::Settings GetQualitySettings(int tier) const;
+	HRESULT CompileShaderVariant(LPCWSTR fileName, const ShaderPermutationSpace& permutations, LPCSTR entryPoint, LPCSTR target, UINT flags, ID3DBlob** code, ID3DBlob** errors = nullptr);
+	void ApplyQualityTier(int tier);
+	void ScheduleAsyncCompute();
+	void SetGIRenderTargetRatios(float rsmRatio, float vctRatio);
+
+	void StartBenchmark();
+	void BeginBenchmarkFrame();
+	void EndBenchmarkFrame();
 
 	void ThrowFailedErrorBlob(ID3DBlob* blob);
 
@@ -95,6 +168,41 @@ private:
 
 	std::vector<U_PTR<DXRSModel>> mRenderableObjects;
 
+	PipelineStateCache mPipelineCache;
+
+	// Shader option spaces, the first value of each option is what the High tier uses
+	ShaderPermutationSpace mRSMPermutations = { { "RSM_SAMPLES_COUNT", { 512, 256, 64 } } };
+	ShaderPermutationSpace mSSAOPermutations = { { "SSAO_KERNEL_SIZE", { 16, 8, 4 } } };
+	ShaderPermutationSpace mVCTPermutations = { { "NUM_CONES", { 6, 1 } } };
+	ShaderPermutationSpace mBlurPermutations = { { "BLUR_TAPS", { 9, 7, 5 } } };
+	int mQualityTier = 2; // 0 - Low, 1 - Medium, 2 - High
+	int mAppliedQualityTier = 2;
+
+	std::vector<PSOShadersDesc> mPSOShaders;
+	ShaderDependencyGraph mShaderDependencies;
+	FileWatcher mShaderWatcher;
+	bool mUseShaderHotReload = true;
+	float mShaderHotReloadPollTime = 0.0f;
+	UINT mShaderReloadedPSOCount = 0;
+	std::string mShaderReloadError;
+	// workers compiling the startup shaders, one per hardware thread; 0 compiles them serially on the main thread
+	UINT mShaderCompileThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	// CPU scope summary of the last refresh, the events are cleared after every refresh
+	bool mUseCpuProfiler = true;
+	std::vector<CpuProfiler::ScopeSummary> mCpuProfileSummary;
+	UINT mCpuProfileRefreshFrames = 0;
+	int mCommandCaptureFrames = 1;
+
+	// Benchmark mode: the runner drives the GI toggles and the camera, frames use a fixed timestep
+	std::wstring mBenchmarkScenarioPath;
+	U_PTR<BenchmarkRunner> mBenchmark;
+	std::chrono::steady_clock::time_point mBenchmarkLastFrameTime;
+	uint64_t mBenchmarkResolvedGpuFrames = 0;
+	// render targets of every ratio used so far, switching back to a ratio reuses them
+	std::map<float, DXRSRenderTarget*> mRSMRTsByRatio;
+	std::map<float, DXRSRenderTarget*> mVCTMainRTsByRatio;
+
 	// Gbuffer
 	RootSignature mGbufferRS;
 	DXRSRenderTarget* mGbufferRTs[3] = { nullptr };
@@ -134,10 +242,13 @@ private:
 		float RSMIntensity;
 		float RSMRMax;
 		XMFLOAT2 UpsampleRatio;
+		XMFLOAT2 SampleRotation;
+		UINT InterleaveSize;
+		UINT InterleaveFrame;
 	};
 	__declspec(align(16)) struct RSMCBDataRandomValues
 	{
-		XMFLOAT4 xi[RSM_SAMPLES_COUNT];
+		XMFLOAT4 xi[RSM_MAX_SAMPLES_COUNT];
 	};
 	__declspec(align(16)) struct RSMCBDataDownsample
 	{
@@ -154,9 +265,107 @@ private:
 	bool mRSMComputeVersion = true;
 	UINT mRSMDownsampleScaleSize = 4;
 	bool mRSMDownsampleForLPV = false;
+	bool mRSMRotateSamples = false;	// a new rotation of the sample set every frame, noise for a temporal filter
 	bool mRSMDownsampleUseCS = false;
 	float mRSMGIPower = 1.0f;
 
+	// RSM lightcuts: a light tree over the RSM, rebuilt every frame, gathered instead of the samples (RSMLightTree)
+	RootSignature mRSMLightTreeBuildRS;
+	RootSignature mRSMLightcutsRS;
+	ComputePSO mRSMLightTreeLeavesPSO;
+	ComputePSO mRSMLightTreeLevelPSO;
+	ComputePSO mRSMLightcutsPSO;
+	ComPtr<ID3D12Resource> mRSMLightTreeResource;
+	DXRS::DescriptorHandle mRSMLightTreeUAVDescriptorHandleCPU;
+	DXRS::DescriptorHandle mRSMLightTreeSRVDescriptorHandleCPU;
+	struct RSMLightcutsConstants
+	{
+		UINT LeafLevel;
+		UINT StartLevel;
+		float ErrorThreshold;
+		UINT MaxClusters;
+		UINT RSMSize;
+	};
+	UINT mRSMLightTreeLeafLevel = 0;
+	bool mRSMUseLightcuts = false;
+	float mRSMLightcutsThreshold = RSMLightTree::DEFAULT_ERROR_THRESHOLD;
+	int mRSMLightcutsMaxClusters = RSMLightTree::DEFAULT_MAX_CLUSTERS;
+
+	// "Capture RSM": RSM and G-buffer read back after the frame and written for tools/RSMLightcutsBench
+	static constexpr int RSM_CAPTURE_TARGETS = 5;
+	ComPtr<ID3D12Resource> mRSMCaptureReadbacks[RSM_CAPTURE_TARGETS];
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT mRSMCaptureFootprints[RSM_CAPTURE_TARGETS] = {};
+	bool mRSMCaptureRequested = false;
+	bool mRSMCapturePending = false;	// copies recorded, written by the next Update
+	XMMATRIX mRSMCaptureShadowViewProjection;
+	float mRSMCaptureRMax = 0.0f;
+	std::string mRSMCaptureStatus;
+
+	// RSM interleaved sampling: the CS pass takes a disjoint subset of the samples per pixel of an interleave tile into
+	// mInterleaved, RSMTemporalCS de-interleaves it into mRSMRT and accumulates it in the history (RSMInterleave).
+	// The targets follow the RSM ratio like mRSMRTsByRatio and are created on first use.
+	struct RSMTemporalTargets
+	{
+		DXRSRenderTarget* mInterleaved = nullptr;
+		DXRSRenderTarget* mHistory[2] = {};
+	};
+	std::map<float, RSMTemporalTargets> mRSMTemporalTargetsByRatio;
+	RootSignature mRSMTemporalRS;
+	ComputePSO mRSMTemporalPSO;
+	__declspec(align(16)) struct RSMTemporalCBData
+	{
+		XMMATRIX ViewProjection;
+		XMMATRIX PreviousViewProjection;
+		XMMATRIX PreviousInverseViewProjection;
+		XMFLOAT2 UpsampleRatio;
+		UINT InterleaveSize;
+		UINT UseHistory;
+		float HistoryWeight;
+	};
+	DXRSBuffer* mRSMTemporalCB = nullptr;
+	int mRSMInterleaveSize = 1;
+	bool mRSMTemporalAccumulation = false;
+	float mRSMHistoryWeight = RSMInterleave::DEFAULT_HISTORY_WEIGHT;
+	bool mRSMHistoryValid = false;	// last frame's resolve wrote mHistory[mRSMHistoryIndex] for the current ratio
+	UINT mRSMHistoryIndex = 0;
+	XMMATRIX mRSMPreviousViewProjection = XMMatrixIdentity();
+
+	// RSM tile classification: RSMTileClassifyCS sorts the tiles of the CS pass into full, reduced and none lists
+	// (RSMTileClassifier) and the pass is dispatched indirectly over each. The VPL bounds come from the light tree.
+	RootSignature mRSMTileClassifyRS;
+	RootSignature mRSMTilesRS;
+	ComputePSO mRSMTileResetPSO;
+	ComputePSO mRSMTileClassifyPSO;
+	ComputePSO mRSMTilesPSO;
+	ComputePSO mRSMClearTilesPSO;
+	ComPtr<ID3D12CommandSignature> mRSMTileDispatchSignature;
+	ComPtr<ID3D12Resource> mRSMTileListsResource;
+	DXRS::DescriptorHandle mRSMTileListsUAVDescriptorHandleCPU;
+	DXRS::DescriptorHandle mRSMTileListsSRVDescriptorHandleCPU;
+	UINT mRSMTileCapacity = 0;	// tiles of the largest RSM target
+	__declspec(align(16)) struct RSMTileClassifyCBData
+	{
+		XMMATRIX ViewProjection;
+		XMMATRIX ShadowViewProjection;
+		XMFLOAT2 UpsampleRatio;
+		UINT OutputWidth;
+		UINT OutputHeight;
+		float RSMRMax;
+		float NormalVariance;
+		float PlaneDistance;
+		UINT Level;
+		UINT TileCapacity;
+	};
+	DXRSBuffer* mRSMTileClassifyCB = nullptr;
+	struct RSMTileConstants
+	{
+		UINT TileListOffset;
+		UINT TileSampleDivisor;
+	};
+	bool mRSMUseTileClassification = false;
+	float mRSMTileNormalVariance = RSMTileClassifier::DEFAULT_NORMAL_VARIANCE;
+	float mRSMTilePlaneDistance = RSMTileClassifier::DEFAULT_PLANE_DISTANCE;
+
 	// LPV
 	RootSignature mLPVInjectionRS;
 	RootSignature mLPVPropagationRS;
@@ -181,6 +390,12 @@ private:
 		float LPVCutoff;
 		float LPVPower;
 		float LPVAttenuation;
+		int LPVCascadeCount;
+		XMFLOAT4 LPVCascadeTransforms[LPV_CASCADES]; // cell = position * w + xyz
+		float LPVCascadeMargin;
+		float LPVCascadeBlend;
+		int LPVInjectCoarser;
+		float LPVStorageScale;
 	};
 	DXRSBuffer* mLPVCB = nullptr;
 	int mLPVPropagationSteps = 50;
@@ -189,6 +404,34 @@ private:
 	float mLPVAttenuation = 1.0f;
 	XMMATRIX mWorldToLPV;
 	float mLPVGIPower = 1.0f;
+	// one cascade of 4 unit cells around the origin is the original fixed volume
+	LPVCascades mLPVCascades = LPVCascades(1, LPV_DIM, 1.0f / LPVEngine::LPV_SCALE);
+	int mLPVCascadeCount = 1;
+	float mLPVCascadeCellSize = 1.0f / LPVEngine::LPV_SCALE;
+	float mLPVCascadeMargin = 1.0f;
+	float mLPVCascadeBlend = 2.0f;
+	bool mLPVCascadesFollowCamera = false;
+	bool mLPVInjectCoarser = true;
+
+	// amortized propagation: the grid and accumulation carry over frames, restarts when the injection inputs change
+	bool mLPVAmortize = false;
+	int mLPVStepsPerFrame = 10;
+	float mLPVRestartThreshold = 0.01f;
+	LPVPropagationScheduler mLPVScheduler;
+	std::vector<float> mLPVRestartInputs;   // light of the last restart, compared with a threshold
+	uint64_t mLPVRestartSignature = 0;      // everything else of the last restart, any change restarts
+
+	// occlusion of the static models per cascade (LPVGeometryVolume), rebuilt on the CPU when the cascades move
+	bool mUseLPVGeometryVolume = false;
+	ComPtr<ID3D12Resource> mLPVGeometryVolumeResource;
+	DXRS::DescriptorHandle mLPVGeometryVolumeDescriptorHandleCPU;
+	uint64_t mLPVGeometryVolumeSignature = 0; // 0 while the volume is empty
+
+	// storage of the SH grids and accumulations, the targets of every encoding used so far are kept for switching back
+	int mLPVSHEncoding = LPVSHCodec::ENCODING_UNORM8;
+	int mAppliedLPVSHEncoding = LPVSHCodec::ENCODING_UNORM8;
+	float mLPVStorageRange = 4.0f;      // largest coefficient of SNORM8 scaled
+	std::vector<DXRSRenderTarget*> mLPVEncodingRTs[LPVSHCodec::ENCODING_COUNT];
 
 	// Voxel Cone Tracing
 	RootSignature mVCTVoxelizationRS;
@@ -333,7 +576,6 @@ private:
 	bool mUseSSAO = false;
 	DXRSBuffer* mSSAOCB = nullptr;
 	ComPtr<ID3D12Resource> mRandomVectorSSAOResource;
-	ComPtr<ID3D12Resource> mRandomVectorSSAOUploadBuffer;
 	DXRS::DescriptorHandle mRandomVectorSSAODescriptorHandleCPU;
 
 	// Shadows
@@ -389,8 +631,10 @@ private:
 		XMFLOAT2 ScreenResolution;
 		XMFLOAT2 RTAORadiusPower;
 		int FrameIndex;
+		XMFLOAT2 SampleRotation;
 	};
 	DXRSBuffer*	mDXRCB = nullptr; //cbuffer for DXR passes
+	UINT mSampleFrame = 0;	// rotates the samples of RTAO and RSM (Sampling::GetFrameRotation)
 	bool mUseDXRReflections = false;
 	bool mDXRBlurReflections = true;
 	int mDXRBlurPasses = 1;
@@ -438,6 +682,18 @@ private:
 	};
 
 	bool mUseAsyncCompute = false;
+	int mFramesInFlight = 3;	// 2 stalls the CPU when async compute makes the GPU chain longer than a CPU frame, tools/FrameTimelineCheck
+	// placement of the RSM and VCT compute passes in RenderAsync, decided by ScheduleAsyncCompute
+	AsyncComputeScheduler mAsyncComputeScheduler;
+	bool mRSMOnAsyncCompute = true;
+	bool mVCTOnAsyncCompute = true;
+	bool mRSMAsyncPreviousFrame = true;	// reads last frame's RSM buffers through mRSMBuffersRTs_CopiesForAsync
+	bool mVCTAsyncPreviousFrame = true;	// reads last frame's voxels through mVCTVoxelization3DRT_CopyForAsync
+	bool mAsyncComputeWaitsForGraphics2 = false; // compute starts after graphics command list #2 instead of #1
+	// PerDrawBinding::Data of the passes drawing every object, switched at the frame boundary
+	int mPerDrawData = PerDrawBinding::DATA_ROOT_CONSTANTS;
+	int mAppliedPerDrawData = PerDrawBinding::DATA_ROOT_CONSTANTS;
+	UINT mPerDrawBinds = 0;
 	bool mUseDynamicObjects = false;
 	bool mStopDynamicObjects = false;
 };
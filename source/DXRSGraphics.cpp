@@ -4,10 +4,12 @@
 #include "DescriptorHeap.h"
 
 UINT DXRSGraphics::mBackBufferIndex = 0;
+UINT DXRSGraphics::mFrameSlot = 0;
 
 DXRSGraphics::DXRSGraphics(DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBufferFormat, UINT backBufferCount, D3D_FEATURE_LEVEL minFeatureLevel, unsigned int flags)
     :
-    mFenceValuesGraphics{},
+    mFrameTimeline(backBufferCount),
+    mGpuProfiler(GPU_PROFILER_QUERIES_PER_FRAME, MAX_FRAMES_IN_FLIGHT),
     mBackBufferFormat(backBufferFormat),
     mDepthBufferFormat(depthBufferFormat),
     mBackBufferCount(backBufferCount),
@@ -24,6 +26,20 @@ DXRSGraphics::DXRSGraphics(DXGI_FORMAT backBufferFormat, DXGI_FORMAT depthBuffer
     //assert(minFeatureLevel < D3D_FEATURE_LEVEL_11_0);
 
     mCurrentPath = std::filesystem::current_path();
+    mShaderCache.SetDirectory(GetFilePath(L"cache\\shaders"));
+    mD3DCompilerVersion = GetLoadedCompilerVersion(D3DCOMPILER_DLL_W);
+    mDXCompilerVersion = GetLoadedCompilerVersion(L"dxcompiler.dll");
+
+    mTimelineFenceGraphics = mFrameTimeline.AddFence("Graphics");
+    mTimelineFenceGraphics2 = mFrameTimeline.AddFence("Graphics mid-frame");
+    mTimelineFenceCompute = mFrameTimeline.AddFence("Compute");
+    mFrameTimeline.SetCompletedValueFunc([this](FrameTimeline::FenceId fence) {
+        return GetTimelineFence(fence)->GetCompletedValue();
+    });
+    mFrameTimeline.SetWaitFunc([this](FrameTimeline::FenceId fence, UINT64 value) {
+        ThrowIfFailed(GetTimelineFence(fence)->SetEventOnCompletion(value, mFenceEvent.Get()));
+        WaitForSingleObjectEx(mFenceEvent.Get(), INFINITE, FALSE);
+    });
 }
 
 DXRSGraphics::~DXRSGraphics()
@@ -154,8 +170,8 @@ void DXRSGraphics::CreateResources()
             ThrowIfFailed(mDevice->CreateDescriptorHeap(&dsvDescriptorHeapDesc, IID_PPV_ARGS(mDSVDescriptorHeap.ReleaseAndGetAddressOf())));
         }
 
-        // Create a command allocator for each back buffer that will be rendered to.
-        for (UINT n = 0; n < mBackBufferCount; n++)
+        // Create a command allocator for each frame slot, the frames in flight can change at runtime.
+        for (UINT n = 0; n < MAX_FRAMES_IN_FLIGHT; n++)
         {
             ThrowIfFailed(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(mCommandAllocatorsGraphics[n][0].ReleaseAndGetAddressOf())));
             ThrowIfFailed(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(mCommandAllocatorsGraphics[n][1].ReleaseAndGetAddressOf())));
@@ -175,23 +191,45 @@ void DXRSGraphics::CreateResources()
 
 		ThrowIfFailed(mDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(mCommandQueueCompute.ReleaseAndGetAddressOf())));
 
-		for (UINT n = 0; n < mBackBufferCount; n++)
+		for (UINT n = 0; n < MAX_FRAMES_IN_FLIGHT; n++)
 			ThrowIfFailed(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COMPUTE, IID_PPV_ARGS(mCommandAllocatorsCompute[n].ReleaseAndGetAddressOf())));
 
         ThrowIfFailed(mDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COMPUTE, mCommandAllocatorsCompute[0].Get(), nullptr, IID_PPV_ARGS(mCommandListCompute.ReleaseAndGetAddressOf())));
 		ThrowIfFailed(mCommandListCompute->Close());
 
 		// Create a fence for async compute.
-		ThrowIfFailed(mDevice->CreateFence(mFenceValuesCompute, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFenceCompute.ReleaseAndGetAddressOf())));
-        mFenceValuesCompute++;
-		mFenceEventCompute.Attach(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
-		if (!mFenceEventCompute.IsValid())
-		{
-			throw std::exception("CreateEvent");
-		}
+		ThrowIfFailed(mDevice->CreateFence(mFrameTimeline.GetLastSignaledValue(mTimelineFenceCompute), D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFenceCompute.ReleaseAndGetAddressOf())));
         mFenceCompute->SetName(L"Compute fence");
     }
 
+    // Copy queue for resource uploads
+    mUploadManager.Init(mDevice.Get());
+
+    // Timestamp queries for the GPU profiler
+    {
+        UINT64 frequency = 1;
+        ThrowIfFailed(mCommandQueueGraphics->GetTimestampFrequency(&frequency));
+        mGpuProfilerGraphics = mGpuProfiler.AddQueue("Graphics", frequency);
+        ThrowIfFailed(mCommandQueueCompute->GetTimestampFrequency(&frequency));
+        mGpuProfilerCompute = mGpuProfiler.AddQueue("Compute", frequency);
+
+        D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+        queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+        queryHeapDesc.Count = mGpuProfiler.GetQueryCount();
+        for (int i = 0; i < 2; i++)
+        {
+            ThrowIfFailed(mDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(mTimestampQueryHeaps[i].ReleaseAndGetAddressOf())));
+            ThrowIfFailed(mDevice->CreateCommittedResource(
+                &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+                D3D12_HEAP_FLAG_NONE,
+                &CD3DX12_RESOURCE_DESC::Buffer(queryHeapDesc.Count * sizeof(UINT64)),
+                D3D12_RESOURCE_STATE_COPY_DEST,
+                nullptr,
+                IID_PPV_ARGS(mTimestampReadbackBuffers[i].ReleaseAndGetAddressOf())));
+        }
+        mTimestampReadbackBuffers[mGpuProfilerGraphics]->SetName(L"Graphics timestamps readback");
+        mTimestampReadbackBuffers[mGpuProfilerCompute]->SetName(L"Compute timestamps readback");
+    }
 }
 
 // Close and flush command list after initialization 
@@ -199,28 +237,25 @@ void DXRSGraphics::FinalizeResources()
 {
     ThrowIfFailed(mCommandListGraphics[0]->Close());
     ID3D12CommandList* ppCommandLists[] = { mCommandListGraphics[0].Get() };
+    // Initialization commands (e.g. acceleration structure builds) read the uploaded meshes
+    mUploadManager.WaitOnQueue(mCommandQueueGraphics.Get(), mUploadManager.Submit());
     mCommandQueueGraphics->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
 
     // Create a fence for tracking GPU execution progress.
-    ThrowIfFailed(mDevice->CreateFence(mFenceValuesGraphics[mBackBufferIndex], D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFenceGraphics.ReleaseAndGetAddressOf())));
-    mFenceValuesGraphics[mBackBufferIndex]++;
-    mFenceEventGraphics.Attach(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
-    if (!mFenceEventGraphics.IsValid())
+    ThrowIfFailed(mDevice->CreateFence(mFrameTimeline.GetLastSignaledValue(mTimelineFenceGraphics), D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFenceGraphics.ReleaseAndGetAddressOf())));
+    mFenceEvent.Attach(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
+    if (!mFenceEvent.IsValid())
     {
         throw std::exception("CreateEvent");
     }
     mFenceGraphics->SetName(L"Graphics fence #1 (main)");
 
 	// Create a fence 2 for tracking GPU execution progress.
-	ThrowIfFailed(mDevice->CreateFence(mFenceValuesGraphics2, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFenceGraphics2.ReleaseAndGetAddressOf())));
-    mFenceValuesGraphics2++;
-	mFenceEventGraphics2.Attach(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
-	if (!mFenceEventGraphics2.IsValid())
-	{
-		throw std::exception("CreateEvent");
-	}
+	ThrowIfFailed(mDevice->CreateFence(mFrameTimeline.GetLastSignaledValue(mTimelineFenceGraphics2), D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFenceGraphics2.ReleaseAndGetAddressOf())));
     mFenceGraphics2->SetName(L"Graphics fence #2");
 
+    // The first Prepare resets the allocator the initialization commands were recorded with
+    WaitForGpu();
 }
 
 void DXRSGraphics::CreateFullscreenQuadBuffers()
@@ -247,27 +282,13 @@ void DXRSGraphics::CreateFullscreenQuadBuffers()
             &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT /*D3D12_HEAP_TYPE_UPLOAD*/),
             D3D12_HEAP_FLAG_NONE,
             &CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize),
-            /*D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER*/ D3D12_RESOURCE_STATE_COPY_DEST /*D3D12_RESOURCE_STATE_GENERIC_READ*/,
+            D3D12_RESOURCE_STATE_COMMON,
             nullptr,
             IID_PPV_ARGS(&mFullscreenQuadVertexBuffer)));
 
-        ThrowIfFailed(mDevice->CreateCommittedResource(
-            &CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-            D3D12_HEAP_FLAG_NONE,
-            &CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize),
-            D3D12_RESOURCE_STATE_GENERIC_READ,
-            nullptr,
-            IID_PPV_ARGS(&mFullscreenQuadVertexBufferUpload)));
-
-        // Copy data to the intermediate upload heap and then schedule a copy
-        // from the upload heap to the vertex buffer.
-        D3D12_SUBRESOURCE_DATA vertexData = {};
-        vertexData.pData = reinterpret_cast<BYTE*>(quadVertices);
-        vertexData.RowPitch = vertexBufferSize;
-        vertexData.SlicePitch = vertexData.RowPitch;
-
-        UpdateSubresources<1>(mCommandListGraphics[0].Get(), mFullscreenQuadVertexBuffer.Get(), mFullscreenQuadVertexBufferUpload.Get(), 0, 0, 1, &vertexData);
-        mCommandListGraphics[0]->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mFullscreenQuadVertexBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER));
+        // Copy through the upload queue, the buffer is promoted to VERTEX_AND_CONSTANT_BUFFER on first use.
+        // FinalizeResources makes the graphics queue wait for it.
+        mUploadManager.UploadBuffer(mFullscreenQuadVertexBuffer.Get(), 0, quadVertices, vertexBufferSize);
 
         // Copy buffer - simple way with UPLOAD HEAP TYPE
         //UINT8* pVertexDataBegin;
@@ -294,12 +315,9 @@ void DXRSGraphics::CreateWindowResources()
     // Wait until all previous GPU work is complete.
     WaitForGpu();
 
-    // Release resources that are tied to the swap chain and update fence values.
+    // Release resources that are tied to the swap chain.
     for (UINT n = 0; n < mBackBufferCount; n++)
-    {
         mRenderTargets[n].Reset();
-        mFenceValuesGraphics[n] = mFenceValuesGraphics[mBackBufferIndex];
-    }
 
     // Determine the render target size in pixels.
     UINT backBufferWidth = std::max<UINT>(static_cast<UINT>(mOutputSize.right - mOutputSize.left), 1u);
@@ -453,15 +471,38 @@ bool DXRSGraphics::WindowSizeChanged(int width, int height)
 
 void DXRSGraphics::Prepare(D3D12_RESOURCE_STATES beforeState, bool skipComputeQReset)
 {
-    ThrowIfFailed(mCommandAllocatorsGraphics[mBackBufferIndex][0]->Reset());
-    ThrowIfFailed(mCommandListGraphics[0]->Reset(mCommandAllocatorsGraphics[mBackBufferIndex][0].Get(), nullptr));
+    CPU_PROFILE_SCOPE("Prepare");
+
+    // Only blocks if the GPU is still working on the frame that last used this slot
+    mFrameSlot = mFrameTimeline.BeginFrame();
+
+    // Hand the uploads recorded during the last frame to the copy queue and reclaim finished staging memory
+    mUploadManager.Submit();
+    mUploadManager.Update();
+
+    mGpuProfiler.BeginFrame(mFrameSlot);
+
+    if (mCommandCaptureFrames > 0)
+    {
+        if (!mCommandCapture)
+        {
+            mCommandLog.Clear();
+            mCommandCaptureFrameIndex = 0;
+            mCommandCapture = &mCommandLog;
+            mDescriptorHeapManager->SetCommandLog(mCommandCapture);
+        }
+        mCommandLog.BeginFrame(mCommandCaptureFrameIndex++);
+    }
+
+    ThrowIfFailed(mCommandAllocatorsGraphics[mFrameSlot][0]->Reset());
+    ThrowIfFailed(mCommandListGraphics[0]->Reset(mCommandAllocatorsGraphics[mFrameSlot][0].Get(), nullptr));
 
     if (!skipComputeQReset) {
-        ThrowIfFailed(mCommandAllocatorsCompute[mBackBufferIndex]->Reset());
-        ThrowIfFailed(mCommandListCompute->Reset(mCommandAllocatorsCompute[mBackBufferIndex].Get(), nullptr));
+        ThrowIfFailed(mCommandAllocatorsCompute[mFrameSlot]->Reset());
+        ThrowIfFailed(mCommandListCompute->Reset(mCommandAllocatorsCompute[mFrameSlot].Get(), nullptr));
 
-		ThrowIfFailed(mCommandAllocatorsGraphics[mBackBufferIndex][1]->Reset());
-		ThrowIfFailed(mCommandListGraphics[1]->Reset(mCommandAllocatorsGraphics[mBackBufferIndex][1].Get(), nullptr));
+		ThrowIfFailed(mCommandAllocatorsGraphics[mFrameSlot][1]->Reset());
+		ThrowIfFailed(mCommandListGraphics[1]->Reset(mCommandAllocatorsGraphics[mFrameSlot][1].Get(), nullptr));
     }
 }
 
@@ -476,6 +517,8 @@ void DXRSGraphics::TransitionMainRT(ID3D12GraphicsCommandList* cmdList, D3D12_RE
 }
 void DXRSGraphics::Present(D3D12_RESOURCE_STATES beforeState, bool needExecuteCmdList)
 {
+    CPU_PROFILE_SCOPE("Present");
+
     if (needExecuteCmdList) {
 
         if (beforeState != D3D12_RESOURCE_STATE_PRESENT)
@@ -484,12 +527,26 @@ void DXRSGraphics::Present(D3D12_RESOURCE_STATES beforeState, bool needExecuteCm
             mCommandListGraphics[0]->ResourceBarrier(1, &barrier);
         }
 
+        // the last graphics submission of the frame
+        ResolveGpuTimestamps(mCommandListGraphics[0].Get(), mGpuProfilerGraphics);
+
         ThrowIfFailed(mCommandListGraphics[0]->Close());
         mCommandQueueGraphics->ExecuteCommandLists(1, CommandListCast(mCommandListGraphics[0].GetAddressOf()));
     }
 
+    mGpuProfiler.EndFrame();
+    UINT frameSlot = mFrameSlot;
+    mFrameTimeline.Retire([this, frameSlot]() { ReadGpuTimestamps(frameSlot); });
+
+    if (mCommandCapture && --mCommandCaptureFrames == 0)
+    {
+        mCommandLog.Write(mCommandCapturePath);
+        mCommandCapture = nullptr;
+        mDescriptorHeapManager->SetCommandLog(nullptr);
+    }
+
     HRESULT hr;
-    hr = mSwapChain->Present(1, 0);
+    hr = mSwapChain->Present(mVSync ? 1 : 0, 0);
 
     // If the device was reset we must completely reinitialize the renderer.
     if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET)
@@ -513,91 +570,190 @@ void DXRSGraphics::Present(D3D12_RESOURCE_STATES beforeState, bool needExecuteCm
 
 void DXRSGraphics::WaitForComputeToFinish()
 {
-    assert(mCommandQueueGraphics && mFenceCompute/* && mFenceEventCompute.IsValid()*/);
-
-	UINT64 fenceValue = mFenceValuesCompute - 1;
-    mCommandQueueGraphics->Wait(mFenceCompute.Get(), fenceValue);
-
-    UINT64 completedValue = mFenceCompute->GetCompletedValue();
-
-	// wait until it is ready.
-	if (completedValue < fenceValue)
-	{
-		ThrowIfFailed(mFenceCompute->SetEventOnCompletion(fenceValue, mFenceEventCompute.Get()));
-		WaitForSingleObjectEx(mFenceEventCompute.Get(), INFINITE, FALSE);
-	}
+    assert(mCommandQueueGraphics && mFenceCompute);
 
+    // GPU side only: the CPU never waits for compute inside the frame, the timeline protects the compute allocators
+    mCommandQueueGraphics->Wait(mFenceCompute.Get(), mFrameTimeline.GetLastSignaledValue(mTimelineFenceCompute));
 }
 
 void DXRSGraphics::WaitForGraphicsFence2ToFinish(ID3D12CommandQueue* aQueue, bool previousFrame)
 {
 	assert(aQueue && mFenceGraphics2);
-    aQueue->Wait(mFenceGraphics2.Get(), (previousFrame) ? (mFenceValuesGraphics2 - 1) : mFenceValuesGraphics2);
+    // without previousFrame the queue waits for the next mid-frame signal, which is submitted later
+    aQueue->Wait(mFenceGraphics2.Get(), (previousFrame) ? mFrameTimeline.GetLastSignaledValue(mTimelineFenceGraphics2) : mFrameTimeline.GetNextValue(mTimelineFenceGraphics2));
 }
 
 void DXRSGraphics::SignalGraphicsFence2()
 {
-	UINT64 fenceValue = mFenceValuesGraphics2;
-	mCommandQueueGraphics->Signal(mFenceGraphics2.Get(), fenceValue);
-	mFenceValuesGraphics2++;
+	mCommandQueueGraphics->Signal(mFenceGraphics2.Get(), mFrameTimeline.Signal(mTimelineFenceGraphics2));
 }
 
 void DXRSGraphics::WaitForGraphicsToFinish()
 {
-	assert(mCommandQueueCompute && mFenceGraphics/* && mFenceEventCompute.IsValid()*/);
-    mCommandQueueCompute->Wait(mFenceGraphics.Get(), mFenceValuesGraphics[mBackBufferIndex] - 1);
+	assert(mCommandQueueCompute && mFenceGraphics);
+    mCommandQueueCompute->Wait(mFenceGraphics.Get(), mFrameTimeline.GetLastSignaledValue(mTimelineFenceGraphics));
 }
 
 void DXRSGraphics::PresentCompute()
 {
+    ResolveGpuTimestamps(mCommandListCompute.Get(), mGpuProfilerCompute);
     mCommandListCompute->Close();
 
 	ID3D12CommandList* ppCommandLists[] = { mCommandListCompute.Get() };
 	mCommandQueueCompute->ExecuteCommandLists(1, ppCommandLists);
 
-	UINT64 fenceValue = mFenceValuesCompute;
-    mCommandQueueCompute->Signal(mFenceCompute.Get(), fenceValue);
-    mFenceValuesCompute++;
+    mCommandQueueCompute->Signal(mFenceCompute.Get(), mFrameTimeline.Signal(mTimelineFenceCompute));
 }
 
 void DXRSGraphics::WaitForGpu() 
 {
-    if (mCommandQueueGraphics && mFenceGraphics && mFenceEventGraphics.IsValid())
-    {
-        // Schedule a Signal command in the GPU queue.
-        UINT64 fenceValue = mFenceValuesGraphics[mBackBufferIndex];
-        if (SUCCEEDED(mCommandQueueGraphics->Signal(mFenceGraphics.Get(), fenceValue)))
-        {
-            // Wait until the Signal has been processed.
-            if (SUCCEEDED(mFenceGraphics->SetEventOnCompletion(fenceValue, mFenceEventGraphics.Get())))
-            {
-                WaitForSingleObjectEx(mFenceEventGraphics.Get(), INFINITE, FALSE);
+    if (!mCommandQueueGraphics || !mCommandQueueCompute || !mFenceGraphics || !mFenceGraphics2 || !mFenceCompute || !mFenceEvent.IsValid())
+        return;
 
-                // Increment the fence value for the current frame.
-                mFenceValuesGraphics[mBackBufferIndex]++;
-            }
-        }
-    }
+    // Schedule a Signal command on both queues and wait until every fence has caught up.
+    if (FAILED(mCommandQueueGraphics->Signal(mFenceGraphics.Get(), mFrameTimeline.Signal(mTimelineFenceGraphics))))
+        return;
+    if (FAILED(mCommandQueueCompute->Signal(mFenceCompute.Get(), mFrameTimeline.Signal(mTimelineFenceCompute))))
+        return;
+
+    mUploadManager.WaitForIdle();
+    mFrameTimeline.Flush();
+}
+
+void DXRSGraphics::SetFramesInFlight(UINT count)
+{
+    count = std::min(std::max(count, 1u), MAX_FRAMES_IN_FLIGHT);
+    if (count == mFrameTimeline.GetFramesInFlight())
+        return;
+
+    WaitForGpu();
+    mFrameTimeline.SetFramesInFlight(count);
 }
 
 void DXRSGraphics::MoveToNextFrame()
 {
-    // Schedule a Signal command in the queue.
-    const UINT64 currentFenceValue = mFenceValuesGraphics[mBackBufferIndex];
-    ThrowIfFailed(mCommandQueueGraphics->Signal(mFenceGraphics.Get(), currentFenceValue));
+    // Schedule a Signal command in the queue, the next Prepare waits for it once the slot comes around again.
+    ThrowIfFailed(mCommandQueueGraphics->Signal(mFenceGraphics.Get(), mFrameTimeline.Signal(mTimelineFenceGraphics)));
+    mFrameTimeline.EndFrame();
 
     // Update the back buffer index.
     mBackBufferIndex = mSwapChain->GetCurrentBackBufferIndex();
+}
 
-    // If the next frame is not ready to be rendered yet, wait until it is ready.
-    if (mFenceGraphics->GetCompletedValue() < mFenceValuesGraphics[mBackBufferIndex])
+ID3D12Fence* DXRSGraphics::GetTimelineFence(FrameTimeline::FenceId fence) const
+{
+    if (fence == mTimelineFenceGraphics)
+        return mFenceGraphics.Get();
+    if (fence == mTimelineFenceGraphics2)
+        return mFenceGraphics2.Get();
+    return mFenceCompute.Get();
+}
+
+GpuProfiler::QueueId DXRSGraphics::GetGpuProfilerQueue(ID3D12GraphicsCommandList* commandList) const
+{
+    return commandList->GetType() == D3D12_COMMAND_LIST_TYPE_COMPUTE ? mGpuProfilerCompute : mGpuProfilerGraphics;
+}
+
+RecordingCommandList* DXRSGraphics::GetRecordingCommandList(ID3D12GraphicsCommandList* commandList) const
+{
+    for (auto& recordingList : mRecordingCommandLists)
     {
-        ThrowIfFailed(mFenceGraphics->SetEventOnCompletion(mFenceValuesGraphics[mBackBufferIndex], mFenceEventGraphics.Get()));
-        WaitForSingleObjectEx(mFenceEventGraphics.Get(), INFINITE, FALSE);
+        if (recordingList && (recordingList.get() == commandList || recordingList->GetTarget() == commandList))
+            return recordingList.get();
     }
+    return nullptr;
+}
 
-    // Set the fence value for the next frame.
-    mFenceValuesGraphics[mBackBufferIndex] = currentFenceValue + 1;
+void DXRSGraphics::CaptureCommands(UINT frames, const std::string& path)
+{
+    if (mCommandCapture)
+        return;
+
+    mCommandCaptureFrames = std::max(frames, 1u);
+    mCommandCapturePath = path;
+}
+
+ID3D12GraphicsCommandList* DXRSGraphics::RecordCommands(ID3D12GraphicsCommandList* commandList)
+{
+    if (!mCommandCapture)
+        return commandList;
+
+    ID3D12GraphicsCommandList* lists[] = { mCommandListGraphics[0].Get(), mCommandListGraphics[1].Get(), mCommandListCompute.Get() };
+    for (uint32_t i = 0; i < _countof(lists); i++)
+    {
+        if (lists[i] != commandList)
+            continue;
+        if (!mRecordingCommandLists[i])
+            mRecordingCommandLists[i] = std::make_unique<RecordingCommandList>(commandList, *mCommandCapture, i);
+        return mRecordingCommandLists[i].get();
+    }
+    return commandList;
+}
+
+void DXRSGraphics::BeginGpuEvent(ID3D12GraphicsCommandList* commandList, const char* name)
+{
+    if (mCommandCapture)
+    {
+        if (RecordingCommandList* recordingList = GetRecordingCommandList(commandList))
+            mCommandLog.BeginPass(recordingList->GetListIndex(), recordingList->GetType(), name);
+    }
+
+    CpuProfiler::Get().BeginScope(name);
+    PIXBeginEvent(commandList, 0, name);
+
+    GpuProfiler::QueueId queue = GetGpuProfilerQueue(commandList);
+    UINT query = mGpuProfiler.BeginScope(queue, name);
+    if (query != GpuProfiler::INVALID_QUERY)
+        commandList->EndQuery(mTimestampQueryHeaps[queue].Get(), D3D12_QUERY_TYPE_TIMESTAMP, query);
+}
+
+void DXRSGraphics::EndGpuEvent(ID3D12GraphicsCommandList* commandList)
+{
+    GpuProfiler::QueueId queue = GetGpuProfilerQueue(commandList);
+    UINT query = mGpuProfiler.EndScope(queue);
+    if (query != GpuProfiler::INVALID_QUERY)
+        commandList->EndQuery(mTimestampQueryHeaps[queue].Get(), D3D12_QUERY_TYPE_TIMESTAMP, query);
+
+    PIXEndEvent(commandList);
+    CpuProfiler::Get().EndScope();
+
+    if (mCommandCapture)
+    {
+        if (RecordingCommandList* recordingList = GetRecordingCommandList(commandList))
+            mCommandLog.EndPass(recordingList->GetListIndex(), recordingList->GetType());
+    }
+}
+
+void DXRSGraphics::ResolveGpuTimestamps(ID3D12GraphicsCommandList* commandList, GpuProfiler::QueueId queue)
+{
+    UINT first = 0;
+    UINT count = 0;
+    if (mGpuProfiler.GetResolveRange(queue, first, count))
+        commandList->ResolveQueryData(mTimestampQueryHeaps[queue].Get(), D3D12_QUERY_TYPE_TIMESTAMP, first, count, mTimestampReadbackBuffers[queue].Get(), first * sizeof(UINT64));
+}
+
+void DXRSGraphics::ReadGpuTimestamps(UINT frameSlot)
+{
+    // the readback ranges of the slot are written by this frame only, map just those
+    UINT64 offset = UINT64(frameSlot) * mGpuProfiler.GetMaxQueriesPerFrame() * sizeof(UINT64);
+    D3D12_RANGE readRange = { SIZE_T(offset), SIZE_T(offset + mGpuProfiler.GetMaxQueriesPerFrame() * sizeof(UINT64)) };
+    D3D12_RANGE writtenRange = { 0, 0 };
+
+    std::vector<const uint64_t*> timestamps(2, nullptr);
+    UINT8* data[2] = {};
+    for (int i = 0; i < 2; i++)
+    {
+        if (SUCCEEDED(mTimestampReadbackBuffers[i]->Map(0, &readRange, reinterpret_cast<void**>(&data[i]))))
+            timestamps[i] = reinterpret_cast<const uint64_t*>(data[i] + offset);
+    }
+
+    mGpuProfiler.ResolveFrame(frameSlot, timestamps);
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (timestamps[i])
+            mTimestampReadbackBuffers[i]->Unmap(0, &writtenRange);
+    }
 }
 
 void DXRSGraphics::GetAdapter(IDXGIAdapter1** ppAdapter)
@@ -691,6 +847,88 @@ void DXRSGraphics::GetAdapter(IDXGIAdapter1** ppAdapter)
     *ppAdapter = adapter.Detach();
 }
 
+// Same signature as D3DCompileFromFile (with the standard include handler), but looks the bytecode up
+// in the on-disk shader cache first and stores freshly compiled bytecode there.
+HRESULT DXRSGraphics::CompileShader(LPCWSTR fileName, const D3D_SHADER_MACRO* defines, LPCSTR entryPoint, LPCSTR target, UINT flags, ID3DBlob** code, ID3DBlob** errors)
+{
+    if (errors)
+        *errors = nullptr;
+
+    ShaderCache::Request request;
+    request.mPath = fileName;
+    request.mEntryPoint = entryPoint;
+    request.mTarget = target;
+    request.mFlags = flags;
+    request.mCompilerVersion = mD3DCompilerVersion;
+    request.mDefines = mGlobalShaderDefines;
+    for (const D3D_SHADER_MACRO* define = defines; define && define->Name; define++)
+        request.mDefines.emplace_back(define->Name, define->Definition ? define->Definition : "");
+
+    std::vector<D3D_SHADER_MACRO> macros;
+    for (auto& define : request.mDefines)
+        macros.push_back({ define.first.c_str(), define.second.c_str() });
+    macros.push_back({ nullptr, nullptr });
+
+    uint64_t key = 0;
+    bool hasKey = mShaderCache.ComputeKey(request, key);
+
+    if (hasKey)
+    {
+        std::lock_guard<std::mutex> lock(mCompiledShadersMutex);
+        auto it = mCompiledShaders.find(key);
+        if (it != mCompiledShaders.end())
+        {
+            // bytecode blobs are immutable, so the same blob can be handed out to every caller
+            *code = it->second.Get();
+            (*code)->AddRef();
+            return S_OK;
+        }
+    }
+
+    HRESULT hr = E_FAIL;
+    std::vector<uint8_t> bytecode;
+    if (hasKey && mShaderCache.Load(key, bytecode))
+    {
+        hr = D3DCreateBlob(bytecode.size(), code);
+        if (SUCCEEDED(hr))
+            memcpy((*code)->GetBufferPointer(), bytecode.data(), bytecode.size());
+    }
+
+    if (FAILED(hr))
+    {
+        hr = D3DCompileFromFile(fileName, macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, entryPoint, target, flags, 0, code, errors);
+        if (SUCCEEDED(hr) && hasKey)
+            mShaderCache.Store(key, (*code)->GetBufferPointer(), (*code)->GetBufferSize());
+    }
+
+    if (SUCCEEDED(hr) && hasKey)
+    {
+        std::lock_guard<std::mutex> lock(mCompiledShadersMutex);
+        mCompiledShaders[key] = *code;
+    }
+
+    return hr;
+}
+
+void DXRSGraphics::SetGlobalShaderDefine(const std::string& name, const std::string& value)
+{
+    for (auto& define : mGlobalShaderDefines)
+    {
+        if (define.first == name)
+        {
+            define.second = value;
+            return;
+        }
+    }
+    mGlobalShaderDefines.emplace_back(name, value);
+}
+
+void DXRSGraphics::ReleaseCompiledShaders()
+{
+    std::lock_guard<std::mutex> lock(mCompiledShadersMutex);
+    mCompiledShaders.clear();
+}
+
 // Compile a HLSL file into a DXIL library
 IDxcBlob* DXRSGraphics::CompileShaderLibrary(LPCWSTR fileName)
 {
@@ -707,6 +945,22 @@ IDxcBlob* DXRSGraphics::CompileShaderLibrary(LPCWSTR fileName)
         ThrowIfFailed(DxcCreateInstance(CLSID_DxcLibrary, __uuidof(IDxcLibrary), (void**)&pLibrary));
         ThrowIfFailed(pLibrary->CreateIncludeHandler(&dxcIncludeHandler));
     }
+
+    ShaderCache::Request request;
+    request.mPath = fileName;
+    request.mTarget = "lib_6_3";
+    request.mCompilerVersion = mDXCompilerVersion;
+
+    uint64_t key = 0;
+    bool hasKey = mShaderCache.ComputeKey(request, key);
+
+    std::vector<uint8_t> bytecode;
+    if (hasKey && mShaderCache.Load(key, bytecode))
+    {
+        IDxcBlobEncoding* pCachedBlob;
+        ThrowIfFailed(pLibrary->CreateBlobWithEncodingOnHeapCopy(bytecode.data(), (uint32_t)bytecode.size(), 0, &pCachedBlob));
+        return pCachedBlob;
+    }
     // Open and read the file
     std::ifstream shaderFile(fileName);
     if (shaderFile.good() == false)
@@ -753,10 +1007,25 @@ IDxcBlob* DXRSGraphics::CompileShaderLibrary(LPCWSTR fileName)
 
     IDxcBlob* pBlob;
     ThrowIfFailed(pResult->GetResult(&pBlob));
+
+    if (hasKey)
+        mShaderCache.Store(key, pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+
     return pBlob;
 }
 
 
+// Both compilers are linked through their import libraries, so they are loaded before the first compile
+uint64_t DXRSGraphics::GetLoadedCompilerVersion(LPCWSTR moduleName)
+{
+    HMODULE module = GetModuleHandleW(moduleName);
+    WCHAR path[MAX_PATH];
+    if (!module || !GetModuleFileNameW(module, path, MAX_PATH))
+        return 0;
+
+    return ShaderCache::GetCompilerVersion(path);
+}
+
 std::wstring DXRSGraphics::ExecutableDirectory()
 {
     WCHAR buffer[MAX_PATH];
@@ -15,11 +15,20 @@ using namespace Microsoft::WRL;
 #include <dxc/dxcapi.h>
 
 #include "Common.h"
+#include "ShaderCache.h"
+#include "FrameTimeline.h"
+#include "UploadManager.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "CommandLog.h"
+#include "RecordingCommandList.h"
 
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <filesystem>
+#include <map>
+#include <mutex>
 
 #define MAX_SCREEN_WIDTH 1920
 #define MAX_SCREEN_HEIGHT 1080
@@ -50,6 +59,30 @@ public:
     void SignalGraphicsFence2();
     void WaitForGraphicsToFinish();
     void WaitForGpu();
+    // Number of frames the CPU may record ahead of the GPU, independent of the swap chain buffer count.
+    // Flushes the GPU, call it between Present and the next Prepare.
+    void SetFramesInFlight(UINT count);
+    UINT GetFramesInFlight() const { return mFrameTimeline.GetFramesInFlight(); }
+    // Releases the object once the GPU has finished every frame submitted so far
+    void DeferRelease(ComPtr<IUnknown> object) { mFrameTimeline.Retire([object]() {}); }
+    FrameTimeline& GetFrameTimeline() { return mFrameTimeline; }
+    // Copy queue uploads, the batch recorded during a frame is submitted by the next Prepare
+    UploadManager& GetUploadManager() { return mUploadManager; }
+    // PIX region that is also timed with timestamp queries, the queue is taken from the command list type.
+    // Results are read back once the frame has completed on the GPU. The CPU profiler times the recording.
+    void BeginGpuEvent(ID3D12GraphicsCommandList* commandList, const char* name);
+    void EndGpuEvent(ID3D12GraphicsCommandList* commandList);
+    GpuProfiler& GetGpuProfiler() { return mGpuProfiler; }
+    GpuProfiler::QueueId GetGpuProfilerGraphicsQueue() const { return mGpuProfilerGraphics; }
+    GpuProfiler::QueueId GetGpuProfilerComputeQueue() const { return mGpuProfilerCompute; }
+    // Present waits for the vertical blank, benchmarks turn it off to measure uncapped frame times
+    void SetVSync(bool enabled) { mVSync = enabled; }
+    // Records the commands of the next frames into a command log, written to the path after the last one is presented.
+    // Only lists handed out by RecordCommands are recorded, the framework's own barriers and resolves are not.
+    void CaptureCommands(UINT frames, const std::string& path);
+    bool IsCapturingCommands() const { return mCommandCaptureFrames > 0; }
+    // The recording wrapper of the list while a capture runs, the list itself otherwise; submit the real list
+    ID3D12GraphicsCommandList* RecordCommands(ID3D12GraphicsCommandList* commandList);
     void TransitionMainRT(ID3D12GraphicsCommandList* cmdList, D3D12_RESOURCE_STATES beforeState);
 
     ID3D12Device*               GetD3DDevice() const { return mDevice.Get(); }
@@ -59,11 +92,11 @@ public:
     D3D_FEATURE_LEVEL           GetDeviceFeatureLevel() const { return mD3DFeatureLevel; }
     
     ID3D12CommandQueue*         GetCommandQueueGraphics() const { return mCommandQueueGraphics.Get(); }
-    ID3D12CommandAllocator*     GetCommandAllocatorGraphics(int i = 0) const { return mCommandAllocatorsGraphics[mBackBufferIndex][i].Get(); }
+    ID3D12CommandAllocator*     GetCommandAllocatorGraphics(int i = 0) const { return mCommandAllocatorsGraphics[mFrameSlot][i].Get(); }
     ID3D12GraphicsCommandList*  GetCommandListGraphics(int i = 0) const { return mCommandListGraphics[i].Get(); }
 
 	ID3D12CommandQueue*         GetCommandQueueCompute() const { return mCommandQueueCompute.Get(); }
-	ID3D12CommandAllocator*     GetCommandAllocatorCompute() const { return mCommandAllocatorsCompute[mBackBufferIndex].Get(); }
+	ID3D12CommandAllocator*     GetCommandAllocatorCompute() const { return mCommandAllocatorsCompute[mFrameSlot].Get(); }
 	ID3D12GraphicsCommandList*  GetCommandListCompute() const { return mCommandListCompute.Get(); }
    
     DXGI_FORMAT                 GetBackBufferFormat() const { return mBackBufferFormat; }
@@ -90,9 +123,19 @@ public:
 
     DXRS::DescriptorHeapManager* GetDescriptorHeapManager() { return mDescriptorHeapManager; }
     IDxcBlob* CompileShaderLibrary(LPCWSTR fileName);
+    HRESULT CompileShader(LPCWSTR fileName, const D3D_SHADER_MACRO* defines, LPCSTR entryPoint, LPCSTR target, UINT flags, ID3DBlob** code, ID3DBlob** errors = nullptr);
+    ShaderCache& GetShaderCache() { return mShaderCache; }
+    // Macros added to every CompileShader call, used to share constants between C++ and HLSL
+    void SetGlobalShaderDefine(const std::string& name, const std::string& value);
+    // Drops the in-memory bytecode kept by CompileShader, the on-disk cache is untouched
+    void ReleaseCompiledShaders();
 
     static const size_t                 MAX_BACK_BUFFER_COUNT = 3;
+    static constexpr UINT               MAX_FRAMES_IN_FLIGHT = 4;
     static UINT                         mBackBufferIndex;
+    // Per-frame resources (allocators, GPU descriptor heaps) are indexed by the frame slot, not the back buffer
+    static UINT                         mFrameSlot;
+    static constexpr UINT               GPU_PROFILER_QUERIES_PER_FRAME = 256;
 
     std::string GetFilePath(const std::string& input);
     std::wstring GetFilePath(const std::wstring& input);
@@ -103,6 +146,11 @@ private:
     DXRSGraphics& operator=(const DXRSGraphics& rhs);
 
     void MoveToNextFrame();
+    ID3D12Fence* GetTimelineFence(FrameTimeline::FenceId fence) const;
+    GpuProfiler::QueueId GetGpuProfilerQueue(ID3D12GraphicsCommandList* commandList) const;
+    RecordingCommandList* GetRecordingCommandList(ID3D12GraphicsCommandList* commandList) const;
+    void ResolveGpuTimestamps(ID3D12GraphicsCommandList* commandList, GpuProfiler::QueueId queue);
+    void ReadGpuTimestamps(UINT frameSlot);
     void GetAdapter(IDXGIAdapter1** ppAdapter);
     
     ComPtr<IDXGIFactory4>               mDXGIFactory;
@@ -113,23 +161,41 @@ private:
 
     ComPtr<ID3D12CommandQueue>          mCommandQueueGraphics;
     ComPtr<ID3D12GraphicsCommandList>   mCommandListGraphics[2];
-    ComPtr<ID3D12CommandAllocator>      mCommandAllocatorsGraphics[MAX_BACK_BUFFER_COUNT][2];
+    ComPtr<ID3D12CommandAllocator>      mCommandAllocatorsGraphics[MAX_FRAMES_IN_FLIGHT][2];
 
 	ComPtr<ID3D12CommandQueue>          mCommandQueueCompute;
 	ComPtr<ID3D12GraphicsCommandList>   mCommandListCompute;
-	ComPtr<ID3D12CommandAllocator>      mCommandAllocatorsCompute[MAX_BACK_BUFFER_COUNT];
+	ComPtr<ID3D12CommandAllocator>      mCommandAllocatorsCompute[MAX_FRAMES_IN_FLIGHT];
 
+    // Fence values are handed out by the timeline: end of frame and mid-frame signals on the graphics queue, compute queue
+    FrameTimeline                       mFrameTimeline;
+    FrameTimeline::FenceId              mTimelineFenceGraphics;
+    FrameTimeline::FenceId              mTimelineFenceGraphics2;
+    FrameTimeline::FenceId              mTimelineFenceCompute;
     ComPtr<ID3D12Fence>                 mFenceGraphics;
-    UINT64                              mFenceValuesGraphics[MAX_BACK_BUFFER_COUNT];
-    Wrappers::Event                     mFenceEventGraphics;
-
 	ComPtr<ID3D12Fence>                 mFenceGraphics2;
-	UINT64                              mFenceValuesGraphics2;
-	Wrappers::Event                     mFenceEventGraphics2;
-
 	ComPtr<ID3D12Fence>                 mFenceCompute;
-	UINT64                              mFenceValuesCompute;
-	Wrappers::Event                     mFenceEventCompute;
+    Wrappers::Event                     mFenceEvent;
+
+    UploadManager                       mUploadManager;
+
+    // Timestamp queries of the direct and compute queues, one range per frame slot
+    GpuProfiler                         mGpuProfiler;
+    GpuProfiler::QueueId                mGpuProfilerGraphics;
+    GpuProfiler::QueueId                mGpuProfilerCompute;
+    ComPtr<ID3D12QueryHeap>             mTimestampQueryHeaps[2];
+    ComPtr<ID3D12Resource>              mTimestampReadbackBuffers[2];
+
+    bool                                mVSync = true;
+
+    // Command capture: wrappers of graphics lists #1, #2 and the compute list, created on first use
+    CommandLog                          mCommandLog;
+    // The log while a capture runs, null otherwise; handed to the recording lists and the descriptor heaps
+    CommandLog*                         mCommandCapture = nullptr;
+    U_PTR<RecordingCommandList>         mRecordingCommandLists[3];
+    UINT                                mCommandCaptureFrames = 0;
+    UINT64                              mCommandCaptureFrameIndex = 0;
+    std::string                         mCommandCapturePath;
 
     ComPtr<ID3D12Resource>              mRenderTargets[MAX_BACK_BUFFER_COUNT];
     ComPtr<ID3D12Resource>              mDepthStencilTarget;
@@ -151,10 +217,18 @@ private:
 
     // Fullscreen Quad
     ComPtr<ID3D12Resource>              mFullscreenQuadVertexBuffer;
-    ComPtr<ID3D12Resource>              mFullscreenQuadVertexBufferUpload;
     D3D12_VERTEX_BUFFER_VIEW            mFullscreenQuadVertexBufferView;
 
     std::filesystem::path               mCurrentPath;
+    ShaderCache                         mShaderCache;
+    // ShaderCache::GetCompilerVersion of the loaded d3dcompiler_47.dll and dxcompiler.dll
+    uint64_t                            mD3DCompilerVersion = 0;
+    uint64_t                            mDXCompilerVersion = 0;
+    // CompileShader may be called from the startup compile queue's worker threads
+    std::map<uint64_t, ComPtr<ID3DBlob>> mCompiledShaders;
+    std::mutex                          mCompiledShadersMutex;
+    std::vector<std::pair<std::string, std::string>> mGlobalShaderDefines;
     std::wstring ExecutableDirectory();
+    static uint64_t GetLoadedCompilerVersion(LPCWSTR moduleName);
     bool mRaytracingTierAvailable = false;
 };
\ No newline at end of file
@@ -102,25 +102,18 @@ DXRSMesh::DXRSMesh(ID3D12Device* device, DXRSModel& model, aiMesh& mesh)
 	const UINT vertexBufferSize = static_cast<UINT>(mVertices.size()) * sizeof(Vertex);
 	const UINT indexBufferSize = mNumOfIndices * sizeof(mIndices[0]);
 
-	// Note: using upload heaps to transfer static data like vert buffers is not 
-	// recommended. Every time the GPU needs it, the upload heap will be marshalled 
-	// over. Please read up on Default Heap usage. An upload heap is used here for 
-	// code simplicity and because there are very few verts to actually transfer.
+	// Default heap buffers filled by the copy queue, the mesh is skipped while the copy is in flight
+	UploadManager& uploadManager = mModel.GetDXWrapper().GetUploadManager();
+
 	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
 		D3D12_HEAP_FLAG_NONE,
 		&CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
+		D3D12_RESOURCE_STATE_COMMON,
 		nullptr,
 		IID_PPV_ARGS(&mVertexBuffer)));
 
-	// Copy the triangle data to the vertex buffer.
-	UINT8* pVertexDataBegin;
-	CD3DX12_RANGE readRange(0, 0);
-
-	ThrowIfFailed(mVertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-	memcpy(pVertexDataBegin, &mVertices[0], vertexBufferSize);
-	mVertexBuffer->Unmap(0, nullptr);
+	uploadManager.UploadBuffer(mVertexBuffer.Get(), 0, &mVertices[0], vertexBufferSize);
 
 	// Initialize the vertex buffer view.
 	mVertexBufferView.BufferLocation = mVertexBuffer->GetGPUVirtualAddress();
@@ -128,19 +121,15 @@ DXRSMesh::DXRSMesh(ID3D12Device* device, DXRSModel& model, aiMesh& mesh)
 	mVertexBufferView.SizeInBytes = vertexBufferSize;
 
 	ThrowIfFailed(device->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
 		D3D12_HEAP_FLAG_NONE,
 		&CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
+		D3D12_RESOURCE_STATE_COMMON,
 		nullptr,
 		IID_PPV_ARGS(&mIndexBuffer)));
 
-	// Copy the triangle data to the vertex buffer.
-	UINT8* pIndexDataBegin;
-
-	ThrowIfFailed(mIndexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pIndexDataBegin)));
-	memcpy(pIndexDataBegin, &mIndices[0], indexBufferSize);
-	mIndexBuffer->Unmap(0, nullptr);
+	// batches complete in order, so the later handle covers the vertex buffer as well
+	mUploadHandle = uploadManager.UploadBuffer(mIndexBuffer.Get(), 0, &mIndices[0], indexBufferSize);
 
 	// Initialize the vertex buffer view.
 	mIndexBufferView.BufferLocation = mIndexBuffer->GetGPUVirtualAddress();
@@ -240,6 +229,11 @@ const std::vector<std::vector<XMFLOAT4>*>& DXRSMesh::VertexColors() const
 	return mVertexColors;
 }
 
+bool DXRSMesh::IsResident()
+{
+	return mModel.GetDXWrapper().GetUploadManager().IsComplete(mUploadHandle);
+}
+
 UINT DXRSMesh::FaceCount() const
 {
 	return mFaceCount;
@@ -2,6 +2,7 @@
 
 #include "Common.h"
 #include "DescriptorHeap.h"
+#include "UploadManager.h"
 
 struct aiMesh;
 class DXRSModel;
@@ -56,6 +57,10 @@ public:
 	DXRS::DescriptorHandle& GetVertexBufferSRV() { return mVertexBufferSRV; }
 
 	DXRSBuffer* GetMeshInfoBuffer() { return mMeshInfo; }
+
+	// False while the vertex and index data are still being copied
+	bool IsResident();
+	UploadManager::Handle GetUploadHandle() { return mUploadHandle; }
 		
 private:
 
@@ -85,6 +90,7 @@ private:
 
 	D3D12_VERTEX_BUFFER_VIEW mVertexBufferView;
 	D3D12_INDEX_BUFFER_VIEW mIndexBufferView;
+	UploadManager::Handle mUploadHandle = 0;
 
 	DXRS::DescriptorHandle mIndexBufferSRV;
 	DXRS::DescriptorHandle mVertexBufferSRV;
@@ -50,10 +50,10 @@ DXRSModel::DXRSModel(DXRSGraphics& dxWrapper, const std::string& filename, bool
 
 	mBufferCB = new DXRSBuffer(dxWrapper.GetD3DDevice(), dxWrapper.GetDescriptorHeapManager(), dxWrapper.GetCommandListGraphics(), desc, L"Model CB");
 
-	ModelConstantBuffer cbData = {};
-	cbData.World = transformWorld;
-	cbData.DiffuseColor = color;
-	memcpy(mBufferCB->Map(), &cbData, sizeof(cbData));
+	mConstants = {};
+	mConstants.World = transformWorld;
+	mConstants.DiffuseColor = color;
+	memcpy(mBufferCB->Map(), &mConstants, sizeof(mConstants));
 
 }
 
@@ -76,10 +76,10 @@ void DXRSModel::UpdateWorldMatrix(XMMATRIX matrix)
 {
 	mWorldMatrix = matrix;
 
-	ModelConstantBuffer cbData = {};
-	cbData.World = matrix;
-	cbData.DiffuseColor = mDiffuseColor;
-	memcpy(mBufferCB->Map(), &cbData, sizeof(cbData));
+	mConstants = {};
+	mConstants.World = matrix;
+	mConstants.DiffuseColor = mDiffuseColor;
+	memcpy(mBufferCB->Map(), &mConstants, sizeof(mConstants));
 }
 
 DXRSGraphics& DXRSModel::GetDXWrapper()
@@ -103,6 +103,10 @@ void DXRSModel::Render(ID3D12GraphicsCommandList* commandList)
 
 	for (DXRSMesh* mesh : mMeshes)
 	{
+		// streamed in on the copy queue, drawn from the first frame after the copy finished
+		if (!mesh->IsResident())
+			continue;
+
 		commandList->IASetVertexBuffers(0, 1, &mesh->GetVertexBufferView());
 		commandList->IASetIndexBuffer(&mesh->GetIndexBufferView());
 		commandList->DrawIndexedInstanced(mesh->GetIndicesNum(), 1, 0, 0, 0);
@@ -19,13 +19,14 @@ using namespace DirectX;
 
 class DXRSModel
 {
+public:
+	// perModelInstanceCB of the shaders, bound per draw as root constants or through GetCB()
 	__declspec(align(16)) struct ModelConstantBuffer
 	{
 		XMMATRIX	World;
 		XMFLOAT4	DiffuseColor;
 	};
 
-public:
 	DXRSModel(DXRSGraphics& dxWrapper, const std::string& filename, bool flipUVs = false, XMMATRIX tranformWorld = XMMatrixIdentity(), XMFLOAT4 color = XMFLOAT4(1, 0, 1, 1), bool isDynamic = false, float speed = 0.0f, float amplitude = 1.0f);
 	~DXRSModel();
 
@@ -34,6 +35,7 @@ public:
 	DXRSGraphics& GetDXWrapper();
 
 	DXRSBuffer* GetCB() { return mBufferCB; }
+	const ModelConstantBuffer& GetConstants() const { return mConstants; }
 	bool HasMeshes() const;
 	bool HasMaterials() const;
 
@@ -61,6 +63,7 @@ private:
 	DXRSGraphics& mDXWrapper;
 
 	DXRSBuffer* mBufferCB;
+	ModelConstantBuffer mConstants;
 
 	std::vector<DXRSMesh*> mMeshes;
 	std::vector<DXRSModelMaterial*> mMaterials;
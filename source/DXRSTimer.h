@@ -1,33 +1,46 @@
 #pragma once
 
-#include "Common.h"
+#include "FrameTimeStats.h"
 
+#include <chrono>
 #include <cmath>
-#include <exception>
+#include <functional>
 #include <stdint.h>
 
+// Update loop timing with a fixed or variable timestep.
+// Time comes from a clock source: std::chrono::steady_clock by default (QueryPerformanceCounter on Windows,
+// clock_gettime(CLOCK_MONOTONIC) on Linux), or an injected counter and its frequency, so tests and replays
+// can drive the timer with synthetic time. Every Run or Step also records the wall clock time since the
+// previous one in the frame time statistics, which show the stutter the per-second frame rate hides.
 class DXRSTimer
 {
 public:
+    // Monotonic counter, in ticks of the frequency passed along with it
+    typedef std::function<uint64_t()> ClockFunc;
+
     DXRSTimer()
         :
+        mClockSecondCounter(0),
         mElapsedTicks(0),
         mTotalTicks(0),
         mLeftOverTicks(0),
         mFrameCount(0),
         mFramesPerSecond(0),
         mFramesThisSecond(0),
-        mQPCSecondCounter(0),
-        mIsFixedTimeStep(false),
-        mTargetElapsedTicks(TicksPerSecond / 60)
+        mTargetElapsedTicks(TicksPerSecond / 60),
+        mIsFixedTimeStep(false)
     {
-        if (!QueryPerformanceFrequency(&mQPCFrequency))
-            throw std::exception("QueryPerformanceFrequency");
-
-        if (!QueryPerformanceCounter(&mQPCLastTime))
-            throw std::exception("QueryPerformanceCounter");
+        SetClock([]() { return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count()); },
+            static_cast<uint64_t>(std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num));
+    }
 
-        mQPCMaxDelta = static_cast<uint64_t>(mQPCFrequency.QuadPart / 10);
+    // Restarts the elapsed time from the new clock's current value
+    void SetClock(ClockFunc clock, uint64_t frequency)
+    {
+        mClock = clock;
+        mClockFrequency = frequency > 0 ? frequency : 1;
+        mClockMaxDelta = mClockFrequency / 10;
+        ResetElapsedTime();
     }
 
     uint64_t GetElapsedTicks() const { return mElapsedTicks; }
@@ -41,6 +54,10 @@ public:
     void SetTargetElapsedTicks(uint64_t targetElapsed) { mTargetElapsedTicks = targetElapsed; }
     void SetTargetElapsedSeconds(double targetElapsed) { mTargetElapsedTicks = SecondsToTicks(targetElapsed); }
 
+    // Wall clock frame times, unclamped; the first frame after a reset is not recorded
+    FrameTimeStats& GetFrameTimeStats() { return mFrameTimeStats; }
+    const FrameTimeStats& GetFrameTimeStats() const { return mFrameTimeStats; }
+
     static const uint64_t TicksPerSecond = 10000000;
 
     static double TicksToSeconds(uint64_t ticks) { return static_cast<double>(ticks) / TicksPerSecond; }
@@ -48,42 +65,29 @@ public:
 
     void ResetElapsedTime()
     {
-        if (!QueryPerformanceCounter(&mQPCLastTime))
-        {
-            throw std::exception("QueryPerformanceCounter");
-        }
+        mClockLastTime = mClock();
 
         mLeftOverTicks = 0;
         mFramesPerSecond = 0;
         mFramesThisSecond = 0;
-        mQPCSecondCounter = 0;
+        mClockSecondCounter = 0;
+        mSkipFrameTime = true;
     }
 
     template<typename TUpdate>
     void Run(const TUpdate& update)
     {
-        // Query the current time.
-        LARGE_INTEGER currentTime;
-
-        if (!QueryPerformanceCounter(&currentTime))
-        {
-            throw std::exception("QueryPerformanceCounter");
-        }
-
-        uint64_t timeDelta = static_cast<uint64_t>(currentTime.QuadPart - mQPCLastTime.QuadPart);
-
-        mQPCLastTime = currentTime;
-        mQPCSecondCounter += timeDelta;
+        uint64_t timeDelta = ReadClock();
 
         // Clamp excessively large time deltas (e.g. after paused in the debugger).
-        if (timeDelta > mQPCMaxDelta)
+        if (timeDelta > mClockMaxDelta)
         {
-            timeDelta = mQPCMaxDelta;
+            timeDelta = mClockMaxDelta;
         }
 
-        // Convert QPC units into a canonical tick format. This cannot overflow due to the previous clamp.
+        // Convert clock units into a canonical tick format. This cannot overflow due to the previous clamp.
         timeDelta *= TicksPerSecond;
-        timeDelta /= static_cast<uint64_t>(mQPCFrequency.QuadPart);
+        timeDelta /= mClockFrequency;
 
         uint32_t lastFrameCount = mFrameCount;
 
@@ -132,20 +136,60 @@ public:
             mFramesThisSecond++;
         }
 
-        if (mQPCSecondCounter >= static_cast<uint64_t>(mQPCFrequency.QuadPart))
+        UpdateFramesPerSecond();
+    }
+
+    // Advances exactly one fixed step of the target elapsed time, however long the frame took, so every
+    // machine simulates the same frames (benchmarks). The frame rate still follows the wall clock.
+    template<typename TUpdate>
+    void Step(const TUpdate& update)
+    {
+        ReadClock();
+
+        mElapsedTicks = mTargetElapsedTicks;
+        mTotalTicks += mTargetElapsedTicks;
+        mLeftOverTicks = 0;
+        mFrameCount++;
+
+        update();
+
+        mFramesThisSecond++;
+        UpdateFramesPerSecond();
+    }
+
+private:
+    // Clock ticks since the previous call, also recorded as the frame time
+    uint64_t ReadClock()
+    {
+        uint64_t currentTime = mClock();
+        uint64_t timeDelta = currentTime - mClockLastTime;
+
+        mClockLastTime = currentTime;
+        mClockSecondCounter += timeDelta;
+
+        if (!mSkipFrameTime)
+            mFrameTimeStats.AddFrame(static_cast<double>(timeDelta) * 1000.0 / static_cast<double>(mClockFrequency));
+        mSkipFrameTime = false;
+
+        return timeDelta;
+    }
+
+    void UpdateFramesPerSecond()
+    {
+        if (mClockSecondCounter >= mClockFrequency)
         {
             mFramesPerSecond = mFramesThisSecond;
             mFramesThisSecond = 0;
-            mQPCSecondCounter %= static_cast<uint64_t>(mQPCFrequency.QuadPart);
+            mClockSecondCounter %= mClockFrequency;
         }
     }
 
-private:
-    // Source timing data uses QPC units.
-    LARGE_INTEGER mQPCFrequency;
-    LARGE_INTEGER mQPCLastTime;
-    uint64_t mQPCMaxDelta;
-    uint64_t mQPCSecondCounter;
+    // Source timing data uses clock units.
+    ClockFunc mClock;
+    uint64_t mClockFrequency;
+    uint64_t mClockLastTime;
+    uint64_t mClockMaxDelta;
+    uint64_t mClockSecondCounter;
 
     uint64_t mElapsedTicks;
     uint64_t mTotalTicks;
@@ -155,5 +199,7 @@ private:
     uint32_t mFramesThisSecond;
     uint64_t mTargetElapsedTicks;
     bool mIsFixedTimeStep;
-};
+    bool mSkipFrameTime = true;
 
+    FrameTimeStats mFrameTimeStats;
+};
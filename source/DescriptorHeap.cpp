@@ -132,7 +132,7 @@ namespace DXRS
 		mCPUDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_DSV] = new CPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 128);
 		mCPUDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER] = new CPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 16);
 
-		for (UINT i = 0; i < DXRSGraphics::MAX_BACK_BUFFER_COUNT; i++)
+		for (UINT i = 0; i < DXRSGraphics::MAX_FRAMES_IN_FLIGHT; i++)
 		{
 			ZeroMemory(mGPUDescriptorHeaps[i], sizeof(mGPUDescriptorHeaps[i]));
 			mGPUDescriptorHeaps[i][D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV] = new GPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, MaxNoofSRVDescriptors);
@@ -147,7 +147,7 @@ namespace DXRS
 			if (mCPUDescriptorHeaps[i])
 				delete mCPUDescriptorHeaps[i];
 
-			for (UINT j = 0; j < DXRSGraphics::MAX_BACK_BUFFER_COUNT; j++)
+			for (UINT j = 0; j < DXRSGraphics::MAX_FRAMES_IN_FLIGHT; j++)
 			{
 				if (mGPUDescriptorHeaps[j][i])
 					delete mGPUDescriptorHeaps[j][i];
@@ -157,15 +157,30 @@ namespace DXRS
 
 	DescriptorHandle DescriptorHeapManager::CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType)
 	{
-		const UINT currentFrame = DXRSGraphics::mBackBufferIndex;
+		const UINT currentFrame = DXRSGraphics::mFrameSlot;
 
 		return mCPUDescriptorHeaps[heapType]->GetNewHandle();
 	}
 
 	DescriptorHandle DescriptorHeapManager::CreateGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType, UINT count)
 	{
-		const UINT currentFrame = DXRSGraphics::mBackBufferIndex;
+		const UINT currentFrame = DXRSGraphics::mFrameSlot;
 
 		return mGPUDescriptorHeaps[currentFrame][heapType]->GetHandleBlock(count);
 	}
+
+	void DescriptorHeapManager::SetCommandLog(CommandLog* log)
+	{
+		for (int i = 0; i < D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES; i++)
+		{
+			if (mCPUDescriptorHeaps[i])
+				mCPUDescriptorHeaps[i]->SetCommandLog(log);
+
+			for (UINT j = 0; j < DXRSGraphics::MAX_FRAMES_IN_FLIGHT; j++)
+			{
+				if (mGPUDescriptorHeaps[j][i])
+					mGPUDescriptorHeaps[j][i]->SetCommandLog(log);
+			}
+		}
+	}
 }
\ No newline at end of file
@@ -45,17 +45,23 @@ namespace DXRS
 		D3D12_GPU_DESCRIPTOR_HANDLE GetHeapGPUStart() { return mDescriptorHeapGPUStart; }
 		UINT GetMaxNoofDescriptors() { return mMaxNumDescriptors; }
 		UINT GetDescriptorSize() { return mDescriptorSize; }
+		// Descriptor copies are added to the log while one is set (a command capture runs), null for none
+		void SetCommandLog(CommandLog* log) { mCommandLog = log; }
 
 		void AddToHandle(ID3D12Device* device, DXRS::DescriptorHandle& destCPUHandle, DXRS::DescriptorHandle& sourceCPUHandle)
 		{
 			device->CopyDescriptorsSimple(1, destCPUHandle.GetCPUHandle(), sourceCPUHandle.GetCPUHandle(), mHeapType);
 			destCPUHandle.GetCPUHandle().ptr += mDescriptorSize;
+			if (mCommandLog)
+				mCommandLog->AddToCurrentList(CommandLog::OP_DESCRIPTOR_COPY, { 1 });
 		}
 
 		void AddToHandle(ID3D12Device* device, DXRS::DescriptorHandle& destCPUHandle, D3D12_CPU_DESCRIPTOR_HANDLE& sourceCPUHandle)
 		{
 			device->CopyDescriptorsSimple(1, destCPUHandle.GetCPUHandle(), sourceCPUHandle, mHeapType);
 			destCPUHandle.GetCPUHandle().ptr += mDescriptorSize;
+			if (mCommandLog)
+				mCommandLog->AddToCurrentList(CommandLog::OP_DESCRIPTOR_COPY, { 1 });
 		}
 
 	protected:
@@ -66,6 +72,7 @@ namespace DXRS
 		UINT mMaxNumDescriptors;
 		UINT mDescriptorSize;
 		bool mIsReferencedByShader;
+		CommandLog* mCommandLog = nullptr;
 	};
 
 	class CPUDescriptorHeap : public DescriptorHeap
@@ -104,15 +111,17 @@ namespace DXRS
 
 		DescriptorHandle CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType);
 		DescriptorHandle CreateGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType, UINT count);
+		// Sets the log of every heap
+		void SetCommandLog(CommandLog* log);
 
 		GPUDescriptorHeap* GetGPUHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType)
 		{
-			return mGPUDescriptorHeaps[DXRSGraphics::mBackBufferIndex][heapType];
+			return mGPUDescriptorHeaps[DXRSGraphics::mFrameSlot][heapType];
 		}
 
 	private:
 		CPUDescriptorHeap* mCPUDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
-		GPUDescriptorHeap* mGPUDescriptorHeaps[DXRSGraphics::MAX_BACK_BUFFER_COUNT][D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
+		GPUDescriptorHeap* mGPUDescriptorHeaps[DXRSGraphics::MAX_FRAMES_IN_FLIGHT][D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
 
 	};
 }
@@ -0,0 +1,44 @@
+#include "FileWatcher.h"
+
+FileWatcher::Entry FileWatcher::Query(const std::filesystem::path& path)
+{
+	Entry entry;
+	std::error_code ec;
+	entry.mLastWriteTime = std::filesystem::last_write_time(path, ec);
+	entry.mExists = !ec;
+	return entry;
+}
+
+void FileWatcher::Watch(const std::filesystem::path& path)
+{
+	std::filesystem::path file = path.lexically_normal();
+	if (mFiles.find(file) == mFiles.end())
+		mFiles[file] = Query(file);
+}
+
+void FileWatcher::Unwatch(const std::filesystem::path& path)
+{
+	mFiles.erase(path.lexically_normal());
+}
+
+std::vector<std::filesystem::path> FileWatcher::Poll()
+{
+	std::vector<std::filesystem::path> changed;
+	for (auto& file : mFiles)
+	{
+		Entry current = Query(file.first);
+		if (!current.mExists)
+		{
+			// keep the old timestamp, a save through delete + rename shows up once the file is back
+			file.second.mExists = false;
+			continue;
+		}
+
+		if (!file.second.mExists || current.mLastWriteTime != file.second.mLastWriteTime)
+		{
+			changed.push_back(file.first);
+			file.second = current;
+		}
+	}
+	return changed;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <vector>
+
+// Detects modified files by polling their last write time. Poll() is cheap enough to call every few
+// hundred milliseconds for the few dozen shader files of a scene, and works the same on every platform
+// std::filesystem supports. A native backend (ReadDirectoryChangesW, inotify) would only replace Poll().
+// Files that are missing (e.g. while an editor replaces them) are reported once they reappear.
+class FileWatcher
+{
+public:
+    // Adding a watched file again keeps its current timestamp
+    void Watch(const std::filesystem::path& path);
+    void Unwatch(const std::filesystem::path& path);
+    void Clear() { mFiles.clear(); }
+
+    // Files whose last write time changed since they were added or last reported
+    std::vector<std::filesystem::path> Poll();
+
+    size_t GetWatchedCount() const { return mFiles.size(); }
+
+private:
+    struct Entry
+    {
+        std::filesystem::file_time_type mLastWriteTime;
+        bool mExists = false;
+    };
+
+    static Entry Query(const std::filesystem::path& path);
+
+    std::map<std::filesystem::path, Entry> mFiles;
+};
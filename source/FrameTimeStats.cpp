@@ -0,0 +1,156 @@
+#include "FrameTimeStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+FrameTimeStats::FrameTimeStats(uint32_t windowSize, double bucketMs, uint32_t bucketCount)
+	: mFrames(std::max(windowSize, 1u), 0.0)
+	, mHitches(std::max(windowSize, 1u), false)
+	, mHistogram(std::max(bucketCount, 1u), 0)
+	, mBucketMs(bucketMs > 0.0 ? bucketMs : DEFAULT_BUCKET_MS)
+{
+}
+
+uint32_t FrameTimeStats::GetBucket(double ms) const
+{
+	if (!(ms > 0.0))
+		return 0;
+	double bucket = std::floor(ms / mBucketMs);
+	return bucket >= double(mHistogram.size() - 1) ? static_cast<uint32_t>(mHistogram.size() - 1) : static_cast<uint32_t>(bucket);
+}
+
+bool FrameTimeStats::AddFrame(double ms)
+{
+	// the median before this frame is the reference, otherwise a long hitch would raise its own bar
+	bool hitch = false;
+	double median = 0.0;
+	if (mWindowCount >= MIN_FRAMES_FOR_HITCHES)
+	{
+		median = GetMedianMs();
+		hitch = ms > median * mHitchFactor && ms - median >= mMinHitchMs;
+	}
+
+	uint32_t windowSize = GetWindowSize();
+	if (mWindowCount == windowSize)
+		mHistogram[GetBucket(mFrames[mNext])]--;
+	else
+		mWindowCount++;
+
+	mFrames[mNext] = ms;
+	mHitches[mNext] = hitch;
+	mHistogram[GetBucket(ms)]++;
+	mNext = (mNext + 1) % windowSize;
+
+	if (hitch)
+	{
+		Hitch entry;
+		entry.mFrame = mFrameCount;
+		entry.mMs = ms;
+		entry.mMedianMs = median;
+		mRecentHitches.push_back(entry);
+		if (mRecentHitches.size() > MAX_RECENT_HITCHES)
+			mRecentHitches.pop_front();
+		mHitchCount++;
+	}
+	mFrameCount++;
+	return hitch;
+}
+
+void FrameTimeStats::Clear()
+{
+	std::fill(mFrames.begin(), mFrames.end(), 0.0);
+	std::fill(mHitches.begin(), mHitches.end(), false);
+	std::fill(mHistogram.begin(), mHistogram.end(), 0u);
+	mNext = 0;
+	mWindowCount = 0;
+	mFrameCount = 0;
+	mHitchCount = 0;
+	mRecentHitches.clear();
+}
+
+double FrameTimeStats::GetLastFrameMs() const
+{
+	if (mWindowCount == 0)
+		return 0.0;
+	return mFrames[(mNext + GetWindowSize() - 1) % GetWindowSize()];
+}
+
+std::vector<float> FrameTimeStats::GetFrameTimes() const
+{
+	std::vector<float> frames;
+	frames.reserve(mWindowCount);
+	uint32_t first = (mNext + GetWindowSize() - mWindowCount) % GetWindowSize();
+	for (uint32_t i = 0; i < mWindowCount; i++)
+		frames.push_back(static_cast<float>(mFrames[(first + i) % GetWindowSize()]));
+	return frames;
+}
+
+double FrameTimeStats::GetMedianMs() const
+{
+	if (mWindowCount == 0)
+		return 0.0;
+
+	uint32_t rank = (mWindowCount + 1) / 2;
+	uint32_t cumulative = 0;
+	for (uint32_t i = 0; i < mHistogram.size(); i++)
+	{
+		cumulative += mHistogram[i];
+		if (cumulative >= rank)
+			return (double(i) + 0.5) * mBucketMs;
+	}
+	return double(mHistogram.size()) * mBucketMs;
+}
+
+FrameTimeStats::Summary FrameTimeStats::GetSummary() const
+{
+	Summary summary;
+	if (mWindowCount == 0)
+		return summary;
+
+	std::vector<double> sorted;
+	sorted.reserve(mWindowCount);
+	uint32_t first = (mNext + GetWindowSize() - mWindowCount) % GetWindowSize();
+	double previous = 0.0;
+	for (uint32_t i = 0; i < mWindowCount; i++)
+	{
+		uint32_t index = (first + i) % GetWindowSize();
+		double ms = mFrames[index];
+		sorted.push_back(ms);
+		summary.mAverageMs += ms;
+		if (i > 0)
+			summary.mJitterMs += std::fabs(ms - previous);
+		summary.mHitchCount += mHitches[index] ? 1 : 0;
+		previous = ms;
+	}
+
+	summary.mCount = mWindowCount;
+	summary.mAverageMs /= double(mWindowCount);
+	if (mWindowCount > 1)
+		summary.mJitterMs /= double(mWindowCount - 1);
+	for (double ms : sorted)
+		summary.mStdDevMs += (ms - summary.mAverageMs) * (ms - summary.mAverageMs);
+	summary.mStdDevMs = std::sqrt(summary.mStdDevMs / double(mWindowCount));
+
+	std::sort(sorted.begin(), sorted.end());
+	auto percentile = [&](double p) {
+		// nearest rank
+		size_t rank = static_cast<size_t>(p * double(sorted.size()) + 0.999999);
+		rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+		return sorted[rank - 1];
+	};
+	summary.mMinMs = sorted.front();
+	summary.mP50Ms = percentile(0.50);
+	summary.mP95Ms = percentile(0.95);
+	summary.mP99Ms = percentile(0.99);
+	summary.mMaxMs = sorted.back();
+	return summary;
+}
+
+FrameTimeStats::Summary FrameTimeStats::Summarize(const std::vector<double>& frameMs, double hitchFactor, double minHitchMs)
+{
+	FrameTimeStats stats(static_cast<uint32_t>(std::max<size_t>(frameMs.size(), 1)));
+	stats.SetHitchThreshold(hitchFactor, minHitchMs);
+	for (double ms : frameMs)
+		stats.AddFrame(ms);
+	return stats.GetSummary();
+}
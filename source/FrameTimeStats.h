@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Rolling statistics of the last frame times: a ring of the last N frames, a histogram of the same window
+// (fixed width buckets, the last one also collects everything above it) and hitch detection.
+// A frame is a hitch when it takes more than the hitch factor times the window's median and at least the
+// minimum hitch time more than the median. The median comes from the histogram, so adding a frame costs
+// O(buckets) and never sorts. Pacing is reported as the standard deviation of the window and as jitter, the
+// mean difference between consecutive frames, which tells steady 20 ms frames from alternating 10/30 ms ones.
+// Only uses the standard library.
+class FrameTimeStats
+{
+public:
+    struct Summary
+    {
+        uint64_t mCount = 0;
+        double mMinMs = 0.0;
+        double mAverageMs = 0.0;
+        double mP50Ms = 0.0;
+        double mP95Ms = 0.0;
+        double mP99Ms = 0.0;
+        double mMaxMs = 0.0;
+        double mStdDevMs = 0.0;
+        double mJitterMs = 0.0;
+        uint64_t mHitchCount = 0;
+    };
+
+    struct Hitch
+    {
+        uint64_t mFrame = 0;        // index since the last Clear
+        double mMs = 0.0;
+        double mMedianMs = 0.0;     // of the window when the hitch happened
+    };
+
+    static constexpr uint32_t DEFAULT_WINDOW = 600;
+    static constexpr double DEFAULT_BUCKET_MS = 0.5;
+    static constexpr uint32_t DEFAULT_BUCKET_COUNT = 100;
+    static constexpr double DEFAULT_HITCH_FACTOR = 2.0;
+    static constexpr double DEFAULT_MIN_HITCH_MS = 4.0;
+    // Frames in the window before hitches are detected, the median of a handful of frames means nothing
+    static constexpr uint32_t MIN_FRAMES_FOR_HITCHES = 8;
+    static constexpr uint32_t MAX_RECENT_HITCHES = 16;
+
+    explicit FrameTimeStats(uint32_t windowSize = DEFAULT_WINDOW, double bucketMs = DEFAULT_BUCKET_MS, uint32_t bucketCount = DEFAULT_BUCKET_COUNT);
+
+    void SetHitchThreshold(double factor, double minMs) { mHitchFactor = factor; mMinHitchMs = minMs; }
+
+    // Returns true if the frame is a hitch
+    bool AddFrame(double ms);
+    void Clear();
+
+    // Frames added since the last Clear
+    uint64_t GetFrameCount() const { return mFrameCount; }
+    uint32_t GetWindowCount() const { return mWindowCount; }
+    uint32_t GetWindowSize() const { return static_cast<uint32_t>(mFrames.size()); }
+    double GetLastFrameMs() const;
+
+    // The window oldest first, for ImGui::PlotLines
+    std::vector<float> GetFrameTimes() const;
+    // Frames of the window per bucket, bucket i covers [i, i + 1) * GetBucketMs()
+    const std::vector<uint32_t>& GetHistogram() const { return mHistogram; }
+    double GetBucketMs() const { return mBucketMs; }
+    // Middle of the bucket holding the median
+    double GetMedianMs() const;
+
+    // Since the last Clear
+    uint64_t GetHitchCount() const { return mHitchCount; }
+    const std::deque<Hitch>& GetRecentHitches() const { return mRecentHitches; }
+
+    // Exact percentiles (nearest rank) over the window, mHitchCount counts the hitches still in the window
+    Summary GetSummary() const;
+    // Streams the frames through a window as large as the sequence
+    static Summary Summarize(const std::vector<double>& frameMs, double hitchFactor = DEFAULT_HITCH_FACTOR, double minHitchMs = DEFAULT_MIN_HITCH_MS);
+
+private:
+    uint32_t GetBucket(double ms) const;
+
+    std::vector<double> mFrames;        // ring
+    std::vector<bool> mHitches;         // per ring entry
+    std::vector<uint32_t> mHistogram;
+    double mBucketMs;
+    double mHitchFactor = DEFAULT_HITCH_FACTOR;
+    double mMinHitchMs = DEFAULT_MIN_HITCH_MS;
+    uint32_t mNext = 0;
+    uint32_t mWindowCount = 0;
+    uint64_t mFrameCount = 0;
+    uint64_t mHitchCount = 0;
+    std::deque<Hitch> mRecentHitches;
+};
@@ -0,0 +1,140 @@
+#include "FrameTimeline.h"
+
+#include <algorithm>
+#include <cassert>
+
+FrameTimeline::FrameTimeline(uint32_t framesInFlight)
+	: mFramesInFlight(std::min(std::max(framesInFlight, 1u), MAX_FRAMES_IN_FLIGHT))
+{
+}
+
+FrameTimeline::FenceId FrameTimeline::AddFence(const std::string& name, uint64_t initialValue)
+{
+	Fence fence;
+	fence.mName = name;
+	fence.mLastSignaled = initialValue;
+	mFences.push_back(fence);
+
+	// frames that ended before the fence existed only waited on the older ones
+	for (auto& frame : mPendingFrames)
+		frame.mFenceValues.push_back(initialValue);
+
+	return static_cast<FenceId>(mFences.size() - 1);
+}
+
+void FrameTimeline::SetFramesInFlight(uint32_t count)
+{
+	count = std::min(std::max(count, 1u), MAX_FRAMES_IN_FLIGHT);
+	if (count == mFramesInFlight)
+		return;
+
+	// pending frames hold slots of the old mapping
+	while (!mPendingFrames.empty())
+	{
+		WaitForFrame(mPendingFrames.front());
+		RetireFrontFrame();
+	}
+	mFramesInFlight = count;
+}
+
+uint64_t FrameTimeline::Signal(FenceId fence)
+{
+	assert(fence < mFences.size());
+	return ++mFences[fence].mLastSignaled;
+}
+
+bool FrameTimeline::IsComplete(FenceId fence, uint64_t value) const
+{
+	return mCompletedValueFunc(fence) >= value;
+}
+
+bool FrameTimeline::IsFrameComplete(const Frame& frame) const
+{
+	for (size_t i = 0; i < frame.mFenceValues.size(); i++)
+	{
+		if (!IsComplete(static_cast<FenceId>(i), frame.mFenceValues[i]))
+			return false;
+	}
+	return true;
+}
+
+void FrameTimeline::WaitForFrame(const Frame& frame)
+{
+	for (size_t i = 0; i < frame.mFenceValues.size(); i++)
+	{
+		FenceId fence = static_cast<FenceId>(i);
+		if (!IsComplete(fence, frame.mFenceValues[i]))
+			mWaitFunc(fence, frame.mFenceValues[i]);
+	}
+}
+
+void FrameTimeline::RetireFrontFrame()
+{
+	// the frame is popped first so callbacks may register new retires
+	Frame frame = std::move(mPendingFrames.front());
+	mPendingFrames.pop_front();
+
+	for (auto& retire : frame.mRetires)
+		retire();
+	mStats.mRetiredCount += frame.mRetires.size();
+}
+
+uint32_t FrameTimeline::BeginFrame()
+{
+	// the slot was last used by frame mFrameNumber - mFramesInFlight, everything up to it has to be done
+	bool stalled = false;
+	while (!mPendingFrames.empty() && mPendingFrames.front().mNumber + mFramesInFlight <= mFrameNumber)
+	{
+		if (!IsFrameComplete(mPendingFrames.front()))
+		{
+			stalled = true;
+			WaitForFrame(mPendingFrames.front());
+		}
+		RetireFrontFrame();
+	}
+	if (stalled)
+		mStats.mStallCount++;
+
+	Update();
+	return GetFrameSlot();
+}
+
+void FrameTimeline::EndFrame()
+{
+	Frame frame;
+	frame.mNumber = mFrameNumber;
+	frame.mFenceValues.reserve(mFences.size());
+	for (auto& fence : mFences)
+		frame.mFenceValues.push_back(fence.mLastSignaled);
+	frame.mRetires.swap(mCurrentRetires);
+	mPendingFrames.push_back(std::move(frame));
+
+	mFrameNumber++;
+	mStats.mFrameCount++;
+}
+
+void FrameTimeline::Update()
+{
+	// retire in order, a later frame never finishes its callbacks before an earlier one
+	while (!mPendingFrames.empty() && IsFrameComplete(mPendingFrames.front()))
+		RetireFrontFrame();
+}
+
+void FrameTimeline::Flush()
+{
+	for (size_t i = 0; i < mFences.size(); i++)
+	{
+		FenceId fence = static_cast<FenceId>(i);
+		if (!IsComplete(fence, mFences[i].mLastSignaled))
+			mWaitFunc(fence, mFences[i].mLastSignaled);
+	}
+
+	while (!mPendingFrames.empty())
+		RetireFrontFrame();
+
+	std::vector<RetireFunc> retires;
+	retires.swap(mCurrentRetires);
+	for (auto& retire : retires)
+		retire();
+	mStats.mRetiredCount += retires.size();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+// CPU side bookkeeping of the frames the GPU has not finished yet.
+// Every fence (usually one per queue) gets monotonically increasing values handed out by Signal; a frame
+// remembers the last value of every fence when it ends, and is complete once all of them have been reached.
+// BeginFrame only blocks when the frame that used the same slot FramesInFlight frames ago is still running,
+// so the depth can be larger than the swap chain buffer count. Retire callbacks registered during a frame
+// run once that frame is complete (deferred releases, ring buffer reclaim).
+// Only uses the standard library; the GPU is reached through the completed value and wait functions,
+// so the timeline can be driven by a simulated GPU without a device.
+class FrameTimeline
+{
+public:
+    typedef uint32_t FenceId;
+    typedef std::function<uint64_t(FenceId fence)> CompletedValueFunc;
+    // Blocks until the fence has reached the value
+    typedef std::function<void(FenceId fence, uint64_t value)> WaitFunc;
+    typedef std::function<void()> RetireFunc;
+
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 8;
+
+    struct Stats
+    {
+        uint64_t mFrameCount = 0;
+        uint64_t mStallCount = 0;       // BeginFrame calls that had to wait for the GPU
+        uint64_t mRetiredCount = 0;     // retire callbacks run
+    };
+
+    explicit FrameTimeline(uint32_t framesInFlight = 2);
+
+    // Fences start at initialValue, the first Signal returns initialValue + 1
+    FenceId AddFence(const std::string& name, uint64_t initialValue = 0);
+    void SetCompletedValueFunc(CompletedValueFunc func) { mCompletedValueFunc = func; }
+    void SetWaitFunc(WaitFunc func) { mWaitFunc = func; }
+
+    // Call between frames; flushes since the frame to slot mapping changes
+    void SetFramesInFlight(uint32_t count);
+    uint32_t GetFramesInFlight() const { return mFramesInFlight; }
+
+    // Reserves the next value of the fence for the current frame, the caller signals it on its queue
+    uint64_t Signal(FenceId fence);
+    // Value the next Signal will return, for GPU waits on work that is submitted later in the frame
+    uint64_t GetNextValue(FenceId fence) const { return mFences[fence].mLastSignaled + 1; }
+    uint64_t GetLastSignaledValue(FenceId fence) const { return mFences[fence].mLastSignaled; }
+    bool IsComplete(FenceId fence, uint64_t value) const;
+    const std::string& GetFenceName(FenceId fence) const { return mFences[fence].mName; }
+    uint32_t GetFenceCount() const { return static_cast<uint32_t>(mFences.size()); }
+
+    // Waits until the slot of the new frame is free and runs the retire callbacks of finished frames.
+    // Returns the slot, i.e. the index of the per-frame resources (allocators, upload rings) to use.
+    uint32_t BeginFrame();
+    void EndFrame();
+
+    uint64_t GetFrameNumber() const { return mFrameNumber; }
+    uint32_t GetFrameSlot() const { return static_cast<uint32_t>(mFrameNumber % mFramesInFlight); }
+
+    // Runs after everything signaled up to the end of the current frame has completed
+    void Retire(RetireFunc func) { mCurrentRetires.push_back(func); }
+    // Runs the callbacks of finished frames without waiting
+    void Update();
+    // Waits for every fence's last signaled value and runs all pending callbacks, the current frame's included.
+    // Everything recorded so far has to be submitted and signaled.
+    void Flush();
+
+    uint32_t GetPendingFrameCount() const { return static_cast<uint32_t>(mPendingFrames.size()); }
+    const Stats& GetStats() const { return mStats; }
+
+private:
+    struct Fence
+    {
+        std::string mName;
+        uint64_t mLastSignaled = 0;
+    };
+
+    struct Frame
+    {
+        uint64_t mNumber = 0;
+        std::vector<uint64_t> mFenceValues;     // last signaled value per fence when the frame ended
+        std::vector<RetireFunc> mRetires;
+    };
+
+    bool IsFrameComplete(const Frame& frame) const;
+    void WaitForFrame(const Frame& frame);
+    void RetireFrontFrame();
+
+    std::vector<Fence> mFences;
+    std::deque<Frame> mPendingFrames;           // ended but not retired, oldest first
+    std::vector<RetireFunc> mCurrentRetires;
+    CompletedValueFunc mCompletedValueFunc;
+    WaitFunc mWaitFunc;
+    uint32_t mFramesInFlight;
+    uint64_t mFrameNumber = 0;
+    Stats mStats;
+};
@@ -0,0 +1,54 @@
+#include "GIPassGraph.h"
+
+namespace GIPassGraph
+{
+	Passes Build(AsyncComputeScheduler& scheduler, const Settings& settings)
+	{
+		// lightcuts: the tree build plus the cut, a cluster costs about 8 samples and the cuts of the sample scene fill
+		// most of their budget (tools/RSMLightcutsBench)
+		float rsmGatherCost = settings.mRSMUseLightcuts ? 0.2f + 2.0f * 8.0f * settings.mRSMLightcutsMaxClusters / settings.mRSMMaxSamplesCount :
+			2.0f * settings.mRSMSamplesCount / settings.mRSMMaxSamplesCount;
+		// tile classification: the tree build and the classifier, then the gather skips 0.75 - 0.95 of the tiles of
+		// tools/RSMTileBench; halved to keep the cleared and reduced tiles and the less favourable views in
+		if (!settings.mRSMUseLightcuts && settings.mRSMUseTileClassification)
+			rsmGatherCost = 0.25f + 0.5f * rsmGatherCost;
+		// interleaving divides the samples per pixel, the resolve reads a window and the history
+		if (!settings.mRSMUseLightcuts && (settings.mRSMInterleaveSize > 1 || settings.mRSMTemporalAccumulation))
+			rsmGatherCost = rsmGatherCost / float(settings.mRSMInterleaveSize * settings.mRSMInterleaveSize) + 0.15f;
+		float rsmCost = 0.0f;
+		if (settings.mUseRSM)
+			rsmCost = (settings.mRSMComputeVersion ? rsmGatherCost : 0.0f) + (settings.mRSMUseUpsampleAndBlur ? 0.3f : 0.0f);
+		float vctCost = settings.mUseVCT ? 0.6f + 0.3f * settings.mVCTConesCount : 0.0f;
+
+		scheduler.Clear();
+		scheduler.SetFenceCost(0.02f);
+
+		Passes passes;
+		passes.mGBuffer = scheduler.AddPass("GBuffer", 1.0f);
+		passes.mShadows = scheduler.AddPass("Shadows", 0.5f);
+		passes.mRSMBuffers = scheduler.AddPass("RSM buffers", (settings.mUseRSM || settings.mUseLPV) ? 0.3f : 0.0f);
+		passes.mLPV = scheduler.AddPass("LPV", settings.mUseLPV ? 0.8f : 0.0f);
+		passes.mVoxelization = scheduler.AddPass("Voxelization", settings.mUseVCT ? 1.0f : 0.0f);
+		passes.mRSM = scheduler.AddPass("RSM", rsmCost, true, rsmCost * 1.1f);
+		passes.mVCT = scheduler.AddPass("VCT", vctCost, true, vctCost * 1.1f);
+		passes.mLighting = scheduler.AddPass("Lighting", 0.5f);
+		passes.mComposite = scheduler.AddPass("Composite", 0.3f);
+
+		// graphics command lists #2 and #3 (#1 is the G-buffer and the history copies)
+		scheduler.SetSubmissionStart(passes.mShadows);
+		scheduler.SetSubmissionStart(passes.mLighting);
+
+		scheduler.AddDependency(passes.mLPV, passes.mRSMBuffers);
+		scheduler.AddDependency(passes.mRSM, passes.mGBuffer);
+		scheduler.AddDependency(passes.mRSM, passes.mRSMBuffers, true, 0.15f);
+		scheduler.AddDependency(passes.mVCT, passes.mGBuffer);
+		scheduler.AddDependency(passes.mVCT, passes.mVoxelization, true, 0.3f);
+		scheduler.AddDependency(passes.mLighting, passes.mGBuffer);
+		scheduler.AddDependency(passes.mLighting, passes.mShadows);
+		scheduler.AddDependency(passes.mLighting, passes.mLPV);
+		scheduler.AddDependency(passes.mLighting, passes.mRSM);
+		scheduler.AddDependency(passes.mLighting, passes.mVCT);
+		scheduler.AddDependency(passes.mComposite, passes.mLighting);
+		return passes;
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "AsyncComputeScheduler.h"
+#include "RSMLightTree.h"
+
+// Pass graph of DXRSExampleGIScene::RenderAsync in submission order, built by ScheduleAsyncCompute and by
+// tools/AsyncComputeSchedulerCheck so both schedule the same graph. Costs are rough relative estimates that follow
+// the UI toggles and the quality tier; the compute queue is assumed ~10% slower as it shares the GPU.
+// Only uses the standard library.
+namespace GIPassGraph
+{
+	// The scene settings the costs depend on, defaults as in the scene with RSM, LPV and VCT on
+	struct Settings
+	{
+		bool mUseRSM = true;
+		bool mUseLPV = true;
+		bool mUseVCT = true;
+		bool mRSMComputeVersion = true;
+		bool mRSMUseUpsampleAndBlur = true;
+		bool mRSMUseLightcuts = false;
+		int mRSMLightcutsMaxClusters = RSMLightTree::DEFAULT_MAX_CLUSTERS;
+		bool mRSMUseTileClassification = false;
+		int mRSMInterleaveSize = 1;
+		bool mRSMTemporalAccumulation = false;
+		// of the quality tier, the RSM gather cost is relative to RSM_MAX_SAMPLES_COUNT of the scene
+		int mRSMSamplesCount = 512;
+		int mRSMMaxSamplesCount = 512;
+		int mVCTConesCount = 9;
+	};
+
+	struct Passes
+	{
+		AsyncComputeScheduler::PassId mGBuffer;
+		AsyncComputeScheduler::PassId mShadows;
+		AsyncComputeScheduler::PassId mRSMBuffers;
+		AsyncComputeScheduler::PassId mLPV;
+		AsyncComputeScheduler::PassId mVoxelization;
+		AsyncComputeScheduler::PassId mRSM;
+		AsyncComputeScheduler::PassId mVCT;
+		AsyncComputeScheduler::PassId mLighting;
+		AsyncComputeScheduler::PassId mComposite;
+	};
+
+	// Clears the scheduler and adds the passes and their dependencies, Schedule() is up to the caller
+	Passes Build(AsyncComputeScheduler& scheduler, const Settings& settings);
+}
@@ -0,0 +1,284 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+GpuProfiler::GpuProfiler(uint32_t maxQueriesPerFrame, uint32_t frameSlotCount)
+	: mMaxQueriesPerFrame(std::max(maxQueriesPerFrame, 2u) & ~1u)
+	, mFrameSlotCount(std::max(frameSlotCount, 1u))
+	, mFrames(mFrameSlotCount)
+{
+}
+
+GpuProfiler::QueueId GpuProfiler::AddQueue(const std::string& name, uint64_t frequency)
+{
+	Queue queue;
+	queue.mName = name;
+	queue.mFrequency = std::max<uint64_t>(frequency, 1);
+	mQueues.push_back(queue);
+	mOpenScopes.resize(mQueues.size());
+
+	for (auto& frame : mFrames)
+	{
+		frame.mQueryCounts.resize(mQueues.size(), 0);
+		frame.mResolvedCounts.resize(mQueues.size(), 0);
+	}
+	return static_cast<QueueId>(mQueues.size() - 1);
+}
+
+void GpuProfiler::SetAveragingFrames(uint32_t frames)
+{
+	mAveragingFrames = std::max(frames, 1u);
+	for (auto& history : mHistory)
+	{
+		while (history.size() > mAveragingFrames)
+			history.pop_front();
+	}
+}
+
+void GpuProfiler::BeginFrame(uint32_t frameSlot)
+{
+	mCurrentSlot = frameSlot % mFrameSlotCount;
+
+	Frame& frame = mFrames[mCurrentSlot];
+	frame.mScopes.clear();
+	std::fill(frame.mQueryCounts.begin(), frame.mQueryCounts.end(), 0);
+	std::fill(frame.mResolvedCounts.begin(), frame.mResolvedCounts.end(), 0);
+	frame.mPending = false;
+
+	for (auto& open : mOpenScopes)
+		open.clear();
+}
+
+uint32_t GpuProfiler::FindOrAddPass(QueueId queue, const std::string& path, uint32_t depth)
+{
+	auto key = std::make_pair(queue, path);
+	auto it = mPassIndices.find(key);
+	if (it != mPassIndices.end())
+		return it->second;
+
+	PassStats pass;
+	pass.mName = path;
+	pass.mQueue = queue;
+	pass.mDepth = depth;
+	mPasses.push_back(pass);
+	mHistory.emplace_back();
+
+	uint32_t index = static_cast<uint32_t>(mPasses.size() - 1);
+	mPassIndices[key] = index;
+	return index;
+}
+
+uint32_t GpuProfiler::BeginScope(QueueId queue, const std::string& name)
+{
+	Frame& frame = mFrames[mCurrentSlot];
+	std::vector<uint32_t>& open = mOpenScopes[queue];
+
+	std::string path = open.empty() ? name : mPasses[frame.mScopes[open.back()].mPass].mName + "/" + name;
+
+	Scope scope;
+	scope.mPass = FindOrAddPass(queue, path, static_cast<uint32_t>(open.size()));
+	scope.mQueue = queue;
+
+	// both queries are reserved up front, an out of queries scope still has to pair with its EndScope
+	uint32_t& count = frame.mQueryCounts[queue];
+	if (count + 2 <= mMaxQueriesPerFrame)
+	{
+		scope.mBegin = count;
+		scope.mEnd = count + 1;
+		count += 2;
+	}
+
+	frame.mScopes.push_back(scope);
+	open.push_back(static_cast<uint32_t>(frame.mScopes.size() - 1));
+
+	if (scope.mBegin == INVALID_QUERY)
+		return INVALID_QUERY;
+	return mCurrentSlot * mMaxQueriesPerFrame + scope.mBegin;
+}
+
+uint32_t GpuProfiler::EndScope(QueueId queue)
+{
+	std::vector<uint32_t>& open = mOpenScopes[queue];
+	if (open.empty())
+		return INVALID_QUERY;
+
+	const Scope& scope = mFrames[mCurrentSlot].mScopes[open.back()];
+	open.pop_back();
+
+	if (scope.mEnd == INVALID_QUERY)
+		return INVALID_QUERY;
+	return mCurrentSlot * mMaxQueriesPerFrame + scope.mEnd;
+}
+
+bool GpuProfiler::GetResolveRange(QueueId queue, uint32_t& first, uint32_t& count)
+{
+	Frame& frame = mFrames[mCurrentSlot];
+	first = mCurrentSlot * mMaxQueriesPerFrame;
+	count = frame.mQueryCounts[queue];
+	frame.mResolvedCounts[queue] = count;
+	return count > 0;
+}
+
+void GpuProfiler::EndFrame()
+{
+	mFrames[mCurrentSlot].mPending = true;
+}
+
+void GpuProfiler::ResolveFrame(uint32_t frameSlot, const std::vector<const uint64_t*>& timestamps)
+{
+	Frame& frame = mFrames[frameSlot % mFrameSlotCount];
+	if (!frame.mPending)
+		return;
+	frame.mPending = false;
+	mResolvedFrameCount++;
+
+	// passes can run more than once per frame (e.g. once per command list), one sample is their sum
+	std::map<uint32_t, double> durations;
+	for (auto& scope : frame.mScopes)
+	{
+		if (scope.mEnd == INVALID_QUERY || scope.mEnd >= frame.mResolvedCounts[scope.mQueue])
+			continue;
+		if (scope.mQueue >= timestamps.size() || !timestamps[scope.mQueue])
+			continue;
+
+		uint64_t begin = timestamps[scope.mQueue][scope.mBegin];
+		uint64_t end = timestamps[scope.mQueue][scope.mEnd];
+		double ms = end > begin ? double(end - begin) * 1000.0 / double(mQueues[scope.mQueue].mFrequency) : 0.0;
+		durations[scope.mPass] += ms;
+	}
+
+	for (auto& duration : durations)
+	{
+		PassStats& pass = mPasses[duration.first];
+		std::deque<double>& history = mHistory[duration.first];
+
+		history.push_back(duration.second);
+		if (history.size() > mAveragingFrames)
+			history.pop_front();
+
+		double sum = 0.0;
+		for (double sample : history)
+			sum += sample;
+
+		pass.mLastMs = duration.second;
+		pass.mAverageMs = sum / double(history.size());
+		pass.mMinMs = *std::min_element(history.begin(), history.end());
+		pass.mMaxMs = *std::max_element(history.begin(), history.end());
+		pass.mSampleCount++;
+		pass.mLastFrame = mResolvedFrameCount;
+	}
+}
+
+double GpuProfiler::GetQueueTimeMs(QueueId queue) const
+{
+	double time = 0.0;
+	for (auto& pass : mPasses)
+	{
+		if (pass.mQueue == queue && pass.mDepth == 0 && pass.mLastFrame == mResolvedFrameCount && pass.mSampleCount > 0)
+			time += pass.mAverageMs;
+	}
+	return time;
+}
+
+double GpuProfiler::GetQueueLastTimeMs(QueueId queue) const
+{
+	double time = 0.0;
+	for (auto& pass : mPasses)
+	{
+		if (pass.mQueue == queue && pass.mDepth == 0 && pass.mLastFrame == mResolvedFrameCount && pass.mSampleCount > 0)
+			time += pass.mLastMs;
+	}
+	return time;
+}
+
+void GpuProfiler::ResetStats()
+{
+	for (size_t i = 0; i < mPasses.size(); i++)
+	{
+		PassStats& pass = mPasses[i];
+		pass.mSampleCount = 0;
+		pass.mLastMs = pass.mAverageMs = pass.mMinMs = pass.mMaxMs = 0.0;
+		mHistory[i].clear();
+	}
+}
+
+std::string GpuProfiler::ExportCSV() const
+{
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(6);
+	stream << "pass,queue,depth,samples,avg_ms,min_ms,max_ms,last_ms\n";
+	for (auto& pass : mPasses)
+	{
+		if (pass.mSampleCount == 0)
+			continue;
+
+		// pass names come from PIX event names and may contain commas
+		std::string name = pass.mName;
+		if (name.find_first_of(",\"") != std::string::npos)
+		{
+			std::string quoted = "\"";
+			for (char c : name)
+				quoted += (c == '"') ? std::string("\"\"") : std::string(1, c);
+			name = quoted + "\"";
+		}
+
+		stream << name << "," << mQueues[pass.mQueue].mName << "," << pass.mDepth << "," << pass.mSampleCount << ","
+			<< pass.mAverageMs << "," << pass.mMinMs << "," << pass.mMaxMs << "," << pass.mLastMs << "\n";
+	}
+	return stream.str();
+}
+
+std::string GpuProfiler::ExportJSON() const
+{
+	auto escape = [](const std::string& text) {
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += c;
+		}
+		return escaped;
+	};
+
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(6);
+	stream << "{\n  \"frames\": " << mResolvedFrameCount << ",\n  \"averagingFrames\": " << mAveragingFrames << ",\n  \"passes\": [";
+
+	bool first = true;
+	for (auto& pass : mPasses)
+	{
+		if (pass.mSampleCount == 0)
+			continue;
+
+		stream << (first ? "\n" : ",\n");
+		stream << "    { \"name\": \"" << escape(pass.mName) << "\", \"queue\": \"" << escape(mQueues[pass.mQueue].mName)
+			<< "\", \"depth\": " << pass.mDepth << ", \"samples\": " << pass.mSampleCount
+			<< ", \"avgMs\": " << pass.mAverageMs << ", \"minMs\": " << pass.mMinMs << ", \"maxMs\": " << pass.mMaxMs
+			<< ", \"lastMs\": " << pass.mLastMs << " }";
+		first = false;
+	}
+	stream << "\n  ]\n}\n";
+	return stream.str();
+}
+
+bool GpuProfiler::WriteCSV(const std::filesystem::path& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	file << ExportCSV();
+	return bool(file);
+}
+
+bool GpuProfiler::WriteJSON(const std::filesystem::path& path) const
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	file << ExportJSON();
+	return bool(file);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Per-pass GPU timings from timestamp queries.
+// Every queue has its own range of queries per frame slot; BeginScope hands out the pair of query indices a
+// scope writes its timestamps to, scopes nest per queue and are named by their path ("Parent/Child").
+// After the last command list of a frame on a queue, GetResolveRange returns the queries to resolve into the
+// readback buffer. Once the frame has completed on the GPU, ResolveFrame turns the read back timestamps into
+// durations; a pass that runs several times in a frame is summed. Statistics cover the last N frames.
+// Only uses the standard library; the caller issues the queries, so synthetic timestamps work just as well.
+class GpuProfiler
+{
+public:
+    typedef uint32_t QueueId;
+
+    static constexpr uint32_t INVALID_QUERY = UINT32_MAX;
+    static constexpr uint32_t DEFAULT_AVERAGING_FRAMES = 60;
+
+    struct PassStats
+    {
+        std::string mName;          // path of the scope
+        QueueId mQueue = 0;
+        uint32_t mDepth = 0;
+        uint64_t mSampleCount = 0;  // frames the pass was resolved in, since the last ResetStats
+        uint64_t mLastFrame = 0;    // resolved frame count when the pass last ran
+        double mLastMs = 0.0;
+        double mAverageMs = 0.0;    // over the last averaging frames the pass ran in
+        double mMinMs = 0.0;
+        double mMaxMs = 0.0;
+    };
+
+    // Queries per queue per frame slot, two per scope
+    GpuProfiler(uint32_t maxQueriesPerFrame = 256, uint32_t frameSlotCount = 4);
+
+    // frequency is in ticks per second
+    QueueId AddQueue(const std::string& name, uint64_t frequency);
+    void SetFrequency(QueueId queue, uint64_t frequency) { mQueues[queue].mFrequency = frequency; }
+    const std::string& GetQueueName(QueueId queue) const { return mQueues[queue].mName; }
+    uint32_t GetQueueCount() const { return static_cast<uint32_t>(mQueues.size()); }
+    void SetAveragingFrames(uint32_t frames);
+
+    // Queries a queue needs in total, the size of its query heap and readback buffer
+    uint32_t GetQueryCount() const { return mMaxQueriesPerFrame * mFrameSlotCount; }
+    uint32_t GetMaxQueriesPerFrame() const { return mMaxQueriesPerFrame; }
+
+    // Forgets the queries of the frame that used the slot before, it has to be resolved (or dropped) by now
+    void BeginFrame(uint32_t frameSlot);
+    // Index of the query for the begin timestamp, INVALID_QUERY if the frame ran out of queries
+    uint32_t BeginScope(QueueId queue, const std::string& name);
+    // Index of the query for the end timestamp of the innermost open scope of the queue
+    uint32_t EndScope(QueueId queue);
+    // First query and count to resolve for the queue; false if the queue has no queries this frame.
+    // Scopes that end after this call are not timed.
+    bool GetResolveRange(QueueId queue, uint32_t& first, uint32_t& count);
+    void EndFrame();
+
+    // timestamps[queue] points at the resolved values of the queue's range of the slot (the first query
+    // GetResolveRange returned), nullptr skips the queue
+    void ResolveFrame(uint32_t frameSlot, const std::vector<const uint64_t*>& timestamps);
+
+    // In the order the passes were first seen
+    const std::vector<PassStats>& GetPasses() const { return mPasses; }
+    uint64_t GetResolvedFrameCount() const { return mResolvedFrameCount; }
+    // Sum of the top level pass averages of the queue that ran in the last resolved frame
+    double GetQueueTimeMs(QueueId queue) const;
+    // Sum of the top level passes of the queue in the last resolved frame alone
+    double GetQueueLastTimeMs(QueueId queue) const;
+    void ResetStats();
+
+    // pass,queue,depth,samples,avg_ms,min_ms,max_ms,last_ms
+    std::string ExportCSV() const;
+    std::string ExportJSON() const;
+    bool WriteCSV(const std::filesystem::path& path) const;
+    bool WriteJSON(const std::filesystem::path& path) const;
+
+private:
+    struct Queue
+    {
+        std::string mName;
+        uint64_t mFrequency = 1;
+    };
+
+    struct Scope
+    {
+        uint32_t mPass = 0;
+        QueueId mQueue = 0;
+        uint32_t mBegin = INVALID_QUERY;    // relative to the queue's range of the slot
+        uint32_t mEnd = INVALID_QUERY;
+    };
+
+    struct Frame
+    {
+        std::vector<Scope> mScopes;
+        std::vector<uint32_t> mQueryCounts;     // per queue
+        std::vector<uint32_t> mResolvedCounts;  // per queue, queries covered by the resolve
+        bool mPending = false;
+    };
+
+    uint32_t FindOrAddPass(QueueId queue, const std::string& path, uint32_t depth);
+
+    uint32_t mMaxQueriesPerFrame;
+    uint32_t mFrameSlotCount;
+    uint32_t mAveragingFrames = DEFAULT_AVERAGING_FRAMES;
+    std::vector<Queue> mQueues;
+
+    std::vector<Frame> mFrames;
+    uint32_t mCurrentSlot = 0;
+    std::vector<std::vector<uint32_t>> mOpenScopes;  // per queue, indices into the current frame's scopes
+
+    std::vector<PassStats> mPasses;
+    std::vector<std::deque<double>> mHistory;       // per pass, the last averaging frames
+    std::map<std::pair<QueueId, std::string>, uint32_t> mPassIndices;
+    uint64_t mResolvedFrameCount = 0;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Small portable hashing helpers (64-bit FNV-1a) used to key pipeline states, root signatures and
+// cached shader bytecode. Hashed descriptions must be zero-initialized so struct padding is deterministic
+// and must have their pointer members cleared (pointed-to data is hashed separately). Structs copied in
+// from callers carry the callers' padding and are hashed field by field instead.
+namespace Utility
+{
+    static const uint64_t HashSeed = 14695981039346656037ULL;
+
+    inline uint64_t HashRange(const void* Data, size_t Size, uint64_t Hash = HashSeed)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(Data);
+        for (size_t i = 0; i < Size; ++i)
+        {
+            Hash ^= bytes[i];
+            Hash *= 1099511628211ULL;
+        }
+        return Hash;
+    }
+
+    template <typename T>
+    inline uint64_t HashState(const T* StateDesc, size_t Count = 1, uint64_t Hash = HashSeed)
+    {
+        return HashRange(StateDesc, sizeof(T) * Count, Hash);
+    }
+
+    inline uint64_t HashString(const char* Str, uint64_t Hash = HashSeed)
+    {
+        return Str ? HashRange(Str, strlen(Str) + 1, Hash) : HashRange("", 1, Hash);
+    }
+}
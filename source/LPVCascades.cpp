@@ -0,0 +1,135 @@
+#include "LPVCascades.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+LPVCascades::LPVCascades(uint32_t cascadeCount, uint32_t dim, float finestCellSize, float ratio)
+{
+	cascadeCount = std::min(std::max(cascadeCount, 1u), MAX_CASCADES);
+	float cellSize = finestCellSize;
+	for (uint32_t i = 0; i < cascadeCount; i++)
+	{
+		Cascade cascade = {};
+		cascade.mCellSize = cellSize;
+		cascade.mDim = std::max(dim, 1u);
+		mCascades.push_back(cascade);
+		cellSize *= ratio;
+	}
+
+	const float origin[3] = { 0.0f, 0.0f, 0.0f };
+	Update(origin);
+	for (Cascade& cascade : mCascades)
+		cascade.mMoved = true;
+}
+
+void LPVCascades::Update(const float center[3])
+{
+	for (Cascade& cascade : mCascades)
+	{
+		bool moved = false;
+		for (int i = 0; i < 3; i++)
+		{
+			float origin = (std::floor(center[i] / cascade.mCellSize) - float(cascade.mDim / 2)) * cascade.mCellSize;
+			moved |= origin != cascade.mOrigin[i];
+			cascade.mOrigin[i] = origin;
+		}
+		cascade.mMoved = moved;
+	}
+}
+
+void LPVCascades::GetCellTransform(uint32_t cascade, float& scale, float offset[3]) const
+{
+	const Cascade& data = mCascades[cascade];
+	scale = 1.0f / data.mCellSize;
+	for (int i = 0; i < 3; i++)
+		offset[i] = -data.mOrigin[i] * scale;
+}
+
+void LPVCascades::GetCellPosition(uint32_t cascade, const float position[3], float cell[3]) const
+{
+	float scale, offset[3];
+	GetCellTransform(cascade, scale, offset);
+	for (int i = 0; i < 3; i++)
+		cell[i] = position[i] * scale + offset[i];
+}
+
+void LPVCascades::Configure(uint32_t cascade, LPVEngine& engine) const
+{
+	assert(engine.GetDim() == mCascades[cascade].mDim);
+
+	float scale, offset[3];
+	GetCellTransform(cascade, scale, offset);
+	engine.SetCellTransform(scale, offset);
+}
+
+float LPVCascades::GetBorderDistance(uint32_t cascade, const float position[3]) const
+{
+	float cell[3];
+	GetCellPosition(cascade, position, cell);
+
+	float dim = float(mCascades[cascade].mDim);
+	float distance = dim;
+	for (int i = 0; i < 3; i++)
+		distance = std::min(distance, std::min(cell[i], dim - cell[i]));
+	return distance;
+}
+
+uint32_t LPVCascades::Route(const float position[3]) const
+{
+	uint32_t last = GetCascadeCount() - 1;
+	uint32_t target = last;
+	for (uint32_t i = 0; i < last; i++)
+	{
+		if (GetBorderDistance(i, position) >= mMargin)
+		{
+			target = i;
+			break;
+		}
+	}
+
+	uint32_t mask = 1u << target;
+	if (mInjectCoarser)
+	{
+		for (uint32_t i = target + 1; i <= last; i++)
+		{
+			if (GetBorderDistance(i, position) >= 0.0f)
+				mask |= 1u << i;
+		}
+	}
+	return mask;
+}
+
+void LPVCascades::Route(const std::vector<LPVEngine::VPL>& vpls, std::vector<std::vector<LPVEngine::VPL>>& cascadeVPLs) const
+{
+	cascadeVPLs.assign(GetCascadeCount(), std::vector<LPVEngine::VPL>());
+	for (const LPVEngine::VPL& vpl : vpls)
+	{
+		uint32_t mask = Route(vpl.mPosition);
+		for (uint32_t i = 0; i < GetCascadeCount(); i++)
+		{
+			if (mask & (1u << i))
+				cascadeVPLs[i].push_back(vpl);
+		}
+	}
+}
+
+void LPVCascades::GetBlendWeights(const float position[3], float weights[MAX_CASCADES]) const
+{
+	std::fill(weights, weights + MAX_CASCADES, 0.0f);
+
+	uint32_t last = GetCascadeCount() - 1;
+	float remaining = 1.0f;
+	for (uint32_t i = 0; i <= last && remaining > 0.0f; i++)
+	{
+		float distance = GetBorderDistance(i, position);
+		float weight;
+		if (i == last)
+			weight = distance >= 0.0f ? 1.0f : 0.0f;
+		else
+			weight = std::min(std::max((distance - mMargin) / std::max(mBlend, 1e-6f), 0.0f), 1.0f);
+
+		weights[i] = remaining * weight;
+		remaining -= weights[i];
+	}
+}
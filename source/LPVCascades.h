@@ -0,0 +1,67 @@
+#pragma once
+
+#include "LPVEngine.h"
+
+#include <cstdint>
+#include <vector>
+
+// Placement of nested light propagation volumes, each cascade the same number of cells as the previous one but
+// with cells ratio times larger. The cascades are centered on the camera (or on a fixed point) and their origins
+// snap to whole cells of their own size, so a moving camera never shifts the light inside a cascade by part of a
+// cell; coarser cells are multiples of finer ones, so the snapped cascades also stay aligned to each other.
+// VPLs go to the finest cascade that holds them at least margin cells inside its border, the coarsest one
+// otherwise, and with inject coarser set to every coarser cascade holding them too, so light near the camera
+// still reaches the far field. Lookups weight the finest cascade fully inside its blend band and fade to the
+// next coarser one over blend cells towards its border; the coarsest cascade stops at its border.
+// A world position maps to cascade cells as position * scale + offset (GetCellTransform), what the injection and
+// lighting shaders get through the LPV constant buffer.
+// Only uses the standard library.
+class LPVCascades
+{
+public:
+    static constexpr uint32_t MAX_CASCADES = 4;
+
+    struct Cascade
+    {
+        float mOrigin[3];       // world position of the corner of cell (0, 0, 0)
+        float mCellSize;
+        uint32_t mDim;
+        bool mMoved;            // origin changed in the last Update, its light has to be injected again
+    };
+
+    LPVCascades(uint32_t cascadeCount, uint32_t dim, float finestCellSize, float ratio = 2.0f);
+
+    void SetMargin(float cells) { mMargin = cells; }
+    void SetBlend(float cells) { mBlend = cells; }
+    void SetInjectCoarser(bool injectCoarser) { mInjectCoarser = injectCoarser; }
+    float GetMargin() const { return mMargin; }
+    float GetBlend() const { return mBlend; }
+
+    // Centers every cascade on the position, snapped to its cells
+    void Update(const float center[3]);
+
+    uint32_t GetCascadeCount() const { return static_cast<uint32_t>(mCascades.size()); }
+    const Cascade& GetCascade(uint32_t cascade) const { return mCascades[cascade]; }
+    void GetCellTransform(uint32_t cascade, float& scale, float offset[3]) const;
+    // Cell coordinates of a world position, [0, dim) inside the cascade
+    void GetCellPosition(uint32_t cascade, const float position[3], float cell[3]) const;
+    // Sets the cell transform of an engine of the cascade's size
+    void Configure(uint32_t cascade, LPVEngine& engine) const;
+
+    // Bit i set when the VPL goes to cascade i. The finest cascade it goes to is always set, injection drops the VPL
+    // when its cell (offset along the normal) is outside, like for a single volume.
+    uint32_t Route(const float position[3]) const;
+    void Route(const std::vector<LPVEngine::VPL>& vpls, std::vector<std::vector<LPVEngine::VPL>>& cascadeVPLs) const;
+
+    // Weight of every cascade for a lookup at the position, the weights add up to 1 inside the coarsest cascade
+    void GetBlendWeights(const float position[3], float weights[MAX_CASCADES]) const;
+
+private:
+    // Distance in cells from the position to the nearest face of the cascade, negative outside
+    float GetBorderDistance(uint32_t cascade, const float position[3]) const;
+
+    std::vector<Cascade> mCascades;
+    float mMargin = 1.0f;
+    float mBlend = 2.0f;
+    bool mInjectCoarser = true;
+};
@@ -0,0 +1,201 @@
+#include "LPVClustering.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const uint32_t OUTSIDE = ~0u;
+
+	// weight, position, normal and flux of a cluster
+	enum Sum
+	{
+		SUM_WEIGHT = 0,
+		SUM_POSITION = 1,
+		SUM_NORMAL = 4,
+		SUM_FLUX = 7,
+
+		SUM_COUNT = 10
+	};
+
+	float Weight(const LPVEngine::VPL& vpl)
+	{
+		return vpl.mFlux[0] + vpl.mFlux[1] + vpl.mFlux[2];
+	}
+
+	void Normalized(const float normal[3], float result[3])
+	{
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		for (int i = 0; i < 3; i++)
+			result[i] = normal[i] * scale;
+	}
+}
+
+LPVClustering::LPVClustering(uint32_t maxPerCell)
+{
+	SetMaxPerCell(maxPerCell);
+}
+
+void LPVClustering::SetMaxPerCell(uint32_t maxPerCell)
+{
+	mMaxPerCell = std::max(maxPerCell, 1u);
+}
+
+void LPVClustering::Cluster(const LPVEngine& engine, const std::vector<LPVEngine::VPL>& vpls, std::vector<LPVEngine::VPL>& clustered)
+{
+	CPU_PROFILE_SCOPE("LPV VPL clustering");
+
+	clustered.clear();
+	mStats = Stats();
+	mStats.mInputCount = vpls.size();
+
+	uint32_t dim = engine.GetDim();
+	mCellOfVPL.resize(vpls.size());
+	mCellStart.assign(size_t(engine.GetCellCount()) + 1, 0);
+	for (size_t i = 0; i < vpls.size(); i++)
+	{
+		uint32_t x, y, z;
+		if (engine.GetInjectionCell(vpls[i], x, y, z))
+		{
+			mCellOfVPL[i] = (z * dim + y) * dim + x;
+			mCellStart[mCellOfVPL[i] + 1]++;
+			mStats.mInjectedCount++;
+		}
+		else
+			mCellOfVPL[i] = OUTSIDE;
+	}
+	for (size_t cell = 1; cell < mCellStart.size(); cell++)
+		mCellStart[cell] += mCellStart[cell - 1];
+
+	// stable, so a cell keeps the order of its VPLs
+	mOrder.resize(mStats.mInjectedCount);
+	std::vector<uint32_t> cursor(mCellStart.begin(), mCellStart.end() - 1);
+	for (size_t i = 0; i < vpls.size(); i++)
+	{
+		if (mCellOfVPL[i] != OUTSIDE)
+			mOrder[cursor[mCellOfVPL[i]]++] = uint32_t(i);
+	}
+
+	for (uint32_t cell = 0; cell < engine.GetCellCount(); cell++)
+	{
+		size_t count = mCellStart[cell + 1] - mCellStart[cell];
+		if (count == 0)
+			continue;
+		mStats.mOccupiedCells++;
+		ClusterCell(engine, cell, &mOrder[mCellStart[cell]], count, vpls, clustered);
+	}
+	mStats.mOutputCount = clustered.size();
+}
+
+void LPVClustering::ClusterCell(const LPVEngine& engine, uint32_t cell, const uint32_t* indices, size_t count,
+	const std::vector<LPVEngine::VPL>& vpls, std::vector<LPVEngine::VPL>& clustered)
+{
+	if (count <= mMaxPerCell)
+	{
+		for (size_t i = 0; i < count; i++)
+			clustered.push_back(vpls[indices[i]]);
+		return;
+	}
+
+	// the brightest VPL, then the one facing furthest away from every seed so far
+	mSeeds.clear();
+	mSeedNormals.clear();
+	size_t brightest = 0;
+	for (size_t i = 1; i < count; i++)
+	{
+		if (Weight(vpls[indices[i]]) > Weight(vpls[indices[brightest]]))
+			brightest = i;
+	}
+	auto addSeed = [&](size_t i)
+	{
+		float seedNormal[3];
+		Normalized(vpls[indices[i]].mNormal, seedNormal);
+		mSeeds.push_back(uint32_t(i));
+		mSeedNormals.insert(mSeedNormals.end(), seedNormal, seedNormal + 3);
+	};
+	addSeed(brightest);
+	while (mSeeds.size() < mMaxPerCell)
+	{
+		size_t furthest = 0;
+		float furthestFacing = 2.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			float normal[3];
+			Normalized(vpls[indices[i]].mNormal, normal);
+			float facing = -1.0f;
+			for (size_t seed = 0; seed < mSeeds.size(); seed++)
+			{
+				const float* other = &mSeedNormals[seed * 3];
+				facing = std::max(facing, normal[0] * other[0] + normal[1] * other[1] + normal[2] * other[2]);
+			}
+			if (facing < furthestFacing)
+			{
+				furthest = i;
+				furthestFacing = facing;
+			}
+		}
+		// the rest faces the same way as a seed
+		if (furthestFacing > 0.999f)
+			break;
+		addSeed(furthest);
+	}
+
+	mSums.assign(mSeeds.size() * SUM_COUNT, 0.0f);
+	for (size_t i = 0; i < count; i++)
+	{
+		const LPVEngine::VPL& vpl = vpls[indices[i]];
+		float normal[3];
+		Normalized(vpl.mNormal, normal);
+		size_t best = 0;
+		float bestFacing = -2.0f;
+		for (size_t seed = 0; seed < mSeeds.size(); seed++)
+		{
+			const float* other = &mSeedNormals[seed * 3];
+			float facing = normal[0] * other[0] + normal[1] * other[1] + normal[2] * other[2];
+			if (facing > bestFacing)
+			{
+				best = seed;
+				bestFacing = facing;
+			}
+		}
+
+		float weight = Weight(vpl);
+		float* sums = &mSums[best * SUM_COUNT];
+		sums[SUM_WEIGHT] += weight;
+		for (int j = 0; j < 3; j++)
+		{
+			sums[SUM_POSITION + j] += weight * vpl.mPosition[j];
+			sums[SUM_NORMAL + j] += weight * vpl.mNormal[j];
+			sums[SUM_FLUX + j] += vpl.mFlux[j];
+		}
+	}
+
+	uint32_t dim = engine.GetDim();
+	uint32_t cellCoordinates[3] = { cell % dim, (cell / dim) % dim, cell / (dim * dim) };
+	for (size_t cluster = 0; cluster < mSeeds.size(); cluster++)
+	{
+		const float* sums = &mSums[cluster * SUM_COUNT];
+		// black VPLs inject nothing when summed
+		if (!(sums[SUM_WEIGHT] > 0.0f))
+			continue;
+
+		LPVEngine::VPL vpl;
+		for (int j = 0; j < 3; j++)
+		{
+			vpl.mPosition[j] = sums[SUM_POSITION + j] / sums[SUM_WEIGHT];
+			vpl.mNormal[j] = sums[SUM_NORMAL + j] / sums[SUM_WEIGHT];
+			vpl.mFlux[j] = sums[SUM_FLUX + j];
+		}
+
+		uint32_t x, y, z;
+		if (!engine.GetInjectionCell(vpl, x, y, z) || x != cellCoordinates[0] || y != cellCoordinates[1] || z != cellCoordinates[2])
+		{
+			// position * scale + offset + 0.5 * normal at the center of the cell
+			for (int j = 0; j < 3; j++)
+				vpl.mPosition[j] = (float(cellCoordinates[j]) + 0.5f - engine.GetCellOffset()[j] - 0.5f * vpl.mNormal[j]) / engine.GetCellScale();
+		}
+		clustered.push_back(vpl);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "LPVEngine.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Reduces the VPLs of an RSM to at most K per cell of a light propagation volume before injection.
+// The VPLs of a cell are split by normal: the brightest one seeds the first cluster, the one facing furthest away
+// from all seeds the next, and every VPL joins the seed it faces most. A cluster becomes one VPL with the summed
+// flux and the flux weighted (luminance) average position and normal. The cosine lobe is linear in the normal and
+// the shader does not renormalize it, so a cluster injects exactly the SH of its VPLs summed (LPVEngine::Inject with
+// accumulate) unless their colour varies with their normal. A representative whose average position and normal
+// fall into a neighbouring cell is moved back to the center of its own.
+// Reference only: the scene injects every (downsampled) RSM texel and has no GPU binning pass that would feed this,
+// tools/LPVClusterBench measures the reduction and its error on the sample scene RSM.
+// Only uses the standard library.
+class LPVClustering
+{
+public:
+    struct Stats
+    {
+        size_t mInputCount = 0;
+        size_t mInjectedCount = 0;     // inside the volume
+        size_t mOccupiedCells = 0;
+        size_t mOutputCount = 0;
+    };
+
+    explicit LPVClustering(uint32_t maxPerCell);
+
+    void SetMaxPerCell(uint32_t maxPerCell);
+    uint32_t GetMaxPerCell() const { return mMaxPerCell; }
+
+    // Clusters the VPLs by their injection cell in the engine, VPLs outside the volume are dropped
+    void Cluster(const LPVEngine& engine, const std::vector<LPVEngine::VPL>& vpls, std::vector<LPVEngine::VPL>& clustered);
+    const Stats& GetStats() const { return mStats; }
+
+private:
+    void ClusterCell(const LPVEngine& engine, uint32_t cell, const uint32_t* indices, size_t count,
+        const std::vector<LPVEngine::VPL>& vpls, std::vector<LPVEngine::VPL>& clustered);
+
+    uint32_t mMaxPerCell;
+    Stats mStats;
+    // counting sort of the VPLs by cell, kept between calls
+    std::vector<uint32_t> mCellOfVPL;
+    std::vector<uint32_t> mCellStart;
+    std::vector<uint32_t> mOrder;
+    // per cluster of the cell being clustered
+    std::vector<uint32_t> mSeeds;
+    std::vector<float> mSeedNormals;
+    std::vector<float> mSums;
+};
@@ -0,0 +1,476 @@
+#include "LPVEngine.h"
+#include "LPVGeometryVolume.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define LPV_ENGINE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+	// cellDirections of LPVPropagation.hlsl, the neighbour gathered through direction n is cell - CELL_DIRECTIONS[n]
+	const int CELL_DIRECTIONS[6][3] =
+	{
+		{ 0, 0, 1 },
+		{ 1, 0, 0 },
+		{ 0, 0,-1 },
+		{-1, 0, 0 },
+		{ 0, 1, 0 },
+		{ 0,-1, 0 }
+	};
+	const int CELL_SIDES[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+	const float NO_OCCLUSION[6] = { 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+
+	void GetEvalSideDirection(int index, const int orientation[3], float direction[3])
+	{
+		const float smallComponent = 0.4472135f; // 1 / sqrt(5)
+		const float bigComponent = 0.894427f; // 2 / sqrt(5)
+
+		direction[0] = orientation[0] * CELL_SIDES[index][0] * smallComponent;
+		direction[1] = orientation[1] * CELL_SIDES[index][1] * smallComponent;
+		direction[2] = orientation[2] * bigComponent;
+	}
+
+	void GetReprojSideDirection(int index, const int orientation[3], float direction[3])
+	{
+		direction[0] = float(orientation[0] * CELL_SIDES[index][0]);
+		direction[1] = float(orientation[1] * CELL_SIDES[index][1]);
+		direction[2] = 0.0f;
+	}
+
+	float Dot4(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+	}
+
+	// Reusable barrier for the propagation threads, one wait per step
+	class StepBarrier
+	{
+	public:
+		explicit StepBarrier(uint32_t count) : mCount(count) {}
+
+		void Wait()
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			uint64_t generation = mGeneration;
+			if (++mArrived == mCount)
+			{
+				mArrived = 0;
+				mGeneration++;
+				mWake.notify_all();
+				return;
+			}
+			mWake.wait(lock, [&] { return mGeneration != generation; });
+		}
+
+	private:
+		std::mutex mMutex;
+		std::condition_variable mWake;
+		uint32_t mCount;
+		uint32_t mArrived = 0;
+		uint64_t mGeneration = 0;
+	};
+}
+
+LPVEngine::LPVEngine(uint32_t dim)
+	: mDim(std::max(dim, 1u))
+{
+	std::fill(std::begin(mCellOffset), std::end(mCellOffset), float(mDim / 2));
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+	{
+		mGrid[channel].assign(size_t(GetCellCount()) * 4, 0.0f);
+		mAccumulation[channel].assign(size_t(GetCellCount()) * 4, 0.0f);
+	}
+	BuildGatherMatrices();
+}
+
+void LPVEngine::Clear()
+{
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+	{
+		std::fill(mGrid[channel].begin(), mGrid[channel].end(), 0.0f);
+		std::fill(mAccumulation[channel].begin(), mAccumulation[channel].end(), 0.0f);
+	}
+}
+
+void LPVEngine::SetCellTransform(float scale, const float offset[3])
+{
+	mCellScale = scale;
+	std::copy(offset, offset + 3, mCellOffset);
+}
+
+void LPVEngine::SetGeometryVolume(const LPVGeometryVolume* volume)
+{
+	mTransmittance.clear();
+	if (!volume || volume->GetDim() != mDim)
+		return;
+
+	const int dim = int(mDim);
+	mTransmittance.resize(size_t(GetCellCount()) * 6);
+	for (int z = 0; z < dim; z++)
+	for (int y = 0; y < dim; y++)
+	for (int x = 0; x < dim; x++)
+	{
+		float* transmittance = &mTransmittance[((size_t(z) * dim + y) * dim + x) * 6];
+		for (int neighbour = 0; neighbour < 6; neighbour++)
+		{
+			const int* direction = CELL_DIRECTIONS[neighbour];
+			transmittance[neighbour] = volume->GetTransmittance(x - direction[0], y - direction[1], z - direction[2], direction);
+		}
+	}
+}
+
+void LPVEngine::DirToSH(const float direction[3], float sh[4])
+{
+	sh[0] = SH_C0;
+	sh[1] = -SH_C1 * direction[1];
+	sh[2] = SH_C1 * direction[2];
+	sh[3] = -SH_C1 * direction[0];
+}
+
+void LPVEngine::DirCosLobeToSH(const float direction[3], float sh[4])
+{
+	sh[0] = SH_COSINE_LOBE_C0;
+	sh[1] = -SH_COSINE_LOBE_C1 * direction[1];
+	sh[2] = SH_COSINE_LOBE_C1 * direction[2];
+	sh[3] = -SH_COSINE_LOBE_C1 * direction[0];
+}
+
+bool LPVEngine::GetInjectionCell(const VPL& vpl, uint32_t& x, uint32_t& y, uint32_t& z) const
+{
+	// int3(pos * scale + offset + 0.5f * normal) truncates towards zero, so (-1, 0) still lands in cell 0
+	float cell[3];
+	for (int i = 0; i < 3; i++)
+		cell[i] = vpl.mPosition[i] * mCellScale + mCellOffset[i] + 0.5f * vpl.mNormal[i];
+
+	float limit = float(mDim);
+	for (int i = 0; i < 3; i++)
+	{
+		if (!(cell[i] > -1.0f && cell[i] < limit))
+			return false;
+	}
+
+	x = uint32_t(int(cell[0]));
+	y = uint32_t(int(cell[1]));
+	z = uint32_t(int(cell[2]));
+	return true;
+}
+
+void LPVEngine::Inject(const std::vector<VPL>& vpls, bool accumulate)
+{
+	CPU_PROFILE_SCOPE("LPV injection");
+
+	for (const VPL& vpl : vpls)
+	{
+		uint32_t x, y, z;
+		if (!GetInjectionCell(vpl, x, y, z))
+			continue;
+
+		float lobe[4];
+		DirCosLobeToSH(vpl.mNormal, lobe);
+		size_t offset = ((size_t(z) * mDim + y) * mDim + x) * 4;
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+		{
+			float* cell = &mGrid[channel][offset];
+			for (int i = 0; i < 4; i++)
+			{
+				float value = lobe[i] / PI * vpl.mFlux[channel];
+				cell[i] = accumulate ? cell[i] + value : value;
+			}
+		}
+	}
+}
+
+void LPVEngine::BuildGatherMatrices()
+{
+	// the side faces are taken from cellDirections[face] for every neighbour, as the shader does
+	float side[16] = {};
+	for (int face = 0; face < 4; face++)
+	{
+		float evaluatedSideDirection[3], reprojectedSideDirection[3];
+		GetEvalSideDirection(face, CELL_DIRECTIONS[face], evaluatedSideDirection);
+		GetReprojSideDirection(face, CELL_DIRECTIONS[face], reprojectedSideDirection);
+
+		float evaluatedSideSH[4], reprojectedSideCosLobeSH[4];
+		DirToSH(evaluatedSideDirection, evaluatedSideSH);
+		DirCosLobeToSH(reprojectedSideDirection, reprojectedSideCosLobeSH);
+		for (int column = 0; column < 4; column++)
+			for (int row = 0; row < 4; row++)
+				side[column * 4 + row] += SIDE_FACE_SUBTENDED_SOLID_ANGLE * reprojectedSideCosLobeSH[row] * evaluatedSideSH[column];
+	}
+
+	for (int neighbour = 0; neighbour < 6; neighbour++)
+	{
+		float direction[3] = { float(CELL_DIRECTIONS[neighbour][0]), float(CELL_DIRECTIONS[neighbour][1]), float(CELL_DIRECTIONS[neighbour][2]) };
+		float directionCosLobeSH[4], directionSH[4];
+		DirCosLobeToSH(direction, directionCosLobeSH);
+		DirToSH(direction, directionSH);
+		for (int column = 0; column < 4; column++)
+			for (int row = 0; row < 4; row++)
+				mGather[neighbour][column * 4 + row] = DIRECT_FACE_SUBTENDED_SOLID_ANGLE * directionCosLobeSH[row] * directionSH[column] + side[column * 4 + row];
+	}
+}
+
+template <bool OCCLUDED>
+void LPVEngine::PropagateSlices(const float* const source[CHANNEL_COUNT], float* const destination[CHANNEL_COUNT], uint32_t zBegin, uint32_t zEnd)
+{
+	const size_t dim = mDim;
+	const size_t rowFloats = dim * 4;
+	const size_t sliceFloats = dim * rowFloats;
+
+#ifdef LPV_ENGINE_SSE
+	__m128 gather[6][4];
+	for (int neighbour = 0; neighbour < 6; neighbour++)
+		for (int column = 0; column < 4; column++)
+			gather[neighbour][column] = _mm_loadu_ps(&mGather[neighbour][column * 4]);
+
+	auto add = [](__m128 sum, const __m128 (&matrix)[4], const float* cell, float transmittance) {
+		__m128 value = _mm_loadu_ps(cell);
+		if (OCCLUDED)
+			value = _mm_mul_ps(value, _mm_set1_ps(transmittance));
+		sum = _mm_add_ps(sum, _mm_mul_ps(matrix[0], _mm_shuffle_ps(value, value, _MM_SHUFFLE(0, 0, 0, 0))));
+		sum = _mm_add_ps(sum, _mm_mul_ps(matrix[1], _mm_shuffle_ps(value, value, _MM_SHUFFLE(1, 1, 1, 1))));
+		sum = _mm_add_ps(sum, _mm_mul_ps(matrix[2], _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 2, 2, 2))));
+		return _mm_add_ps(sum, _mm_mul_ps(matrix[3], _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 3, 3, 3))));
+	};
+#endif
+
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+	{
+		const float* grid = source[channel];
+		float* result = destination[channel];
+		float* accumulation = mAccumulation[channel].data();
+
+		for (size_t z = zBegin; z < zEnd; z++)
+		{
+			for (size_t y = 0; y < dim; y++)
+			{
+				// neighbour rows in the order of CELL_DIRECTIONS, null outside the volume
+				const float* row = grid + z * sliceFloats + y * rowFloats;
+				const float* rowZMinus = z > 0 ? row - sliceFloats : nullptr;
+				const float* rowZPlus = z + 1 < dim ? row + sliceFloats : nullptr;
+				const float* rowYMinus = y > 0 ? row - rowFloats : nullptr;
+				const float* rowYPlus = y + 1 < dim ? row + rowFloats : nullptr;
+				size_t rowOffset = z * sliceFloats + y * rowFloats;
+
+				for (size_t x = 0; x < dim; x++)
+				{
+					size_t cell = x * 4;
+					const float* transmittance = OCCLUDED ? &mTransmittance[(rowOffset + cell) / 4 * 6] : NO_OCCLUSION;
+#ifdef LPV_ENGINE_SSE
+					__m128 sum = _mm_setzero_ps();
+					if (rowZMinus)
+						sum = add(sum, gather[0], rowZMinus + cell, transmittance[0]);
+					if (x > 0)
+						sum = add(sum, gather[1], row + cell - 4, transmittance[1]);
+					if (rowZPlus)
+						sum = add(sum, gather[2], rowZPlus + cell, transmittance[2]);
+					if (x + 1 < dim)
+						sum = add(sum, gather[3], row + cell + 4, transmittance[3]);
+					if (rowYMinus)
+						sum = add(sum, gather[4], rowYMinus + cell, transmittance[4]);
+					if (rowYPlus)
+						sum = add(sum, gather[5], rowYPlus + cell, transmittance[5]);
+
+					_mm_storeu_ps(result + rowOffset + cell, sum);
+					_mm_storeu_ps(accumulation + rowOffset + cell, _mm_add_ps(_mm_loadu_ps(accumulation + rowOffset + cell), sum));
+#else
+					const float* neighbours[6] =
+					{
+						rowZMinus ? rowZMinus + cell : nullptr,
+						x > 0 ? row + cell - 4 : nullptr,
+						rowZPlus ? rowZPlus + cell : nullptr,
+						x + 1 < dim ? row + cell + 4 : nullptr,
+						rowYMinus ? rowYMinus + cell : nullptr,
+						rowYPlus ? rowYPlus + cell : nullptr
+					};
+
+					float sum[4] = {};
+					for (int neighbour = 0; neighbour < 6; neighbour++)
+					{
+						if (!neighbours[neighbour])
+							continue;
+						for (int column = 0; column < 4; column++)
+							for (int i = 0; i < 4; i++)
+								sum[i] += mGather[neighbour][column * 4 + i] * neighbours[neighbour][column] * transmittance[neighbour];
+					}
+
+					for (int i = 0; i < 4; i++)
+					{
+						result[rowOffset + cell + i] = sum[i];
+						accumulation[rowOffset + cell + i] += sum[i];
+					}
+#endif
+				}
+			}
+		}
+	}
+}
+
+void LPVEngine::ClearAccumulation()
+{
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+		std::fill(mAccumulation[channel].begin(), mAccumulation[channel].end(), 0.0f);
+}
+
+double LPVEngine::GetEnergy(const std::vector<float> (&grids)[CHANNEL_COUNT])
+{
+	double energy = 0.0;
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+	{
+		for (size_t i = 0; i < grids[channel].size(); i += 4)
+			energy += grids[channel][i];
+	}
+	return energy;
+}
+
+void LPVEngine::Propagate(uint32_t steps)
+{
+	ClearAccumulation();
+	PropagateSteps(steps);
+}
+
+void LPVEngine::PropagateSteps(uint32_t steps)
+{
+	CPU_PROFILE_SCOPE("LPV propagation");
+
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+		mScratch[channel].resize(mGrid[channel].size());
+
+	const float* grids[2][CHANNEL_COUNT] = {
+		{ mGrid[CHANNEL_RED].data(), mGrid[CHANNEL_GREEN].data(), mGrid[CHANNEL_BLUE].data() },
+		{ mScratch[CHANNEL_RED].data(), mScratch[CHANNEL_GREEN].data(), mScratch[CHANNEL_BLUE].data() }
+	};
+	float* writableGrids[2][CHANNEL_COUNT] = {
+		{ mGrid[CHANNEL_RED].data(), mGrid[CHANNEL_GREEN].data(), mGrid[CHANNEL_BLUE].data() },
+		{ mScratch[CHANNEL_RED].data(), mScratch[CHANNEL_GREEN].data(), mScratch[CHANNEL_BLUE].data() }
+	};
+
+	uint32_t threadCount = std::min(std::max(mThreadCount, 1u), mDim);
+	StepBarrier barrier(threadCount);
+	bool occluded = HasGeometryVolume();
+
+	auto run = [&](uint32_t thread) {
+		uint32_t zBegin = mDim * thread / threadCount;
+		uint32_t zEnd = mDim * (thread + 1) / threadCount;
+		for (uint32_t step = 0; step < steps; step++)
+		{
+			if (occluded)
+				PropagateSlices<true>(grids[step & 1], writableGrids[(step + 1) & 1], zBegin, zEnd);
+			else
+				PropagateSlices<false>(grids[step & 1], writableGrids[(step + 1) & 1], zBegin, zEnd);
+			// the next step reads the neighbour slices of the other threads
+			if (threadCount > 1)
+				barrier.Wait();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (uint32_t thread = 1; thread < threadCount; thread++)
+		threads.emplace_back(run, thread);
+	run(0);
+	for (std::thread& thread : threads)
+		thread.join();
+
+	if (steps & 1)
+	{
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+			mGrid[channel].swap(mScratch[channel]);
+	}
+}
+
+void LPVEngine::PropagateReference(uint32_t steps)
+{
+	CPU_PROFILE_SCOPE("LPV propagation (reference)");
+
+	ClearAccumulation();
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+		mScratch[channel].resize(mGrid[channel].size());
+
+	const int dim = int(mDim);
+	for (uint32_t step = 0; step < steps; step++)
+	{
+		for (int z = 0; z < dim; z++)
+		for (int y = 0; y < dim; y++)
+		for (int x = 0; x < dim; x++)
+		{
+			// GetSHGatheringContribution
+			float result[CHANNEL_COUNT][4] = {};
+			for (int neighbourCell = 0; neighbourCell < 6; neighbourCell++)
+			{
+				int neighbourPos[3] = { x - CELL_DIRECTIONS[neighbourCell][0], y - CELL_DIRECTIONS[neighbourCell][1], z - CELL_DIRECTIONS[neighbourCell][2] };
+				float neighbourContribution[CHANNEL_COUNT][4] = {};
+				if (neighbourPos[0] >= 0 && neighbourPos[0] < dim && neighbourPos[1] >= 0 && neighbourPos[1] < dim && neighbourPos[2] >= 0 && neighbourPos[2] < dim)
+				{
+					size_t offset = ((size_t(neighbourPos[2]) * dim + neighbourPos[1]) * dim + neighbourPos[0]) * 4;
+					float transmittance = mTransmittance.empty() ? 1.0f : mTransmittance[((size_t(z) * dim + y) * dim + x) * 6 + neighbourCell];
+					for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+						for (int i = 0; i < 4; i++)
+							neighbourContribution[channel][i] = mGrid[channel][offset + i] * transmittance;
+				}
+
+				// add contribution from main direction
+				float direction[3] = { float(CELL_DIRECTIONS[neighbourCell][0]), float(CELL_DIRECTIONS[neighbourCell][1]), float(CELL_DIRECTIONS[neighbourCell][2]) };
+				float directionCosLobeSH[4], directionSH[4];
+				DirCosLobeToSH(direction, directionCosLobeSH);
+				DirToSH(direction, directionSH);
+				for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+				{
+					float weight = DIRECT_FACE_SUBTENDED_SOLID_ANGLE * Dot4(neighbourContribution[channel], directionSH);
+					for (int i = 0; i < 4; i++)
+						result[channel][i] += weight * directionCosLobeSH[i];
+				}
+
+				// contributions from side direction
+				for (int face = 0; face < 4; face++)
+				{
+					float evaluatedSideDir[3], reproSideDir[3];
+					GetEvalSideDirection(face, CELL_DIRECTIONS[face], evaluatedSideDir);
+					GetReprojSideDirection(face, CELL_DIRECTIONS[face], reproSideDir);
+
+					float evalSideDirSH[4], reproSideDirCosLobeSH[4];
+					DirToSH(evaluatedSideDir, evalSideDirSH);
+					DirCosLobeToSH(reproSideDir, reproSideDirCosLobeSH);
+					for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+					{
+						float weight = SIDE_FACE_SUBTENDED_SOLID_ANGLE * Dot4(neighbourContribution[channel], evalSideDirSH);
+						for (int i = 0; i < 4; i++)
+							result[channel][i] += weight * reproSideDirCosLobeSH[i];
+					}
+				}
+			}
+
+			size_t offset = ((size_t(z) * dim + y) * dim + x) * 4;
+			for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+			{
+				for (int i = 0; i < 4; i++)
+				{
+					mScratch[channel][offset + i] = result[channel][i];
+					mAccumulation[channel][offset + i] += result[channel][i];
+				}
+			}
+		}
+
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++)
+			mGrid[channel].swap(mScratch[channel]);
+	}
+}
+
+float LPVEngine::MaxRelativeError(const float* a, const float* b, size_t count)
+{
+	float largest = 0.0f;
+	float difference = 0.0f;
+	for (size_t i = 0; i < count; i++)
+	{
+		largest = std::max(largest, std::fabs(a[i]));
+		difference = std::max(difference, std::fabs(a[i] - b[i]));
+	}
+	return largest > 0.0f ? difference / largest : difference;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class LPVGeometryVolume;
+
+// CPU version of the light propagation volume: injection of VPLs (LPVInjection.hlsl) and the 6 neighbour
+// gather of LPVPropagation.hlsl with the same SH basis, cosine lobes and face subtended solid angles.
+// Used as the reference when changing the shaders and as a fallback without a GPU.
+// Every cell holds 4 SH coefficients per colour channel, cell (x, y, z) starts at float ((z * dim + y) * dim + x) * 4,
+// x and y are the texel of the volume texture and z its slice. Cells outside the volume read as zero.
+// World positions map to cells as position * scale + offset, by default the fixed volume of LPV_SCALE centered on the
+// origin; cascades set their own (LPVCascades).
+// The GPU reads and renders to the same textures during a step, here every step reads the result of the previous
+// one and writes the other buffer. The accumulation is the sum of all steps since it was last cleared, without the
+// injected light, like the accumulation targets the lighting pass samples.
+// Propagate folds the gather of each neighbour into a 4x4 matrix, runs it with SSE where available and splits the
+// slices over threads; PropagateReference follows the shader line by line.
+// With a geometry volume set, the light gathered from every neighbour is scaled by the transmittance between the two
+// cells (LPVGeometryVolume), computed once when the volume is set.
+// Only uses the standard library.
+class LPVEngine
+{
+public:
+    enum Channel
+    {
+        CHANNEL_RED = 0,
+        CHANNEL_GREEN,
+        CHANNEL_BLUE,
+
+        CHANNEL_COUNT
+    };
+
+    // A texel of the RSM: world position, normal (not renormalized, like the shader) and flux
+    struct VPL
+    {
+        float mPosition[3];
+        float mNormal[3];
+        float mFlux[3];
+    };
+
+    // Common.hlsl
+    static constexpr float PI = 3.14159265359f;
+    static constexpr float SH_C0 = 0.282094792f;
+    static constexpr float SH_C1 = 0.488602512f;
+    static constexpr float SH_COSINE_LOBE_C0 = 0.886226925f;
+    static constexpr float SH_COSINE_LOBE_C1 = 1.02332671f;
+    static constexpr float LPV_SCALE = 0.25f;
+    // LPVPropagation.hlsl
+    static constexpr float DIRECT_FACE_SUBTENDED_SOLID_ANGLE = 0.4006696846f / PI;
+    static constexpr float SIDE_FACE_SUBTENDED_SOLID_ANGLE = 0.4234413544f / PI;
+
+    explicit LPVEngine(uint32_t dim);
+
+    uint32_t GetDim() const { return mDim; }
+    uint32_t GetCellCount() const { return mDim * mDim * mDim; }
+
+    void SetCellTransform(float scale, const float offset[3]);
+    float GetCellScale() const { return mCellScale; }
+    const float* GetCellOffset() const { return mCellOffset; }
+
+    // 0 propagates on the calling thread, otherwise slices are split over that many threads (the caller included)
+    void SetThreadCount(uint32_t threadCount) { mThreadCount = threadCount; }
+    uint32_t GetThreadCount() const { return mThreadCount; }
+
+    // Occlusion of the propagation, null for none; the volume has to match the size and is not kept
+    void SetGeometryVolume(const LPVGeometryVolume* volume);
+    bool HasGeometryVolume() const { return !mTransmittance.empty(); }
+
+    void Clear();
+
+    // Writes every VPL into its cell the way the injection pass does: blending is off there, so the last VPL
+    // of a cell wins. accumulate sums the VPLs of a cell instead.
+    void Inject(const std::vector<VPL>& vpls, bool accumulate = false);
+    // Cell of a VPL, false if it falls outside the volume
+    bool GetInjectionCell(const VPL& vpl, uint32_t& x, uint32_t& y, uint32_t& z) const;
+
+    // Clears the accumulation and propagates, like the GPU pass every frame
+    void Propagate(uint32_t steps);
+    // Continues from the current grid and adds to the accumulation, for propagation spread over frames
+    void PropagateSteps(uint32_t steps);
+    void PropagateReference(uint32_t steps);
+    void ClearAccumulation();
+
+    // Sum of the DC coefficients over all cells and channels, proportional to the light the grid holds
+    double GetEnergy() const { return GetEnergy(mGrid); }
+    double GetAccumulatedEnergy() const { return GetEnergy(mAccumulation); }
+
+    float* GetGrid(Channel channel) { return mGrid[channel].data(); }
+    const float* GetGrid(Channel channel) const { return mGrid[channel].data(); }
+    const float* GetAccumulation(Channel channel) const { return mAccumulation[channel].data(); }
+
+    // Largest difference between two grids of the same size, relative to the largest magnitude in a
+    static float MaxRelativeError(const float* a, const float* b, size_t count);
+
+    static void DirToSH(const float direction[3], float sh[4]);
+    static void DirCosLobeToSH(const float direction[3], float sh[4]);
+
+private:
+    // The gather of each neighbour as out += mGather[n] * in, column major
+    void BuildGatherMatrices();
+    static double GetEnergy(const std::vector<float> (&grids)[CHANNEL_COUNT]);
+    // OCCLUDED reads the transmittance, without a geometry volume the gather skips it
+    template <bool OCCLUDED>
+    void PropagateSlices(const float* const source[CHANNEL_COUNT], float* const destination[CHANNEL_COUNT], uint32_t zBegin, uint32_t zEnd);
+
+    uint32_t mDim;
+    float mCellScale = LPV_SCALE;
+    float mCellOffset[3];
+    uint32_t mThreadCount = 0;
+    std::vector<float> mGrid[CHANNEL_COUNT];
+    std::vector<float> mScratch[CHANNEL_COUNT];
+    std::vector<float> mAccumulation[CHANNEL_COUNT];
+    float mGather[6][16];
+    // 6 per cell, of the light gathered from the neighbour in the order of the gather matrices
+    std::vector<float> mTransmittance;
+};
@@ -0,0 +1,247 @@
+#include "LPVGeometryVolume.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace
+{
+	void Subtract(const float a[3], const float b[3], float result[3])
+	{
+		for (int i = 0; i < 3; i++)
+			result[i] = a[i] - b[i];
+	}
+
+	void Cross(const float a[3], const float b[3], float result[3])
+	{
+		result[0] = a[1] * b[2] - a[2] * b[1];
+		result[1] = a[2] * b[0] - a[0] * b[2];
+		result[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	float Length(const float v[3])
+	{
+		return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	}
+
+	typedef std::vector<std::array<float, 3>> Polygon;
+
+	// Part of a convex polygon with bound <= p[axis] < bound + 1, points on the upper plane belong to the next slab
+	void ClipSlab(const Polygon& polygon, int axis, float bound, Polygon& result)
+	{
+		Polygon lower;
+		for (int side = 0; side < 2; side++)
+		{
+			const Polygon& input = side == 0 ? polygon : lower;
+			Polygon& output = side == 0 ? lower : result;
+			output.clear();
+			// signed distance to the plane, positive inside
+			auto distance = [&](const std::array<float, 3>& p) { return side == 0 ? p[axis] - bound : bound + 1.0f - p[axis]; };
+			auto inside = [&](float d) { return side == 0 ? d >= 0.0f : d > 0.0f; };
+			for (size_t i = 0; i < input.size(); i++)
+			{
+				const std::array<float, 3>& current = input[i];
+				const std::array<float, 3>& next = input[(i + 1) % input.size()];
+				float dCurrent = distance(current);
+				float dNext = distance(next);
+				if (inside(dCurrent))
+					output.push_back(current);
+				if (inside(dCurrent) != inside(dNext))
+				{
+					float t = dCurrent / (dCurrent - dNext);
+					std::array<float, 3> crossing;
+					for (int k = 0; k < 3; k++)
+						crossing[k] = current[k] + (next[k] - current[k]) * t;
+					crossing[axis] = side == 0 ? bound : bound + 1.0f;
+					output.push_back(crossing);
+				}
+			}
+		}
+	}
+
+	float Area(const Polygon& polygon)
+	{
+		float sum[3] = {};
+		for (size_t i = 1; i + 1 < polygon.size(); i++)
+		{
+			float u[3], v[3], normal[3];
+			Subtract(polygon[i].data(), polygon[0].data(), u);
+			Subtract(polygon[i + 1].data(), polygon[0].data(), v);
+			Cross(u, v, normal);
+			for (int k = 0; k < 3; k++)
+				sum[k] += normal[k];
+		}
+		return 0.5f * Length(sum);
+	}
+}
+
+LPVGeometryVolume::LPVGeometryVolume(uint32_t dim)
+	: mDim(dim)
+	, mCellScale(LPVEngine::LPV_SCALE)
+{
+	for (int i = 0; i < 3; i++)
+		mCellOffset[i] = float(dim / 2);
+	mOcclusion.resize(size_t(dim) * dim * dim * 4);
+}
+
+void LPVGeometryVolume::SetCellTransform(float scale, const float offset[3])
+{
+	mCellScale = scale;
+	std::copy(offset, offset + 3, mCellOffset);
+}
+
+void LPVGeometryVolume::Clear()
+{
+	std::fill(mOcclusion.begin(), mOcclusion.end(), 0.0f);
+}
+
+void LPVGeometryVolume::AddSurfel(const float position[3], const float normal[3], float area)
+{
+	int cell[3];
+	for (int i = 0; i < 3; i++)
+	{
+		float coordinate = std::floor(position[i] * mCellScale + mCellOffset[i]);
+		if (!(coordinate >= 0.0f && coordinate < float(mDim)))
+			return;
+		cell[i] = int(coordinate);
+	}
+
+	float length = Length(normal);
+	if (!(length > 0.0f))
+		return;
+	float direction[3] = { normal[0] / length, normal[1] / length, normal[2] / length };
+	float lobe[4];
+	LPVEngine::DirCosLobeToSH(direction, lobe);
+
+	float coverage = area * mCellScale * mCellScale;
+	float* occlusion = &mOcclusion[((size_t(cell[2]) * mDim + cell[1]) * mDim + cell[0]) * 4];
+	for (int i = 0; i < 4; i++)
+		occlusion[i] += coverage * lobe[i];
+}
+
+void LPVGeometryVolume::AddTriangle(const float a[3], const float b[3], const float c[3])
+{
+	float ab[3], ac[3], normal[3];
+	Subtract(b, a, ab);
+	Subtract(c, a, ac);
+	Cross(ab, ac, normal);
+	float length = Length(normal);
+	if (!(length > 0.0f))
+		return;
+	float direction[3] = { normal[0] / length, normal[1] / length, normal[2] / length };
+	float lobe[4];
+	LPVEngine::DirCosLobeToSH(direction, lobe);
+
+	// in cell units, where the area of a piece is its coverage
+	Polygon triangle(3);
+	const float* corners[3] = { a, b, c };
+	for (int v = 0; v < 3; v++)
+		for (int i = 0; i < 3; i++)
+			triangle[v][i] = corners[v][i] * mCellScale + mCellOffset[i];
+
+	int first[3], last[3];
+	for (int i = 0; i < 3; i++)
+	{
+		float minimum = std::min(triangle[0][i], std::min(triangle[1][i], triangle[2][i]));
+		float maximum = std::max(triangle[0][i], std::max(triangle[1][i], triangle[2][i]));
+		first[i] = std::max(int(std::floor(minimum)), 0);
+		last[i] = std::min(int(std::floor(maximum)), int(mDim) - 1);
+	}
+
+	// slabs along x, rows along y, then cells along z
+	Polygon slab, row, piece;
+	for (int x = first[0]; x <= last[0]; x++)
+	{
+		ClipSlab(triangle, 0, float(x), slab);
+		for (int y = first[1]; y <= last[1] && slab.size() >= 3; y++)
+		{
+			ClipSlab(slab, 1, float(y), row);
+			for (int z = first[2]; z <= last[2] && row.size() >= 3; z++)
+			{
+				ClipSlab(row, 2, float(z), piece);
+				float coverage = Area(piece);
+				if (!(coverage > 0.0f))
+					continue;
+				float* occlusion = &mOcclusion[((size_t(z) * mDim + y) * mDim + x) * 4];
+				for (int i = 0; i < 4; i++)
+					occlusion[i] += coverage * lobe[i];
+			}
+		}
+	}
+}
+
+void LPVGeometryVolume::AddMesh(const float* positions, const float* normals, size_t vertexCount, const uint32_t* indices, size_t indexCount, const float* world)
+{
+	CPU_PROFILE_SCOPE("LPV geometry volume");
+
+	std::vector<float> transformed;
+	if (world)
+	{
+		transformed.resize(vertexCount * 3);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			const float* p = positions + v * 3;
+			for (int i = 0; i < 3; i++)
+				transformed[v * 3 + i] = p[0] * world[i] + p[1] * world[4 + i] + p[2] * world[8 + i] + world[12 + i];
+		}
+		positions = transformed.data();
+	}
+
+	for (size_t t = 0; t + 2 < indexCount; t += 3)
+	{
+		if (indices[t] >= vertexCount || indices[t + 1] >= vertexCount || indices[t + 2] >= vertexCount)
+			continue;
+		const float* a = positions + size_t(indices[t]) * 3;
+		const float* b = positions + size_t(indices[t + 1]) * 3;
+		const float* c = positions + size_t(indices[t + 2]) * 3;
+
+		bool flip = false;
+		if (normals)
+		{
+			float ab[3], ac[3], normal[3];
+			Subtract(b, a, ab);
+			Subtract(c, a, ac);
+			Cross(ab, ac, normal);
+			// object space normals through the rotation part of world, enough for the side
+			float facing = 0.0f;
+			for (int v = 0; v < 3; v++)
+			{
+				const float* n = normals + size_t(indices[t + v]) * 3;
+				for (int i = 0; i < 3; i++)
+					facing += normal[i] * (world ? n[0] * world[i] + n[1] * world[4 + i] + n[2] * world[8 + i] : n[i]);
+			}
+			flip = facing < 0.0f;
+		}
+		if (flip)
+			AddTriangle(a, c, b);
+		else
+			AddTriangle(a, b, c);
+	}
+}
+
+float LPVGeometryVolume::GetTransmittance(int x, int y, int z, const int direction[3]) const
+{
+	const int dim = int(mDim);
+	auto inside = [dim](int cx, int cy, int cz) {
+		return cx >= 0 && cx < dim && cy >= 0 && cy < dim && cz >= 0 && cz < dim;
+	};
+
+	// a surface blocks light coming against its normal, in whichever of the two cells it lies
+	float against[3] = { -float(direction[0]), -float(direction[1]), -float(direction[2]) };
+	auto blocking = [&](int cx, int cy, int cz) {
+		return inside(cx, cy, cz) ? GetBlocking(GetCell(uint32_t(cx), uint32_t(cy), uint32_t(cz)), against) : 0.0f;
+	};
+	return 1.0f - std::max(blocking(x, y, z), blocking(x + direction[0], y + direction[1], z + direction[2]));
+}
+
+float LPVGeometryVolume::GetBlocking(const float occlusion[4], const float direction[3])
+{
+	// inverse of DirCosLobeToSH
+	float coverage = occlusion[0] / LPVEngine::SH_COSINE_LOBE_C0;
+	float normal[3] = { -occlusion[3] / LPVEngine::SH_COSINE_LOBE_C1, -occlusion[1] / LPVEngine::SH_COSINE_LOBE_C1, occlusion[2] / LPVEngine::SH_COSINE_LOBE_C1 };
+
+	float facing = std::max(normal[0] * direction[0] + normal[1] * direction[1] + normal[2] * direction[2], 0.0f);
+	float cancelled = std::max(coverage - Length(normal), 0.0f);
+	return std::min(facing + 0.5f * cancelled, 1.0f);
+}
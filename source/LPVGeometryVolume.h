@@ -0,0 +1,51 @@
+#pragma once
+
+#include "LPVEngine.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Geometry volume of a light propagation volume: how much the surfaces in every cell block light, as 4 SH
+// coefficients per cell in the cell layout of LPVEngine. Surfaces are added as surfels (RSM or G-buffer samples) or
+// as triangle meshes, which are clipped against the cells. A surfel or the piece of a triangle in a cell adds its
+// coverage c (area in cells, 1 for a face spanning the cell) times the SH of its clamped cosine lobe.
+// Evaluating the SH directly would block a third of the light running along a surface and some of the light
+// leaving its back, so the blocking towards w is rebuilt from the coefficients instead: with C the summed coverage
+// (band 0) and N the summed coverage weighted normals (band 1), max(0, dot(N, w)) is exact for surfaces facing one
+// way, and C - |N| is the coverage that cancelled out in N (surfaces facing each other inside a cell), which blocks
+// in every direction with half its amount. Surfaces never block the light they reflect themselves.
+// Propagation from a cell into its neighbour along direction d is scaled by the transmittance 1 - blocking towards
+// -d of the more occluded of the two cells (LPVPropagation.hlsl).
+// Only uses the standard library.
+class LPVGeometryVolume
+{
+public:
+    explicit LPVGeometryVolume(uint32_t dim);
+
+    uint32_t GetDim() const { return mDim; }
+    // Same mapping as the engine the volume is used with (LPVEngine::SetCellTransform)
+    void SetCellTransform(float scale, const float offset[3]);
+    void Clear();
+
+    void AddSurfel(const float position[3], const float normal[3], float area);
+    // Triangles of 3 indices into xyz positions; world is a row major 4x4 matrix applied to row vectors
+    // (DirectXMath), null for positions already in world space. A triangle abc faces cross(b - a, c - a), or the
+    // side of its vertex normals if they are given, whatever the winding of the mesh.
+    void AddMesh(const float* positions, const float* normals, size_t vertexCount, const uint32_t* indices, size_t indexCount, const float* world = nullptr);
+
+    const float* GetCell(uint32_t x, uint32_t y, uint32_t z) const { return &mOcclusion[((size_t(z) * mDim + y) * mDim + x) * 4]; }
+    const std::vector<float>& GetData() const { return mOcclusion; }
+    // Of light going from the cell into its neighbour at cell + direction, an axis
+    float GetTransmittance(int x, int y, int z, const int direction[3]) const;
+    // Fraction of the light towards the direction the occlusion of a cell blocks
+    static float GetBlocking(const float occlusion[4], const float direction[3]);
+
+private:
+    void AddTriangle(const float a[3], const float b[3], const float c[3]);
+
+    uint32_t mDim;
+    float mCellScale;
+    float mCellOffset[3];
+    std::vector<float> mOcclusion;
+};
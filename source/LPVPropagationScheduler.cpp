@@ -0,0 +1,78 @@
+#include "LPVPropagationScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+LPVPropagationScheduler::LPVPropagationScheduler(const Settings& settings)
+	: mSettings(settings)
+{
+}
+
+void LPVPropagationScheduler::SetSettings(const Settings& settings)
+{
+	// fewer steps than already ran, or a stricter epsilon, need a fresh volume to mean anything
+	if (settings.mMaxSteps < mCompletedSteps || settings.mConvergenceEpsilon < mSettings.mConvergenceEpsilon)
+		mValid = false;
+	mSettings = settings;
+}
+
+LPVPropagationScheduler::Action LPVPropagationScheduler::BeginFrame(float injectionChange)
+{
+	mStats.mFrames++;
+	mFrameSteps = 0;
+
+	if (!mValid || injectionChange < 0.0f || injectionChange > mSettings.mRestartThreshold)
+	{
+		mAction = ACTION_RESTART;
+		mValid = true;
+		mCompletedSteps = 0;
+		mConverged = false;
+		mStats.mRestarts++;
+	}
+	else if (IsDone())
+	{
+		mAction = ACTION_SKIP;
+		mStats.mSkippedFrames++;
+	}
+	else
+		mAction = ACTION_CONTINUE;
+
+	uint32_t remaining = IsDone() ? 0 : mSettings.mMaxSteps - mCompletedSteps;
+	mBudget = mSettings.mStepsPerFrame > 0 ? std::min(mSettings.mStepsPerFrame, remaining) : remaining;
+	return mAction;
+}
+
+bool LPVPropagationScheduler::EndStep(double stepEnergy, double accumulatedEnergy)
+{
+	EndSteps(1);
+
+	// a grid without light has converged as well
+	if (mSettings.mConvergenceEpsilon > 0.0f && mCompletedSteps < mSettings.mMaxSteps &&
+		std::fabs(stepEnergy) <= double(mSettings.mConvergenceEpsilon) * std::fabs(accumulatedEnergy))
+	{
+		mConverged = true;
+		mStats.mEarlyStops++;
+	}
+	return !IsDone() && mFrameSteps < mBudget;
+}
+
+void LPVPropagationScheduler::EndSteps(uint32_t steps)
+{
+	mFrameSteps += steps;
+	mCompletedSteps = std::min(mCompletedSteps + steps, mSettings.mMaxSteps);
+	mStats.mSteps += steps;
+}
+
+float LPVPropagationScheduler::RelativeChange(const float* reference, const float* current, size_t count)
+{
+	double difference = 0.0;
+	double total = 0.0;
+	for (size_t i = 0; i < count; i++)
+	{
+		difference += std::fabs(double(current[i]) - double(reference[i]));
+		total += std::fabs(double(reference[i]));
+	}
+	if (total > 0.0)
+		return float(difference / total);
+	return difference > 0.0 ? 1.0f : 0.0f;
+}
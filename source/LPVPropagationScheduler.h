@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Spreads the propagation of the light propagation volume over frames and stops it once it stops changing.
+// A frame restarts propagation (inject, clear the accumulation) when the injected light changed by more than the
+// restart threshold since the last restart, otherwise it continues where the last frame stopped with at most the
+// steps per frame budget, and it skips propagation entirely once all steps ran or the volume converged.
+// Convergence is measured per step: a step whose energy (LPVEngine::GetEnergy of its output) adds less than
+// epsilon times the energy accumulated so far ends propagation early. Callers without the energies (the GPU path has
+// no readback) report the steps they ran with EndSteps and only stop at the step limit.
+// Only uses the standard library.
+class LPVPropagationScheduler
+{
+public:
+    enum Action
+    {
+        ACTION_SKIP = 0,    // nothing to do, the accumulation is final
+        ACTION_RESTART,     // inject, clear the accumulation, then propagate
+        ACTION_CONTINUE,    // propagate from the current grid, adding to the accumulation
+    };
+
+    struct Settings
+    {
+        uint32_t mMaxSteps = 50;
+        uint32_t mStepsPerFrame = 0;        // 0 runs all remaining steps in one frame
+        float mRestartThreshold = 0.01f;    // relative change of the injected light
+        float mConvergenceEpsilon = 0.0f;   // 0 never stops early
+    };
+
+    struct Stats
+    {
+        uint64_t mFrames = 0;
+        uint64_t mRestarts = 0;
+        uint64_t mSkippedFrames = 0;
+        uint64_t mSteps = 0;
+        uint64_t mEarlyStops = 0;           // restarts that converged before the step limit
+        // Steps a full propagation every frame would have run on top of mSteps
+        uint64_t GetSavedSteps(uint32_t maxSteps) const { return mFrames * maxSteps - mSteps; }
+    };
+
+    LPVPropagationScheduler() = default;
+    explicit LPVPropagationScheduler(const Settings& settings);
+
+    void SetSettings(const Settings& settings);
+    const Settings& GetSettings() const { return mSettings; }
+
+    // injectionChange is the relative change of the injected light since the last restart (RelativeChange),
+    // a negative value forces a restart
+    Action BeginFrame(float injectionChange);
+    Action GetAction() const { return mAction; }
+    // Steps the frame may run
+    uint32_t GetStepBudget() const { return mBudget; }
+
+    // After every step of the frame; returns false when the frame should stop propagating
+    bool EndStep(double stepEnergy, double accumulatedEnergy);
+    // Steps run without energies
+    void EndSteps(uint32_t steps);
+
+    // Forgets the propagated volume, the next frame restarts
+    void Invalidate() { mValid = false; }
+
+    uint32_t GetCompletedSteps() const { return mCompletedSteps; }
+    bool IsConverged() const { return mConverged; }
+    bool IsDone() const { return mConverged || mCompletedSteps >= mSettings.mMaxSteps; }
+    const Stats& GetStats() const { return mStats; }
+    void ResetStats() { mStats = Stats(); }
+
+    // Sum of the absolute differences relative to the sum of the absolute reference values
+    static float RelativeChange(const float* reference, const float* current, size_t count);
+
+private:
+    Settings mSettings;
+    Stats mStats;
+    Action mAction = ACTION_SKIP;
+    uint32_t mBudget = 0;
+    uint32_t mFrameSteps = 0;
+    uint32_t mCompletedSteps = 0;
+    bool mConverged = false;
+    bool mValid = false;
+};
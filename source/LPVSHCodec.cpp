@@ -0,0 +1,198 @@
+#include "LPVSHCodec.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// UNORM/SNORM conversions of D3D: clamped, scaled and rounded to nearest
+	uint8_t ToUnorm8(float value)
+	{
+		value = std::min(std::max(value, 0.0f), 1.0f);
+		return uint8_t(std::nearbyint(value * 255.0f));
+	}
+
+	int8_t ToSnorm8(float value)
+	{
+		value = std::min(std::max(value, -1.0f), 1.0f);
+		return int8_t(std::nearbyint(value * 127.0f));
+	}
+
+	float Scale(float scale)
+	{
+		return scale > 0.0f ? scale : 1.0f;
+	}
+}
+
+const char* LPVSHCodec::GetName(Encoding encoding)
+{
+	switch (encoding)
+	{
+	case ENCODING_UNORM8: return "UNORM8";
+	case ENCODING_FLOAT16: return "FLOAT16";
+	case ENCODING_SNORM8_SCALED: return "SNORM8 scaled";
+	default: return "Unknown";
+	}
+}
+
+uint32_t LPVSHCodec::GetBytesPerCell(Encoding encoding)
+{
+	return encoding == ENCODING_FLOAT16 ? 8 : 4;
+}
+
+void LPVSHCodec::Encode(Encoding encoding, const float* sh, size_t cellCount, float scale, std::vector<uint8_t>& packed)
+{
+	const uint32_t bytesPerCell = GetBytesPerCell(encoding);
+	packed.resize(cellCount * bytesPerCell);
+	const float inverseScale = 1.0f / Scale(scale);
+
+	for (size_t cell = 0; cell < cellCount; cell++)
+	{
+		const float* coefficients = sh + cell * 4;
+		uint8_t* bytes = &packed[cell * bytesPerCell];
+		switch (encoding)
+		{
+		case ENCODING_UNORM8:
+			for (int i = 0; i < 4; i++)
+				bytes[i] = ToUnorm8(coefficients[i]);
+			break;
+		case ENCODING_FLOAT16:
+			for (int i = 0; i < 4; i++)
+			{
+				uint16_t half = FloatToHalf(coefficients[i]);
+				bytes[i * 2] = uint8_t(half & 0xFF);
+				bytes[i * 2 + 1] = uint8_t(half >> 8);
+			}
+			break;
+		case ENCODING_SNORM8_SCALED:
+			for (int i = 0; i < 4; i++)
+				bytes[i] = uint8_t(ToSnorm8(coefficients[i] * inverseScale));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void LPVSHCodec::Decode(Encoding encoding, const uint8_t* packed, size_t cellCount, float scale, float* sh)
+{
+	const uint32_t bytesPerCell = GetBytesPerCell(encoding);
+	scale = Scale(scale);
+
+	for (size_t cell = 0; cell < cellCount; cell++)
+	{
+		float* coefficients = sh + cell * 4;
+		const uint8_t* bytes = packed + cell * bytesPerCell;
+		switch (encoding)
+		{
+		case ENCODING_UNORM8:
+			for (int i = 0; i < 4; i++)
+				coefficients[i] = float(bytes[i]) / 255.0f;
+			break;
+		case ENCODING_FLOAT16:
+			for (int i = 0; i < 4; i++)
+				coefficients[i] = HalfToFloat(uint16_t(bytes[i * 2] | (bytes[i * 2 + 1] << 8)));
+			break;
+		case ENCODING_SNORM8_SCALED:
+			// -128 reads as -1 too
+			for (int i = 0; i < 4; i++)
+				coefficients[i] = std::max(float(int8_t(bytes[i])) / 127.0f, -1.0f) * scale;
+			break;
+		default:
+			std::fill(coefficients, coefficients + 4, 0.0f);
+			break;
+		}
+	}
+}
+
+float LPVSHCodec::FindScale(const float* sh, size_t count)
+{
+	float largest = 0.0f;
+	for (size_t i = 0; i < count; i++)
+		largest = std::max(largest, std::fabs(sh[i]));
+	return largest;
+}
+
+uint16_t LPVSHCodec::FloatToHalf(float value)
+{
+	uint16_t sign = std::signbit(value) ? 0x8000 : 0;
+	float magnitude = std::fabs(value);
+	if (std::isnan(magnitude))
+		return sign | 0x7E00;
+	if (magnitude >= HALF_MAX)
+		return sign | 0x7BFF;
+	if (magnitude == 0.0f)
+		return sign;
+
+	// magnitude = fraction * 2^exponent with fraction in [0.5, 1)
+	int exponent = 0;
+	float fraction = std::frexp(magnitude, &exponent);
+	if (exponent < -13)
+	{
+		// subnormal in steps of 2^-24, rounding up to 1024 gives the smallest normal
+		return sign | uint16_t(std::nearbyint(std::ldexp(magnitude, 24)));
+	}
+
+	uint32_t significand = uint32_t(std::nearbyint(fraction * 2048.0f));
+	if (significand == 2048)
+	{
+		significand = 1024;
+		exponent++;
+	}
+	uint32_t biased = uint32_t(exponent + 14);
+	if (biased >= 31)
+		return sign | 0x7BFF;
+	return sign | uint16_t((biased << 10) | (significand - 1024));
+}
+
+float LPVSHCodec::HalfToFloat(uint16_t half)
+{
+	float sign = (half & 0x8000) ? -1.0f : 1.0f;
+	int biased = (half >> 10) & 0x1F;
+	int significand = half & 0x3FF;
+	if (biased == 0)
+		return sign * std::ldexp(float(significand), -24);
+	if (biased == 31)
+		return significand ? NAN : sign * INFINITY;
+	return sign * std::ldexp(float(significand + 1024), biased - 25);
+}
+
+uint32_t LPVSHCodec::PackSharedExponent(const float sh[4])
+{
+	float largest = 0.0f;
+	for (int i = 0; i < 4; i++)
+		largest = std::max(largest, std::fabs(sh[i]));
+	if (!(largest > 0.0f))
+		return 0;
+
+	// the smallest power of two at or above the largest coefficient
+	int exponent = 0;
+	float fraction = std::frexp(largest, &exponent);
+	if (fraction == 0.5f)
+		exponent--;
+	int biased = std::min(std::max(exponent + SHARED_EXPONENT_BIAS, 0), SHARED_EXPONENT_MAX);
+	float inverseStep = float(SHARED_MANTISSA_MAX) / std::ldexp(1.0f, biased - SHARED_EXPONENT_BIAS);
+
+	uint32_t packed = uint32_t(biased) << 28;
+	for (int i = 0; i < 4; i++)
+	{
+		float magnitude = std::fabs(sh[i]) * inverseStep;
+		uint32_t mantissa = magnitude < float(SHARED_MANTISSA_MAX) ? uint32_t(std::nearbyint(magnitude)) : uint32_t(SHARED_MANTISSA_MAX);
+		if (std::signbit(sh[i]) && mantissa > 0)
+			mantissa |= 0x40;
+		packed |= mantissa << (i * 7);
+	}
+	return packed;
+}
+
+void LPVSHCodec::UnpackSharedExponent(uint32_t packed, float sh[4])
+{
+	int biased = int(packed >> 28);
+	float step = std::ldexp(1.0f, biased - SHARED_EXPONENT_BIAS) / float(SHARED_MANTISSA_MAX);
+	for (int i = 0; i < 4; i++)
+	{
+		uint32_t mantissa = (packed >> (i * 7)) & 0x7F;
+		float magnitude = float(mantissa & 0x3F) * step;
+		sh[i] = (mantissa & 0x40) ? -magnitude : magnitude;
+	}
+}
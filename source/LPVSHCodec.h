@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Storage encodings of the SH volumes of a light propagation volume, 4 coefficients of one colour channel per cell
+// in the layout of LPVEngine. Encode and Decode do what the GPU does when rendering to and sampling a texture of
+// the matching format, so errors and sizes can be measured on the CPU (tools/LPVCodecBench).
+//   UNORM8          R8G8B8A8_UNORM, the original format: negative coefficients and everything above 1 are clamped
+//   FLOAT16         R16G16B16A16_FLOAT, 11 significant bits per coefficient, saturated at 65504
+//   SNORM8_SCALED   R8G8B8A8_SNORM of the coefficients divided by a scale for the whole volume, signed but clamped
+//                   to [-scale, scale]; the injection divides and the lighting multiplies (LPVStorageScale)
+// The volumes are rendered to with additive blending and sampled with trilinear filtering, so only render target
+// formats are encodings. PackSharedExponent is for volumes stored or sent by the CPU: 32 bits per cell, a 4 bit
+// exponent for the largest coefficient and 4 sign and 6 bit magnitude mantissas; an R32_UINT target could hold it
+// but neither blends nor filters it.
+// Only uses the standard library.
+class LPVSHCodec
+{
+public:
+    enum Encoding
+    {
+        ENCODING_UNORM8 = 0,
+        ENCODING_FLOAT16,
+        ENCODING_SNORM8_SCALED,
+
+        ENCODING_COUNT
+    };
+
+    // value = mantissa / SHARED_MANTISSA_MAX * 2^(exponent - SHARED_EXPONENT_BIAS), up to 128
+    static constexpr int SHARED_EXPONENT_BIAS = 8;
+    static constexpr int SHARED_EXPONENT_MAX = 15;
+    static constexpr int SHARED_MANTISSA_MAX = 63;
+    static constexpr float HALF_MAX = 65504.0f;
+
+    static const char* GetName(Encoding encoding);
+    // Per cell and colour channel
+    static uint32_t GetBytesPerCell(Encoding encoding);
+    // The scale only matters for SNORM8_SCALED
+    static void Encode(Encoding encoding, const float* sh, size_t cellCount, float scale, std::vector<uint8_t>& packed);
+    static void Decode(Encoding encoding, const uint8_t* packed, size_t cellCount, float scale, float* sh);
+    // Largest magnitude of the coefficients, the smallest scale that clamps none of them
+    static float FindScale(const float* sh, size_t count);
+
+    // Round to nearest even, with subnormals
+    static uint16_t FloatToHalf(float value);
+    static float HalfToFloat(uint16_t half);
+    static uint32_t PackSharedExponent(const float sh[4]);
+    static void UnpackSharedExponent(uint32_t packed, float sh[4]);
+};
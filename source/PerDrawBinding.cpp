@@ -0,0 +1,45 @@
+#include "PerDrawBinding.h"
+
+namespace PerDrawBinding
+{
+	const char* GetPassName(Pass pass)
+	{
+		static const char* names[PASS_COUNT] = { "GBuffer", "Shadows", "RSM buffers", "Voxelization" };
+		return pass < PASS_COUNT ? names[pass] : "";
+	}
+
+	const char* GetDataName(Data data)
+	{
+		return data == DATA_ROOT_CONSTANTS ? "root constants" : "root CBV";
+	}
+
+	RootSignatureLayout GetLayout(Pass pass, Data data)
+	{
+		typedef RootSignatureLayout L;
+		// the shadow map only has a vertex shader
+		L::Visibility visibility = pass == PASS_SHADOWS ? L::VISIBILITY_VERTEX : L::VISIBILITY_ALL;
+
+		L layout;
+		layout.AddDescriptor(L::PARAMETER_CBV, 0, visibility);
+		if (data == DATA_ROOT_CONSTANTS)
+			layout.AddConstants(1, OBJECT_CONSTANT_DWORDS, visibility);
+		else
+			layout.AddDescriptor(L::PARAMETER_CBV, 1, visibility);
+
+		switch (pass)
+		{
+		case PASS_GBUFFER:
+			layout.AddStaticSampler(0, L::VISIBILITY_PIXEL);
+			break;
+		case PASS_VOXELIZATION:
+			// shadow map and the voxel volume
+			layout.AddTable({ { L::RANGE_SRV, 0, 1, 0 } });
+			layout.AddTable({ { L::RANGE_UAV, 0, 1, 0 } });
+			layout.AddStaticSampler(0, L::VISIBILITY_PIXEL);
+			break;
+		default:
+			break;
+		}
+		return layout;
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "RootSignatureLayout.h"
+
+// Root signature layouts of the passes that draw every object, shared by DXRSExampleGIScene and
+// tools/RootSignatureCheck. Parameter 0 is the per-pass constant buffer (b0) as a root CBV and parameter 1 the
+// per-object data (b1, perModelInstanceCB of the shaders): either the object's constants written straight into the
+// root arguments or a root CBV of the object's constant buffer. Both replace the table of 2 CBVs the passes used to
+// build per draw, a descriptor block and 2 descriptor copies each.
+namespace PerDrawBinding
+{
+	enum Pass { PASS_GBUFFER, PASS_SHADOWS, PASS_RSM_BUFFERS, PASS_VOXELIZATION, PASS_COUNT };
+	enum Data { DATA_ROOT_CONSTANTS, DATA_ROOT_CBV, DATA_COUNT };
+
+	const uint32_t PASS_PARAMETER = 0;
+	const uint32_t OBJECT_PARAMETER = 1;
+	// float4x4 World and float4 DiffuseColor, DXRSModel::ModelConstantBuffer
+	const uint32_t OBJECT_CONSTANT_DWORDS = 20;
+
+	const char* GetPassName(Pass pass);
+	const char* GetDataName(Data data);
+	RootSignatureLayout GetLayout(Pass pass, Data data);
+}
@@ -0,0 +1,144 @@
+#include "PipelineStateCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+template<typename T>
+static void Write(std::vector<uint8_t>& out, const T& value)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+static bool Read(const uint8_t*& cursor, const uint8_t* end, T& value)
+{
+	if (static_cast<size_t>(end - cursor) < sizeof(T))
+		return false;
+
+	memcpy(&value, cursor, sizeof(T));
+	cursor += sizeof(T);
+	return true;
+}
+
+bool PipelineStateCache::Load(const std::wstring& path)
+{
+	std::ifstream file(std::filesystem::path(path), std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+
+	std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	if (!file.read(reinterpret_cast<char*>(data.data()), data.size()))
+		return false;
+
+	return Deserialize(data.data(), data.size());
+}
+
+bool PipelineStateCache::Save(const std::wstring& path)
+{
+	std::vector<uint8_t> data;
+	Serialize(data);
+
+	std::filesystem::path filePath(path);
+	std::error_code ec;
+	if (filePath.has_parent_path())
+		std::filesystem::create_directories(filePath.parent_path(), ec);
+
+	std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	if (!file)
+		return false;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mDirty = false;
+	return true;
+}
+
+bool PipelineStateCache::Find(uint64_t key, std::vector<uint8_t>& out) const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto it = mEntries.find(key);
+	if (it == mEntries.end())
+		return false;
+
+	out = it->second;
+	return true;
+}
+
+void PipelineStateCache::Store(uint64_t key, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mEntries[key].assign(bytes, bytes + size);
+	mDirty = true;
+}
+
+void PipelineStateCache::Remove(uint64_t key)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (mEntries.erase(key) > 0)
+		mDirty = true;
+}
+
+void PipelineStateCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mDirty = !mEntries.empty();
+	mEntries.clear();
+}
+
+void PipelineStateCache::Serialize(std::vector<uint8_t>& out) const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	out.clear();
+	Write(out, Magic);
+	Write(out, Version);
+	Write(out, static_cast<uint32_t>(mEntries.size()));
+	for (auto& entry : mEntries)
+	{
+		Write(out, entry.first);
+		Write(out, static_cast<uint32_t>(entry.second.size()));
+		out.insert(out.end(), entry.second.begin(), entry.second.end());
+	}
+}
+
+bool PipelineStateCache::Deserialize(const uint8_t* data, size_t size)
+{
+	const uint8_t* cursor = data;
+	const uint8_t* end = data + size;
+
+	uint32_t magic = 0, version = 0, count = 0;
+	if (!Read(cursor, end, magic) || magic != Magic)
+		return false;
+	if (!Read(cursor, end, version) || version != Version)
+		return false;
+	if (!Read(cursor, end, count))
+		return false;
+
+	// parse everything first so a truncated file leaves the cache untouched
+	std::map<uint64_t, std::vector<uint8_t>> entries;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint64_t key = 0;
+		uint32_t blobSize = 0;
+		if (!Read(cursor, end, key) || !Read(cursor, end, blobSize))
+			return false;
+		if (static_cast<size_t>(end - cursor) < blobSize)
+			return false;
+
+		entries[key].assign(cursor, cursor + blobSize);
+		cursor += blobSize;
+	}
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mEntries.swap(entries);
+	mDirty = false;
+	return true;
+}
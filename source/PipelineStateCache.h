@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// On-disk store of driver pipeline blobs (ID3D12PipelineState::GetCachedBlob) keyed by the
+// description hash computed in GraphicsPSO/ComputePSO::Finalize. Blobs are fed back through
+// D3D12_CACHED_PIPELINE_STATE on the next start so the driver can skip compilation.
+// Only uses the standard library, so the index and file format can be exercised without a device.
+//
+// File layout (little endian):
+//   uint32 magic 'PSOC', uint32 version, uint32 entry count
+//   per entry: uint64 key, uint32 size, size bytes of blob
+class PipelineStateCache
+{
+public:
+    static constexpr uint32_t Magic = 0x434F5350; // 'PSOC'
+    static constexpr uint32_t Version = 1;
+
+    bool Load(const std::wstring& path);
+    bool Save(const std::wstring& path);
+
+    // Copies the blob for the key into out, returns false if there is none
+    bool Find(uint64_t key, std::vector<uint8_t>& out) const;
+    void Store(uint64_t key, const void* data, size_t size);
+    void Remove(uint64_t key);
+    void Clear();
+
+    // Passes the stored blob for the key to createFromBlob(data, size), which returns false when the driver
+    // rejects it (new driver or adapter); a rejected blob is dropped. Counts a hit or a miss and returns
+    // whether the blob was used. On a miss the caller compiles the pipeline and stores its new blob.
+    template<typename CreateFunc>
+    bool CreateFromBlob(uint64_t key, CreateFunc createFromBlob)
+    {
+        std::vector<uint8_t> blob;
+        if (Find(key, blob))
+        {
+            if (createFromBlob(blob.data(), blob.size()))
+            {
+                mHits++;
+                return true;
+            }
+            Remove(key);
+        }
+        mMisses++;
+        return false;
+    }
+
+    size_t GetEntryCount() const { return mEntries.size(); }
+    bool IsDirty() const { return mDirty; }
+
+    // Serialization to/from memory, used by Load/Save
+    void Serialize(std::vector<uint8_t>& out) const;
+    bool Deserialize(const uint8_t* data, size_t size);
+
+    // Statistics for the current run, updated by PSO::Finalize
+    std::atomic<uint32_t> mHits{ 0 };
+    std::atomic<uint32_t> mMisses{ 0 };
+
+private:
+    std::map<uint64_t, std::vector<uint8_t>> mEntries;
+    mutable std::mutex mMutex;
+    bool mDirty = false;
+};
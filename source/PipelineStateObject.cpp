@@ -12,19 +12,122 @@
 
 #include "RootSignature.h"
 #include "PipelineStateObject.h"
-
-#include <map>
+#include "PipelineStateCache.h"
+#include "Hash.h"
+#include "SharedObjectMap.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace std;
 
-static map< size_t, ComPtr<ID3D12PipelineState> > s_GraphicsPSOHashMap;
-static map< size_t, ComPtr<ID3D12PipelineState> > s_ComputePSOHashMap;
+static SharedObjectMap< uint64_t, ComPtr<ID3D12PipelineState> > s_GraphicsPSOHashMap;
+static SharedObjectMap< uint64_t, ComPtr<ID3D12PipelineState> > s_ComputePSOHashMap;
+static PipelineStateCache* s_PipelineCache = nullptr;
 
 void PSO::DestroyAll(void)
 {
-    s_GraphicsPSOHashMap.clear();
-    s_ComputePSOHashMap.clear();
+    s_GraphicsPSOHashMap.Clear();
+    s_ComputePSOHashMap.Clear();
+}
+
+void PSO::Evict(uint64_t Hash)
+{
+    s_GraphicsPSOHashMap.Erase(Hash);
+    s_ComputePSOHashMap.Erase(Hash);
+}
+
+void PSO::SetPipelineCache(PipelineStateCache* cache)
+{
+    s_PipelineCache = cache;
+}
+
+static uint64_t HashBytecode(const D3D12_SHADER_BYTECODE& Bytecode, uint64_t Hash)
+{
+    Hash = Utility::HashState(&Bytecode.BytecodeLength, 1, Hash);
+    return Utility::HashRange(Bytecode.pShaderBytecode, Bytecode.BytecodeLength, Hash);
+}
+
+// The structs below have padding that assignments from caller descriptions may fill with garbage,
+// so their fields are hashed one by one
+static uint64_t HashBlendState(const D3D12_BLEND_DESC& Blend, uint64_t Hash)
+{
+    Hash = Utility::HashState(&Blend.AlphaToCoverageEnable, 1, Hash);
+    Hash = Utility::HashState(&Blend.IndependentBlendEnable, 1, Hash);
+    for (const D3D12_RENDER_TARGET_BLEND_DESC& Target : Blend.RenderTarget)
+    {
+        Hash = Utility::HashState(&Target.BlendEnable, 1, Hash);
+        Hash = Utility::HashState(&Target.LogicOpEnable, 1, Hash);
+        Hash = Utility::HashState(&Target.SrcBlend, 1, Hash);
+        Hash = Utility::HashState(&Target.DestBlend, 1, Hash);
+        Hash = Utility::HashState(&Target.BlendOp, 1, Hash);
+        Hash = Utility::HashState(&Target.SrcBlendAlpha, 1, Hash);
+        Hash = Utility::HashState(&Target.DestBlendAlpha, 1, Hash);
+        Hash = Utility::HashState(&Target.BlendOpAlpha, 1, Hash);
+        Hash = Utility::HashState(&Target.LogicOp, 1, Hash);
+        Hash = Utility::HashState(&Target.RenderTargetWriteMask, 1, Hash);
+    }
+    return Hash;
+}
+
+static uint64_t HashDepthStencilState(const D3D12_DEPTH_STENCIL_DESC& DepthStencil, uint64_t Hash)
+{
+    Hash = Utility::HashState(&DepthStencil.DepthEnable, 1, Hash);
+    Hash = Utility::HashState(&DepthStencil.DepthWriteMask, 1, Hash);
+    Hash = Utility::HashState(&DepthStencil.DepthFunc, 1, Hash);
+    Hash = Utility::HashState(&DepthStencil.StencilEnable, 1, Hash);
+    Hash = Utility::HashState(&DepthStencil.StencilReadMask, 1, Hash);
+    Hash = Utility::HashState(&DepthStencil.StencilWriteMask, 1, Hash);
+    for (const D3D12_DEPTH_STENCILOP_DESC* Face : { &DepthStencil.FrontFace, &DepthStencil.BackFace })
+        Hash = Utility::HashState(Face, 1, Hash);   // four enums, no padding
+    return Hash;
+}
+
+static uint64_t HashInputElement(const D3D12_INPUT_ELEMENT_DESC& Element, uint64_t Hash)
+{
+    Hash = Utility::HashString(Element.SemanticName, Hash);
+    Hash = Utility::HashState(&Element.SemanticIndex, 1, Hash);
+    Hash = Utility::HashState(&Element.Format, 1, Hash);
+    Hash = Utility::HashState(&Element.InputSlot, 1, Hash);
+    Hash = Utility::HashState(&Element.AlignedByteOffset, 1, Hash);
+    Hash = Utility::HashState(&Element.InputSlotClass, 1, Hash);
+    return Utility::HashState(&Element.InstanceDataStepRate, 1, Hash);
+}
+
+static uint64_t HashStreamOutputEntry(const D3D12_SO_DECLARATION_ENTRY& Entry, uint64_t Hash)
+{
+    Hash = Utility::HashState(&Entry.Stream, 1, Hash);
+    Hash = Utility::HashString(Entry.SemanticName, Hash);
+    Hash = Utility::HashState(&Entry.SemanticIndex, 1, Hash);
+    Hash = Utility::HashState(&Entry.StartComponent, 1, Hash);
+    Hash = Utility::HashState(&Entry.ComponentCount, 1, Hash);
+    return Utility::HashState(&Entry.OutputSlot, 1, Hash);
+}
+
+static void StoreCachedBlob(uint64_t HashCode, ID3D12PipelineState* PipelineState)
+{
+    ComPtr<ID3DBlob> blob;
+    if (SUCCEEDED(PipelineState->GetCachedBlob(&blob)))
+        s_PipelineCache->Store(HashCode, blob->GetBufferPointer(), blob->GetBufferSize());
+}
+
+// Creates the pipeline from the on-disk cache blob when there is one. A blob rejected by the driver
+// (new driver or adapter) is dropped and the pipeline is compiled from scratch.
+template<typename DescType, typename CreateFunc>
+static ComPtr<ID3D12PipelineState> CreatePipelineState(const DescType& Desc, uint64_t HashCode, CreateFunc Create)
+{
+    ComPtr<ID3D12PipelineState> PipelineState;
+    if (s_PipelineCache && s_PipelineCache->CreateFromBlob(HashCode, [&](const void* Blob, size_t Size) {
+            DescType CachedDesc = Desc;
+            CachedDesc.CachedPSO.pCachedBlob = Blob;
+            CachedDesc.CachedPSO.CachedBlobSizeInBytes = Size;
+            return SUCCEEDED(Create(&CachedDesc, PipelineState));
+        }))
+        return PipelineState;
+
+    ThrowIfFailed(Create(&Desc, PipelineState));
+
+    if (s_PipelineCache)
+        StoreCachedBlob(HashCode, PipelineState.Get());
+    return PipelineState;
 }
 
 GraphicsPSO::GraphicsPSO()
@@ -109,39 +212,60 @@ void GraphicsPSO::Finalize(ID3D12Device* device)
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
     assert(m_PSODesc.pRootSignature != nullptr);
 
-    m_PSODesc.InputLayout.pInputElementDescs = nullptr;
-    //  size_t HashCode = Utility::HashState(&m_PSODesc);
-     // HashCode = Utility::HashState(m_InputLayouts.get(), m_PSODesc.InputLayout.NumElements, HashCode);
     m_PSODesc.InputLayout.pInputElementDescs = m_InputLayouts.get();
+    m_Hash = ComputeHash();
 
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = true;
-    //{
-    //    static mutex s_HashMapMutex;
-    //    lock_guard<mutex> CS(s_HashMapMutex);
-    //    auto iter = s_GraphicsPSOHashMap.find(HashCode);
-
-    //    // Reserve space so the next inquiry will find that someone got here first.
-    //    if (iter == s_GraphicsPSOHashMap.end())
-    //    {
-    //        firstCompile = true;
-    //        PSORef = s_GraphicsPSOHashMap[HashCode].GetAddressOf();
-    //    }
-    //    else
-    //        PSORef = iter->second.GetAddressOf();
-    //}
-
-    if (firstCompile)
-    {
-        ThrowIfFailed(device->CreateGraphicsPipelineState(&m_PSODesc, IID_PPV_ARGS(&m_PSO)));
-        // s_GraphicsPSOHashMap[HashCode].Attach(m_PSO);
-    }
-    //else
-    //{
-    //    while (*PSORef == nullptr)
-    //        this_thread::yield();
-    //    m_PSO = *PSORef;
-    //}
+    // The first Finalize of a hash creates the pipeline, the others wait for it (or for its exception)
+    m_PSO = s_GraphicsPSOHashMap.GetOrCreate(m_Hash, [this, device]() {
+        return CreatePipelineState(m_PSODesc, m_Hash, [device](const D3D12_GRAPHICS_PIPELINE_STATE_DESC* Desc, ComPtr<ID3D12PipelineState>& PipelineState) {
+            return device->CreateGraphicsPipelineState(Desc, IID_PPV_ARGS(&PipelineState));
+        });
+    });
+}
+
+uint64_t GraphicsPSO::ComputeHash() const
+{
+    // Pointer members are cleared here and the data they reference is hashed by content instead,
+    // so the hash stays stable between runs (needed for the on-disk cache). The members with padding
+    // are cleared too and hashed field by field.
+    D3D12_GRAPHICS_PIPELINE_STATE_DESC Desc;
+    memcpy(&Desc, &m_PSODesc, sizeof(Desc));
+    Desc.pRootSignature = nullptr;
+    Desc.VS.pShaderBytecode = nullptr;
+    Desc.PS.pShaderBytecode = nullptr;
+    Desc.DS.pShaderBytecode = nullptr;
+    Desc.HS.pShaderBytecode = nullptr;
+    Desc.GS.pShaderBytecode = nullptr;
+    ZeroMemory(&Desc.StreamOutput, sizeof(Desc.StreamOutput));
+    ZeroMemory(&Desc.BlendState, sizeof(Desc.BlendState));
+    ZeroMemory(&Desc.DepthStencilState, sizeof(Desc.DepthStencilState));
+    ZeroMemory(&Desc.InputLayout, sizeof(Desc.InputLayout));
+    Desc.CachedPSO.pCachedBlob = nullptr;
+    Desc.CachedPSO.CachedBlobSizeInBytes = 0;
+
+    const uint64_t RootSignatureHash = m_RootSignature->GetHash();
+    uint64_t HashCode = Utility::HashState(&Desc);
+    HashCode = HashBlendState(m_PSODesc.BlendState, HashCode);
+    HashCode = HashDepthStencilState(m_PSODesc.DepthStencilState, HashCode);
+    HashCode = Utility::HashState(&RootSignatureHash, 1, HashCode);
+    HashCode = HashBytecode(m_PSODesc.VS, HashCode);
+    HashCode = HashBytecode(m_PSODesc.PS, HashCode);
+    HashCode = HashBytecode(m_PSODesc.DS, HashCode);
+    HashCode = HashBytecode(m_PSODesc.HS, HashCode);
+    HashCode = HashBytecode(m_PSODesc.GS, HashCode);
+
+    HashCode = Utility::HashState(&m_PSODesc.InputLayout.NumElements, 1, HashCode);
+    for (UINT i = 0; i < m_PSODesc.InputLayout.NumElements; ++i)
+        HashCode = HashInputElement(m_InputLayouts.get()[i], HashCode);
+
+    HashCode = Utility::HashState(&m_PSODesc.StreamOutput.NumEntries, 1, HashCode);
+    for (UINT i = 0; i < m_PSODesc.StreamOutput.NumEntries; ++i)
+        HashCode = HashStreamOutputEntry(m_PSODesc.StreamOutput.pSODeclaration[i], HashCode);
+    HashCode = Utility::HashState(&m_PSODesc.StreamOutput.NumStrides, 1, HashCode);
+    HashCode = Utility::HashState(m_PSODesc.StreamOutput.pBufferStrides, m_PSODesc.StreamOutput.NumStrides, HashCode);
+    HashCode = Utility::HashState(&m_PSODesc.StreamOutput.RasterizedStream, 1, HashCode);
+
+    return HashCode;
 }
 
 void ComputePSO::Finalize(ID3D12Device* device)
@@ -150,36 +274,29 @@ void ComputePSO::Finalize(ID3D12Device* device)
     m_PSODesc.pRootSignature = m_RootSignature->GetSignature();
     assert(m_PSODesc.pRootSignature != nullptr);
 
-    //size_t HashCode = Utility::HashState(&m_PSODesc);
-
-    ID3D12PipelineState** PSORef = nullptr;
-    bool firstCompile = true;
-    //{
-    //    static mutex s_HashMapMutex;
-    //    lock_guard<mutex> CS(s_HashMapMutex);
-    //    auto iter = s_ComputePSOHashMap.find(HashCode);
-
-    //    // Reserve space so the next inquiry will find that someone got here first.
-    //    if (iter == s_ComputePSOHashMap.end())
-    //    {
-    //        firstCompile = true;
-    //        PSORef = s_ComputePSOHashMap[HashCode].GetAddressOf();
-    //    }
-    //    else
-    //        PSORef = iter->second.GetAddressOf();
-    //}
-
-    if (firstCompile)
-    {
-        ThrowIfFailed(device->CreateComputePipelineState(&m_PSODesc, IID_PPV_ARGS(&m_PSO)));
-        //   s_ComputePSOHashMap[HashCode].Attach(m_PSO);
-    }
-    //else
-    //{
-    //    while (*PSORef == nullptr)
-    //        this_thread::yield();
-    //    m_PSO = *PSORef;
-    //}
+    m_Hash = ComputeHash();
+
+    // The first Finalize of a hash creates the pipeline, the others wait for it (or for its exception)
+    m_PSO = s_ComputePSOHashMap.GetOrCreate(m_Hash, [this, device]() {
+        return CreatePipelineState(m_PSODesc, m_Hash, [device](const D3D12_COMPUTE_PIPELINE_STATE_DESC* Desc, ComPtr<ID3D12PipelineState>& PipelineState) {
+            return device->CreateComputePipelineState(Desc, IID_PPV_ARGS(&PipelineState));
+        });
+    });
+}
+
+uint64_t ComputePSO::ComputeHash() const
+{
+    D3D12_COMPUTE_PIPELINE_STATE_DESC Desc;
+    memcpy(&Desc, &m_PSODesc, sizeof(Desc));
+    Desc.pRootSignature = nullptr;
+    Desc.CS.pShaderBytecode = nullptr;
+    Desc.CachedPSO.pCachedBlob = nullptr;
+    Desc.CachedPSO.CachedBlobSizeInBytes = 0;
+
+    const uint64_t RootSignatureHash = m_RootSignature->GetHash();
+    uint64_t HashCode = Utility::HashState(&Desc);
+    HashCode = Utility::HashState(&RootSignatureHash, 1, HashCode);
+    return HashBytecode(m_PSODesc.CS, HashCode);
 }
 
 ComputePSO::ComputePSO()
@@ -15,14 +15,23 @@
 #include "Common.h"
 #include "RootSignature.h"
 
+class PipelineStateCache;
+
 class PSO
 {
 public:
 
-    PSO() : m_RootSignature(nullptr) {}
+    PSO() : m_RootSignature(nullptr), m_Hash(0) {}
 
     static void DestroyAll(void);
 
+    // Drops the hash map's reference to the pipeline of Hash once no PSO uses it anymore, e.g. after a rebuild
+    // replaced it. PSOs holding it keep it alive.
+    static void Evict(uint64_t Hash);
+
+    // Optional on-disk cache of driver blobs used by Finalize(), pass nullptr to disable
+    static void SetPipelineCache(PipelineStateCache* cache);
+
     void SetRootSignature(const RootSignature& rootSignature)
     {
         m_RootSignature = &rootSignature;
@@ -36,9 +45,13 @@ public:
 
     ID3D12PipelineState* GetPipelineStateObject(void) const { return m_PSO.Get(); }
 
+    // Hash of the full description (states, input layout, shader bytecode, root signature), valid after Finalize()
+    uint64_t GetHash() const { return m_Hash; }
+
 protected:
 
     const RootSignature* m_RootSignature;
+    uint64_t m_Hash;
 
     ComPtr<ID3D12PipelineState> m_PSO;
 };
@@ -80,6 +93,8 @@ public:
 
 private:
 
+    uint64_t ComputeHash() const;
+
     D3D12_GRAPHICS_PIPELINE_STATE_DESC m_PSODesc;
     std::shared_ptr<const D3D12_INPUT_ELEMENT_DESC> m_InputLayouts;
 };
@@ -99,5 +114,7 @@ public:
 
 private:
 
+    uint64_t ComputeHash() const;
+
     D3D12_COMPUTE_PIPELINE_STATE_DESC m_PSODesc;
 };
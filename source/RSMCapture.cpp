@@ -0,0 +1,98 @@
+#include "RSMCapture.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	const char MAGIC[4] = { 'R', 'S', 'M', 'C' };
+
+	bool Write(FILE* file, const void* data, size_t size)
+	{
+		return size == 0 || std::fwrite(data, 1, size, file) == size;
+	}
+
+	bool Read(FILE* file, void* data, size_t size)
+	{
+		return size == 0 || std::fread(data, 1, size, file) == size;
+	}
+}
+
+bool RSMCapture::Save(const std::string& path, std::string& error) const
+{
+	const size_t rsmFloats = size_t(mRSMSize) * mRSMSize * 4;
+	const size_t gbufferFloats = size_t(mWidth) * mHeight * 4;
+	if (mRSMPositions.size() != rsmFloats || mRSMNormals.size() != rsmFloats || mRSMFlux.size() != rsmFloats ||
+		mPositions.size() != gbufferFloats || mNormals.size() != gbufferFloats)
+	{
+		error = "capture buffers do not match their sizes";
+		return false;
+	}
+
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		error = "cannot open " + path + " for writing";
+		return false;
+	}
+	const uint32_t header[4] = { VERSION, mRSMSize, mWidth, mHeight };
+	bool written = Write(file, MAGIC, sizeof(MAGIC)) && Write(file, header, sizeof(header)) &&
+		Write(file, mShadowViewProjection, sizeof(mShadowViewProjection)) && Write(file, &mRMax, sizeof(mRMax)) &&
+		Write(file, mRSMPositions.data(), rsmFloats * sizeof(float)) && Write(file, mRSMNormals.data(), rsmFloats * sizeof(float)) &&
+		Write(file, mRSMFlux.data(), rsmFloats * sizeof(float)) &&
+		Write(file, mPositions.data(), gbufferFloats * sizeof(float)) && Write(file, mNormals.data(), gbufferFloats * sizeof(float));
+	written = (std::fclose(file) == 0) && written;
+	if (!written)
+		error = "cannot write " + path;
+	return written;
+}
+
+bool RSMCapture::Load(const std::string& path, std::string& error)
+{
+	FILE* file = std::fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		error = "cannot open " + path;
+		return false;
+	}
+
+	char magic[4] = {};
+	uint32_t header[4] = {};
+	bool read = Read(file, magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0 && Read(file, header, sizeof(header));
+	if (!read || header[0] != VERSION || header[1] == 0 || header[1] > 16384 || header[2] > 16384 || header[3] > 16384)
+	{
+		std::fclose(file);
+		error = path + " is not an RSM capture of version " + std::to_string(VERSION);
+		return false;
+	}
+
+	mRSMSize = header[1];
+	mWidth = header[2];
+	mHeight = header[3];
+	const size_t rsmFloats = size_t(mRSMSize) * mRSMSize * 4;
+	const size_t gbufferFloats = size_t(mWidth) * mHeight * 4;
+	mRSMPositions.resize(rsmFloats);
+	mRSMNormals.resize(rsmFloats);
+	mRSMFlux.resize(rsmFloats);
+	mPositions.resize(gbufferFloats);
+	mNormals.resize(gbufferFloats);
+	read = Read(file, mShadowViewProjection, sizeof(mShadowViewProjection)) && Read(file, &mRMax, sizeof(mRMax)) &&
+		Read(file, mRSMPositions.data(), rsmFloats * sizeof(float)) && Read(file, mRSMNormals.data(), rsmFloats * sizeof(float)) &&
+		Read(file, mRSMFlux.data(), rsmFloats * sizeof(float)) &&
+		Read(file, mPositions.data(), gbufferFloats * sizeof(float)) && Read(file, mNormals.data(), gbufferFloats * sizeof(float));
+	std::fclose(file);
+	if (!read)
+		error = path + " is truncated";
+	return read;
+}
+
+void RSMCapture::Project(const float position[3], float uv[2]) const
+{
+	const float* m = mShadowViewProjection;
+	float clip[4];
+	for (int i = 0; i < 4; i++)
+		clip[i] = position[0] * m[i] + position[1] * m[4 + i] + position[2] * m[8 + i] + m[12 + i];
+	float w = clip[3] != 0.0f ? clip[3] : 1.0f;
+	uv[0] = clip[0] / w * 0.5f + 0.5f;
+	uv[1] = clip[1] / w * -0.5f + 0.5f;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// RSM and G-buffer of one frame as float4 texels, written by the scene ("Capture RSM" in the RSM settings) or without
+// a GPU by tools/RSMSceneCapture, and read by tools/RSMLightcutsBench, so the gather can be measured on real data. The file is little endian:
+// "RSMC", version, RSM size, G-buffer width and height, the shadow view projection (row major, applied to row
+// vectors as in DirectXMath), RMax, then RSM positions, normals and flux and G-buffer positions and normals.
+// Only uses the standard library.
+class RSMCapture
+{
+public:
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t mRSMSize = 0;
+    std::vector<float> mRSMPositions;
+    std::vector<float> mRSMNormals;
+    std::vector<float> mRSMFlux;
+
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+    std::vector<float> mPositions;
+    std::vector<float> mNormals;
+
+    float mShadowViewProjection[16] = {};
+    float mRMax = 0.0f;
+
+    bool Save(const std::string& path, std::string& error) const;
+    bool Load(const std::string& path, std::string& error);
+    // RSM uv of a world position, as ReflectiveShadowMappingCS.hlsl projects receivers
+    void Project(const float position[3], float uv[2]) const;
+};
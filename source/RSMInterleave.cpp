@@ -0,0 +1,200 @@
+#include "RSMInterleave.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void Transform(const float m[16], const float position[3], float clip[4])
+	{
+		for (int i = 0; i < 4; i++)
+			clip[i] = position[0] * m[i] + position[1] * m[4 + i] + position[2] * m[8 + i] + m[12 + i];
+	}
+
+	bool HasGeometry(const float normal[3])
+	{
+		return normal[0] != 0.0f || normal[1] != 0.0f || normal[2] != 0.0f;
+	}
+}
+
+uint32_t RSMInterleave::GetSubset(uint32_t x, uint32_t y, uint32_t tileSize, uint32_t frame)
+{
+	tileSize = std::max(tileSize, 1u);
+	return ((y % tileSize) * tileSize + x % tileSize + frame) % (tileSize * tileSize);
+}
+
+void RSMInterleave::GetSampleRange(uint32_t subset, uint32_t tileSize, uint32_t sampleCount, uint32_t& first, uint32_t& count)
+{
+	tileSize = std::max(tileSize, 1u);
+	count = sampleCount / (tileSize * tileSize);
+	first = subset * count;
+}
+
+float RSMInterleave::GetDepth(const float viewProjection[16], const float position[3])
+{
+	float clip[4];
+	Transform(viewProjection, position, clip);
+	return clip[3];
+}
+
+bool RSMInterleave::Project(const float viewProjection[16], const float position[3], uint32_t width, uint32_t height, uint32_t& x, uint32_t& y, float& depth)
+{
+	float clip[4];
+	Transform(viewProjection, position, clip);
+	depth = clip[3];
+	if (depth <= 0.0f)
+		return false;
+
+	float u = clip[0] / depth * 0.5f + 0.5f;
+	float v = clip[1] / depth * -0.5f + 0.5f;
+	if (u < 0.0f || u >= 1.0f || v < 0.0f || v >= 1.0f)
+		return false;
+	x = std::min(uint32_t(u * float(width)), width - 1);
+	y = std::min(uint32_t(v * float(height)), height - 1);
+	return true;
+}
+
+bool RSMInterleave::Unproject(const float viewProjection[16], const float inverseViewProjection[16], uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+	float depth, float position[3])
+{
+	if (depth <= 0.0f)
+		return false;
+
+	// the points of the ray on the near and far planes; clip w is affine along it
+	const float ndc[2] = { (float(x) + 0.5f) / float(width) * 2.0f - 1.0f, 1.0f - (float(y) + 0.5f) / float(height) * 2.0f };
+	float points[2][3];
+	float depths[2];
+	for (int i = 0; i < 2; i++)
+	{
+		const float clip[3] = { ndc[0], ndc[1], float(i) };
+		float world[4];
+		Transform(inverseViewProjection, clip, world);
+		if (world[3] == 0.0f)
+			return false;
+		for (int c = 0; c < 3; c++)
+			points[i][c] = world[c] / world[3];
+		depths[i] = GetDepth(viewProjection, points[i]);
+	}
+	if (depths[1] == depths[0])
+		return false;
+	float t = (depth - depths[0]) / (depths[1] - depths[0]);
+	for (int c = 0; c < 3; c++)
+		position[c] = points[0][c] + (points[1][c] - points[0][c]) * t;
+	return true;
+}
+
+bool RSMInterleave::IsHistoryValid(const float position[3], const float normal[3], float depth, const float historyPosition[3])
+{
+	const float offset[3] = { historyPosition[0] - position[0], historyPosition[1] - position[1], historyPosition[2] - position[2] };
+	return std::fabs(Dot(normal, offset)) <= PLANE_TOLERANCE * depth;
+}
+
+bool RSMInterleave::SampleHistory(const Frame& frame, const float* history, const float position[3], const float normal[3], float result[3])
+{
+	float clip[4];
+	Transform(frame.mPreviousViewProjection, position, clip);
+	if (clip[3] <= 0.0f)
+		return false;
+
+	const float x = (clip[0] / clip[3] * 0.5f + 0.5f) * float(frame.mWidth) - 0.5f;
+	const float y = (clip[1] / clip[3] * -0.5f + 0.5f) * float(frame.mHeight) - 0.5f;
+	const int x0 = int(std::floor(x));
+	const int y0 = int(std::floor(y));
+	const float fractions[2] = { x - float(x0), y - float(y0) };
+	float sum[3] = { 0.0f, 0.0f, 0.0f };
+	float weightSum = 0.0f;
+	for (int tap = 0; tap < 4; tap++)
+	{
+		const int tapX = x0 + (tap & 1);
+		const int tapY = y0 + (tap >> 1);
+		const float weight = ((tap & 1) ? fractions[0] : 1.0f - fractions[0]) * ((tap >> 1) ? fractions[1] : 1.0f - fractions[1]);
+		if (weight <= 0.0f || tapX < 0 || tapY < 0 || tapX >= int(frame.mWidth) || tapY >= int(frame.mHeight))
+			continue;
+
+		const float* texel = history + (size_t(tapY) * frame.mWidth + tapX) * 4;
+		float historyPosition[3];
+		if (!Unproject(frame.mPreviousViewProjection, frame.mPreviousInverseViewProjection, uint32_t(tapX), uint32_t(tapY), frame.mWidth, frame.mHeight,
+			texel[3], historyPosition) || !IsHistoryValid(position, normal, clip[3], historyPosition))
+			continue;
+		for (int c = 0; c < 3; c++)
+			sum[c] += weight * texel[c];
+		weightSum += weight;
+	}
+	if (weightSum <= 0.0f)
+		return false;
+	for (int c = 0; c < 3; c++)
+		result[c] = sum[c] / weightSum;
+	return true;
+}
+
+float RSMInterleave::GetGeometryWeight(const float position[3], const float normal[3], float depth, const float otherPosition[3], const float otherNormal[3])
+{
+	if (!HasGeometry(otherNormal))
+		return 0.0f;
+	const float offset[3] = { otherPosition[0] - position[0], otherPosition[1] - position[1], otherPosition[2] - position[2] };
+	if (std::fabs(Dot(normal, offset)) > PLANE_TOLERANCE * depth)
+		return 0.0f;
+	return std::pow(std::max(Dot(normal, otherNormal), 0.0f), NORMAL_POWER);
+}
+
+void RSMInterleave::Resolve(const Frame& frame, const ResolveSettings& settings, const float* interleaved, const float* history, float* newHistory, float* output)
+{
+	const uint32_t tileSize = std::max(settings.mTileSize, 1u);
+	const bool useHistory = settings.mTemporal && settings.mHistoryValid && history;
+	for (uint32_t y = 0; y < frame.mHeight; y++)
+	{
+		for (uint32_t x = 0; x < frame.mWidth; x++)
+		{
+			const size_t index = (size_t(y) * frame.mWidth + x) * 4;
+			const float* position = frame.mPositions + index;
+			const float* normal = frame.mNormals + index;
+			float value[3] = { 0.0f, 0.0f, 0.0f };
+			float depth = 0.0f;
+			if (HasGeometry(normal))
+			{
+				depth = GetDepth(frame.mViewProjection, position);
+
+				// the window is kept inside the target so that it still holds every subset
+				int startX = std::max(std::min(int(x) - int(tileSize - 1) / 2, int(frame.mWidth) - int(tileSize)), 0);
+				int startY = std::max(std::min(int(y) - int(tileSize - 1) / 2, int(frame.mHeight) - int(tileSize)), 0);
+				int endX = std::min(startX + int(tileSize), int(frame.mWidth));
+				int endY = std::min(startY + int(tileSize), int(frame.mHeight));
+				float weightSum = 0.0f;
+				for (int ny = startY; ny < endY; ny++)
+				{
+					for (int nx = startX; nx < endX; nx++)
+					{
+						const size_t other = (size_t(ny) * frame.mWidth + nx) * 4;
+						float weight = (uint32_t(nx) == x && uint32_t(ny) == y) ? 1.0f :
+							GetGeometryWeight(position, normal, depth, frame.mPositions + other, frame.mNormals + other);
+						for (int c = 0; c < 3; c++)
+							value[c] += weight * interleaved[other + c];
+						weightSum += weight;
+					}
+				}
+				for (int c = 0; c < 3; c++)
+					value[c] /= weightSum;
+
+				float previous[3];
+				if (useHistory && SampleHistory(frame, history, position, normal, previous))
+				{
+					for (int c = 0; c < 3; c++)
+						value[c] = previous[c] + (value[c] - previous[c]) * settings.mHistoryWeight;
+				}
+			}
+
+			for (int c = 0; c < 3; c++)
+			{
+				newHistory[index + c] = value[c];
+				output[index + c] = value[c];
+			}
+			newHistory[index + 3] = depth;
+			output[index + 3] = 1.0f;
+		}
+	}
+}
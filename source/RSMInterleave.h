@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+// Interleaved sampling (Keller and Heidrich 2001) and temporal accumulation for the RSM pass. The pixels of every
+// tileSize x tileSize tile take disjoint subsets of the RSM samples, each an aligned contiguous block of the scrambled
+// Sobol set, which keeps every subset stratified (a (0,m,2)-net) where a strided subset would not be. The pass then
+// takes sampleCount / tileSize^2 samples per pixel (ReflectiveShadowMappingCS.hlsl) and the resolve
+// (RSMTemporalCS.hlsl) puts the full set back together:
+//   de-interleave  per pixel the tileSize x tileSize window around it, which holds every subset once, weighted by
+//                  normal similarity and the distance to the pixel's tangent plane so the gather does not cross edges
+//   temporal       the position reprojected with the previous view projection reads the history bilinearly from the
+//                  texels whose stored position lies on the pixel's tangent plane, blended in with historyWeight; new
+//                  subsets every frame cycle a pixel through all of them over tileSize^2 frames
+// The history is float4: the accumulated light and the linear depth (clip w) it belongs to, 0 where there is no
+// geometry; a texel's position is rebuilt from its depth. A depth comparison alone would keep the history of the
+// floor for a box standing on it, the plane test does not, and nearest texels would smear edges while the camera
+// moves. Matrices are row major and applied to row vectors, as DirectXMath and the shaders' mul(M, v) of the
+// uploaded matrices. This is the reference for the shaders (tools/RSMInterleaveBench).
+// Only uses the standard library.
+class RSMInterleave
+{
+public:
+    static constexpr uint32_t MAX_TILE_SIZE = 4;
+    static constexpr float NORMAL_POWER = 8.0f;
+    static constexpr float PLANE_TOLERANCE = 0.005f;  // distance to the tangent plane, relative to the depth
+    static constexpr float DEFAULT_HISTORY_WEIGHT = 0.1f;
+
+    // G-buffer at the resolution of the pass as float4 texels; zero normals have no geometry
+    struct Frame
+    {
+        const float* mPositions = nullptr;
+        const float* mNormals = nullptr;
+        uint32_t mWidth = 0;
+        uint32_t mHeight = 0;
+        const float* mViewProjection = nullptr;
+        const float* mPreviousViewProjection = nullptr;
+        const float* mPreviousInverseViewProjection = nullptr;
+    };
+
+    struct ResolveSettings
+    {
+        uint32_t mTileSize = 1;
+        bool mTemporal = false;
+        bool mHistoryValid = false;   // false on the first frame and after a camera cut or resize
+        float mHistoryWeight = DEFAULT_HISTORY_WEIGHT;
+    };
+
+    // Subset of a pixel, unique within its tile; frame moves every pixel on to the next subset
+    static uint32_t GetSubset(uint32_t x, uint32_t y, uint32_t tileSize, uint32_t frame);
+    // Samples [first, first + count) of subset; sampleCount should be a multiple of tileSize^2, the remainder is dropped
+    static void GetSampleRange(uint32_t subset, uint32_t tileSize, uint32_t sampleCount, uint32_t& first, uint32_t& count);
+
+    // Clip w, the linear depth
+    static float GetDepth(const float viewProjection[16], const float position[3]);
+    // Pixel of a position in a width x height target, false behind the camera or off screen
+    static bool Project(const float viewProjection[16], const float position[3], uint32_t width, uint32_t height, uint32_t& x, uint32_t& y, float& depth);
+    // Position at depth on the ray through the center of pixel x, y; false without geometry (depth 0)
+    static bool Unproject(const float viewProjection[16], const float inverseViewProjection[16], uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+        float depth, float position[3]);
+    // Whether the history at historyPosition belongs to the surface of the pixel at position
+    static bool IsHistoryValid(const float position[3], const float normal[3], float depth, const float historyPosition[3]);
+    // Bilinear history of the texels around the reprojected position that pass IsHistoryValid, false if none does
+    static bool SampleHistory(const Frame& frame, const float* history, const float position[3], const float normal[3], float result[3]);
+    // Weight of a neighbour in the de-interleave, 1 for the pixel itself
+    static float GetGeometryWeight(const float position[3], const float normal[3], float depth, const float otherPosition[3], const float otherNormal[3]);
+
+    // RSMTemporalCS.hlsl for every pixel: interleaved is the pass output (rgba), history and newHistory as above (history
+    // is only read when temporal and valid), output the resolved light (rgba, alpha 1)
+    static void Resolve(const Frame& frame, const ResolveSettings& settings, const float* interleaved, const float* history, float* newHistory, float* output);
+};
@@ -0,0 +1,446 @@
+#include "RSMLightTree.h"
+#include "CpuProfiler.h"
+#include "Sampling.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const float PI = 3.14159265358979f;
+
+	float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Disc weight without the cut at rMax
+	float RadialWeight(float rho, float rMax, uint32_t rsmSize)
+	{
+		return float(RSMLightTree::MAX_SAMPLES_COUNT) * rho / (2.0f * PI * rMax * rMax * rMax * float(rsmSize) * float(rsmSize));
+	}
+
+	float SafeAcos(float value)
+	{
+		return std::acos(std::min(std::max(value, -1.0f), 1.0f));
+	}
+
+	// As in the RSM pass: flux leaving the VPL towards the receiver and arriving at it, over distance^4
+	float Transfer(const float vplPosition[3], const float vplNormal[3], const RSMLightTree::Receiver& receiver)
+	{
+		float direction[3];
+		for (int i = 0; i < 3; i++)
+			direction[i] = receiver.mPosition[i] - vplPosition[i];
+		float distanceSquared = Dot(direction, direction);
+		if (!(distanceSquared > 0.0f))
+			return 0.0f;
+		return std::max(Dot(vplNormal, direction), 0.0f) * std::max(-Dot(receiver.mNormal, direction), 0.0f) / (distanceSquared * distanceSquared);
+	}
+
+	// Node coordinates in the cut, as the shader packs them
+	uint32_t Pack(uint32_t level, uint32_t x, uint32_t y)
+	{
+		return (level << 28) | (y << 14) | x;
+	}
+
+	void Unpack(uint32_t packed, uint32_t& level, uint32_t& x, uint32_t& y)
+	{
+		level = packed >> 28;
+		y = (packed >> 14) & 0x3FFF;
+		x = packed & 0x3FFF;
+	}
+
+	// Distance in RSM uv from a point to the square of a node
+	float MinDistance(uint32_t level, uint32_t x, uint32_t y, const float uv[2])
+	{
+		float size = 1.0f / float(1u << level);
+		float dx = std::max(std::max(float(x) * size - uv[0], uv[0] - float(x + 1) * size), 0.0f);
+		float dy = std::max(std::max(float(y) * size - uv[1], uv[1] - float(y + 1) * size), 0.0f);
+		return std::sqrt(dx * dx + dy * dy);
+	}
+
+	float MaxDistance(uint32_t level, uint32_t x, uint32_t y, const float uv[2])
+	{
+		float size = 1.0f / float(1u << level);
+		float dx = std::max(std::fabs(float(x) * size - uv[0]), std::fabs(float(x + 1) * size - uv[0]));
+		float dy = std::max(std::fabs(float(y) * size - uv[1]), std::fabs(float(y + 1) * size - uv[1]));
+		return std::sqrt(dx * dx + dy * dy);
+	}
+
+	// Largest cosine between axis and a vector of the box [lo, hi], widened by a cone around axis, 0 if negative.
+	// The box is bounded in a frame around axis first, as lightcuts does.
+	float CosineBound(const float lo[3], const float hi[3], const float axis[3], float coneAngle)
+	{
+		// orthonormal basis (Duff et al. 2017)
+		float sign = std::copysign(1.0f, axis[2]);
+		float a = -1.0f / (sign + axis[2]);
+		float b = axis[0] * axis[1] * a;
+		const float tangent[3] = { 1.0f + sign * axis[0] * axis[0] * a, sign * b, -sign * axis[0] };
+		const float bitangent[3] = { b, sign + axis[1] * axis[1] * a, -axis[1] };
+
+		float minimum[3] = { 1e30f, 1e30f, 1e30f };
+		float maximum[3] = { -1e30f, -1e30f, -1e30f };
+		for (int corner = 0; corner < 8; corner++)
+		{
+			const float v[3] = { corner & 1 ? hi[0] : lo[0], corner & 2 ? hi[1] : lo[1], corner & 4 ? hi[2] : lo[2] };
+			const float local[3] = { Dot(v, tangent), Dot(v, bitangent), Dot(v, axis) };
+			for (int i = 0; i < 3; i++)
+			{
+				minimum[i] = std::min(minimum[i], local[i]);
+				maximum[i] = std::max(maximum[i], local[i]);
+			}
+		}
+
+		// the largest cosine has the largest z and, for z > 0, the smallest distance to the axis, else the largest
+		float radiusSquared = 0.0f;
+		for (int i = 0; i < 2; i++)
+		{
+			float nearest = std::max(std::max(minimum[i], -maximum[i]), 0.0f);
+			float farthest = std::max(-minimum[i], maximum[i]);
+			float r = maximum[2] > 0.0f ? nearest : farthest;
+			radiusSquared += r * r;
+		}
+		float length = std::sqrt(maximum[2] * maximum[2] + radiusSquared);
+		float cosine = length > 0.0f ? maximum[2] / length : 1.0f;
+		if (coneAngle <= 0.0f)
+			return std::max(cosine, 0.0f);
+		float angle = SafeAcos(cosine) - coneAngle;
+		return angle <= 0.0f ? 1.0f : std::max(std::cos(angle), 0.0f);
+	}
+
+	// Node of the cut with its error bound
+	struct CutEntry
+	{
+		float mBound;
+		uint32_t mNode;
+
+		bool operator<(const CutEntry& other) const { return mBound < other.mBound; }
+	};
+
+	// Accumulates flux weighted members into a node; Finish turns the sums into means and bounds the normals
+	struct NodeBuilder
+	{
+		RSMLightTree::Node mNode = {};
+		float mWeight = 0.0f;
+
+		NodeBuilder()
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				mNode.mBoundsMin[i] = 1e30f;
+				mNode.mBoundsMax[i] = -1e30f;
+			}
+		}
+
+		void Add(const float flux[3], const float position[3], const float normal[3], float u, float v, const float boundsMin[3], const float boundsMax[3])
+		{
+			float weight = RSMLightTree::GetLuminance(flux);
+			if (!(weight > 0.0f))
+				return;
+			mWeight += weight;
+			for (int i = 0; i < 3; i++)
+			{
+				mNode.mFlux[i] += flux[i];
+				mNode.mPosition[i] += weight * position[i];
+				mNode.mNormal[i] += weight * normal[i];
+				mNode.mBoundsMin[i] = std::min(mNode.mBoundsMin[i], boundsMin[i]);
+				mNode.mBoundsMax[i] = std::max(mNode.mBoundsMax[i], boundsMax[i]);
+			}
+			mNode.mU += weight * u;
+			mNode.mV += weight * v;
+		}
+
+		void Finish()
+		{
+			mNode.mConeCos = -1.0f;
+			if (!(mWeight > 0.0f))
+				return;
+			for (int i = 0; i < 3; i++)
+				mNode.mPosition[i] /= mWeight;
+			mNode.mU /= mWeight;
+			mNode.mV /= mWeight;
+			float length = std::sqrt(Dot(mNode.mNormal, mNode.mNormal));
+			if (length > 0.0f)
+			{
+				for (int i = 0; i < 3; i++)
+					mNode.mNormal[i] /= length;
+			}
+		}
+	};
+
+	// Widens a cone around the node normal to contain a member cone
+	float ConeAngle(const RSMLightTree::Node& node, const float normal[3], float memberAngle)
+	{
+		return std::min(SafeAcos(Dot(node.mNormal, normal)) + memberAngle, PI);
+	}
+}
+
+bool RSMLightTree::Build(const Image& image, uint32_t leafSize, std::string& error)
+{
+	CPU_PROFILE_SCOPE("RSM light tree");
+
+	uint32_t leafDim = leafSize > 0 ? image.mSize / leafSize : 0;
+	uint32_t leafLevel = 0;
+	while ((1u << leafLevel) < leafDim)
+		leafLevel++;
+	if (leafDim == 0 || leafDim * leafSize != image.mSize || (1u << leafLevel) != leafDim || leafLevel >= MAX_LEVELS)
+	{
+		error = "RSM size " + std::to_string(image.mSize) + " is not a power of two multiple of leaf size " + std::to_string(leafSize);
+		return false;
+	}
+
+	mRSMSize = image.mSize;
+	mLeafSize = leafSize;
+	mLeafLevel = leafLevel;
+	mNodes.assign(GetNodeCount(leafLevel), Node());
+
+	// leaves from their texels
+	const float texel = 1.0f / float(image.mSize);
+	Node* leaves = &mNodes[GetLevelOffset(leafLevel)];
+	for (uint32_t y = 0; y < leafDim; y++)
+	{
+		for (uint32_t x = 0; x < leafDim; x++)
+		{
+			NodeBuilder builder;
+			for (uint32_t ty = y * leafSize; ty < (y + 1) * leafSize; ty++)
+			{
+				for (uint32_t tx = x * leafSize; tx < (x + 1) * leafSize; tx++)
+				{
+					size_t index = (size_t(ty) * image.mSize + tx) * 4;
+					const float* position = image.mPositions + index;
+					builder.Add(image.mFlux + index, position, image.mNormals + index, (float(tx) + 0.5f) * texel, (float(ty) + 0.5f) * texel, position, position);
+				}
+			}
+			builder.Finish();
+
+			float angle = 0.0f;
+			for (uint32_t ty = y * leafSize; ty < (y + 1) * leafSize && builder.mWeight > 0.0f; ty++)
+			{
+				for (uint32_t tx = x * leafSize; tx < (x + 1) * leafSize; tx++)
+				{
+					size_t index = (size_t(ty) * image.mSize + tx) * 4;
+					if (GetLuminance(image.mFlux + index) > 0.0f)
+						angle = std::max(angle, ConeAngle(builder.mNode, image.mNormals + index, 0.0f));
+				}
+			}
+			if (builder.mWeight > 0.0f)
+				builder.mNode.mConeCos = angle >= PI ? -1.0f : std::cos(angle);
+			leaves[size_t(y) * leafDim + x] = builder.mNode;
+		}
+	}
+
+	// parents from their 4 children
+	for (uint32_t level = leafLevel; level-- > 0;)
+	{
+		const uint32_t dim = 1u << level;
+		Node* parents = &mNodes[GetLevelOffset(level)];
+		const Node* children = &mNodes[GetLevelOffset(level + 1)];
+		for (uint32_t y = 0; y < dim; y++)
+		{
+			for (uint32_t x = 0; x < dim; x++)
+			{
+				const Node* members[4] = {
+					&children[size_t(2 * y) * (2 * dim) + 2 * x], &children[size_t(2 * y) * (2 * dim) + 2 * x + 1],
+					&children[size_t(2 * y + 1) * (2 * dim) + 2 * x], &children[size_t(2 * y + 1) * (2 * dim) + 2 * x + 1] };
+
+				NodeBuilder builder;
+				for (const Node* child : members)
+					builder.Add(child->mFlux, child->mPosition, child->mNormal, child->mU, child->mV, child->mBoundsMin, child->mBoundsMax);
+				builder.Finish();
+
+				float angle = 0.0f;
+				for (const Node* child : members)
+				{
+					if (GetLuminance(child->mFlux) > 0.0f)
+						angle = std::max(angle, ConeAngle(builder.mNode, child->mNormal, SafeAcos(child->mConeCos)));
+				}
+				if (builder.mWeight > 0.0f)
+					builder.mNode.mConeCos = angle >= PI ? -1.0f : std::cos(angle);
+				parents[size_t(y) * dim + x] = builder.mNode;
+			}
+		}
+	}
+	return true;
+}
+
+void RSMLightTree::Gather(const Receiver& receiver, const GatherSettings& settings, float result[3], GatherStats* stats) const
+{
+	result[0] = result[1] = result[2] = 0.0f;
+	GatherStats gatherStats;
+	if (mNodes.empty())
+	{
+		if (stats)
+			*stats = gatherStats;
+		return;
+	}
+
+	const float rMax = settings.mRMax;
+	const uint32_t maxClusters = std::max(settings.mMaxClusters, START_NODES_PER_AXIS * START_NODES_PER_AXIS);
+	auto getNode = [this](uint32_t level, uint32_t x, uint32_t y) -> const Node& {
+		return mNodes[GetLevelOffset(level) + (size_t(y) << level) + x];
+	};
+
+	// the cut is a max heap on the error bound; leaves cannot be refined and bound nothing
+	std::vector<CutEntry> cut;
+	cut.reserve(std::min<uint32_t>(maxClusters, 1024));
+	auto add = [&](uint32_t level, uint32_t x, uint32_t y, float sign) {
+		const Node& node = getNode(level, x, y);
+		if (!(GetLuminance(node.mFlux) > 0.0f) || MinDistance(level, x, y, receiver.mUV) >= rMax)
+			return;
+		float estimate[3];
+		Estimate(node, receiver, rMax, estimate);
+		for (int i = 0; i < 3; i++)
+			result[i] += sign * estimate[i];
+		if (sign > 0.0f)
+		{
+			cut.push_back({ level < mLeafLevel ? GetBound(node, level, x, y, receiver, rMax) : 0.0f, Pack(level, x, y) });
+			std::push_heap(cut.begin(), cut.end());
+		}
+	};
+
+	const uint32_t startLevel = GetStartLevel(rMax, mLeafLevel);
+	const int dim = int(1u << startLevel);
+	int first[2], last[2];
+	for (int i = 0; i < 2; i++)
+	{
+		first[i] = std::min(std::max(int(std::floor((receiver.mUV[i] - rMax) * float(dim))), 0), dim - 1);
+		last[i] = std::min(std::max(int(std::floor((receiver.mUV[i] + rMax) * float(dim))), 0), dim - 1);
+	}
+	for (int y = first[1]; y <= last[1]; y++)
+	{
+		for (int x = first[0]; x <= last[0]; x++)
+			add(startLevel, x, y, 1.0f);
+	}
+
+	// refine the worst cluster until every bound is within the threshold of the running total; refining may add 3
+	// clusters, all of which must still fit in the budget
+	while (!cut.empty() && uint32_t(cut.size()) + 3 <= maxClusters &&
+		cut.front().mBound > settings.mErrorThreshold * std::max(GetLuminance(result), 0.0f))
+	{
+		std::pop_heap(cut.begin(), cut.end());
+		uint32_t level, x, y;
+		Unpack(cut.back().mNode, level, x, y);
+		cut.pop_back();
+		gatherStats.mRefined++;
+
+		add(level, x, y, -1.0f);
+		for (uint32_t child = 0; child < 4; child++)
+			add(level + 1, 2 * x + (child & 1), 2 * y + (child >> 1), 1.0f);
+	}
+	for (int i = 0; i < 3; i++)
+		result[i] = std::max(result[i], 0.0f);
+
+	gatherStats.mClusters = uint32_t(cut.size());
+	if (stats)
+		*stats = gatherStats;
+}
+
+float RSMLightTree::GetBound(const Node& node, uint32_t level, uint32_t x, uint32_t y, const Receiver& receiver, float rMax) const
+{
+	// vectors from the VPLs of the box to the receiver
+	float lo[3], hi[3], closest[3];
+	for (int i = 0; i < 3; i++)
+	{
+		lo[i] = receiver.mPosition[i] - node.mBoundsMax[i];
+		hi[i] = receiver.mPosition[i] - node.mBoundsMin[i];
+		closest[i] = std::min(std::max(0.0f, lo[i]), hi[i]);
+	}
+	float minDistanceSquared = Dot(closest, closest);
+	// the receiver inside the box bounds nothing
+	if (!(minDistanceSquared > 0.0f))
+		return 1e30f;
+
+	const float receiverAxis[3] = { -receiver.mNormal[0], -receiver.mNormal[1], -receiver.mNormal[2] };
+	float vplCos = CosineBound(lo, hi, node.mNormal, SafeAcos(node.mConeCos));
+	float receiverCos = CosineBound(lo, hi, receiverAxis, 0.0f);
+	float discWeight = RadialWeight(std::min(MaxDistance(level, x, y, receiver.mUV), rMax), rMax, mRSMSize);
+	return GetLuminance(node.mFlux) * vplCos * receiverCos / minDistanceSquared * discWeight;
+}
+
+void RSMLightTree::Estimate(const Node& node, const Receiver& receiver, float rMax, float result[3]) const
+{
+	float du = node.mU - receiver.mUV[0];
+	float dv = node.mV - receiver.mUV[1];
+	float weight = Transfer(node.mPosition, node.mNormal, receiver) * GetDiscWeight(std::sqrt(du * du + dv * dv), rMax, mRSMSize);
+	for (int i = 0; i < 3; i++)
+		result[i] = node.mFlux[i] * weight;
+}
+
+uint32_t RSMLightTree::GetStartLevel(float rMax, uint32_t leafLevel)
+{
+	// a diameter of at most START_NODES_PER_AXIS - 1 nodes overlaps at most START_NODES_PER_AXIS of them
+	uint32_t level = 0;
+	while (level < leafLevel && 2.0f * rMax * float(2u << level) <= float(START_NODES_PER_AXIS - 1))
+		level++;
+	return level;
+}
+
+float RSMLightTree::GetDiscWeight(float rho, float rMax, uint32_t rsmSize)
+{
+	return rho < rMax ? RadialWeight(rho, rMax, rsmSize) : 0.0f;
+}
+
+void RSMLightTree::MakeSamples(uint32_t count, std::vector<float>& xi)
+{
+	xi.resize(size_t(count) * 2);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		xi[i * 2] = Sampling::ScrambledSobol(i, 0, 0x2C1B3C6Du);
+		xi[i * 2 + 1] = Sampling::ScrambledSobol(i, 1, 0x297A2D39u);
+	}
+}
+
+void RSMLightTree::GatherSamples(const Image& image, const Receiver& receiver, float rMax, const float* xi, uint32_t sampleCount, float result[3])
+{
+	result[0] = result[1] = result[2] = 0.0f;
+	for (uint32_t i = 0; i < sampleCount; i++)
+	{
+		float radius = xi[i * 2];
+		float angle = 2.0f * PI * xi[i * 2 + 1];
+		float u = receiver.mUV[0] + rMax * radius * std::sin(angle);
+		float v = receiver.mUV[1] + rMax * radius * std::cos(angle);
+		if (u < 0.0f || u > 1.0f || v < 0.0f || v > 1.0f)
+			continue;
+		// Load past the last texel reads zero
+		uint32_t x = uint32_t(u * float(image.mSize));
+		uint32_t y = uint32_t(v * float(image.mSize));
+		if (x >= image.mSize || y >= image.mSize)
+			continue;
+
+		size_t index = (size_t(y) * image.mSize + x) * 4;
+		float weight = Transfer(image.mPositions + index, image.mNormals + index, receiver) * radius * radius;
+		for (int c = 0; c < 3; c++)
+			result[c] += image.mFlux[index + c] * weight;
+	}
+	float scale = sampleCount > 0 ? float(MAX_SAMPLES_COUNT) / float(sampleCount) : 0.0f;
+	for (int c = 0; c < 3; c++)
+		result[c] *= scale;
+}
+
+void RSMLightTree::GatherExact(const Image& image, const Receiver& receiver, float rMax, float result[3])
+{
+	result[0] = result[1] = result[2] = 0.0f;
+	const float size = float(image.mSize);
+	int first[2], last[2];
+	for (int i = 0; i < 2; i++)
+	{
+		first[i] = std::max(int(std::floor((receiver.mUV[i] - rMax) * size)), 0);
+		last[i] = std::min(int(std::floor((receiver.mUV[i] + rMax) * size)), int(image.mSize) - 1);
+	}
+
+	for (int y = first[1]; y <= last[1]; y++)
+	{
+		for (int x = first[0]; x <= last[0]; x++)
+		{
+			float du = (float(x) + 0.5f) / size - receiver.mUV[0];
+			float dv = (float(y) + 0.5f) / size - receiver.mUV[1];
+			float discWeight = GetDiscWeight(std::sqrt(du * du + dv * dv), rMax, image.mSize);
+			if (discWeight == 0.0f)
+				continue;
+			size_t index = (size_t(y) * image.mSize + x) * 4;
+			float weight = Transfer(image.mPositions + index, image.mNormals + index, receiver) * discWeight;
+			for (int c = 0; c < 3; c++)
+				result[c] += image.mFlux[index + c] * weight;
+		}
+	}
+}
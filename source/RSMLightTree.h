@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Hierarchical VPL gathering (lightcuts, Walter et al. 2005) for the reflective shadow map. The RSM pass estimates,
+// per receiver, the sum over the RSM texels within RMax of its projected position of flux * transfer with 512 polar
+// samples weighted by xi.x^2 (ReflectiveShadowMappingCS.hlsl). That estimator converges to the same sum with every
+// texel weighted by N * rho / (2 pi RMax^3 size^2), rho its distance in RSM uv and N = RSM_MAX_SAMPLES_COUNT, which
+// is what the tree gathers instead:
+//   build   leaves summarize leafSize x leafSize texels, a complete quadtree over them is built bottom up. A node keeps
+//           its summed flux, flux weighted position, normal and RSM uv (the representative VPL), the bounding box of
+//           the positions and a cone bounding the normals.
+//   gather  the cut starts as the nodes of GetStartLevel overlapping the disc, each evaluated with its representative.
+//           The cluster with the largest error bound is replaced by its children until every bound is below
+//           threshold * the current estimate or the next refinement would exceed maxClusters. The bound is
+//           flux * max cosines / min distance^2 * max disc weight over the node; the cosines are bounded over the box
+//           of directions to the receiver in a frame around the normal (widened by the normal cone), as in lightcuts,
+//           so coplanar clusters bound nothing. Leaves bound nothing either.
+// RSMLightTreeBuildCS.hlsl and ReflectiveShadowMappingLightcutsCS.hlsl follow Build and Gather; node layout and level
+// order (root first, row major levels) are shared. The sample estimator and the exact texel sum
+// are here too, as references (tools/RSMLightcutsBench).
+// Only uses the standard library.
+class RSMLightTree
+{
+public:
+    static constexpr uint32_t MAX_LEVELS = 12;
+    static constexpr uint32_t START_NODES_PER_AXIS = 4;
+    static constexpr uint32_t MAX_SAMPLES_COUNT = 512;   // RSM_MAX_SAMPLES_COUNT
+    // Lightcuts' error threshold. The budget is where the error stops falling on the sample scene (tools/RSMLightcutsBench
+    // on profiling/rsm_capture.bin): against the 512 samples it is 22% at 64 clusters, 7.9% at 128 and 5.0% at 256,
+    // within 0.1% of an unbounded cut, the error of the 4x4 texel leaves. The samples are 1.6% from the exact sum and
+    // cost a quarter of the CPU time there, so the lightcuts gather is off by default. The shader's cut holds
+    // MAX_CLUSTERS
+    static constexpr float DEFAULT_ERROR_THRESHOLD = 0.02f;
+    static constexpr uint32_t DEFAULT_MAX_CLUSTERS = 256;
+    static constexpr uint32_t MAX_CLUSTERS = 256;
+
+    // LightTreeNode in RSMLightTreeBuildCS.hlsl, 72 bytes
+    struct Node
+    {
+        float mFlux[3];
+        float mConeCos;       // normals within acos(mConeCos) of mNormal, -1 for any direction
+        float mPosition[3];
+        float mU;
+        float mNormal[3];
+        float mV;
+        float mBoundsMin[3];
+        float mBoundsMax[3];
+    };
+
+    // RSM render targets as float4 texels, size x size: world position, normal, flux
+    struct Image
+    {
+        const float* mPositions = nullptr;
+        const float* mNormals = nullptr;
+        const float* mFlux = nullptr;
+        uint32_t mSize = 0;
+    };
+
+    struct Receiver
+    {
+        float mPosition[3];
+        float mNormal[3];
+        float mUV[2];   // projected into the RSM
+    };
+
+    struct GatherSettings
+    {
+        float mRMax = 0.035f;
+        float mErrorThreshold = DEFAULT_ERROR_THRESHOLD;
+        uint32_t mMaxClusters = DEFAULT_MAX_CLUSTERS;
+    };
+
+    struct GatherStats
+    {
+        uint32_t mClusters = 0;   // evaluated nodes, the cut
+        uint32_t mRefined = 0;    // clusters replaced by their children
+    };
+
+    // The size must be a power of two multiple of leafSize with at most MAX_LEVELS levels
+    bool Build(const Image& image, uint32_t leafSize, std::string& error);
+
+    uint32_t GetLeafLevel() const { return mLeafLevel; }
+    uint32_t GetLeafSize() const { return mLeafSize; }
+    uint32_t GetRSMSize() const { return mRSMSize; }
+    const std::vector<Node>& GetNodes() const { return mNodes; }
+
+    void Gather(const Receiver& receiver, const GatherSettings& settings, float result[3], GatherStats* stats = nullptr) const;
+
+    // Deepest level whose nodes are at least half the disc diameter wide, so the disc overlaps at most
+    // START_NODES_PER_AXIS^2 of them
+    static uint32_t GetStartLevel(float rMax, uint32_t leafLevel);
+    static size_t GetLevelOffset(uint32_t level) { return ((size_t(1) << (2 * level)) - 1) / 3; }
+    static size_t GetNodeCount(uint32_t leafLevel) { return GetLevelOffset(leafLevel + 1); }
+    // Weight of a texel at rho in the converged sample estimator, 0 outside the disc
+    static float GetDiscWeight(float rho, float rMax, uint32_t rsmSize);
+    static float GetLuminance(const float rgb[3]) { return 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2]; }
+
+    // The polar samples of the RSM pass, xy pairs (the scene uploads these)
+    static void MakeSamples(uint32_t count, std::vector<float>& xi);
+    // The RSM pass: the first sampleCount samples, scaled to MAX_SAMPLES_COUNT; nearest texels
+    static void GatherSamples(const Image& image, const Receiver& receiver, float rMax, const float* xi, uint32_t sampleCount, float result[3]);
+    // Every texel of the disc with its disc weight, what the samples converge to
+    static void GatherExact(const Image& image, const Receiver& receiver, float rMax, float result[3]);
+
+private:
+    float GetBound(const Node& node, uint32_t level, uint32_t x, uint32_t y, const Receiver& receiver, float rMax) const;
+    void Estimate(const Node& node, const Receiver& receiver, float rMax, float result[3]) const;
+
+    uint32_t mRSMSize = 0;
+    uint32_t mLeafSize = 1;
+    uint32_t mLeafLevel = 0;
+    std::vector<Node> mNodes;
+};
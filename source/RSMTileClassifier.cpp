@@ -0,0 +1,233 @@
+#include "RSMTileClassifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	void Transform(const float m[16], const float position[3], float clip[4])
+	{
+		for (int i = 0; i < 4; i++)
+			clip[i] = position[0] * m[i] + position[1] * m[4 + i] + position[2] * m[8 + i] + m[12 + i];
+	}
+
+	bool HasGeometry(const float normal[3])
+	{
+		return normal[0] != 0.0f || normal[1] != 0.0f || normal[2] != 0.0f;
+	}
+
+	float GetDepth(const float viewProjection[16], const float position[3])
+	{
+		float clip[4];
+		Transform(viewProjection, position, clip);
+		return clip[3];
+	}
+
+	// The projection of ReflectiveShadowMappingCS.hlsl
+	void ProjectToRSM(const float shadowViewProjection[16], const float position[3], float uv[2])
+	{
+		float clip[4];
+		Transform(shadowViewProjection, position, clip);
+		uv[0] = clip[0] / clip[3] * 0.5f + 0.5f;
+		uv[1] = clip[1] / clip[3] * -0.5f + 0.5f;
+	}
+
+	// Nodes of level overlapping [lo, hi] in RSM uv
+	void GetNodeRange(const float lo[2], const float hi[2], uint32_t level, int first[2], int last[2])
+	{
+		const int dim = int(1u << level);
+		for (int i = 0; i < 2; i++)
+		{
+			first[i] = std::min(std::max(int(std::floor(lo[i] * float(dim))), 0), dim - 1);
+			last[i] = std::min(std::max(int(std::floor(hi[i] * float(dim))), 0), dim - 1);
+		}
+	}
+}
+
+const char* RSMTileClassifier::GetName(Class tileClass)
+{
+	switch (tileClass)
+	{
+	case CLASS_FULL: return "full";
+	case CLASS_REDUCED: return "reduced";
+	case CLASS_NONE: return "none";
+	default: return "?";
+	}
+}
+
+uint32_t RSMTileClassifier::GetLevel(float rMax, uint32_t leafLevel)
+{
+	return std::min(RSMLightTree::GetStartLevel(rMax, leafLevel) + 1, leafLevel);
+}
+
+uint32_t RSMTileClassifier::GetSampleCount(Class tileClass, uint32_t sampleCount)
+{
+	switch (tileClass)
+	{
+	case CLASS_FULL: return sampleCount;
+	case CLASS_REDUCED: return sampleCount / REDUCED_SAMPLES_DIVISOR;
+	default: return 0;
+	}
+}
+
+RSMTileClassifier::Class RSMTileClassifier::ClassifyTile(const Frame& frame, const RSMLightTree& tree, const Settings& settings, uint32_t tileX, uint32_t tileY,
+	TileStats* stats)
+{
+	TileStats tileStats;
+	if (stats)
+		*stats = tileStats;
+
+	const uint32_t startX = tileX * TILE_SIZE;
+	const uint32_t startY = tileY * TILE_SIZE;
+	const uint32_t endX = std::min(startX + TILE_SIZE, frame.mWidth);
+	const uint32_t endY = std::min(startY + TILE_SIZE, frame.mHeight);
+
+	// extent of the receivers in the RSM and their mean normal and position
+	float uvMin[2] = { FLT_MAX, FLT_MAX };
+	float uvMax[2] = { -FLT_MAX, -FLT_MAX };
+	float normalSum[3] = { 0.0f, 0.0f, 0.0f };
+	float positionSum[3] = { 0.0f, 0.0f, 0.0f };
+	for (uint32_t y = startY; y < endY; y++)
+	{
+		for (uint32_t x = startX; x < endX; x++)
+		{
+			const size_t index = (size_t(y) * frame.mWidth + x) * 4;
+			const float* normal = frame.mNormals + index;
+			const float* position = frame.mPositions + index;
+			if (!HasGeometry(normal))
+				continue;
+			tileStats.mGeometryPixels++;
+
+			float uv[2];
+			ProjectToRSM(frame.mShadowViewProjection, position, uv);
+			for (int i = 0; i < 2; i++)
+			{
+				uvMin[i] = std::min(uvMin[i], uv[i]);
+				uvMax[i] = std::max(uvMax[i], uv[i]);
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				normalSum[c] += normal[c];
+				positionSum[c] += position[c];
+			}
+		}
+	}
+	if (stats)
+		*stats = tileStats;
+	if (tileStats.mGeometryPixels == 0)
+		return CLASS_NONE;
+
+	// the discs of every receiver, in the RSM
+	const float lo[2] = { uvMin[0] - settings.mRMax, uvMin[1] - settings.mRMax };
+	const float hi[2] = { uvMax[0] + settings.mRMax, uvMax[1] + settings.mRMax };
+	if (hi[0] < 0.0f || hi[1] < 0.0f || lo[0] > 1.0f || lo[1] > 1.0f)
+		return CLASS_NONE;
+
+	// box of the VPLs in reach: the nodes with flux overlapping the discs, at a coarser level if there are too many
+	uint32_t level = std::min(settings.mLevel, tree.GetLeafLevel());
+	int first[2], last[2];
+	for (;;)
+	{
+		GetNodeRange(lo, hi, level, first, last);
+		if (uint32_t(last[0] - first[0] + 1) * uint32_t(last[1] - first[1] + 1) <= MAX_NODES || level == 0)
+			break;
+		level--;
+	}
+	tileStats.mLevel = level;
+	tileStats.mNodes = uint32_t(last[0] - first[0] + 1) * uint32_t(last[1] - first[1] + 1);
+
+	const std::vector<RSMLightTree::Node>& nodes = tree.GetNodes();
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int y = first[1]; y <= last[1]; y++)
+	{
+		for (int x = first[0]; x <= last[0]; x++)
+		{
+			const RSMLightTree::Node& node = nodes[RSMLightTree::GetLevelOffset(level) + (size_t(y) << level) + size_t(x)];
+			if (RSMLightTree::GetLuminance(node.mFlux) <= 0.0f)
+				continue;
+			tileStats.mLitNodes++;
+			for (int c = 0; c < 3; c++)
+			{
+				boundsMin[c] = std::min(boundsMin[c], node.mBoundsMin[c]);
+				boundsMax[c] = std::max(boundsMax[c], node.mBoundsMax[c]);
+			}
+		}
+	}
+	if (stats)
+		*stats = tileStats;
+	if (tileStats.mLitNodes == 0)
+		return CLASS_NONE;
+
+	// a receiver only gathers VPLs in front of it, the box corner furthest along its normal is the best case
+	float meanNormal[3], meanPosition[3];
+	for (int c = 0; c < 3; c++)
+	{
+		meanNormal[c] = normalSum[c] / float(tileStats.mGeometryPixels);
+		meanPosition[c] = positionSum[c] / float(tileStats.mGeometryPixels);
+	}
+	const float meanLength = std::sqrt(Dot(meanNormal, meanNormal));
+	float planeDistance = 0.0f;
+	for (uint32_t y = startY; y < endY; y++)
+	{
+		for (uint32_t x = startX; x < endX; x++)
+		{
+			const size_t index = (size_t(y) * frame.mWidth + x) * 4;
+			const float* normal = frame.mNormals + index;
+			const float* position = frame.mPositions + index;
+			if (!HasGeometry(normal))
+				continue;
+
+			const float depth = GetDepth(frame.mViewProjection, position);
+			float corner[3];
+			for (int c = 0; c < 3; c++)
+				corner[c] = (normal[c] > 0.0f ? boundsMax[c] : boundsMin[c]) - position[c];
+			if (Dot(normal, corner) > RECEIVER_TOLERANCE * depth)
+				tileStats.mReceivingPixels++;
+
+			const float offset[3] = { position[0] - meanPosition[0], position[1] - meanPosition[1], position[2] - meanPosition[2] };
+			if (meanLength > 0.0f && depth > 0.0f)
+				planeDistance = std::max(planeDistance, std::fabs(Dot(meanNormal, offset)) / (meanLength * depth));
+		}
+	}
+	if (stats)
+		*stats = tileStats;
+	if (tileStats.mReceivingPixels == 0)
+		return CLASS_NONE;
+
+	return (1.0f - meanLength <= settings.mNormalVariance && planeDistance <= settings.mPlaneDistance) ? CLASS_REDUCED : CLASS_FULL;
+}
+
+void RSMTileClassifier::ResetLists(uint32_t tileCapacity, std::vector<uint32_t>& buffer)
+{
+	buffer.resize(std::max(buffer.size(), size_t(GetBufferWords(tileCapacity))), 0u);
+	for (uint32_t tileClass = 0; tileClass < CLASS_COUNT; tileClass++)
+	{
+		uint32_t* arguments = buffer.data() + GetArgumentsOffset(Class(tileClass));
+		arguments[0] = 0;
+		arguments[1] = 1;
+		arguments[2] = 1;
+	}
+}
+
+void RSMTileClassifier::AppendTile(Class tileClass, uint32_t tile, uint32_t tileCapacity, std::vector<uint32_t>& buffer)
+{
+	const uint32_t slot = buffer[GetArgumentsOffset(tileClass)]++;
+	buffer[GetListOffset(tileClass, tileCapacity) + slot] = tile;
+}
+
+void RSMTileClassifier::Classify(const Frame& frame, const RSMLightTree& tree, const Settings& settings, uint32_t tileCapacity, std::vector<uint32_t>& buffer)
+{
+	ResetLists(tileCapacity, buffer);
+	for (uint32_t y = 0; y < GetTilesY(frame.mHeight); y++)
+	{
+		for (uint32_t x = 0; x < GetTilesX(frame.mWidth); x++)
+			AppendTile(ClassifyTile(frame, tree, settings, x, y), PackTile(x, y), tileCapacity, buffer);
+	}
+}
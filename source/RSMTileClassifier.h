@@ -0,0 +1,94 @@
+#pragma once
+
+#include "RSMLightTree.h"
+
+#include <cstdint>
+#include <vector>
+
+// Tile classification for the RSM pass: a pre-pass sorts the TILE_SIZE x TILE_SIZE tiles of the pass (its thread
+// groups) into lists, and the pass is dispatched indirectly over each list (RSMTileClassifyCS.hlsl,
+// ReflectiveShadowMappingCS.hlsl CSTiles).
+//   none     nothing can arrive: no geometry (sky), every RSM disc of the tile outside the RSM or without flux, or
+//            every receiver facing away from the VPLs in reach. The VPLs are bounded by the boxes of the light tree
+//            nodes (RSMLightTree) that overlap the tile's discs, so this only drops light the sample estimator would
+//            not gather. These tiles are cleared instead.
+//   reduced  a smooth surface: normals within DEFAULT_NORMAL_VARIANCE of their mean (1 - |mean normal|) and positions
+//            within DEFAULT_PLANE_DISTANCE of the mean plane, relative to the depth. These take 1 / REDUCED_SAMPLES_DIVISOR
+//            of the samples, an aligned block of the Sobol set that is still stratified.
+//   full     everything else.
+// The lists live in one buffer of 32 bit words: a D3D12_DISPATCH_ARGUMENTS per class (the tile count, 1, 1), then a
+// list of tileCapacity packed tiles per class. The classifier appends to them with atomics, so the order of a list
+// differs between runs on the GPU; AppendTile and Classify fill them as one group after the other does. This is the
+// reference for the shaders (tools/RSMTileBench). Only uses the standard library.
+class RSMTileClassifier
+{
+public:
+    enum Class
+    {
+        CLASS_FULL = 0,
+        CLASS_REDUCED,
+        CLASS_NONE,
+
+        CLASS_COUNT
+    };
+
+    static constexpr uint32_t TILE_SIZE = 8;
+    static constexpr uint32_t MAX_NODES = 64;           // nodes tested per tile, one per thread of the classifier
+    static constexpr uint32_t REDUCED_SAMPLES_DIVISOR = 4;
+    static constexpr float DEFAULT_NORMAL_VARIANCE = 0.02f;
+    static constexpr float DEFAULT_PLANE_DISTANCE = 0.01f;
+    static constexpr float RECEIVER_TOLERANCE = 0.001f; // towards the VPL boxes, relative to the depth
+    static constexpr uint32_t ARGUMENT_WORDS = 3;       // D3D12_DISPATCH_ARGUMENTS
+
+    // G-buffer at the resolution of the pass as float4 texels; zero normals have no geometry. Matrices as in
+    // RSMInterleave: row major, applied to row vectors.
+    struct Frame
+    {
+        const float* mPositions = nullptr;
+        const float* mNormals = nullptr;
+        uint32_t mWidth = 0;
+        uint32_t mHeight = 0;
+        const float* mViewProjection = nullptr;
+        const float* mShadowViewProjection = nullptr;
+    };
+
+    struct Settings
+    {
+        float mRMax = 0.035f;
+        float mNormalVariance = DEFAULT_NORMAL_VARIANCE;
+        float mPlaneDistance = DEFAULT_PLANE_DISTANCE;
+        uint32_t mLevel = 0;    // GetLevel
+    };
+
+    struct TileStats
+    {
+        uint32_t mGeometryPixels = 0;
+        uint32_t mReceivingPixels = 0;
+        uint32_t mLevel = 0;    // of the nodes tested, coarser than Settings::mLevel for tiles spanning much of the RSM
+        uint32_t mNodes = 0;
+        uint32_t mLitNodes = 0;
+    };
+
+    static const char* GetName(Class tileClass);
+    // One level below RSMLightTree::GetStartLevel, so a disc overlaps up to 8 x 8 nodes of tighter boxes
+    static uint32_t GetLevel(float rMax, uint32_t leafLevel);
+    static uint32_t GetTilesX(uint32_t width) { return (width + TILE_SIZE - 1) / TILE_SIZE; }
+    static uint32_t GetTilesY(uint32_t height) { return (height + TILE_SIZE - 1) / TILE_SIZE; }
+    static uint32_t PackTile(uint32_t x, uint32_t y) { return (y << 16) | x; }
+    static void UnpackTile(uint32_t tile, uint32_t& x, uint32_t& y) { x = tile & 0xFFFF; y = tile >> 16; }
+    // Samples of the pass for a tile of the class
+    static uint32_t GetSampleCount(Class tileClass, uint32_t sampleCount);
+
+    static Class ClassifyTile(const Frame& frame, const RSMLightTree& tree, const Settings& settings, uint32_t tileX, uint32_t tileY, TileStats* stats = nullptr);
+
+    // Buffer layout, in words
+    static uint32_t GetArgumentsOffset(Class tileClass) { return uint32_t(tileClass) * ARGUMENT_WORDS; }
+    static uint32_t GetListOffset(Class tileClass, uint32_t tileCapacity) { return CLASS_COUNT * ARGUMENT_WORDS + uint32_t(tileClass) * tileCapacity; }
+    static uint32_t GetBufferWords(uint32_t tileCapacity) { return CLASS_COUNT * (ARGUMENT_WORDS + tileCapacity); }
+    // CSReset: every list empty, the rest of the buffer is left as it is
+    static void ResetLists(uint32_t tileCapacity, std::vector<uint32_t>& buffer);
+    // A group of CSClassify: the tile goes to the end of its list
+    static void AppendTile(Class tileClass, uint32_t tile, uint32_t tileCapacity, std::vector<uint32_t>& buffer);
+    // CSReset and CSClassify for every tile, row major; tileCapacity must hold every tile of the frame
+    static void Classify(const Frame& frame, const RSMLightTree& tree, const Settings& settings, uint32_t tileCapacity, std::vector<uint32_t>& buffer);
+};
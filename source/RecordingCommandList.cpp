@@ -0,0 +1,363 @@
+#include "RecordingCommandList.h"
+#include "Hash.h"
+
+RecordingCommandList::RecordingCommandList(ID3D12GraphicsCommandList* commandList, CommandLog& log, uint32_t listIndex)
+	: mTarget(commandList)
+	, mLog(log)
+	, mListIndex(listIndex)
+	, mListType(commandList->GetType())
+{
+}
+
+HRESULT RecordingCommandList::QueryInterface(REFIID riid, void** ppvObject)
+{
+	if (!ppvObject)
+		return E_POINTER;
+
+	if (riid == __uuidof(ID3D12GraphicsCommandList) || riid == __uuidof(ID3D12CommandList) || riid == __uuidof(ID3D12DeviceChild) ||
+		riid == __uuidof(ID3D12Object) || riid == __uuidof(IUnknown))
+	{
+		*ppvObject = static_cast<ID3D12GraphicsCommandList*>(this);
+		AddRef();
+		return S_OK;
+	}
+	return mTarget->QueryInterface(riid, ppvObject);
+}
+
+HRESULT RecordingCommandList::Close()
+{
+	Record(CommandLog::OP_CLOSE, {});
+	return mTarget->Close();
+}
+
+HRESULT RecordingCommandList::Reset(ID3D12CommandAllocator* pAllocator, ID3D12PipelineState* pInitialState)
+{
+	Record(CommandLog::OP_RESET, {});
+	HRESULT hr = mTarget->Reset(pAllocator, pInitialState);
+	if (pInitialState)
+		Record(CommandLog::OP_SET_PIPELINE_STATE, { uint64_t(pInitialState) });
+	return hr;
+}
+
+void RecordingCommandList::ClearState(ID3D12PipelineState* pPipelineState)
+{
+	Record(CommandLog::OP_OTHER, { CommandLog::OTHER_CLEAR_STATE });
+	mTarget->ClearState(pPipelineState);
+}
+
+void RecordingCommandList::DrawInstanced(UINT VertexCountPerInstance, UINT InstanceCount, UINT StartVertexLocation, UINT StartInstanceLocation)
+{
+	Record(CommandLog::OP_DRAW, { VertexCountPerInstance, InstanceCount });
+	mTarget->DrawInstanced(VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation);
+}
+
+void RecordingCommandList::DrawIndexedInstanced(UINT IndexCountPerInstance, UINT InstanceCount, UINT StartIndexLocation, INT BaseVertexLocation, UINT StartInstanceLocation)
+{
+	Record(CommandLog::OP_DRAW_INDEXED, { IndexCountPerInstance, InstanceCount });
+	mTarget->DrawIndexedInstanced(IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation);
+}
+
+void RecordingCommandList::Dispatch(UINT ThreadGroupCountX, UINT ThreadGroupCountY, UINT ThreadGroupCountZ)
+{
+	Record(CommandLog::OP_DISPATCH, { ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ });
+	mTarget->Dispatch(ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ);
+}
+
+void RecordingCommandList::CopyBufferRegion(ID3D12Resource* pDstBuffer, UINT64 DstOffset, ID3D12Resource* pSrcBuffer, UINT64 SrcOffset, UINT64 NumBytes)
+{
+	Record(CommandLog::OP_COPY, { CommandLog::COPY_BUFFER_REGION });
+	mTarget->CopyBufferRegion(pDstBuffer, DstOffset, pSrcBuffer, SrcOffset, NumBytes);
+}
+
+void RecordingCommandList::CopyTextureRegion(const D3D12_TEXTURE_COPY_LOCATION* pDst, UINT DstX, UINT DstY, UINT DstZ, const D3D12_TEXTURE_COPY_LOCATION* pSrc, const D3D12_BOX* pSrcBox)
+{
+	Record(CommandLog::OP_COPY, { CommandLog::COPY_TEXTURE_REGION });
+	mTarget->CopyTextureRegion(pDst, DstX, DstY, DstZ, pSrc, pSrcBox);
+}
+
+void RecordingCommandList::CopyResource(ID3D12Resource* pDstResource, ID3D12Resource* pSrcResource)
+{
+	Record(CommandLog::OP_COPY, { CommandLog::COPY_RESOURCE });
+	mTarget->CopyResource(pDstResource, pSrcResource);
+}
+
+void RecordingCommandList::CopyTiles(ID3D12Resource* pTiledResource, const D3D12_TILED_RESOURCE_COORDINATE* pTileRegionStartCoordinate, const D3D12_TILE_REGION_SIZE* pTileRegionSize,
+	ID3D12Resource* pBuffer, UINT64 BufferStartOffsetInBytes, D3D12_TILE_COPY_FLAGS Flags)
+{
+	Record(CommandLog::OP_COPY, { CommandLog::COPY_TILES });
+	mTarget->CopyTiles(pTiledResource, pTileRegionStartCoordinate, pTileRegionSize, pBuffer, BufferStartOffsetInBytes, Flags);
+}
+
+void RecordingCommandList::ResolveSubresource(ID3D12Resource* pDstResource, UINT DstSubresource, ID3D12Resource* pSrcResource, UINT SrcSubresource, DXGI_FORMAT Format)
+{
+	Record(CommandLog::OP_COPY, { CommandLog::COPY_RESOLVE });
+	mTarget->ResolveSubresource(pDstResource, DstSubresource, pSrcResource, SrcSubresource, Format);
+}
+
+void RecordingCommandList::IASetPrimitiveTopology(D3D12_PRIMITIVE_TOPOLOGY PrimitiveTopology)
+{
+	Record(CommandLog::OP_SET_PRIMITIVE_TOPOLOGY, { uint64_t(PrimitiveTopology) });
+	mTarget->IASetPrimitiveTopology(PrimitiveTopology);
+}
+
+void RecordingCommandList::RSSetViewports(UINT NumViewports, const D3D12_VIEWPORT* pViewports)
+{
+	Record(CommandLog::OP_SET_VIEWPORTS, { NumViewports, CommandLog::Hash(pViewports, sizeof(D3D12_VIEWPORT) * NumViewports) });
+	mTarget->RSSetViewports(NumViewports, pViewports);
+}
+
+void RecordingCommandList::RSSetScissorRects(UINT NumRects, const D3D12_RECT* pRects)
+{
+	Record(CommandLog::OP_SET_SCISSOR_RECTS, { NumRects, CommandLog::Hash(pRects, sizeof(D3D12_RECT) * NumRects) });
+	mTarget->RSSetScissorRects(NumRects, pRects);
+}
+
+void RecordingCommandList::OMSetBlendFactor(const FLOAT BlendFactor[4])
+{
+	const FLOAT defaultFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	Record(CommandLog::OP_SET_BLEND_FACTOR, { CommandLog::Hash(BlendFactor ? BlendFactor : defaultFactor, sizeof(defaultFactor)) });
+	mTarget->OMSetBlendFactor(BlendFactor);
+}
+
+void RecordingCommandList::OMSetStencilRef(UINT StencilRef)
+{
+	Record(CommandLog::OP_SET_STENCIL_REF, { StencilRef });
+	mTarget->OMSetStencilRef(StencilRef);
+}
+
+void RecordingCommandList::SetPipelineState(ID3D12PipelineState* pPipelineState)
+{
+	Record(CommandLog::OP_SET_PIPELINE_STATE, { uint64_t(pPipelineState) });
+	mTarget->SetPipelineState(pPipelineState);
+}
+
+void RecordingCommandList::ResourceBarrier(UINT NumBarriers, const D3D12_RESOURCE_BARRIER* pBarriers)
+{
+	uint64_t transitions = 0;
+	uint64_t aliasing = 0;
+	uint64_t uav = 0;
+	for (UINT i = 0; i < NumBarriers; i++)
+	{
+		if (pBarriers[i].Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION)
+			transitions++;
+		else if (pBarriers[i].Type == D3D12_RESOURCE_BARRIER_TYPE_ALIASING)
+			aliasing++;
+		else
+			uav++;
+	}
+	Record(CommandLog::OP_BARRIER, { transitions, aliasing, uav });
+	mTarget->ResourceBarrier(NumBarriers, pBarriers);
+}
+
+void RecordingCommandList::ExecuteBundle(ID3D12GraphicsCommandList* pCommandList)
+{
+	Record(CommandLog::OP_EXECUTE_BUNDLE, { uint64_t(pCommandList) });
+	mTarget->ExecuteBundle(pCommandList);
+}
+
+void RecordingCommandList::SetDescriptorHeaps(UINT NumDescriptorHeaps, ID3D12DescriptorHeap* const* ppDescriptorHeaps)
+{
+	Record(CommandLog::OP_SET_DESCRIPTOR_HEAPS, { NumDescriptorHeaps, CommandLog::Hash(ppDescriptorHeaps, sizeof(ID3D12DescriptorHeap*) * NumDescriptorHeaps) });
+	mTarget->SetDescriptorHeaps(NumDescriptorHeaps, ppDescriptorHeaps);
+}
+
+void RecordingCommandList::SetComputeRootSignature(ID3D12RootSignature* pRootSignature)
+{
+	Record(CommandLog::OP_SET_ROOT_SIGNATURE, { CommandLog::BIND_COMPUTE, uint64_t(pRootSignature) });
+	mTarget->SetComputeRootSignature(pRootSignature);
+}
+
+void RecordingCommandList::SetGraphicsRootSignature(ID3D12RootSignature* pRootSignature)
+{
+	Record(CommandLog::OP_SET_ROOT_SIGNATURE, { CommandLog::BIND_GRAPHICS, uint64_t(pRootSignature) });
+	mTarget->SetGraphicsRootSignature(pRootSignature);
+}
+
+void RecordingCommandList::SetComputeRootDescriptorTable(UINT RootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor)
+{
+	Record(CommandLog::OP_SET_ROOT_TABLE, { CommandLog::BIND_COMPUTE, RootParameterIndex, BaseDescriptor.ptr });
+	mTarget->SetComputeRootDescriptorTable(RootParameterIndex, BaseDescriptor);
+}
+
+void RecordingCommandList::SetGraphicsRootDescriptorTable(UINT RootParameterIndex, D3D12_GPU_DESCRIPTOR_HANDLE BaseDescriptor)
+{
+	Record(CommandLog::OP_SET_ROOT_TABLE, { CommandLog::BIND_GRAPHICS, RootParameterIndex, BaseDescriptor.ptr });
+	mTarget->SetGraphicsRootDescriptorTable(RootParameterIndex, BaseDescriptor);
+}
+
+void RecordingCommandList::SetComputeRoot32BitConstant(UINT RootParameterIndex, UINT SrcData, UINT DestOffsetIn32BitValues)
+{
+	Record(CommandLog::OP_SET_ROOT_CONSTANTS, { CommandLog::BIND_COMPUTE, RootParameterIndex, DestOffsetIn32BitValues, 1, CommandLog::Hash(&SrcData, sizeof(UINT)) });
+	mTarget->SetComputeRoot32BitConstant(RootParameterIndex, SrcData, DestOffsetIn32BitValues);
+}
+
+void RecordingCommandList::SetGraphicsRoot32BitConstant(UINT RootParameterIndex, UINT SrcData, UINT DestOffsetIn32BitValues)
+{
+	Record(CommandLog::OP_SET_ROOT_CONSTANTS, { CommandLog::BIND_GRAPHICS, RootParameterIndex, DestOffsetIn32BitValues, 1, CommandLog::Hash(&SrcData, sizeof(UINT)) });
+	mTarget->SetGraphicsRoot32BitConstant(RootParameterIndex, SrcData, DestOffsetIn32BitValues);
+}
+
+void RecordingCommandList::SetComputeRoot32BitConstants(UINT RootParameterIndex, UINT Num32BitValuesToSet, const void* pSrcData, UINT DestOffsetIn32BitValues)
+{
+	Record(CommandLog::OP_SET_ROOT_CONSTANTS, { CommandLog::BIND_COMPUTE, RootParameterIndex, DestOffsetIn32BitValues, Num32BitValuesToSet,
+		CommandLog::Hash(pSrcData, sizeof(UINT) * Num32BitValuesToSet) });
+	mTarget->SetComputeRoot32BitConstants(RootParameterIndex, Num32BitValuesToSet, pSrcData, DestOffsetIn32BitValues);
+}
+
+void RecordingCommandList::SetGraphicsRoot32BitConstants(UINT RootParameterIndex, UINT Num32BitValuesToSet, const void* pSrcData, UINT DestOffsetIn32BitValues)
+{
+	Record(CommandLog::OP_SET_ROOT_CONSTANTS, { CommandLog::BIND_GRAPHICS, RootParameterIndex, DestOffsetIn32BitValues, Num32BitValuesToSet,
+		CommandLog::Hash(pSrcData, sizeof(UINT) * Num32BitValuesToSet) });
+	mTarget->SetGraphicsRoot32BitConstants(RootParameterIndex, Num32BitValuesToSet, pSrcData, DestOffsetIn32BitValues);
+}
+
+void RecordingCommandList::SetComputeRootConstantBufferView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+{
+	Record(CommandLog::OP_SET_ROOT_VIEW, { CommandLog::BIND_COMPUTE, RootParameterIndex, CommandLog::VIEW_CBV, BufferLocation });
+	mTarget->SetComputeRootConstantBufferView(RootParameterIndex, BufferLocation);
+}
+
+void RecordingCommandList::SetGraphicsRootConstantBufferView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+{
+	Record(CommandLog::OP_SET_ROOT_VIEW, { CommandLog::BIND_GRAPHICS, RootParameterIndex, CommandLog::VIEW_CBV, BufferLocation });
+	mTarget->SetGraphicsRootConstantBufferView(RootParameterIndex, BufferLocation);
+}
+
+void RecordingCommandList::SetComputeRootShaderResourceView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+{
+	Record(CommandLog::OP_SET_ROOT_VIEW, { CommandLog::BIND_COMPUTE, RootParameterIndex, CommandLog::VIEW_SRV, BufferLocation });
+	mTarget->SetComputeRootShaderResourceView(RootParameterIndex, BufferLocation);
+}
+
+void RecordingCommandList::SetGraphicsRootShaderResourceView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+{
+	Record(CommandLog::OP_SET_ROOT_VIEW, { CommandLog::BIND_GRAPHICS, RootParameterIndex, CommandLog::VIEW_SRV, BufferLocation });
+	mTarget->SetGraphicsRootShaderResourceView(RootParameterIndex, BufferLocation);
+}
+
+void RecordingCommandList::SetComputeRootUnorderedAccessView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+{
+	Record(CommandLog::OP_SET_ROOT_VIEW, { CommandLog::BIND_COMPUTE, RootParameterIndex, CommandLog::VIEW_UAV, BufferLocation });
+	mTarget->SetComputeRootUnorderedAccessView(RootParameterIndex, BufferLocation);
+}
+
+void RecordingCommandList::SetGraphicsRootUnorderedAccessView(UINT RootParameterIndex, D3D12_GPU_VIRTUAL_ADDRESS BufferLocation)
+{
+	Record(CommandLog::OP_SET_ROOT_VIEW, { CommandLog::BIND_GRAPHICS, RootParameterIndex, CommandLog::VIEW_UAV, BufferLocation });
+	mTarget->SetGraphicsRootUnorderedAccessView(RootParameterIndex, BufferLocation);
+}
+
+void RecordingCommandList::IASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* pView)
+{
+	D3D12_INDEX_BUFFER_VIEW view = {};
+	if (pView)
+		view = *pView;
+	Record(CommandLog::OP_SET_INDEX_BUFFER, { CommandLog::Hash(&view, sizeof(view)) });
+	mTarget->IASetIndexBuffer(pView);
+}
+
+void RecordingCommandList::IASetVertexBuffers(UINT StartSlot, UINT NumViews, const D3D12_VERTEX_BUFFER_VIEW* pViews)
+{
+	Record(CommandLog::OP_SET_VERTEX_BUFFERS, { StartSlot, NumViews, pViews ? CommandLog::Hash(pViews, sizeof(D3D12_VERTEX_BUFFER_VIEW) * NumViews) : 0 });
+	mTarget->IASetVertexBuffers(StartSlot, NumViews, pViews);
+}
+
+void RecordingCommandList::SOSetTargets(UINT StartSlot, UINT NumViews, const D3D12_STREAM_OUTPUT_BUFFER_VIEW* pViews)
+{
+	Record(CommandLog::OP_OTHER, { CommandLog::OTHER_SO_TARGETS });
+	mTarget->SOSetTargets(StartSlot, NumViews, pViews);
+}
+
+void RecordingCommandList::OMSetRenderTargets(UINT NumRenderTargetDescriptors, const D3D12_CPU_DESCRIPTOR_HANDLE* pRenderTargetDescriptors, BOOL RTsSingleHandleToDescriptorRange,
+	const D3D12_CPU_DESCRIPTOR_HANDLE* pDepthStencilDescriptor)
+{
+	// a descriptor range is given by its first handle only
+	UINT handleCount = RTsSingleHandleToDescriptorRange ? (NumRenderTargetDescriptors > 0 ? 1 : 0) : NumRenderTargetDescriptors;
+	uint64_t hash = pRenderTargetDescriptors ? CommandLog::Hash(pRenderTargetDescriptors, sizeof(D3D12_CPU_DESCRIPTOR_HANDLE) * handleCount) : 0;
+	SIZE_T depthStencil = pDepthStencilDescriptor ? pDepthStencilDescriptor->ptr : 0;
+	hash = Utility::HashRange(&depthStencil, sizeof(depthStencil), hash);
+	Record(CommandLog::OP_SET_RENDER_TARGETS, { NumRenderTargetDescriptors, hash });
+	mTarget->OMSetRenderTargets(NumRenderTargetDescriptors, pRenderTargetDescriptors, RTsSingleHandleToDescriptorRange, pDepthStencilDescriptor);
+}
+
+void RecordingCommandList::ClearDepthStencilView(D3D12_CPU_DESCRIPTOR_HANDLE DepthStencilView, D3D12_CLEAR_FLAGS ClearFlags, FLOAT Depth, UINT8 Stencil, UINT NumRects, const D3D12_RECT* pRects)
+{
+	Record(CommandLog::OP_CLEAR, { CommandLog::CLEAR_DSV });
+	mTarget->ClearDepthStencilView(DepthStencilView, ClearFlags, Depth, Stencil, NumRects, pRects);
+}
+
+void RecordingCommandList::ClearRenderTargetView(D3D12_CPU_DESCRIPTOR_HANDLE RenderTargetView, const FLOAT ColorRGBA[4], UINT NumRects, const D3D12_RECT* pRects)
+{
+	Record(CommandLog::OP_CLEAR, { CommandLog::CLEAR_RTV });
+	mTarget->ClearRenderTargetView(RenderTargetView, ColorRGBA, NumRects, pRects);
+}
+
+void RecordingCommandList::ClearUnorderedAccessViewUint(D3D12_GPU_DESCRIPTOR_HANDLE ViewGPUHandleInCurrentHeap, D3D12_CPU_DESCRIPTOR_HANDLE ViewCPUHandle, ID3D12Resource* pResource,
+	const UINT Values[4], UINT NumRects, const D3D12_RECT* pRects)
+{
+	Record(CommandLog::OP_CLEAR, { CommandLog::CLEAR_UAV_UINT });
+	mTarget->ClearUnorderedAccessViewUint(ViewGPUHandleInCurrentHeap, ViewCPUHandle, pResource, Values, NumRects, pRects);
+}
+
+void RecordingCommandList::ClearUnorderedAccessViewFloat(D3D12_GPU_DESCRIPTOR_HANDLE ViewGPUHandleInCurrentHeap, D3D12_CPU_DESCRIPTOR_HANDLE ViewCPUHandle, ID3D12Resource* pResource,
+	const FLOAT Values[4], UINT NumRects, const D3D12_RECT* pRects)
+{
+	Record(CommandLog::OP_CLEAR, { CommandLog::CLEAR_UAV_FLOAT });
+	mTarget->ClearUnorderedAccessViewFloat(ViewGPUHandleInCurrentHeap, ViewCPUHandle, pResource, Values, NumRects, pRects);
+}
+
+void RecordingCommandList::DiscardResource(ID3D12Resource* pResource, const D3D12_DISCARD_REGION* pRegion)
+{
+	Record(CommandLog::OP_OTHER, { CommandLog::OTHER_DISCARD });
+	mTarget->DiscardResource(pResource, pRegion);
+}
+
+void RecordingCommandList::BeginQuery(ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE Type, UINT Index)
+{
+	Record(CommandLog::OP_QUERY, { CommandLog::QUERY_BEGIN });
+	mTarget->BeginQuery(pQueryHeap, Type, Index);
+}
+
+void RecordingCommandList::EndQuery(ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE Type, UINT Index)
+{
+	Record(CommandLog::OP_QUERY, { CommandLog::QUERY_END });
+	mTarget->EndQuery(pQueryHeap, Type, Index);
+}
+
+void RecordingCommandList::ResolveQueryData(ID3D12QueryHeap* pQueryHeap, D3D12_QUERY_TYPE Type, UINT StartIndex, UINT NumQueries, ID3D12Resource* pDestinationBuffer,
+	UINT64 AlignedDestinationBufferOffset)
+{
+	Record(CommandLog::OP_QUERY, { CommandLog::QUERY_RESOLVE });
+	mTarget->ResolveQueryData(pQueryHeap, Type, StartIndex, NumQueries, pDestinationBuffer, AlignedDestinationBufferOffset);
+}
+
+void RecordingCommandList::SetPredication(ID3D12Resource* pBuffer, UINT64 AlignedBufferOffset, D3D12_PREDICATION_OP Operation)
+{
+	Record(CommandLog::OP_OTHER, { CommandLog::OTHER_PREDICATION });
+	mTarget->SetPredication(pBuffer, AlignedBufferOffset, Operation);
+}
+
+void RecordingCommandList::SetMarker(UINT Metadata, const void* pData, UINT Size)
+{
+	Record(CommandLog::OP_OTHER, { CommandLog::OTHER_MARKER });
+	mTarget->SetMarker(Metadata, pData, Size);
+}
+
+void RecordingCommandList::BeginEvent(UINT Metadata, const void* pData, UINT Size)
+{
+	Record(CommandLog::OP_OTHER, { CommandLog::OTHER_BEGIN_EVENT });
+	mTarget->BeginEvent(Metadata, pData, Size);
+}
+
+void RecordingCommandList::EndEvent()
+{
+	Record(CommandLog::OP_OTHER, { CommandLog::OTHER_END_EVENT });
+	mTarget->EndEvent();
+}
+
+void RecordingCommandList::ExecuteIndirect(ID3D12CommandSignature* pCommandSignature, UINT MaxCommandCount, ID3D12Resource* pArgumentBuffer, UINT64 ArgumentBufferOffset,
+	ID3D12Resource* pCountBuffer, UINT64 CountBufferOffset)
+{
+	Record(CommandLog::OP_EXECUTE_INDIRECT, { MaxCommandCount });
+	mTarget->ExecuteIndirect(pCommandSignature, MaxCommandCount, pArgumentBuffer, ArgumentBufferOffset, pCountBuffer, CountBufferOffset);
+}
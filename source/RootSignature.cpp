@@ -12,14 +12,15 @@
 //
 
 #include "RootSignature.h"
-#include<map>
+#include "Hash.h"
+#include "SharedObjectMap.h"
 
 using namespace std;
-static std::map< size_t, ID3D12RootSignature* > s_RootSignatureHashMap;
+static SharedObjectMap< uint64_t, ComPtr<ID3D12RootSignature> > s_RootSignatureHashMap;
 
 void RootSignature::DestroyAll(void)
 {
-    s_RootSignatureHashMap.clear();
+    s_RootSignatureHashMap.Clear();
 }
 
 void RootSignature::InitStaticSampler(
@@ -78,12 +79,127 @@ void RootSignature::InitStaticSampler(
     }
 }
 
+static_assert(RootSignatureLayout::PARAMETER_TABLE == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE &&
+    RootSignatureLayout::PARAMETER_CONSTANTS == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS &&
+    RootSignatureLayout::PARAMETER_CBV == D3D12_ROOT_PARAMETER_TYPE_CBV &&
+    RootSignatureLayout::PARAMETER_SRV == D3D12_ROOT_PARAMETER_TYPE_SRV &&
+    RootSignatureLayout::PARAMETER_UAV == D3D12_ROOT_PARAMETER_TYPE_UAV, "RootSignatureLayout::ParameterType");
+static_assert(RootSignatureLayout::RANGE_SRV == D3D12_DESCRIPTOR_RANGE_TYPE_SRV &&
+    RootSignatureLayout::RANGE_UAV == D3D12_DESCRIPTOR_RANGE_TYPE_UAV &&
+    RootSignatureLayout::RANGE_CBV == D3D12_DESCRIPTOR_RANGE_TYPE_CBV &&
+    RootSignatureLayout::RANGE_SAMPLER == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, "RootSignatureLayout::RangeType");
+static_assert(RootSignatureLayout::VISIBILITY_ALL == D3D12_SHADER_VISIBILITY_ALL &&
+    RootSignatureLayout::VISIBILITY_VERTEX == D3D12_SHADER_VISIBILITY_VERTEX &&
+    RootSignatureLayout::VISIBILITY_HULL == D3D12_SHADER_VISIBILITY_HULL &&
+    RootSignatureLayout::VISIBILITY_DOMAIN == D3D12_SHADER_VISIBILITY_DOMAIN &&
+    RootSignatureLayout::VISIBILITY_GEOMETRY == D3D12_SHADER_VISIBILITY_GEOMETRY &&
+    RootSignatureLayout::VISIBILITY_PIXEL == D3D12_SHADER_VISIBILITY_PIXEL, "RootSignatureLayout::Visibility");
+static_assert(RootSignatureLayout::MAX_DWORD_COST == D3D12_MAX_ROOT_COST &&
+    RootSignatureLayout::UNBOUNDED == D3D12_DESCRIPTOR_RANGE_UNBOUNDED, "RootSignatureLayout limits");
+
+void RootSignature::Reset(const RootSignatureLayout& Layout)
+{
+    const std::vector<RootSignatureLayout::Parameter>& Parameters = Layout.GetParameters();
+    Reset((UINT)Parameters.size(), (UINT)Layout.GetStaticSamplers().size());
+
+    for (UINT Param = 0; Param < m_NumParameters; ++Param)
+    {
+        const RootSignatureLayout::Parameter& Parameter = Parameters[Param];
+        RootParameter& RootParam = m_ParamArray[Param];
+        D3D12_SHADER_VISIBILITY Visibility = (D3D12_SHADER_VISIBILITY)Parameter.mVisibility;
+        switch (Parameter.mType)
+        {
+        case RootSignatureLayout::PARAMETER_CONSTANTS:
+            RootParam.InitAsConstants(Parameter.mRegister, Parameter.mConstantCount, Visibility);
+            RootParam.m_RootParam.Constants.RegisterSpace = Parameter.mSpace;
+            break;
+        case RootSignatureLayout::PARAMETER_CBV:
+        case RootSignatureLayout::PARAMETER_SRV:
+        case RootSignatureLayout::PARAMETER_UAV:
+            RootParam.InitAsConstantBuffer(Parameter.mRegister, Visibility);
+            RootParam.m_RootParam.ParameterType = (D3D12_ROOT_PARAMETER_TYPE)Parameter.mType;
+            RootParam.m_RootParam.Descriptor.RegisterSpace = Parameter.mSpace;
+            break;
+        case RootSignatureLayout::PARAMETER_TABLE:
+            RootParam.InitAsDescriptorTable((UINT)Parameter.mRanges.size(), Visibility);
+            for (UINT Range = 0; Range < (UINT)Parameter.mRanges.size(); ++Range)
+            {
+                const RootSignatureLayout::Range& LayoutRange = Parameter.mRanges[Range];
+                RootParam.SetTableRange(Range, (D3D12_DESCRIPTOR_RANGE_TYPE)LayoutRange.mType, LayoutRange.mRegister, LayoutRange.mCount, LayoutRange.mSpace);
+            }
+            break;
+        }
+    }
+}
+
+RootSignatureLayout RootSignature::GetLayout() const
+{
+    RootSignatureLayout Layout;
+    for (UINT Param = 0; Param < m_NumParameters; ++Param)
+    {
+        const D3D12_ROOT_PARAMETER& RootParam = m_ParamArray[Param]();
+        RootSignatureLayout::Visibility Visibility = (RootSignatureLayout::Visibility)RootParam.ShaderVisibility;
+        switch (RootParam.ParameterType)
+        {
+        case D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS:
+            Layout.AddConstants(RootParam.Constants.ShaderRegister, RootParam.Constants.Num32BitValues, Visibility, RootParam.Constants.RegisterSpace);
+            break;
+        case D3D12_ROOT_PARAMETER_TYPE_CBV:
+        case D3D12_ROOT_PARAMETER_TYPE_SRV:
+        case D3D12_ROOT_PARAMETER_TYPE_UAV:
+            Layout.AddDescriptor((RootSignatureLayout::ParameterType)RootParam.ParameterType, RootParam.Descriptor.ShaderRegister, Visibility, RootParam.Descriptor.RegisterSpace);
+            break;
+        case D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE:
+        {
+            std::vector<RootSignatureLayout::Range> Ranges;
+            for (UINT Range = 0; Range < RootParam.DescriptorTable.NumDescriptorRanges; ++Range)
+            {
+                const D3D12_DESCRIPTOR_RANGE& TableRange = RootParam.DescriptorTable.pDescriptorRanges[Range];
+                Ranges.push_back({ (RootSignatureLayout::RangeType)TableRange.RangeType, TableRange.BaseShaderRegister, TableRange.NumDescriptors, TableRange.RegisterSpace });
+            }
+            Layout.AddTable(Ranges, Visibility);
+            break;
+        }
+        default:
+            // not initialized, Validate() reports it
+            Layout.AddDescriptor(RootSignatureLayout::PARAMETER_UNINITIALIZED, 0);
+            break;
+        }
+    }
+
+    for (UINT Sampler = 0; Sampler < m_NumInitializedStaticSamplers; ++Sampler)
+    {
+        const D3D12_STATIC_SAMPLER_DESC& SamplerDesc = m_SamplerArray[Sampler];
+        Layout.AddStaticSampler(SamplerDesc.ShaderRegister, (RootSignatureLayout::Visibility)SamplerDesc.ShaderVisibility, SamplerDesc.RegisterSpace);
+    }
+    return Layout;
+}
+
+UINT RootSignature::GetDWORDCost() const
+{
+    return GetLayout().GetDWORDCost();
+}
+
+bool RootSignature::Validate(std::string* Error) const
+{
+    return GetLayout().Validate(Error);
+}
+
 void RootSignature::Finalize(ID3D12Device* device, const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAGS Flags)
 {
     if (m_Finalized)
         return;
 
     assert(m_NumInitializedStaticSamplers == m_NumSamplers);
+#if defined(_DEBUG)
+    std::string LayoutError;
+    if (!Validate(&LayoutError))
+    {
+        OutputDebugStringW(name.c_str());
+        OutputDebugStringA((": " + LayoutError + "\n").c_str());
+    }
+    assert(LayoutError.empty());
+#endif
 
     D3D12_ROOT_SIGNATURE_DESC RootDesc;
     RootDesc.NumParameters = m_NumParameters;
@@ -95,22 +211,27 @@ void RootSignature::Finalize(ID3D12Device* device, const std::wstring& name, D3D
     m_DescriptorTableBitMap = 0;
     m_SamplerTableBitMap = 0;
 
-    // size_t HashCode = Utility::HashState(&RootDesc.Flags);
-    // HashCode = Utility::HashState( RootDesc.pStaticSamplers, m_NumSamplers, HashCode );
+    uint64_t HashCode = Utility::HashState(&RootDesc.Flags);
+    HashCode = Utility::HashState(RootDesc.pStaticSamplers, m_NumSamplers, HashCode);
 
     for (UINT Param = 0; Param < m_NumParameters; ++Param)
     {
         const D3D12_ROOT_PARAMETER& RootParam = RootDesc.pParameters[Param];
         m_DescriptorTableSize[Param] = 0;
 
+        // RootParameter is not zero-initialized, so only the members of the active union field are hashed
+        HashCode = Utility::HashState(&RootParam.ParameterType, 1, HashCode);
+        HashCode = Utility::HashState(&RootParam.ShaderVisibility, 1, HashCode);
+
         if (RootParam.ParameterType == D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE)
         {
             assert(RootParam.DescriptorTable.pDescriptorRanges != nullptr);
 
-            //  HashCode = Utility::HashState( RootParam.DescriptorTable.pDescriptorRanges,
-             //     RootParam.DescriptorTable.NumDescriptorRanges, HashCode );
+            HashCode = Utility::HashState(&RootParam.DescriptorTable.NumDescriptorRanges, 1, HashCode);
+            HashCode = Utility::HashState(RootParam.DescriptorTable.pDescriptorRanges,
+                RootParam.DescriptorTable.NumDescriptorRanges, HashCode);
 
-              // We keep track of sampler descriptor tables separately from CBV_SRV_UAV descriptor tables
+            // We keep track of sampler descriptor tables separately from CBV_SRV_UAV descriptor tables
             if (RootParam.DescriptorTable.pDescriptorRanges->RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER)
                 m_SamplerTableBitMap |= (1 << Param);
             else
@@ -119,47 +240,27 @@ void RootSignature::Finalize(ID3D12Device* device, const std::wstring& name, D3D
             for (UINT TableRange = 0; TableRange < RootParam.DescriptorTable.NumDescriptorRanges; ++TableRange)
                 m_DescriptorTableSize[Param] += RootParam.DescriptorTable.pDescriptorRanges[TableRange].NumDescriptors;
         }
-        // else
-        //     HashCode = Utility::HashState( &RootParam, 1, HashCode );
+        else if (RootParam.ParameterType == D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS)
+            HashCode = Utility::HashState(&RootParam.Constants, 1, HashCode);
+        else
+            HashCode = Utility::HashState(&RootParam.Descriptor, 1, HashCode);
     }
 
-    ID3D12RootSignature** RSRef = nullptr;
-    bool firstCompile = true;
-    //{
-    //    static mutex s_HashMapMutex;
-    //    lock_guard<mutex> CS(s_HashMapMutex);
-    //    auto iter = s_RootSignatureHashMap.find(HashCode);
-
-    //    // Reserve space so the next inquiry will find that someone got here first.
-    //    if (iter == s_RootSignatureHashMap.end())
-    //    {
-    //        RSRef = s_RootSignatureHashMap[HashCode].GetAddressOf();
-    //        firstCompile = true;
-    //    }
-    //    else
-    //        RSRef = iter->second.GetAddressOf();
-    //}
-
-    if (firstCompile)
-    {
+    m_Hash = HashCode;
+
+    // The first Finalize of a hash creates the root signature, the others wait for it (or for its exception)
+    m_Signature = s_RootSignatureHashMap.GetOrCreate(HashCode, [&]() {
         ComPtr<ID3DBlob> pOutBlob, pErrorBlob;
 
         ThrowIfFailed(D3D12SerializeRootSignature(&RootDesc, D3D_ROOT_SIGNATURE_VERSION_1,
             pOutBlob.GetAddressOf(), pErrorBlob.GetAddressOf()));
 
-        ThrowIfFailed(device->CreateRootSignature(1, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&m_Signature)));
+        ComPtr<ID3D12RootSignature> Signature;
+        ThrowIfFailed(device->CreateRootSignature(1, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&Signature)));
 
-        m_Signature->SetName(name.c_str());
-
-        // s_RootSignatureHashMap[HashCode].Attach(m_Signature);
-        // assert(*RSRef == m_Signature);
-    }
-    else
-    {
-        //while (*RSRef == nullptr)
-        //    this_thread::yield();
-        //m_Signature = *RSRef;
-    }
+        Signature->SetName(name.c_str());
+        return Signature;
+    });
 
     m_Finalized = TRUE;
 }
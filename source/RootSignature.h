@@ -14,6 +14,7 @@
 #pragma once
 
 #include "Common.h"
+#include "RootSignatureLayout.h"
 
 class RootParameter
 {
@@ -114,7 +115,7 @@ class RootSignature
 
 public:
 
-    RootSignature(UINT NumRootParams = 0, UINT NumStaticSamplers = 0) : m_Finalized(FALSE), m_NumParameters(NumRootParams)
+    RootSignature(UINT NumRootParams = 0, UINT NumStaticSamplers = 0) : m_Finalized(FALSE), m_Hash(0), m_NumParameters(NumRootParams)
     {
         Reset(NumRootParams, NumStaticSamplers);
     }
@@ -140,8 +141,16 @@ public:
             m_SamplerArray = nullptr;
         m_NumSamplers = NumStaticSamplers;
         m_NumInitializedStaticSamplers = 0;
+        m_Finalized = FALSE;
     }
 
+    // Takes the parameters of a device-free layout; its static samplers are only counted and still need
+    // InitStaticSampler in the same order
+    void Reset(const RootSignatureLayout& Layout);
+
+    // The parameters and the static samplers initialized so far as plain data
+    RootSignatureLayout GetLayout() const;
+
     RootParameter& operator[] (size_t EntryIndex)
     {
         assert(EntryIndex < m_NumParameters);
@@ -161,9 +170,20 @@ public:
 
     ID3D12RootSignature* GetSignature() const { return m_Signature.Get(); }
 
+    // Hash of the full description, valid after Finalize(). Identical layouts share one ID3D12RootSignature.
+    uint64_t GetHash() const { return m_Hash; }
+
+    // Total root argument size in DWORDs, must not exceed D3D12_MAX_ROOT_COST (64)
+    UINT GetDWORDCost() const;
+
+    // RootSignatureLayout::Validate of GetLayout(): the root argument budget and register clashes
+    // between bindings visible to the same stage. Asserted by Finalize().
+    bool Validate(std::string* Error = nullptr) const;
+
 protected:
 
     BOOL m_Finalized;
+    uint64_t m_Hash;
     UINT m_NumParameters;
     UINT m_NumSamplers;
     UINT m_NumInitializedStaticSamplers;
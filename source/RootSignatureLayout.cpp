@@ -0,0 +1,145 @@
+#include "RootSignatureLayout.h"
+
+namespace
+{
+	// A register interval one binding occupies, in the register class of its range type
+	struct Binding
+	{
+		RootSignatureLayout::RangeType mType;
+		uint32_t mSpace;
+		uint64_t mBegin, mEnd;
+		RootSignatureLayout::Visibility mVisibility;
+		std::string mName;
+	};
+
+	const char* RegisterPrefix(RootSignatureLayout::RangeType type)
+	{
+		switch (type)
+		{
+		case RootSignatureLayout::RANGE_SRV: return "t";
+		case RootSignatureLayout::RANGE_UAV: return "u";
+		case RootSignatureLayout::RANGE_CBV: return "b";
+		default: return "s";
+		}
+	}
+
+	bool Overlaps(const Binding& a, const Binding& b)
+	{
+		return a.mType == b.mType && a.mSpace == b.mSpace && a.mBegin < b.mEnd && b.mBegin < a.mEnd &&
+			(a.mVisibility == RootSignatureLayout::VISIBILITY_ALL || b.mVisibility == RootSignatureLayout::VISIBILITY_ALL || a.mVisibility == b.mVisibility);
+	}
+}
+
+uint32_t RootSignatureLayout::AddConstants(uint32_t shaderRegister, uint32_t count, Visibility visibility, uint32_t space)
+{
+	mParameters.push_back({ PARAMETER_CONSTANTS, visibility, shaderRegister, space, count, {} });
+	return uint32_t(mParameters.size() - 1);
+}
+
+uint32_t RootSignatureLayout::AddDescriptor(ParameterType type, uint32_t shaderRegister, Visibility visibility, uint32_t space)
+{
+	mParameters.push_back({ type, visibility, shaderRegister, space, 0, {} });
+	return uint32_t(mParameters.size() - 1);
+}
+
+uint32_t RootSignatureLayout::AddTable(const std::vector<Range>& ranges, Visibility visibility)
+{
+	mParameters.push_back({ PARAMETER_TABLE, visibility, 0, 0, 0, ranges });
+	return uint32_t(mParameters.size() - 1);
+}
+
+void RootSignatureLayout::AddStaticSampler(uint32_t shaderRegister, Visibility visibility, uint32_t space)
+{
+	mStaticSamplers.push_back({ shaderRegister, space, visibility });
+}
+
+uint32_t RootSignatureLayout::GetDWORDCost(const Parameter& parameter)
+{
+	switch (parameter.mType)
+	{
+	case PARAMETER_CONSTANTS:
+		return parameter.mConstantCount;
+	case PARAMETER_CBV:
+	case PARAMETER_SRV:
+	case PARAMETER_UAV:
+		return 2;
+	case PARAMETER_TABLE:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+uint32_t RootSignatureLayout::GetDWORDCost() const
+{
+	uint32_t cost = 0;
+	for (const Parameter& parameter : mParameters)
+		cost += GetDWORDCost(parameter);
+	return cost;
+}
+
+bool RootSignatureLayout::Validate(std::string* error) const
+{
+	auto fail = [error](const std::string& message) {
+		if (error)
+			*error = message;
+		return false;
+	};
+
+	uint32_t cost = GetDWORDCost();
+	if (cost > MAX_DWORD_COST)
+		return fail(std::to_string(cost) + " DWORDs of root arguments, at most " + std::to_string(MAX_DWORD_COST) + " fit");
+
+	std::vector<Binding> bindings;
+	for (size_t i = 0; i < mParameters.size(); i++)
+	{
+		const Parameter& parameter = mParameters[i];
+		std::string name = "parameter " + std::to_string(i);
+		switch (parameter.mType)
+		{
+		case PARAMETER_CONSTANTS:
+		case PARAMETER_CBV:
+			bindings.push_back({ RANGE_CBV, parameter.mSpace, parameter.mRegister, uint64_t(parameter.mRegister) + 1, parameter.mVisibility, name });
+			break;
+		case PARAMETER_SRV:
+			bindings.push_back({ RANGE_SRV, parameter.mSpace, parameter.mRegister, uint64_t(parameter.mRegister) + 1, parameter.mVisibility, name });
+			break;
+		case PARAMETER_UAV:
+			bindings.push_back({ RANGE_UAV, parameter.mSpace, parameter.mRegister, uint64_t(parameter.mRegister) + 1, parameter.mVisibility, name });
+			break;
+		case PARAMETER_TABLE:
+			for (size_t r = 0; r < parameter.mRanges.size(); r++)
+			{
+				const Range& range = parameter.mRanges[r];
+				if ((range.mType == RANGE_SAMPLER) != (parameter.mRanges[0].mType == RANGE_SAMPLER))
+					return fail(name + " mixes sampler and view ranges in one table");
+				uint64_t end = range.mCount == UNBOUNDED ? uint64_t(UNBOUNDED) + 1 : uint64_t(range.mRegister) + range.mCount;
+				bindings.push_back({ range.mType, range.mSpace, range.mRegister, end, parameter.mVisibility, name + " range " + std::to_string(r) });
+			}
+			break;
+		default:
+			return fail(name + " has no type");
+		}
+	}
+	for (size_t i = 0; i < mStaticSamplers.size(); i++)
+	{
+		const StaticSampler& sampler = mStaticSamplers[i];
+		bindings.push_back({ RANGE_SAMPLER, sampler.mSpace, sampler.mRegister, uint64_t(sampler.mRegister) + 1, sampler.mVisibility, "static sampler " + std::to_string(i) });
+	}
+
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		for (size_t j = i + 1; j < bindings.size(); j++)
+		{
+			const Binding& a = bindings[i];
+			const Binding& b = bindings[j];
+			if (Overlaps(a, b))
+			{
+				uint64_t shared = a.mBegin > b.mBegin ? a.mBegin : b.mBegin;
+				return fail(a.mName + " and " + b.mName + " both bind " + RegisterPrefix(a.mType) + std::to_string(shared) +
+					", space" + std::to_string(a.mSpace));
+			}
+		}
+	}
+	return true;
+}
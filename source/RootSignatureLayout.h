@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Root signature description as plain data: what RootSignature::Finalize serializes, without the D3D12 headers, so
+// its DWORD cost and register clashes can be computed and checked anywhere. The enums carry the values of
+// D3D12_ROOT_PARAMETER_TYPE, D3D12_DESCRIPTOR_RANGE_TYPE and D3D12_SHADER_VISIBILITY.
+class RootSignatureLayout
+{
+public:
+	// PARAMETER_UNINITIALIZED is what RootParameter holds until one of its Init functions ran
+	enum ParameterType { PARAMETER_TABLE = 0, PARAMETER_CONSTANTS = 1, PARAMETER_CBV = 2, PARAMETER_SRV = 3, PARAMETER_UAV = 4, PARAMETER_UNINITIALIZED = 0x7FFFFFFF };
+	enum RangeType { RANGE_SRV = 0, RANGE_UAV = 1, RANGE_CBV = 2, RANGE_SAMPLER = 3 };
+	enum Visibility { VISIBILITY_ALL = 0, VISIBILITY_VERTEX = 1, VISIBILITY_HULL = 2, VISIBILITY_DOMAIN = 3, VISIBILITY_GEOMETRY = 4, VISIBILITY_PIXEL = 5 };
+
+	// D3D12_MAX_ROOT_COST
+	static const uint32_t MAX_DWORD_COST = 64;
+	// D3D12_DESCRIPTOR_RANGE_UNBOUNDED (UINT_MAX) as a range count
+	static const uint32_t UNBOUNDED = 0xFFFFFFFFu;
+
+	struct Range
+	{
+		RangeType mType;
+		uint32_t mRegister;
+		uint32_t mCount;
+		uint32_t mSpace;
+	};
+
+	struct Parameter
+	{
+		ParameterType mType;
+		Visibility mVisibility;
+		// root constants and root descriptors, tables use mRanges
+		uint32_t mRegister;
+		uint32_t mSpace;
+		uint32_t mConstantCount;
+		std::vector<Range> mRanges;
+	};
+
+	struct StaticSampler
+	{
+		uint32_t mRegister;
+		uint32_t mSpace;
+		Visibility mVisibility;
+	};
+
+	uint32_t AddConstants(uint32_t shaderRegister, uint32_t count, Visibility visibility = VISIBILITY_ALL, uint32_t space = 0);
+	uint32_t AddDescriptor(ParameterType type, uint32_t shaderRegister, Visibility visibility = VISIBILITY_ALL, uint32_t space = 0);
+	uint32_t AddTable(const std::vector<Range>& ranges, Visibility visibility = VISIBILITY_ALL);
+	void AddStaticSampler(uint32_t shaderRegister, Visibility visibility = VISIBILITY_ALL, uint32_t space = 0);
+
+	const std::vector<Parameter>& GetParameters() const { return mParameters; }
+	const std::vector<StaticSampler>& GetStaticSamplers() const { return mStaticSamplers; }
+
+	// Root constants cost 1 DWORD each, root descriptors 2, a table 1 and static samplers nothing
+	static uint32_t GetDWORDCost(const Parameter& parameter);
+	uint32_t GetDWORDCost() const;
+
+	// False if the cost is above MAX_DWORD_COST or two bindings a shader stage sees at the same time share a
+	// register: root constants and root CBVs count as one b register, root SRVs and UAVs as one t or u register,
+	// table ranges as their registers and static samplers as one s register, all in their space. Visibility ALL
+	// overlaps every stage. error names the first problem.
+	bool Validate(std::string* error = nullptr) const;
+
+private:
+	std::vector<Parameter> mParameters;
+	std::vector<StaticSampler> mStaticSamplers;
+};
@@ -0,0 +1,111 @@
+#include "Sampling.h"
+
+#include <cmath>
+
+namespace
+{
+	const uint32_t Primes[Sampling::HALTON_MAX_DIMENSIONS] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53 };
+}
+
+void PCG32::Seed(uint64_t seed, uint64_t stream)
+{
+	// pcg32_srandom_r
+	mState = 0;
+	mIncrement = (stream << 1) | 1;
+	Next();
+	mState += seed;
+	Next();
+}
+
+uint32_t PCG32::Next()
+{
+	uint64_t state = mState;
+	mState = state * 6364136223846793005ull + mIncrement;
+	uint32_t xorShifted = uint32_t(((state >> 18) ^ state) >> 27);
+	uint32_t rotation = uint32_t(state >> 59);
+	return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+}
+
+uint32_t PCG32::NextBounded(uint32_t bound)
+{
+	if (bound == 0)
+		return 0;
+	// rejects the 2^32 % bound lowest outputs
+	uint32_t threshold = (0u - bound) % bound;
+	for (;;)
+	{
+		uint32_t value = Next();
+		if (value >= threshold)
+			return value % bound;
+	}
+}
+
+float Sampling::RadicalInverse(uint32_t index, uint32_t base)
+{
+	double inverseBase = 1.0 / double(base);
+	double factor = inverseBase;
+	double result = 0.0;
+	for (; index > 0; index /= base)
+	{
+		result += double(index % base) * factor;
+		factor *= inverseBase;
+	}
+	// below 1 after rounding to float
+	return float(std::fmin(result, 0.99999994));
+}
+
+float Sampling::Halton(uint32_t index, uint32_t dimension)
+{
+	return RadicalInverse(index, Primes[dimension % HALTON_MAX_DIMENSIONS]);
+}
+
+uint32_t Sampling::SobolBits(uint32_t index, uint32_t dimension)
+{
+	if (dimension == 0)
+		return ReverseBits(index);
+
+	// direction numbers of x + 1: v_0 = 1/2, v_k = v_(k-1) ^ (v_(k-1) >> 1)
+	uint32_t result = 0;
+	for (uint32_t direction = 1u << 31; index != 0; index >>= 1, direction ^= direction >> 1)
+	{
+		if (index & 1)
+			result ^= direction;
+	}
+	return result;
+}
+
+uint32_t Sampling::OwenScramble(uint32_t bits, uint32_t seed)
+{
+	// a hash in which every bit only depends on the bits below it, applied to the reversed fraction: each digit is
+	// flipped depending on the digits above it, Owen's nested uniform scrambling
+	uint32_t x = ReverseBits(bits);
+	x += seed;
+	x ^= x * 0x6C50B47Cu;
+	x ^= x * 0xB82F1E52u;
+	x ^= x * 0xC7AFE638u;
+	x ^= x * 0x8D22F6E6u;
+	return ReverseBits(x);
+}
+
+void Sampling::R2(uint32_t index, float result[2])
+{
+	result[0] = ToFloat(0x80000000u + index * R2_STEP_X);
+	result[1] = ToFloat(0x80000000u + index * R2_STEP_Y);
+}
+
+float Sampling::Rotate(float value, float offset)
+{
+	float result = value + offset;
+	result -= std::floor(result);
+	return result < 1.0f ? result : 0.0f;
+}
+
+uint32_t Sampling::ReverseBits(uint32_t bits)
+{
+	bits = (bits << 16) | (bits >> 16);
+	bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+	bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+	bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+	bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+	return bits;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+// Random numbers and sample sequences for the stochastic passes (RSM, SSAO, RTAO) and the scene setup. They replace
+// rand(), which keeps hidden global state, is not thread safe and has only 15 bits on MSVC.
+//   PCG32   O'Neill's permuted congruential generator (XSH RR): 64 bit state, 32 bit output, 2^63 selectable streams
+//   Halton  radical inverses in the first 16 prime bases, one base per dimension
+//   Sobol   the first two Sobol dimensions, a (0,2) sequence: every prefix of 2^m points puts exactly one point in each
+//           elementary interval of area 2^-m, so a quality tier that takes fewer RSM samples still takes a stratified
+//           subset. Owen scrambling (Laine-Karras hashing, Burley 2020) decorrelates seeds and keeps that property.
+//   R2      Roberts' additive recurrence on the plastic constant, low discrepancy for any count
+// A Cranley-Patterson rotation (toroidal shift) by R2 of the frame number gives every frame a different point set of
+// the same quality. Sequences are computed in 32 bit fixed point, floats are in [0, 1).
+// Only uses the standard library.
+class PCG32
+{
+public:
+    explicit PCG32(uint64_t seed = 0x853C49E6748FEA9Bull, uint64_t stream = 0xDA3E39CB94B95BDBull) { Seed(seed, stream); }
+
+    void Seed(uint64_t seed, uint64_t stream);
+    uint32_t Next();
+    // Uniform in [0, bound) without modulo bias
+    uint32_t NextBounded(uint32_t bound);
+    // 24 bits, uniform in [0, 1)
+    float NextFloat() { return float(Next() >> 8) * (1.0f / 16777216.0f); }
+    float NextFloat(float a, float b) { return a + NextFloat() * (b - a); }
+
+private:
+    uint64_t mState = 0;
+    uint64_t mIncrement = 1;
+};
+
+class Sampling
+{
+public:
+    static constexpr uint32_t HALTON_MAX_DIMENSIONS = 16;
+    // Fractional parts of the R2 (1 / plastic constant and its square) and R1 (golden ratio) steps in 32 bit
+    static constexpr uint32_t R2_STEP_X = 3242174889u;
+    static constexpr uint32_t R2_STEP_Y = 2447445414u;
+    static constexpr uint32_t R1_STEP = 2654435769u;
+
+    static float ToFloat(uint32_t bits) { return float(bits >> 8) * (1.0f / 16777216.0f); }
+
+    static float RadicalInverse(uint32_t index, uint32_t base);
+    static float Halton(uint32_t index, uint32_t dimension);
+
+    // Dimension 0 or 1, as bits of the fraction
+    static uint32_t SobolBits(uint32_t index, uint32_t dimension);
+    static float Sobol(uint32_t index, uint32_t dimension) { return ToFloat(SobolBits(index, dimension)); }
+    // Owen scrambled, use a different seed per dimension
+    static float ScrambledSobol(uint32_t index, uint32_t dimension, uint32_t seed) { return ToFloat(OwenScramble(SobolBits(index, dimension), seed)); }
+    static uint32_t OwenScramble(uint32_t bits, uint32_t seed);
+
+    static float R1(uint32_t index) { return ToFloat(0x80000000u + index * R1_STEP); }
+    static void R2(uint32_t index, float result[2]);
+
+    // Toroidal shift of a sample in [0, 1), same uniformity, different points
+    static float Rotate(float value, float offset);
+    // Offset of the Cranley-Patterson rotation for a frame
+    static void GetFrameRotation(uint32_t frame, float rotation[2]) { R2(frame, rotation); }
+
+    static uint32_t ReverseBits(uint32_t bits);
+};
@@ -0,0 +1,196 @@
+#include "ShaderCache.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace {
+	const uint32_t EntryMagic = 0x43485344; // 'DSHC'
+
+	bool ReadFile(const std::filesystem::path& path, std::string& out)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+
+		std::stringstream stream;
+		stream << file.rdbuf();
+		out = stream.str();
+		return true;
+	}
+}
+
+std::vector<std::filesystem::path> ShaderCache::ParseIncludes(const std::string& source, const std::filesystem::path& includingFile)
+{
+	std::vector<std::filesystem::path> includes;
+	std::istringstream stream(source);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		size_t pos = line.find_first_not_of(" \t");
+		if (pos == std::string::npos || line.compare(pos, 8, "#include") != 0)
+			continue;
+
+		size_t open = line.find_first_of("\"<", pos + 8);
+		if (open == std::string::npos)
+			continue;
+
+		size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+		if (close == std::string::npos)
+			continue;
+
+		std::filesystem::path include = includingFile.parent_path() / line.substr(open + 1, close - open - 1);
+		includes.push_back(include.lexically_normal());
+	}
+	return includes;
+}
+
+bool ShaderCache::GetFileInfo(const std::filesystem::path& path, FileInfo& info)
+{
+	{
+		std::lock_guard<std::mutex> lock(mFilesMutex);
+		auto it = mFiles.find(path);
+		if (it != mFiles.end())
+		{
+			info = it->second;
+			return true;
+		}
+	}
+
+	std::string source;
+	if (!ReadFile(path, source))
+		return false;
+
+	info.mHash = Utility::HashRange(source.data(), source.size());
+	info.mIncludes = ParseIncludes(source, path);
+
+	std::lock_guard<std::mutex> lock(mFilesMutex);
+	mFiles[path] = info;
+	return true;
+}
+
+bool ShaderCache::HashFileRecursive(const std::filesystem::path& path, std::vector<std::filesystem::path>& visited, uint64_t& hash)
+{
+	if (std::find(visited.begin(), visited.end(), path) != visited.end())
+		return true;
+	visited.push_back(path);
+
+	FileInfo info;
+	if (!GetFileInfo(path, info))
+		return false;
+
+	hash = Utility::HashState(&info.mHash, 1, hash);
+	for (auto& include : info.mIncludes)
+	{
+		if (!HashFileRecursive(include, visited, hash))
+			return false;
+	}
+	return true;
+}
+
+bool ShaderCache::ComputeKey(const Request& request, uint64_t& key)
+{
+	uint64_t hash = Utility::HashState(&Version);
+	hash = Utility::HashString(request.mEntryPoint.c_str(), hash);
+	hash = Utility::HashString(request.mTarget.c_str(), hash);
+	hash = Utility::HashState(&request.mFlags, 1, hash);
+	hash = Utility::HashState(&request.mCompilerVersion, 1, hash);
+	for (auto& define : request.mDefines)
+	{
+		hash = Utility::HashString(define.first.c_str(), hash);
+		hash = Utility::HashString(define.second.c_str(), hash);
+	}
+
+	std::vector<std::filesystem::path> visited;
+	if (!HashFileRecursive(request.mPath.lexically_normal(), visited, hash))
+		return false;
+
+	key = hash;
+	return true;
+}
+
+uint64_t ShaderCache::GetCompilerVersion(const std::filesystem::path& compilerFile)
+{
+	std::error_code error;
+	uint64_t size = std::filesystem::file_size(compilerFile, error);
+	if (error)
+		return 0;
+	int64_t time = std::filesystem::last_write_time(compilerFile, error).time_since_epoch().count();
+	if (error)
+		return 0;
+
+	uint64_t hash = Utility::HashState(&size);
+	return Utility::HashState(&time, 1, hash);
+}
+
+std::filesystem::path ShaderCache::GetEntryPath(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.cso", static_cast<unsigned long long>(key));
+	return mDirectory / name;
+}
+
+bool ShaderCache::Load(uint64_t key, std::vector<uint8_t>& bytecode) const
+{
+	std::string data;
+	if (mDirectory.empty() || !ReadFile(GetEntryPath(key), data))
+		return false;
+
+	// header: magic, key, size - guards against truncated writes and file name collisions
+	const size_t headerSize = sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint64_t);
+	if (data.size() < headerSize)
+		return false;
+
+	uint32_t magic;
+	uint64_t storedKey, size;
+	memcpy(&magic, data.data(), sizeof(magic));
+	memcpy(&storedKey, data.data() + sizeof(magic), sizeof(storedKey));
+	memcpy(&size, data.data() + sizeof(magic) + sizeof(storedKey), sizeof(size));
+	if (magic != EntryMagic || storedKey != key || size != data.size() - headerSize)
+		return false;
+
+	bytecode.assign(data.begin() + headerSize, data.end());
+	return true;
+}
+
+bool ShaderCache::Store(uint64_t key, const void* bytecode, size_t size) const
+{
+	if (mDirectory.empty())
+		return false;
+
+	std::error_code ec;
+	std::filesystem::create_directories(mDirectory, ec);
+
+	// write to a temporary file first so a concurrent reader never sees a partial entry
+	std::filesystem::path path = GetEntryPath(key);
+	std::filesystem::path tempPath = path;
+	tempPath += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		uint64_t size64 = size;
+		file.write(reinterpret_cast<const char*>(&EntryMagic), sizeof(EntryMagic));
+		file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+		file.write(reinterpret_cast<const char*>(&size64), sizeof(size64));
+		file.write(static_cast<const char*>(bytecode), size);
+		if (!file)
+			return false;
+	}
+
+	std::filesystem::rename(tempPath, path, ec);
+	return !ec;
+}
+
+void ShaderCache::InvalidateFile(const std::filesystem::path& path)
+{
+	std::lock_guard<std::mutex> lock(mFilesMutex);
+	if (path.empty())
+		mFiles.clear();
+	else
+		mFiles.erase(path.lexically_normal());
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Content-addressed store of compiled shader bytecode.
+// The key covers everything that affects the output: the source file, every file it pulls in through
+// #include "..." (resolved recursively relative to the including file), macro definitions, entry point,
+// target profile and compile flags. Editing Common.hlsl therefore changes the key of every shader that
+// includes it. Only uses the standard library, the D3DCompiler/DXC glue lives in DXRSGraphics.
+class ShaderCache
+{
+public:
+    // Bump when the key layout changes to invalidate all stored entries, compiler updates are covered by
+    // Request::mCompilerVersion
+    static constexpr uint32_t Version = 2;
+
+    struct Request
+    {
+        std::filesystem::path mPath;
+        std::string mEntryPoint;
+        std::string mTarget;
+        std::vector<std::pair<std::string, std::string>> mDefines;
+        uint32_t mFlags = 0;
+        // GetCompilerVersion of the compiler DLL that compiles the request
+        uint64_t mCompilerVersion = 0;
+    };
+
+    void SetDirectory(const std::filesystem::path& directory) { mDirectory = directory; }
+    const std::filesystem::path& GetDirectory() const { return mDirectory; }
+
+    // Returns false if the source file (or one of its includes) cannot be read
+    bool ComputeKey(const Request& request, uint64_t& key);
+
+    bool Load(uint64_t key, std::vector<uint8_t>& bytecode) const;
+    bool Store(uint64_t key, const void* bytecode, size_t size) const;
+
+    // Forget memoized file contents, e.g. after a file was edited on disk. Empty path drops everything.
+    void InvalidateFile(const std::filesystem::path& path = {});
+
+    // Identifies a build of a compiler by the size and last write time of its file, so an updated compiler misses
+    // every entry of the old one. 0 if the file cannot be read.
+    static uint64_t GetCompilerVersion(const std::filesystem::path& compilerFile);
+
+    // Files directly included by the source, resolved to absolute paths
+    static std::vector<std::filesystem::path> ParseIncludes(const std::string& source, const std::filesystem::path& includingFile);
+
+    std::filesystem::path GetEntryPath(uint64_t key) const;
+
+private:
+    struct FileInfo
+    {
+        uint64_t mHash = 0;
+        std::vector<std::filesystem::path> mIncludes;
+    };
+
+    bool GetFileInfo(const std::filesystem::path& path, FileInfo& info);
+    bool HashFileRecursive(const std::filesystem::path& path, std::vector<std::filesystem::path>& visited, uint64_t& hash);
+
+    std::filesystem::path mDirectory;
+
+    // shared headers are read and hashed once per run
+    std::map<std::filesystem::path, FileInfo> mFiles;
+    std::mutex mFilesMutex;
+};
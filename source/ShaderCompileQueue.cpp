@@ -0,0 +1,219 @@
+#include "ShaderCompileQueue.h"
+#include "CpuProfiler.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+
+namespace {
+	typedef std::chrono::high_resolution_clock Clock;
+
+	double ElapsedMs(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+}
+
+ShaderCompileQueue::Handle ShaderCompileQueue::AddCompile(const std::string& name, CompileFunc func)
+{
+	Job job;
+	job.mName = name;
+	job.mCompile = std::move(func);
+	mJobs.push_back(std::move(job));
+	return static_cast<Handle>(mJobs.size() - 1);
+}
+
+ShaderCompileQueue::Handle ShaderCompileQueue::AddContinuation(const std::string& name, const std::vector<Handle>& dependencies, ContinuationFunc func)
+{
+	Handle handle = static_cast<Handle>(mJobs.size());
+
+	Job job;
+	job.mName = name;
+	job.mContinuation = std::move(func);
+	for (Handle dependency : dependencies)
+	{
+		// handles are only valid once added, which also rules out cycles
+		assert(dependency < handle);
+		mJobs[dependency].mDependents.push_back(handle);
+		job.mDependencyCount++;
+	}
+	mJobs.push_back(std::move(job));
+	return handle;
+}
+
+std::vector<std::string> ShaderCompileQueue::Run(uint32_t threadCount)
+{
+	CPU_PROFILE_SCOPE("Shader compile queue");
+
+	mErrors.clear();
+	mStats = Stats();
+	mStats.mThreadCount = threadCount;
+
+	Clock::time_point runStart = Clock::now();
+
+	std::mutex mutex;
+	std::condition_variable workerWake;
+	std::condition_variable mainWake;
+	std::deque<Handle> compileReady;
+	std::set<Handle> continuationReady; // ordered so continuations keep their submission order
+	std::vector<uint32_t> remaining(mJobs.size());
+	std::vector<bool> dependencyFailed(mJobs.size());
+	size_t finished = 0;
+	bool shutdown = false;
+
+	// both called with the lock held; a continuation whose dependency failed completes as failed without running
+	std::function<void(Handle, bool)> complete;
+	auto push = [&](Handle handle) {
+		if (mJobs[handle].mCompile)
+			compileReady.push_back(handle);
+		else if (dependencyFailed[handle])
+		{
+			mStats.mSkippedCount++;
+			complete(handle, true);
+		}
+		else
+			continuationReady.insert(handle);
+	};
+
+	complete = [&](Handle handle, bool failed) {
+		finished++;
+		for (Handle dependent : mJobs[handle].mDependents)
+		{
+			if (failed)
+				dependencyFailed[dependent] = true;
+			if (--remaining[dependent] == 0)
+				push(dependent);
+		}
+	};
+
+	auto fail = [&](Handle handle, const std::string& error) {
+		mStats.mFailedCount++;
+		mErrors.push_back(mJobs[handle].mName + ": " + error);
+	};
+
+	auto runCompile = [&](Handle handle) {
+		std::string error;
+		Clock::time_point start = Clock::now();
+		bool success = mJobs[handle].mCompile(error);
+		double ms = ElapsedMs(start);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			mStats.mCompileMs += ms;
+			mStats.mJobCount++;
+			if (!success)
+				fail(handle, error);
+			complete(handle, !success);
+		}
+		workerWake.notify_all();
+		mainWake.notify_one();
+	};
+
+	for (Handle i = 0; i < mJobs.size(); i++)
+	{
+		remaining[i] = mJobs[i].mDependencyCount;
+		if (remaining[i] == 0)
+			push(i);
+	}
+
+	std::vector<std::thread> workers;
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		workers.emplace_back([&]() {
+			for (;;)
+			{
+				Handle handle;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					workerWake.wait(lock, [&]() { return shutdown || !compileReady.empty(); });
+					if (compileReady.empty())
+						return;
+					handle = compileReady.front();
+					compileReady.pop_front();
+				}
+				runCompile(handle);
+			}
+		});
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	while (finished < mJobs.size())
+	{
+		if (threadCount == 0 && !compileReady.empty())
+		{
+			Handle handle = compileReady.front();
+			compileReady.pop_front();
+			lock.unlock();
+			runCompile(handle);
+			lock.lock();
+			continue;
+		}
+
+		if (continuationReady.empty())
+		{
+			mainWake.wait(lock, [&]() { return !continuationReady.empty() || finished == mJobs.size(); });
+			continue;
+		}
+
+		Handle handle = *continuationReady.begin();
+		continuationReady.erase(continuationReady.begin());
+		lock.unlock();
+
+		std::string error;
+		bool success = true;
+		Clock::time_point start = Clock::now();
+		try
+		{
+			mJobs[handle].mContinuation();
+		}
+		catch (const std::exception& exception)
+		{
+			error = exception.what();
+			success = false;
+		}
+		catch (...)
+		{
+			error = "unknown exception";
+			success = false;
+		}
+		double ms = ElapsedMs(start);
+
+		lock.lock();
+		mStats.mContinuationMs += ms;
+		if (!success)
+			fail(handle, error);
+		complete(handle, !success);
+		workerWake.notify_all();
+	}
+
+	shutdown = true;
+	lock.unlock();
+	workerWake.notify_all();
+	for (auto& worker : workers)
+		worker.join();
+
+	mStats.mWallMs = ElapsedMs(runStart);
+	return mErrors;
+}
+
+std::string ShaderCompileQueue::GetStatsString() const
+{
+	char text[256];
+	snprintf(text, sizeof(text), "Shader compile queue: %u jobs (%u failed, %u skipped) on %u threads, %.1f ms wall, %.1f ms compile, %.1f ms PSO creation\n",
+		mStats.mJobCount, mStats.mFailedCount, mStats.mSkippedCount, mStats.mThreadCount, mStats.mWallMs, mStats.mCompileMs, mStats.mContinuationMs);
+	return text;
+}
+
+void ShaderCompileQueue::Clear()
+{
+	mJobs.clear();
+	mErrors.clear();
+	mStats = Stats();
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Dependency-driven job queue used to compile shaders at startup.
+// Compile jobs run on worker threads; continuations (PSO creation, anything touching the device
+// context or scene state) run on the thread that calls Run, in the order they were added, as soon as
+// all of their dependencies have finished. A continuation handle can itself be a dependency, which is
+// how the scene keeps its Init* passes in their original order.
+// Only uses the standard library, so it can be driven with a stub compiler without a device.
+class ShaderCompileQueue
+{
+public:
+    typedef uint32_t Handle;
+
+    // Returns false and fills the error string on failure
+    typedef std::function<bool(std::string& error)> CompileFunc;
+    typedef std::function<void()> ContinuationFunc;
+
+    struct Stats
+    {
+        uint32_t mThreadCount = 0;
+        uint32_t mJobCount = 0;
+        uint32_t mFailedCount = 0;      // compiles and continuations
+        uint32_t mSkippedCount = 0;     // continuations after a failed dependency
+        double mWallMs = 0.0;       // whole Run call
+        double mCompileMs = 0.0;    // sum over compile jobs, mCompileMs / mWallMs is the achieved parallelism
+        double mContinuationMs = 0.0;
+    };
+
+    Handle AddCompile(const std::string& name, CompileFunc func);
+    Handle AddContinuation(const std::string& name, const std::vector<Handle>& dependencies, ContinuationFunc func);
+
+    // threadCount == 0 runs everything serially on the calling thread (the single threaded baseline).
+    // Returns the errors of the failed jobs as "name: error", empty if every job succeeded. A continuation fails
+    // with the message of the exception it throws. Continuations depending on a failed job, directly or through
+    // other continuations, are skipped, so nothing runs with a shader that did not compile.
+    std::vector<std::string> Run(uint32_t threadCount);
+
+    const Stats& GetStats() const { return mStats; }
+    const std::vector<std::string>& GetErrors() const { return mErrors; }
+    std::string GetStatsString() const;
+
+    void Clear();
+
+private:
+    struct Job
+    {
+        std::string mName;
+        CompileFunc mCompile;
+        ContinuationFunc mContinuation;
+        std::vector<Handle> mDependents;
+        uint32_t mDependencyCount = 0;
+    };
+
+    std::vector<Job> mJobs;
+    std::vector<std::string> mErrors;
+    Stats mStats;
+};
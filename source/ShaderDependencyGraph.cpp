@@ -0,0 +1,106 @@
+#include "ShaderDependencyGraph.h"
+#include "ShaderCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+ShaderDependencyGraph::ShaderDependencyGraph()
+{
+	mReadFunc = [](const std::filesystem::path& path, std::string& source) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+
+		std::stringstream stream;
+		stream << file.rdbuf();
+		source = stream.str();
+		return true;
+	};
+}
+
+void ShaderDependencyGraph::ParseFile(const std::filesystem::path& path, bool force)
+{
+	if (!force && mIncludes.find(path) != mIncludes.end())
+		return;
+
+	std::string source;
+	std::vector<std::filesystem::path> includes;
+	if (mReadFunc(path, source))
+		includes = ShaderCache::ParseIncludes(source, path);
+
+	// insert before recursing so include cycles terminate
+	mIncludes[path] = includes;
+	for (auto& include : includes)
+		ParseFile(include, false);
+}
+
+void ShaderDependencyGraph::AddRoot(const std::filesystem::path& path)
+{
+	std::filesystem::path root = path.lexically_normal();
+	mRoots.insert(root);
+	ParseFile(root, false);
+}
+
+std::vector<std::filesystem::path> ShaderDependencyGraph::OnFileChanged(const std::filesystem::path& path)
+{
+	std::filesystem::path file = path.lexically_normal();
+	if (mIncludes.find(file) != mIncludes.end())
+		ParseFile(file, true);
+
+	return GetAffectedRoots(file);
+}
+
+std::vector<std::filesystem::path> ShaderDependencyGraph::GetAffectedRoots(const std::filesystem::path& path) const
+{
+	std::filesystem::path file = path.lexically_normal();
+
+	// walk the reverse edges from the file up to the roots
+	std::map<std::filesystem::path, std::vector<std::filesystem::path>> includedBy;
+	for (auto& entry : mIncludes)
+	{
+		for (auto& include : entry.second)
+			includedBy[include].push_back(entry.first);
+	}
+
+	std::set<std::filesystem::path> visited;
+	std::vector<std::filesystem::path> stack = { file };
+	std::vector<std::filesystem::path> roots;
+	while (!stack.empty())
+	{
+		std::filesystem::path current = stack.back();
+		stack.pop_back();
+		if (!visited.insert(current).second)
+			continue;
+
+		if (mRoots.count(current))
+			roots.push_back(current);
+
+		auto it = includedBy.find(current);
+		if (it != includedBy.end())
+			stack.insert(stack.end(), it->second.begin(), it->second.end());
+	}
+
+	std::sort(roots.begin(), roots.end());
+	return roots;
+}
+
+std::vector<std::filesystem::path> ShaderDependencyGraph::GetFiles() const
+{
+	std::vector<std::filesystem::path> files;
+	for (auto& entry : mIncludes)
+		files.push_back(entry.first);
+	return files;
+}
+
+const std::vector<std::filesystem::path>* ShaderDependencyGraph::GetIncludes(const std::filesystem::path& path) const
+{
+	auto it = mIncludes.find(path.lexically_normal());
+	return it != mIncludes.end() ? &it->second : nullptr;
+}
+
+void ShaderDependencyGraph::Clear()
+{
+	mRoots.clear();
+	mIncludes.clear();
+}
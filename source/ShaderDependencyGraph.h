@@ -0,0 +1,48 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Include graph of the shaders used by a scene, used by hot reload to find which shaders have to be
+// recompiled when a file changes. Roots are the files passed to the compiler, every other node is
+// reached through #include "..." (parsed by ShaderCache::ParseIncludes). All paths are lexically normalized.
+// Only uses the standard library; file access goes through a replaceable read function.
+class ShaderDependencyGraph
+{
+public:
+    typedef std::function<bool(const std::filesystem::path& path, std::string& source)> ReadFunc;
+
+    ShaderDependencyGraph();
+
+    void SetReadFunc(ReadFunc readFunc) { mReadFunc = readFunc; }
+
+    // Parses the root and everything it includes, files already in the graph are not read again
+    void AddRoot(const std::filesystem::path& path);
+
+    // Re-reads the changed file (its includes may have changed), pulls in new includes and returns
+    // the roots that depend on it, the file itself included if it is a root
+    std::vector<std::filesystem::path> OnFileChanged(const std::filesystem::path& path);
+
+    // Roots that include the file directly or through other includes
+    std::vector<std::filesystem::path> GetAffectedRoots(const std::filesystem::path& path) const;
+
+    // Every root and include in the graph, i.e. the set of files worth watching
+    std::vector<std::filesystem::path> GetFiles() const;
+
+    const std::vector<std::filesystem::path>* GetIncludes(const std::filesystem::path& path) const;
+    bool IsRoot(const std::filesystem::path& path) const { return mRoots.count(path.lexically_normal()) > 0; }
+
+    void Clear();
+
+private:
+    void ParseFile(const std::filesystem::path& path, bool force);
+
+    ReadFunc mReadFunc;
+    std::set<std::filesystem::path> mRoots;
+    // direct includes per file, files that could not be read have an empty entry
+    std::map<std::filesystem::path, std::vector<std::filesystem::path>> mIncludes;
+};
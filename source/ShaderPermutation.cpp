@@ -0,0 +1,126 @@
+#include "ShaderPermutation.h"
+
+#include <cassert>
+
+ShaderPermutationSpace::ShaderPermutationSpace(std::initializer_list<ShaderOption> options) : mOptions(options)
+{
+#ifndef NDEBUG
+	for (auto& option : mOptions)
+		assert(!option.mValues.empty());
+	assert(GetVariantCount() > 0);
+#endif
+}
+
+uint32_t ShaderPermutationSpace::GetVariantCount() const
+{
+	uint64_t count = 1;
+	for (auto& option : mOptions)
+	{
+		count *= option.mValues.size();
+		if (count > UINT32_MAX)
+			return 0;
+	}
+	return static_cast<uint32_t>(count);
+}
+
+bool ShaderPermutationSpace::Encode(const std::vector<int>& values, Key& key) const
+{
+	if (values.size() != mOptions.size())
+		return false;
+
+	Key result = 0;
+	Key stride = 1;
+	for (size_t i = 0; i < mOptions.size(); i++)
+	{
+		int index = FindValue(static_cast<int>(i), values[i]);
+		if (index < 0)
+			return false;
+
+		result += static_cast<Key>(index) * stride;
+		stride *= static_cast<Key>(mOptions[i].mValues.size());
+	}
+
+	key = result;
+	return true;
+}
+
+bool ShaderPermutationSpace::Decode(Key key, std::vector<int>& values) const
+{
+	if (key >= GetVariantCount())
+		return false;
+
+	values.resize(mOptions.size());
+	for (size_t i = 0; i < mOptions.size(); i++)
+	{
+		Key radix = static_cast<Key>(mOptions[i].mValues.size());
+		values[i] = mOptions[i].mValues[key % radix];
+		key /= radix;
+	}
+	return true;
+}
+
+bool ShaderPermutationSpace::MakeKey(const Settings& settings, Key& key) const
+{
+	std::vector<int> values(mOptions.size());
+	for (size_t i = 0; i < mOptions.size(); i++)
+	{
+		auto it = settings.find(mOptions[i].mName);
+		values[i] = it != settings.end() ? it->second : mOptions[i].mValues[0];
+	}
+	return Encode(values, key);
+}
+
+bool ShaderPermutationSpace::SetOption(Key& key, const std::string& name, int value) const
+{
+	std::vector<int> values;
+	int option = FindOption(name);
+	if (option < 0 || !Decode(key, values))
+		return false;
+
+	values[option] = value;
+	return Encode(values, key);
+}
+
+bool ShaderPermutationSpace::GetOption(Key key, const std::string& name, int& value) const
+{
+	std::vector<int> values;
+	int option = FindOption(name);
+	if (option < 0 || !Decode(key, values))
+		return false;
+
+	value = values[option];
+	return true;
+}
+
+std::vector<std::pair<std::string, std::string>> ShaderPermutationSpace::GetDefines(Key key) const
+{
+	std::vector<std::pair<std::string, std::string>> defines;
+	std::vector<int> values;
+	if (!Decode(key, values))
+		return defines;
+
+	for (size_t i = 0; i < mOptions.size(); i++)
+		defines.emplace_back(mOptions[i].mName, std::to_string(values[i]));
+	return defines;
+}
+
+int ShaderPermutationSpace::FindOption(const std::string& name) const
+{
+	for (size_t i = 0; i < mOptions.size(); i++)
+	{
+		if (mOptions[i].mName == name)
+			return static_cast<int>(i);
+	}
+	return -1;
+}
+
+int ShaderPermutationSpace::FindValue(int option, int value) const
+{
+	const std::vector<int>& values = mOptions[option].mValues;
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		if (values[i] == value)
+			return static_cast<int>(i);
+	}
+	return -1;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A compile-time option exposed by a shader, e.g. RSM_SAMPLES_COUNT = { 64, 256, 512 }.
+// The first value is the default.
+struct ShaderOption
+{
+    std::string mName;
+    std::vector<int> mValues;
+};
+
+// Option space of one shader. A variant is identified by a dense key: the mixed-radix number formed by
+// the index of the selected value of every option, the first option being the least significant digit.
+// Keys run from 0 (all defaults) to GetVariantCount() - 1, so they can index flat arrays of prebuilt variants.
+// The defines of a key are part of the ShaderCache key, so every variant gets its own on-disk entry.
+// Only uses the standard library.
+class ShaderPermutationSpace
+{
+public:
+    typedef uint32_t Key;
+    typedef std::map<std::string, int> Settings;
+
+    ShaderPermutationSpace() {}
+    ShaderPermutationSpace(std::initializer_list<ShaderOption> options);
+
+    const std::vector<ShaderOption>& GetOptions() const { return mOptions; }
+    uint32_t GetVariantCount() const;
+
+    // values holds one entry per option, in declaration order
+    bool Encode(const std::vector<int>& values, Key& key) const;
+    bool Decode(Key key, std::vector<int>& values) const;
+
+    // Picks every option's value from the settings by name, options missing from the settings keep their default.
+    // Fails if a value is not part of the option space.
+    bool MakeKey(const Settings& settings, Key& key) const;
+
+    bool SetOption(Key& key, const std::string& name, int value) const;
+    bool GetOption(Key key, const std::string& name, int& value) const;
+
+    // Macro definitions for the variant, in declaration order
+    std::vector<std::pair<std::string, std::string>> GetDefines(Key key) const;
+
+private:
+    int FindOption(const std::string& name) const;
+    int FindValue(int option, int value) const;
+
+    std::vector<ShaderOption> mOptions;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <map>
+#include <mutex>
+
+// Hash map of objects that are expensive to create (PSOs, root signatures) and shared by every caller asking for
+// the same key. The first caller of a key creates the object outside the lock; callers asking for the key in the
+// meantime block on its future instead of creating it again. If the creation throws, the entry is removed and the
+// exception reaches the creator and every waiter, so the next caller tries again.
+// Only uses the standard library, so it can be driven without a device.
+template<typename Key, typename Value>
+class SharedObjectMap
+{
+public:
+    // Returns the object of key, calling create() (which returns a Value) if there is none yet
+    template<typename CreateFunc>
+    Value GetOrCreate(const Key& key, CreateFunc create)
+    {
+        std::promise<Value> promise;
+        std::unique_lock<std::mutex> lock(mMutex);
+        auto iter = mEntries.find(key);
+        if (iter != mEntries.end())
+        {
+            std::shared_future<Value> future = iter->second.mFuture;
+            lock.unlock();
+            return future.get();
+        }
+
+        uint64_t generation = ++mGeneration;
+        mEntries[key] = { promise.get_future().share(), generation };
+        lock.unlock();
+
+        try
+        {
+            Value value = create();
+            promise.set_value(value);
+            return value;
+        }
+        catch (...)
+        {
+            // only our own reservation, Erase() and a new creator may have replaced it meanwhile
+            lock.lock();
+            iter = mEntries.find(key);
+            if (iter != mEntries.end() && iter->second.mGeneration == generation)
+                mEntries.erase(iter);
+            lock.unlock();
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+    // Drops the map's reference, callers that already got the object keep theirs
+    void Erase(const Key& key)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEntries.erase(key);
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mEntries.clear();
+    }
+
+    size_t GetSize()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mEntries.size();
+    }
+
+private:
+    struct Entry
+    {
+        std::shared_future<Value> mFuture;
+        uint64_t mGeneration;
+    };
+
+    std::mutex mMutex;
+    std::map<Key, Entry> mEntries;
+    uint64_t mGeneration = 0;
+};
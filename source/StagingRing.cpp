@@ -0,0 +1,71 @@
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <cassert>
+
+void StagingRing::Reset(uint64_t capacity)
+{
+	mCapacity = capacity;
+	mHead = 0;
+	mTail = 0;
+	mClosedHead = 0;
+	mBatches.clear();
+}
+
+uint64_t StagingRing::Allocate(uint64_t size, uint64_t alignment)
+{
+	alignment = std::max<uint64_t>(alignment, 1);
+	if (size == 0 || size > mCapacity)
+	{
+		mStats.mFailedCount++;
+		return INVALID_OFFSET;
+	}
+
+	uint64_t start = (mHead + alignment - 1) / alignment * alignment;
+	// skip to the start of the ring instead of splitting the allocation
+	if (start % mCapacity + size > mCapacity)
+		start = (start / mCapacity + 1) * mCapacity;
+
+	if (start + size - mTail > mCapacity)
+	{
+		mStats.mFailedCount++;
+		return INVALID_OFFSET;
+	}
+
+	mHead = start + size;
+	mStats.mAllocationCount++;
+	mStats.mAllocatedBytes += size;
+	mStats.mPeakUsedSize = std::max(mStats.mPeakUsedSize, GetUsedSize());
+	return start % mCapacity;
+}
+
+void StagingRing::Close(uint64_t fenceValue)
+{
+	assert(mBatches.empty() || mBatches.back().mFenceValue <= fenceValue);
+	if (mHead == mClosedHead)
+		return;
+
+	Batch batch;
+	batch.mFenceValue = fenceValue;
+	batch.mEnd = mHead;
+	mBatches.push_back(batch);
+	mClosedHead = mHead;
+}
+
+void StagingRing::Retire(uint64_t completedValue)
+{
+	while (!mBatches.empty() && mBatches.front().mFenceValue <= completedValue)
+	{
+		mTail = mBatches.front().mEnd;
+		mBatches.pop_front();
+	}
+
+	// an empty ring starts over at the next multiple of the capacity, so the next allocation does not wrap
+	if (mCapacity > 0 && mTail == mHead && mBatches.empty())
+	{
+		uint64_t restart = (mHead + mCapacity - 1) / mCapacity * mCapacity;
+		mHead = restart;
+		mTail = restart;
+		mClosedHead = restart;
+	}
+}
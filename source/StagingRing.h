@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+// Sub-allocates staging memory for uploads from a fixed size ring.
+// Allocations are made in submission order; Close tags everything allocated since the previous Close with the
+// fence value of the submission that reads it, and Retire frees the oldest batches once the GPU has reached
+// their values. An allocation never wraps: if it does not fit before the end of the ring, the rest of the ring
+// is skipped. Offsets are relative to the start of the ring, so one mapped buffer can back the whole ring.
+// Only uses the standard library; fence values are plain integers, so the ring can be driven without a device.
+class StagingRing
+{
+public:
+    static constexpr uint64_t INVALID_OFFSET = UINT64_MAX;
+
+    struct Stats
+    {
+        uint64_t mAllocationCount = 0;
+        uint64_t mFailedCount = 0;      // allocations that did not fit until older batches retire
+        uint64_t mAllocatedBytes = 0;   // requested sizes, without alignment and wrap padding
+        uint64_t mPeakUsedSize = 0;
+    };
+
+    explicit StagingRing(uint64_t capacity = 0) : mCapacity(capacity) {}
+
+    // Forgets every allocation, only call when the GPU is done with the ring
+    void Reset(uint64_t capacity);
+
+    // Returns INVALID_OFFSET if the ring is too full (or size is larger than the ring).
+    // The capacity should be a multiple of the largest alignment used.
+    uint64_t Allocate(uint64_t size, uint64_t alignment = 1);
+    // Allocations since the previous Close are released once fenceValue completes. Values must not decrease.
+    void Close(uint64_t fenceValue);
+    // Frees every closed batch up to completedValue
+    void Retire(uint64_t completedValue);
+
+    uint64_t GetCapacity() const { return mCapacity; }
+    // Bytes not available for allocation, padding included
+    uint64_t GetUsedSize() const { return mHead - mTail; }
+    // Allocated bytes that are not closed yet
+    uint64_t GetOpenSize() const { return mHead - mClosedHead; }
+    uint32_t GetPendingBatchCount() const { return static_cast<uint32_t>(mBatches.size()); }
+    // Fence value of the oldest closed batch, the one to wait for when Allocate fails; 0 if none
+    uint64_t GetOldestFenceValue() const { return mBatches.empty() ? 0 : mBatches.front().mFenceValue; }
+    const Stats& GetStats() const { return mStats; }
+
+private:
+    struct Batch
+    {
+        uint64_t mFenceValue = 0;
+        uint64_t mEnd = 0;
+    };
+
+    uint64_t mCapacity = 0;
+    // Positions only grow, the offset in the ring is position % capacity
+    uint64_t mHead = 0;
+    uint64_t mTail = 0;
+    uint64_t mClosedHead = 0;
+    std::deque<Batch> mBatches;
+    Stats mStats;
+};
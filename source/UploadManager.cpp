@@ -0,0 +1,240 @@
+#include "UploadManager.h"
+
+UploadManager::~UploadManager()
+{
+	WaitForIdle();
+
+	if (mRingBuffer)
+		mRingBuffer->Unmap(0, nullptr);
+}
+
+void UploadManager::Init(ID3D12Device* device, UINT64 ringSize, UINT64 batchSize)
+{
+	mDevice = device;
+	mBatchSize = batchSize;
+
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	ThrowIfFailed(mDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(mQueue.ReleaseAndGetAddressOf())));
+	mQueue->SetName(L"Upload copy queue");
+
+	ThrowIfFailed(mDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFence.ReleaseAndGetAddressOf())));
+	mFence->SetName(L"Upload fence");
+	mFenceEvent.Attach(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
+	if (!mFenceEvent.IsValid())
+		throw std::exception("CreateEvent");
+
+	// texture footprints need 512 byte placement, keep the ring a multiple of it
+	ringSize = Align(ringSize, (UINT64)D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(ringSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(mRingBuffer.ReleaseAndGetAddressOf())));
+	mRingBuffer->SetName(L"Upload staging ring");
+
+	CD3DX12_RANGE readRange(0, 0);
+	ThrowIfFailed(mRingBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mRingData)));
+	mRing.Reset(ringSize);
+}
+
+UINT8* UploadManager::AllocateStaging(UINT64 size, UINT64 alignment, ID3D12Resource** buffer, UINT64* offset)
+{
+	if (size > mRing.GetCapacity() / 2)
+	{
+		// would keep most of the ring busy, give it its own buffer that is released with the batch
+		DedicatedBuffer dedicated;
+		ThrowIfFailed(mDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(size),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(dedicated.mBuffer.GetAddressOf())));
+		dedicated.mHandle = GetOpenHandle();
+
+		UINT8* data = nullptr;
+		CD3DX12_RANGE readRange(0, 0);
+		ThrowIfFailed(dedicated.mBuffer->Map(0, &readRange, reinterpret_cast<void**>(&data)));
+
+		*buffer = dedicated.mBuffer.Get();
+		*offset = 0;
+		mDedicatedBuffers.push_back(dedicated);
+		mStats.mDedicatedCount++;
+		return data;
+	}
+
+	UINT64 ringOffset = mRing.Allocate(size, alignment);
+	while (ringOffset == StagingRing::INVALID_OFFSET)
+	{
+		// the ring is full of work that is not done yet: hand the open batch over and wait for the oldest one
+		if (mRing.GetOpenSize() > 0)
+			Submit();
+
+		mStats.mStallCount++;
+		WaitForCompletion(mRing.GetOldestFenceValue());
+		ringOffset = mRing.Allocate(size, alignment);
+	}
+
+	*buffer = mRingBuffer.Get();
+	*offset = ringOffset;
+	return mRingData + ringOffset;
+}
+
+void UploadManager::OpenBatch()
+{
+	if (mBatchOpen)
+		return;
+
+	Allocator allocator;
+	if (!mAllocators.empty() && IsComplete(mAllocators.front().mHandle))
+	{
+		allocator = mAllocators.front();
+		mAllocators.pop_front();
+		ThrowIfFailed(allocator.mAllocator->Reset());
+	}
+	else
+		ThrowIfFailed(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(allocator.mAllocator.GetAddressOf())));
+
+	if (!mCommandList)
+	{
+		ThrowIfFailed(mDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, allocator.mAllocator.Get(), nullptr, IID_PPV_ARGS(mCommandList.GetAddressOf())));
+		mCommandList->SetName(L"Upload command list");
+	}
+	else
+		ThrowIfFailed(mCommandList->Reset(allocator.mAllocator.Get(), nullptr));
+
+	allocator.mHandle = GetOpenHandle();
+	mAllocators.push_back(allocator);
+	mBatchOpen = true;
+	mBatchBytes = 0;
+}
+
+void UploadManager::SubmitIfFull()
+{
+	if (mBatchBytes >= mBatchSize)
+		Submit();
+}
+
+UploadManager::Handle UploadManager::UploadBuffer(ID3D12Resource* destination, UINT64 destinationOffset, const void* data, UINT64 size)
+{
+	if (size == 0)
+		return 0;
+
+	ID3D12Resource* staging = nullptr;
+	UINT64 stagingOffset = 0;
+	UINT8* stagingData = AllocateStaging(size, 4, &staging, &stagingOffset);
+	memcpy(stagingData, data, size);
+
+	// opened after the allocation, which may have submitted the previous batch
+	OpenBatch();
+	mCommandList->CopyBufferRegion(destination, destinationOffset, staging, stagingOffset, size);
+
+	Handle handle = GetOpenHandle();
+	mBatchBytes += size;
+	mStats.mUploadedBytes += size;
+	SubmitIfFull();
+	return handle;
+}
+
+UploadManager::Handle UploadManager::UploadTexture(ID3D12Resource* destination, UINT firstSubresource, UINT numSubresources, const D3D12_SUBRESOURCE_DATA* data)
+{
+	if (numSubresources == 0)
+		return 0;
+
+	std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> layouts(numSubresources);
+	std::vector<UINT> numRows(numSubresources);
+	std::vector<UINT64> rowSizes(numSubresources);
+	UINT64 totalSize = 0;
+
+	D3D12_RESOURCE_DESC desc = destination->GetDesc();
+	mDevice->GetCopyableFootprints(&desc, firstSubresource, numSubresources, 0, layouts.data(), numRows.data(), rowSizes.data(), &totalSize);
+
+	ID3D12Resource* staging = nullptr;
+	UINT64 stagingOffset = 0;
+	UINT8* stagingData = AllocateStaging(totalSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, &staging, &stagingOffset);
+
+	OpenBatch();
+	for (UINT i = 0; i < numSubresources; i++)
+	{
+		D3D12_MEMCPY_DEST destData = { stagingData + layouts[i].Offset, layouts[i].Footprint.RowPitch, SIZE_T(layouts[i].Footprint.RowPitch) * SIZE_T(numRows[i]) };
+		MemcpySubresource(&destData, &data[i], static_cast<SIZE_T>(rowSizes[i]), numRows[i], layouts[i].Footprint.Depth);
+
+		layouts[i].Offset += stagingOffset;
+		CD3DX12_TEXTURE_COPY_LOCATION dst(destination, firstSubresource + i);
+		CD3DX12_TEXTURE_COPY_LOCATION src(staging, layouts[i]);
+		mCommandList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+	}
+
+	Handle handle = GetOpenHandle();
+	mBatchBytes += totalSize;
+	mStats.mUploadedBytes += totalSize;
+	SubmitIfFull();
+	return handle;
+}
+
+UploadManager::Handle UploadManager::Submit()
+{
+	if (!mBatchOpen)
+		return mLastSubmitted;
+
+	ThrowIfFailed(mCommandList->Close());
+	ID3D12CommandList* ppCommandLists[] = { mCommandList.Get() };
+	mQueue->ExecuteCommandLists(1, ppCommandLists);
+
+	Handle handle = GetOpenHandle();
+	ThrowIfFailed(mQueue->Signal(mFence.Get(), handle));
+	mRing.Close(handle);
+
+	mLastSubmitted = handle;
+	mBatchOpen = false;
+	mStats.mSubmissionCount++;
+	return handle;
+}
+
+void UploadManager::WaitOnQueue(ID3D12CommandQueue* queue, Handle handle)
+{
+	if (IsComplete(handle))
+		return;
+
+	if (handle > mLastSubmitted)
+		Submit();
+	ThrowIfFailed(queue->Wait(mFence.Get(), handle));
+}
+
+void UploadManager::WaitForCompletion(Handle handle)
+{
+	if (handle > mLastSubmitted)
+		Submit();
+
+	if (mFence->GetCompletedValue() < handle)
+	{
+		ThrowIfFailed(mFence->SetEventOnCompletion(handle, mFenceEvent.Get()));
+		WaitForSingleObjectEx(mFenceEvent.Get(), INFINITE, FALSE);
+	}
+	Update();
+}
+
+void UploadManager::WaitForIdle()
+{
+	if (!mQueue)
+		return;
+
+	Submit();
+	WaitForCompletion(mLastSubmitted);
+}
+
+void UploadManager::Update()
+{
+	if (!mFence)
+		return;
+
+	mCompletedValue = mFence->GetCompletedValue();
+	mRing.Retire(mCompletedValue);
+
+	while (!mDedicatedBuffers.empty() && IsComplete(mDedicatedBuffers.front().mHandle))
+		mDedicatedBuffers.pop_front();
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Common.h"
+#include "StagingRing.h"
+
+#include <deque>
+#include <vector>
+
+// Uploads resource data on a dedicated copy queue so loading does not go through the graphics command list.
+// Data is copied into a persistently mapped staging ring and the copies are recorded into a batch; a batch is
+// submitted by Submit, or automatically once it holds more than the batch size. Every upload returns the handle
+// of its batch (the copy fence value it signals), which can be polled, waited on by another queue on the GPU,
+// or waited on by the CPU. Uploads larger than half the ring get their own staging buffer.
+// Destinations have to be in the COMMON state and stay alive until their batch completes. The copy queue
+// promotes them to COPY_DEST and they decay back to COMMON, from where buffers (and textures, for shader reads)
+// are implicitly promoted on first use by another queue.
+class UploadManager
+{
+public:
+    // Copy fence value of a batch, 0 is always complete
+    typedef UINT64 Handle;
+
+    static constexpr UINT64 DEFAULT_RING_SIZE = 64 * 1024 * 1024;
+    static constexpr UINT64 DEFAULT_BATCH_SIZE = 16 * 1024 * 1024;
+
+    struct Stats
+    {
+        UINT64 mUploadedBytes = 0;
+        UINT64 mSubmissionCount = 0;
+        UINT64 mDedicatedCount = 0;     // uploads too large for the ring
+        UINT64 mStallCount = 0;         // times the CPU waited for the copy queue to free ring space
+    };
+
+    UploadManager() {}
+    ~UploadManager();
+
+    void Init(ID3D12Device* device, UINT64 ringSize = DEFAULT_RING_SIZE, UINT64 batchSize = DEFAULT_BATCH_SIZE);
+
+    Handle UploadBuffer(ID3D12Resource* destination, UINT64 destinationOffset, const void* data, UINT64 size);
+    Handle UploadTexture(ID3D12Resource* destination, UINT firstSubresource, UINT numSubresources, const D3D12_SUBRESOURCE_DATA* data);
+
+    // Submits the open batch, returns its handle (or the last submitted one if nothing was recorded)
+    Handle Submit();
+    // Handle the open batch will get, for resources that are recorded but not submitted yet
+    Handle GetOpenHandle() const { return mLastSubmitted + 1; }
+
+    // Uses the completed value of the last Update, cheap enough to ask for every draw
+    bool IsComplete(Handle handle) const { return handle <= mCompletedValue; }
+    // The queue waits on the GPU until the batch is done, submits it if it is still open
+    void WaitOnQueue(ID3D12CommandQueue* queue, Handle handle);
+    void WaitForCompletion(Handle handle);
+    void WaitForIdle();
+    // Reads the copy fence and frees staging memory and allocators of completed batches
+    void Update();
+
+    ID3D12CommandQueue* GetQueue() const { return mQueue.Get(); }
+    const StagingRing& GetRing() const { return mRing; }
+    const Stats& GetStats() const { return mStats; }
+
+private:
+    struct Allocator
+    {
+        ComPtr<ID3D12CommandAllocator> mAllocator;
+        Handle mHandle = 0;
+    };
+
+    struct DedicatedBuffer
+    {
+        ComPtr<ID3D12Resource> mBuffer;
+        Handle mHandle = 0;
+    };
+
+    // Returns the mapped staging memory and where it lives
+    UINT8* AllocateStaging(UINT64 size, UINT64 alignment, ID3D12Resource** buffer, UINT64* offset);
+    void OpenBatch();
+    void SubmitIfFull();
+
+    ID3D12Device* mDevice = nullptr;
+    ComPtr<ID3D12CommandQueue> mQueue;
+    ComPtr<ID3D12GraphicsCommandList> mCommandList;
+    ComPtr<ID3D12Fence> mFence;
+    Wrappers::Event mFenceEvent;
+
+    // Allocators in submission order, the front one is reused once its batch completes
+    std::deque<Allocator> mAllocators;
+    std::deque<DedicatedBuffer> mDedicatedBuffers;
+
+    ComPtr<ID3D12Resource> mRingBuffer;
+    UINT8* mRingData = nullptr;
+    StagingRing mRing;
+
+    bool mBatchOpen = false;
+    UINT64 mBatchBytes = 0;
+    UINT64 mBatchSize = DEFAULT_BATCH_SIZE;
+    Handle mLastSubmitted = 0;
+    Handle mCompletedValue = 0;
+    Stats mStats;
+};
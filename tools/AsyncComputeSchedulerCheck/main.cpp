@@ -0,0 +1,334 @@
+// Checks the schedules of AsyncComputeScheduler: on the RenderAsync pass graph of the GI scene and on small graphs
+// built to hit the deadlock rejection and the greedy search.
+//   scene      the pass graph and cost estimates GIPassGraph builds for DXRSExampleGIScene::ScheduleAsyncCompute (default
+//              RSM gather: no lightcuts, tiles or interleaving). At the high tier with RSM, LPV and VCT on, RSM goes to compute
+//              with the previous frame's RSM buffers, compute waits after list #1, lighting waits for compute and
+//              the critical path is 6.97 against 9.10. At the low tier RSM and VCT both go to compute, 4.07
+//              against 5.05 with LPV off and 4.87 against 5.85 with it on
+//   timing     in every schedule, same-frame producers end before their consumers start, previous-frame reads
+//              copy the producer's output before the producer runs, every fence wait starts after its signal,
+//              the graphics queue joins the compute queue and the critical path is at most the serial length, also
+//              with lightcuts, tile classification, interleaving and with GI off
+//   deadlock   a compute pass between two graphics passes of one submission would wait on itself and is kept on
+//              graphics; with the consumer in its own submission it goes to compute
+//   greedy     beyond 16 decisions the greedy search still finds a valid schedule close to the exhaustive one
+//
+//   AsyncComputeSchedulerCheck [--verbose]
+//
+// --verbose prints every schedule. Prints a line per check and exits with 1 if any fails and 2 on bad arguments.
+// Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o AsyncComputeSchedulerCheck tools/AsyncComputeSchedulerCheck/main.cpp source/GIPassGraph.cpp source/AsyncComputeScheduler.cpp
+
+#include "../Check.h"
+#include "AsyncComputeScheduler.h"
+#include "GIPassGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: AsyncComputeSchedulerCheck [--verbose]\n";
+		return 2;
+	}
+
+	typedef AsyncComputeScheduler Scheduler;
+
+	// The pass graph of ScheduleAsyncCompute for a quality tier (RSM samples, VCT cones) with RSM and VCT on
+	GIPassGraph::Passes BuildScene(Scheduler& scheduler, int rsmSamplesCount, int vctConesCount, bool useLPV)
+	{
+		GIPassGraph::Settings settings;
+		settings.mRSMSamplesCount = rsmSamplesCount;
+		settings.mVCTConesCount = vctConesCount;
+		settings.mUseLPV = useLPV;
+		GIPassGraph::Passes passes = GIPassGraph::Build(scheduler, settings);
+		scheduler.Schedule();
+		return passes;
+	}
+
+	struct Dependency
+	{
+		Scheduler::PassId mConsumer;
+		Scheduler::PassId mProducer;
+	};
+
+	// Step of a pass (or of its history copy) on its queue
+	const Scheduler::Step* FindStep(const Scheduler& scheduler, Scheduler::PassId pass, bool historyCopy, Scheduler::Queue& queue)
+	{
+		for (int q = 0; q < Scheduler::QUEUE_COUNT; q++)
+		{
+			for (const Scheduler::Step& step : scheduler.GetSteps(Scheduler::Queue(q)))
+			{
+				if (step.mPass == pass && step.mHistoryCopy == historyCopy)
+				{
+					queue = Scheduler::Queue(q);
+					return &step;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	// Timing problems of the chosen schedule, printed and counted
+	int CheckTiming(const Scheduler& scheduler, const std::vector<Dependency>& dependencies, const char* name)
+	{
+		const float epsilon = 1e-4f;
+		int problems = 0;
+		auto problem = [&](const std::string& what) {
+			std::printf("    %s: %s\n", name, what.c_str());
+			problems++;
+		};
+
+		for (const Dependency& dependency : dependencies)
+		{
+			Scheduler::Queue consumerQueue = Scheduler::GRAPHICS_QUEUE, producerQueue = consumerQueue, copyQueue = consumerQueue;
+			const Scheduler::Step* consumer = FindStep(scheduler, dependency.mConsumer, false, consumerQueue);
+			const Scheduler::Step* producer = FindStep(scheduler, dependency.mProducer, false, producerQueue);
+			std::string edge = scheduler.GetPassName(dependency.mConsumer) + " <- " + scheduler.GetPassName(dependency.mProducer);
+			if (!consumer || !producer)
+			{
+				problem(edge + " is not scheduled");
+				continue;
+			}
+
+			if (scheduler.IsPreviousFrame(dependency.mConsumer, dependency.mProducer))
+			{
+				const Scheduler::Step* copy = FindStep(scheduler, dependency.mProducer, true, copyQueue);
+				if (!copy || copyQueue != producerQueue || copy->mEnd > producer->mStart + epsilon)
+					problem(edge + " reads the previous frame without a copy ahead of the producer");
+				else if (copyQueue != consumerQueue && copy->mEnd > consumer->mStart + epsilon)
+					problem(edge + " reads the copy before it is made");
+			}
+			else if (producer->mEnd > consumer->mStart + epsilon)
+				problem(edge + " starts before its producer ends");
+		}
+
+		const std::vector<Scheduler::Step>& computeSteps = scheduler.GetSteps(Scheduler::COMPUTE_QUEUE);
+		bool joined = computeSteps.empty();
+		for (const Scheduler::Fence& fence : scheduler.GetFences())
+		{
+			const Scheduler::Step& signal = scheduler.GetSteps(fence.mSignalQueue)[fence.mSignalStep];
+			if (fence.mWaitQueue == Scheduler::GRAPHICS_QUEUE && fence.mSignalStep + 1 == computeSteps.size())
+				joined = true;
+			if (fence.mWaitStep == Scheduler::END_OF_FRAME)
+				continue;
+
+			const Scheduler::Step& wait = scheduler.GetSteps(fence.mWaitQueue)[fence.mWaitStep];
+			if (wait.mStart + epsilon < signal.mEnd)
+				problem("a fence wait starts before its signal");
+		}
+		if (!joined)
+			problem("the graphics queue does not join the compute queue");
+		if (scheduler.GetCriticalPathLength() > scheduler.GetSerialLength() + epsilon)
+			problem("the critical path is longer than the serial schedule");
+		return problems;
+	}
+
+	std::vector<Dependency> SceneDependencies(const GIPassGraph::Passes& p)
+	{
+		return {
+			{ p.mLPV, p.mRSMBuffers }, { p.mRSM, p.mGBuffer }, { p.mRSM, p.mRSMBuffers }, { p.mVCT, p.mGBuffer },
+			{ p.mVCT, p.mVoxelization }, { p.mLighting, p.mGBuffer }, { p.mLighting, p.mShadows }, { p.mLighting, p.mLPV },
+			{ p.mLighting, p.mRSM }, { p.mLighting, p.mVCT }, { p.mComposite, p.mLighting } };
+	}
+
+	bool Near(float value, float expected)
+	{
+		return std::fabs(value - expected) < 0.005f;
+	}
+
+	// passes independent compute-capable passes of cost 1 next to one graphics pass of the same total cost,
+	// all in their own submissions
+	void BuildWide(Scheduler& scheduler, int passes, std::vector<Dependency>& dependencies)
+	{
+		scheduler.Clear();
+		scheduler.SetFenceCost(0.02f);
+		Scheduler::PassId source = scheduler.AddPass("Source", 0.5f);
+		Scheduler::PassId heavy = scheduler.AddPass("Heavy", float(passes) * 0.5f);
+		scheduler.SetSubmissionStart(heavy);
+		std::vector<Scheduler::PassId> wide;
+		for (int i = 0; i < passes; i++)
+		{
+			wide.push_back(scheduler.AddPass("Wide" + std::to_string(i), 1.0f, true, 1.0f));
+			scheduler.SetSubmissionStart(wide.back());
+			scheduler.AddDependency(wide.back(), source);
+			dependencies.push_back({ wide.back(), source });
+		}
+		Scheduler::PassId sink = scheduler.AddPass("Sink", 0.5f);
+		scheduler.SetSubmissionStart(sink);
+		scheduler.AddDependency(sink, heavy);
+		dependencies.push_back({ sink, heavy });
+		for (Scheduler::PassId pass : wide)
+		{
+			scheduler.AddDependency(sink, pass);
+			dependencies.push_back({ sink, pass });
+		}
+		scheduler.Schedule();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool verbose = false;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--verbose")
+			verbose = true;
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+	Scheduler scheduler;
+
+	{
+		// High tier: 512 RSM samples, 6 cones
+		GIPassGraph::Passes passes = BuildScene(scheduler, 512, 6, true);
+		if (verbose)
+			std::printf("%s", scheduler.GetScheduleString().c_str());
+		Scheduler::PassId rsm = passes.mRSM, vct = passes.mVCT;
+		bool placement = scheduler.GetQueue(rsm) == Scheduler::COMPUTE_QUEUE && scheduler.GetQueue(vct) == Scheduler::GRAPHICS_QUEUE &&
+			scheduler.IsPreviousFrame(rsm, passes.mRSMBuffers);
+		passed &= Check("high: RSM on compute with previous buffers", placement, "%.0f passes on compute", double(scheduler.GetQueue(rsm) + scheduler.GetQueue(vct)));
+
+		// compute waits on the G-buffer (list #1) only, lighting waits for compute
+		bool afterList1 = false, lightingWaits = false;
+		const std::vector<Scheduler::Step>& graphicsSteps = scheduler.GetSteps(Scheduler::GRAPHICS_QUEUE);
+		for (const Scheduler::Fence& fence : scheduler.GetFences())
+		{
+			if (fence.mWaitQueue == Scheduler::COMPUTE_QUEUE)
+				afterList1 = graphicsSteps[fence.mSignalStep].mPass == passes.mGBuffer || graphicsSteps[fence.mSignalStep].mHistoryCopy;
+			else if (fence.mWaitStep != Scheduler::END_OF_FRAME)
+				lightingWaits = graphicsSteps[fence.mWaitStep].mPass == passes.mLighting;
+		}
+		passed &= Check("high: compute waits after list #1", afterList1, "%.0f fences", double(scheduler.GetFences().size()));
+		passed &= Check("high: lighting waits for compute", lightingWaits, "%.0f fences", double(scheduler.GetFences().size()));
+		passed &= Check("high: critical path 6.97", Near(scheduler.GetCriticalPathLength(), 6.97f), "%.2f", scheduler.GetCriticalPathLength());
+		passed &= Check("high: serial 9.10", Near(scheduler.GetSerialLength(), 9.10f), "%.2f", scheduler.GetSerialLength());
+		int problems = CheckTiming(scheduler, SceneDependencies(passes), "high");
+		passed &= Check("high: schedule timing holds", problems == 0, "%.0f problems", double(problems));
+	}
+
+	for (bool useLPV : { false, true })
+	{
+		// Low tier: 64 RSM samples, 1 cone
+		GIPassGraph::Passes passes = BuildScene(scheduler, 64, 1, useLPV);
+		if (verbose)
+			std::printf("%s", scheduler.GetScheduleString().c_str());
+		std::string prefix = useLPV ? "low with LPV: " : "low: ";
+		float criticalPath = useLPV ? 4.87f : 4.07f, serial = useLPV ? 5.85f : 5.05f;
+		char name[64];
+		Scheduler::PassId rsm = passes.mRSM, vct = passes.mVCT;
+		bool placement = scheduler.GetQueue(rsm) == Scheduler::COMPUTE_QUEUE && scheduler.GetQueue(vct) == Scheduler::COMPUTE_QUEUE;
+		passed &= Check((prefix + "RSM and VCT on compute").c_str(), placement, "%.0f passes on compute", double(scheduler.GetQueue(rsm) + scheduler.GetQueue(vct)));
+		std::snprintf(name, sizeof(name), "%scritical path %.2f", prefix.c_str(), criticalPath);
+		passed &= Check(name, Near(scheduler.GetCriticalPathLength(), criticalPath), "%.2f", scheduler.GetCriticalPathLength());
+		std::snprintf(name, sizeof(name), "%sserial %.2f", prefix.c_str(), serial);
+		passed &= Check(name, Near(scheduler.GetSerialLength(), serial), "%.2f", scheduler.GetSerialLength());
+		int problems = CheckTiming(scheduler, SceneDependencies(passes), prefix.c_str());
+		passed &= Check((prefix + "schedule timing holds").c_str(), problems == 0, "%.0f problems", double(problems));
+	}
+
+	{
+		// the other RSM gathers and the scene with its GI off, at the high tier
+		struct Variant
+		{
+			const char* mName;
+			GIPassGraph::Settings mSettings;
+		};
+		std::vector<Variant> variants(5);
+		variants[0].mName = "lightcuts";
+		variants[0].mSettings.mRSMUseLightcuts = true;
+		variants[1].mName = "tiles";
+		variants[1].mSettings.mRSMUseTileClassification = true;
+		variants[2].mName = "interleaved";
+		variants[2].mSettings.mRSMInterleaveSize = 2;
+		variants[2].mSettings.mRSMTemporalAccumulation = true;
+		variants[3].mName = "pixel shader RSM";
+		variants[3].mSettings.mRSMComputeVersion = false;
+		variants[4].mName = "GI off";
+		variants[4].mSettings.mUseRSM = variants[4].mSettings.mUseLPV = variants[4].mSettings.mUseVCT = false;
+
+		int problems = 0;
+		for (Variant& variant : variants)
+		{
+			variant.mSettings.mVCTConesCount = 6;
+			GIPassGraph::Passes passes = GIPassGraph::Build(scheduler, variant.mSettings);
+			scheduler.Schedule();
+			if (verbose)
+				std::printf("%s", scheduler.GetScheduleString().c_str());
+			problems += CheckTiming(scheduler, SceneDependencies(passes), variant.mName);
+		}
+		passed &= Check("other settings: schedule timing holds", problems == 0, "%.0f problems", double(problems));
+	}
+
+	{
+		// A, then B on either queue, then C that needs B. With A and C in one graphics submission, B on compute
+		// would have to be waited for before A, which B itself waits for.
+		for (bool split : { false, true })
+		{
+			scheduler.Clear();
+			scheduler.SetFenceCost(0.02f);
+			Scheduler::PassId a = scheduler.AddPass("A", 1.0f);
+			Scheduler::PassId b = scheduler.AddPass("B", 2.0f, true, 2.0f);
+			Scheduler::PassId x = scheduler.AddPass("X", 2.0f);
+			Scheduler::PassId c = scheduler.AddPass("C", 1.0f);
+			scheduler.AddDependency(b, a);
+			scheduler.AddDependency(c, b);
+			scheduler.AddDependency(c, x);
+			if (split)
+			{
+				scheduler.SetSubmissionStart(x);
+				scheduler.SetSubmissionStart(c);
+			}
+			scheduler.Schedule();
+			if (verbose)
+				std::printf("%s", scheduler.GetScheduleString().c_str());
+
+			std::vector<Dependency> dependencies = { { b, a }, { c, b }, { c, x } };
+			int problems = CheckTiming(scheduler, dependencies, split ? "split" : "single");
+			if (!split)
+				passed &= Check("one submission keeps B on graphics", scheduler.GetQueue(b) == Scheduler::GRAPHICS_QUEUE && problems == 0, "%.2f", scheduler.GetCriticalPathLength());
+			else
+				passed &= Check("split submissions move B to compute", scheduler.GetQueue(b) == Scheduler::COMPUTE_QUEUE && problems == 0 &&
+					scheduler.GetCriticalPathLength() < scheduler.GetSerialLength(), "%.2f", scheduler.GetCriticalPathLength());
+		}
+	}
+
+	{
+		std::vector<Dependency> dependencies;
+		BuildWide(scheduler, Scheduler::MAX_EXHAUSTIVE_DECISIONS, dependencies);
+		float exhaustive = scheduler.GetCriticalPathLength();
+		int problems = CheckTiming(scheduler, dependencies, "exhaustive");
+		passed &= Check("16 decisions search exhaustively", problems == 0 && exhaustive < scheduler.GetSerialLength(), "%.2f", exhaustive);
+
+		dependencies.clear();
+		BuildWide(scheduler, Scheduler::MAX_EXHAUSTIVE_DECISIONS + 1, dependencies);
+		float greedy = scheduler.GetCriticalPathLength();
+		problems = CheckTiming(scheduler, dependencies, "greedy");
+		uint32_t onCompute = 0;
+		for (Scheduler::PassId pass = 0; pass < scheduler.GetPassCount(); pass++)
+			onCompute += scheduler.GetQueue(pass) == Scheduler::COMPUTE_QUEUE;
+		passed &= Check("17 decisions fall back to greedy", problems == 0 && onCompute > 0 && greedy < scheduler.GetSerialLength(), "%.0f passes on compute", double(onCompute));
+		// one more unit pass and half a unit more of graphics work: at most 1.5 longer than the exhaustive result
+		passed &= Check("greedy stays close to exhaustive", greedy <= exhaustive + 1.5f + 1e-3f, "%.2f", greedy);
+	}
+
+	{
+		Scheduler empty;
+		passed &= Check("empty graph does not schedule", !empty.Schedule(), "%.0f passes", double(empty.GetPassCount()));
+		Scheduler order;
+		Scheduler::PassId first = order.AddPass("First", 1.0f);
+		Scheduler::PassId second = order.AddPass("Second", 1.0f);
+		passed &= Check("dependencies follow submission order", !order.AddDependency(first, second) && order.AddDependency(second, first), "%.0f passes", double(order.GetPassCount()));
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,241 @@
+// Checks the scenario parser, the camera path and the run bookkeeping of the benchmark mode (BenchmarkScenario,
+// BenchmarkRunner) with synthetic frame times.
+//   sample     the checked-in scenario parses into 20 runs in matrix order, with its frame counts and keyframes
+//   parser     every malformed directive fails with its line number and leaves the scenario empty; comments, defaults,
+//              keyframe sorting, repeated technique sets and ratios of techniques that are off do not add runs
+//   path       the camera passes through every keyframe, clamps outside the path, keeps a continuous velocity across
+//              unevenly spaced keyframes and stays on the line through collinear, evenly spaced ones
+//   runner     warmup frames hold the camera at the start, measured frames advance one timestep each, GPU times only
+//              count while measuring, every run is reported once in scenario order
+//   stats      nearest-rank percentiles on 1..100 ms, one hitch in a steady run, jitter of alternating frames,
+//              a CSV row per run
+//
+//   BenchmarkCheck [--scenario path]
+//
+// --scenario defaults to profiling/benchmarks/gi_techniques.txt, relative to the repository root. Prints a line per
+// check and exits with 1 if any fails and 2 on bad arguments. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o BenchmarkCheck tools/BenchmarkCheck/main.cpp source/BenchmarkScenario.cpp source/BenchmarkRunner.cpp source/FrameTimeStats.cpp
+
+#include "../Check.h"
+#include "BenchmarkRunner.h"
+#include "BenchmarkScenario.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: BenchmarkCheck [--scenario path]\n";
+		return 2;
+	}
+
+	typedef BenchmarkScenario::Vector3 Vector3;
+
+	double Distance(const Vector3& a, const Vector3& b)
+	{
+		return std::sqrt(double(a.x - b.x) * (a.x - b.x) + double(a.y - b.y) * (a.y - b.y) + double(a.z - b.z) * (a.z - b.z));
+	}
+
+	Vector3 Position(const BenchmarkScenario& scenario, double time)
+	{
+		Vector3 position, target;
+		scenario.EvaluateCamera(time, position, target);
+		return position;
+	}
+
+	// A scenario that has to fail on the given line
+	struct Malformed
+	{
+		const char* mText;
+		int mLine;
+	};
+
+	const Malformed MalformedScenarios[] = {
+		{ "camera 0 0 0 0 0 0 1\nresolution 1920\n", 2 },
+		{ "camera 0 0 0 0 0 0 1\nframes\n", 2 },
+		{ "camera 0 0 0 0 0 0 1\nframes 0\n", 2 },
+		{ "camera 0 0 0 0 0 0 1\nframes -5\n", 2 },
+		{ "camera 0 0 0 0 0 0 1\nwarmup 10 20\n", 2 },
+		{ "# header\ncamera 0 0 0 0 0 0 1\n\ntimestep 0\n", 4 },
+		{ "camera 0 0 0 0 0 0\n", 1 },
+		{ "camera 0 0 0 0 0 0 x\n", 1 },
+		{ "camera 1 0 0 0 0 0 1\ncamera 1 5 0 0 0 0 1\n", 2 },
+		{ "camera 0 0 0 0 0 0 1\ngi rsm+ssao\n", 2 },
+		{ "camera 0 0 0 0 0 0 1\ngi none rsm+\n", 2 },
+		{ "camera 0 0 0 0 0 0 1\nasync yes\n", 2 },
+		{ "camera 0 0 0 0 0 0 1\nrsm_ratio 0.5 0\n", 2 },
+		{ "camera 0 0 0 0 0 0 1\nvct_ratio 1.5\n", 2 },
+	};
+}
+
+int main(int argc, char** argv)
+{
+	std::string scenarioPath = (FindRepoRoot(argv[0]) / "profiling" / "benchmarks" / "gi_techniques.txt").string();
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--scenario" && hasValue)
+			scenarioPath = argv[++i];
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+	std::string error;
+
+	{
+		BenchmarkScenario scenario;
+		bool loaded = scenario.Load(scenarioPath, error);
+		if (!loaded)
+			std::printf("    %s\n", error.c_str());
+		passed &= Check("sample scenario loads", loaded && scenario.GetName() == "gi_techniques" && scenario.GetFrameCount() == 600 &&
+			scenario.GetWarmupFrameCount() == 60 && scenario.GetKeyframes().size() == 4, "%.0f keyframes", double(scenario.GetKeyframes().size()));
+
+		// per async setting: none, rsm x 2 ratios, lpv, vct x 2 ratios, rsm+lpv+vct x 4
+		const std::vector<BenchmarkScenario::Run>& runs = scenario.GetRuns();
+		passed &= Check("sample scenario expands into 20 runs", runs.size() == 20, "%.0f runs", double(runs.size()));
+		bool order = runs.size() == 20 && runs[0].mName == "none" && runs[1].mName == "none async" &&
+			runs[2].mName == "rsm rsm_ratio=0.33333" && runs[3].mName == "rsm rsm_ratio=0.5" &&
+			runs[19].mName == "rsm+lpv+vct async rsm_ratio=0.5 vct_ratio=1";
+		passed &= Check("runs follow the matrix order", order, "%.0f runs", double(runs.size()));
+
+		BenchmarkScenario missing;
+		bool failed = !missing.Load("does/not/exist.txt", error) && error.find("cannot open") == 0;
+		passed &= Check("a missing file fails", failed, "%.0f runs", double(missing.GetRuns().size()));
+	}
+
+	{
+		int named = 0, emptied = 0;
+		for (const Malformed& malformed : MalformedScenarios)
+		{
+			BenchmarkScenario scenario;
+			scenario.Parse("camera 0 1 2 3 4 5 6\n", error);
+			bool failed = !scenario.Parse(malformed.mText, error);
+			named += failed && error.find("line " + std::to_string(malformed.mLine) + ": ") == 0;
+			emptied += scenario.GetRuns().empty() && scenario.GetKeyframes().empty();
+			if (!failed || error.find("line " + std::to_string(malformed.mLine) + ": ") != 0)
+				std::printf("    expected line %d, got \"%s\"\n", malformed.mLine, error.c_str());
+		}
+		const int count = int(sizeof(MalformedScenarios) / sizeof(MalformedScenarios[0]));
+		passed &= Check("malformed directives name their line", named == count, "%.0f of 14", double(named));
+		passed &= Check("a failed parse leaves the scenario empty", emptied == count, "%.0f of 14", double(emptied));
+
+		BenchmarkScenario scenario;
+		bool noPath = !scenario.Parse("name no camera\ngi rsm\n", error) && error == "the scenario has no camera keyframes";
+		passed &= Check("a scenario needs a keyframe", noPath, "%.0f runs", double(scenario.GetRuns().size()));
+	}
+
+	{
+		BenchmarkScenario scenario;
+		bool parsed = scenario.Parse("# only a path\ncamera 2 0 0 0 0 0 1   # end\ncamera 0 0 0 0 0 0 1\n", error);
+		const std::vector<BenchmarkScenario::Run>& runs = scenario.GetRuns();
+		bool defaults = parsed && runs.size() == 1 && runs[0].mName == "none" && !runs[0].mAsyncCompute &&
+			runs[0].mRSMRatio == BenchmarkScenario::DEFAULT_RSM_RATIO && runs[0].mVCTRatio == BenchmarkScenario::DEFAULT_VCT_RATIO &&
+			scenario.GetName() == "benchmark" && scenario.GetFrameCount() == BenchmarkScenario::DEFAULT_FRAMES;
+		passed &= Check("missing axes use the defaults", defaults, "%.0f runs", double(runs.size()));
+		passed &= Check("keyframes are sorted by time", scenario.GetKeyframes().front().mTime == 0.0 && scenario.GetDuration() == 2.0, "%.1f s", scenario.GetDuration());
+
+		parsed = scenario.Parse("camera 0 0 0 0 0 0 1\ngi lpv vct lpv\nrsm_ratio 0.25 0.5 1\nvct_ratio 0.5 1\n", error);
+		passed &= Check("ratios of disabled techniques add no runs", parsed && scenario.GetRuns().size() == 3, "%.0f runs", double(scenario.GetRuns().size()));
+	}
+
+	{
+		BenchmarkScenario scenario;
+		scenario.Parse("camera 0 0 0 0 0 0 1\ncamera 1 4 1 0 0 0 1\ncamera 4 6 -2 3 0 0 1\ncamera 4.5 9 0 0 0 0 1\n", error);
+		double worst = 0.0;
+		for (const BenchmarkScenario::Keyframe& keyframe : scenario.GetKeyframes())
+			worst = std::max(worst, Distance(Position(scenario, keyframe.mTime), keyframe.mPosition));
+		passed &= Check("the path passes through every keyframe", worst < 1e-5, "%.1e off", worst);
+
+		bool clamped = Distance(Position(scenario, -1.0), scenario.GetKeyframes().front().mPosition) < 1e-6 &&
+			Distance(Position(scenario, 10.0), scenario.GetKeyframes().back().mPosition) < 1e-6;
+		passed &= Check("the path clamps at both ends", clamped, "%.1f s long", scenario.GetDuration());
+
+		// one-sided differences on both sides of the interior keyframes
+		const double h = 1e-4;
+		double jump = 0.0;
+		for (double time : { 1.0, 4.0 })
+		{
+			Vector3 before = Position(scenario, time - h), at = Position(scenario, time), after = Position(scenario, time + h);
+			Vector3 in = { float((at.x - before.x) / h), float((at.y - before.y) / h), float((at.z - before.z) / h) };
+			Vector3 out = { float((after.x - at.x) / h), float((after.y - at.y) / h), float((after.z - at.z) / h) };
+			jump = std::max(jump, Distance(in, out));
+		}
+		passed &= Check("velocity is continuous across keyframes", jump < 0.05, "%.3f jump", jump);
+
+		scenario.Parse("camera 0 0 0 0 0 0 1\ncamera 1 1 2 3 0 0 1\ncamera 2 2 4 6 0 0 1\ncamera 3 3 6 9 0 0 1\n", error);
+		double offLine = 0.0;
+		for (double time = 0.0; time <= 3.0; time += 0.125)
+			offLine = std::max(offLine, Distance(Position(scenario, time), { float(time), float(2.0 * time), float(3.0 * time) }));
+		passed &= Check("collinear keyframes give a straight path", offLine < 1e-4, "%.1e off", offLine);
+	}
+
+	{
+		BenchmarkScenario scenario;
+		scenario.Parse("frames 100\nwarmup 5\ntimestep 0.02\ncamera 0 0 0 0 0 0 1\ncamera 10 10 0 0 0 0 1\ngi none rsm\nrsm_ratio 0.5\n", error);
+		BenchmarkRunner runner(scenario);
+		int starts = 0, warmupMoved = 0, badTime = 0;
+		uint32_t frames = 0;
+		while (!runner.IsFinished())
+		{
+			starts += runner.IsRunStart();
+			if (!runner.IsMeasuring())
+			{
+				warmupMoved += runner.GetCameraTime() != 0.0;
+				runner.AddGpuTimes(1000.0, 1000.0);
+			}
+			else
+			{
+				badTime += std::fabs(runner.GetCameraTime() - 0.02 * (runner.GetFrame() - 5)) > 1e-12;
+				runner.AddGpuTimes(2.0 + runner.GetRunIndex(), 0.5);
+			}
+			// frame times 1..100 ms in a shuffled order, the warmup ones are far off
+			runner.EndFrame(runner.IsMeasuring() ? double((runner.GetFrame() - 5) * 37 % 100 + 1) : 1000.0);
+			frames++;
+		}
+		passed &= Check("every run starts once", starts == 2 && runner.GetResults().size() == 2 && frames == 2 * 105, "%.0f frames", double(frames));
+		passed &= Check("warmup holds the camera at the start", warmupMoved == 0, "%.0f moved", double(warmupMoved));
+		passed &= Check("measured frames advance one timestep", badTime == 0, "%.0f off", double(badTime));
+
+		const BenchmarkRunner::RunResult& first = runner.GetResults()[0];
+		bool gpu = first.mGraphics.mCount == 100 && first.mGraphics.mMaxMs == 2.0 && runner.GetResults()[1].mGraphics.mAverageMs == 3.0;
+		passed &= Check("GPU times only count while measuring", gpu, "%.0f samples", double(first.mGraphics.mCount));
+
+		const BenchmarkRunner::Summary& frame = first.mFrame;
+		bool exact = frame.mCount == 100 && frame.mMinMs == 1.0 && frame.mMaxMs == 100.0 && frame.mP50Ms == 50.0 && frame.mP95Ms == 95.0 &&
+			frame.mP99Ms == 99.0 && std::fabs(frame.mAverageMs - 50.5) < 1e-9;
+		passed &= Check("percentiles are exact on 1..100 ms", exact, "p95 %.1f ms", frame.mP95Ms);
+
+		std::string csv = runner.ExportCSV();
+		bool rows = std::count(csv.begin(), csv.end(), '\n') == 3 && csv.find("\n\"rsm rsm_ratio=0.5\",rsm,off,0.5") != std::string::npos;
+		passed &= Check("CSV has a row per run", rows, "%.0f rows", double(std::count(csv.begin(), csv.end(), '\n') - 1));
+		std::string json = runner.ExportJSON();
+		passed &= Check("JSON lists the frames of every run", json.find("\"frameMs\": [") != std::string::npos && json.find("\"timestep\": 0.020000") != std::string::npos,
+			"%.0f bytes", double(json.size()));
+	}
+
+	{
+		std::vector<double> steady(120, 16.0);
+		steady[60] = 50.0;
+		BenchmarkRunner::Summary hitch = BenchmarkRunner::Summarize(steady);
+		passed &= Check("one slow frame in a steady run is a hitch", hitch.mHitchCount == 1 && hitch.mJitterMs < 1.0, "%.0f hitches", double(hitch.mHitchCount));
+
+		std::vector<double> alternating;
+		for (int i = 0; i < 120; i++)
+			alternating.push_back(i % 2 ? 30.0 : 10.0);
+		BenchmarkRunner::Summary uneven = BenchmarkRunner::Summarize(alternating);
+		BenchmarkRunner::Summary even = BenchmarkRunner::Summarize(std::vector<double>(120, 20.0));
+		bool pacing = std::fabs(uneven.mJitterMs - 20.0) < 1e-9 && std::fabs(uneven.mStdDevMs - 10.0) < 1e-9 && even.mJitterMs == 0.0 &&
+			std::fabs(uneven.mAverageMs - even.mAverageMs) < 1e-9;
+		passed &= Check("jitter tells alternating from steady frames", pacing, "%.1f ms jitter", uneven.mJitterMs);
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+// Report helpers shared by the checks and benches under tools/. Every tool prints one line per check with its name,
+// a detail and ok or FAILED, and exits with 1 if any fails; RunChecks.sh builds and runs them all.
+
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+inline void PrintCheck(const char* name, const char* detail, const char* status)
+{
+	std::printf("%-52s %-30s %s\n", name, detail, status);
+}
+
+// Prints the check with value formatted into its detail, returns passed
+inline bool Check(const char* name, bool passed, const char* format, double value)
+{
+	char detail[128];
+	std::snprintf(detail, sizeof(detail), format, value);
+	PrintCheck(name, detail, passed ? "ok" : "FAILED");
+	return passed;
+}
+
+// The directory holding DXR-Sandbox.vcxproj, searched upwards from the working directory and then from the
+// executable, so checked in fixtures load wherever a tool is started from. Empty if neither is inside the repo.
+inline std::filesystem::path FindRepoRoot(const char* executable)
+{
+	namespace fs = std::filesystem;
+	std::error_code error;
+	fs::path starts[] = { fs::current_path(error), fs::absolute(fs::path(executable), error).parent_path() };
+	for (const fs::path& start : starts)
+	{
+		for (fs::path directory = start; !directory.empty(); directory = directory.parent_path())
+		{
+			if (fs::is_regular_file(directory / "DXR-Sandbox.vcxproj", error))
+				return directory;
+			if (directory == directory.parent_path())
+				break;
+		}
+	}
+	return fs::path();
+}
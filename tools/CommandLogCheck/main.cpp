@@ -0,0 +1,359 @@
+// Checks the binary format of CommandLog and the totals CommandLogAnalyzer reports for a log.
+//   round trip  a frame recorded the way the GI scene records it (graphics list with GBuffer and Shadows passes,
+//               compute list with nested LPV passes, back to graphics for Composite) is written to a file, loaded
+//               and decoded into the same commands, list switches included; varints hold 0 to 2^64 - 1
+//   damage      every cut of the log fails with its byte offset unless it ends on a record, and leaves no
+//               commands; a bad magic, a new version, an unknown op, a command before any list and a list record
+//               without its type fail too
+//   totals      three captured frames give the hand counted commands, draws, dispatches, barriers, descriptor
+//               copies and redundant state changes per pass: repeated values, root arguments dropped by a new
+//               root signature, state dropped by bundles and ClearState, viewports kept across bundles;
+//               unbalanced passes are counted, the CSV has a row per pass
+//
+//   CommandLogCheck [--log command_log.bin]
+//
+// --log additionally checks a log captured by the sandbox (profiling/command_log.bin): it must parse, have balanced
+// passes and pass counts that add up to the per op totals. Prints a line per check and exits with 1 if any fails and
+// 2 on bad arguments. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o CommandLogCheck tools/CommandLogCheck/main.cpp source/CommandLog.cpp source/CommandLogAnalyzer.cpp
+
+#include "../Check.h"
+#include "CommandLog.h"
+#include "CommandLogAnalyzer.h"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: CommandLogCheck [--log command_log.bin]\n";
+		return 2;
+	}
+
+	// D3D12_COMMAND_LIST_TYPE
+	const uint32_t DIRECT = 0;
+	const uint32_t COMPUTE = 2;
+
+	// One frame shaped like the GI scene's; the comments count what each pass must report
+	void RecordFrame(CommandLog& log, uint64_t frame)
+	{
+		typedef CommandLog L;
+		log.BeginFrame(frame);
+
+		// (no pass) on direct: Reset, heaps and Close, 3 commands, 1 state set
+		log.Add(0, DIRECT, L::OP_RESET, {});
+		log.Add(0, DIRECT, L::OP_SET_DESCRIPTOR_HEAPS, { 1, 7 });
+
+		// GBuffer: 63 commands, 10 draws, 4 barriers in 1 call, 5 clears, 47 state sets of which 19 redundant
+		log.BeginPass(0, DIRECT, "GBuffer");
+		log.Add(0, DIRECT, L::OP_BARRIER, { 4, 0, 0 });
+		for (int i = 0; i < 4; i++)
+			log.Add(0, DIRECT, L::OP_CLEAR, { L::CLEAR_RTV });
+		log.Add(0, DIRECT, L::OP_CLEAR, { L::CLEAR_DSV });
+		log.Add(0, DIRECT, L::OP_SET_PIPELINE_STATE, { 11 });
+		log.Add(0, DIRECT, L::OP_SET_ROOT_SIGNATURE, { L::BIND_GRAPHICS, 21 });
+		log.Add(0, DIRECT, L::OP_SET_VIEWPORTS, { 1, 31 });
+		log.Add(0, DIRECT, L::OP_SET_SCISSOR_RECTS, { 1, 32 });
+		log.Add(0, DIRECT, L::OP_SET_RENDER_TARGETS, { 5, 33 });
+		log.Add(0, DIRECT, L::OP_SET_PRIMITIVE_TOPOLOGY, { 4 });
+		for (uint64_t object = 0; object < 10; object++)
+		{
+			// the table and index buffer repeat after the first object, the vertex buffers alternate
+			log.Add(0, DIRECT, L::OP_SET_ROOT_CONSTANTS, { L::BIND_GRAPHICS, 0, 0, 16, 100 + object });
+			log.Add(0, DIRECT, L::OP_SET_ROOT_TABLE, { L::BIND_GRAPHICS, 1, 41 });
+			log.Add(0, DIRECT, L::OP_SET_VERTEX_BUFFERS, { 0, 1, 50 + object % 2 });
+			log.Add(0, DIRECT, L::OP_SET_INDEX_BUFFER, { 60 });
+			log.Add(0, DIRECT, L::OP_DRAW_INDEXED, { 36, 1 });
+		}
+		log.Add(0, DIRECT, L::OP_SET_PIPELINE_STATE, { 11 });
+		log.EndPass(0, DIRECT);
+
+		// Shadows: 13 commands, 4 draws, 9 state sets of which 2 redundant (the viewport and the second table)
+		log.BeginPass(0, DIRECT, "Shadows");
+		log.Add(0, DIRECT, L::OP_SET_ROOT_SIGNATURE, { L::BIND_GRAPHICS, 22 });
+		log.Add(0, DIRECT, L::OP_SET_ROOT_TABLE, { L::BIND_GRAPHICS, 1, 41 });
+		log.Add(0, DIRECT, L::OP_SET_VIEWPORTS, { 1, 31 });
+		log.Add(0, DIRECT, L::OP_SET_PIPELINE_STATE, { 12 });
+		for (uint64_t cascade = 0; cascade < 4; cascade++)
+		{
+			log.Add(0, DIRECT, L::OP_SET_ROOT_CONSTANTS, { L::BIND_GRAPHICS, 0, 0, 1, cascade });
+			log.Add(0, DIRECT, L::OP_DRAW_INDEXED, { 36, 10 });
+		}
+		log.Add(0, DIRECT, L::OP_SET_ROOT_TABLE, { L::BIND_GRAPHICS, 1, 41 });
+		log.EndPass(0, DIRECT);
+		log.Add(0, DIRECT, L::OP_CLOSE, {});
+
+		// (no pass) on compute: Reset and Close
+		log.Add(1, COMPUTE, L::OP_RESET, {});
+		log.BeginPass(1, COMPUTE, "LPV");
+		// LPV/Injection: 5 commands, 1 dispatch, 1 UAV barrier, 3 state sets
+		log.BeginPass(1, COMPUTE, "Injection");
+		log.Add(1, COMPUTE, L::OP_SET_PIPELINE_STATE, { 13 });
+		log.Add(1, COMPUTE, L::OP_SET_ROOT_SIGNATURE, { L::BIND_COMPUTE, 23 });
+		log.Add(1, COMPUTE, L::OP_SET_ROOT_TABLE, { L::BIND_COMPUTE, 0, 42 });
+		log.Add(1, COMPUTE, L::OP_DISPATCH, { 8, 8, 1 });
+		log.Add(1, COMPUTE, L::OP_BARRIER, { 0, 0, 1 });
+		log.EndPass(1, COMPUTE);
+		// LPV/Propagation: 26 commands, 8 dispatches, 8 barriers, 10 state sets of which the last pipeline is redundant
+		log.BeginPass(1, COMPUTE, "Propagation");
+		log.Add(1, COMPUTE, L::OP_SET_PIPELINE_STATE, { 14 });
+		for (uint64_t step = 0; step < 8; step++)
+		{
+			log.Add(1, COMPUTE, L::OP_SET_ROOT_CONSTANTS, { L::BIND_COMPUTE, 1, 0, 1, step });
+			log.Add(1, COMPUTE, L::OP_DISPATCH, { 4, 4, 4 });
+			log.Add(1, COMPUTE, L::OP_BARRIER, { 0, 0, 1 });
+		}
+		log.Add(1, COMPUTE, L::OP_SET_PIPELINE_STATE, { 14 });
+		log.EndPass(1, COMPUTE);
+		// LPV itself: the 12 descriptors copied while it is open
+		log.AddToCurrentList(L::OP_DESCRIPTOR_COPY, { 12 });
+		log.EndPass(1, COMPUTE);
+		log.Add(1, COMPUTE, L::OP_CLOSE, {});
+
+		// Composite: 7 commands, 1 draw, 1 copy, 3 state sets of which the viewport kept across the bundle is redundant
+		log.BeginPass(0, DIRECT, "Composite");
+		log.Add(0, DIRECT, L::OP_EXECUTE_BUNDLE, { 77 });
+		log.Add(0, DIRECT, L::OP_SET_PIPELINE_STATE, { 12 });
+		log.Add(0, DIRECT, L::OP_SET_VIEWPORTS, { 1, 31 });
+		log.Add(0, DIRECT, L::OP_OTHER, { L::OTHER_CLEAR_STATE });
+		log.Add(0, DIRECT, L::OP_SET_VIEWPORTS, { 1, 31 });
+		log.Add(0, DIRECT, L::OP_DRAW, { 3, 1 });
+		log.Add(0, DIRECT, L::OP_COPY, { L::COPY_RESOURCE });
+		log.EndPass(0, DIRECT);
+	}
+
+	struct Expected
+	{
+		const char* mName;
+		uint32_t mListType;
+		uint64_t mCommands, mDraws, mDispatches, mBarriers, mStateSets, mRedundant, mDescriptorCopies;
+	};
+
+	// Per frame, in the order the passes were first recorded
+	const Expected ExpectedPasses[] =
+	{
+		{ "(no pass)", DIRECT, 3, 0, 0, 0, 1, 0, 0 },
+		{ "GBuffer", DIRECT, 63, 10, 0, 4, 47, 19, 0 },
+		{ "Shadows", DIRECT, 13, 4, 0, 0, 9, 2, 0 },
+		{ "(no pass)", COMPUTE, 2, 0, 0, 0, 0, 0, 0 },
+		{ "LPV", COMPUTE, 1, 0, 0, 0, 0, 0, 12 },
+		{ "LPV/Injection", COMPUTE, 5, 0, 1, 1, 3, 0, 0 },
+		{ "LPV/Propagation", COMPUTE, 26, 0, 8, 8, 10, 1, 0 },
+		{ "Composite", DIRECT, 7, 1, 0, 0, 3, 1, 0 },
+	};
+
+	bool SameCommands(const std::vector<CommandLog::Command>& a, const std::vector<CommandLog::Command>& b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (a[i].mOp != b[i].mOp || a[i].mList != b[i].mList || a[i].mListType != b[i].mListType || a[i].mArgs != b[i].mArgs || a[i].mName != b[i].mName)
+				return false;
+		}
+		return true;
+	}
+
+	// Pass counts add up to the per op totals and every pass is closed
+	bool Consistent(const CommandLogAnalyzer& analyzer)
+	{
+		uint64_t commands = 0, draws = 0, dispatches = 0, stateSets = 0, redundant = 0;
+		for (const CommandLogAnalyzer::PassStats& pass : analyzer.GetPasses())
+		{
+			commands += pass.mCommands;
+			draws += pass.mDraws;
+			dispatches += pass.mDispatches;
+			stateSets += pass.mStateSets;
+			redundant += pass.mRedundantStateSets;
+		}
+		uint64_t opStateSets = 0, opRedundant = 0;
+		for (int op = CommandLog::OP_SET_PIPELINE_STATE; op <= CommandLog::OP_SET_STENCIL_REF; op++)
+		{
+			opStateSets += analyzer.GetOpStats(CommandLog::Op(op)).mCount;
+			opRedundant += analyzer.GetOpStats(CommandLog::Op(op)).mRedundant;
+		}
+		uint64_t opDraws = analyzer.GetOpStats(CommandLog::OP_DRAW).mCount + analyzer.GetOpStats(CommandLog::OP_DRAW_INDEXED).mCount +
+			analyzer.GetOpStats(CommandLog::OP_EXECUTE_INDIRECT).mCount;
+		return commands == analyzer.GetCommandCount() && draws == opDraws && dispatches == analyzer.GetOpStats(CommandLog::OP_DISPATCH).mCount &&
+			stateSets == opStateSets && redundant == opRedundant && analyzer.GetUnbalancedPassCount() == 0;
+	}
+
+	size_t Lines(const std::string& text)
+	{
+		size_t lines = 0;
+		for (char c : text)
+			lines += c == '\n';
+		return lines;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	fs::path capturedLog;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--log" && hasValue)
+			capturedLog = argv[++i];
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+	std::string error;
+	const uint64_t frames = 3;
+
+	CommandLog log;
+	for (uint64_t frame = 0; frame < frames; frame++)
+		RecordFrame(log, 1000 + frame);
+
+	std::vector<CommandLog::Command> commands;
+	{
+		fs::path path = fs::temp_directory_path() / "CommandLogCheck.bin";
+		bool written = log.Write(path);
+		bool loaded = written && CommandLog::Load(path, commands, error);
+		std::error_code ec;
+		fs::remove(path, ec);
+		std::vector<CommandLog::Command> parsed;
+		CommandLog::Parse(log.GetData(), parsed, error);
+		passed &= Check("round trip: a written log loads again", loaded && commands.size() == log.GetRecordCount() && SameCommands(commands, parsed),
+			"%.0f records", double(commands.size()));
+		std::printf("    %.0f bytes, %.1f per record\n", double(log.GetData().size()), double(log.GetData().size()) / double(log.GetRecordCount()));
+
+		// frame, list 0, Reset, heaps, BeginPass GBuffer, barrier, 4 + 1 clears, pipeline, root signature, 4 states, then
+		// object 0's constants, table, vertex and index buffers and its draw
+		bool decoded = commands.size() > 21 && commands[0].mOp == CommandLog::OP_FRAME && commands[0].mArgs == std::vector<uint64_t>{ 1000 } &&
+			commands[1].mOp == CommandLog::OP_LIST && commands[4].mName == "GBuffer" && commands[21].mOp == CommandLog::OP_DRAW_INDEXED &&
+			commands[21].mArgs == std::vector<uint64_t>{ 36, 1 } && commands[21].mList == 0;
+		uint32_t switches = 0;
+		for (const CommandLog::Command& command : commands)
+			switches += command.mOp == CommandLog::OP_LIST;
+		passed &= Check("round trip: commands and list switches", decoded && switches == 3 * frames, "%.0f list records", double(switches));
+
+		CommandLog wide;
+		const std::vector<uint64_t> values = { 0, 127, 128, 16383, 16384, uint64_t(1) << 63, ~uint64_t(0) };
+		wide.Add(5, COMPUTE, CommandLog::OP_DISPATCH, { values[0], values[1], values[2], values[3], values[4], values[5], values[6] });
+		std::vector<CommandLog::Command> wideCommands;
+		bool varints = CommandLog::Parse(wide.GetData(), wideCommands, error) && wideCommands.size() == 2 && wideCommands[1].mArgs == values &&
+			wideCommands[1].mList == 5 && wideCommands[1].mListType == COMPUTE;
+		passed &= Check("round trip: varints up to 2^64 - 1", varints, "%.0f bytes", double(wide.GetData().size()));
+	}
+
+	{
+		const std::vector<uint8_t>& data = log.GetData();
+		std::vector<CommandLog::Command> cut;
+		uint64_t complete = 0, failed = 0, wrong = 0;
+		// the header is the magic and a one byte version
+		for (size_t size = 9; size < data.size(); size++)
+		{
+			std::vector<uint8_t> prefix(data.begin(), data.begin() + size);
+			if (CommandLog::Parse(prefix, cut, error))
+				complete++;
+			else
+			{
+				failed++;
+				wrong += !cut.empty() || error.compare(0, 7, "offset ") != 0;
+			}
+		}
+		passed &= Check("damage: cuts parse only on record ends", complete == log.GetRecordCount() && wrong == 0, "%.0f failed cuts", double(failed));
+
+		int rejected = 0;
+		std::vector<uint8_t> bad = data;
+		bad[0] = 'X';
+		rejected += !CommandLog::Parse(bad, cut, error) && error == "not a command log";
+		bad = data;
+		bad[8] = 2;
+		rejected += !CommandLog::Parse(bad, cut, error) && error == "unsupported command log version 2";
+		bad = data;
+		bad[9] = 200;
+		rejected += !CommandLog::Parse(bad, cut, error) && error == "offset 9: unknown op 200";
+		bad = { 'D', 'X', 'R', 'S', 'C', 'M', 'D', 'L', 1, CommandLog::OP_DRAW, 0 };
+		rejected += !CommandLog::Parse(bad, cut, error) && error == "offset 9: DrawInstanced before any list";
+		bad = { 'D', 'X', 'R', 'S', 'C', 'M', 'D', 'L', 1, CommandLog::OP_LIST, 1, 0 };
+		rejected += !CommandLog::Parse(bad, cut, error) && error == "offset 9: list record without list and type";
+		bad = { 'D', 'X', 'R', 'S', 'C', 'M', 'D', 'L', 1, CommandLog::OP_LIST, 0xff, 0xff, 0xff, 0x0f };
+		rejected += !CommandLog::Parse(bad, cut, error) && error == "offset 9: truncated record";
+		passed &= Check("damage: malformed logs fail", rejected == 6 && cut.empty(), "%.0f of 6", double(rejected));
+	}
+
+	{
+		CommandLogAnalyzer analyzer;
+		analyzer.Analyze(commands);
+		const std::vector<CommandLogAnalyzer::PassStats>& passes = analyzer.GetPasses();
+		const size_t expectedCount = sizeof(ExpectedPasses) / sizeof(ExpectedPasses[0]);
+		uint32_t mismatches = 0;
+		uint64_t perFrame = 0, redundantPerFrame = 0;
+		for (size_t i = 0; i < expectedCount; i++)
+		{
+			const Expected& expected = ExpectedPasses[i];
+			perFrame += expected.mCommands;
+			redundantPerFrame += expected.mRedundant;
+			if (i >= passes.size())
+			{
+				mismatches++;
+				continue;
+			}
+			const CommandLogAnalyzer::PassStats& pass = passes[i];
+			bool same = pass.mName == expected.mName && pass.mListType == expected.mListType && pass.mInstances == (pass.mName == "(no pass)" ? 0 : frames) &&
+				pass.mCommands == frames * expected.mCommands && pass.mDraws == frames * expected.mDraws && pass.mDispatches == frames * expected.mDispatches &&
+				pass.mBarriers == frames * expected.mBarriers && pass.mStateSets == frames * expected.mStateSets &&
+				pass.mRedundantStateSets == frames * expected.mRedundant && pass.mDescriptorCopies == frames * expected.mDescriptorCopies;
+			if (!same)
+				std::printf("    %s: %llu commands, %llu state sets, %llu redundant\n", pass.mName.c_str(), (unsigned long long)pass.mCommands,
+					(unsigned long long)pass.mStateSets, (unsigned long long)pass.mRedundantStateSets);
+			mismatches += !same;
+		}
+		passed &= Check("totals: passes match the hand counts", mismatches == 0 && passes.size() == expectedCount, "%.0f passes", double(passes.size()));
+		passed &= Check("totals: commands and frames", analyzer.GetFrameCount() == frames && analyzer.GetCommandCount() == frames * perFrame,
+			"%.0f commands", double(analyzer.GetCommandCount()));
+
+		const CommandLogAnalyzer::OpStats& tables = analyzer.GetOpStats(CommandLog::OP_SET_ROOT_TABLE);
+		const CommandLogAnalyzer::OpStats& indices = analyzer.GetOpStats(CommandLog::OP_SET_INDEX_BUFFER);
+		const CommandLogAnalyzer::OpStats& pipelines = analyzer.GetOpStats(CommandLog::OP_SET_PIPELINE_STATE);
+		bool perOp = tables.mCount == 13 * frames && tables.mRedundant == 10 * frames && indices.mCount == 10 * frames && indices.mRedundant == 9 * frames &&
+			pipelines.mCount == 7 * frames && pipelines.mRedundant == 2 * frames;
+		passed &= Check("totals: redundant state per call", perOp, "%.0f redundant", double(frames * redundantPerFrame));
+		passed &= Check("totals: passes add up to the op totals", Consistent(analyzer), "%.0f unbalanced", double(analyzer.GetUnbalancedPassCount()));
+
+		std::string report = analyzer.FormatReport();
+		std::string csv = analyzer.ExportCSV();
+		bool exported = report.find("3 frame(s), 360 commands (120.0 per frame)") == 0 && Lines(csv) == passes.size() + 1 &&
+			csv.find("compute,\"LPV/Propagation\",1,3,78,0,24,24,24,30,3,0,0,0\n") != std::string::npos;
+		passed &= Check("totals: report and CSV", exported, "%.0f CSV rows", double(Lines(csv) - 1));
+
+		CommandLog unbalanced;
+		unbalanced.BeginFrame(0);
+		unbalanced.EndPass(0, DIRECT);
+		unbalanced.BeginPass(0, DIRECT, "Open at reset");
+		unbalanced.Add(0, DIRECT, CommandLog::OP_RESET, {});
+		unbalanced.BeginPass(1, COMPUTE, "Open at frame end");
+		unbalanced.BeginFrame(1);
+		unbalanced.BeginPass(0, DIRECT, "Open at log end");
+		std::vector<CommandLog::Command> unbalancedCommands;
+		CommandLog::Parse(unbalanced.GetData(), unbalancedCommands, error);
+		analyzer.Analyze(unbalancedCommands);
+		passed &= Check("totals: unbalanced passes are counted", analyzer.GetUnbalancedPassCount() == 4 &&
+			analyzer.FormatReport().find("warning: 4 unbalanced pass(es)") != std::string::npos, "%.0f unbalanced", double(analyzer.GetUnbalancedPassCount()));
+	}
+
+	if (!capturedLog.empty())
+	{
+		std::vector<CommandLog::Command> captured;
+		bool loaded = CommandLog::Load(capturedLog, captured, error);
+		if (!loaded)
+			std::printf("    %s\n", error.c_str());
+		CommandLogAnalyzer analyzer;
+		analyzer.Analyze(captured);
+		passed &= Check("captured: the log loads", loaded && analyzer.GetFrameCount() > 0, "%.0f frames", double(analyzer.GetFrameCount()));
+		passed &= Check("captured: passes add up to the op totals", loaded && Consistent(analyzer), "%.0f commands", double(analyzer.GetCommandCount()));
+	}
+
+	return passed ? 0 : 1;
+}
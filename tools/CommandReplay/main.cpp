@@ -0,0 +1,104 @@
+// Replays a command log captured by the sandbox (profiling/command_log.bin) and reports what every pass records.
+//
+//   CommandReplay <command_log.bin> [options]
+//     --csv <file>     also write the per pass counts as CSV
+//     --dump           print every decoded command
+//
+// Exits with 2 on bad arguments or logs. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o CommandReplay tools/CommandReplay/main.cpp source/CommandLog.cpp source/CommandLogAnalyzer.cpp
+
+#include "CommandLog.h"
+#include "CommandLogAnalyzer.h"
+
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: CommandReplay <command_log.bin> [--csv <file>] [--dump]\n";
+		return 2;
+	}
+
+	void Dump(const std::vector<CommandLog::Command>& commands)
+	{
+		uint32_t depth = 0;
+		for (const CommandLog::Command& command : commands)
+		{
+			if (command.mOp == CommandLog::OP_FRAME)
+			{
+				std::cout << "frame " << (command.mArgs.empty() ? 0 : command.mArgs[0]) << "\n";
+				depth = 0;
+				continue;
+			}
+			if (command.mOp == CommandLog::OP_LIST)
+			{
+				std::cout << "  list " << command.mList << " (" << CommandLog::GetListTypeName(command.mListType) << ")\n";
+				continue;
+			}
+			if (command.mOp == CommandLog::OP_END_PASS && depth > 0)
+				depth--;
+
+			std::cout << std::string(4 + depth * 2, ' ') << CommandLog::GetOpName(command.mOp);
+			if (command.mOp == CommandLog::OP_BEGIN_PASS)
+			{
+				std::cout << " \"" << command.mName << "\"";
+				depth++;
+			}
+			for (uint64_t arg : command.mArgs)
+				std::cout << " " << arg;
+			std::cout << "\n";
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string logPath;
+	std::string csvPath;
+	bool dump = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--dump")
+			dump = true;
+		else if (arg == "--csv" && i + 1 < argc)
+			csvPath = argv[++i];
+		else if (arg.compare(0, 2, "--") == 0 || !logPath.empty())
+			return Usage();
+		else
+			logPath = arg;
+	}
+
+	if (logPath.empty())
+		return Usage();
+
+	std::vector<CommandLog::Command> commands;
+	std::string error;
+	if (!CommandLog::Load(logPath, commands, error))
+	{
+		std::cerr << error << "\n";
+		return 2;
+	}
+
+	if (dump)
+		Dump(commands);
+
+	CommandLogAnalyzer analyzer;
+	analyzer.Analyze(commands);
+	std::cout << logPath << ": " << analyzer.FormatReport();
+
+	if (!csvPath.empty())
+	{
+		std::ofstream file(csvPath, std::ios::binary);
+		file << analyzer.ExportCSV();
+		if (!file)
+		{
+			std::cerr << "cannot write " << csvPath << "\n";
+			return 2;
+		}
+	}
+	return 0;
+}
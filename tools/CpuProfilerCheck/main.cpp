@@ -0,0 +1,280 @@
+// Checks the recording, capture and summaries of CpuProfiler and measures the cost of a marker.
+//   nesting     scopes are stored when they end, children before their parent, with their depth and inside the
+//               parent's time span; BeginScope/EndScope pairs nest with block scopes, past MAX_OPEN_SCOPES the
+//               deeper ones are skipped and the stack stays balanced, an EndScope without a scope does nothing
+//   rings       a full ring keeps the newest events and counts the rest as dropped, Clear forgets what was recorded
+//               and keeps open scopes, a disabled profiler records nothing, also not for scopes begun while disabled
+//   threads     8 threads record nested scopes while the main thread keeps capturing: every captured event is
+//               whole (its name, depth and times agree), each thread has its own ring and name, and after the threads
+//               finish the events plus the dropped count add up to what each thread recorded
+//   summary     nearest-rank p50/p90/p99, mean, total and max are exact on durations of 1..100 ms, rows are sorted
+//               by total; the Chrome trace has one metadata event per thread and one complete event per scope
+//   overhead    nanoseconds per enabled and disabled marker and per steady_clock read, over --markers iterations;
+//               a disabled marker must cost less than a fifth of an enabled one
+//
+//   CpuProfilerCheck [--markers n] [--max-enabled-ns x]
+//
+// --max-enabled-ns adds an absolute bound for the enabled marker; it depends on the machine and is off by default.
+// Prints a line per check and exits with 1 if any fails and 2 on bad arguments. Standalone and standard library
+// only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o CpuProfilerCheck tools/CpuProfilerCheck/main.cpp source/CpuProfiler.cpp
+
+#include "../Check.h"
+#include "CpuProfiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: CpuProfilerCheck [--markers n] [--max-enabled-ns x]\n";
+		return 2;
+	}
+
+	// Names recorded by the worker threads, their depth is their index
+	const char* const WorkerScopes[] = { "Frame", "Record", "Draw" };
+
+	// Ring of the thread with the given name in the capture
+	const CpuProfiler::ThreadCapture* FindThread(const std::vector<CpuProfiler::ThreadCapture>& capture, const std::string& name)
+	{
+		for (const CpuProfiler::ThreadCapture& thread : capture)
+		{
+			if (thread.mThreadName == name)
+				return &thread;
+		}
+		return nullptr;
+	}
+
+	size_t CountEvents(const std::vector<CpuProfiler::ThreadCapture>& capture)
+	{
+		size_t count = 0;
+		for (const CpuProfiler::ThreadCapture& thread : capture)
+			count += thread.mEvents.size();
+		return count;
+	}
+
+	size_t CountOf(const std::string& text, const std::string& pattern)
+	{
+		size_t count = 0;
+		for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1))
+			count++;
+		return count;
+	}
+
+	// Nanoseconds per call of marker over iterations
+	template <typename Marker>
+	double TimeNs(uint32_t iterations, Marker marker)
+	{
+		auto start = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < iterations; i++)
+			marker();
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / double(iterations);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t markers = 10000000;
+	double maxEnabledNs = 0.0;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--markers" && hasValue)
+			markers = uint32_t(std::max(std::atoi(argv[++i]), 1000));
+		else if (arg == "--max-enabled-ns" && hasValue)
+			maxEnabledNs = std::atof(argv[++i]);
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+
+	{
+		CpuProfiler profiler;
+		profiler.SetThreadName("main");
+		{
+			CpuProfiler::Scope outer(profiler, "Outer");
+			{
+				CpuProfiler::Scope middle(profiler, "Middle");
+				profiler.BeginScope("Explicit");
+				{
+					CpuProfiler::Scope inner(profiler, "Inner");
+				}
+				profiler.EndScope();
+			}
+		}
+		std::vector<CpuProfiler::ThreadCapture> capture = profiler.Capture();
+		const std::vector<CpuProfiler::Event>& events = capture[0].mEvents;
+		const char* order[] = { "Inner", "Explicit", "Middle", "Outer" };
+		bool stored = events.size() == 4;
+		for (size_t i = 0; stored && i < events.size(); i++)
+			stored = std::strcmp(events[i].mName, order[i]) == 0 && events[i].mDepth == 3 - i;
+		passed &= Check("children are stored first with their depth", stored && capture[0].mThreadName == "main", "%.0f events", double(events.size()));
+		bool contained = stored;
+		for (size_t i = 0; contained && i + 1 < events.size(); i++)
+			contained = events[i + 1].mBeginNs <= events[i].mBeginNs && events[i].mEndNs <= events[i + 1].mEndNs && events[i].mBeginNs <= events[i].mEndNs;
+		passed &= Check("children lie inside their parent", contained, "%.0f events", double(events.size()));
+
+		profiler.Clear();
+		const uint32_t deep = CpuProfiler::MAX_OPEN_SCOPES + 6;
+		for (uint32_t i = 0; i < deep; i++)
+			profiler.BeginScope("Deep");
+		for (uint32_t i = 0; i < deep; i++)
+			profiler.EndScope();
+		profiler.EndScope();
+		{
+			CpuProfiler::Scope after(profiler, "After");
+		}
+		capture = profiler.Capture();
+		uint32_t maxDepth = 0;
+		for (const CpuProfiler::Event& event : capture[0].mEvents)
+			maxDepth = std::max(maxDepth, event.mDepth);
+		bool limited = capture[0].mEvents.size() == CpuProfiler::MAX_OPEN_SCOPES + 1 && maxDepth == CpuProfiler::MAX_OPEN_SCOPES - 1 &&
+			capture[0].mEvents.back().mDepth == 0;
+		passed &= Check("scopes past the depth limit are skipped", limited, "%.0f events", double(capture[0].mEvents.size()));
+	}
+
+	{
+		CpuProfiler profiler(8);
+		for (int i = 0; i < 20; i++)
+			CpuProfiler::Scope scope(profiler, i < 12 ? "Old" : "New");
+		std::vector<CpuProfiler::ThreadCapture> capture = profiler.Capture();
+		bool newest = capture[0].mEvents.size() == 8 && capture[0].mDroppedCount == 12 &&
+			std::all_of(capture[0].mEvents.begin(), capture[0].mEvents.end(), [](const CpuProfiler::Event& event) { return std::strcmp(event.mName, "New") == 0; });
+		passed &= Check("a full ring keeps the newest events", newest, "%.0f dropped", double(capture[0].mDroppedCount));
+
+		{
+			CpuProfiler::Scope open(profiler, "Open");
+			profiler.Clear();
+			capture = profiler.Capture();
+		}
+		bool cleared = capture[0].mEvents.empty() && capture[0].mDroppedCount == 0;
+		capture = profiler.Capture();
+		passed &= Check("Clear forgets and keeps open scopes", cleared && capture[0].mEvents.size() == 1, "%.0f events", double(capture[0].mEvents.size()));
+
+		profiler.Clear();
+		profiler.SetEnabled(false);
+		{
+			CpuProfiler::Scope disabled(profiler, "Disabled");
+		}
+		profiler.BeginScope("Begun disabled");
+		profiler.SetEnabled(true);
+		profiler.EndScope();
+		capture = profiler.Capture();
+		passed &= Check("a disabled profiler records nothing", capture[0].mEvents.empty(), "%.0f events", double(capture[0].mEvents.size()));
+	}
+
+	{
+		const int threadCount = 8, frames = 20000;
+		CpuProfiler profiler(1024);
+		std::atomic<int> running{ threadCount };
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; t++)
+		{
+			threads.emplace_back([&profiler, &running, t]() {
+				profiler.SetThreadName("worker " + std::to_string(t));
+				for (int frame = 0; frame < frames; frame++)
+				{
+					CpuProfiler::Scope frameScope(profiler, WorkerScopes[0]);
+					CpuProfiler::Scope record(profiler, WorkerScopes[1]);
+					for (int draw = 0; draw < 2; draw++)
+						CpuProfiler::Scope drawScope(profiler, WorkerScopes[2]);
+				}
+				running--;
+			});
+		}
+
+		int captures = 0, torn = 0;
+		while (running > 0)
+		{
+			for (const CpuProfiler::ThreadCapture& thread : profiler.Capture())
+			{
+				for (const CpuProfiler::Event& event : thread.mEvents)
+				{
+					bool whole = event.mDepth < 3 && event.mName == WorkerScopes[event.mDepth] && event.mBeginNs <= event.mEndNs;
+					torn += !whole;
+				}
+			}
+			captures++;
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+
+		std::vector<CpuProfiler::ThreadCapture> capture = profiler.Capture();
+		int accounted = 0, named = 0;
+		for (int t = 0; t < threadCount; t++)
+		{
+			const CpuProfiler::ThreadCapture* thread = FindThread(capture, "worker " + std::to_string(t));
+			named += thread != nullptr;
+			accounted += thread && thread->mEvents.size() + thread->mDroppedCount == uint64_t(frames) * 4 && thread->mEvents.size() == 1024;
+		}
+		passed &= Check("8 threads: captured events are whole", torn == 0 && captures > 0, "%.0f captures", double(captures));
+		passed &= Check("8 threads: a named ring per thread", named == threadCount && capture.size() == size_t(threadCount), "%.0f rings", double(capture.size()));
+		passed &= Check("8 threads: kept plus dropped adds up", accounted == threadCount, "%.0f threads", double(accounted));
+	}
+
+	{
+		// durations of 1..100 ms on two threads, in shuffled order
+		std::vector<CpuProfiler::ThreadCapture> capture(2);
+		capture[0].mThreadName = "main \"render\"";
+		capture[1].mThreadIndex = 1;
+		capture[1].mThreadName = "worker";
+		for (uint64_t i = 0; i < 100; i++)
+		{
+			uint64_t ms = (i * 37) % 100 + 1;
+			CpuProfiler::Event event;
+			event.mName = "Lighting";
+			event.mBeginNs = i * 1000000000ull;
+			event.mEndNs = event.mBeginNs + ms * 1000000ull;
+			capture[i % 2].mEvents.push_back(event);
+		}
+		CpuProfiler::Event small;
+		small.mName = "Small";
+		small.mEndNs = 1000000;
+		capture[0].mEvents.push_back(small);
+
+		std::vector<CpuProfiler::ScopeSummary> summaries = CpuProfiler::Summarize(capture);
+		const CpuProfiler::ScopeSummary& lighting = summaries[0];
+		bool exact = lighting.mName == "Lighting" && lighting.mCount == 100 && std::fabs(lighting.mP50Ms - 50.0) < 1e-9 &&
+			std::fabs(lighting.mP90Ms - 90.0) < 1e-9 && std::fabs(lighting.mP99Ms - 99.0) < 1e-9 && std::fabs(lighting.mMaxMs - 100.0) < 1e-9 &&
+			std::fabs(lighting.mMeanMs - 50.5) < 1e-9 && std::fabs(lighting.mTotalMs - 5050.0) < 1e-6;
+		passed &= Check("percentiles are exact on 1..100 ms", exact, "p99 %.3f ms", lighting.mP99Ms);
+		passed &= Check("rows are sorted by total", summaries.size() == 2 && summaries[1].mName == "Small", "%.0f rows", double(summaries.size()));
+
+		std::string trace = CpuProfiler::ExportChromeTrace(capture);
+		bool complete = CountOf(trace, "\"ph\":\"X\"") == CountEvents(capture) && CountOf(trace, "\"ph\":\"M\"") == capture.size();
+		bool escaped = trace.find("\"args\":{\"name\":\"main \\\"render\\\"\"}") != std::string::npos;
+		bool balanced = std::count(trace.begin(), trace.end(), '{') == std::count(trace.begin(), trace.end(), '}') &&
+			trace.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0) == 0 && trace.find("\n]}\n") == trace.size() - 4;
+		passed &= Check("Chrome trace has every thread and event", complete && escaped && balanced, "%.0f events", double(CountOf(trace, "\"ph\":\"X\"")));
+	}
+
+	{
+		CpuProfiler profiler;
+		const char* name = "Marker";
+		double enabledNs = TimeNs(markers, [&profiler, name]() { CpuProfiler::Scope scope(profiler, name); });
+		profiler.SetEnabled(false);
+		double disabledNs = TimeNs(markers, [&profiler, name]() { CpuProfiler::Scope scope(profiler, name); });
+		volatile uint64_t sink = 0;
+		double clockNs = TimeNs(markers, [&profiler, &sink]() { sink = sink + profiler.GetTimeNs(); });
+
+		passed &= Check("overhead: disabled under a fifth of enabled", disabledNs * 5.0 < enabledNs, "%.1f ns disabled", disabledNs);
+		std::printf("    enabled marker %.1f ns, disabled %.1f ns, clock read %.1f ns\n", enabledNs, disabledNs, clockNs);
+		if (maxEnabledNs > 0.0)
+			passed &= Check("overhead: enabled under --max-enabled-ns", enabledNs <= maxEnabledNs, "%.1f ns enabled", enabledNs);
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,290 @@
+// Drives FrameTimeline with a simulated GPU instead of a device. The GPU is a discrete-time model with a graphics and
+// a compute queue: every frame the CPU records for --cpu ms, then submits the compute work (--compute ms) and the
+// graphics work (--graphics ms), which waits for the compute work on the GPU like RenderAsync does. Checked:
+//   slot reuse       BeginFrame only hands out a slot once every fence of the frame that used it last has completed,
+//                    and retire callbacks run once, in order, after their frame
+//   depth change     SetFramesInFlight while frames are pending: the old slots drain first, nothing is lost
+//   flush            every fence reaches its last signaled value and every callback runs, the current frame's too
+//   stalls           the CPU stall count per depth; at the default timings the GPU chain of a frame (13 ms) is longer
+//                    than the CPU frame (10 ms), so depth 2 stalls on every other frame and depth 3 never does
+//
+//   FrameTimelineCheck [--frames n] [--cpu ms] [--graphics ms] [--compute ms]
+//
+// Prints a line per check and a table of stalls per depth, and exits with 1 if a check fails and 2 on bad arguments.
+// Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o FrameTimelineCheck tools/FrameTimelineCheck/main.cpp source/FrameTimeline.cpp
+
+#include "../Check.h"
+#include "FrameTimeline.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: FrameTimelineCheck [--frames n] [--cpu ms] [--graphics ms] [--compute ms]\n";
+		return 2;
+	}
+
+	// Fences signaled at the end of GPU work; the CPU clock advances while it waits
+	class SimulatedGpu
+	{
+	public:
+		enum Queue
+		{
+			QUEUE_GRAPHICS = 0,
+			QUEUE_COMPUTE,
+
+			QUEUE_COUNT
+		};
+
+		explicit SimulatedGpu(FrameTimeline& timeline)
+		{
+			for (int queue = 0; queue < QUEUE_COUNT; queue++)
+				mFences[queue] = timeline.AddFence(queue == QUEUE_GRAPHICS ? "Graphics" : "Compute");
+			timeline.SetCompletedValueFunc([this](FrameTimeline::FenceId fence) { return GetCompletedValue(fence); });
+			timeline.SetWaitFunc([this](FrameTimeline::FenceId fence, uint64_t value) { Wait(fence, value); });
+		}
+
+		// Work starts once the queue is free, it has been submitted and afterTime has passed (a GPU-side wait);
+		// returns its end
+		double Submit(FrameTimeline& timeline, Queue queue, double duration, double afterTime = 0.0)
+		{
+			double start = std::max(std::max(mNow, mQueueFree[queue]), afterTime);
+			mQueueFree[queue] = start + duration;
+			mSignals[queue].push_back({ timeline.Signal(mFences[queue]), mQueueFree[queue] });
+			return mQueueFree[queue];
+		}
+
+		uint64_t GetCompletedValue(FrameTimeline::FenceId fence) const
+		{
+			uint64_t value = 0;
+			for (const Signal& signal : mSignals[GetQueue(fence)])
+			{
+				if (signal.mTime <= mNow)
+					value = std::max(value, signal.mValue);
+			}
+			return value;
+		}
+
+		void Wait(FrameTimeline::FenceId fence, uint64_t value)
+		{
+			mWaitCount++;
+			for (const Signal& signal : mSignals[GetQueue(fence)])
+			{
+				if (signal.mValue >= value)
+				{
+					mNow = std::max(mNow, signal.mTime);
+					return;
+				}
+			}
+			mBadWaitCount++;    // waiting on a value that was never signaled would hang a real device
+		}
+
+		void Advance(double ms) { mNow += ms; }
+		double GetNow() const { return mNow; }
+		FrameTimeline::FenceId GetFence(Queue queue) const { return mFences[queue]; }
+		uint64_t GetWaitCount() const { return mWaitCount; }
+		uint64_t GetBadWaitCount() const { return mBadWaitCount; }
+
+	private:
+		struct Signal
+		{
+			uint64_t mValue;
+			double mTime;
+		};
+
+		int GetQueue(FrameTimeline::FenceId fence) const { return fence == mFences[QUEUE_GRAPHICS] ? QUEUE_GRAPHICS : QUEUE_COMPUTE; }
+
+		FrameTimeline::FenceId mFences[QUEUE_COUNT] = {};
+		std::vector<Signal> mSignals[QUEUE_COUNT];
+		double mQueueFree[QUEUE_COUNT] = {};
+		double mNow = 0.0;
+		uint64_t mWaitCount = 0;
+		uint64_t mBadWaitCount = 0;
+	};
+
+	struct Timings
+	{
+		double mCpu = 10.0;
+		double mGraphics = 8.0;
+		double mCompute = 5.0;
+	};
+
+	// What a run observed against what the timeline promised
+	struct Run
+	{
+		FrameTimeline mTimeline;
+		SimulatedGpu mGpu;
+		std::vector<double> mSlotBusyUntil;     // GPU end of the last frame per slot
+		std::vector<double> mFrameEnds;         // GPU end per frame
+		std::vector<uint64_t> mRetired;         // frame numbers in retire order
+		uint64_t mSlotViolations = 0;           // a slot handed out while its last frame was still running
+		uint64_t mEarlyRetires = 0;             // a callback run before its frame had finished
+
+		explicit Run(uint32_t framesInFlight)
+			: mTimeline(framesInFlight), mGpu(mTimeline), mSlotBusyUntil(FrameTimeline::MAX_FRAMES_IN_FLIGHT, 0.0)
+		{
+		}
+
+		void Frame(const Timings& timings)
+		{
+			uint32_t slot = mTimeline.BeginFrame();
+			if (mSlotBusyUntil[slot] > mGpu.GetNow())
+				mSlotViolations++;
+
+			uint64_t frame = mTimeline.GetFrameNumber();
+			mGpu.Advance(timings.mCpu);
+			double computeEnd = mGpu.Submit(mTimeline, SimulatedGpu::QUEUE_COMPUTE, timings.mCompute);
+			double graphicsEnd = mGpu.Submit(mTimeline, SimulatedGpu::QUEUE_GRAPHICS, timings.mGraphics, computeEnd);
+			double end = std::max(computeEnd, graphicsEnd);
+			mSlotBusyUntil[slot] = end;
+			mFrameEnds.push_back(end);
+
+			mTimeline.Retire([this, frame]() {
+				if (mFrameEnds[frame] > mGpu.GetNow())
+					mEarlyRetires++;
+				mRetired.push_back(frame);
+			});
+			mTimeline.EndFrame();
+		}
+
+		bool RetiredInOrder() const
+		{
+			for (size_t i = 0; i < mRetired.size(); i++)
+			{
+				if (mRetired[i] != i)
+					return false;
+			}
+			return true;
+		}
+
+		bool AllFencesComplete() const
+		{
+			for (int queue = 0; queue < SimulatedGpu::QUEUE_COUNT; queue++)
+			{
+				FrameTimeline::FenceId fence = mGpu.GetFence(SimulatedGpu::Queue(queue));
+				if (!mTimeline.IsComplete(fence, mTimeline.GetLastSignaledValue(fence)))
+					return false;
+			}
+			return true;
+		}
+	};
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t frames = 200;
+	Timings timings;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--frames" && hasValue)
+			frames = uint32_t(std::max(std::atoi(argv[++i]), 8));
+		else if (arg == "--cpu" && hasValue)
+			timings.mCpu = std::max(std::atof(argv[++i]), 0.1);
+		else if (arg == "--graphics" && hasValue)
+			timings.mGraphics = std::max(std::atof(argv[++i]), 0.0);
+		else if (arg == "--compute" && hasValue)
+			timings.mCompute = std::max(std::atof(argv[++i]), 0.0);
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+
+	// slot reuse and retire order at every depth the app allows
+	{
+		uint64_t violations = 0, early = 0, badWaits = 0;
+		bool ordered = true;
+		for (uint32_t depth = 1; depth <= 4; depth++)
+		{
+			Run run(depth);
+			for (uint32_t frame = 0; frame < frames; frame++)
+				run.Frame(timings);
+			run.mTimeline.Flush();
+			violations += run.mSlotViolations;
+			early += run.mEarlyRetires;
+			badWaits += run.mGpu.GetBadWaitCount();
+			ordered &= run.RetiredInOrder() && run.mRetired.size() == frames;
+		}
+		passed &= Check("a slot is reused only after its frame ended", violations == 0, "%.0f violations", double(violations));
+		passed &= Check("callbacks run after their frame", early == 0, "%.0f early", double(early));
+		passed &= Check("callbacks run once and in order", ordered, "%.0f depths", 4.0);
+		passed &= Check("waits only on signaled values", badWaits == 0, "%.0f bad waits", double(badWaits));
+	}
+
+	// the depth changes between frames while the GPU is busy, like the slider in the GI scene
+	{
+		Run run(3);
+		const uint32_t depths[] = { 1, 4, 2, 4, 3 };
+		uint64_t pending = 0;
+		uint32_t frame = 0;
+		for (uint32_t depth : depths)
+		{
+			for (uint32_t i = 0; i < frames / 6; i++, frame++)
+				run.Frame(timings);
+			run.mTimeline.SetFramesInFlight(depth);
+			pending += run.mTimeline.GetPendingFrameCount();
+		}
+		for (uint32_t i = 0; i < frames / 6; i++, frame++)
+			run.Frame(timings);
+		run.mTimeline.Flush();
+		passed &= Check("depth changes drain the old slots", pending == 0 && run.mSlotViolations == 0, "%.0f pending frames", double(pending));
+		passed &= Check("depth changes lose no callback", run.RetiredInOrder() && run.mRetired.size() == frame, "%.0f retired", double(run.mRetired.size()));
+
+		run.mTimeline.SetFramesInFlight(0);
+		uint32_t lowest = run.mTimeline.GetFramesInFlight();
+		run.mTimeline.SetFramesInFlight(100);
+		uint32_t highest = run.mTimeline.GetFramesInFlight();
+		passed &= Check("depth is clamped", lowest == 1 && highest == FrameTimeline::MAX_FRAMES_IN_FLIGHT, "%.0f at most", double(highest));
+	}
+
+	// Flush with a frame half recorded: its callbacks run too
+	{
+		Run run(3);
+		for (uint32_t frame = 0; frame < 10; frame++)
+			run.Frame(timings);
+		run.mTimeline.BeginFrame();
+		bool currentRan = false;
+		run.mTimeline.Retire([&currentRan]() { currentRan = true; });
+		run.mGpu.Submit(run.mTimeline, SimulatedGpu::QUEUE_GRAPHICS, timings.mGraphics);
+		run.mTimeline.Flush();
+		passed &= Check("flush completes every fence", run.AllFencesComplete(), "%.1f ms GPU end", run.mGpu.GetNow());
+		passed &= Check("flush runs every callback", currentRan && run.mRetired.size() == 10 && run.mTimeline.GetPendingFrameCount() == 0,
+			"%.0f retired", double(run.mRetired.size()));
+		uint64_t waits = run.mGpu.GetWaitCount();
+		run.mTimeline.Flush();
+		passed &= Check("a second flush does not wait", run.mGpu.GetWaitCount() == waits, "%.0f waits", double(run.mGpu.GetWaitCount() - waits));
+	}
+
+	// stalls per depth; the GPU chain of a frame is compute then graphics
+	std::printf("\n%.1f ms CPU, %.1f ms compute then %.1f ms graphics per frame, %u frames\n", timings.mCpu, timings.mCompute, timings.mGraphics, frames);
+	std::printf("%-8s %-10s %-14s\n", "depth", "stalls", "ms per frame");
+	uint64_t stalls[5] = {};
+	double frameMs[5] = {};
+	for (uint32_t depth = 1; depth <= 4; depth++)
+	{
+		Run run(depth);
+		for (uint32_t frame = 0; frame < frames; frame++)
+			run.Frame(timings);
+		stalls[depth] = run.mTimeline.GetStats().mStallCount;
+		frameMs[depth] = run.mGpu.GetNow() / frames;
+		std::printf("%-8u %-10llu %-14.2f\n", depth, (unsigned long long)stalls[depth], frameMs[depth]);
+	}
+	const bool defaultTimings = timings.mCpu == 10.0 && timings.mGraphics == 8.0 && timings.mCompute == 5.0;
+	if (defaultTimings)
+	{
+		passed &= Check("depth 2 stalls on a 13 ms GPU chain", stalls[2] > 0 && frameMs[2] > timings.mCpu, "%.2f ms per frame", frameMs[2]);
+		passed &= Check("depth 3 never stalls on it", stalls[3] == 0, "%.0f stalls", double(stalls[3]));
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+// Checks DXRSTimer driven by an injected clock and the rolling statistics of FrameTimeStats.
+//   variable    each Run advances by the clock's delta converted to 100 ns ticks, deltas above 0.1 s are clamped
+//               while the frame time keeps the unclamped wall time, the first frame after a reset is not recorded
+//   fixed       frames within 1/4 ms of the target snap to it so a 59.94 Hz display still runs one update per
+//               frame, slow frames run several updates and fast ones none, the left over time carries over
+//   step        Step advances exactly one target step however long the frame took, the frame rate follows the
+//               wall clock
+//   stats       nearest rank percentiles, standard deviation and jitter, hitches against the histogram median and
+//               the minimum hitch time, the ring window, the incremental histogram against a recount, the recent
+//               hitch list and Clear
+//
+//   FrameTimerCheck [--frames n] [--seed n]
+//
+// --frames is the length of the random run that checks the histogram (100000). Prints a line per check and exits
+// with 1 if any fails and 2 on bad arguments. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o FrameTimerCheck tools/FrameTimerCheck/main.cpp source/FrameTimeStats.cpp
+
+#include "../Check.h"
+#include "DXRSTimer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: FrameTimerCheck [--frames n] [--seed n]\n";
+		return 2;
+	}
+
+	// The injected clock counts microseconds
+	const uint64_t ClockFrequency = 1000000;
+
+	struct ManualClock
+	{
+		uint64_t mNow = 1000;
+	};
+
+	void UseClock(DXRSTimer& timer, ManualClock& clock)
+	{
+		timer.SetClock([&clock]() { return clock.mNow; }, ClockFrequency);
+	}
+
+	// Advances the clock by microseconds and runs a frame, returns the updates it ran
+	uint32_t RunFrame(DXRSTimer& timer, ManualClock& clock, uint64_t microseconds)
+	{
+		clock.mNow += microseconds;
+		uint32_t updates = 0;
+		timer.Run([&updates]() { updates++; });
+		return updates;
+	}
+
+	bool Near(double a, double b, double tolerance = 1e-9)
+	{
+		return std::fabs(a - b) <= tolerance;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t frames = 100000;
+	uint32_t seed = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--frames" && hasValue)
+			frames = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--seed" && hasValue)
+			seed = uint32_t(std::atoi(argv[++i]));
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+
+	{
+		DXRSTimer timer;
+		ManualClock clock;
+		UseClock(timer, clock);
+		uint32_t updates = 0;
+		for (int i = 0; i < 3; i++)
+			updates += RunFrame(timer, clock, 16667);
+		bool variable = updates == 3 && timer.GetElapsedTicks() == 166670 && timer.GetTotalTicks() == 3 * 166670 && timer.GetFrameCount() == 3;
+		passed &= Check("variable: ticks follow the clock", variable, "%.0f ticks", double(timer.GetElapsedTicks()));
+
+		RunFrame(timer, clock, 2500000);
+		bool clamped = timer.GetElapsedTicks() == DXRSTimer::TicksPerSecond / 10 && Near(timer.GetFrameTimeStats().GetLastFrameMs(), 2500.0);
+		passed &= Check("variable: long frames clamp to 0.1 s", clamped, "%.0f ms recorded", timer.GetFrameTimeStats().GetLastFrameMs());
+		passed &= Check("variable: the first frame is not recorded", timer.GetFrameTimeStats().GetFrameCount() == 3, "%.0f frames", double(timer.GetFrameTimeStats().GetFrameCount()));
+
+		clock.mNow += 5000000;
+		timer.ResetElapsedTime();
+		RunFrame(timer, clock, 20000);
+		bool reset = timer.GetElapsedTicks() == 200000 && timer.GetFrameTimeStats().GetFrameCount() == 3;
+		passed &= Check("variable: a reset skips the paused time", reset, "%.0f ticks", double(timer.GetElapsedTicks()));
+
+		timer.GetFrameTimeStats().Clear();
+		for (int i = 0; i < 60; i++)
+			RunFrame(timer, clock, 16667);
+		passed &= Check("variable: 60 Hz counts 60 frames a second", timer.GetFramesPerSecond() == 60, "%.0f fps", double(timer.GetFramesPerSecond()));
+	}
+
+	{
+		DXRSTimer timer;
+		ManualClock clock;
+		UseClock(timer, clock);
+		timer.SetFixedTimeStep(true);
+		timer.SetTargetElapsedSeconds(1.0 / 60.0);
+		uint64_t target = DXRSTimer::SecondsToTicks(1.0 / 60.0);
+
+		// 59.94 Hz, 16 us longer than the target
+		uint32_t updates = 0, misses = 0;
+		RunFrame(timer, clock, 16683);
+		for (int i = 0; i < 36000; i++)
+		{
+			uint32_t frame = RunFrame(timer, clock, 16683);
+			updates += frame;
+			misses += frame != 1;
+		}
+		bool snapped = misses == 0 && updates == 36000 && timer.GetElapsedTicks() == target && timer.GetTotalTicks() == uint64_t(36001) * target;
+		passed &= Check("fixed: 59.94 Hz snaps for 10 minutes", snapped, "%.0f missed frames", double(misses));
+
+		uint32_t slow = RunFrame(timer, clock, 33334);
+		uint32_t fast = RunFrame(timer, clock, 8000) + RunFrame(timer, clock, 8000);
+		uint32_t carried = RunFrame(timer, clock, 8000);
+		passed &= Check("fixed: slow frames catch up, fast ones wait", slow == 2 && fast == 0 && carried == 1, "%.0f updates", double(slow));
+
+		clock.mNow += 1000000;
+		uint32_t clamped = RunFrame(timer, clock, 0);
+		passed &= Check("fixed: a clamped stall runs 6 updates", clamped == 6, "%.0f updates", double(clamped));
+	}
+
+	{
+		DXRSTimer timer;
+		ManualClock clock;
+		UseClock(timer, clock);
+		timer.SetTargetElapsedSeconds(1.0 / 30.0);
+		uint64_t target = DXRSTimer::SecondsToTicks(1.0 / 30.0);
+		uint32_t updates = 0;
+		uint64_t elapsedSum = 0;
+		for (int i = 0; i < 100; i++)
+		{
+			clock.mNow += i % 2 ? 5000 : 45000;
+			timer.Step([&]() { updates++; elapsedSum += timer.GetElapsedTicks(); });
+		}
+		bool stepped = updates == 100 && elapsedSum == 100 * target && timer.GetTotalTicks() == 100 * target && timer.GetFrameCount() == 100;
+		passed &= Check("step: one target step per frame", stepped, "%.4f s simulated", timer.GetTotalSeconds());
+		passed &= Check("step: frame rate follows the wall clock", timer.GetFramesPerSecond() == 40, "%.0f fps", double(timer.GetFramesPerSecond()));
+		FrameTimeStats::Summary summary = timer.GetFrameTimeStats().GetSummary();
+		passed &= Check("step: frame times are the wall time", summary.mCount == 99 && Near(summary.mJitterMs, 40.0), "%.1f ms jitter", summary.mJitterMs);
+	}
+
+	{
+		DXRSTimer timer;
+		uint32_t updates = 0;
+		timer.Run([&updates]() { updates++; });
+		timer.Run([&updates]() { updates++; });
+		passed &= Check("steady_clock: the default clock runs", updates == 2 && timer.GetFrameCount() == 2, "%.0f updates", double(updates));
+	}
+
+	{
+		std::vector<double> ramp;
+		for (int i = 1; i <= 100; i++)
+			ramp.push_back(double(i));
+		FrameTimeStats::Summary summary = FrameTimeStats::Summarize(ramp, 1000.0, 1000.0);
+		bool ranks = summary.mMinMs == 1.0 && summary.mP50Ms == 50.0 && summary.mP95Ms == 95.0 && summary.mP99Ms == 99.0 &&
+			summary.mMaxMs == 100.0 && Near(summary.mAverageMs, 50.5) && Near(summary.mStdDevMs, std::sqrt((100.0 * 100.0 - 1.0) / 12.0));
+		passed &= Check("stats: nearest rank percentiles of 1..100", ranks, "p95 %.0f ms", summary.mP95Ms);
+
+		std::vector<double> three = { 30.0, 10.0, 20.0 };
+		summary = FrameTimeStats::Summarize(three);
+		passed &= Check("stats: small windows round the rank up", summary.mP50Ms == 20.0 && summary.mP99Ms == 30.0, "p50 %.0f ms", summary.mP50Ms);
+
+		std::vector<double> steady(100, 20.0), alternating;
+		for (int i = 0; i < 100; i++)
+			alternating.push_back(i % 2 ? 30.0 : 10.0);
+		FrameTimeStats::Summary smooth = FrameTimeStats::Summarize(steady, 1000.0, 1000.0);
+		FrameTimeStats::Summary rough = FrameTimeStats::Summarize(alternating, 1000.0, 1000.0);
+		bool jitter = smooth.mAverageMs == rough.mAverageMs && smooth.mJitterMs == 0.0 && smooth.mStdDevMs == 0.0 &&
+			Near(rough.mJitterMs, 20.0) && Near(rough.mStdDevMs, 10.0);
+		passed &= Check("stats: jitter tells 10/30 ms from 20 ms", jitter, "%.1f ms jitter", rough.mJitterMs);
+	}
+
+	{
+		FrameTimeStats stats;
+		int early = 0;
+		for (uint32_t i = 0; i < FrameTimeStats::MIN_FRAMES_FOR_HITCHES - 1; i++)
+			early += stats.AddFrame(i == 3 ? 100.0 : 16.0);
+		passed &= Check("stats: no hitches before 8 frames", early == 0, "%.0f hitches", double(early));
+		for (int i = 0; i < 20; i++)
+			stats.AddFrame(16.0);
+		bool median = Near(stats.GetMedianMs(), 16.25);
+		bool below = !stats.AddFrame(32.0);
+		bool above = stats.AddFrame(33.0);
+		passed &= Check("stats: hitches are twice the median", median && below && above, "median %.2f ms", stats.GetMedianMs());
+		passed &= Check("stats: the hitch records its median", stats.GetRecentHitches().size() == 1 && stats.GetRecentHitches()[0].mFrame == 28 &&
+			Near(stats.GetRecentHitches()[0].mMedianMs, 16.25), "frame %.0f", stats.GetRecentHitches().empty() ? -1.0 : double(stats.GetRecentHitches()[0].mFrame));
+
+		FrameTimeStats fast;
+		for (int i = 0; i < 20; i++)
+			fast.AddFrame(1.0);
+		// the median is the middle of the 1.0 to 1.5 ms bucket
+		bool floor = !fast.AddFrame(5.0) && fast.AddFrame(5.5);
+		passed &= Check("stats: hitches are at least 4 ms longer", floor, "%.0f hitches", double(fast.GetHitchCount()));
+
+		for (int i = 0; i < 40; i++)
+		{
+			for (int j = 0; j < 10; j++)
+				fast.AddFrame(1.0);
+			fast.AddFrame(50.0);
+		}
+		passed &= Check("stats: the recent hitch list keeps 16", fast.GetHitchCount() == 41 &&
+			fast.GetRecentHitches().size() == FrameTimeStats::MAX_RECENT_HITCHES && fast.GetRecentHitches().back().mFrame == fast.GetFrameCount() - 1,
+			"%.0f hitches", double(fast.GetHitchCount()));
+		fast.Clear();
+		passed &= Check("stats: Clear empties everything", fast.GetFrameCount() == 0 && fast.GetWindowCount() == 0 && fast.GetHitchCount() == 0 &&
+			fast.GetRecentHitches().empty() && fast.GetSummary().mCount == 0 && fast.GetMedianMs() == 0.0, "%.0f frames", double(fast.GetFrameCount()));
+	}
+
+	{
+		FrameTimeStats stats(4, 1.0, 10);
+		for (int i = 1; i <= 6; i++)
+			stats.AddFrame(double(i));
+		stats.AddFrame(250.0);
+		std::vector<float> window = stats.GetFrameTimes();
+		bool ring = window == std::vector<float>{ 4.0f, 5.0f, 6.0f, 250.0f } && stats.GetLastFrameMs() == 250.0 && stats.GetFrameCount() == 7;
+		passed &= Check("stats: the window keeps the last frames", ring, "%.0f in window", double(stats.GetWindowCount()));
+		const std::vector<uint32_t>& histogram = stats.GetHistogram();
+		bool buckets = histogram[4] == 1 && histogram[5] == 1 && histogram[6] == 1 && histogram[9] == 1 && histogram[1] == 0;
+		passed &= Check("stats: the last bucket collects the rest", buckets, "%.0f in last bucket", double(histogram[9]));
+		FrameTimeStats::Summary summary = stats.GetSummary();
+		passed &= Check("stats: the summary covers the window only", summary.mCount == 4 && summary.mMinMs == 4.0 && summary.mMaxMs == 250.0,
+			"min %.0f ms", summary.mMinMs);
+	}
+
+	{
+		FrameTimeStats stats(600);
+		std::mt19937 random(seed);
+		std::lognormal_distribution<double> frameMs(std::log(16.0), 0.4);
+		uint32_t mismatches = 0;
+		for (uint32_t i = 0; i < frames; i++)
+		{
+			stats.AddFrame(frameMs(random));
+			if (i % 997 != 0)
+				continue;
+			std::vector<uint32_t> recount(stats.GetHistogram().size(), 0);
+			for (float ms : stats.GetFrameTimes())
+				recount[std::min(size_t(std::floor(double(ms) / stats.GetBucketMs())), recount.size() - 1)]++;
+			mismatches += recount != stats.GetHistogram();
+		}
+		passed &= Check("stats: the histogram matches a recount", mismatches == 0, "%.0f mismatches", double(mismatches));
+		FrameTimeStats::Summary summary = stats.GetSummary();
+		passed &= Check("stats: hitches in the window are counted", summary.mHitchCount <= stats.GetHitchCount() && summary.mCount == 600,
+			"%.0f in window", double(summary.mHitchCount));
+	}
+
+	return passed ? 0 : 1;
+}
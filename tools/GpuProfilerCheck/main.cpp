@@ -0,0 +1,261 @@
+// Drives GpuProfiler with a synthetic GPU: scopes of known length write ticks into per-queue readback arrays laid
+// out like the query heaps, and every frame is resolved two frames late like the FrameTimeline retire callback does.
+//   queries    every scope gets an adjacent begin/end pair inside its queue's range of the frame slot; a frame that
+//              runs out of queries hands out INVALID_QUERY for the scopes that do not fit and keeps the rest
+//   resolve    durations use each queue's frequency, nested scopes are named by their path, a pass that runs twice
+//              in a frame is summed, scopes that end after GetResolveRange and unbalanced ends are not timed, an
+//              end tick below its begin tick (a disjoint or wrapped counter) counts as 0 instead of a huge time,
+//              a slot reused before it was resolved drops the old frame, nullptr readbacks skip their queue
+//   stats      window average, min, max and last over SetAveragingFrames, queue totals of top level passes only,
+//              ResetStats
+//   export     the CSV header and quoting of names with commas, JSON escaping and frame count
+//
+//   GpuProfilerCheck [--frames n]
+//
+// --frames is the length of the steady run (64). Prints a line per check and exits with 1 if any fails and 2 on bad
+// arguments. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o GpuProfilerCheck tools/GpuProfilerCheck/main.cpp source/GpuProfiler.cpp
+
+#include "../Check.h"
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: GpuProfilerCheck [--frames n]\n";
+		return 2;
+	}
+
+	bool Near(double value, double expected)
+	{
+		return std::fabs(value - expected) < 1e-6;
+	}
+
+	// Query heaps and readback buffers of every queue, and the clock of each queue in ticks
+	struct SyntheticGpu
+	{
+		std::vector<std::vector<uint64_t>> mReadback;
+		std::vector<uint64_t> mClock;
+		std::vector<uint64_t> mFrequency;
+		int mInvalidQueries = 0;
+		int mOutsideSlot = 0;
+
+		SyntheticGpu(const GpuProfiler& profiler, const std::vector<uint64_t>& frequencies)
+			: mReadback(frequencies.size(), std::vector<uint64_t>(profiler.GetQueryCount())), mClock(frequencies.size(), 1000), mFrequency(frequencies) {}
+
+		void Write(GpuProfiler::QueueId queue, uint32_t query, uint32_t slot, uint32_t maxQueries)
+		{
+			if (query == GpuProfiler::INVALID_QUERY)
+			{
+				mInvalidQueries++;
+				return;
+			}
+			mOutsideSlot += query / maxQueries != slot;
+			mReadback[queue][query] = mClock[queue];
+		}
+		void Advance(GpuProfiler::QueueId queue, double ms) { mClock[queue] += uint64_t(std::llround(ms * double(mFrequency[queue]) / 1000.0)); }
+	};
+
+	// A scope of ms on the queue with its timestamps written by the synthetic GPU
+	void Scope(GpuProfiler& profiler, SyntheticGpu& gpu, uint32_t slot, GpuProfiler::QueueId queue, const std::string& name, double ms)
+	{
+		gpu.Write(queue, profiler.BeginScope(queue, name), slot, profiler.GetMaxQueriesPerFrame());
+		gpu.Advance(queue, ms);
+		gpu.Write(queue, profiler.EndScope(queue), slot, profiler.GetMaxQueriesPerFrame());
+	}
+
+	std::vector<const uint64_t*> Readbacks(SyntheticGpu& gpu, GpuProfiler& profiler, uint32_t slot)
+	{
+		std::vector<const uint64_t*> timestamps;
+		for (GpuProfiler::QueueId queue = 0; queue < profiler.GetQueueCount(); queue++)
+			timestamps.push_back(gpu.mReadback[queue].data() + slot * profiler.GetMaxQueriesPerFrame());
+		return timestamps;
+	}
+
+	const GpuProfiler::PassStats* Find(const GpuProfiler& profiler, const std::string& name)
+	{
+		for (const GpuProfiler::PassStats& pass : profiler.GetPasses())
+		{
+			if (pass.mName == name)
+				return &pass;
+		}
+		return nullptr;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t frames = 64;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--frames" && hasValue)
+			frames = uint32_t(std::max(std::atoi(argv[++i]), 8));
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+	const uint32_t slots = 4, latency = 2;
+
+	{
+		// the scene's layout: G-buffer, lighting with nested shadows, a blur run twice and a compute pass
+		GpuProfiler profiler(64, slots);
+		GpuProfiler::QueueId direct = profiler.AddQueue("direct", 10000000);
+		GpuProfiler::QueueId compute = profiler.AddQueue("compute", 25000000);
+		SyntheticGpu gpu(profiler, { 10000000, 25000000 });
+		profiler.SetAveragingFrames(8);
+
+		int lateTimed = 0;
+		for (uint32_t frame = 0; frame < frames; frame++)
+		{
+			uint32_t slot = frame % slots;
+			profiler.BeginFrame(slot);
+			double gbuffer = 1.0 + 0.01 * (frame % 8);
+			Scope(profiler, gpu, slot, direct, "GBuffer", gbuffer);
+			gpu.Write(direct, profiler.BeginScope(direct, "Lighting"), slot, profiler.GetMaxQueriesPerFrame());
+			gpu.Advance(direct, 0.25);
+			Scope(profiler, gpu, slot, direct, "Shadows", 0.5);
+			gpu.Advance(direct, 0.25);
+			gpu.Write(direct, profiler.EndScope(direct), slot, profiler.GetMaxQueriesPerFrame());
+			Scope(profiler, gpu, slot, direct, "Blur", 0.2);
+			Scope(profiler, gpu, slot, direct, "Blur", 0.3);
+			Scope(profiler, gpu, slot, compute, "RSM", 2.0);
+
+			uint32_t first = 0, count = 0;
+			profiler.GetResolveRange(direct, first, count);
+			profiler.GetResolveRange(compute, first, count);
+			// recorded after the resolve, lands in the queries but must not be timed
+			Scope(profiler, gpu, slot, direct, "Late", 1.0);
+			profiler.EndFrame();
+
+			if (frame >= latency)
+				profiler.ResolveFrame((frame - latency) % slots, Readbacks(gpu, profiler, (frame - latency) % slots));
+			lateTimed += Find(profiler, "Late") && Find(profiler, "Late")->mSampleCount > 0;
+		}
+
+		passed &= Check("scopes stay in their frame slot", gpu.mOutsideSlot == 0 && gpu.mInvalidQueries == 0, "%.0f outside", double(gpu.mOutsideSlot));
+		passed &= Check("every frame resolves once", profiler.GetResolvedFrameCount() == frames - latency, "%.0f frames", double(profiler.GetResolvedFrameCount()));
+
+		const GpuProfiler::PassStats* shadows = Find(profiler, "Lighting/Shadows");
+		const GpuProfiler::PassStats* lighting = Find(profiler, "Lighting");
+		passed &= Check("nested scopes are named by path", shadows && shadows->mDepth == 1 && lighting && lighting->mDepth == 0, "depth %.0f", shadows ? double(shadows->mDepth) : -1.0);
+		passed &= Check("durations use the queue frequency", shadows && Near(shadows->mLastMs, 0.5) && lighting && Near(lighting->mLastMs, 1.0) &&
+			Near(Find(profiler, "RSM")->mLastMs, 2.0), "%.3f ms", shadows ? shadows->mLastMs : -1.0);
+		const GpuProfiler::PassStats* blur = Find(profiler, "Blur");
+		passed &= Check("a repeated pass is summed", blur && Near(blur->mLastMs, 0.5) && blur->mSampleCount == frames - latency, "%.3f ms", blur ? blur->mLastMs : -1.0);
+		passed &= Check("scopes after the resolve are not timed", lateTimed == 0, "%.0f frames timed", double(lateTimed));
+
+		// the last resolved frame is frames - 1 - latency, the window holds it and the 7 before it
+		const GpuProfiler::PassStats* gbuffer = Find(profiler, "GBuffer");
+		double expectedLast = 1.0 + 0.01 * ((frames - 1 - latency) % 8);
+		bool window = gbuffer && Near(gbuffer->mAverageMs, 1.035) && Near(gbuffer->mMinMs, 1.0) && Near(gbuffer->mMaxMs, 1.07) && Near(gbuffer->mLastMs, expectedLast);
+		passed &= Check("window average, min, max and last", window, "%.3f ms average", gbuffer ? gbuffer->mAverageMs : -1.0);
+
+		double directTotal = profiler.GetQueueLastTimeMs(direct);
+		double expectedTotal = expectedLast + 1.0 + 0.5;
+		passed &= Check("queue totals count top level passes", Near(directTotal, expectedTotal) && Near(profiler.GetQueueTimeMs(compute), 2.0), "%.3f ms", directTotal);
+
+		std::string csv = profiler.ExportCSV();
+		bool header = csv.rfind("pass,queue,depth,samples,avg_ms,min_ms,max_ms,last_ms\n", 0) == 0;
+		bool row = csv.find("\nLighting/Shadows,direct,1,") != std::string::npos && csv.find("\nRSM,compute,0,") != std::string::npos;
+		passed &= Check("CSV has the header and a row per pass", header && row && csv.find("Late") == std::string::npos,
+			"%.0f rows", double(std::count(csv.begin(), csv.end(), '\n') - 1));
+		std::string json = profiler.ExportJSON();
+		bool frameCount = json.find("\"frames\": " + std::to_string(frames - latency)) != std::string::npos;
+		passed &= Check("JSON has the frame count and passes", frameCount && json.find("\"name\": \"Lighting/Shadows\"") != std::string::npos, "%.0f bytes", double(json.size()));
+
+		profiler.ResetStats();
+		passed &= Check("ResetStats drops every sample", profiler.ExportCSV() == "pass,queue,depth,samples,avg_ms,min_ms,max_ms,last_ms\n" &&
+			Find(profiler, "GBuffer")->mSampleCount == 0, "%.0f samples", double(Find(profiler, "GBuffer")->mSampleCount));
+	}
+
+	{
+		// 8 queries: four pairs, the fifth scope and the one nested in it do not fit
+		GpuProfiler profiler(8, slots);
+		GpuProfiler::QueueId direct = profiler.AddQueue("direct", 1000);
+		SyntheticGpu gpu(profiler, { 1000 });
+		profiler.BeginFrame(0);
+		for (int i = 0; i < 4; i++)
+			Scope(profiler, gpu, 0, direct, "Pass" + std::to_string(i), 1.0 + i);
+		uint32_t outerBegin = profiler.BeginScope(direct, "Outer");
+		uint32_t innerBegin = profiler.BeginScope(direct, "Inner");
+		uint32_t innerEnd = profiler.EndScope(direct);
+		uint32_t outerEnd = profiler.EndScope(direct);
+		uint32_t unbalanced = profiler.EndScope(direct);
+		bool exhausted = outerBegin == GpuProfiler::INVALID_QUERY && innerBegin == GpuProfiler::INVALID_QUERY &&
+			innerEnd == GpuProfiler::INVALID_QUERY && outerEnd == GpuProfiler::INVALID_QUERY;
+		passed &= Check("scopes past the limit get no queries", exhausted, "%.0f queries", double(profiler.GetMaxQueriesPerFrame()));
+		passed &= Check("an unbalanced end gets no query", unbalanced == GpuProfiler::INVALID_QUERY, "%.0f open scopes", 0.0);
+
+		uint32_t first = 0, count = 0;
+		profiler.GetResolveRange(direct, first, count);
+		profiler.EndFrame();
+		profiler.ResolveFrame(0, Readbacks(gpu, profiler, 0));
+		const GpuProfiler::PassStats* last = Find(profiler, "Pass3");
+		const GpuProfiler::PassStats* outer = Find(profiler, "Outer");
+		passed &= Check("scopes within the limit are still timed", count == 8 && last && Near(last->mLastMs, 4.0) && outer && outer->mSampleCount == 0,
+			"%.0f ms", last ? last->mLastMs : -1.0);
+	}
+
+	{
+		GpuProfiler profiler(16, slots);
+		GpuProfiler::QueueId direct = profiler.AddQueue("direct", 1000000);
+		GpuProfiler::QueueId compute = profiler.AddQueue("compute", 1000000);
+		SyntheticGpu gpu(profiler, { 1000000, 1000000 });
+
+		// a counter that went backwards, e.g. across a disjoint or wrapped timestamp
+		profiler.BeginFrame(0);
+		uint32_t begin = profiler.BeginScope(direct, "Wrapped");
+		uint32_t end = profiler.EndScope(direct);
+		gpu.mReadback[direct][begin] = UINT64_MAX - 10;
+		gpu.mReadback[direct][end] = 5;
+		Scope(profiler, gpu, 0, compute, "Skipped", 1.0);
+		uint32_t first = 0, count = 0;
+		profiler.GetResolveRange(direct, first, count);
+		profiler.GetResolveRange(compute, first, count);
+		profiler.EndFrame();
+		profiler.ResolveFrame(0, { gpu.mReadback[direct].data(), nullptr });
+		const GpuProfiler::PassStats* wrapped = Find(profiler, "Wrapped");
+		passed &= Check("a backwards counter times 0 ms", wrapped && wrapped->mSampleCount == 1 && wrapped->mLastMs == 0.0, "%.3f ms", wrapped ? wrapped->mLastMs : -1.0);
+		passed &= Check("a nullptr readback skips its queue", Find(profiler, "Skipped")->mSampleCount == 0, "%.0f samples", double(Find(profiler, "Skipped")->mSampleCount));
+
+		// slot 1 is ended, then begun again before the old frame was read back
+		profiler.BeginFrame(1);
+		Scope(profiler, gpu, 1, direct, "Dropped", 1.0);
+		profiler.GetResolveRange(direct, first, count);
+		profiler.EndFrame();
+		profiler.BeginFrame(1);
+		profiler.ResolveFrame(1, Readbacks(gpu, profiler, 1));
+		profiler.ResolveFrame(0, Readbacks(gpu, profiler, 0));
+		passed &= Check("a reused slot drops the old frame", profiler.GetResolvedFrameCount() == 1 && Find(profiler, "Dropped")->mSampleCount == 0,
+			"%.0f frames", double(profiler.GetResolvedFrameCount()));
+	}
+
+	{
+		GpuProfiler profiler(16, slots);
+		GpuProfiler::QueueId direct = profiler.AddQueue("direct", 1000);
+		SyntheticGpu gpu(profiler, { 1000 });
+		profiler.BeginFrame(0);
+		Scope(profiler, gpu, 0, direct, "Blur \"wide\", 9 taps", 1.0);
+		uint32_t first = 0, count = 0;
+		profiler.GetResolveRange(direct, first, count);
+		profiler.EndFrame();
+		profiler.ResolveFrame(0, Readbacks(gpu, profiler, 0));
+		bool csv = profiler.ExportCSV().find("\n\"Blur \"\"wide\"\", 9 taps\",direct,0,1,") != std::string::npos;
+		bool json = profiler.ExportJSON().find("\"name\": \"Blur \\\"wide\\\", 9 taps\"") != std::string::npos;
+		passed &= Check("names are quoted in CSV and escaped in JSON", csv && json, "%.0f of 2", double(csv + json));
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,488 @@
+// Times the CPU light propagation volume and checks it against the line by line port of the shader. The injection
+// is checked the same way against a scalar port of LPVInjection.hlsl (GSMain's cell and bounds, PSMain's
+// coefficients, blending off) for random VPLs inside and around the volume plus ones on the cell bounds, with the
+// default and a shifted cell transform, each written last-wins and accumulated.
+// --amortize instead plays a sequence of frames through LPVPropagationScheduler: static light, small flicker below
+// the restart threshold and two light changes, and reports per convergence epsilon the steps saved against a full
+// propagation every frame and the error of the accumulation against that full propagation.
+//
+//   LPVBench [options]
+//     --dims <list>        grid sizes, comma separated (default 16,32,64,128)
+//     --steps <n>          propagation steps (default 50, like the scene)
+//     --threads <n>        threads of the parallel run (default: hardware threads)
+//     --vpls <n>           random VPLs injected per grid (default 4096)
+//     --seed <n>           of the VPLs (default 1)
+//     --tolerance <value>  largest relative difference to the reference (default 1e-4)
+//     --no-reference       skip the reference run, it is slow for large grids
+//     --amortize           evaluate the amortized propagation instead
+//     --frames <n>         frames of the sequence (default 90)
+//     --steps-per-frame <n>  step budget of a frame, 0 for all (default 10)
+//     --restart-threshold <value>  relative change of the injection that restarts (default 0.01)
+//     --epsilons <list>    convergence epsilons, comma separated (default 0,0.01,0.02,0.05)
+//
+// Exits with 1 if a grid differs from the reference, an injection from the shader's, or a completed amortized propagation from a full one, and 2 on
+// bad arguments. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o LPVBench tools/LPVBench/main.cpp source/LPVEngine.cpp source/LPVGeometryVolume.cpp source/LPVPropagationScheduler.cpp source/CpuProfiler.cpp
+
+#include "LPVEngine.h"
+#include "LPVPropagationScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	int Usage()
+	{
+		std::cerr << "usage: LPVBench [--dims 16,32,64,128] [--steps n] [--threads n] [--vpls n] [--seed n] [--tolerance value] [--no-reference]\n"
+			"               [--amortize [--frames n] [--steps-per-frame n] [--restart-threshold value] [--epsilons 0,0.02]]\n";
+		return 2;
+	}
+
+	// VPLs on the floor and walls of the volume, facing inwards
+	std::vector<LPVEngine::VPL> MakeVPLs(uint32_t dim, uint32_t count, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		float extent = float(dim / 2) / LPVEngine::LPV_SCALE;
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> flux(0.0f, 1.0f);
+		std::uniform_int_distribution<int> wall(0, 5);
+
+		std::vector<LPVEngine::VPL> vpls(count);
+		for (LPVEngine::VPL& vpl : vpls)
+		{
+			int side = wall(random);
+			int axis = side % 3;
+			float sign = side < 3 ? -1.0f : 1.0f;
+			for (int i = 0; i < 3; i++)
+			{
+				vpl.mPosition[i] = position(random);
+				vpl.mNormal[i] = 0.0f;
+				vpl.mFlux[i] = flux(random);
+			}
+			vpl.mPosition[axis] = sign * extent * 0.9f;
+			vpl.mNormal[axis] = -sign;
+		}
+		return vpls;
+	}
+
+	// VPLs up to a quarter of the volume outside of it, with unnormalized normals in any direction, then VPLs on the
+	// bounds GSMain tests: int3() truncates towards zero, so cells in (-1, 0) land in 0 and -1 and dim are outside.
+	// The last ones share a cell so that the order of the writes shows.
+	std::vector<LPVEngine::VPL> MakeInjectionVPLs(uint32_t dim, uint32_t count, uint32_t seed, float scale, const float offset[3])
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> cell(-0.25f * float(dim), 1.25f * float(dim));
+		std::uniform_real_distribution<float> normal(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> flux(0.0f, 1.0f);
+
+		auto make = [&](float x, float y, float z) {
+			LPVEngine::VPL vpl;
+			float position[3] = { x, y, z };
+			for (int i = 0; i < 3; i++)
+			{
+				vpl.mPosition[i] = (position[i] - offset[i]) / scale;
+				vpl.mNormal[i] = normal(random);
+				vpl.mFlux[i] = flux(random);
+			}
+			return vpl;
+		};
+
+		std::vector<LPVEngine::VPL> vpls;
+		for (uint32_t i = 0; i < count; i++)
+			vpls.push_back(make(cell(random), cell(random), cell(random)));
+
+		float last = float(dim);
+		const float bounds[][3] = { { -0.75f, 0.5f, 0.5f }, { -1.25f, 0.5f, 0.5f }, { 0.5f, last + 0.25f, 0.5f }, { 0.5f, 0.5f, last - 0.25f },
+			{ 1e12f, 0.5f, 0.5f }, { 0.5f, -1e12f, 0.5f } };
+		for (const float (&position)[3] : bounds)
+		{
+			LPVEngine::VPL vpl = make(position[0], position[1], position[2]);
+			std::fill(std::begin(vpl.mNormal), std::end(vpl.mNormal), 0.0f);
+			vpls.push_back(vpl);
+		}
+		for (int i = 0; i < 8; i++)
+			vpls.push_back(make(2.5f, 2.5f, 2.5f));
+		return vpls;
+	}
+
+	// LPVInjection.hlsl for a single cascade with a storage scale of 1, written per line of GSMain and PSMain
+	void InjectReference(uint32_t dim, float scale, const float offset[3], const std::vector<LPVEngine::VPL>& vpls, bool accumulate,
+		std::vector<float> (&grids)[LPVEngine::CHANNEL_COUNT])
+	{
+		for (const LPVEngine::VPL& vpl : vpls)
+		{
+			// float3 cell = input[0].positionWS * LPVCascadeTransforms[cascade].w + LPVCascadeTransforms[cascade].xyz;
+			float cell[3];
+			for (int i = 0; i < 3; i++)
+				cell[i] = vpl.mPosition[i] * scale + offset[i];
+
+			// int3 cellPos = int3(cell + 0.5f * input[0].normal); if (any(cellPos < 0) || any(cellPos >= LPV_DIM)) continue;
+			// the conversion is only defined in C++ within the range of int, anything beyond is outside either way
+			int cellPos[3];
+			bool inside = true;
+			for (int i = 0; i < 3; i++)
+			{
+				float position = cell[i] + 0.5f * vpl.mNormal[i];
+				if (!(std::fabs(position) < 2147483520.0f))
+				{
+					inside = false;
+					break;
+				}
+				cellPos[i] = int(position);
+				inside = inside && cellPos[i] >= 0 && cellPos[i] < int(dim);
+			}
+			if (!inside)
+				continue;
+
+			// float4 SH_coef = DirCosLobeToSH(input.normal) / (PI * LPVStorageScale);
+			float shCoef[4] = { LPVEngine::SH_COSINE_LOBE_C0, -LPVEngine::SH_COSINE_LOBE_C1 * vpl.mNormal[1], LPVEngine::SH_COSINE_LOBE_C1 * vpl.mNormal[2],
+				-LPVEngine::SH_COSINE_LOBE_C1 * vpl.mNormal[0] };
+			for (float& coefficient : shCoef)
+				coefficient = coefficient / (LPVEngine::PI * 1.0f);
+
+			// output.layerID = cascade * LPV_DIM + cellPos.z at texel cellPos.xy, output.redSH = SH_coef * input.flux.r
+			size_t texel = ((size_t(cellPos[2]) * dim + size_t(cellPos[1])) * dim + size_t(cellPos[0])) * 4;
+			for (int channel = 0; channel < LPVEngine::CHANNEL_COUNT; channel++)
+			{
+				for (int i = 0; i < 4; i++)
+				{
+					float value = shCoef[i] * vpl.mFlux[channel];
+					grids[channel][texel + i] = accumulate ? grids[channel][texel + i] + value : value;
+				}
+			}
+		}
+	}
+
+	template <typename Func>
+	double TimeMs(Func func)
+	{
+		Clock::time_point start = Clock::now();
+		func();
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	float GridError(const LPVEngine& a, const LPVEngine& b)
+	{
+		float error = 0.0f;
+		size_t count = size_t(a.GetCellCount()) * 4;
+		for (int channel = 0; channel < LPVEngine::CHANNEL_COUNT; channel++)
+		{
+			error = std::max(error, LPVEngine::MaxRelativeError(a.GetGrid(LPVEngine::Channel(channel)), b.GetGrid(LPVEngine::Channel(channel)), count));
+			error = std::max(error, LPVEngine::MaxRelativeError(a.GetAccumulation(LPVEngine::Channel(channel)), b.GetAccumulation(LPVEngine::Channel(channel)), count));
+		}
+		return error;
+	}
+
+	// Sum of the absolute differences of the accumulations relative to the sum of the absolute values of a
+	double AccumulationError(const LPVEngine& a, const LPVEngine& b)
+	{
+		double difference = 0.0;
+		double total = 0.0;
+		size_t count = size_t(a.GetCellCount()) * 4;
+		for (int channel = 0; channel < LPVEngine::CHANNEL_COUNT; channel++)
+		{
+			const float* accumulationA = a.GetAccumulation(LPVEngine::Channel(channel));
+			const float* accumulationB = b.GetAccumulation(LPVEngine::Channel(channel));
+			for (size_t i = 0; i < count; i++)
+			{
+				difference += std::fabs(double(accumulationA[i]) - double(accumulationB[i]));
+				total += std::fabs(double(accumulationA[i]));
+			}
+		}
+		return total > 0.0 ? difference / total : difference;
+	}
+
+	bool ParseList(const char* text, std::vector<double>& values)
+	{
+		values.clear();
+		std::stringstream list(text);
+		std::string item;
+		while (std::getline(list, item, ','))
+		{
+			char* end = nullptr;
+			double value = std::strtod(item.c_str(), &end);
+			if (item.empty() || *end != '\0' || value < 0.0)
+				return false;
+			values.push_back(value);
+		}
+		return !values.empty();
+	}
+
+	struct AmortizedRun
+	{
+		LPVEngine mEngine;
+		LPVPropagationScheduler mScheduler;
+		std::vector<LPVEngine::VPL> mRestartVPLs;   // injection of the last restart, what the accumulation converges to
+		double mErrorSum = 0.0;
+		double mMaxError = 0.0;
+		double mLastError = 0.0;
+
+		AmortizedRun(uint32_t dim, const LPVPropagationScheduler::Settings& settings) : mEngine(dim), mScheduler(settings) {}
+	};
+
+	// Light that changes twice over the sequence, at a third and two thirds, and flickers by a quarter of the restart
+	// threshold in between
+	std::vector<LPVEngine::VPL> MakeFrameVPLs(uint32_t dim, uint32_t count, uint32_t seed, uint32_t frame, uint32_t frames, float flicker)
+	{
+		uint32_t phase = frame * 3 / std::max(frames, 1u);
+		std::vector<LPVEngine::VPL> vpls = MakeVPLs(dim, count, seed + phase);
+		float scale = 1.0f + flicker * std::sin(float(frame));
+		for (LPVEngine::VPL& vpl : vpls)
+		{
+			for (int i = 0; i < 3; i++)
+				vpl.mFlux[i] *= scale;
+		}
+		return vpls;
+	}
+
+	bool EvaluateAmortized(const std::vector<uint32_t>& dims, uint32_t steps, uint32_t threads, uint32_t vplCount, uint32_t seed,
+		double tolerance, uint32_t frames, const LPVPropagationScheduler::Settings& baseSettings, const std::vector<double>& epsilons)
+	{
+		std::printf("%u steps, %u steps per frame, %u frames, %u VPLs, restart threshold %g\n\n", steps, baseSettings.mStepsPerFrame,
+			frames, vplCount, baseSettings.mRestartThreshold);
+		std::printf("%6s %10s %10s %8s %9s %8s %12s %12s %12s\n", "Dim", "Epsilon", "Steps", "Saved", "Restarts", "Early", "Mean error", "Max error", "Last error");
+
+		bool failed = false;
+		for (uint32_t dim : dims)
+		{
+			std::vector<std::unique_ptr<AmortizedRun>> runs;
+			for (double epsilon : epsilons)
+			{
+				LPVPropagationScheduler::Settings settings = baseSettings;
+				settings.mMaxSteps = steps;
+				settings.mConvergenceEpsilon = float(epsilon);
+				runs.emplace_back(new AmortizedRun(dim, settings));
+				runs.back()->mEngine.SetThreadCount(threads);
+			}
+
+			LPVEngine full(dim);
+			LPVEngine probe(dim);
+			full.SetThreadCount(threads);
+			size_t count = size_t(probe.GetCellCount()) * 4;
+			std::vector<float> injected(count * LPVEngine::CHANNEL_COUNT);
+			std::vector<float> restartInjected;
+
+			for (uint32_t frame = 0; frame < frames; frame++)
+			{
+				std::vector<LPVEngine::VPL> vpls = MakeFrameVPLs(dim, vplCount, seed, frame, frames, baseSettings.mRestartThreshold * 0.25f);
+
+				// What every frame runs today
+				full.Clear();
+				full.Inject(vpls);
+				full.Propagate(steps);
+
+				// The injection alone, to measure how much it changed
+				probe.Clear();
+				probe.Inject(vpls);
+				for (int channel = 0; channel < LPVEngine::CHANNEL_COUNT; channel++)
+					std::copy(probe.GetGrid(LPVEngine::Channel(channel)), probe.GetGrid(LPVEngine::Channel(channel)) + count, injected.begin() + channel * count);
+
+				for (std::unique_ptr<AmortizedRun>& run : runs)
+				{
+					// every run restarts on the first frame, so they share the reference injection
+					float change = restartInjected.empty() ? -1.0f :
+						LPVPropagationScheduler::RelativeChange(restartInjected.data(), injected.data(), injected.size());
+					LPVPropagationScheduler::Action action = run->mScheduler.BeginFrame(change);
+					if (action == LPVPropagationScheduler::ACTION_RESTART)
+					{
+						run->mEngine.Clear();
+						run->mEngine.Inject(vpls);
+						run->mRestartVPLs = vpls;
+					}
+					for (uint32_t step = 0; step < run->mScheduler.GetStepBudget(); step++)
+					{
+						run->mEngine.PropagateSteps(1);
+						if (!run->mScheduler.EndStep(run->mEngine.GetEnergy(), run->mEngine.GetAccumulatedEnergy()))
+							break;
+					}
+
+					double error = AccumulationError(full, run->mEngine);
+					run->mErrorSum += error;
+					run->mMaxError = std::max(run->mMaxError, error);
+					run->mLastError = error;
+				}
+				if (restartInjected.empty() || runs.front()->mScheduler.GetAction() == LPVPropagationScheduler::ACTION_RESTART)
+					restartInjected = injected;
+			}
+
+			for (size_t i = 0; i < runs.size(); i++)
+			{
+				const AmortizedRun& run = *runs[i];
+				const LPVPropagationScheduler::Stats& stats = run.mScheduler.GetStats();
+				uint64_t fullSteps = uint64_t(frames) * steps;
+
+				// Steps spread over frames have to add up to the same accumulation as running them at once
+				bool mismatch = false;
+				if (run.mScheduler.IsDone() && !run.mScheduler.IsConverged())
+				{
+					LPVEngine check(dim);
+					check.Inject(run.mRestartVPLs);
+					check.Propagate(steps);
+					mismatch = GridError(check, run.mEngine) > tolerance;
+				}
+				std::printf("%6u %10g %10llu %7.1f%% %9llu %8llu %12.3g %12.3g %12.3g%s\n", dim, epsilons[i], (unsigned long long)stats.mSteps,
+					fullSteps > 0 ? 100.0 * double(stats.GetSavedSteps(steps)) / double(fullSteps) : 0.0, (unsigned long long)stats.mRestarts,
+					(unsigned long long)stats.mEarlyStops, run.mErrorSum / std::max(frames, 1u), run.mMaxError, run.mLastError,
+					mismatch ? "  MISMATCH" : "");
+				failed |= mismatch;
+			}
+		}
+		return !failed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<uint32_t> dims = { 16, 32, 64, 128 };
+	uint32_t steps = 50;
+	uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+	uint32_t vplCount = 4096;
+	uint32_t seed = 1;
+	double tolerance = 1e-4;
+	bool reference = true;
+	bool amortize = false;
+	uint32_t frames = 90;
+	LPVPropagationScheduler::Settings amortizeSettings;
+	amortizeSettings.mStepsPerFrame = 10;
+	std::vector<double> epsilons = { 0.0, 0.01, 0.02, 0.05 };
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--dims" && hasValue)
+		{
+			dims.clear();
+			std::stringstream list(argv[++i]);
+			std::string item;
+			while (std::getline(list, item, ','))
+			{
+				int dim = std::atoi(item.c_str());
+				if (dim <= 0)
+					return Usage();
+				dims.push_back(uint32_t(dim));
+			}
+		}
+		else if (arg == "--steps" && hasValue)
+			steps = uint32_t(std::atoi(argv[++i]));
+		else if (arg == "--threads" && hasValue)
+			threads = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--vpls" && hasValue)
+			vplCount = uint32_t(std::max(std::atoi(argv[++i]), 0));
+		else if (arg == "--seed" && hasValue)
+			seed = uint32_t(std::atoi(argv[++i]));
+		else if (arg == "--tolerance" && hasValue)
+			tolerance = std::atof(argv[++i]);
+		else if (arg == "--no-reference")
+			reference = false;
+		else if (arg == "--amortize")
+			amortize = true;
+		else if (arg == "--frames" && hasValue)
+			frames = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--steps-per-frame" && hasValue)
+			amortizeSettings.mStepsPerFrame = uint32_t(std::max(std::atoi(argv[++i]), 0));
+		else if (arg == "--restart-threshold" && hasValue)
+			amortizeSettings.mRestartThreshold = float(std::atof(argv[++i]));
+		else if (arg == "--epsilons" && hasValue)
+		{
+			if (!ParseList(argv[++i], epsilons))
+				return Usage();
+		}
+		else
+			return Usage();
+	}
+	if (dims.empty())
+		return Usage();
+	if (amortize)
+		return EvaluateAmortized(dims, steps, threads, vplCount, seed, tolerance, frames, amortizeSettings, epsilons) ? 0 : 1;
+
+	std::printf("%u steps, %u VPLs, %u threads\n\n", steps, vplCount, threads);
+	std::printf("%6s %12s %12s %12s %12s %10s %12s\n", "Dim", "Reference", "1 thread", "Threads", "ns/cell", "Speedup", "Error");
+
+	bool failed = false;
+	for (uint32_t dim : dims)
+	{
+		std::vector<LPVEngine::VPL> vpls = MakeVPLs(dim, vplCount, seed);
+
+		LPVEngine serial(dim);
+		serial.Inject(vpls);
+		double serialMs = TimeMs([&] { serial.Propagate(steps); });
+
+		LPVEngine parallel(dim);
+		parallel.SetThreadCount(threads);
+		parallel.Inject(vpls);
+		double parallelMs = TimeMs([&] { parallel.Propagate(steps); });
+
+		float error = GridError(serial, parallel);
+		double referenceMs = 0.0;
+		if (reference)
+		{
+			LPVEngine golden(dim);
+			golden.Inject(vpls);
+			referenceMs = TimeMs([&] { golden.PropagateReference(steps); });
+			error = std::max(error, GridError(golden, parallel));
+		}
+
+		double cellSteps = double(serial.GetCellCount()) * std::max(steps, 1u);
+		char referenceText[32] = "-";
+		if (reference)
+			std::snprintf(referenceText, sizeof(referenceText), "%.2f ms", referenceMs);
+		std::printf("%6u %12s %9.2f ms %9.2f ms %12.2f %9.2fx %12.3g%s\n", dim, referenceText, serialMs, parallelMs,
+			parallelMs * 1e6 / cellSteps, parallelMs > 0.0 ? serialMs / parallelMs : 0.0, error, error > tolerance ? "  MISMATCH" : "");
+		failed |= error > tolerance;
+	}
+
+	std::printf("\nInjection against LPVInjection.hlsl, %u VPLs\n\n", vplCount);
+	std::printf("%6s %10s %12s %12s %10s %12s\n", "Dim", "Transform", "Inject", "ns/VPL", "Cells", "Error");
+	for (uint32_t dim : dims)
+	{
+		const float centered[3] = { float(dim / 2), float(dim / 2), float(dim / 2) };
+		const float shifted[3] = { float(dim / 2) + 3.25f, float(dim / 2) - 7.5f, float(dim / 2) + 0.125f };
+		const struct { const char* mName; float mScale; const float* mOffset; } transforms[] = {
+			{ "default", LPVEngine::LPV_SCALE, centered }, { "shifted", 0.5f, shifted } };
+		for (const auto& transform : transforms)
+		{
+			std::vector<LPVEngine::VPL> vpls = MakeInjectionVPLs(dim, vplCount, seed, transform.mScale, transform.mOffset);
+			LPVEngine engine(dim);
+			engine.SetCellTransform(transform.mScale, transform.mOffset);
+			size_t count = size_t(engine.GetCellCount()) * 4;
+
+			float error = 0.0f;
+			double injectMs = 0.0;
+			uint64_t cells = 0;
+			for (bool accumulate : { false, true })
+			{
+				engine.Clear();
+				injectMs = TimeMs([&] { engine.Inject(vpls, accumulate); });
+
+				std::vector<float> golden[LPVEngine::CHANNEL_COUNT];
+				for (std::vector<float>& grid : golden)
+					grid.assign(count, 0.0f);
+				InjectReference(dim, transform.mScale, transform.mOffset, vpls, accumulate, golden);
+				for (int channel = 0; channel < LPVEngine::CHANNEL_COUNT; channel++)
+					error = std::max(error, LPVEngine::MaxRelativeError(golden[channel].data(), engine.GetGrid(LPVEngine::Channel(channel)), count));
+
+				cells = 0;
+				for (size_t i = 0; i < count; i += 4)
+					cells += golden[LPVEngine::CHANNEL_RED][i] != 0.0f || golden[LPVEngine::CHANNEL_GREEN][i] != 0.0f || golden[LPVEngine::CHANNEL_BLUE][i] != 0.0f;
+			}
+
+			std::printf("%6u %10s %9.3f ms %12.2f %10llu %12.3g%s\n", dim, transform.mName, injectMs, vpls.empty() ? 0.0 : injectMs * 1e6 / double(vpls.size()),
+				(unsigned long long)cells, error, error > tolerance ? "  MISMATCH" : "");
+			failed |= error > tolerance;
+		}
+	}
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,375 @@
+// Checks the placement, routing and blend weights of LPVCascades, the last two against ports of the shader loops.
+//   placement   one cascade of 4 unit cells at the origin is the old fixed volume of LPVEngine; cell sizes double
+//               per cascade; along a random camera path every origin stays a whole number of its cells, the camera
+//               stays in the middle cell, each cascade fits inside the next coarser one, a world point never moves
+//               by part of a cell and a cascade is marked moved exactly when its origin changed, coarser ones less
+//               often than finer ones
+//   routing     the finest cascade holding a VPL margin cells inside its border takes it, coarser ones holding it
+//               too take it with inject coarser, the coarsest takes everything else; Route equals GSMain of
+//               LPVInjection.hlsl for random positions and the VPL lists follow the masks; a configured engine puts
+//               a VPL into the cell the cascade maps it to
+//   blending    the weights add up to 1 inside the coarsest cascade and 0 outside, the finest cascade is 1 at the
+//               camera and fades linearly over the blend band, no weight jumps along a ray out of the cascades and
+//               GetBlendWeights equals the cascade loop of Lighting.hlsl
+//
+//   LPVCascadesCheck [--dim n] [--cascades n] [--cell-size x] [--steps n] [--seed n]
+//
+// --dim is the cells per side (32, LPV_DIM), --cascades the cascade count (3, LPV_CASCADES), --cell-size the finest
+// cell size (1) and --steps the length of the camera path (20000). Prints a line per check and exits with 1 if any
+// fails and 2 on bad arguments. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o LPVCascadesCheck tools/LPVCascadesCheck/main.cpp source/LPVCascades.cpp source/LPVEngine.cpp source/LPVGeometryVolume.cpp source/CpuProfiler.cpp
+
+#include "../Check.h"
+#include "LPVCascades.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: LPVCascadesCheck [--dim n] [--cascades n] [--cell-size x] [--steps n] [--seed n]\n";
+		return 2;
+	}
+
+	// LPVBorderDistance of Common.hlsl
+	float BorderDistance(const float cell[3], uint32_t dim)
+	{
+		float distance[3];
+		for (int i = 0; i < 3; i++)
+			distance[i] = std::min(cell[i], float(dim) - cell[i]);
+		return std::min(distance[0], std::min(distance[1], distance[2]));
+	}
+
+	void ToCell(const LPVCascades& cascades, uint32_t cascade, const float position[3], float cell[3])
+	{
+		// float3 cell = positionWS * LPVCascadeTransforms[cascade].w + LPVCascadeTransforms[cascade].xyz;
+		float scale, offset[3];
+		cascades.GetCellTransform(cascade, scale, offset);
+		for (int i = 0; i < 3; i++)
+			cell[i] = position[i] * scale + offset[i];
+	}
+
+	// The cascades GSMain of LPVInjection.hlsl emits a point for, before the cell bounds test
+	uint32_t RouteShader(const LPVCascades& cascades, const float position[3], float margin, bool injectCoarser)
+	{
+		int lastCascade = int(cascades.GetCascadeCount()) - 1;
+		int targetCascade = lastCascade;
+		for (int i = 0; i < lastCascade; i++)
+		{
+			float cell[3];
+			ToCell(cascades, uint32_t(i), position, cell);
+			if (BorderDistance(cell, cascades.GetCascade(i).mDim) >= margin)
+			{
+				targetCascade = i;
+				break;
+			}
+		}
+
+		uint32_t mask = 0;
+		for (int cascade = targetCascade; cascade <= lastCascade; cascade++)
+		{
+			float cell[3];
+			ToCell(cascades, uint32_t(cascade), position, cell);
+			if (cascade > targetCascade && (!injectCoarser || BorderDistance(cell, cascades.GetCascade(cascade).mDim) < 0.0f))
+				continue;
+			mask |= 1u << cascade;
+		}
+		return mask;
+	}
+
+	// The cascade loop of Lighting.hlsl
+	void BlendShader(const LPVCascades& cascades, const float position[3], float margin, float blend, float weights[LPVCascades::MAX_CASCADES])
+	{
+		std::fill(weights, weights + LPVCascades::MAX_CASCADES, 0.0f);
+		int cascadeCount = int(cascades.GetCascadeCount());
+		float remainingWeight = 1.0f;
+		for (int cascade = 0; cascade < cascadeCount && remainingWeight > 0.0f; cascade++)
+		{
+			float cell[3];
+			ToCell(cascades, uint32_t(cascade), position, cell);
+			float borderDistance = BorderDistance(cell, cascades.GetCascade(cascade).mDim);
+			float weight = (cascade == cascadeCount - 1) ? (borderDistance >= 0.0f ? 1.0f : 0.0f) :
+				std::min(std::max((borderDistance - margin) / std::max(blend, 1e-6f), 0.0f), 1.0f);
+			weight *= remainingWeight;
+			remainingWeight -= weight;
+			weights[cascade] = weight;
+		}
+	}
+
+	float WeightSum(const float weights[LPVCascades::MAX_CASCADES])
+	{
+		float sum = 0.0f;
+		for (uint32_t i = 0; i < LPVCascades::MAX_CASCADES; i++)
+			sum += weights[i];
+		return sum;
+	}
+
+	uint32_t BitCount(uint32_t mask)
+	{
+		uint32_t count = 0;
+		for (; mask; mask &= mask - 1)
+			count++;
+		return count;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t dim = 32;
+	uint32_t cascadeCount = 3;
+	float cellSize = 1.0f;
+	uint32_t steps = 20000;
+	uint32_t seed = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--dim" && hasValue)
+			dim = uint32_t(std::max(std::atoi(argv[++i]), 4));
+		else if (arg == "--cascades" && hasValue)
+			cascadeCount = uint32_t(std::min(std::max(std::atoi(argv[++i]), 1), int(LPVCascades::MAX_CASCADES)));
+		else if (arg == "--cell-size" && hasValue)
+			cellSize = float(std::max(std::atof(argv[++i]), 1e-3));
+		else if (arg == "--steps" && hasValue)
+			steps = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--seed" && hasValue)
+			seed = uint32_t(std::atoi(argv[++i]));
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+	std::mt19937 random(seed);
+	LPVCascades cascades(cascadeCount, dim, cellSize);
+	const uint32_t last = cascades.GetCascadeCount() - 1;
+	// the extent of the coarsest cascade, positions are drawn a bit beyond it
+	const float extent = float(dim) * cascades.GetCascade(last).mCellSize;
+
+	{
+		LPVCascades single(1, dim, 1.0f / LPVEngine::LPV_SCALE);
+		LPVEngine engine(dim);
+		float scale, offset[3];
+		single.GetCellTransform(0, scale, offset);
+		bool fixed = scale == engine.GetCellScale() && std::equal(offset, offset + 3, engine.GetCellOffset());
+		passed &= Check("one cascade is the old fixed volume", fixed, "offset %.0f cells", offset[0]);
+
+		bool doubling = cascades.GetCascadeCount() == cascadeCount;
+		for (uint32_t i = 1; i < cascades.GetCascadeCount(); i++)
+			doubling = doubling && cascades.GetCascade(i).mCellSize == 2.0f * cascades.GetCascade(i - 1).mCellSize;
+		LPVCascades clamped(9, dim, cellSize);
+		passed &= Check("cell sizes double per cascade", doubling && clamped.GetCascadeCount() == LPVCascades::MAX_CASCADES,
+			"%.0f coarsest", cascades.GetCascade(last).mCellSize);
+	}
+
+	{
+		LPVCascades path(cascadeCount, dim, cellSize);
+		std::normal_distribution<float> step(0.0f, cellSize * 0.4f);
+		float center[3] = { 0.37f, -12.5f, 3.0f };
+		const float world[3] = { 5.3f, -7.1f, 11.9f };
+		float startFraction[LPVCascades::MAX_CASCADES][3];
+		for (uint32_t c = 0; c <= last; c++)
+		{
+			float cell[3];
+			path.GetCellPosition(c, world, cell);
+			for (int i = 0; i < 3; i++)
+				startFraction[c][i] = cell[i] - std::floor(cell[i]);
+		}
+
+		uint32_t unsnapped = 0, offCenter = 0, outside = 0, shifted = 0, wrongMoved = 0;
+		uint64_t moves[LPVCascades::MAX_CASCADES] = {};
+		for (uint32_t s = 0; s < steps; s++)
+		{
+			float previous[LPVCascades::MAX_CASCADES][3];
+			for (uint32_t c = 0; c <= last; c++)
+				std::copy(path.GetCascade(c).mOrigin, path.GetCascade(c).mOrigin + 3, previous[c]);
+			for (int i = 0; i < 3; i++)
+				center[i] += step(random);
+			path.Update(center);
+
+			for (uint32_t c = 0; c <= last; c++)
+			{
+				const LPVCascades::Cascade& cascade = path.GetCascade(c);
+				bool changed = false;
+				float cell[3], worldCell[3];
+				path.GetCellPosition(c, center, cell);
+				path.GetCellPosition(c, world, worldCell);
+				for (int i = 0; i < 3; i++)
+				{
+					float cells = cascade.mOrigin[i] / cascade.mCellSize;
+					// exact for power of two cell sizes, within rounding for the others
+					unsnapped += std::fabs(cells - std::round(cells)) > 1e-3f;
+					offCenter += !(cell[i] >= float(dim / 2) && cell[i] < float(dim / 2 + 1));
+					changed |= cascade.mOrigin[i] != previous[c][i];
+					float fraction = worldCell[i] - std::floor(worldCell[i]);
+					float drift = std::fabs(fraction - startFraction[c][i]);
+					shifted += std::min(drift, 1.0f - drift) > 1e-3f;
+					if (c < last)
+					{
+						const LPVCascades::Cascade& coarser = path.GetCascade(c + 1);
+						outside += cascade.mOrigin[i] < coarser.mOrigin[i] ||
+							cascade.mOrigin[i] + float(dim) * cascade.mCellSize > coarser.mOrigin[i] + float(dim) * coarser.mCellSize;
+					}
+				}
+				wrongMoved += changed != cascade.mMoved;
+				moves[c] += cascade.mMoved;
+			}
+		}
+		bool fewerMoves = true;
+		for (uint32_t c = 1; c <= last; c++)
+			fewerMoves = fewerMoves && moves[c] < moves[c - 1];
+		passed &= Check("path: origins snap to whole cells", unsnapped == 0, "%.0f unsnapped", double(unsnapped));
+		passed &= Check("path: the camera stays in the middle cell", offCenter == 0, "%.0f off center", double(offCenter));
+		passed &= Check("path: cascades nest", outside == 0, "%.0f outside", double(outside));
+		passed &= Check("path: light never moves by part of a cell", shifted == 0, "%.0f shifted", double(shifted));
+		passed &= Check("path: moved flags follow the origins", wrongMoved == 0 && fewerMoves, "%.0f finest moves", double(moves[0]));
+		std::printf("    moves per cascade over %u steps:", steps);
+		for (uint32_t c = 0; c <= last; c++)
+			std::printf(" %llu", (unsigned long long)moves[c]);
+		std::printf("\n");
+	}
+
+	{
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		cascades.Update(center);
+		uint32_t all = (1u << cascades.GetCascadeCount()) - 1;
+		bool atCamera = cascades.Route(center) == all;
+		cascades.SetInjectCoarser(false);
+		atCamera = atCamera && cascades.Route(center) == 1u;
+		cascades.SetInjectCoarser(true);
+		passed &= Check("routing: the camera goes to the finest", atCamera, "mask %.0f", double(cascades.Route(center)));
+
+		const LPVCascades::Cascade& finest = cascades.GetCascade(0);
+		float inMargin[3] = { finest.mOrigin[0] + 0.5f * finest.mCellSize, 0.0f, 0.0f };
+		float far[3] = { 10.0f * extent, 0.0f, 0.0f };
+		bool edges = last == 0 || ((cascades.Route(inMargin) & 1u) == 0 && (cascades.Route(inMargin) & 2u) != 0);
+		edges = edges && cascades.Route(far) == 1u << last;
+		passed &= Check("routing: the margin and far VPLs", edges, "mask %.0f", double(cascades.Route(inMargin)));
+
+		std::uniform_real_distribution<float> position(-0.6f * extent, 0.6f * extent);
+		std::uniform_real_distribution<float> margin(0.0f, 4.0f);
+		uint32_t differences = 0, listErrors = 0, cellErrors = 0, injected = 0;
+		for (int round = 0; round < 20; round++)
+		{
+			float moved[3] = { position(random), position(random), position(random) };
+			cascades.Update(moved);
+			cascades.SetMargin(margin(random));
+			cascades.SetInjectCoarser(round % 2 == 0);
+
+			std::vector<LPVEngine::VPL> vpls(2000);
+			uint32_t expectedEntries = 0;
+			for (LPVEngine::VPL& vpl : vpls)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					vpl.mPosition[i] = moved[i] + position(random);
+					vpl.mNormal[i] = 0.0f;
+					vpl.mFlux[i] = 1.0f;
+				}
+				uint32_t mask = cascades.Route(vpl.mPosition);
+				differences += mask != RouteShader(cascades, vpl.mPosition, cascades.GetMargin(), round % 2 == 0);
+				expectedEntries += BitCount(mask);
+			}
+
+			std::vector<std::vector<LPVEngine::VPL>> cascadeVPLs;
+			cascades.Route(vpls, cascadeVPLs);
+			uint32_t entries = 0;
+			for (const std::vector<LPVEngine::VPL>& list : cascadeVPLs)
+				entries += uint32_t(list.size());
+			listErrors += entries != expectedEntries || cascadeVPLs.size() != cascades.GetCascadeCount();
+
+			// a configured engine puts the VPL where the cascade maps it
+			for (uint32_t c = 0; c <= last; c++)
+			{
+				LPVEngine engine(dim);
+				cascades.Configure(c, engine);
+				for (const LPVEngine::VPL& vpl : cascadeVPLs[c])
+				{
+					uint32_t x, y, z;
+					float cell[3];
+					cascades.GetCellPosition(c, vpl.mPosition, cell);
+					bool inside = engine.GetInjectionCell(vpl, x, y, z);
+					bool expectInside = cell[0] > -1.0f && cell[1] > -1.0f && cell[2] > -1.0f && cell[0] < float(dim) && cell[1] < float(dim) && cell[2] < float(dim);
+					cellErrors += inside != expectInside || (inside && (x != uint32_t(int(cell[0])) || y != uint32_t(int(cell[1])) || z != uint32_t(int(cell[2]))));
+					injected += inside;
+				}
+			}
+		}
+		cascades.SetMargin(1.0f);
+		cascades.SetInjectCoarser(true);
+		passed &= Check("routing: Route equals GSMain", differences == 0, "%.0f differences", double(differences));
+		passed &= Check("routing: VPL lists follow the masks", listErrors == 0, "%.0f rounds off", double(listErrors));
+		passed &= Check("routing: engines inject into cascade cells", cellErrors == 0, "%.0f injected", double(injected));
+	}
+
+	{
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		cascades.Update(center);
+		cascades.SetMargin(1.0f);
+		cascades.SetBlend(4.0f);
+		float weights[LPVCascades::MAX_CASCADES];
+		cascades.GetBlendWeights(center, weights);
+		bool atCamera = weights[0] == 1.0f && WeightSum(weights) == 1.0f;
+		passed &= Check("blend: the finest cascade at the camera", atCamera, "weight %.2f", weights[0]);
+
+		// halfway through the band of the finest cascade: 1 + 2 cells from its border, far inside the next one
+		const LPVCascades::Cascade& finest = cascades.GetCascade(0);
+		float band[3] = { finest.mOrigin[0] + 3.0f * finest.mCellSize, 0.0f, 0.0f };
+		cascades.GetBlendWeights(band, weights);
+		bool half = last == 0 || (std::fabs(weights[0] - 0.5f) < 1e-5f && std::fabs(weights[1] - 0.5f) < 1e-5f);
+		passed &= Check("blend: half way through the band", half, "weight %.3f", weights[0]);
+
+		std::uniform_real_distribution<float> position(-0.75f * extent, 0.75f * extent);
+		std::uniform_real_distribution<float> setting(0.0f, 6.0f);
+		uint32_t differences = 0, badSums = 0;
+		for (int round = 0; round < 20; round++)
+		{
+			float moved[3] = { position(random), position(random), position(random) };
+			cascades.Update(moved);
+			cascades.SetMargin(setting(random));
+			cascades.SetBlend(round == 0 ? 0.0f : setting(random));
+			for (int i = 0; i < 5000; i++)
+			{
+				float point[3] = { moved[0] + position(random), moved[1] + position(random), moved[2] + position(random) };
+				float shader[LPVCascades::MAX_CASCADES];
+				cascades.GetBlendWeights(point, weights);
+				BlendShader(cascades, point, cascades.GetMargin(), cascades.GetBlend(), shader);
+				differences += !std::equal(weights, weights + LPVCascades::MAX_CASCADES, shader);
+
+				float cell[3];
+				cascades.GetCellPosition(last, point, cell);
+				float expected = BorderDistance(cell, dim) >= 0.0f ? 1.0f : 0.0f;
+				badSums += std::fabs(WeightSum(weights) - expected) > 1e-5f;
+			}
+		}
+		passed &= Check("blend: weights equal Lighting.hlsl", differences == 0, "%.0f differences", double(differences));
+		passed &= Check("blend: weights add up to 1 inside", badSums == 0, "%.0f bad sums", double(badSums));
+
+		cascades.Update(center);
+		cascades.SetMargin(1.0f);
+		cascades.SetBlend(4.0f);
+		float previous[LPVCascades::MAX_CASCADES];
+		cascades.GetBlendWeights(center, previous);
+		const float stepSize = cascades.GetCascade(0).mCellSize / 64.0f;
+		float largestJump = 0.0f;
+		for (float x = stepSize; x < 0.45f * extent; x += stepSize)
+		{
+			float point[3] = { x, 0.3f * x, -0.2f * x };
+			cascades.GetBlendWeights(point, weights);
+			for (uint32_t c = 0; c < last; c++)
+				largestJump = std::max(largestJump, std::fabs(weights[c] - previous[c]));
+			std::copy(weights, weights + LPVCascades::MAX_CASCADES, previous);
+		}
+		// a band of 4 cells changes a weight by 1/256 per 1/64 cell
+		passed &= Check("blend: no jumps along a ray", largestJump <= 1.0f / 256.0f + 1e-4f, "%.4f largest step", largestJump);
+	}
+
+	return passed ? 0 : 1;
+}
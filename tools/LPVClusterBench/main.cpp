@@ -0,0 +1,322 @@
+// Clusters the VPLs of a reflective shadow map per light propagation volume cell (LPVClustering) and compares the
+// injected and propagated SH against injecting every VPL.
+// The RSM is profiling/rsm_capture.bin, the sample scene (tools/RSMSceneCapture), or the file of --capture, in the
+// fixed volume of LPV_SCALE around the origin, which is the finest cascade of the scene at the origin. With
+// --synthetic, or without the capture, it is ray cast on the CPU from a box scene in the volume: a floor, two
+// coloured walls and two blocks, lit by the default directional light of the sample scene, with the flux of
+// ShadowMapping.hlsl (albedo * light colour).
+// The reference sums every VPL into its cell (LPVEngine::Inject with accumulate), errors are the summed absolute
+// difference of all SH coefficients relative to the summed absolute reference.
+//
+//   LPVClusterBench [options]
+//     --capture <file>     RSM capture (default profiling/rsm_capture.bin)
+//     --synthetic          box scene instead of the capture
+//     --rsm <n>            RSM size of the box scene (default 2048, like RSM_SIZE)
+//     --dim <n>            volume size (default 32, like LPV_DIM)
+//     --steps <n>          propagation steps (default 50)
+//     --k <list>           VPLs per cell, comma separated (default 1,2,4,8)
+//     --threads <n>        propagation threads (default: hardware threads)
+//     --tolerance <value>  largest propagated error of the largest K (default 0.05)
+//
+// Exits with 1 if the largest K is above the tolerance and 2 on bad arguments. Standalone and standard library only,
+// e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o LPVClusterBench tools/LPVClusterBench/main.cpp source/LPVClustering.cpp source/LPVEngine.cpp source/LPVGeometryVolume.cpp source/RSMCapture.cpp source/CpuProfiler.cpp
+
+#include "../Check.h"
+#include "LPVClustering.h"
+#include "LPVEngine.h"
+#include "RSMCapture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace
+{
+	typedef std::chrono::high_resolution_clock Clock;
+
+	int Usage()
+	{
+		std::cerr << "usage: LPVClusterBench [--capture file | --synthetic] [--rsm n] [--dim n] [--steps n] [--k 1,2,4,8] [--threads n] [--tolerance value]\n";
+		return 2;
+	}
+
+	struct Box
+	{
+		float mMin[3];
+		float mMax[3];
+		float mAlbedo[3];
+	};
+
+	// Closest hit of the ray with the boxes, false if it misses all of them
+	bool Trace(const std::vector<Box>& boxes, const float origin[3], const float direction[3], LPVEngine::VPL& hit)
+	{
+		float closest = 1e30f;
+		bool found = false;
+		for (const Box& box : boxes)
+		{
+			float tNear = -1e30f, tFar = 1e30f;
+			int axis = 0;
+			float sign = 0.0f;
+			bool missed = false;
+			for (int i = 0; i < 3 && !missed; i++)
+			{
+				if (std::fabs(direction[i]) < 1e-8f)
+				{
+					missed = origin[i] < box.mMin[i] || origin[i] > box.mMax[i];
+					continue;
+				}
+				float t0 = (box.mMin[i] - origin[i]) / direction[i];
+				float t1 = (box.mMax[i] - origin[i]) / direction[i];
+				float entrySign = -1.0f;
+				if (t0 > t1)
+				{
+					std::swap(t0, t1);
+					entrySign = 1.0f;
+				}
+				if (t0 > tNear)
+				{
+					tNear = t0;
+					axis = i;
+					sign = entrySign;
+				}
+				tFar = std::min(tFar, t1);
+				missed = tNear > tFar;
+			}
+			if (missed || tNear < 0.0f || tNear >= closest)
+				continue;
+
+			closest = tNear;
+			found = true;
+			for (int i = 0; i < 3; i++)
+			{
+				hit.mPosition[i] = origin[i] + direction[i] * tNear;
+				hit.mNormal[i] = 0.0f;
+				hit.mFlux[i] = box.mAlbedo[i];
+			}
+			hit.mNormal[axis] = sign;
+		}
+		return found;
+	}
+
+	// The texels of an orthographic RSM looking along -lightDir over the volume
+	std::vector<LPVEngine::VPL> RenderRSM(uint32_t size, float extent, const float lightDir[3], const float lightColor[3])
+	{
+		const std::vector<Box> boxes =
+		{
+			{ { -extent, -extent, -extent }, { extent, -0.9f * extent, extent }, { 0.8f, 0.8f, 0.8f } },                         // floor
+			{ { -extent, -0.9f * extent, -extent }, { -0.9f * extent, 0.4f * extent, extent }, { 0.8f, 0.1f, 0.1f } },          // red wall
+			{ { -extent, -0.9f * extent, -extent }, { extent, 0.4f * extent, -0.9f * extent }, { 0.1f, 0.7f, 0.1f } },          // green wall
+			{ { -0.4f * extent, -0.9f * extent, -0.3f * extent }, { -0.1f * extent, -0.2f * extent, 0.0f }, { 0.2f, 0.3f, 0.9f } },
+			{ { 0.2f * extent, -0.9f * extent, 0.1f * extent }, { 0.6f * extent, -0.6f * extent, 0.5f * extent }, { 0.9f, 0.8f, 0.2f } },
+		};
+
+		float length = std::sqrt(lightDir[0] * lightDir[0] + lightDir[1] * lightDir[1] + lightDir[2] * lightDir[2]);
+		float toLight[3] = { lightDir[0] / length, lightDir[1] / length, lightDir[2] / length };
+		float direction[3] = { -toLight[0], -toLight[1], -toLight[2] };
+		// texel axes perpendicular to the light
+		float up[3] = { 0.0f, 0.0f, 1.0f };
+		float right[3] = { up[1] * toLight[2] - up[2] * toLight[1], up[2] * toLight[0] - up[0] * toLight[2], up[0] * toLight[1] - up[1] * toLight[0] };
+		float rightLength = std::sqrt(right[0] * right[0] + right[1] * right[1] + right[2] * right[2]);
+		for (int i = 0; i < 3; i++)
+			right[i] /= rightLength;
+		float down[3] = { toLight[1] * right[2] - toLight[2] * right[1], toLight[2] * right[0] - toLight[0] * right[2], toLight[0] * right[1] - toLight[1] * right[0] };
+
+		float halfWidth = extent * 1.8f;
+		std::vector<LPVEngine::VPL> vpls;
+		vpls.reserve(size_t(size) * size);
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				float u = ((float(x) + 0.5f) / float(size) * 2.0f - 1.0f) * halfWidth;
+				float v = ((float(y) + 0.5f) / float(size) * 2.0f - 1.0f) * halfWidth;
+				float origin[3];
+				for (int i = 0; i < 3; i++)
+					origin[i] = toLight[i] * extent * 4.0f + right[i] * u + down[i] * v;
+
+				LPVEngine::VPL vpl;
+				if (!Trace(boxes, origin, direction, vpl))
+					continue;
+				for (int i = 0; i < 3; i++)
+					vpl.mFlux[i] *= lightColor[i];
+				vpls.push_back(vpl);
+			}
+		}
+		return vpls;
+	}
+
+	// The lit texels of a captured RSM, texels nothing was rendered to have no flux
+	std::vector<LPVEngine::VPL> LoadRSM(const RSMCapture& capture)
+	{
+		std::vector<LPVEngine::VPL> vpls;
+		size_t texels = size_t(capture.mRSMSize) * capture.mRSMSize;
+		for (size_t texel = 0; texel < texels; texel++)
+		{
+			const float* flux = &capture.mRSMFlux[texel * 4];
+			if (flux[0] <= 0.0f && flux[1] <= 0.0f && flux[2] <= 0.0f)
+				continue;
+			LPVEngine::VPL vpl;
+			for (int i = 0; i < 3; i++)
+			{
+				vpl.mPosition[i] = capture.mRSMPositions[texel * 4 + i];
+				vpl.mNormal[i] = capture.mRSMNormals[texel * 4 + i];
+				vpl.mFlux[i] = flux[i];
+			}
+			vpls.push_back(vpl);
+		}
+		return vpls;
+	}
+
+	// Sum of the absolute differences relative to the sum of the absolute values of the reference
+	double RelativeError(const LPVEngine& reference, const LPVEngine& engine, bool accumulation)
+	{
+		double difference = 0.0;
+		double total = 0.0;
+		size_t count = size_t(reference.GetCellCount()) * 4;
+		for (int channel = 0; channel < LPVEngine::CHANNEL_COUNT; channel++)
+		{
+			LPVEngine::Channel c = LPVEngine::Channel(channel);
+			const float* a = accumulation ? reference.GetAccumulation(c) : reference.GetGrid(c);
+			const float* b = accumulation ? engine.GetAccumulation(c) : engine.GetGrid(c);
+			for (size_t i = 0; i < count; i++)
+			{
+				difference += std::fabs(double(a[i]) - double(b[i]));
+				total += std::fabs(double(a[i]));
+			}
+		}
+		return total > 0.0 ? difference / total : difference;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string capturePath;
+	bool synthetic = false;
+	uint32_t rsmSize = 2048;
+	uint32_t dim = 32;
+	uint32_t steps = 50;
+	std::vector<uint32_t> ks = { 1, 2, 4, 8 };
+	uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+	double tolerance = 0.05;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--capture" && hasValue)
+			capturePath = argv[++i];
+		else if (arg == "--synthetic")
+			synthetic = true;
+		else if (arg == "--rsm" && hasValue)
+			rsmSize = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--dim" && hasValue)
+			dim = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--steps" && hasValue)
+			steps = uint32_t(std::max(std::atoi(argv[++i]), 0));
+		else if (arg == "--k" && hasValue)
+		{
+			ks.clear();
+			std::stringstream list(argv[++i]);
+			std::string item;
+			while (std::getline(list, item, ','))
+			{
+				int k = std::atoi(item.c_str());
+				if (k <= 0)
+					return Usage();
+				ks.push_back(uint32_t(k));
+			}
+		}
+		else if (arg == "--threads" && hasValue)
+			threads = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--tolerance" && hasValue)
+			tolerance = std::atof(argv[++i]);
+		else
+			return Usage();
+	}
+	if (ks.empty())
+		return Usage();
+
+	if (capturePath.empty() && !synthetic)
+	{
+		std::filesystem::path scene = FindRepoRoot(argv[0]) / "profiling" / "rsm_capture.bin";
+		std::error_code exists;
+		if (std::filesystem::is_regular_file(scene, exists))
+			capturePath = scene.string();
+	}
+	else if (synthetic)
+		capturePath.clear();
+
+	std::vector<LPVEngine::VPL> vpls;
+	if (!capturePath.empty())
+	{
+		RSMCapture capture;
+		std::string error;
+		if (!capture.Load(capturePath, error))
+		{
+			std::cerr << error << "\n";
+			return 2;
+		}
+		rsmSize = capture.mRSMSize;
+		vpls = LoadRSM(capture);
+	}
+	else
+	{
+		// DXRSExampleGIScene defaults: mDirectionalLightDir, mDirectionalLightColor * mDirectionalLightIntensity
+		const float lightDir[3] = { 0.191f, 1.0f, 0.574f };
+		const float lightColor[3] = { 0.9f * 3.0f, 0.9f * 3.0f, 0.9f * 3.0f };
+		float extent = float(dim / 2) / LPVEngine::LPV_SCALE;
+		vpls = RenderRSM(rsmSize, extent, lightDir, lightColor);
+	}
+
+	LPVEngine full(dim);
+	full.SetThreadCount(threads);
+	full.Inject(vpls, true);
+	LPVEngine injected = full;
+	full.Propagate(steps);
+
+	std::printf("%s: %ux%u RSM, %zu VPLs, %u^3 volume, %u steps\n\n", capturePath.empty() ? "synthetic" : capturePath.c_str(),
+		rsmSize, rsmSize, vpls.size(), dim, steps);
+	std::printf("%-8s %12s %10s %12s %14s %16s\n", "K", "Points", "Reduction", "Time", "Injected error", "Propagated error");
+
+	auto report = [&](const char* name, size_t points, double ms, LPVEngine& engine)
+	{
+		double injectedError = RelativeError(injected, engine, false);
+		engine.Propagate(steps);
+		double propagatedError = RelativeError(full, engine, true);
+		std::printf("%-8s %12zu %9.1fx %9.2f ms %14.4g %16.4g\n", name, points, points > 0 ? double(vpls.size()) / double(points) : 0.0,
+			ms, injectedError, propagatedError);
+		return propagatedError;
+	};
+
+	LPVClustering clustering(1);
+	std::vector<LPVEngine::VPL> clustered;
+	double largestKError = 0.0;
+	for (uint32_t k : ks)
+	{
+		clustering.SetMaxPerCell(k);
+		Clock::time_point start = Clock::now();
+		clustering.Cluster(full, vpls, clustered);
+		double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		LPVEngine engine(dim);
+		engine.SetThreadCount(threads);
+		engine.Inject(clustered, true);
+		char name[32];
+		std::snprintf(name, sizeof(name), "%u", k);
+		double error = report(name, clustering.GetStats().mOutputCount, ms, engine);
+		if (k == *std::max_element(ks.begin(), ks.end()))
+			largestKError = error;
+	}
+	std::printf("\n%zu of %zu VPLs inside the volume, %zu occupied cells\n", clustering.GetStats().mInjectedCount, vpls.size(),
+		clustering.GetStats().mOccupiedCells);
+
+	return largestKError > tolerance ? 1 : 0;
+}
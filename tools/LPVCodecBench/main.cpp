@@ -0,0 +1,321 @@
+// Measures the storage encodings of the light propagation volume SH (LPVSHCodec) on synthetic SH fields and checks
+// their error bounds:
+//   propagated  accumulation of a CPU propagated volume (LPVEngine) lit by random VPLs, what the lighting samples
+//   lobes       one cosine lobe per cell with a log uniform flux over the whole range
+//   signed      independent coefficients of either sign with log uniform magnitudes, negative DC included
+//   edges       zero, subnormal halfs, powers of two around every limit and values beyond them
+// Per field and encoding it reports the relative RMS error of the coefficients, the largest error relative to the
+// largest coefficient of its cell and the relative error of the irradiance the lighting pass would evaluate along the
+// 6 axes. SNORM8 scaled uses the largest magnitude of the field as its scale. The shared exponent packing is not an
+// encoding the scene can render to, it is measured after them for volumes stored by the CPU. Memory is for the
+// scene volumes: 3 colour channels, a grid and an accumulation, LPV_DIM 32 and 3 cascades.
+//
+//   LPVCodecBench [--dim n] [--steps n] [--vpls n] [--flux value] [--cells n] [--seed n]
+//
+// Exits with 1 if an encoding exceeds its bound (FLOAT16 half an ulp, SNORM8 half a step of the scale, the shared
+// exponent half a step of the cell exponent) or the half conversion breaks, and 2 on bad arguments. Standalone and
+// standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o LPVCodecBench tools/LPVCodecBench/main.cpp source/LPVSHCodec.cpp source/LPVEngine.cpp source/LPVGeometryVolume.cpp source/CpuProfiler.cpp
+
+#include "../Check.h"
+#include "LPVEngine.h"
+#include "LPVSHCodec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: LPVCodecBench [--dim n] [--steps n] [--vpls n] [--flux value] [--cells n] [--seed n]\n";
+		return 2;
+	}
+
+	struct Field
+	{
+		const char* mName;
+		std::vector<float> mSH;
+	};
+
+	struct Errors
+	{
+		double mRelativeRMS = 0.0;
+		double mCellMax = 0.0;      // largest error over the largest coefficient of the cell
+		double mIrradiance = 0.0;
+		bool mWithinBound = true;
+	};
+
+	Field MakePropagated(uint32_t dim, uint32_t steps, uint32_t vplCount, float flux, std::mt19937& random)
+	{
+		float extent = float(dim / 2) / LPVEngine::LPV_SCALE;
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> albedo(0.0f, 1.0f);
+
+		std::vector<LPVEngine::VPL> vpls(vplCount);
+		for (LPVEngine::VPL& vpl : vpls)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				vpl.mPosition[i] = position(random);
+				vpl.mNormal[i] = unit(random);
+				vpl.mFlux[i] = albedo(random) * flux;
+			}
+			float length = std::sqrt(vpl.mNormal[0] * vpl.mNormal[0] + vpl.mNormal[1] * vpl.mNormal[1] + vpl.mNormal[2] * vpl.mNormal[2]);
+			for (int i = 0; i < 3; i++)
+				vpl.mNormal[i] = length > 0.0f ? vpl.mNormal[i] / length : (i == 1 ? 1.0f : 0.0f);
+		}
+
+		LPVEngine engine(dim);
+		engine.Inject(vpls);
+		engine.Propagate(steps);
+		const float* accumulation = engine.GetAccumulation(LPVEngine::CHANNEL_RED);
+		return { "propagated", std::vector<float>(accumulation, accumulation + size_t(engine.GetCellCount()) * 4) };
+	}
+
+	Field MakeLobes(uint32_t cells, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> exponent(-4.0f, 2.0f);
+		Field field = { "lobes", std::vector<float>(size_t(cells) * 4) };
+		for (uint32_t cell = 0; cell < cells; cell++)
+		{
+			float direction[3] = { unit(random), unit(random), unit(random) };
+			float length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+			if (!(length > 0.0f))
+				continue;
+			for (int i = 0; i < 3; i++)
+				direction[i] /= length;
+			float lobe[4];
+			LPVEngine::DirCosLobeToSH(direction, lobe);
+			float flux = std::pow(10.0f, exponent(random));
+			for (int i = 0; i < 4; i++)
+				field.mSH[size_t(cell) * 4 + i] = lobe[i] * flux / LPVEngine::PI;
+		}
+		return field;
+	}
+
+	Field MakeSigned(uint32_t cells, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> exponent(-4.0f, 2.0f);
+		std::bernoulli_distribution negative(0.5);
+		Field field = { "signed", std::vector<float>(size_t(cells) * 4) };
+		for (float& coefficient : field.mSH)
+			coefficient = (negative(random) ? -1.0f : 1.0f) * std::pow(10.0f, exponent(random));
+		return field;
+	}
+
+	Field MakeEdges()
+	{
+		const float values[] = {
+			0.0f, std::ldexp(1.0f, -24), std::ldexp(1.0f, -14), std::ldexp(1.0f, -9), std::ldexp(1.0f, -8), 1e-3f,
+			1.0f / 255.0f, 0.5f, 1.0f, 1.0f + 1.0f / 1024.0f, 2.0f, 127.0f, 128.0f, 200.0f, 1000.0f, 65504.0f, 1e5f,
+		};
+		Field field = { "edges", {} };
+		for (float value : values)
+		{
+			// alone, with either sign, and next to larger coefficients of the other band
+			for (float sign : { 1.0f, -1.0f })
+			{
+				const float cells[3][4] = {
+					{ sign * value, 0.0f, 0.0f, 0.0f },
+					{ 0.0f, sign * value, -sign * value, sign * value },
+					{ 1.0f, sign * value, 0.5f, -0.25f },
+				};
+				for (const float* cell : cells)
+					field.mSH.insert(field.mSH.end(), cell, cell + 4);
+			}
+		}
+		return field;
+	}
+
+	// The encodings, then the shared exponent packing
+	const int ROW_SHARED_EXPONENT = LPVSHCodec::ENCODING_COUNT;
+	const int ROW_COUNT = ROW_SHARED_EXPONENT + 1;
+
+	// Largest error the row promises for a coefficient of the cell, negative if it promises nothing
+	double Bound(int row, const float* cell, int i, float scale)
+	{
+		float magnitude = std::fabs(cell[i]);
+		if (row == ROW_SHARED_EXPONENT)
+		{
+			float largest = std::max(std::max(std::fabs(cell[0]), std::fabs(cell[1])), std::max(std::fabs(cell[2]), std::fabs(cell[3])));
+			float maximum = std::ldexp(1.0f, LPVSHCodec::SHARED_EXPONENT_MAX - LPVSHCodec::SHARED_EXPONENT_BIAS);
+			if (largest > maximum)
+				return -1.0;
+			// the exponent is the power of two at or above the largest coefficient, at least 2^-bias
+			float range = std::max(largest, std::ldexp(1.0f, -LPVSHCodec::SHARED_EXPONENT_BIAS));
+			return double(range) / LPVSHCodec::SHARED_MANTISSA_MAX * 1.0001;
+		}
+
+		switch (LPVSHCodec::Encoding(row))
+		{
+		case LPVSHCodec::ENCODING_FLOAT16:
+			if (magnitude > LPVSHCodec::HALF_MAX)
+				return -1.0;
+			// half an ulp, constant below the smallest normal
+			return std::ldexp(1.0, std::max(int(std::floor(std::log2(std::max(magnitude, std::ldexp(1.0f, -14))))), -14) - 11);
+		case LPVSHCodec::ENCODING_SNORM8_SCALED:
+			return magnitude <= scale ? 0.5 * double(scale) / 127.0 * 1.0001 : -1.0;
+		default:
+			return -1.0;
+		}
+	}
+
+	Errors Measure(int row, const std::vector<float>& sh, float scale)
+	{
+		size_t cellCount = sh.size() / 4;
+		std::vector<float> decoded(sh.size());
+		if (row == ROW_SHARED_EXPONENT)
+		{
+			for (size_t cell = 0; cell < cellCount; cell++)
+				LPVSHCodec::UnpackSharedExponent(LPVSHCodec::PackSharedExponent(&sh[cell * 4]), &decoded[cell * 4]);
+		}
+		else
+		{
+			std::vector<uint8_t> packed;
+			LPVSHCodec::Encode(LPVSHCodec::Encoding(row), sh.data(), cellCount, scale, packed);
+			LPVSHCodec::Decode(LPVSHCodec::Encoding(row), packed.data(), cellCount, scale, decoded.data());
+		}
+
+		const float axes[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		float axisSH[6][4];
+		for (int axis = 0; axis < 6; axis++)
+			LPVEngine::DirToSH(axes[axis], axisSH[axis]);
+
+		Errors errors;
+		double squaredError = 0.0, squaredTotal = 0.0, irradianceError = 0.0, irradianceTotal = 0.0;
+		for (size_t cell = 0; cell < cellCount; cell++)
+		{
+			const float* a = &sh[cell * 4];
+			const float* b = &decoded[cell * 4];
+			double largest = 0.0, largestError = 0.0;
+			for (int i = 0; i < 4; i++)
+			{
+				double error = std::fabs(double(a[i]) - double(b[i]));
+				squaredError += error * error;
+				squaredTotal += double(a[i]) * double(a[i]);
+				largest = std::max(largest, std::fabs(double(a[i])));
+				largestError = std::max(largestError, error);
+
+				double bound = Bound(row, a, i, scale);
+				if (bound >= 0.0 && error > bound)
+					errors.mWithinBound = false;
+			}
+			if (largest > 0.0)
+				errors.mCellMax = std::max(errors.mCellMax, largestError / largest);
+
+			// like the lighting pass: max(0, dot(SH of the direction, coefficients))
+			for (int axis = 0; axis < 6; axis++)
+			{
+				double reference = 0.0, value = 0.0;
+				for (int i = 0; i < 4; i++)
+				{
+					reference += double(axisSH[axis][i]) * a[i];
+					value += double(axisSH[axis][i]) * b[i];
+				}
+				reference = std::max(reference, 0.0);
+				value = std::max(value, 0.0);
+				irradianceError += std::fabs(reference - value);
+				irradianceTotal += reference;
+			}
+		}
+		errors.mRelativeRMS = squaredTotal > 0.0 ? std::sqrt(squaredError / squaredTotal) : std::sqrt(squaredError);
+		errors.mIrradiance = irradianceTotal > 0.0 ? irradianceError / irradianceTotal : irradianceError;
+		return errors;
+	}
+
+	bool Check(const char* name, bool passed)
+	{
+		PrintCheck(name, "", passed ? "ok" : "FAILED");
+		return passed;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t dim = 32;
+	uint32_t steps = 50;
+	uint32_t vpls = 4096;
+	float flux = 2.7f;
+	uint32_t cells = 1 << 16;
+	uint32_t seed = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--dim" && hasValue)
+			dim = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--steps" && hasValue)
+			steps = uint32_t(std::max(std::atoi(argv[++i]), 0));
+		else if (arg == "--vpls" && hasValue)
+			vpls = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--flux" && hasValue)
+			flux = float(std::atof(argv[++i]));
+		else if (arg == "--cells" && hasValue)
+			cells = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--seed" && hasValue)
+			seed = uint32_t(std::atoi(argv[++i]));
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+
+	// every half survives the way back, the conversion rounds to nearest even
+	{
+		bool roundTrip = true;
+		for (uint32_t bits = 0; bits < 0x10000; bits++)
+		{
+			float value = LPVSHCodec::HalfToFloat(uint16_t(bits));
+			if (std::isnan(value) || std::isinf(value))
+				continue;
+			roundTrip &= LPVSHCodec::FloatToHalf(value) == uint16_t(bits);
+		}
+		passed &= Check("every finite half converts back to itself", roundTrip);
+
+		const struct { float mValue; uint16_t mHalf; } known[] = {
+			{ 1.0f, 0x3C00 }, { -2.0f, 0xC000 }, { 0.1f, 0x2E66 }, { 65504.0f, 0x7BFF }, { 1e6f, 0x7BFF },
+			{ std::ldexp(1.0f, -24), 0x0001 }, { std::ldexp(1.0f, -26), 0x0000 }, { 1.0f + std::ldexp(1.0f, -11), 0x3C00 },
+			{ 1.0f + 3.0f * std::ldexp(1.0f, -11), 0x3C02 }, { std::ldexp(1023.5f, -24), 0x0400 },
+		};
+		bool matches = true;
+		for (const auto& entry : known)
+			matches &= LPVSHCodec::FloatToHalf(entry.mValue) == entry.mHalf;
+		passed &= Check("half conversion of known values, ties to even", matches);
+	}
+
+	std::mt19937 random(seed);
+	std::vector<Field> fields;
+	fields.push_back(MakePropagated(dim, steps, vpls, flux, random));
+	fields.push_back(MakeLobes(cells, random));
+	fields.push_back(MakeSigned(cells, random));
+	fields.push_back(MakeEdges());
+
+	const double sceneCells = 32.0 * 32.0 * 32.0 * 3.0;
+	for (const Field& field : fields)
+	{
+		float scale = LPVSHCodec::FindScale(field.mSH.data(), field.mSH.size());
+		std::printf("\n%s: %zu cells, largest coefficient %g\n", field.mName, field.mSH.size() / 4, scale);
+		std::printf("%-16s %6s %9s %14s %14s %14s %8s\n", "Encoding", "Bytes", "Scene MB", "Relative RMS", "Cell max", "Irradiance", "Bound");
+		for (int row = 0; row < ROW_COUNT; row++)
+		{
+			Errors errors = Measure(row, field.mSH, scale);
+			bool sharedExponent = row == ROW_SHARED_EXPONENT;
+			uint32_t bytes = sharedExponent ? 4 : LPVSHCodec::GetBytesPerCell(LPVSHCodec::Encoding(row));
+			// UNORM8 promises nothing, it is the baseline
+			const char* bound = row == LPVSHCodec::ENCODING_UNORM8 ? "-" : (errors.mWithinBound ? "ok" : "FAILED");
+			std::printf("%-16s %6u %9.2f %14.4g %14.4g %14.4g %8s\n", sharedExponent ? "Shared exp (CPU)" : LPVSHCodec::GetName(LPVSHCodec::Encoding(row)),
+				bytes, sceneCells * 3.0 * 2.0 * bytes / (1024.0 * 1024.0), errors.mRelativeRMS, errors.mCellMax, errors.mIrradiance, bound);
+			passed &= errors.mWithinBound || row == LPVSHCodec::ENCODING_UNORM8;
+		}
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,261 @@
+// Checks the geometry volume occlusion of the CPU light propagation volume (LPVGeometryVolume) on simple occluders:
+// a wall facing the light, the same wall facing away, a wall with a hole, a closed box and the coverage of single
+// quads, plus the optimized propagation against the line by line port of the shader with occlusion.
+// The light is a sheet of VPLs on the left of the volume facing +x; occluders stand in the middle.
+//
+//   LPVOcclusionCheck [--dim n] [--steps n]
+//
+// Prints a line per check and exits with 1 if any fails and 2 on bad arguments. Standalone and standard library
+// only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o LPVOcclusionCheck tools/LPVOcclusionCheck/main.cpp source/LPVGeometryVolume.cpp source/LPVEngine.cpp source/CpuProfiler.cpp
+
+#include "../Check.h"
+#include "LPVEngine.h"
+#include "LPVGeometryVolume.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: LPVOcclusionCheck [--dim n] [--steps n]\n";
+		return 2;
+	}
+
+	// Two triangles facing cross(u, v), or normal if given
+	void AddQuad(LPVGeometryVolume& volume, const float origin[3], const float u[3], const float v[3], const float* normal = nullptr)
+	{
+		float normals[12];
+		for (int i = 0; i < 12; i++)
+			normals[i] = normal ? normal[i % 3] : 0.0f;
+		float positions[12];
+		for (int i = 0; i < 3; i++)
+		{
+			positions[i] = origin[i];
+			positions[3 + i] = origin[i] + u[i];
+			positions[6 + i] = origin[i] + u[i] + v[i];
+			positions[9 + i] = origin[i] + v[i];
+		}
+		const uint32_t indices[6] = { 0, 1, 2, 0, 2, 3 };
+		volume.AddMesh(positions, normal ? normals : nullptr, 4, indices, 6);
+	}
+
+	// Axis aligned box with outward faces
+	void AddBox(LPVGeometryVolume& volume, const float minimum[3], const float maximum[3])
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			int a = (axis + 1) % 3, b = (axis + 2) % 3;
+			float u[3] = {}, v[3] = {};
+			u[a] = maximum[a] - minimum[a];
+			v[b] = maximum[b] - minimum[b];
+			// cross(u, v) points along +axis, cross(v, u) along -axis
+			float origin[3] = { minimum[0], minimum[1], minimum[2] };
+			origin[axis] = maximum[axis];
+			AddQuad(volume, origin, u, v);
+			origin[axis] = minimum[axis];
+			AddQuad(volume, origin, v, u);
+		}
+	}
+
+	std::vector<LPVEngine::VPL> MakeLight(uint32_t dim, float extent)
+	{
+		std::vector<LPVEngine::VPL> vpls;
+		float cellSize = 1.0f / LPVEngine::LPV_SCALE;
+		for (uint32_t y = 0; y < dim; y++)
+		{
+			for (uint32_t z = 0; z < dim; z++)
+			{
+				LPVEngine::VPL vpl = {};
+				vpl.mPosition[0] = -extent + 2.5f * cellSize;
+				vpl.mPosition[1] = -extent + (float(y) + 0.5f) * cellSize;
+				vpl.mPosition[2] = -extent + (float(z) + 0.5f) * cellSize;
+				vpl.mNormal[0] = 1.0f;
+				vpl.mFlux[0] = vpl.mFlux[1] = vpl.mFlux[2] = 1.0f;
+				vpls.push_back(vpl);
+			}
+		}
+		return vpls;
+	}
+
+	// Accumulated DC of the cells in the x range, all channels
+	double Energy(const LPVEngine& engine, uint32_t xBegin, uint32_t xEnd, uint32_t yzBegin = 0, uint32_t yzEnd = ~0u)
+	{
+		uint32_t dim = engine.GetDim();
+		yzEnd = std::min(yzEnd, dim);
+		double energy = 0.0;
+		for (int channel = 0; channel < LPVEngine::CHANNEL_COUNT; channel++)
+		{
+			const float* accumulation = engine.GetAccumulation(LPVEngine::Channel(channel));
+			for (uint32_t z = yzBegin; z < yzEnd; z++)
+				for (uint32_t y = yzBegin; y < yzEnd; y++)
+					for (uint32_t x = xBegin; x < std::min(xEnd, dim); x++)
+						energy += accumulation[((size_t(z) * dim + y) * dim + x) * 4];
+		}
+		return energy;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t dim = 16;
+	uint32_t steps = 32;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--dim" && hasValue)
+			dim = uint32_t(std::max(std::atoi(argv[++i]), 8));
+		else if (arg == "--steps" && hasValue)
+			steps = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else
+			return Usage();
+	}
+
+	const float cellSize = 1.0f / LPVEngine::LPV_SCALE;
+	const float extent = float(dim / 2) * cellSize;
+	const uint32_t wallCell = dim / 2;
+	const float wallX = 0.5f * cellSize;   // inside cell dim / 2
+	std::vector<LPVEngine::VPL> light = MakeLight(dim, extent);
+
+	auto propagate = [&](const LPVGeometryVolume* volume, bool reference) {
+		LPVEngine engine(dim);
+		engine.SetGeometryVolume(volume);
+		engine.Inject(light, true);
+		if (reference)
+			engine.PropagateReference(steps);
+		else
+			engine.Propagate(steps);
+		return engine;
+	};
+
+	LPVEngine open = propagate(nullptr, false);
+	double openBehind = Energy(open, wallCell + 1, dim);
+	bool passed = true;
+
+	// nothing to occlude
+	{
+		LPVGeometryVolume volume(dim);
+		LPVEngine engine = propagate(&volume, false);
+		float error = 0.0f;
+		for (int channel = 0; channel < LPVEngine::CHANNEL_COUNT; channel++)
+			error = std::max(error, LPVEngine::MaxRelativeError(open.GetAccumulation(LPVEngine::Channel(channel)),
+				engine.GetAccumulation(LPVEngine::Channel(channel)), size_t(dim) * dim * dim * 4));
+		passed &= Check("empty volume changes nothing", error == 0.0f, "max error %g", error);
+	}
+
+	// a wall across the volume facing the light (-x): cross(+z, +y) = -x
+	LPVGeometryVolume wall(dim);
+	{
+		float origin[3] = { wallX, -extent, -extent };
+		float u[3] = { 0.0f, 0.0f, 2.0f * extent };
+		float v[3] = { 0.0f, 2.0f * extent, 0.0f };
+		AddQuad(wall, origin, u, v);
+		int direction[3] = { 1, 0, 0 };
+		float transmittance = wall.GetTransmittance(int(wallCell) - 1, int(dim / 2), int(dim / 2), direction);
+		passed &= Check("wall facing the light is opaque", transmittance < 1e-6f, "transmittance %g", transmittance);
+
+		LPVEngine engine = propagate(&wall, false);
+		double behind = Energy(engine, wallCell + 1, dim) / openBehind;
+		passed &= Check("no light behind a wall", std::fabs(behind) < 1e-6, "%.3g of the open volume", behind);
+		double front = Energy(engine, 0, wallCell) / Energy(open, 0, wallCell);
+		passed &= Check("light in front of the wall stays", front > 0.9, "%.3g of the open volume", front);
+
+		LPVEngine reference = propagate(&wall, true);
+		float error = 0.0f;
+		for (int channel = 0; channel < LPVEngine::CHANNEL_COUNT; channel++)
+			error = std::max(error, LPVEngine::MaxRelativeError(reference.GetAccumulation(LPVEngine::Channel(channel)),
+				engine.GetAccumulation(LPVEngine::Channel(channel)), size_t(dim) * dim * dim * 4));
+		passed &= Check("occluded propagation matches the reference", error < 1e-4f, "max error %g", error);
+	}
+
+	// the same wall facing away lets the light through
+	{
+		LPVGeometryVolume volume(dim);
+		float origin[3] = { wallX, -extent, -extent };
+		float u[3] = { 0.0f, 2.0f * extent, 0.0f };
+		float v[3] = { 0.0f, 0.0f, 2.0f * extent };
+		AddQuad(volume, origin, u, v);
+		int direction[3] = { 1, 0, 0 };
+		float transmittance = volume.GetTransmittance(int(wallCell) - 1, int(dim / 2), int(dim / 2), direction);
+		passed &= Check("back of a wall does not block", transmittance == 1.0f, "transmittance %g", transmittance);
+
+		// light reflected back towards -x is blocked by the front, so less than the open volume arrives
+		LPVEngine engine = propagate(&volume, false);
+		double behind = Energy(engine, wallCell + 1, dim) / openBehind;
+		passed &= Check("light passes the back of a wall", behind > 0.5, "%.3g of the open volume", behind);
+	}
+
+	// the back facing winding with normals towards the light blocks like the facing wall
+	{
+		LPVGeometryVolume volume(dim);
+		float origin[3] = { wallX, -extent, -extent };
+		float u[3] = { 0.0f, 2.0f * extent, 0.0f };
+		float v[3] = { 0.0f, 0.0f, 2.0f * extent };
+		float normal[3] = { -1.0f, 0.0f, 0.0f };
+		AddQuad(volume, origin, u, v, normal);
+		int direction[3] = { 1, 0, 0 };
+		float transmittance = volume.GetTransmittance(int(wallCell) - 1, int(dim / 2), int(dim / 2), direction);
+		passed &= Check("vertex normals orient the triangles", transmittance < 1e-6f, "transmittance %g", transmittance);
+	}
+
+	// a hole of 4x4 cells in the middle of the wall
+	{
+		LPVGeometryVolume volume(dim);
+		float low = -2.0f * cellSize, high = 2.0f * cellSize;
+		const float pieces[4][4] = {
+			{ -extent, low, -extent, extent },      // y range, z range
+			{ high, extent, -extent, extent },
+			{ low, high, -extent, low },
+			{ low, high, high, extent },
+		};
+		for (const float* piece : pieces)
+		{
+			float origin[3] = { wallX, piece[0], piece[2] };
+			float u[3] = { 0.0f, 0.0f, piece[3] - piece[2] };
+			float v[3] = { 0.0f, piece[1] - piece[0], 0.0f };
+			AddQuad(volume, origin, u, v);
+		}
+		LPVEngine engine = propagate(&volume, false);
+		double behind = Energy(engine, wallCell + 1, dim) / openBehind;
+		passed &= Check("light leaks only through a hole", behind > 1e-3 && behind < 0.5, "%.3g of the open volume", behind);
+	}
+
+	// a closed box in the light keeps its inside dark
+	{
+		LPVGeometryVolume volume(dim);
+		float minimum[3] = { -2.0f * cellSize, -2.0f * cellSize, -2.0f * cellSize };
+		float maximum[3] = { 2.0f * cellSize, 2.0f * cellSize, 2.0f * cellSize };
+		AddBox(volume, minimum, maximum);
+		LPVEngine engine = propagate(&volume, false);
+		// the cells strictly inside the faces, which lie in cells dim / 2 - 2 and dim / 2 + 2
+		double inside = Energy(engine, wallCell - 1, wallCell + 2, wallCell - 1, wallCell + 2);
+		double openInside = Energy(open, wallCell - 1, wallCell + 2, wallCell - 1, wallCell + 2);
+		passed &= Check("inside of a closed box stays dark", std::fabs(inside / openInside) < 1e-6, "%.3g of the open volume", inside / openInside);
+	}
+
+	// a quad covering one cell face blocks fully, half of it half
+	{
+		for (float fraction : { 1.0f, 0.5f })
+		{
+			LPVGeometryVolume volume(dim);
+			float origin[3] = { wallX, 0.0f, 0.0f };
+			float u[3] = { 0.0f, 0.0f, cellSize * fraction };
+			float v[3] = { 0.0f, cellSize, 0.0f };
+			AddQuad(volume, origin, u, v);
+			int direction[3] = { 1, 0, 0 };
+			float transmittance = volume.GetTransmittance(int(wallCell), int(dim / 2), int(dim / 2), direction);
+			char name[64];
+			std::snprintf(name, sizeof(name), "quad covering %g of a cell blocks as much", fraction);
+			passed &= Check(name, std::fabs(transmittance - (1.0f - fraction)) < 1e-4f, "transmittance %g", transmittance);
+		}
+	}
+
+	return passed ? 0 : 1;
+}
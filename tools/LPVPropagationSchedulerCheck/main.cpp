@@ -0,0 +1,287 @@
+// Checks the frame decisions of LPVPropagationScheduler and the amortized propagation it drives on LPVEngine.
+//   schedule    the first frame restarts, later ones continue with the step budget until the step limit and then
+//               skip; a budget of 0 runs everything at once and the last budget is what remains; EndStep stops the
+//               frame at its budget and at the limit; EndSteps without energies only stops at the limit
+//   restart     a change above the threshold restarts, one at the threshold continues, a negative change, Invalidate,
+//               a lower step limit than already ran and a stricter epsilon restart, a looser one continues
+//   converge    a step adding at most epsilon times the accumulation stops early and counts as an early stop, a grid
+//               without light converges, epsilon 0 never stops early, the step limit is not an early stop
+//   engine      10 steps per frame over 5 frames give the same accumulation as Propagate(50), step energy falls like
+//               a power of the step no steeper than 1 / step (light only leaves through the border, so a relative
+//               epsilon cuts off a long tail), and an epsilon of 0.02 stops early with less accumulated light
+//   change      RelativeChange of identical, scaled and empty grids
+//
+//   LPVPropagationSchedulerCheck [--dim n] [--vpls n] [--seed n]
+//
+// --dim and --vpls size the engine run (16, 2048); smaller grids lose their light through the border within a few
+// steps, so --dim is at least 16. Prints a line per check and exits with 1 if any fails and 2 on bad arguments.
+// Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o LPVPropagationSchedulerCheck tools/LPVPropagationSchedulerCheck/main.cpp source/LPVPropagationScheduler.cpp source/LPVEngine.cpp source/LPVGeometryVolume.cpp source/CpuProfiler.cpp
+
+#include "../Check.h"
+#include "LPVEngine.h"
+#include "LPVPropagationScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	typedef LPVPropagationScheduler Scheduler;
+
+	int Usage()
+	{
+		std::cerr << "usage: LPVPropagationSchedulerCheck [--dim n] [--vpls n] [--seed n]\n";
+		return 2;
+	}
+
+	Scheduler::Settings MakeSettings(uint32_t maxSteps, uint32_t stepsPerFrame, float epsilon = 0.0f)
+	{
+		Scheduler::Settings settings;
+		settings.mMaxSteps = maxSteps;
+		settings.mStepsPerFrame = stepsPerFrame;
+		settings.mConvergenceEpsilon = epsilon;
+		return settings;
+	}
+
+	// Runs the frame's budget with constant energies, returns the steps it ran
+	uint32_t RunFrame(Scheduler& scheduler, double stepEnergy = 1.0, double accumulatedEnergy = 1.0)
+	{
+		uint32_t steps = 0;
+		while (steps < scheduler.GetStepBudget())
+		{
+			steps++;
+			if (!scheduler.EndStep(stepEnergy, accumulatedEnergy))
+				break;
+		}
+		return steps;
+	}
+
+	// VPLs on the floor of the volume facing up
+	std::vector<LPVEngine::VPL> MakeVPLs(uint32_t dim, uint32_t count, uint32_t seed)
+	{
+		std::mt19937 random(seed);
+		float extent = float(dim / 2) / LPVEngine::LPV_SCALE;
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> flux(0.0f, 1.0f);
+		std::vector<LPVEngine::VPL> vpls(count);
+		for (LPVEngine::VPL& vpl : vpls)
+		{
+			vpl.mPosition[0] = position(random);
+			vpl.mPosition[1] = -0.9f * extent;
+			vpl.mPosition[2] = position(random);
+			vpl.mNormal[0] = vpl.mNormal[2] = 0.0f;
+			vpl.mNormal[1] = 1.0f;
+			for (float& channel : vpl.mFlux)
+				channel = flux(random);
+		}
+		return vpls;
+	}
+
+	float AccumulationError(const LPVEngine& a, const LPVEngine& b)
+	{
+		float error = 0.0f;
+		for (int channel = 0; channel < LPVEngine::CHANNEL_COUNT; channel++)
+			error = std::max(error, LPVEngine::MaxRelativeError(a.GetAccumulation(LPVEngine::Channel(channel)),
+				b.GetAccumulation(LPVEngine::Channel(channel)), size_t(a.GetCellCount()) * 4));
+		return error;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t dim = 16;
+	uint32_t vplCount = 2048;
+	uint32_t seed = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--dim" && hasValue)
+			dim = uint32_t(std::max(std::atoi(argv[++i]), 16));
+		else if (arg == "--vpls" && hasValue)
+			vplCount = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--seed" && hasValue)
+			seed = uint32_t(std::atoi(argv[++i]));
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+
+	{
+		Scheduler scheduler(MakeSettings(50, 10));
+		std::vector<Scheduler::Action> actions;
+		std::vector<uint32_t> steps;
+		for (int frame = 0; frame < 8; frame++)
+		{
+			actions.push_back(scheduler.BeginFrame(0.0f));
+			steps.push_back(RunFrame(scheduler));
+		}
+		bool order = actions[0] == Scheduler::ACTION_RESTART && actions[1] == Scheduler::ACTION_CONTINUE && actions[4] == Scheduler::ACTION_CONTINUE &&
+			actions[5] == Scheduler::ACTION_SKIP && actions[7] == Scheduler::ACTION_SKIP && steps == std::vector<uint32_t>{ 10, 10, 10, 10, 10, 0, 0, 0 };
+		const Scheduler::Stats& stats = scheduler.GetStats();
+		bool counted = stats.mFrames == 8 && stats.mRestarts == 1 && stats.mSkippedFrames == 3 && stats.mSteps == 50 && stats.GetSavedSteps(50) == 350;
+		passed &= Check("schedule: restart, continue, then skip", order && scheduler.IsDone() && !scheduler.IsConverged(), "%.0f steps", double(stats.mSteps));
+		passed &= Check("schedule: stats count frames and steps", counted, "%.0f saved", double(stats.GetSavedSteps(50)));
+
+		Scheduler all(MakeSettings(50, 0));
+		all.BeginFrame(-1.0f);
+		uint32_t allSteps = RunFrame(all);
+		passed &= Check("schedule: a budget of 0 runs every step", all.GetStepBudget() == 50 && allSteps == 50 && all.IsDone(), "%.0f steps", double(allSteps));
+
+		Scheduler remainder(MakeSettings(45, 10));
+		std::vector<uint32_t> budgets;
+		for (int frame = 0; frame < 6; frame++)
+		{
+			remainder.BeginFrame(0.0f);
+			budgets.push_back(remainder.GetStepBudget());
+			RunFrame(remainder);
+		}
+		passed &= Check("schedule: the last budget is the remainder", budgets == std::vector<uint32_t>{ 10, 10, 10, 10, 5, 0 }, "%.0f last", double(budgets[4]));
+
+		Scheduler gpu(MakeSettings(50, 20, 0.5f));
+		gpu.BeginFrame(0.0f);
+		gpu.EndSteps(20);
+		bool running = !gpu.IsDone();
+		gpu.BeginFrame(0.0f);
+		gpu.EndSteps(20);
+		gpu.BeginFrame(0.0f);
+		uint32_t lastBudget = gpu.GetStepBudget();
+		gpu.EndSteps(lastBudget);
+		passed &= Check("schedule: EndSteps stops only at the limit", running && lastBudget == 10 && gpu.IsDone() && !gpu.IsConverged() &&
+			gpu.GetCompletedSteps() == 50, "%.0f steps", double(gpu.GetCompletedSteps()));
+	}
+
+	{
+		Scheduler scheduler(MakeSettings(50, 10));
+		scheduler.BeginFrame(0.0f);
+		RunFrame(scheduler);
+		int decisions = 0;
+		decisions += scheduler.BeginFrame(0.01f) == Scheduler::ACTION_CONTINUE;
+		decisions += scheduler.BeginFrame(0.0101f) == Scheduler::ACTION_RESTART && scheduler.GetCompletedSteps() == 0;
+		RunFrame(scheduler);
+		decisions += scheduler.BeginFrame(-1.0f) == Scheduler::ACTION_RESTART;
+		passed &= Check("restart: only above the threshold", decisions == 3, "%.0f of 3", double(decisions));
+
+		int restarts = 0;
+		RunFrame(scheduler);
+		scheduler.Invalidate();
+		restarts += scheduler.BeginFrame(0.0f) == Scheduler::ACTION_RESTART;
+		RunFrame(scheduler);
+		RunFrame(scheduler);
+		scheduler.SetSettings(MakeSettings(5, 10));
+		restarts += scheduler.BeginFrame(0.0f) == Scheduler::ACTION_RESTART;
+		scheduler.SetSettings(MakeSettings(50, 10, 0.05f));
+		RunFrame(scheduler);
+		scheduler.SetSettings(MakeSettings(50, 10, 0.01f));
+		restarts += scheduler.BeginFrame(0.0f) == Scheduler::ACTION_RESTART;
+		RunFrame(scheduler);
+		scheduler.SetSettings(MakeSettings(60, 10, 0.02f));
+		restarts += scheduler.BeginFrame(0.0f) == Scheduler::ACTION_CONTINUE && scheduler.GetCompletedSteps() == 10;
+		passed &= Check("restart: invalidation and stricter settings", restarts == 4, "%.0f of 4", double(restarts));
+
+		Scheduler extended(MakeSettings(20, 0));
+		extended.BeginFrame(0.0f);
+		RunFrame(extended);
+		extended.SetSettings(MakeSettings(30, 0));
+		bool continued = extended.BeginFrame(0.0f) == Scheduler::ACTION_CONTINUE && extended.GetStepBudget() == 10;
+		passed &= Check("restart: a higher limit continues", continued, "%.0f budget", double(extended.GetStepBudget()));
+	}
+
+	{
+		Scheduler scheduler(MakeSettings(50, 10, 0.1f));
+		scheduler.BeginFrame(0.0f);
+		uint32_t first = RunFrame(scheduler, 1.0, 5.0);
+		// 1 is above 0.1 times 5 and goes on, 0.5 is not and stops the frame
+		bool stopped = scheduler.BeginFrame(0.0f) == Scheduler::ACTION_CONTINUE && scheduler.EndStep(1.0, 5.0) && !scheduler.EndStep(0.5, 5.0);
+		bool early = first == 10 && stopped && scheduler.IsConverged() && scheduler.IsDone() && scheduler.GetCompletedSteps() == 12 &&
+			scheduler.GetStats().mEarlyStops == 1 && scheduler.BeginFrame(0.0f) == Scheduler::ACTION_SKIP;
+		passed &= Check("converge: a small step stops early", early, "%.0f steps", double(scheduler.GetCompletedSteps()));
+
+		Scheduler dark(MakeSettings(50, 10, 0.1f));
+		dark.BeginFrame(0.0f);
+		uint32_t darkSteps = RunFrame(dark, 0.0, 0.0);
+		Scheduler never(MakeSettings(50, 0, 0.0f));
+		never.BeginFrame(0.0f);
+		uint32_t neverSteps = RunFrame(never, 0.0, 0.0);
+		passed &= Check("converge: dark grids, epsilon 0", darkSteps == 1 && dark.IsConverged() && neverSteps == 50 && !never.IsConverged(),
+			"%.0f dark steps", double(darkSteps));
+
+		Scheduler limit(MakeSettings(3, 0, 0.5f));
+		limit.BeginFrame(0.0f);
+		limit.EndStep(1.0, 1.0);
+		limit.EndStep(1.0, 1.0);
+		limit.EndStep(0.0, 1.0);
+		passed &= Check("converge: the limit is not an early stop", limit.IsDone() && !limit.IsConverged() && limit.GetStats().mEarlyStops == 0,
+			"%.0f early stops", double(limit.GetStats().mEarlyStops));
+	}
+
+	{
+		std::vector<LPVEngine::VPL> vpls = MakeVPLs(dim, vplCount, seed);
+		LPVEngine full(dim);
+		full.Inject(vpls);
+		full.Propagate(50);
+
+		LPVEngine amortized(dim);
+		Scheduler scheduler(MakeSettings(50, 10));
+		uint32_t frames = 0;
+		std::vector<double> stepEnergies;
+		for (; frames < 10 && scheduler.BeginFrame(0.0f) != Scheduler::ACTION_SKIP; frames++)
+		{
+			if (scheduler.GetAction() == Scheduler::ACTION_RESTART)
+			{
+				amortized.Clear();
+				amortized.Inject(vpls);
+			}
+			for (uint32_t step = 0; step < scheduler.GetStepBudget(); step++)
+			{
+				amortized.PropagateSteps(1);
+				stepEnergies.push_back(amortized.GetEnergy());
+				if (!scheduler.EndStep(amortized.GetEnergy(), amortized.GetAccumulatedEnergy()))
+					break;
+			}
+		}
+		float error = AccumulationError(full, amortized);
+		passed &= Check("engine: 5 frames of 10 equal Propagate(50)", frames == 5 && stepEnergies.size() == 50 && error < 1e-4f, "%.2g error", error);
+
+		// energy ~ step^-p between steps 10 and 40; p is about 0.7 at 16^3 and 0.45 at 32^3
+		double decay = stepEnergies.size() == 50 ? std::log(stepEnergies[9] / stepEnergies[39]) / std::log(4.0) : 0.0;
+		passed &= Check("engine: step energy decays slowly", decay > 0.2 && decay < 1.0, "step^-%.2f", decay);
+
+		LPVEngine early(dim);
+		Scheduler converging(MakeSettings(50, 0, 0.02f));
+		converging.BeginFrame(-1.0f);
+		early.Inject(vpls);
+		for (uint32_t step = 0; step < converging.GetStepBudget(); step++)
+		{
+			early.PropagateSteps(1);
+			if (!converging.EndStep(early.GetEnergy(), early.GetAccumulatedEnergy()))
+				break;
+		}
+		double shortfall = 1.0 - early.GetAccumulatedEnergy() / full.GetAccumulatedEnergy();
+		passed &= Check("engine: epsilon 0.02 stops early", converging.IsConverged() && converging.GetCompletedSteps() < 50 && shortfall > 0.0,
+			"%.0f steps", double(converging.GetCompletedSteps()));
+		std::printf("    epsilon 0.02 stops after %u of 50 steps, %.1f%% of the accumulated energy short\n", converging.GetCompletedSteps(), 100.0 * shortfall);
+	}
+
+	{
+		std::vector<float> reference = { 1.0f, -2.0f, 3.0f, 0.0f };
+		std::vector<float> scaled = { 1.5f, -3.0f, 4.5f, 0.0f };
+		std::vector<float> zero(4, 0.0f);
+		int changes = 0;
+		changes += Scheduler::RelativeChange(reference.data(), reference.data(), 4) == 0.0f;
+		changes += std::fabs(Scheduler::RelativeChange(reference.data(), scaled.data(), 4) - 0.5f) < 1e-6f;
+		changes += Scheduler::RelativeChange(zero.data(), reference.data(), 4) == 1.0f;
+		changes += Scheduler::RelativeChange(zero.data(), zero.data(), 4) == 0.0f;
+		passed &= Check("change: identical, scaled and empty grids", changes == 4, "%.0f of 4", double(changes));
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,304 @@
+// Checks the on-disk pipeline cache (PipelineStateCache) the way PSO::Finalize uses it, against a mock device that
+// counts full compiles and creates from a cached blob. Blobs carry the driver version and the description hash, and
+// the mock rejects blobs of another driver like a real one does:
+//   cold       an empty cache compiles every pipeline and stores its blob
+//   warm       the saved cache is loaded on the next start and every pipeline is created from its blob
+//   changed    a new or edited pipeline compiles on its own, the others still come from the cache
+//   driver     blobs of another driver are rejected, dropped and replaced by fresh ones
+//   file       truncated, foreign or missing files load nothing and leave the cache as it was
+//   shared     the SharedObjectMap the PSO and root signature hash maps use creates a pipeline finalized by many
+//              threads at once once, hands a failed creation to every waiting thread and lets the next Finalize
+//              retry, and an evicted pipeline is created again while the PSOs holding it keep theirs
+//
+//   PipelineCacheCheck [--pipelines n]
+//
+// Prints a line per check and exits with 1 if any fails and 2 on bad arguments. Standalone and standard library
+// only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o PipelineCacheCheck tools/PipelineCacheCheck/main.cpp source/PipelineStateCache.cpp
+
+#include "../Check.h"
+#include "Hash.h"
+#include "PipelineStateCache.h"
+#include "SharedObjectMap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: PipelineCacheCheck [--pipelines n]\n";
+		return 2;
+	}
+
+	// Stands in for ID3D12Device: a pipeline description is its serialized bytes, a blob is the driver version and
+	// the hash of the description it was compiled from, followed by the "compiled" code
+	class MockDevice
+	{
+	public:
+		explicit MockDevice(uint32_t driverVersion) : mDriverVersion(driverVersion) {}
+
+		void Compile(const std::string&)
+		{
+			mCompiles++;
+		}
+
+		// CreateGraphicsPipelineState with CachedPSO set, false is the E_INVALIDARG of a mismatching blob
+		bool CreateFromBlob(const std::string& desc, const void* data, size_t size)
+		{
+			std::vector<uint8_t> expected = GetCachedBlob(desc);
+			if (size != expected.size() || memcmp(data, expected.data(), size) != 0)
+			{
+				mRejected++;
+				return false;
+			}
+			mBlobCreates++;
+			return true;
+		}
+
+		std::vector<uint8_t> GetCachedBlob(const std::string& desc) const
+		{
+			uint64_t hash = Utility::HashRange(desc.data(), desc.size());
+			std::vector<uint8_t> blob(sizeof(mDriverVersion) + sizeof(hash) + 64);
+			memcpy(blob.data(), &mDriverVersion, sizeof(mDriverVersion));
+			memcpy(blob.data() + sizeof(mDriverVersion), &hash, sizeof(hash));
+			for (size_t i = sizeof(mDriverVersion) + sizeof(hash); i < blob.size(); i++)
+				blob[i] = uint8_t(hash >> (i % 8 * 8)) ^ uint8_t(mDriverVersion);
+			return blob;
+		}
+
+		uint32_t mDriverVersion;
+		uint32_t mCompiles = 0;
+		uint32_t mBlobCreates = 0;
+		uint32_t mRejected = 0;
+	};
+
+	// CreatePipelineState of PipelineStateObject.cpp with the mock in place of the device
+	void Finalize(PipelineStateCache* cache, MockDevice& device, const std::string& desc)
+	{
+		uint64_t key = Utility::HashRange(desc.data(), desc.size());
+		if (cache && cache->CreateFromBlob(key, [&](const void* blob, size_t size) { return device.CreateFromBlob(desc, blob, size); }))
+			return;
+
+		device.Compile(desc);
+
+		if (cache)
+		{
+			std::vector<uint8_t> blob = device.GetCachedBlob(desc);
+			cache->Store(key, blob.data(), blob.size());
+		}
+	}
+
+	struct Run
+	{
+		uint32_t mCompiles;
+		uint32_t mBlobCreates;
+		uint32_t mRejected;
+		uint32_t mHits;
+		uint32_t mMisses;
+		size_t mEntries;
+		bool mLoaded;
+		bool mDirty;
+	};
+
+	// One start of the app: loads the cache file, finalizes every pipeline and saves the cache when it changed
+	Run Start(const fs::path& path, uint32_t driverVersion, const std::vector<std::string>& descs)
+	{
+		PipelineStateCache cache;
+		bool loaded = cache.Load(path.wstring());
+		MockDevice device(driverVersion);
+		for (const std::string& desc : descs)
+			Finalize(&cache, device, desc);
+
+		Run run = { device.mCompiles, device.mBlobCreates, device.mRejected, cache.mHits.load(), cache.mMisses.load(),
+			cache.GetEntryCount(), loaded, cache.IsDirty() };
+		if (cache.IsDirty())
+			cache.Save(path.wstring());
+		return run;
+	}
+
+	// Stand-ins for the serialized descriptions: root signature hash, shaders and state differ per pipeline
+	std::vector<std::string> MakeDescs(uint32_t count)
+	{
+		std::vector<std::string> descs;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			std::string desc = "RS " + std::to_string(i % 7) + " VS " + std::to_string(i) + " PS " + std::to_string(i * 31 % 17);
+			desc.resize(desc.size() + 256 + i % 13, char('a' + i % 26));
+			descs.push_back(desc);
+		}
+		return descs;
+	}
+
+	// ComPtr<ID3D12PipelineState> stand-in, the use count shows who still holds a pipeline
+	typedef std::shared_ptr<uint32_t> Pipeline;
+
+	struct Shared
+	{
+		uint32_t mCreates;
+		uint32_t mSucceeded;
+		uint32_t mFailed;
+		bool mSameObject;
+	};
+
+	// threads Finalize the same description at once, the creation takes a while and throws if fail is set
+	Shared FinalizeShared(SharedObjectMap<uint64_t, Pipeline>& map, uint32_t threads, bool fail)
+	{
+		std::atomic<uint32_t> creates(0), succeeded(0), failed(0), started(0);
+		std::vector<Pipeline> results(threads);
+		std::vector<std::thread> workers;
+		for (uint32_t i = 0; i < threads; i++)
+		{
+			workers.emplace_back([&, i]() {
+				started++;
+				while (started < threads)
+					std::this_thread::yield();
+				try
+				{
+					results[i] = map.GetOrCreate(1, [&]() {
+						creates++;
+						std::this_thread::sleep_for(std::chrono::milliseconds(20));
+						if (fail)
+							throw std::runtime_error("CreateGraphicsPipelineState failed");
+						return std::make_shared<uint32_t>(creates.load());
+					});
+					succeeded++;
+				}
+				catch (const std::runtime_error&)
+				{
+					failed++;
+				}
+			});
+		}
+		for (std::thread& worker : workers)
+			worker.join();
+
+		bool same = true;
+		for (const Pipeline& result : results)
+			same = same && result == results[0];
+		return { creates.load(), succeeded.load(), failed.load(), same };
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t pipelines = 40;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--pipelines" && hasValue)
+			pipelines = uint32_t(std::max(std::atoi(argv[++i]), 2));
+		else
+			return Usage();
+	}
+
+	const fs::path directory = fs::temp_directory_path() / "PipelineCacheCheck";
+	const fs::path path = directory / "pipelines.bin";
+	std::error_code ec;
+	fs::remove_all(directory, ec);
+
+	std::vector<std::string> descs = MakeDescs(pipelines);
+	bool passed = true;
+
+	Run cold = Start(path, 1, descs);
+	passed &= Check("cold run finds no file", !cold.mLoaded, "%.0f loaded", double(cold.mLoaded));
+	passed &= Check("cold run compiles every pipeline", cold.mCompiles == pipelines && cold.mBlobCreates == 0, "%.0f compiles", double(cold.mCompiles));
+	passed &= Check("cold run counts misses", cold.mMisses == pipelines && cold.mHits == 0, "%.0f misses", double(cold.mMisses));
+	passed &= Check("cold run stores every blob", cold.mEntries == pipelines && cold.mDirty, "%.0f entries", double(cold.mEntries));
+
+	Run warm = Start(path, 1, descs);
+	passed &= Check("warm run loads the saved cache", warm.mLoaded, "%.0f entries", double(warm.mEntries));
+	passed &= Check("warm run compiles nothing", warm.mCompiles == 0, "%.0f compiles", double(warm.mCompiles));
+	passed &= Check("warm run creates every pipeline from blobs", warm.mBlobCreates == pipelines && warm.mHits == pipelines, "%.0f blob creates", double(warm.mBlobCreates));
+	passed &= Check("warm run does not rewrite the file", !warm.mDirty && warm.mMisses == 0, "%.0f misses", double(warm.mMisses));
+
+	std::vector<std::string> changed = descs;
+	changed[0] += " edited";
+	changed.push_back("RS 0 VS new PS new");
+	Run edit = Start(path, 1, changed);
+	passed &= Check("new and edited pipelines compile alone", edit.mCompiles == 2 && edit.mBlobCreates == pipelines - 1, "%.0f compiles", double(edit.mCompiles));
+	passed &= Check("their blobs are added", edit.mDirty && edit.mEntries == pipelines + 2, "%.0f entries", double(edit.mEntries));
+	Run afterEdit = Start(path, 1, changed);
+	passed &= Check("next run is warm again", afterEdit.mCompiles == 0 && afterEdit.mHits == pipelines + 1, "%.0f hits", double(afterEdit.mHits));
+
+	Run driver = Start(path, 2, descs);
+	passed &= Check("new driver rejects the old blobs", driver.mRejected == pipelines && driver.mBlobCreates == 0, "%.0f rejected", double(driver.mRejected));
+	passed &= Check("rejected pipelines compile and count misses", driver.mCompiles == pipelines && driver.mMisses == pipelines, "%.0f compiles", double(driver.mCompiles));
+	Run afterDriver = Start(path, 2, descs);
+	passed &= Check("replaced blobs are used on the next run", afterDriver.mCompiles == 0 && afterDriver.mBlobCreates == pipelines, "%.0f blob creates", double(afterDriver.mBlobCreates));
+
+	{
+		PipelineStateCache cache;
+		cache.Load(path.wstring());
+		std::vector<uint8_t> data;
+		cache.Serialize(data);
+
+		PipelineStateCache truncated;
+		truncated.Store(1, "x", 1);
+		bool rejected = !truncated.Deserialize(data.data(), data.size() - 1);
+		passed &= Check("truncated file is rejected", rejected && truncated.GetEntryCount() == 1, "%.0f entries kept", double(truncated.GetEntryCount()));
+
+		std::vector<uint8_t> foreign = data;
+		foreign[4] ^= 0xFF;
+		PipelineStateCache wrongVersion;
+		passed &= Check("other format version is rejected", !wrongVersion.Deserialize(foreign.data(), foreign.size()) && wrongVersion.GetEntryCount() == 0, "%.0f entries", double(wrongVersion.GetEntryCount()));
+
+		PipelineStateCache roundTrip;
+		std::vector<uint8_t> again;
+		bool read = roundTrip.Deserialize(data.data(), data.size());
+		roundTrip.Serialize(again);
+		passed &= Check("serialized cache round-trips", read && again == data && !roundTrip.IsDirty(), "%.0f bytes", double(data.size()));
+
+		std::ofstream(path, std::ios::binary | std::ios::trunc).write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size() / 2));
+		Run damaged = Start(path, 2, descs);
+		passed &= Check("damaged file starts cold and is rewritten", !damaged.mLoaded && damaged.mCompiles == pipelines, "%.0f compiles", double(damaged.mCompiles));
+		Run repaired = Start(path, 2, descs);
+		passed &= Check("rewritten file is warm", repaired.mLoaded && repaired.mCompiles == 0, "%.0f compiles", double(repaired.mCompiles));
+	}
+
+	{
+		MockDevice device(1);
+		for (const std::string& desc : descs)
+			Finalize(nullptr, device, desc);
+		passed &= Check("without a cache every pipeline compiles", device.mCompiles == pipelines && device.mBlobCreates == 0, "%.0f compiles", double(device.mCompiles));
+	}
+
+	{
+		const uint32_t threads = 8;
+		SharedObjectMap<uint64_t, Pipeline> map;
+		Shared failing = FinalizeShared(map, threads, true);
+		// a thread arriving after the failure retries on its own, so only most of them share the first creation
+		passed &= Check("shared: a failed creation reaches the waiters", failing.mCreates < threads && failing.mFailed == threads && map.GetSize() == 0,
+			"%.0f creates", double(failing.mCreates));
+
+		Shared shared = FinalizeShared(map, threads, false);
+		passed &= Check("shared: the next Finalize retries, once for all", shared.mCreates == 1 && shared.mSucceeded == threads && shared.mSameObject,
+			"%.0f creates", double(shared.mCreates));
+
+		Pipeline held = map.GetOrCreate(1, []() { return std::make_shared<uint32_t>(0); });
+		map.Erase(1);
+		uint32_t recreates = 0;
+		Pipeline rebuilt = map.GetOrCreate(1, [&recreates]() { recreates++; return std::make_shared<uint32_t>(0); });
+		passed &= Check("shared: evicted pipelines are created again", recreates == 1 && rebuilt != held && held.use_count() == 1,
+			"%.0f creates", double(recreates));
+	}
+
+	fs::remove_all(directory, ec);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,511 @@
+#include "NsightMetrics.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+namespace
+{
+	struct LabeledMetric
+	{
+		const char* mName;
+		const char* mLabel;
+	};
+
+	// the metrics a compute pass comparison usually starts with, in table order
+	const LabeledMetric LabeledMetrics[] =
+	{
+		{ "sm__cycles_elapsed.avg", "SM elapsed cycles" },
+		{ "sm__cycles_active.avg", "SM active cycles" },
+		{ "smsp__inst_executed_shader_cs.sum", "CS instructions" },
+		{ "sm__warps_active.avg.pct_of_peak_sustained_active", "Achieved occupancy %" },
+		{ "sm__throughput.avg.pct_of_peak_sustained_elapsed", "SM throughput %" },
+		{ "l1tex__t_sector_hit_rate.pct", "L1 hit rate %" },
+		{ "lts__t_sector_hit_rate.pct", "L2 hit rate %" },
+		{ "l1tex__throughput.avg.pct_of_peak_sustained_elapsed", "L1/TEX throughput %" },
+		{ "lts__throughput.avg.pct_of_peak_sustained_elapsed", "L2 throughput %" },
+		{ "dram__throughput.avg.pct_of_peak_sustained_elapsed", "DRAM throughput %" },
+		{ "smsp__warps_issue_stalled_long_scoreboard.avg.pct_of_peak_sustained_active", "Long scoreboard stalls %" },
+		{ "smsp__warps_issue_stalled_barrier.avg.pct_of_peak_sustained_active", "Barrier stalls %" },
+	};
+
+	std::string Trim(const std::string& text)
+	{
+		size_t begin = text.find_first_not_of(" \t\r\n");
+		if (begin == std::string::npos)
+			return std::string();
+		size_t end = text.find_last_not_of(" \t\r\n");
+		std::string trimmed = text.substr(begin, end - begin + 1);
+		if (trimmed.size() >= 2 && trimmed.front() == '"' && trimmed.back() == '"')
+			trimmed = trimmed.substr(1, trimmed.size() - 2);
+		return trimmed;
+	}
+
+	bool ParseNumber(const std::string& text, double& value)
+	{
+		if (text.empty())
+			return false;
+
+		char* end = nullptr;
+		value = std::strtod(text.c_str(), &end);
+		return end == text.c_str() + text.size() && std::isfinite(value);
+	}
+
+	bool EndsWith(const std::string& text, const std::string& suffix)
+	{
+		return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	// "sm__cs_thread_count_and_per_dispatch" holds the count and the count per dispatch,
+	// "sm__cs_instructions_per_dispatch_and_thread" the instructions per dispatch and per thread
+	void SplitPairName(const std::string& name, std::string& first, std::string& second)
+	{
+		size_t pos = name.rfind("_and_");
+		if (pos == std::string::npos)
+		{
+			first = name + ".0";
+			second = name + ".1";
+			return;
+		}
+
+		first = name.substr(0, pos);
+		std::string rest = name.substr(pos + 5);
+		size_t per = first.rfind("_per_");
+		if (rest.compare(0, 4, "per_") == 0)
+			second = first + "_" + rest;
+		else if (per != std::string::npos)
+			second = first.substr(0, per) + "_per_" + rest;
+		else
+		{
+			first = name + ".0";
+			second = name + ".1";
+		}
+	}
+
+	std::string FormatValue(double value)
+	{
+		std::ostringstream stream;
+		if (std::isinf(value))
+			return value > 0.0 ? "inf" : "-inf";
+		if (value == std::floor(value) && std::fabs(value) < 1e15)
+			stream << std::fixed << std::setprecision(0) << value;
+		else
+			stream << std::fixed << std::setprecision(std::fabs(value) >= 1000.0 ? 1 : 4) << value;
+		return stream.str();
+	}
+}
+
+const NsightMetrics::Metric* NsightMetrics::Section::Find(const std::string& name) const
+{
+	for (auto& metric : mMetrics)
+	{
+		if (metric.mName == name)
+			return &metric;
+	}
+	return nullptr;
+}
+
+bool NsightMetrics::Parse(const std::string& text, std::string& error)
+{
+	Clear();
+
+	auto fail = [&](uint32_t line, const std::string& message) {
+		error = "line " + std::to_string(line) + ": " + message;
+		Clear();
+		return false;
+	};
+
+	std::stringstream lines(text);
+	std::string line;
+	uint32_t lineNumber = 0;
+	while (std::getline(lines, line))
+	{
+		lineNumber++;
+		line = Trim(line);
+		if (line.empty())
+			continue;
+
+		// a line without a value names the next section ("E235  Dispatch Call 0 [Event: 235]", with or without the comma)
+		size_t comma = line.find(',');
+		std::string rawName = Trim(line.substr(0, comma));
+		std::string value = comma != std::string::npos ? Trim(line.substr(comma + 1)) : std::string();
+		if (value.empty())
+		{
+			Section section;
+			section.mLabel = rawName;
+			mSections.push_back(section);
+			continue;
+		}
+
+		if (rawName.empty())
+			return fail(lineNumber, "value without a metric name");
+		if (mSections.empty())
+			mSections.push_back(Section());
+		Section& section = mSections.back();
+
+		std::string name = NormalizeName(rawName);
+		std::vector<Metric> metrics;
+
+		Metric metric;
+		metric.mName = name;
+		metric.mRawName = rawName;
+		metric.mText = value;
+		metric.mNumeric = ParseNumber(value, metric.mValue);
+
+		size_t slash = value.find(" / ");
+		double first = 0.0, second = 0.0;
+		if (!metric.mNumeric && slash != std::string::npos && ParseNumber(Trim(value.substr(0, slash)), first)
+			&& ParseNumber(Trim(value.substr(slash + 3)), second))
+		{
+			Metric pair = metric;
+			pair.mNumeric = true;
+			SplitPairName(name, metric.mName, pair.mName);
+			metric.mNumeric = true;
+			metric.mValue = first;
+			pair.mValue = second;
+			metrics.push_back(metric);
+			metrics.push_back(pair);
+		}
+		else
+		{
+			// ratios are stored as percentages, so exports using either rollup compare
+			if (metric.mNumeric && EndsWith(rawName, ".ratio") && EndsWith(name, ".pct"))
+				metric.mValue *= 100.0;
+			metrics.push_back(metric);
+		}
+
+		for (auto& added : metrics)
+		{
+			if (section.Find(added.mName))
+				return fail(lineNumber, "metric '" + added.mName + "' appears twice in section '" + section.mLabel + "'");
+			section.mMetrics.push_back(added);
+		}
+	}
+
+	// sections without metrics (a trailing label) carry nothing to compare
+	mSections.erase(std::remove_if(mSections.begin(), mSections.end(), [](const Section& section) { return section.mMetrics.empty(); }), mSections.end());
+	if (mSections.empty())
+	{
+		error = "no metrics found";
+		return false;
+	}
+
+	error.clear();
+	return true;
+}
+
+bool NsightMetrics::Load(const std::filesystem::path& path, std::string& error)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		Clear();
+		error = "cannot open " + path.string();
+		return false;
+	}
+
+	std::stringstream stream;
+	stream << file.rdbuf();
+	if (!Parse(stream.str(), error))
+	{
+		error = path.string() + ", " + error;
+		return false;
+	}
+	return true;
+}
+
+std::string NsightMetrics::NormalizeName(const std::string& name)
+{
+	std::string trimmed = Trim(name);
+	std::string normalized;
+
+	if (trimmed.find("__") != std::string::npos)
+	{
+		// Nsight metric names are lower case already, only the spelling of the rollup differs between exports
+		for (char c : trimmed)
+			normalized += (c == ' ') ? '_' : char(std::tolower(static_cast<unsigned char>(c)));
+		if (EndsWith(normalized, ".ratio"))
+			normalized = normalized.substr(0, normalized.size() - 6) + ".pct";
+		return normalized;
+	}
+
+	// counters like DispatchCallCount or GPUAdapterName
+	for (size_t i = 0; i < trimmed.size(); i++)
+	{
+		char c = trimmed[i];
+		if (c == ' ' || c == '-')
+		{
+			if (!normalized.empty() && normalized.back() != '_')
+				normalized += '_';
+			continue;
+		}
+
+		bool upper = std::isupper(static_cast<unsigned char>(c)) != 0;
+		if (upper && i > 0 && !normalized.empty() && normalized.back() != '_')
+		{
+			char previous = trimmed[i - 1];
+			bool nextLower = i + 1 < trimmed.size() && std::islower(static_cast<unsigned char>(trimmed[i + 1]));
+			if (std::islower(static_cast<unsigned char>(previous)) || std::isdigit(static_cast<unsigned char>(previous))
+				|| (std::isupper(static_cast<unsigned char>(previous)) && nextLower))
+				normalized += '_';
+		}
+		normalized += char(std::tolower(static_cast<unsigned char>(c)));
+	}
+	return normalized;
+}
+
+NsightMetrics::Direction NsightMetrics::GetDirection(const std::string& normalizedName)
+{
+	const std::string& name = normalizedName;
+	if (name.find("hit_rate") != std::string::npos)
+		return DIRECTION_HIGHER_IS_BETTER;
+
+	if (name.compare(0, 18, "sm__cycles_active.") == 0 || name.compare(0, 19, "sm__cycles_elapsed.") == 0
+		|| name.find("warps_issue_stalled") != std::string::npos || name.find("cycles_stalled") != std::string::npos
+		|| name.find("inst_executed") != std::string::npos || name.find("__cs_instructions") != std::string::npos)
+		return DIRECTION_LOWER_IS_BETTER;
+
+	return DIRECTION_NEUTRAL;
+}
+
+std::string NsightMetrics::GetLabel(const std::string& normalizedName)
+{
+	for (auto& labeled : LabeledMetrics)
+	{
+		if (normalizedName == labeled.mName)
+			return labeled.mLabel;
+	}
+	return std::string();
+}
+
+bool NsightMetrics::IsPercentage(const std::string& normalizedName)
+{
+	return EndsWith(normalizedName, ".pct") || normalizedName.find(".pct_of_peak") != std::string::npos
+		|| EndsWith(normalizedName, "_rate");
+}
+
+void NsightMetricsComparison::SetMetricThreshold(const std::string& name, double percent)
+{
+	mMetricThresholds[NsightMetrics::NormalizeName(name)] = percent;
+}
+
+double NsightMetricsComparison::GetThreshold(const std::string& name) const
+{
+	// the longest matching prefix wins, "smsp__warps_issue_stalled" covers every stall reason
+	double threshold = mThreshold;
+	size_t matched = 0;
+	for (auto& entry : mMetricThresholds)
+	{
+		if (entry.first.size() > matched && name.compare(0, entry.first.size(), entry.first) == 0)
+		{
+			threshold = entry.second;
+			matched = entry.first.size();
+		}
+	}
+	return threshold;
+}
+
+void NsightMetricsComparison::Compare(const NsightMetrics& base, const NsightMetrics& candidate)
+{
+	mDeltas.clear();
+	mSectionLabels.clear();
+
+	const std::vector<NsightMetrics::Section>& baseSections = base.GetSections();
+	const std::vector<NsightMetrics::Section>& candidateSections = candidate.GetSections();
+	size_t sectionCount = std::max(baseSections.size(), candidateSections.size());
+	const NsightMetrics::Section empty;
+
+	for (size_t i = 0; i < sectionCount; i++)
+	{
+		const NsightMetrics::Section& baseSection = i < baseSections.size() ? baseSections[i] : empty;
+		const NsightMetrics::Section& candidateSection = i < candidateSections.size() ? candidateSections[i] : empty;
+		std::string label = baseSection.mLabel;
+		if (i >= baseSections.size())
+			label = candidateSection.mLabel;
+		else if (i < candidateSections.size() && candidateSection.mLabel != baseSection.mLabel)
+			label += " | " + candidateSection.mLabel;
+		mSectionLabels.push_back(label);
+
+		auto compare = [&](const NsightMetrics::Metric* baseMetric, const NsightMetrics::Metric* candidateMetric) {
+			Delta delta;
+			delta.mSection = static_cast<uint32_t>(i);
+			delta.mName = baseMetric ? baseMetric->mName : candidateMetric->mName;
+			delta.mDirection = NsightMetrics::GetDirection(delta.mName);
+
+			if (!candidateMetric || !baseMetric)
+			{
+				delta.mStatus = candidateMetric ? STATUS_ADDED : STATUS_REMOVED;
+				delta.mBaseText = baseMetric ? baseMetric->mText : std::string();
+				delta.mCandidateText = candidateMetric ? candidateMetric->mText : std::string();
+				delta.mBase = baseMetric ? baseMetric->mValue : 0.0;
+				delta.mCandidate = candidateMetric ? candidateMetric->mValue : 0.0;
+				mDeltas.push_back(delta);
+				return;
+			}
+
+			delta.mBaseText = baseMetric->mText;
+			delta.mCandidateText = candidateMetric->mText;
+			if (!baseMetric->mNumeric || !candidateMetric->mNumeric)
+			{
+				delta.mStatus = (baseMetric->mNumeric == candidateMetric->mNumeric && delta.mBaseText == delta.mCandidateText) ? STATUS_UNCHANGED : STATUS_CHANGED;
+				mDeltas.push_back(delta);
+				return;
+			}
+
+			delta.mNumeric = true;
+			delta.mBase = baseMetric->mValue;
+			delta.mCandidate = candidateMetric->mValue;
+			delta.mDelta = delta.mCandidate - delta.mBase;
+			if (delta.mBase != 0.0)
+				delta.mRelative = delta.mDelta / std::fabs(delta.mBase);
+			else if (delta.mDelta != 0.0)
+				delta.mRelative = delta.mDelta > 0.0 ? std::numeric_limits<double>::infinity() : -std::numeric_limits<double>::infinity();
+
+			bool significant = std::fabs(delta.mRelative) * 100.0 > GetThreshold(delta.mName);
+			if (NsightMetrics::IsPercentage(delta.mName))
+				significant &= std::fabs(delta.mDelta) >= mPercentPointFloor;
+
+			if (!significant)
+				delta.mStatus = STATUS_UNCHANGED;
+			else if (delta.mDirection == NsightMetrics::DIRECTION_NEUTRAL)
+				delta.mStatus = STATUS_CHANGED;
+			else if ((delta.mDelta > 0.0) == (delta.mDirection == NsightMetrics::DIRECTION_LOWER_IS_BETTER))
+				delta.mStatus = STATUS_REGRESSED;
+			else
+				delta.mStatus = STATUS_IMPROVED;
+			mDeltas.push_back(delta);
+		};
+
+		for (auto& metric : baseSection.mMetrics)
+			compare(&metric, candidateSection.Find(metric.mName));
+		for (auto& metric : candidateSection.mMetrics)
+		{
+			if (!baseSection.Find(metric.mName))
+				compare(nullptr, &metric);
+		}
+	}
+}
+
+uint32_t NsightMetricsComparison::GetCount(Status status) const
+{
+	uint32_t count = 0;
+	for (auto& delta : mDeltas)
+		count += delta.mStatus == status ? 1 : 0;
+	return count;
+}
+
+const char* NsightMetricsComparison::GetStatusString(Status status)
+{
+	switch (status)
+	{
+	case STATUS_CHANGED: return "changed";
+	case STATUS_IMPROVED: return "improved";
+	case STATUS_REGRESSED: return "REGRESSED";
+	case STATUS_ADDED: return "added";
+	case STATUS_REMOVED: return "removed";
+	default: return "";
+	}
+}
+
+std::string NsightMetricsComparison::FormatTable(bool all) const
+{
+	std::ostringstream stream;
+	for (size_t section = 0; section < mSectionLabels.size(); section++)
+	{
+		// labeled metrics first in the label table's order, then everything else that changed
+		std::vector<const Delta*> rows;
+		for (auto& labeled : LabeledMetrics)
+		{
+			for (auto& delta : mDeltas)
+			{
+				if (delta.mSection == section && delta.mName == labeled.mName)
+					rows.push_back(&delta);
+			}
+		}
+		for (auto& delta : mDeltas)
+		{
+			if (delta.mSection == section && NsightMetrics::GetLabel(delta.mName).empty() && (all || delta.mStatus != STATUS_UNCHANGED))
+				rows.push_back(&delta);
+		}
+
+		size_t nameWidth = 6;
+		std::vector<std::string> names;
+		for (const Delta* delta : rows)
+		{
+			std::string label = NsightMetrics::GetLabel(delta->mName);
+			names.push_back(label.empty() ? delta->mName : label);
+			nameWidth = std::max(nameWidth, names.back().size());
+		}
+
+		stream << "== " << mSectionLabels[section] << " ==\n";
+		stream << std::left << std::setw(int(nameWidth)) << "metric" << std::right << std::setw(16) << "base" << std::setw(16) << "candidate"
+			<< std::setw(16) << "delta" << std::setw(10) << "delta %" << "  status\n";
+		for (size_t i = 0; i < rows.size(); i++)
+		{
+			const Delta& delta = *rows[i];
+			if (!delta.mNumeric)
+				continue;
+
+			std::ostringstream relative;
+			if (std::isinf(delta.mRelative))
+				relative << (delta.mRelative > 0.0 ? "+inf" : "-inf");
+			else
+				relative << std::showpos << std::fixed << std::setprecision(1) << delta.mRelative * 100.0;
+
+			stream << std::left << std::setw(int(nameWidth)) << names[i] << std::right << std::setw(16) << FormatValue(delta.mBase)
+				<< std::setw(16) << FormatValue(delta.mCandidate) << std::setw(16) << FormatValue(delta.mDelta)
+				<< std::setw(10) << relative.str() << "  " << GetStatusString(delta.mStatus) << "\n";
+		}
+
+		// text values (adapter, SOL summary) and metrics only one side has do not fit the columns
+		for (size_t i = 0; i < rows.size(); i++)
+		{
+			const Delta& delta = *rows[i];
+			if (delta.mNumeric)
+				continue;
+
+			std::string baseText = delta.mStatus == STATUS_ADDED ? "-" : delta.mBaseText;
+			std::string candidateText = delta.mStatus == STATUS_REMOVED ? "-" : delta.mCandidateText;
+			stream << names[i] << ": " << baseText;
+			if (delta.mStatus != STATUS_UNCHANGED)
+				stream << " -> " << candidateText << "  " << GetStatusString(delta.mStatus);
+			stream << "\n";
+		}
+		stream << "\n";
+	}
+
+	stream << GetCount(STATUS_REGRESSED) << " regressed, " << GetCount(STATUS_IMPROVED) << " improved, " << GetCount(STATUS_CHANGED) << " changed, "
+		<< GetCount(STATUS_ADDED) << " added, " << GetCount(STATUS_REMOVED) << " removed\n";
+	return stream.str();
+}
+
+std::string NsightMetricsComparison::ExportCSV() const
+{
+	auto quote = [](const std::string& text) {
+		if (text.find_first_of(",\"") == std::string::npos)
+			return text;
+		std::string quoted = "\"";
+		for (char c : text)
+			quoted += (c == '"') ? std::string("\"\"") : std::string(1, c);
+		return quoted + "\"";
+	};
+
+	std::ostringstream stream;
+	stream << std::setprecision(10);
+	stream << "section,metric,base,candidate,delta,relative_pct,status\n";
+	for (auto& delta : mDeltas)
+	{
+		stream << quote(mSectionLabels[delta.mSection]) << "," << delta.mName << ",";
+		if (delta.mNumeric)
+			stream << delta.mBase << "," << delta.mCandidate << "," << delta.mDelta << "," << delta.mRelative * 100.0;
+		else
+			stream << quote(delta.mBaseText) << "," << quote(delta.mCandidateText) << ",,";
+		stream << "," << GetStatusString(delta.mStatus) << "\n";
+	}
+	return stream.str();
+}
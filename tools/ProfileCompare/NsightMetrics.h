@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Metric dumps exported from the Nsight Graphics range profiler, like the ones in profiling/.
+// A dump is a list of sections: a line naming the event or range ("E235  Dispatch Call 0 [Event: 235]")
+// followed by "metric,value" lines. Values are numbers, "a / b" pairs or text (adapter name, SOL summary).
+// Names are normalized so dumps from different exports line up: trimmed, CamelCase counters turned into
+// snake_case, ".ratio" rollups converted to ".pct", and "x_and_per_y" pairs split into two metrics.
+// Only uses the standard library.
+class NsightMetrics
+{
+public:
+    enum Direction
+    {
+        DIRECTION_NEUTRAL = 0,      // a change is reported but never a regression (throughput, counts)
+        DIRECTION_LOWER_IS_BETTER,  // cycles, stalls, instructions
+        DIRECTION_HIGHER_IS_BETTER  // hit rates
+    };
+
+    struct Metric
+    {
+        std::string mName;          // normalized
+        std::string mRawName;       // as exported
+        std::string mText;          // the exported value
+        double mValue = 0.0;
+        bool mNumeric = false;
+    };
+
+    struct Section
+    {
+        std::string mLabel;
+        std::vector<Metric> mMetrics;   // in file order
+
+        const Metric* Find(const std::string& name) const;
+    };
+
+    // On failure the error names the line and the dump is left empty
+    bool Parse(const std::string& text, std::string& error);
+    bool Load(const std::filesystem::path& path, std::string& error);
+
+    const std::vector<Section>& GetSections() const { return mSections; }
+    void Clear() { mSections.clear(); }
+
+    static std::string NormalizeName(const std::string& name);
+    static Direction GetDirection(const std::string& normalizedName);
+    // Short name of the metrics worth reading first, empty for the rest
+    static std::string GetLabel(const std::string& normalizedName);
+    // Percentages compare in percent points against the noise floor as well as relatively
+    static bool IsPercentage(const std::string& normalizedName);
+
+private:
+    std::vector<Section> mSections;
+};
+
+// Deltas between the sections of two dumps, matched by position, and their metrics, matched by name.
+// A change is significant when it exceeds the relative threshold (per metric or global) and, for
+// percentages, the percent point floor. Significant changes are regressions or improvements depending on
+// the metric's direction.
+class NsightMetricsComparison
+{
+public:
+    enum Status
+    {
+        STATUS_UNCHANGED = 0,
+        STATUS_CHANGED,     // significant change of a neutral metric, or different text
+        STATUS_IMPROVED,
+        STATUS_REGRESSED,
+        STATUS_ADDED,       // only in the candidate
+        STATUS_REMOVED      // only in the base
+    };
+
+    struct Delta
+    {
+        uint32_t mSection = 0;
+        std::string mName;
+        std::string mBaseText;
+        std::string mCandidateText;
+        double mBase = 0.0;
+        double mCandidate = 0.0;
+        double mDelta = 0.0;
+        double mRelative = 0.0;     // delta / |base|, infinite if the base is 0
+        bool mNumeric = false;      // both values are numbers, the others compare as text
+        NsightMetrics::Direction mDirection = NsightMetrics::DIRECTION_NEUTRAL;
+        Status mStatus = STATUS_UNCHANGED;
+    };
+
+    static constexpr double DEFAULT_THRESHOLD_PERCENT = 5.0;
+    static constexpr double DEFAULT_PERCENT_POINT_FLOOR = 0.5;
+
+    void SetThreshold(double percent) { mThreshold = percent; }
+    // The name is normalized, so the exported spelling works too
+    void SetMetricThreshold(const std::string& name, double percent);
+    void SetPercentPointFloor(double points) { mPercentPointFloor = points; }
+
+    void Compare(const NsightMetrics& base, const NsightMetrics& candidate);
+
+    // Section by section, metrics in the base's order followed by the ones only the candidate has
+    const std::vector<Delta>& GetDeltas() const { return mDeltas; }
+    uint32_t GetCount(Status status) const;
+    // Labels of matched sections, "base | candidate" if they differ
+    const std::vector<std::string>& GetSectionLabels() const { return mSectionLabels; }
+
+    // Labeled metrics always, the others only when they changed (or all of them with all = true)
+    std::string FormatTable(bool all = false) const;
+    // section,metric,base,candidate,delta,relative_pct,status
+    std::string ExportCSV() const;
+
+    static const char* GetStatusString(Status status);
+
+private:
+    double GetThreshold(const std::string& name) const;
+
+    double mThreshold = DEFAULT_THRESHOLD_PERCENT;
+    double mPercentPointFloor = DEFAULT_PERCENT_POINT_FLOOR;
+    std::map<std::string, double> mMetricThresholds;
+    std::vector<Delta> mDeltas;
+    std::vector<std::string> mSectionLabels;
+};
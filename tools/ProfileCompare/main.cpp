@@ -0,0 +1,103 @@
+// Compares two Nsight metric dumps from profiling/ and flags regressions.
+//
+//   ProfileCompare <base.csv> <candidate.csv> [options]
+//     --threshold <percent>          relative change that counts (default 5)
+//     --metric <name>=<percent>      threshold of one metric, or of every metric starting with the name
+//     --floor <points>               smallest change of a percentage that counts (default 0.5)
+//     --all                          list unchanged metrics too
+//     --csv <file>                   also write every delta as CSV
+//
+// Exits with 1 if a metric regressed and 2 on bad arguments or dumps, so scripts can gate on it.
+// Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -o ProfileCompare tools/ProfileCompare/*.cpp
+
+#include "NsightMetrics.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: ProfileCompare <base.csv> <candidate.csv> [--threshold <percent>] [--metric <name>=<percent>] [--floor <points>] [--all] [--csv <file>]\n";
+		return 2;
+	}
+
+	bool ParsePercent(const char* text, double& value)
+	{
+		char* end = nullptr;
+		value = std::strtod(text, &end);
+		return end != text && *end == '\0' && value >= 0.0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> files;
+	NsightMetricsComparison comparison;
+	bool all = false;
+	std::string csvPath;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		double value = 0.0;
+		if (arg == "--all")
+			all = true;
+		else if (arg == "--threshold" && i + 1 < argc && ParsePercent(argv[i + 1], value))
+		{
+			comparison.SetThreshold(value);
+			i++;
+		}
+		else if (arg == "--floor" && i + 1 < argc && ParsePercent(argv[i + 1], value))
+		{
+			comparison.SetPercentPointFloor(value);
+			i++;
+		}
+		else if (arg == "--metric" && i + 1 < argc)
+		{
+			std::string metric = argv[++i];
+			size_t equals = metric.find('=');
+			if (equals == std::string::npos || equals == 0 || !ParsePercent(metric.c_str() + equals + 1, value))
+				return Usage();
+			comparison.SetMetricThreshold(metric.substr(0, equals), value);
+		}
+		else if (arg == "--csv" && i + 1 < argc)
+			csvPath = argv[++i];
+		else if (arg.compare(0, 2, "--") == 0)
+			return Usage();
+		else
+			files.push_back(arg);
+	}
+
+	if (files.size() != 2)
+		return Usage();
+
+	NsightMetrics base, candidate;
+	std::string error;
+	if (!base.Load(files[0], error) || !candidate.Load(files[1], error))
+	{
+		std::cerr << error << "\n";
+		return 2;
+	}
+
+	comparison.Compare(base, candidate);
+	std::cout << "base:      " << files[0] << "\ncandidate: " << files[1] << "\n\n";
+	std::cout << comparison.FormatTable(all);
+
+	if (!csvPath.empty())
+	{
+		std::ofstream file(csvPath, std::ios::binary);
+		file << comparison.ExportCSV();
+		if (!file)
+		{
+			std::cerr << "cannot write " << csvPath << "\n";
+			return 2;
+		}
+	}
+
+	return comparison.GetCount(NsightMetricsComparison::STATUS_REGRESSED) > 0 ? 1 : 0;
+}
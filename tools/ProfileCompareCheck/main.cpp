@@ -0,0 +1,197 @@
+// Checks the dump parser and the comparison of ProfileCompare (NsightMetrics, NsightMetricsComparison) on the two
+// RSM dumps checked in under profiling/ and on small dumps written for one rule each.
+//   fixtures    both RSM dumps parse into their two sections with every "a / b" pair split; comparing a dump with
+//               itself changes nothing; 8x8 third-res against 32x32 half-res regresses the SM cycles, improves the
+//               L1 hit rate and long scoreboard stalls and only reports the neutral occupancy as changed
+//   parser      names are normalized (CamelCase counters, spaces, ".ratio" rollups scaled to ".pct"), section labels
+//               work with and without a trailing comma, duplicate and nameless metrics fail with their line
+//   compare     the global, per metric and longest prefix thresholds, the percent point floor, a zero base, text
+//               values, metrics and sections only one side has, and the CSV export
+//
+//   ProfileCompareCheck [--profiling dir]
+//
+// --profiling is the directory holding the dumps, profiling/ relative to the repository root by default. Prints a
+// line per check and exits with 1 if any fails and 2 on bad arguments. Standalone and standard library only, e.g. on
+// Linux:
+//   g++ -std=c++17 -O2 -I tools/ProfileCompare -o ProfileCompareCheck tools/ProfileCompareCheck/main.cpp tools/ProfileCompare/NsightMetrics.cpp
+
+#include "../Check.h"
+#include "NsightMetrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: ProfileCompareCheck [--profiling dir]\n";
+		return 2;
+	}
+
+	typedef NsightMetricsComparison Comparison;
+
+	const Comparison::Delta* FindDelta(const Comparison& comparison, uint32_t section, const std::string& name)
+	{
+		for (const Comparison::Delta& delta : comparison.GetDeltas())
+		{
+			if (delta.mSection == section && delta.mName == name)
+				return &delta;
+		}
+		return nullptr;
+	}
+
+	Comparison::Status StatusOf(const Comparison& comparison, uint32_t section, const std::string& name)
+	{
+		const Comparison::Delta* delta = FindDelta(comparison, section, name);
+		return delta ? delta->mStatus : Comparison::Status(-1);
+	}
+
+	// Compares two one-section dumps; the comparison is left in comparison
+	bool CompareText(Comparison& comparison, const std::string& base, const std::string& candidate)
+	{
+		NsightMetrics baseMetrics, candidateMetrics;
+		std::string error;
+		if (!baseMetrics.Parse(base, error) || !candidateMetrics.Parse(candidate, error))
+			return false;
+		comparison.Compare(baseMetrics, candidateMetrics);
+		return true;
+	}
+
+	size_t Lines(const std::string& text)
+	{
+		return size_t(std::count(text.begin(), text.end(), '\n'));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	fs::path profiling = FindRepoRoot(argv[0]) / "profiling";
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--profiling" && hasValue)
+			profiling = argv[++i];
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+	std::string error;
+
+	{
+		NsightMetrics third, half;
+		bool loaded = third.Load(profiling / "RSM_CS_8_8_third-res_512_samples.csv", error);
+		loaded = loaded && half.Load(profiling / "RSM_CS_32_32_half-res_512_samples.csv", error);
+		if (!loaded)
+			std::printf("    %s\n", error.c_str());
+		bool sections = loaded && third.GetSections().size() == 2 && half.GetSections().size() == 2 &&
+			third.GetSections()[0].mLabel == "E235  Dispatch Call 0 [Event: 235]" && third.GetSections()[1].mLabel == "E227-235 [Range: 227 to 235]";
+		passed &= Check("RSM dumps parse into their sections", sections, "%.0f sections", double(third.GetSections().size()));
+
+		if (sections)
+		{
+			const NsightMetrics::Section& dispatch = third.GetSections()[0];
+			const NsightMetrics::Metric* perThread = dispatch.Find("sm__cs_instructions_per_thread");
+			const NsightMetrics::Metric* perDispatch = dispatch.Find("sm__cs_instructions_per_dispatch");
+			const NsightMetrics::Metric* threads = dispatch.Find("sm__cs_thread_count_per_dispatch");
+			bool split = perThread && perThread->mValue == 850.3 && perDispatch && perDispatch->mValue == 195912060.0 && threads &&
+				threads->mValue == 230400.0 && !dispatch.Find("sm__cs_instructions_per_dispatch_and_thread");
+			passed &= Check("value pairs split into two metrics", split, "%.1f per thread", perThread ? perThread->mValue : -1.0);
+			const NsightMetrics::Metric* adapter = dispatch.Find("gpu_adapter_name");
+			passed &= Check("counters and text values are kept", adapter && !adapter->mNumeric && adapter->mText == "NVIDIA GeForce RTX 2060" &&
+				dispatch.Find("dispatch_call_count"), "%.0f metrics", double(dispatch.mMetrics.size()));
+
+			Comparison same;
+			same.Compare(third, third);
+			uint32_t unchanged = same.GetCount(Comparison::STATUS_UNCHANGED);
+			passed &= Check("a dump compared with itself is unchanged", unchanged == same.GetDeltas().size(), "%.0f metrics", double(unchanged));
+
+			Comparison comparison;
+			comparison.Compare(third, half);
+			const Comparison::Delta* cycles = FindDelta(comparison, 0, "sm__cycles_elapsed.avg");
+			bool regressed = cycles && cycles->mStatus == Comparison::STATUS_REGRESSED && std::fabs(cycles->mRelative - 0.876) < 0.001;
+			passed &= Check("32x32 half-res regresses SM cycles", regressed, "%+.1f%%", cycles ? cycles->mRelative * 100.0 : 0.0);
+			bool improved = StatusOf(comparison, 0, "l1tex__t_sector_hit_rate.pct") == Comparison::STATUS_IMPROVED &&
+				StatusOf(comparison, 0, "smsp__warps_issue_stalled_long_scoreboard.avg.pct_of_peak_sustained_active") == Comparison::STATUS_IMPROVED;
+			passed &= Check("and improves L1 hits and long scoreboard", improved, "%.0f improved", double(comparison.GetCount(Comparison::STATUS_IMPROVED)));
+			bool neutral = StatusOf(comparison, 0, "sm__warps_active.avg.pct_of_peak_sustained_active") == Comparison::STATUS_CHANGED;
+			passed &= Check("occupancy is neutral", neutral, "%.0f changed", double(comparison.GetCount(Comparison::STATUS_CHANGED)));
+			std::string table = comparison.FormatTable();
+			bool labeledFirst = table.find("SM elapsed cycles") < table.find("fe__output_ops_type_bundle_cmd_go_idle.avg") &&
+				table.find("regressed, ") != std::string::npos;
+			passed &= Check("the table lists labeled metrics first", labeledFirst, "%.0f lines", double(Lines(table)));
+		}
+	}
+
+	{
+		int normalized = 0;
+		normalized += NsightMetrics::NormalizeName("GPUAdapterName") == "gpu_adapter_name";
+		normalized += NsightMetrics::NormalizeName(" DispatchTotalThreads ") == "dispatch_total_threads";
+		normalized += NsightMetrics::NormalizeName("Draw Call Count") == "draw_call_count";
+		normalized += NsightMetrics::NormalizeName("L2HitRate") == "l2_hit_rate";
+		normalized += NsightMetrics::NormalizeName("lts__t_sector_hit_rate.ratio") == "lts__t_sector_hit_rate.pct";
+		passed &= Check("names are normalized", normalized == 5, "%.0f of 5", double(normalized));
+
+		Comparison comparison;
+		bool scaled = CompareText(comparison, "E1 Dispatch,\nlts__t_sector_hit_rate.ratio,0.886\n", "E1 Dispatch\nlts__t_sector_hit_rate.pct,88.6\n") &&
+			comparison.GetDeltas().size() == 1 && comparison.GetDeltas()[0].mStatus == Comparison::STATUS_UNCHANGED &&
+			comparison.GetSectionLabels()[0] == "E1 Dispatch";
+		passed &= Check("ratio rollups and labels line up", scaled, "%.0f deltas", double(comparison.GetDeltas().size()));
+
+		NsightMetrics metrics;
+		int rejected = 0;
+		rejected += !metrics.Parse("E1\nsm__cycles_elapsed.avg,1\n\nsm__cycles_elapsed.avg,2\n", error) && error.find("line 4: ") == 0;
+		rejected += !metrics.Parse("E1\n,5\n", error) && error.find("line 2: ") == 0;
+		rejected += !metrics.Parse("E1 Dispatch\nE2 Dispatch,\n", error) && error == "no metrics found";
+		rejected += !metrics.Parse("E1\nsm__fragment_count_and_per_draw_call,1.0 / 2.0\nsm__fragment_count,3\n", error) && error.find("line 3: ") == 0;
+		passed &= Check("duplicate and nameless metrics fail", rejected == 4 && metrics.GetSections().empty(), "%.0f of 4", double(rejected));
+	}
+
+	{
+		const std::string base = "E1\nsm__cycles_elapsed.avg,1000\nsmsp__warps_issue_stalled_barrier.avg.pct,10.0\n"
+			"smsp__warps_issue_stalled_wait.avg.pct,10.0\nl1tex__t_sector_hit_rate.pct,1.0\nfe__pixel_shader_barriers.sum,0\n"
+			"gpu__sol_full_pipeline,TEX 71.1%\nonly_in_base,1\n";
+		const std::string candidate = "E1\nsm__cycles_elapsed.avg,1040\nsmsp__warps_issue_stalled_barrier.avg.pct,13.0\n"
+			"smsp__warps_issue_stalled_wait.avg.pct,13.0\nl1tex__t_sector_hit_rate.pct,0.8\nfe__pixel_shader_barriers.sum,2\n"
+			"gpu__sol_full_pipeline,TEX 77.4%\nonly_in_candidate,1\nE2\nsm__cycles_elapsed.avg,1\n";
+
+		Comparison comparison;
+		CompareText(comparison, base, candidate);
+		bool defaults = StatusOf(comparison, 0, "sm__cycles_elapsed.avg") == Comparison::STATUS_UNCHANGED &&
+			StatusOf(comparison, 0, "smsp__warps_issue_stalled_wait.avg.pct") == Comparison::STATUS_REGRESSED;
+		passed &= Check("4% stays under the 5% default", defaults, "%.0f regressed", double(comparison.GetCount(Comparison::STATUS_REGRESSED)));
+		bool floor = StatusOf(comparison, 0, "l1tex__t_sector_hit_rate.pct") == Comparison::STATUS_UNCHANGED;
+		passed &= Check("-20% of a 1% rate is under the floor", floor, "%.1f points", FindDelta(comparison, 0, "l1tex__t_sector_hit_rate.pct")->mDelta);
+		const Comparison::Delta* zero = FindDelta(comparison, 0, "fe__pixel_shader_barriers.sum");
+		passed &= Check("a zero base changes by +inf", zero && std::isinf(zero->mRelative) && zero->mStatus == Comparison::STATUS_CHANGED, "%.0f", zero ? zero->mDelta : 0.0);
+		bool sides = StatusOf(comparison, 0, "only_in_base") == Comparison::STATUS_REMOVED && StatusOf(comparison, 0, "only_in_candidate") == Comparison::STATUS_ADDED &&
+			StatusOf(comparison, 1, "sm__cycles_elapsed.avg") == Comparison::STATUS_ADDED && StatusOf(comparison, 0, "gpu__sol_full_pipeline") == Comparison::STATUS_CHANGED;
+		passed &= Check("text, added and removed metrics", sides, "%.0f added", double(comparison.GetCount(Comparison::STATUS_ADDED)));
+
+		comparison.SetThreshold(3.0);
+		comparison.SetMetricThreshold("smsp__warps_issue_stalled", 50.0);
+		comparison.SetMetricThreshold("smsp__warps_issue_stalled_wait", 20.0);
+		comparison.SetPercentPointFloor(0.1);
+		CompareText(comparison, base, candidate);
+		bool thresholds = StatusOf(comparison, 0, "sm__cycles_elapsed.avg") == Comparison::STATUS_REGRESSED &&
+			StatusOf(comparison, 0, "smsp__warps_issue_stalled_barrier.avg.pct") == Comparison::STATUS_UNCHANGED &&
+			StatusOf(comparison, 0, "smsp__warps_issue_stalled_wait.avg.pct") == Comparison::STATUS_REGRESSED &&
+			StatusOf(comparison, 0, "l1tex__t_sector_hit_rate.pct") == Comparison::STATUS_REGRESSED;
+		passed &= Check("thresholds: global, prefix, longest prefix", thresholds, "%.0f regressed", double(comparison.GetCount(Comparison::STATUS_REGRESSED)));
+
+		std::string csv = comparison.ExportCSV();
+		bool exported = csv.rfind("section,metric,base,candidate,delta,relative_pct,status\n", 0) == 0 &&
+			Lines(csv) == comparison.GetDeltas().size() + 1 && csv.find("E1,sm__cycles_elapsed.avg,1000,1040,40,4,REGRESSED\n") != std::string::npos;
+		passed &= Check("CSV has a row per delta", exported, "%.0f rows", double(Lines(csv) - 1));
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// Checks the Visual Studio project against the tree, the only real build of the app:
+//   files      every entry of DXR-Sandbox.vcxproj is written with backslashes and every ClCompile and FxCompile
+//              entry names an existing file; missing headers (ClInclude, None) do not stop MSBuild and are only
+//              listed as warnings
+//   filters    DXR-Sandbox.vcxproj.filters lists the same C++ and shader entries as the project
+//   sources    every .h and .cpp under source/ is in the project
+//
+//   ProjectFilesCheck [--root dir]
+//
+// --root defaults to the repository holding the working directory or the executable. Prints a line per check and every offending entry,
+// and exits with 1 if any check fails and 2 on bad arguments. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -o ProjectFilesCheck tools/ProjectFilesCheck/main.cpp
+
+#include "../Check.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: ProjectFilesCheck [--root dir]\n";
+		return 2;
+	}
+
+	bool ReadFile(const fs::path& path, std::string& text)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+		std::ostringstream stream;
+		stream << file.rdbuf();
+		text = stream.str();
+		return true;
+	}
+
+	// Include attributes of the items of the given kinds, as written
+	std::vector<std::string> GetItems(const std::string& text, const std::vector<std::string>& kinds)
+	{
+		std::vector<std::string> items;
+		for (const std::string& kind : kinds)
+		{
+			const std::string open = "<" + kind + " Include=\"";
+			for (size_t position = text.find(open); position != std::string::npos; position = text.find(open, position))
+			{
+				position += open.size();
+				size_t end = text.find('"', position);
+				if (end == std::string::npos)
+					break;
+				items.push_back(text.substr(position, end - position));
+			}
+		}
+		return items;
+	}
+
+	// MSBuild separates with backslashes; anything else in a path breaks on some machine
+	fs::path ToPath(const fs::path& root, const std::string& item)
+	{
+		std::string path = item;
+		std::replace(path.begin(), path.end(), '\\', '/');
+		return root / path;
+	}
+
+	bool Check(const char* name, const std::vector<std::string>& offending, const char* what, bool warnOnly = false)
+	{
+		char detail[64];
+		std::snprintf(detail, sizeof(detail), "%zu %s", offending.size(), what);
+		PrintCheck(name, detail, offending.empty() ? "ok" : (warnOnly ? "warning" : "FAILED"));
+		for (const std::string& entry : offending)
+			std::printf("    %s\n", entry.c_str());
+		return warnOnly || offending.empty();
+	}
+
+	bool IsMissing(const fs::path& root, const std::string& item)
+	{
+		return !fs::is_regular_file(ToPath(root, item));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	fs::path root = FindRepoRoot(argv[0]);
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--root" && hasValue)
+			root = argv[++i];
+		else
+			return Usage();
+	}
+
+	std::string project, filters;
+	if (!ReadFile(root / "DXR-Sandbox.vcxproj", project) || !ReadFile(root / "DXR-Sandbox.vcxproj.filters", filters))
+	{
+		std::cerr << "cannot read DXR-Sandbox.vcxproj and its filters under " << root.string() << "\n";
+		return 2;
+	}
+
+	const std::vector<std::string> buildKinds = { "ClInclude", "ClCompile", "FxCompile" };
+	std::vector<std::string> projectItems = GetItems(project, buildKinds);
+	bool passed = true;
+
+	std::vector<std::string> malformed;
+	for (const std::string& item : GetItems(project, { "ClInclude", "ClCompile", "FxCompile", "None" }))
+	{
+		if (item.find('/') != std::string::npos)
+			malformed.push_back(item);
+	}
+	passed &= Check("entries use backslashes", malformed, "malformed");
+
+	std::vector<std::string> missing;
+	for (const std::string& item : GetItems(project, { "ClCompile", "FxCompile" }))
+	{
+		if (IsMissing(root, item))
+			missing.push_back(item);
+	}
+	passed &= Check("compiled entries name existing files", missing, "missing");
+
+	std::vector<std::string> missingHeaders;
+	for (const std::string& item : GetItems(project, { "ClInclude", "None" }))
+	{
+		if (IsMissing(root, item))
+			missingHeaders.push_back(item);
+	}
+	passed &= Check("header entries name existing files", missingHeaders, "missing", true);
+
+	std::set<std::string> inProject(projectItems.begin(), projectItems.end());
+	std::vector<std::string> filterItems = GetItems(filters, buildKinds);
+	std::set<std::string> inFilters(filterItems.begin(), filterItems.end());
+	std::vector<std::string> mismatched;
+	for (const std::string& item : inProject)
+	{
+		if (!inFilters.count(item))
+			mismatched.push_back(item + " (not in the filters)");
+	}
+	for (const std::string& item : inFilters)
+	{
+		if (!inProject.count(item))
+			mismatched.push_back(item + " (not in the project)");
+	}
+	passed &= Check("filters match the project", mismatched, "mismatched");
+
+	std::vector<std::string> unlisted;
+	for (const fs::directory_entry& entry : fs::directory_iterator(root / "source"))
+	{
+		const std::string extension = entry.path().extension().string();
+		if (extension != ".h" && extension != ".cpp")
+			continue;
+		const std::string item = "source\\" + entry.path().filename().string();
+		if (!inProject.count(item))
+			unlisted.push_back(item);
+	}
+	std::sort(unlisted.begin(), unlisted.end());
+	passed &= Check("every source file is in the project", unlisted, "unlisted");
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,647 @@
+// Measures interleaved sampling with de-interleaving and temporal accumulation for the RSM pass (RSMInterleave) on a
+// box room lit by a directional light, ray cast into an orthographic RSM and perspective G-buffers at the resolution
+// of the pass. Per tile size it reports the samples per pixel and the relative RMS error of the luminance of
+//   interleaved  each pixel's own subset, what the pass writes, against the full sample set of the RSM pass
+//                (RSMLightTree::GatherSamples)
+//   filter       the de-interleave of the full set against the full set, the blur the window costs at edges
+// and against the de-interleaved full set, which leaves the noise
+//   resolved     the de-interleaved pass
+//   temporal     after --frames static frames of accumulation, every pixel cycling through the subsets
+//   moving       the same with the camera moving between two views, at the last view
+// and the fraction of pixels without history while the camera moves.
+//
+//   RSMInterleaveBench [--rsm-size n] [--width n] [--height n] [--frames n] [--rmax value]
+//
+// Checks: the subsets of every tile and frame are disjoint and cover the samples, every subset of the scrambled Sobol
+// set is a (0,m,2)-net, each pixel sees every subset once in tileSize^2 frames, projecting a pixel's position gives the
+// pixel back, the history test keeps 95% of the pixels visible in the previous view and rejects 95% of the disoccluded
+// ones, the de-interleave at least halves the error of the interleaved pass and accumulation lowers it further.
+// Exits with 1 if a check fails and 2 on bad arguments. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o RSMInterleaveBench tools/RSMInterleaveBench/main.cpp source/RSMInterleave.cpp source/RSMLightTree.cpp source/Sampling.cpp source/CpuProfiler.cpp
+
+#include "../Check.h"
+#include "RSMInterleave.h"
+#include "RSMLightTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: RSMInterleaveBench [--rsm-size n] [--width n] [--height n] [--frames n] [--rmax value]\n";
+		return 2;
+	}
+
+	struct Vector
+	{
+		float x, y, z;
+	};
+
+	Vector operator+(Vector a, Vector b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	Vector operator-(Vector a, Vector b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	Vector operator*(Vector a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	float Dot(Vector a, Vector b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	Vector Cross(Vector a, Vector b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+	Vector Normalize(Vector a) { return a * (1.0f / std::sqrt(Dot(a, a))); }
+	Vector Lerp(Vector a, Vector b, float t) { return a + (b - a) * t; }
+
+	struct Box
+	{
+		Vector mMin, mMax, mAlbedo;
+	};
+
+	// The room of tools/RSMLightcutsBench
+	const Box Boxes[] = {
+		{ { -10.0f, -1.0f, -10.0f }, { 10.0f, 0.0f, 10.0f }, { 0.7f, 0.7f, 0.7f } },
+		{ { -10.0f, 0.0f, -11.0f }, { 10.0f, 10.0f, -10.0f }, { 0.8f, 0.1f, 0.1f } },
+		{ { -11.0f, 0.0f, -10.0f }, { -10.0f, 10.0f, 10.0f }, { 0.1f, 0.8f, 0.1f } },
+		{ { -3.0f, 0.0f, -3.0f }, { 0.0f, 3.0f, 0.0f }, { 0.9f, 0.9f, 0.8f } },
+		{ { 2.0f, 0.0f, 1.0f }, { 5.0f, 6.0f, 4.0f }, { 0.1f, 0.2f, 0.9f } },
+	};
+
+	bool Trace(Vector origin, Vector direction, Vector& position, Vector& normal, Vector& albedo, float& distance)
+	{
+		float nearest = std::numeric_limits<float>::max();
+		for (const Box& box : Boxes)
+		{
+			const float o[3] = { origin.x, origin.y, origin.z };
+			const float d[3] = { direction.x, direction.y, direction.z };
+			const float lo[3] = { box.mMin.x, box.mMin.y, box.mMin.z };
+			const float hi[3] = { box.mMax.x, box.mMax.y, box.mMax.z };
+			float enter = 0.0f, exit = nearest;
+			int axis = -1;
+			float sign = 0.0f;
+			for (int i = 0; i < 3; i++)
+			{
+				if (d[i] == 0.0f)
+				{
+					if (o[i] < lo[i] || o[i] > hi[i])
+						enter = exit + 1.0f;
+					continue;
+				}
+				float t0 = (lo[i] - o[i]) / d[i];
+				float t1 = (hi[i] - o[i]) / d[i];
+				float faceSign = -1.0f;
+				if (t0 > t1)
+				{
+					std::swap(t0, t1);
+					faceSign = 1.0f;
+				}
+				if (t0 > enter)
+				{
+					enter = t0;
+					axis = i;
+					sign = faceSign;
+				}
+				exit = std::min(exit, t1);
+			}
+			if (axis >= 0 && enter <= exit && enter < nearest)
+			{
+				nearest = enter;
+				position = origin + direction * enter;
+				float n[3] = { 0.0f, 0.0f, 0.0f };
+				n[axis] = sign;
+				normal = { n[0], n[1], n[2] };
+				albedo = box.mAlbedo;
+			}
+		}
+		distance = nearest;
+		return nearest < std::numeric_limits<float>::max();
+	}
+
+	void Store(std::vector<float>& data, size_t index, Vector value, float w)
+	{
+		data[index * 4] = value.x;
+		data[index * 4 + 1] = value.y;
+		data[index * 4 + 2] = value.z;
+		data[index * 4 + 3] = w;
+	}
+
+	struct Light
+	{
+		uint32_t mSize = 0;
+		float mViewProjection[16] = {};
+		std::vector<float> mPositions, mNormals, mFlux;
+	};
+
+	void MakeLight(uint32_t rsmSize, Light& light)
+	{
+		// orthographic light looking down the light direction, clip = [p 1] * M
+		const Vector direction = Normalize({ -0.5f, -1.0f, -0.6f });
+		const Vector right = Normalize(Cross({ 0.0f, 1.0f, 0.0f }, direction));
+		const Vector up = Cross(direction, right);
+		const Vector center = { 0.0f, 2.0f, 0.0f };
+		const float extent = 16.0f;
+		const float depth = 60.0f;
+		const Vector axes[3] = { right * (1.0f / extent), up * (1.0f / extent), direction * (1.0f / depth) };
+		float* m = light.mViewProjection;
+		for (int column = 0; column < 3; column++)
+		{
+			m[column] = axes[column].x;
+			m[4 + column] = axes[column].y;
+			m[8 + column] = axes[column].z;
+			m[12 + column] = -Dot(center, axes[column]) + (column == 2 ? 0.5f : 0.0f);
+		}
+		m[15] = 1.0f;
+
+		light.mSize = rsmSize;
+		const size_t texels = size_t(rsmSize) * rsmSize;
+		light.mPositions.assign(texels * 4, 0.0f);
+		light.mNormals.assign(texels * 4, 0.0f);
+		light.mFlux.assign(texels * 4, 0.0f);
+		for (uint32_t y = 0; y < rsmSize; y++)
+		{
+			for (uint32_t x = 0; x < rsmSize; x++)
+			{
+				float cx = ((float(x) + 0.5f) / float(rsmSize) - 0.5f) * 2.0f * extent;
+				float cy = (0.5f - (float(y) + 0.5f) / float(rsmSize)) * 2.0f * extent;
+				Vector origin = center + right * cx + up * cy - direction * (0.5f * depth);
+				Vector position, normal, albedo;
+				float distance;
+				if (!Trace(origin, direction, position, normal, albedo, distance))
+					continue;
+				size_t index = size_t(y) * rsmSize + x;
+				Store(light.mPositions, index, position, 1.0f);
+				Store(light.mNormals, index, normal, 0.0f);
+				Store(light.mFlux, index, albedo * std::max(-Dot(normal, direction), 0.0f), 1.0f);
+			}
+		}
+	}
+
+	// Gauss-Jordan with partial pivoting
+	void Invert(const float m[16], float result[16])
+	{
+		double a[4][8];
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				a[row][column] = m[row * 4 + column];
+				a[row][4 + column] = row == column ? 1.0 : 0.0;
+			}
+		}
+		for (int column = 0; column < 4; column++)
+		{
+			int pivot = column;
+			for (int row = column + 1; row < 4; row++)
+			{
+				if (std::fabs(a[row][column]) > std::fabs(a[pivot][column]))
+					pivot = row;
+			}
+			std::swap(a[column], a[pivot]);
+			double scale = 1.0 / a[column][column];
+			for (int k = 0; k < 8; k++)
+				a[column][k] *= scale;
+			for (int row = 0; row < 4; row++)
+			{
+				double factor = a[row][column];
+				for (int k = 0; row != column && k < 8; k++)
+					a[row][k] -= factor * a[column][k];
+			}
+		}
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+				result[row * 4 + column] = float(a[row][4 + column]);
+		}
+	}
+
+	struct View
+	{
+		Vector mEye;
+		uint32_t mWidth = 0;
+		uint32_t mHeight = 0;
+		float mViewProjection[16] = {};
+		float mInverseViewProjection[16] = {};
+		std::vector<float> mPositions, mNormals;
+		std::vector<RSMLightTree::Receiver> mReceivers;
+	};
+
+	// Perspective camera with a D3D projection (near 0.1, far 100), its G-buffer and the receivers projected into the RSM
+	void MakeView(Vector eye, Vector target, uint32_t width, uint32_t height, const Light& light, View& view)
+	{
+		const Vector forward = Normalize(target - eye);
+		const Vector right = Normalize(Cross(forward, { 0.0f, 1.0f, 0.0f }));
+		const Vector up = Cross(right, forward);
+		const float tanHalf = std::tan(0.5f * 1.0472f);
+		const float aspect = float(width) / float(height);
+		const float zNear = 0.1f, zFar = 100.0f;
+		const float a = zFar / (zFar - zNear);
+		const Vector axes[4] = { right * (1.0f / (tanHalf * aspect)), up * (1.0f / tanHalf), forward * a, forward };
+		float* m = view.mViewProjection;
+		for (int column = 0; column < 4; column++)
+		{
+			m[column] = axes[column].x;
+			m[4 + column] = axes[column].y;
+			m[8 + column] = axes[column].z;
+			m[12 + column] = -Dot(eye, axes[column]) + (column == 2 ? -zNear * a : 0.0f);
+		}
+		Invert(m, view.mInverseViewProjection);
+
+		view.mEye = eye;
+		view.mWidth = width;
+		view.mHeight = height;
+		view.mPositions.assign(size_t(width) * height * 4, 0.0f);
+		view.mNormals.assign(size_t(width) * height * 4, 0.0f);
+		view.mReceivers.assign(size_t(width) * height, RSMLightTree::Receiver{});
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				float sx = ((float(x) + 0.5f) / float(width) * 2.0f - 1.0f) * tanHalf * aspect;
+				float sy = (1.0f - (float(y) + 0.5f) / float(height) * 2.0f) * tanHalf;
+				Vector ray = Normalize(forward + right * sx + up * sy);
+				Vector position, normal, albedo;
+				float distance;
+				if (!Trace(eye, ray, position, normal, albedo, distance))
+					continue;
+				size_t index = size_t(y) * width + x;
+				Store(view.mPositions, index, position, 1.0f);
+				Store(view.mNormals, index, normal, 0.0f);
+
+				RSMLightTree::Receiver& receiver = view.mReceivers[index];
+				const float p[3] = { position.x, position.y, position.z };
+				const float* s = light.mViewProjection;
+				for (int i = 0; i < 3; i++)
+				{
+					receiver.mPosition[i] = p[i];
+					receiver.mNormal[i] = view.mNormals[index * 4 + i];
+				}
+				receiver.mUV[0] = (p[0] * s[0] + p[1] * s[4] + p[2] * s[8] + s[12]) * 0.5f + 0.5f;
+				receiver.mUV[1] = (p[0] * s[1] + p[1] * s[5] + p[2] * s[9] + s[13]) * -0.5f + 0.5f;
+			}
+		}
+	}
+
+	bool HasGeometry(const View& view, size_t index)
+	{
+		return view.mNormals[index * 4] != 0.0f || view.mNormals[index * 4 + 1] != 0.0f || view.mNormals[index * 4 + 2] != 0.0f;
+	}
+
+	// The history test of RSMInterleave::Resolve for pixel index of view against the nearest texel of previous' history
+	bool KeepsHistory(const View& view, size_t index, const View& previous, const std::vector<float>& history)
+	{
+		const float* position = &view.mPositions[index * 4];
+		uint32_t x, y;
+		float depth;
+		float historyPosition[3];
+		return RSMInterleave::Project(previous.mViewProjection, position, previous.mWidth, previous.mHeight, x, y, depth) &&
+			RSMInterleave::Unproject(previous.mViewProjection, previous.mInverseViewProjection, x, y, previous.mWidth, previous.mHeight,
+				history[(size_t(y) * previous.mWidth + x) * 4 + 3], historyPosition) &&
+			RSMInterleave::IsHistoryValid(position, &view.mNormals[index * 4], depth, historyPosition);
+	}
+
+	// Whether RSMInterleave::Resolve blends in history for pixel index of view
+	bool SamplesHistory(const View& view, size_t index, const View& previous, const std::vector<float>& history)
+	{
+		RSMInterleave::Frame frame;
+		frame.mWidth = previous.mWidth;
+		frame.mHeight = previous.mHeight;
+		frame.mPreviousViewProjection = previous.mViewProjection;
+		frame.mPreviousInverseViewProjection = previous.mInverseViewProjection;
+		float rgb[3];
+		return RSMInterleave::SampleHistory(frame, history.data(), &view.mPositions[index * 4], &view.mNormals[index * 4], rgb);
+	}
+
+	// The RSM pass: every pixel gathers its subset of the first sampleCount samples into rgba, saturated as it writes
+	void Gather(const View& view, const RSMLightTree::Image& image, float rMax, const std::vector<float>& xi, uint32_t sampleCount,
+		uint32_t tileSize, uint32_t frame, std::vector<float>& result)
+	{
+		result.assign(size_t(view.mWidth) * view.mHeight * 4, 0.0f);
+		for (uint32_t y = 0; y < view.mHeight; y++)
+		{
+			for (uint32_t x = 0; x < view.mWidth; x++)
+			{
+				size_t index = size_t(y) * view.mWidth + x;
+				if (!HasGeometry(view, index))
+					continue;
+				uint32_t first, count;
+				RSMInterleave::GetSampleRange(RSMInterleave::GetSubset(x, y, tileSize, frame), tileSize, sampleCount, first, count);
+				float rgb[3];
+				RSMLightTree::GatherSamples(image, view.mReceivers[index], rMax, xi.data() + first * 2, count, rgb);
+				for (int c = 0; c < 3; c++)
+					result[index * 4 + c] = std::min(std::max(rgb[c], 0.0f), 1.0f);
+				result[index * 4 + 3] = 1.0f;
+			}
+		}
+	}
+
+	// Relative RMS of the luminance over the pixels with geometry
+	double Measure(const View& view, const std::vector<float>& reference, const std::vector<float>& values)
+	{
+		double sum = 0.0, error = 0.0;
+		for (size_t i = 0; i < size_t(view.mWidth) * view.mHeight; i++)
+		{
+			if (!HasGeometry(view, i))
+				continue;
+			double expected = RSMLightTree::GetLuminance(&reference[i * 4]);
+			double difference = RSMLightTree::GetLuminance(&values[i * 4]) - expected;
+			sum += expected * expected;
+			error += difference * difference;
+		}
+		return sum > 0.0 ? std::sqrt(error / sum) : 0.0;
+	}
+
+	// Every elementary interval of area 1/count holds exactly one of the count points
+	bool IsNet(const float* xi, uint32_t count)
+	{
+		uint32_t m = 0;
+		while ((1u << m) < count)
+			m++;
+		if ((1u << m) != count)
+			return false;
+		std::vector<uint32_t> cells(count);
+		for (uint32_t a = 0; a <= m; a++)
+		{
+			std::fill(cells.begin(), cells.end(), 0u);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				uint32_t cx = std::min(uint32_t(xi[i * 2] * float(1u << a)), (1u << a) - 1);
+				uint32_t cy = std::min(uint32_t(xi[i * 2 + 1] * float(1u << (m - a))), (1u << (m - a)) - 1);
+				if (++cells[(cy << a) | cx] > 1)
+					return false;
+			}
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t rsmSize = 1024;
+	uint32_t width = 256;
+	uint32_t height = 144;
+	uint32_t frames = 16;
+	float rMax = 0.035f;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--rsm-size" && hasValue)
+			rsmSize = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--width" && hasValue)
+			width = uint32_t(std::max(std::atoi(argv[++i]), 4));
+		else if (arg == "--height" && hasValue)
+			height = uint32_t(std::max(std::atoi(argv[++i]), 4));
+		else if (arg == "--frames" && hasValue)
+			frames = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--rmax" && hasValue)
+			rMax = float(std::atof(argv[++i]));
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+	const uint32_t tileSizes[] = { 1, 2, RSMInterleave::MAX_TILE_SIZE };
+	const uint32_t sampleCounts[] = { RSMLightTree::MAX_SAMPLES_COUNT, 256, 64 };   // the RSM_SAMPLES_COUNT permutations
+
+	// partitions: per tile and frame the subsets are a permutation and their ranges tile the samples
+	{
+		bool disjoint = true;
+		bool cycles = true;
+		for (uint32_t tileSize : tileSizes)
+		{
+			const uint32_t subsets = tileSize * tileSize;
+			for (uint32_t frame = 0; frame < subsets; frame++)
+			{
+				for (uint32_t ty = 0; ty < 3; ty++)
+				{
+					for (uint32_t tx = 0; tx < 3; tx++)
+					{
+						for (uint32_t sampleCount : sampleCounts)
+						{
+							std::vector<uint32_t> uses(sampleCount, 0);
+							for (uint32_t y = ty * tileSize; y < (ty + 1) * tileSize; y++)
+							{
+								for (uint32_t x = tx * tileSize; x < (tx + 1) * tileSize; x++)
+								{
+									uint32_t first, count;
+									RSMInterleave::GetSampleRange(RSMInterleave::GetSubset(x, y, tileSize, frame), tileSize, sampleCount, first, count);
+									for (uint32_t i = first; i < first + count && i < sampleCount; i++)
+										uses[i]++;
+									disjoint &= first + count <= sampleCount;
+								}
+							}
+							disjoint &= std::all_of(uses.begin(), uses.end(), [](uint32_t use) { return use == 1; });
+						}
+					}
+				}
+			}
+			for (uint32_t y = 0; y < tileSize; y++)
+			{
+				for (uint32_t x = 0; x < tileSize; x++)
+				{
+					std::vector<uint32_t> seen(subsets, 0);
+					for (uint32_t frame = 0; frame < subsets; frame++)
+						seen[RSMInterleave::GetSubset(x + 5 * tileSize, y + 3 * tileSize, tileSize, frame)]++;
+					cycles &= std::all_of(seen.begin(), seen.end(), [](uint32_t use) { return use == 1; });
+				}
+			}
+		}
+		passed &= Check("tile subsets are disjoint and cover the samples", disjoint, "%g tile sizes", double(sizeof(tileSizes) / sizeof(tileSizes[0])));
+		passed &= Check("every pixel cycles through the subsets", cycles, "%g tile sizes", double(sizeof(tileSizes) / sizeof(tileSizes[0])));
+	}
+
+	std::vector<float> xi;
+	RSMLightTree::MakeSamples(RSMLightTree::MAX_SAMPLES_COUNT, xi);
+	{
+		uint32_t nets = 0, subsetCount = 0;
+		for (uint32_t tileSize : tileSizes)
+		{
+			for (uint32_t sampleCount : sampleCounts)
+			{
+				for (uint32_t subset = 0; subset < tileSize * tileSize; subset++)
+				{
+					uint32_t first, count;
+					RSMInterleave::GetSampleRange(subset, tileSize, sampleCount, first, count);
+					nets += IsNet(xi.data() + first * 2, count) ? 1 : 0;
+					subsetCount++;
+				}
+			}
+		}
+		passed &= Check("every subset is a (0,m,2)-net", nets == subsetCount, "%g subsets", double(subsetCount));
+	}
+
+	Light light;
+	MakeLight(rsmSize, light);
+	RSMLightTree::Image image;
+	image.mPositions = light.mPositions.data();
+	image.mNormals = light.mNormals.data();
+	image.mFlux = light.mFlux.data();
+	image.mSize = light.mSize;
+
+	const Vector eyes[2] = { { 8.0f, 9.0f, 12.0f }, { 3.0f, 6.0f, 13.0f } };
+	const Vector targets[2] = { { -2.0f, 1.0f, -3.0f }, { -1.0f, 1.5f, -3.0f } };
+	View views[2];
+	for (int i = 0; i < 2; i++)
+		MakeView(eyes[i], targets[i], width, height, light, views[i]);
+
+	// projecting a pixel's own position lands on the pixel
+	{
+		const View& view = views[0];
+		size_t pixels = 0, same = 0;
+		for (uint32_t y = 0; y < view.mHeight; y++)
+		{
+			for (uint32_t x = 0; x < view.mWidth; x++)
+			{
+				size_t index = size_t(y) * view.mWidth + x;
+				if (!HasGeometry(view, index))
+					continue;
+				uint32_t px, py;
+				float depth;
+				pixels++;
+				same += RSMInterleave::Project(view.mViewProjection, &view.mPositions[index * 4], view.mWidth, view.mHeight, px, py, depth) && px == x && py == y ? 1 : 0;
+			}
+		}
+		double fraction = double(same) / double(std::max<size_t>(pixels, 1));
+		passed &= Check("projection returns the pixel", fraction >= 0.999, "%.4f of the pixels", fraction);
+	}
+
+	// history test between the views against visibility in the previous view, traced
+	{
+		const View& previous = views[0];
+		const View& current = views[1];
+		std::vector<float> history(size_t(width) * height * 4, 0.0f);
+		for (size_t i = 0; i < size_t(width) * height; i++)
+		{
+			if (HasGeometry(previous, i))
+				history[i * 4 + 3] = RSMInterleave::GetDepth(previous.mViewProjection, &previous.mPositions[i * 4]);
+		}
+
+		size_t visible = 0, kept = 0, occluded = 0, rejected = 0;
+		for (size_t i = 0; i < size_t(width) * height; i++)
+		{
+			if (!HasGeometry(current, i))
+				continue;
+			const float* p = &current.mPositions[i * 4];
+			Vector position = { p[0], p[1], p[2] };
+			Vector toPosition = position - previous.mEye;
+			float length = std::sqrt(Dot(toPosition, toPosition));
+			Vector hit, normal, albedo;
+			float distance;
+			Trace(previous.mEye, toPosition * (1.0f / length), hit, normal, albedo, distance);
+
+			bool valid = KeepsHistory(current, i, previous, history);
+			if (distance >= length * 0.999f)
+			{
+				visible++;
+				kept += valid ? 1 : 0;
+			}
+			else if (distance < length * 0.9f)
+			{
+				occluded++;
+				rejected += valid ? 0 : 1;
+			}
+		}
+		double keptFraction = double(kept) / double(std::max<size_t>(visible, 1));
+		double rejectedFraction = double(rejected) / double(std::max<size_t>(occluded, 1));
+		std::printf("history between the views: %zu visible, %zu disoccluded pixels\n", visible, occluded);
+		passed &= Check("history kept where visible in the previous view", keptFraction >= 0.95, "%.4f of the pixels", keptFraction);
+		passed &= Check("history rejected where disoccluded", rejectedFraction >= 0.95, "%.4f of the pixels", rejectedFraction);
+	}
+
+	std::vector<float> full[2];
+	for (int i = 0; i < 2; i++)
+		Gather(views[i], image, rMax, xi, RSMLightTree::MAX_SAMPLES_COUNT, 1, 0, full[i]);
+
+	std::printf("\nRSM %u, %ux%u pass, RMax %g, %u frames, history weight %g\n\n", rsmSize, width, height, rMax, frames, RSMInterleave::DEFAULT_HISTORY_WEIGHT);
+	std::printf("%-6s %10s %12s %12s %12s %12s %12s %10s\n", "Tile", "Samples", "interleaved", "filter", "resolved", "temporal", "moving", "rejected");
+
+	const size_t texels = size_t(width) * height * 4;
+	std::vector<float> interleaved, output(texels), history[2] = { std::vector<float>(texels), std::vector<float>(texels) };
+	std::vector<float> filtered[2] = { std::vector<float>(texels), std::vector<float>(texels) };
+	bool halved = true, accumulated = true;
+	for (uint32_t tileSize : tileSizes)
+	{
+		RSMInterleave::ResolveSettings settings;
+		settings.mTileSize = tileSize;
+
+		// static camera
+		const View& view = views[0];
+		RSMInterleave::Frame frame;
+		frame.mPositions = view.mPositions.data();
+		frame.mNormals = view.mNormals.data();
+		frame.mWidth = width;
+		frame.mHeight = height;
+		frame.mViewProjection = view.mViewProjection;
+		frame.mPreviousViewProjection = view.mViewProjection;
+		frame.mPreviousInverseViewProjection = view.mInverseViewProjection;
+
+		// the de-interleave of the full set separates the bias of the filter from the noise it removes
+		for (int i = 0; i < 2; i++)
+		{
+			RSMInterleave::Frame fullFrame = frame;
+			fullFrame.mPositions = views[i].mPositions.data();
+			fullFrame.mNormals = views[i].mNormals.data();
+			fullFrame.mViewProjection = views[i].mViewProjection;
+			RSMInterleave::Resolve(fullFrame, settings, full[i].data(), nullptr, history[0].data(), filtered[i].data());
+		}
+		double filterError = Measure(view, full[0], filtered[0]);
+
+		Gather(view, image, rMax, xi, RSMLightTree::MAX_SAMPLES_COUNT, tileSize, 0, interleaved);
+		double interleavedError = Measure(view, full[0], interleaved);
+		RSMInterleave::Resolve(frame, settings, interleaved.data(), nullptr, history[0].data(), output.data());
+		double resolvedError = Measure(view, filtered[0], output);
+
+		settings.mTemporal = true;
+		uint32_t current = 0;
+		for (uint32_t i = 0; i < frames; i++)
+		{
+			settings.mHistoryValid = i > 0;
+			Gather(view, image, rMax, xi, RSMLightTree::MAX_SAMPLES_COUNT, tileSize, i, interleaved);
+			RSMInterleave::Resolve(frame, settings, interleaved.data(), history[current].data(), history[1 - current].data(), output.data());
+			current = 1 - current;
+		}
+		double temporalError = Measure(view, filtered[0], output);
+
+		// moving from the first view to the second over the frames, fresh G-buffers every frame
+		current = 0;
+		View moving, previousView;
+		size_t rejected = 0, pixels = 0;
+		for (uint32_t i = 0; i < frames; i++)
+		{
+			float t = frames > 1 ? float(i) / float(frames - 1) : 1.0f;
+			MakeView(Lerp(eyes[0], eyes[1], t), Lerp(targets[0], targets[1], t), width, height, light, moving);
+			frame.mPositions = moving.mPositions.data();
+			frame.mNormals = moving.mNormals.data();
+			frame.mViewProjection = moving.mViewProjection;
+			frame.mPreviousViewProjection = i > 0 ? previousView.mViewProjection : moving.mViewProjection;
+			frame.mPreviousInverseViewProjection = i > 0 ? previousView.mInverseViewProjection : moving.mInverseViewProjection;
+			settings.mHistoryValid = i > 0;
+
+			Gather(moving, image, rMax, xi, RSMLightTree::MAX_SAMPLES_COUNT, tileSize, i, interleaved);
+			RSMInterleave::Resolve(frame, settings, interleaved.data(), history[current].data(), history[1 - current].data(), output.data());
+			for (uint32_t p = 0; i > 0 && p < width * height; p++)
+			{
+				if (!HasGeometry(moving, p))
+					continue;
+				pixels++;
+				rejected += SamplesHistory(moving, p, previousView, history[current]) ? 0 : 1;
+			}
+			current = 1 - current;
+			previousView = moving;
+		}
+		double movingError = Measure(views[1], filtered[1], output);
+
+		std::printf("%-6u %10u %12.4g %12.4g %12.4g %12.4g %12.4g %10.4f\n", tileSize, RSMLightTree::MAX_SAMPLES_COUNT / (tileSize * tileSize),
+			interleavedError, filterError, resolvedError, temporalError, movingError, double(rejected) / double(std::max<size_t>(pixels, 1)));
+		if (tileSize > 1)
+		{
+			halved &= resolvedError <= 0.5 * interleavedError;
+			accumulated &= temporalError < resolvedError;
+		}
+	}
+	std::printf("\n");
+	passed &= Check("de-interleave at least halves the interleaved error", halved, "%g tile sizes", 2.0);
+	passed &= Check("accumulation lowers the resolved error", accumulated, "%g tile sizes", 2.0);
+
+	return passed ? 0 : 1;
+}
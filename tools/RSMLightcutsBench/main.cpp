@@ -0,0 +1,443 @@
+// Compares the hierarchical VPL gather of the RSM (RSMLightTree) with the 512 sample RSM pass on captured or
+// synthetic RSM data. Per receiver pixel it evaluates
+//   samples  the RSM pass: RSM_MAX_SAMPLES_COUNT scrambled Sobol samples of the disc (RSMLightTree::GatherSamples)
+//   exact    every RSM texel of the disc with the weight the samples converge to
+//   tree     the light tree cut for each error threshold and cluster budget of the sweep ("none" is unbounded)
+// and reports the clusters evaluated per pixel and the relative RMS error of the luminance against the samples and
+// against the exact sum, plus CPU time per pixel, then the error of the default cut against the samples. The data is
+// profiling/rsm_capture.bin, the sample scene (tools/RSMSceneCapture), or the file of --capture; captures come from
+// "Capture RSM" in the scene. With --synthetic, or without the capture, it is a box room lit by a directional light,
+// ray cast into an orthographic RSM and a perspective G-buffer.
+//
+//   RSMLightcutsBench [--capture file | --synthetic] [--rsm-size n] [--width n] [--height n] [--stride n] [--leaf n] [--rmax value]
+//
+// --rsm-size, --width, --height and --rmax set up the synthetic data; --stride picks every nth receiver of the G-buffer
+// (2). Checks: a leaf size 1 tree without threshold and budget reproduces the exact sum and with the default threshold
+// stays within twice the threshold of it (larger leaves add the error of their representative, which nothing bounds),
+// no cut exceeds its budget and the default cut is within 10% of the samples.
+// Exits with 1 if a check fails and 2 on bad arguments or files. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o RSMLightcutsBench tools/RSMLightcutsBench/main.cpp source/RSMLightTree.cpp source/RSMCapture.cpp source/Sampling.cpp source/CpuProfiler.cpp
+
+#include "../Check.h"
+#include "RSMCapture.h"
+#include "RSMLightTree.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: RSMLightcutsBench [--capture file | --synthetic] [--rsm-size n] [--width n] [--height n] [--stride n] [--leaf n] [--rmax value]\n";
+		return 2;
+	}
+
+	struct Vector
+	{
+		float x, y, z;
+	};
+
+	Vector operator+(Vector a, Vector b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	Vector operator-(Vector a, Vector b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	Vector operator*(Vector a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	float Dot(Vector a, Vector b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	Vector Cross(Vector a, Vector b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+	Vector Normalize(Vector a) { return a * (1.0f / std::sqrt(Dot(a, a))); }
+
+	struct Box
+	{
+		Vector mMin, mMax, mAlbedo;
+	};
+
+	// A room with a red and a green wall and two boxes
+	const Box Boxes[] = {
+		{ { -10.0f, -1.0f, -10.0f }, { 10.0f, 0.0f, 10.0f }, { 0.7f, 0.7f, 0.7f } },
+		{ { -10.0f, 0.0f, -11.0f }, { 10.0f, 10.0f, -10.0f }, { 0.8f, 0.1f, 0.1f } },
+		{ { -11.0f, 0.0f, -10.0f }, { -10.0f, 10.0f, 10.0f }, { 0.1f, 0.8f, 0.1f } },
+		{ { -3.0f, 0.0f, -3.0f }, { 0.0f, 3.0f, 0.0f }, { 0.9f, 0.9f, 0.8f } },
+		{ { 2.0f, 0.0f, 1.0f }, { 5.0f, 6.0f, 4.0f }, { 0.1f, 0.2f, 0.9f } },
+	};
+
+	bool Trace(Vector origin, Vector direction, Vector& position, Vector& normal, Vector& albedo)
+	{
+		float nearest = std::numeric_limits<float>::max();
+		for (const Box& box : Boxes)
+		{
+			const float o[3] = { origin.x, origin.y, origin.z };
+			const float d[3] = { direction.x, direction.y, direction.z };
+			const float lo[3] = { box.mMin.x, box.mMin.y, box.mMin.z };
+			const float hi[3] = { box.mMax.x, box.mMax.y, box.mMax.z };
+			float enter = 0.0f, exit = nearest;
+			int axis = -1;
+			float sign = 0.0f;
+			for (int i = 0; i < 3; i++)
+			{
+				if (d[i] == 0.0f)
+				{
+					if (o[i] < lo[i] || o[i] > hi[i])
+						enter = exit + 1.0f;
+					continue;
+				}
+				float t0 = (lo[i] - o[i]) / d[i];
+				float t1 = (hi[i] - o[i]) / d[i];
+				float faceSign = -1.0f;
+				if (t0 > t1)
+				{
+					std::swap(t0, t1);
+					faceSign = 1.0f;
+				}
+				if (t0 > enter)
+				{
+					enter = t0;
+					axis = i;
+					sign = faceSign;
+				}
+				exit = std::min(exit, t1);
+			}
+			if (axis >= 0 && enter <= exit && enter < nearest)
+			{
+				nearest = enter;
+				position = origin + direction * enter;
+				float n[3] = { 0.0f, 0.0f, 0.0f };
+				n[axis] = sign;
+				normal = { n[0], n[1], n[2] };
+				albedo = box.mAlbedo;
+			}
+		}
+		return nearest < std::numeric_limits<float>::max();
+	}
+
+	void Store(std::vector<float>& data, size_t index, Vector value, float w)
+	{
+		data[index * 4] = value.x;
+		data[index * 4 + 1] = value.y;
+		data[index * 4 + 2] = value.z;
+		data[index * 4 + 3] = w;
+	}
+
+	void MakeSyntheticCapture(uint32_t rsmSize, uint32_t width, uint32_t height, float rMax, RSMCapture& capture)
+	{
+		// orthographic light looking down the light direction, clip = [p 1] * M
+		const Vector direction = Normalize({ -0.5f, -1.0f, -0.6f });
+		const Vector right = Normalize(Cross({ 0.0f, 1.0f, 0.0f }, direction));
+		const Vector up = Cross(direction, right);
+		const Vector center = { 0.0f, 2.0f, 0.0f };
+		const float extent = 16.0f;
+		const float depth = 60.0f;
+		const Vector axes[3] = { right * (1.0f / extent), up * (1.0f / extent), direction * (1.0f / depth) };
+		float* m = capture.mShadowViewProjection;
+		for (int column = 0; column < 3; column++)
+		{
+			m[column] = axes[column].x;
+			m[4 + column] = axes[column].y;
+			m[8 + column] = axes[column].z;
+			m[12 + column] = -Dot(center, axes[column]) + (column == 2 ? 0.5f : 0.0f);
+		}
+		m[3] = m[7] = m[11] = 0.0f;
+		m[15] = 1.0f;
+
+		capture.mRSMSize = rsmSize;
+		capture.mRMax = rMax;
+		const size_t texels = size_t(rsmSize) * rsmSize;
+		capture.mRSMPositions.assign(texels * 4, 0.0f);
+		capture.mRSMNormals.assign(texels * 4, 0.0f);
+		capture.mRSMFlux.assign(texels * 4, 0.0f);
+		for (uint32_t y = 0; y < rsmSize; y++)
+		{
+			for (uint32_t x = 0; x < rsmSize; x++)
+			{
+				float cx = ((float(x) + 0.5f) / float(rsmSize) - 0.5f) * 2.0f * extent;
+				float cy = (0.5f - (float(y) + 0.5f) / float(rsmSize)) * 2.0f * extent;
+				Vector origin = center + right * cx + up * cy - direction * (0.5f * depth);
+				Vector position, normal, albedo;
+				if (!Trace(origin, direction, position, normal, albedo))
+					continue;
+				size_t index = size_t(y) * rsmSize + x;
+				Store(capture.mRSMPositions, index, position, 1.0f);
+				Store(capture.mRSMNormals, index, normal, 0.0f);
+				Store(capture.mRSMFlux, index, albedo * std::max(-Dot(normal, direction), 0.0f), 1.0f);
+			}
+		}
+
+		// perspective camera
+		const Vector eye = { 8.0f, 9.0f, 12.0f };
+		const Vector forward = Normalize(Vector{ -2.0f, 1.0f, -3.0f } - eye);
+		const Vector cameraRight = Normalize(Cross(forward, { 0.0f, 1.0f, 0.0f }));
+		const Vector cameraUp = Cross(cameraRight, forward);
+		const float tanHalf = std::tan(0.5f * 1.0472f);
+		const float aspect = float(width) / float(height);
+		capture.mWidth = width;
+		capture.mHeight = height;
+		capture.mPositions.assign(size_t(width) * height * 4, 0.0f);
+		capture.mNormals.assign(size_t(width) * height * 4, 0.0f);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				float sx = ((float(x) + 0.5f) / float(width) * 2.0f - 1.0f) * tanHalf * aspect;
+				float sy = (1.0f - (float(y) + 0.5f) / float(height) * 2.0f) * tanHalf;
+				Vector ray = Normalize(forward + cameraRight * sx + cameraUp * sy);
+				Vector position, normal, albedo;
+				if (!Trace(eye, ray, position, normal, albedo))
+					continue;
+				size_t index = size_t(y) * width + x;
+				Store(capture.mPositions, index, position, 1.0f);
+				Store(capture.mNormals, index, normal, 0.0f);
+			}
+		}
+	}
+
+	struct Pixel
+	{
+		RSMLightTree::Receiver mReceiver;
+		float mSamples = 0.0f;
+		float mExact = 0.0f;
+	};
+
+	struct Errors
+	{
+		double mAgainstSamples = 0.0;
+		double mAgainstExact = 0.0;
+	};
+
+	// Relative RMS of the luminance
+	Errors Measure(const std::vector<Pixel>& pixels, const std::vector<float>& values)
+	{
+		double samples = 0.0, exact = 0.0, errorSamples = 0.0, errorExact = 0.0;
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			samples += double(pixels[i].mSamples) * pixels[i].mSamples;
+			exact += double(pixels[i].mExact) * pixels[i].mExact;
+			errorSamples += double(values[i] - pixels[i].mSamples) * (values[i] - pixels[i].mSamples);
+			errorExact += double(values[i] - pixels[i].mExact) * (values[i] - pixels[i].mExact);
+		}
+		Errors errors;
+		errors.mAgainstSamples = samples > 0.0 ? std::sqrt(errorSamples / samples) : 0.0;
+		errors.mAgainstExact = exact > 0.0 ? std::sqrt(errorExact / exact) : 0.0;
+		return errors;
+	}
+
+	double Seconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string capturePath;
+	uint32_t rsmSize = 2048;
+	uint32_t width = 256;
+	uint32_t height = 144;
+	uint32_t stride = 2;
+	bool synthetic = false;
+	uint32_t leafSize = 4;
+	float rMax = 0.035f;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--capture" && hasValue)
+			capturePath = argv[++i];
+		else if (arg == "--synthetic")
+			synthetic = true;
+		else if (arg == "--rsm-size" && hasValue)
+			rsmSize = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--width" && hasValue)
+			width = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--height" && hasValue)
+			height = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--stride" && hasValue)
+			stride = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--leaf" && hasValue)
+			leafSize = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--rmax" && hasValue)
+			rMax = float(std::atof(argv[++i]));
+		else
+			return Usage();
+	}
+
+	if (capturePath.empty() && !synthetic)
+	{
+		std::filesystem::path scene = FindRepoRoot(argv[0]) / "profiling" / "rsm_capture.bin";
+		std::error_code exists;
+		if (std::filesystem::is_regular_file(scene, exists))
+			capturePath = scene.string();
+	}
+	else if (synthetic)
+		capturePath.clear();
+
+	RSMCapture capture;
+	std::string error;
+	if (!capturePath.empty())
+	{
+		if (!capture.Load(capturePath, error))
+		{
+			std::cerr << error << "\n";
+			return 2;
+		}
+		rMax = capture.mRMax;
+	}
+	else
+		MakeSyntheticCapture(rsmSize, width, height, rMax, capture);
+
+	RSMLightTree::Image image;
+	image.mPositions = capture.mRSMPositions.data();
+	image.mNormals = capture.mRSMNormals.data();
+	image.mFlux = capture.mRSMFlux.data();
+	image.mSize = capture.mRSMSize;
+
+	RSMLightTree tree;
+	auto start = std::chrono::steady_clock::now();
+	if (!tree.Build(image, leafSize, error))
+	{
+		std::cerr << error << "\n";
+		return 2;
+	}
+	double buildSeconds = Seconds(start);
+
+	std::vector<float> xi;
+	RSMLightTree::MakeSamples(RSMLightTree::MAX_SAMPLES_COUNT, xi);
+
+	// receivers with geometry, as the RSM pass reads them at its reduced resolution
+	std::vector<Pixel> pixels;
+	for (uint32_t y = 0; y < capture.mHeight; y += stride)
+	{
+		for (uint32_t x = 0; x < capture.mWidth; x += stride)
+		{
+			size_t index = (size_t(y) * capture.mWidth + x) * 4;
+			Pixel pixel;
+			for (int i = 0; i < 3; i++)
+			{
+				pixel.mReceiver.mPosition[i] = capture.mPositions[index + i];
+				pixel.mReceiver.mNormal[i] = capture.mNormals[index + i];
+			}
+			if (pixel.mReceiver.mNormal[0] == 0.0f && pixel.mReceiver.mNormal[1] == 0.0f && pixel.mReceiver.mNormal[2] == 0.0f)
+				continue;
+			capture.Project(pixel.mReceiver.mPosition, pixel.mReceiver.mUV);
+			pixels.push_back(pixel);
+		}
+	}
+
+	float rgb[3];
+	start = std::chrono::steady_clock::now();
+	for (Pixel& pixel : pixels)
+	{
+		RSMLightTree::GatherSamples(image, pixel.mReceiver, rMax, xi.data(), RSMLightTree::MAX_SAMPLES_COUNT, rgb);
+		pixel.mSamples = RSMLightTree::GetLuminance(rgb);
+	}
+	double samplesSeconds = Seconds(start);
+	start = std::chrono::steady_clock::now();
+	for (Pixel& pixel : pixels)
+	{
+		RSMLightTree::GatherExact(image, pixel.mReceiver, rMax, rgb);
+		pixel.mExact = RSMLightTree::GetLuminance(rgb);
+	}
+	double exactSeconds = Seconds(start);
+
+	std::vector<float> samples(pixels.size());
+	for (size_t i = 0; i < pixels.size(); i++)
+		samples[i] = pixels[i].mSamples;
+	Errors sampleErrors = Measure(pixels, samples);
+	const double pixelCount = double(std::max<size_t>(pixels.size(), 1));
+
+	std::printf("%s: RSM %u, leaf %u (%zu nodes, built in %.1f ms), %zu receivers, RMax %g, start level %u\n\n",
+		capturePath.empty() ? "synthetic" : capturePath.c_str(), image.mSize, leafSize, tree.GetNodes().size(), buildSeconds * 1e3,
+		pixels.size(), rMax, RSMLightTree::GetStartLevel(rMax, tree.GetLeafLevel()));
+	std::printf("%-22s %10s %8s %8s %9s %14s %14s %10s\n", "Gather", "Threshold", "Budget", "Mean", "Max", "vs samples", "vs exact", "us/pixel");
+	std::printf("%-22s %10s %8s %8u %9u %14s %14.4g %10.2f\n", "samples", "-", "-", RSMLightTree::MAX_SAMPLES_COUNT, RSMLightTree::MAX_SAMPLES_COUNT,
+		"-", sampleErrors.mAgainstExact, samplesSeconds * 1e6 / pixelCount);
+	std::printf("%-22s %10s %8s %8s %9s %14.4g %14s %10.2f\n", "exact", "-", "-", "disc", "disc", sampleErrors.mAgainstSamples, "-", exactSeconds * 1e6 / pixelCount);
+
+	bool passed = true;
+	bool withinBudget = true;
+	Errors defaultErrors;
+	const uint32_t unbounded = std::numeric_limits<uint32_t>::max();
+	const float thresholds[] = { 0.005f, RSMLightTree::DEFAULT_ERROR_THRESHOLD, 0.05f };
+	const uint32_t budgets[] = { 32, 64, 128, RSMLightTree::DEFAULT_MAX_CLUSTERS, 512, unbounded };
+	std::vector<float> values(pixels.size());
+	for (uint32_t budget : budgets)
+	{
+		for (float threshold : thresholds)
+		{
+			RSMLightTree::GatherSettings settings;
+			settings.mRMax = rMax;
+			settings.mErrorThreshold = threshold;
+			settings.mMaxClusters = budget;
+
+			double clusters = 0.0;
+			uint32_t maxClusters = 0;
+			start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < pixels.size(); i++)
+			{
+				RSMLightTree::GatherStats stats;
+				tree.Gather(pixels[i].mReceiver, settings, rgb, &stats);
+				values[i] = RSMLightTree::GetLuminance(rgb);
+				clusters += stats.mClusters;
+				maxClusters = std::max(maxClusters, stats.mClusters);
+			}
+			double seconds = Seconds(start);
+			Errors errors = Measure(pixels, values);
+			withinBudget &= maxClusters <= budget;
+			std::printf("%-22s %10g %8s %8.1f %9u %14.4g %14.4g %10.2f\n", "tree", threshold,
+				budget == unbounded ? "none" : std::to_string(budget).c_str(), clusters / pixelCount, maxClusters,
+				errors.mAgainstSamples, errors.mAgainstExact, seconds * 1e6 / pixelCount);
+			if (threshold == RSMLightTree::DEFAULT_ERROR_THRESHOLD && budget == RSMLightTree::DEFAULT_MAX_CLUSTERS)
+				defaultErrors = errors;
+		}
+	}
+	std::printf("\ndefault cut (threshold %g, budget %u): relative RMS %.3g against the %u samples, which are %.3g from the exact sum\n\n",
+		RSMLightTree::DEFAULT_ERROR_THRESHOLD, RSMLightTree::DEFAULT_MAX_CLUSTERS, defaultErrors.mAgainstSamples, RSMLightTree::MAX_SAMPLES_COUNT,
+		sampleErrors.mAgainstExact);
+
+	// without threshold and budget a tree of single texels is the exact sum, with the default threshold its error is
+	// what the bounds allow; subsets of the receivers keep it quick
+	Errors texelErrors;
+	{
+		RSMLightTree texelTree;
+		if (!texelTree.Build(image, 1, error))
+		{
+			std::cerr << error << "\n";
+			return 2;
+		}
+		RSMLightTree::GatherSettings settings;
+		settings.mRMax = rMax;
+		settings.mErrorThreshold = 0.0f;
+		settings.mMaxClusters = std::numeric_limits<uint32_t>::max();
+		double difference = 0.0, exact = 0.0;
+		for (size_t i = 0; i < pixels.size(); i += 97)
+		{
+			texelTree.Gather(pixels[i].mReceiver, settings, rgb);
+			difference += std::fabs(RSMLightTree::GetLuminance(rgb) - pixels[i].mExact);
+			exact += pixels[i].mExact;
+		}
+		double relative = exact > 0.0 ? difference / exact : difference;
+		passed &= Check("full texel tree reproduces the exact sum", relative < 1e-4, "relative error %.2g", relative);
+
+		settings.mErrorThreshold = RSMLightTree::DEFAULT_ERROR_THRESHOLD;
+		std::vector<Pixel> subset;
+		std::vector<float> subsetValues;
+		for (size_t i = 0; i < pixels.size(); i += 13)
+		{
+			texelTree.Gather(pixels[i].mReceiver, settings, rgb);
+			subset.push_back(pixels[i]);
+			subsetValues.push_back(RSMLightTree::GetLuminance(rgb));
+		}
+		texelErrors = Measure(subset, subsetValues);
+	}
+	passed &= Check("cuts stay within their budget", withinBudget, "%g budgets", double(sizeof(budgets) / sizeof(budgets[0])));
+	passed &= Check("unbounded texel cut is within twice the threshold", texelErrors.mAgainstExact <= 2.0 * RSMLightTree::DEFAULT_ERROR_THRESHOLD,
+		"relative RMS %.3g", texelErrors.mAgainstExact);
+	passed &= Check("default cut is within 10% of the samples", defaultErrors.mAgainstSamples <= 0.1, "relative RMS %.3g", defaultErrors.mAgainstSamples);
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,921 @@
+// Writes an RSM capture (RSMCapture) of the sample scene of DXRSExampleGIScene without a GPU, for machines that can't
+// run the sandbox and press "Capture RSM". It reads the scene's models from content/models (binary FBX), places them
+// with the world matrices and colours of the scene's constructor and ray casts what the passes would rasterize:
+//   RSM       ShadowMapping.hlsl PSRSM from the scene's light (the default light direction and colour): world
+//             position, the normal reflected about the light direction, flux = colour * light colour in 8 bits
+//   G-buffer  GBuffer.hlsl world positions and normals from the start camera (0, 7, 33) looking down -z, 60 degrees
+// The scene's RSM spans 256 units in RSM_SIZE texels, most of them empty. The capture keeps that texel size but
+// crops the RSM to the power of two square around the models, and scales RMax so the gather disc keeps its size in
+// the world. The light enters the room through the opening in its ceiling, the top of the ceiling fills the rest.
+//
+//   RSMSceneCapture <output> [--width n] [--height n]
+//
+// --width and --height are of the G-buffer (320 x 180). Exits with 2 on bad arguments or models.
+// Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o RSMSceneCapture tools/RSMSceneCapture/main.cpp source/RSMCapture.cpp
+
+#include "../Check.h"
+#include "RSMCapture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: RSMSceneCapture <output> [--width n] [--height n]\n";
+		return 2;
+	}
+
+	// as DXRSExampleGIScene.h
+	const uint32_t SCENE_RSM_SIZE = 2048;
+	const float SCENE_RSM_EXTENT = 256.0f;
+	const float SCENE_RMAX = 0.035f;
+	const float LIGHT_DIRECTION[3] = { 0.191f, 1.0f, 0.574f };
+	const float LIGHT_COLOR[3] = { 0.9f, 0.9f, 0.9f };
+	const float CAMERA_POSITION[3] = { 0.0f, 7.0f, 33.0f };
+	const float CAMERA_FOV = 60.0f;
+
+	struct Vector
+	{
+		float x, y, z;
+	};
+
+	Vector operator+(Vector a, Vector b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	Vector operator-(Vector a, Vector b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	Vector operator*(Vector a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	float Dot(Vector a, Vector b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	Vector Cross(Vector a, Vector b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+	Vector Normalize(Vector a) { return a * (1.0f / std::sqrt(Dot(a, a))); }
+	float Get(Vector a, int axis) { return axis == 0 ? a.x : axis == 1 ? a.y : a.z; }
+
+	// Row major, applied to row vectors as in DirectXMath
+	struct Matrix
+	{
+		float m[16];
+	};
+
+	Matrix Identity()
+	{
+		return { { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 } };
+	}
+
+	Matrix Multiply(const Matrix& a, const Matrix& b)
+	{
+		Matrix result;
+		for (int row = 0; row < 4; row++)
+			for (int column = 0; column < 4; column++)
+				result.m[row * 4 + column] = a.m[row * 4] * b.m[column] + a.m[row * 4 + 1] * b.m[4 + column] + a.m[row * 4 + 2] * b.m[8 + column] + a.m[row * 4 + 3] * b.m[12 + column];
+		return result;
+	}
+
+	Matrix RotationX(float angle)
+	{
+		float s = std::sin(angle), c = std::cos(angle);
+		return { { 1, 0, 0, 0, 0, c, s, 0, 0, -s, c, 0, 0, 0, 0, 1 } };
+	}
+
+	Matrix RotationY(float angle)
+	{
+		float s = std::sin(angle), c = std::cos(angle);
+		return { { c, 0, -s, 0, 0, 1, 0, 0, s, 0, c, 0, 0, 0, 0, 1 } };
+	}
+
+	Matrix Translation(float x, float y, float z)
+	{
+		return { { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, x, y, z, 1 } };
+	}
+
+	Vector TransformPoint(Vector p, const Matrix& matrix)
+	{
+		const float* m = matrix.m;
+		return { p.x * m[0] + p.y * m[4] + p.z * m[8] + m[12], p.x * m[1] + p.y * m[5] + p.z * m[9] + m[13], p.x * m[2] + p.y * m[6] + p.z * m[10] + m[14] };
+	}
+
+	Vector TransformNormal(Vector n, const Matrix& matrix)
+	{
+		const float* m = matrix.m;
+		return { n.x * m[0] + n.y * m[4] + n.z * m[8], n.x * m[1] + n.y * m[5] + n.z * m[9], n.x * m[2] + n.y * m[6] + n.z * m[10] };
+	}
+
+	// Inflate of RFC 1950/1951 streams, as FBX compresses its arrays
+	class Inflater
+	{
+	public:
+		Inflater(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+		bool Run(std::vector<uint8_t>& output)
+		{
+			// zlib header, the adler32 at the end isn't checked
+			if (mSize < 2 || (mData[0] & 0x0F) != 8 || ((mData[0] << 8) | mData[1]) % 31 != 0)
+				return false;
+			mPosition = 2;
+			bool last = false;
+			while (!last)
+			{
+				last = Bits(1) != 0;
+				uint32_t type = Bits(2);
+				bool ok = type == 0 ? Stored(output) : type == 1 ? Fixed(output) : type == 2 ? Dynamic(output) : false;
+				if (!ok || mOverrun)
+					return false;
+			}
+			return true;
+		}
+
+	private:
+		struct Huffman
+		{
+			uint16_t mCounts[16];
+			uint16_t mSymbols[288];
+		};
+
+		uint32_t Bits(int count)
+		{
+			uint32_t value = mBitBuffer;
+			while (mBitCount < count)
+			{
+				if (mPosition >= mSize)
+				{
+					mOverrun = true;
+					return 0;
+				}
+				value |= uint32_t(mData[mPosition++]) << mBitCount;
+				mBitCount += 8;
+			}
+			mBitBuffer = value >> count;
+			mBitCount -= count;
+			return value & ((1u << count) - 1);
+		}
+
+		bool Stored(std::vector<uint8_t>& output)
+		{
+			mBitBuffer = 0;
+			mBitCount = 0;
+			if (mPosition + 4 > mSize)
+				return false;
+			uint32_t length = mData[mPosition] | (mData[mPosition + 1] << 8);
+			uint32_t complement = mData[mPosition + 2] | (mData[mPosition + 3] << 8);
+			mPosition += 4;
+			if (length != (~complement & 0xFFFF) || mPosition + length > mSize)
+				return false;
+			output.insert(output.end(), mData + mPosition, mData + mPosition + length);
+			mPosition += length;
+			return true;
+		}
+
+		static void Build(Huffman& huffman, const uint16_t* lengths, int count)
+		{
+			std::fill(std::begin(huffman.mCounts), std::end(huffman.mCounts), uint16_t(0));
+			for (int symbol = 0; symbol < count; symbol++)
+				huffman.mCounts[lengths[symbol]]++;
+			uint16_t offsets[16] = {};
+			for (int length = 1; length < 15; length++)
+				offsets[length + 1] = offsets[length] + huffman.mCounts[length];
+			for (int symbol = 0; symbol < count; symbol++)
+			{
+				if (lengths[symbol] != 0)
+					huffman.mSymbols[offsets[lengths[symbol]]++] = uint16_t(symbol);
+			}
+		}
+
+		int Decode(const Huffman& huffman)
+		{
+			int code = 0, first = 0, index = 0;
+			for (int length = 1; length < 16; length++)
+			{
+				code |= int(Bits(1));
+				int count = huffman.mCounts[length];
+				if (code - count < first)
+					return huffman.mSymbols[index + (code - first)];
+				index += count;
+				first = (first + count) << 1;
+				code <<= 1;
+				if (mOverrun)
+					return -1;
+			}
+			return -1;
+		}
+
+		bool Codes(std::vector<uint8_t>& output, const Huffman& lengthCodes, const Huffman& distanceCodes)
+		{
+			static const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+			static const uint16_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+			static const uint16_t DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+			static const uint16_t DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+			for (;;)
+			{
+				int symbol = Decode(lengthCodes);
+				if (symbol < 0 || symbol > 285)
+					return false;
+				if (symbol < 256)
+				{
+					output.push_back(uint8_t(symbol));
+					continue;
+				}
+				if (symbol == 256)
+					return true;
+				symbol -= 257;
+				size_t length = LENGTH_BASE[symbol] + Bits(LENGTH_EXTRA[symbol]);
+				int distanceSymbol = Decode(distanceCodes);
+				if (distanceSymbol < 0 || distanceSymbol > 29)
+					return false;
+				size_t distance = DISTANCE_BASE[distanceSymbol] + Bits(DISTANCE_EXTRA[distanceSymbol]);
+				if (distance > output.size() || mOverrun)
+					return false;
+				size_t from = output.size() - distance;
+				for (size_t i = 0; i < length; i++)
+					output.push_back(output[from + i]);
+			}
+		}
+
+		bool Fixed(std::vector<uint8_t>& output)
+		{
+			uint16_t lengths[288];
+			for (int symbol = 0; symbol < 288; symbol++)
+				lengths[symbol] = symbol < 144 ? 8 : symbol < 256 ? 9 : symbol < 280 ? 7 : 8;
+			Huffman lengthCodes, distanceCodes;
+			Build(lengthCodes, lengths, 288);
+			std::fill(lengths, lengths + 30, uint16_t(5));
+			Build(distanceCodes, lengths, 30);
+			return Codes(output, lengthCodes, distanceCodes);
+		}
+
+		bool Dynamic(std::vector<uint8_t>& output)
+		{
+			static const uint8_t ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+			int lengthCount = int(Bits(5)) + 257;
+			int distanceCount = int(Bits(5)) + 1;
+			int codeCount = int(Bits(4)) + 4;
+			if (lengthCount > 286 || distanceCount > 30)
+				return false;
+
+			uint16_t lengths[320] = {};
+			for (int i = 0; i < codeCount; i++)
+				lengths[ORDER[i]] = uint16_t(Bits(3));
+			Huffman codeCodes;
+			Build(codeCodes, lengths, 19);
+
+			int index = 0;
+			while (index < lengthCount + distanceCount)
+			{
+				int symbol = Decode(codeCodes);
+				if (symbol < 0)
+					return false;
+				if (symbol < 16)
+				{
+					lengths[index++] = uint16_t(symbol);
+					continue;
+				}
+				uint16_t value = 0;
+				int repeat;
+				if (symbol == 16)
+				{
+					if (index == 0)
+						return false;
+					value = lengths[index - 1];
+					repeat = 3 + int(Bits(2));
+				}
+				else if (symbol == 17)
+					repeat = 3 + int(Bits(3));
+				else
+					repeat = 11 + int(Bits(7));
+				if (index + repeat > lengthCount + distanceCount)
+					return false;
+				while (repeat-- > 0)
+					lengths[index++] = value;
+			}
+
+			Huffman lengthCodes, distanceCodes;
+			Build(lengthCodes, lengths, lengthCount);
+			Build(distanceCodes, lengths + lengthCount, distanceCount);
+			return Codes(output, lengthCodes, distanceCodes);
+		}
+
+		const uint8_t* mData;
+		size_t mSize;
+		size_t mPosition = 0;
+		uint32_t mBitBuffer = 0;
+		int mBitCount = 0;
+		bool mOverrun = false;
+	};
+
+	// The node tree of a binary FBX file, keeping only the properties the geometry needs
+	struct FBXNode
+	{
+		std::string mName;
+		std::vector<std::string> mStrings;
+		std::vector<double> mNumbers;	// of 'd', 'f', 'i' and 'l' arrays and scalars
+		std::vector<std::unique_ptr<FBXNode>> mChildren;
+
+		const FBXNode* Find(const std::string& name) const
+		{
+			for (const auto& child : mChildren)
+			{
+				if (child->mName == name)
+					return child.get();
+			}
+			return nullptr;
+		}
+	};
+
+	class FBXReader
+	{
+	public:
+		bool Read(const std::string& path, FBXNode& root, std::string& error)
+		{
+			std::ifstream file(path, std::ios::binary);
+			mData.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			if (mData.size() < 27 || std::memcmp(mData.data(), "Kaydara FBX Binary  ", 20) != 0)
+			{
+				error = path + " is not a binary FBX file";
+				return false;
+			}
+			mVersion = Load<uint32_t>(23);
+			size_t position = 27;
+			for (;;)
+			{
+				auto node = std::make_unique<FBXNode>();
+				bool isNull = false;
+				if (!ReadNode(position, *node, isNull))
+				{
+					error = path + " is truncated or uses an unknown property type";
+					return false;
+				}
+				if (isNull)
+					return true;
+				root.mChildren.push_back(std::move(node));
+			}
+		}
+
+	private:
+		template<typename T>
+		T Load(size_t position) const
+		{
+			T value;
+			std::memcpy(&value, &mData[position], sizeof(T));
+			return value;
+		}
+
+		bool ReadNode(size_t& position, FBXNode& node, bool& isNull)
+		{
+			const bool wide = mVersion >= 7500;
+			const size_t headerSize = wide ? 25 : 13;
+			if (position + headerSize > mData.size())
+				return false;
+			uint64_t end = wide ? Load<uint64_t>(position) : Load<uint32_t>(position);
+			uint64_t propertyCount = wide ? Load<uint64_t>(position + 8) : Load<uint32_t>(position + 4);
+			uint8_t nameLength = mData[position + headerSize - 1];
+			if (end == 0)
+			{
+				isNull = true;
+				position += headerSize;
+				return true;
+			}
+			if (end > mData.size() || position + headerSize + nameLength > end)
+				return false;
+			node.mName.assign(reinterpret_cast<const char*>(&mData[position + headerSize]), nameLength);
+			position += headerSize + nameLength;
+
+			for (uint64_t i = 0; i < propertyCount; i++)
+			{
+				if (!ReadProperty(position, node))
+					return false;
+			}
+			while (position < end)
+			{
+				auto child = std::make_unique<FBXNode>();
+				bool childIsNull = false;
+				if (!ReadNode(position, *child, childIsNull))
+					return false;
+				if (childIsNull)
+					break;
+				node.mChildren.push_back(std::move(child));
+			}
+			position = size_t(end);
+			return true;
+		}
+
+		bool ReadProperty(size_t& position, FBXNode& node)
+		{
+			if (position >= mData.size())
+				return false;
+			char type = char(mData[position++]);
+			size_t scalarSize = type == 'Y' ? 2 : type == 'C' ? 1 : (type == 'I' || type == 'F') ? 4 : (type == 'D' || type == 'L') ? 8 : 0;
+			if (scalarSize != 0)
+			{
+				if (position + scalarSize > mData.size())
+					return false;
+				if (type == 'I')
+					node.mNumbers.push_back(Load<int32_t>(position));
+				else if (type == 'F')
+					node.mNumbers.push_back(Load<float>(position));
+				else if (type == 'D')
+					node.mNumbers.push_back(Load<double>(position));
+				else if (type == 'L')
+					node.mNumbers.push_back(double(Load<int64_t>(position)));
+				position += scalarSize;
+				return true;
+			}
+			if (type == 'S' || type == 'R')
+			{
+				if (position + 4 > mData.size())
+					return false;
+				uint32_t length = Load<uint32_t>(position);
+				if (position + 4 + length > mData.size())
+					return false;
+				if (type == 'S')
+					node.mStrings.emplace_back(reinterpret_cast<const char*>(&mData[position + 4]), length);
+				position += 4 + length;
+				return true;
+			}
+
+			size_t elementSize = (type == 'f' || type == 'i') ? 4 : (type == 'd' || type == 'l') ? 8 : type == 'b' ? 1 : 0;
+			if (elementSize == 0 || position + 12 > mData.size())
+				return false;
+			uint32_t count = Load<uint32_t>(position);
+			uint32_t encoding = Load<uint32_t>(position + 4);
+			uint32_t size = Load<uint32_t>(position + 8);
+			position += 12;
+			if (position + size > mData.size())
+				return false;
+			std::vector<uint8_t> raw;
+			if (encoding == 1)
+			{
+				if (!Inflater(&mData[position], size).Run(raw))
+					return false;
+			}
+			else
+				raw.assign(mData.begin() + position, mData.begin() + position + size);
+			position += size;
+			if (raw.size() != size_t(count) * elementSize)
+				return false;
+			for (uint32_t i = 0; i < count && type != 'b'; i++)
+			{
+				const uint8_t* element = &raw[i * elementSize];
+				double value;
+				if (type == 'f')
+				{
+					float f;
+					std::memcpy(&f, element, 4);
+					value = f;
+				}
+				else if (type == 'i')
+				{
+					int32_t v;
+					std::memcpy(&v, element, 4);
+					value = v;
+				}
+				else if (type == 'd')
+					std::memcpy(&value, element, 8);
+				else
+				{
+					int64_t v;
+					std::memcpy(&v, element, 8);
+					value = double(v);
+				}
+				node.mNumbers.push_back(value);
+			}
+			return true;
+		}
+
+		std::vector<uint8_t> mData;
+		uint32_t mVersion = 0;
+	};
+
+	struct Triangle
+	{
+		Vector mPositions[3];
+		Vector mNormals[3];	// world space, not normalized, as the vertex shaders output them
+		Vector mColor;
+		float mAlpha;
+	};
+
+	// Triangulates the polygons of every mesh of the file as fans, with the normals of the polygon vertices
+	bool LoadModel(const std::string& path, const Matrix& world, Vector color, float alpha, std::vector<Triangle>& triangles, std::string& error)
+	{
+		FBXNode root;
+		if (!FBXReader().Read(path, root, error))
+			return false;
+		const FBXNode* objects = root.Find("Objects");
+		if (!objects)
+		{
+			error = path + " has no objects";
+			return false;
+		}
+		size_t before = triangles.size();
+		for (const auto& geometry : objects->mChildren)
+		{
+			if (geometry->mName != "Geometry" || std::find(geometry->mStrings.begin(), geometry->mStrings.end(), "Mesh") == geometry->mStrings.end())
+				continue;
+			const FBXNode* vertices = geometry->Find("Vertices");
+			const FBXNode* indices = geometry->Find("PolygonVertexIndex");
+			const FBXNode* normalLayer = geometry->Find("LayerElementNormal");
+			const FBXNode* normals = normalLayer ? normalLayer->Find("Normals") : nullptr;
+			const FBXNode* normalIndices = normalLayer ? normalLayer->Find("NormalsIndex") : nullptr;
+			const FBXNode* mapping = normalLayer ? normalLayer->Find("MappingInformationType") : nullptr;
+			const FBXNode* reference = normalLayer ? normalLayer->Find("ReferenceInformationType") : nullptr;
+			if (!vertices || !indices || !normals || !mapping || mapping->mStrings.empty())
+			{
+				error = path + " has a mesh without vertices, polygons or normals";
+				return false;
+			}
+			const bool byPolygonVertex = mapping->mStrings[0] == "ByPolygonVertex";
+			const bool indexed = reference && !reference->mStrings.empty() && reference->mStrings[0] == "IndexToDirect" && normalIndices;
+			if (!byPolygonVertex && mapping->mStrings[0] != "ByVertice" && mapping->mStrings[0] != "ByVertex" && mapping->mStrings[0] != "ByControlPoint")
+			{
+				error = path + " maps its normals " + mapping->mStrings[0];
+				return false;
+			}
+
+			const std::vector<double>& p = vertices->mNumbers;
+			const std::vector<double>& n = normals->mNumbers;
+			auto position = [&](size_t vertex) { return TransformPoint({ float(p[vertex * 3]), float(p[vertex * 3 + 1]), float(p[vertex * 3 + 2]) }, world); };
+			auto normal = [&](size_t polygonVertex, size_t vertex) {
+				size_t index = byPolygonVertex ? polygonVertex : vertex;
+				if (indexed)
+					index = size_t(normalIndices->mNumbers[index]);
+				return TransformNormal({ float(n[index * 3]), float(n[index * 3 + 1]), float(n[index * 3 + 2]) }, world);
+			};
+
+			std::vector<size_t> polygon;
+			const std::vector<double>& polygonIndices = indices->mNumbers;
+			for (size_t i = 0; i < polygonIndices.size(); i++)
+			{
+				polygon.push_back(i);
+				if (polygonIndices[i] >= 0)
+					continue;
+				// the last index of a polygon is stored as ~index
+				auto vertexOf = [&](size_t at) { double v = polygonIndices[at]; return size_t(v < 0 ? -v - 1 : v); };
+				for (size_t corner = 2; corner < polygon.size(); corner++)
+				{
+					const size_t fan[3] = { polygon[0], polygon[corner - 1], polygon[corner] };
+					Triangle triangle;
+					bool valid = true;
+					for (int k = 0; k < 3; k++)
+					{
+						size_t vertex = vertexOf(fan[k]);
+						size_t normalIndex = indexed ? size_t(normalIndices->mNumbers[byPolygonVertex ? fan[k] : vertex]) : (byPolygonVertex ? fan[k] : vertex);
+						valid &= vertex * 3 + 2 < p.size() && normalIndex * 3 + 2 < n.size();
+						if (!valid)
+							break;
+						triangle.mPositions[k] = position(vertex);
+						triangle.mNormals[k] = normal(fan[k], vertex);
+					}
+					if (!valid)
+					{
+						error = path + " indexes past its vertices or normals";
+						return false;
+					}
+					triangle.mColor = color;
+					triangle.mAlpha = alpha;
+					triangles.push_back(triangle);
+				}
+				polygon.clear();
+			}
+		}
+		if (triangles.size() == before)
+		{
+			error = path + " has no triangles";
+			return false;
+		}
+		return true;
+	}
+
+	struct Hit
+	{
+		float mDistance = std::numeric_limits<float>::max();
+		uint32_t mTriangle = 0;
+		float mU = 0.0f, mV = 0.0f;
+	};
+
+	// Bounding volume hierarchy of median splits, nodes are laid out depth first
+	class BVH
+	{
+	public:
+		explicit BVH(const std::vector<Triangle>& triangles) : mTriangles(triangles)
+		{
+			mOrder.resize(triangles.size());
+			for (uint32_t i = 0; i < mOrder.size(); i++)
+				mOrder[i] = i;
+			Build(0, uint32_t(mOrder.size()));
+		}
+
+		bool Trace(Vector origin, Vector direction, Hit& hit) const
+		{
+			const Vector inverse = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+			uint32_t stack[64];
+			int depth = 0;
+			stack[depth++] = 0;
+			bool found = false;
+			while (depth > 0)
+			{
+				const Node& node = mNodes[stack[--depth]];
+				if (!Overlaps(node, origin, inverse, hit.mDistance))
+					continue;
+				if (node.mCount > 0)
+				{
+					for (uint32_t i = node.mFirst; i < node.mFirst + node.mCount; i++)
+						found |= Intersect(mOrder[i], origin, direction, hit);
+				}
+				else
+				{
+					stack[depth++] = node.mFirst;
+					stack[depth++] = uint32_t(&node - mNodes.data()) + 1;
+				}
+			}
+			return found;
+		}
+
+	private:
+		struct Node
+		{
+			Vector mMin, mMax;
+			uint32_t mFirst;	// first triangle of a leaf, the second child of an inner node (the first follows it)
+			uint32_t mCount;	// 0 for inner nodes
+		};
+
+		uint32_t Build(uint32_t begin, uint32_t end)
+		{
+			uint32_t index = uint32_t(mNodes.size());
+			mNodes.push_back({});
+			Vector low = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+			Vector high = low * -1.0f;
+			for (uint32_t i = begin; i < end; i++)
+			{
+				for (const Vector& p : mTriangles[mOrder[i]].mPositions)
+				{
+					low = { std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z) };
+					high = { std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z) };
+				}
+			}
+			mNodes[index].mMin = low;
+			mNodes[index].mMax = high;
+			if (end - begin <= 4)
+			{
+				mNodes[index].mFirst = begin;
+				mNodes[index].mCount = end - begin;
+				return index;
+			}
+
+			Vector extent = high - low;
+			int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+			uint32_t middle = (begin + end) / 2;
+			std::nth_element(mOrder.begin() + begin, mOrder.begin() + middle, mOrder.begin() + end, [&](uint32_t a, uint32_t b) {
+				const Triangle& ta = mTriangles[a];
+				const Triangle& tb = mTriangles[b];
+				return Get(ta.mPositions[0], axis) + Get(ta.mPositions[1], axis) + Get(ta.mPositions[2], axis) <
+					Get(tb.mPositions[0], axis) + Get(tb.mPositions[1], axis) + Get(tb.mPositions[2], axis);
+			});
+			Build(begin, middle);
+			uint32_t second = Build(middle, end);
+			mNodes[index].mFirst = second;
+			mNodes[index].mCount = 0;
+			return index;
+		}
+
+		static bool Overlaps(const Node& node, Vector origin, Vector inverse, float distance)
+		{
+			float enter = 0.0f, exit = distance;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float t0 = (Get(node.mMin, axis) - Get(origin, axis)) * Get(inverse, axis);
+				float t1 = (Get(node.mMax, axis) - Get(origin, axis)) * Get(inverse, axis);
+				if (t0 > t1)
+					std::swap(t0, t1);
+				enter = std::max(enter, t0);
+				exit = std::min(exit, t1);
+			}
+			return enter <= exit;
+		}
+
+		// Moeller-Trumbore. The passes cull back faces: the scene flips the winding of the models on import and its
+		// front faces are clockwise, so the front faces are the ones whose FBX winding points at the viewer. The
+		// room's ceiling faces down and the light sees through it.
+		bool Intersect(uint32_t index, Vector origin, Vector direction, Hit& hit) const
+		{
+			const Triangle& triangle = mTriangles[index];
+			Vector edge1 = triangle.mPositions[1] - triangle.mPositions[0];
+			Vector edge2 = triangle.mPositions[2] - triangle.mPositions[0];
+			Vector p = Cross(direction, edge2);
+			float determinant = Dot(edge1, p);
+			if (determinant < 1e-12f)
+				return false;
+			float inverse = 1.0f / determinant;
+			Vector t = origin - triangle.mPositions[0];
+			float u = Dot(t, p) * inverse;
+			if (u < 0.0f || u > 1.0f)
+				return false;
+			Vector q = Cross(t, edge1);
+			float v = Dot(direction, q) * inverse;
+			if (v < 0.0f || u + v > 1.0f)
+				return false;
+			float distance = Dot(edge2, q) * inverse;
+			if (distance <= 0.0f || distance >= hit.mDistance)
+				return false;
+			hit = { distance, index, u, v };
+			return true;
+		}
+
+		const std::vector<Triangle>& mTriangles;
+		std::vector<uint32_t> mOrder;
+		std::vector<Node> mNodes;
+	};
+
+	Vector Interpolate(const Vector values[3], const Hit& hit)
+	{
+		return values[0] * (1.0f - hit.mU - hit.mV) + values[1] * hit.mU + values[2] * hit.mV;
+	}
+
+	void Store(std::vector<float>& data, size_t index, Vector value, float w)
+	{
+		data[index * 4] = value.x;
+		data[index * 4 + 1] = value.y;
+		data[index * 4 + 2] = value.z;
+		data[index * 4 + 3] = w;
+	}
+
+	float Unorm8(float value)
+	{
+		return std::round(std::min(std::max(value, 0.0f), 1.0f) * 255.0f) / 255.0f;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argv[1][0] == '-')
+		return Usage();
+	std::string outputPath = argv[1];
+	uint32_t width = 320;
+	uint32_t height = 180;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--width" && hasValue)
+			width = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--height" && hasValue)
+			height = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else
+			return Usage();
+	}
+
+	// the static models of DXRSExampleGIScene::DXRSExampleGIScene, the dynamic spheres are off by default
+	const float PI = 3.14159265f;
+	struct Model
+	{
+		const char* mFile;
+		Matrix mWorld;
+		Vector mColor;
+		float mAlpha;
+	};
+	const Model models[] = {
+		{ "room.fbx", RotationX(-PI / 2.0f), { 0.7f, 0.7f, 0.7f }, 0.0f },
+		{ "dragon.fbx", Translation(1.5f, 0.0f, -7.0f), { 0.044f, 0.627f, 0.0f }, 0.0f },
+		{ "bunny.fbx", Multiply(RotationY(-0.3752457f), Translation(21.0f, 13.9f, -19.0f)), { 0.8f, 0.71f, 0.0f }, 0.0f },
+		{ "torus.fbx", Multiply(Multiply(RotationX(-PI / 2.0f), RotationX(1.099557f)), Translation(21.0f, 4.0f, -9.6f)), { 0.329f, 0.26f, 0.8f }, 0.8f },
+		{ "sphere_big.fbx", Translation(-17.25f, -1.15f, -24.15f), { 0.692f, 0.215f, 0.0f }, 0.6f },
+		{ "sphere_medium.fbx", Translation(-21.0f, -0.95f, -13.20f), { 0.005f, 0.8f, 0.426f }, 0.7f },
+		{ "sphere_small.fbx", Translation(-11.25f, -0.45f, -16.20f), { 0.01f, 0.0f, 0.8f }, 0.75f },
+		{ "block.fbx", Multiply(RotationX(-PI / 2.0f), Translation(3.0f, 8.0f, -30.0f)), { 0.9f, 0.15f, 1.0f }, 0.0f },
+		{ "cube.fbx", Multiply(Multiply(RotationX(-PI / 2.0f), RotationY(-0.907571f)), Translation(21.0f, 5.0f, -19.0f)), { 0.1f, 0.75f, 0.8f }, 0.0f },
+	};
+
+	const std::filesystem::path root = FindRepoRoot(argv[0]);
+	std::vector<Triangle> triangles;
+	std::string error;
+	for (const Model& model : models)
+	{
+		if (!LoadModel((root / "content" / "models" / model.mFile).string(), model.mWorld, model.mColor, model.mAlpha, triangles, error))
+		{
+			std::cerr << error << "\n";
+			return 2;
+		}
+	}
+	BVH bvh(triangles);
+
+	// the light view of the scene: XMMatrixLookToRH from the origin down the light direction, y up
+	const Vector lightVector = { LIGHT_DIRECTION[0], LIGHT_DIRECTION[1], LIGHT_DIRECTION[2] };
+	const Vector back = Normalize(lightVector);
+	const Vector right = Normalize(Cross({ 0.0f, 1.0f, 0.0f }, back));
+	const Vector up = Cross(back, right);
+
+	// the square of the light view around the models, in texels of the scene's RSM
+	float low[2] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+	float high[2] = { -low[0], -low[1] };
+	for (const Triangle& triangle : triangles)
+	{
+		for (const Vector& p : triangle.mPositions)
+		{
+			low[0] = std::min(low[0], Dot(p, right));
+			high[0] = std::max(high[0], Dot(p, right));
+			low[1] = std::min(low[1], Dot(p, up));
+			high[1] = std::max(high[1], Dot(p, up));
+		}
+	}
+	const float texel = SCENE_RSM_EXTENT / float(SCENE_RSM_SIZE);
+	// RSMLightTree needs a power of two
+	const uint32_t neededSize = uint32_t(std::ceil(std::max(high[0] - low[0], high[1] - low[1]) / texel)) + 2;
+	uint32_t rsmSize = 1;
+	while (rsmSize < neededSize)
+		rsmSize <<= 1;
+	const float extent = float(rsmSize) * texel;
+	const float center[2] = { 0.5f * (low[0] + high[0]), 0.5f * (low[1] + high[1]) };
+
+	RSMCapture capture;
+	capture.mRSMSize = rsmSize;
+	capture.mRMax = SCENE_RMAX * SCENE_RSM_EXTENT / extent;
+	// view * XMMatrixOrthographicOffCenterRH of the square, depth as the scene's [-256, 256]
+	Matrix view = Identity();
+	const Vector axes[3] = { right, up, back };
+	for (int column = 0; column < 3; column++)
+	{
+		view.m[column] = axes[column].x;
+		view.m[4 + column] = axes[column].y;
+		view.m[8 + column] = axes[column].z;
+	}
+	Matrix projection = Identity();
+	projection.m[0] = 2.0f / extent;
+	projection.m[5] = 2.0f / extent;
+	projection.m[10] = 1.0f / (-256.0f - 256.0f);
+	projection.m[12] = -2.0f * center[0] / extent;
+	projection.m[13] = -2.0f * center[1] / extent;
+	projection.m[14] = -256.0f / (-256.0f - 256.0f);
+	Matrix viewProjection = Multiply(view, projection);
+	std::copy(std::begin(viewProjection.m), std::end(viewProjection.m), capture.mShadowViewProjection);
+
+	const size_t texels = size_t(rsmSize) * rsmSize;
+	capture.mRSMPositions.assign(texels * 4, 0.0f);
+	capture.mRSMNormals.assign(texels * 4, 0.0f);
+	capture.mRSMFlux.assign(texels * 4, 0.0f);
+	const Vector lightDir = lightVector * -1.0f;	// LightDir of ShadowMappingCB
+	for (uint32_t y = 0; y < rsmSize; y++)
+	{
+		for (uint32_t x = 0; x < rsmSize; x++)
+		{
+			float cx = center[0] + ((float(x) + 0.5f) / float(rsmSize) - 0.5f) * extent;
+			float cy = center[1] + (0.5f - (float(y) + 0.5f) / float(rsmSize)) * extent;
+			Vector origin = right * cx + up * cy + back * 256.0f;
+			Hit hit;
+			if (!bvh.Trace(origin, back * -1.0f, hit))
+				continue;
+			const Triangle& triangle = triangles[hit.mTriangle];
+			size_t index = size_t(y) * rsmSize + x;
+			// PSRSM: normalize(reflect(normal, LightDir)) and DiffuseColor * LightColor into R8G8B8A8_UNORM
+			Vector normal = Interpolate(triangle.mNormals, hit);
+			Vector reflected = Normalize(normal - lightDir * (2.0f * Dot(normal, lightDir)));
+			Vector flux = { Unorm8(triangle.mColor.x * LIGHT_COLOR[0]), Unorm8(triangle.mColor.y * LIGHT_COLOR[1]), Unorm8(triangle.mColor.z * LIGHT_COLOR[2]) };
+			Store(capture.mRSMPositions, index, origin + back * (-hit.mDistance), 1.0f);
+			Store(capture.mRSMNormals, index, reflected, 0.0f);
+			Store(capture.mRSMFlux, index, flux, Unorm8(triangle.mAlpha));
+		}
+	}
+
+	// the start camera: XMMatrixPerspectiveFovRH, DXRSCamera looks down -z with y up
+	const Vector eye = { CAMERA_POSITION[0], CAMERA_POSITION[1], CAMERA_POSITION[2] };
+	const float tanHalf = std::tan(0.5f * CAMERA_FOV * PI / 180.0f);
+	const float aspect = float(width) / float(height);
+	capture.mWidth = width;
+	capture.mHeight = height;
+	capture.mPositions.assign(size_t(width) * height * 4, 0.0f);
+	capture.mNormals.assign(size_t(width) * height * 4, 0.0f);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			float sx = ((float(x) + 0.5f) / float(width) * 2.0f - 1.0f) * tanHalf * aspect;
+			float sy = (1.0f - (float(y) + 0.5f) / float(height) * 2.0f) * tanHalf;
+			Vector ray = Normalize({ sx, sy, -1.0f });
+			Hit hit;
+			if (!bvh.Trace(eye, ray, hit))
+				continue;
+			const Triangle& triangle = triangles[hit.mTriangle];
+			size_t index = size_t(y) * width + x;
+			// R16G16B16A16_SNORM clamps the normal
+			Vector normal = Interpolate(triangle.mNormals, hit);
+			normal = { std::min(std::max(normal.x, -1.0f), 1.0f), std::min(std::max(normal.y, -1.0f), 1.0f), std::min(std::max(normal.z, -1.0f), 1.0f) };
+			Store(capture.mPositions, index, eye + ray * hit.mDistance, 1.0f);
+			Store(capture.mNormals, index, normal, 1.0f);
+		}
+	}
+
+	if (!capture.Save(outputPath, error))
+	{
+		std::cerr << error << "\n";
+		return 2;
+	}
+	std::printf("%s: %zu triangles, RSM %u (%.1f units of the scene's %g at its texel size), RMax %.4g, G-buffer %ux%u\n",
+		outputPath.c_str(), triangles.size(), rsmSize, extent, SCENE_RSM_EXTENT, capture.mRMax, width, height);
+	return 0;
+}
@@ -0,0 +1,524 @@
+// Measures the tile classification of the RSM pass (RSMTileClassifier) on synthetic G-buffers: two scenes lit by a
+// directional light, ray cast into an orthographic RSM and perspective G-buffers at the resolution of the pass.
+//   room   the box room of tools/RSMLightcutsBench seen from above its open side, with sky behind it
+//   yard   a floor far larger than the RSM with a wall and a box on it, and sky above the horizon
+// Per view it reports the share of tiles per class and why the none tiles are none, the samples the tiled pass takes
+// against the full dispatch, and the error of the tiled pass against it: the relative RMS of the luminance over all
+// pixels and over the reduced tiles, and the largest luminance lost in a none tile.
+//
+//   RSMTileBench [--rsm-size n] [--width n] [--height n] [--rmax value]
+//
+// Checks: every tile is in exactly one list and the dispatch arguments count them, appending the tiles in any order
+// gives the same lists, a G-buffer without geometry and one facing away from every VPL make only none tiles, a tile
+// with a single receiving pixel is not none, no none tile loses more than half an 8 bit step of the saturated pass,
+// the tiled pass stays within 5% of the full dispatch and the yard skips at least half of the samples.
+// Exits with 1 if a check fails and 2 on bad arguments. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o RSMTileBench tools/RSMTileBench/main.cpp source/RSMTileClassifier.cpp source/RSMLightTree.cpp source/Sampling.cpp source/CpuProfiler.cpp
+
+#include "../Check.h"
+#include "RSMLightTree.h"
+#include "RSMTileClassifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: RSMTileBench [--rsm-size n] [--width n] [--height n] [--rmax value]\n";
+		return 2;
+	}
+
+	struct Vector
+	{
+		float x, y, z;
+	};
+
+	Vector operator+(Vector a, Vector b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	Vector operator-(Vector a, Vector b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	Vector operator*(Vector a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+	float Dot(Vector a, Vector b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	Vector Cross(Vector a, Vector b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+	Vector Normalize(Vector a) { return a * (1.0f / std::sqrt(Dot(a, a))); }
+
+	struct Box
+	{
+		Vector mMin, mMax, mAlbedo;
+	};
+
+	// The room of tools/RSMLightcutsBench
+	const std::vector<Box> Room = {
+		{ { -10.0f, -1.0f, -10.0f }, { 10.0f, 0.0f, 10.0f }, { 0.7f, 0.7f, 0.7f } },
+		{ { -10.0f, 0.0f, -11.0f }, { 10.0f, 10.0f, -10.0f }, { 0.8f, 0.1f, 0.1f } },
+		{ { -11.0f, 0.0f, -10.0f }, { -10.0f, 10.0f, 10.0f }, { 0.1f, 0.8f, 0.1f } },
+		{ { -3.0f, 0.0f, -3.0f }, { 0.0f, 3.0f, 0.0f }, { 0.9f, 0.9f, 0.8f } },
+		{ { 2.0f, 0.0f, 1.0f }, { 5.0f, 6.0f, 4.0f }, { 0.1f, 0.2f, 0.9f } },
+	};
+
+	const std::vector<Box> Yard = {
+		{ { -80.0f, -1.0f, -80.0f }, { 80.0f, 0.0f, 80.0f }, { 0.6f, 0.6f, 0.5f } },
+		{ { -8.0f, 0.0f, -6.0f }, { 8.0f, 5.0f, -5.0f }, { 0.8f, 0.3f, 0.2f } },
+		{ { 1.0f, 0.0f, 0.0f }, { 4.0f, 3.0f, 3.0f }, { 0.2f, 0.3f, 0.9f } },
+	};
+
+	bool Trace(const std::vector<Box>& boxes, Vector origin, Vector direction, Vector& position, Vector& normal, Vector& albedo)
+	{
+		float nearest = std::numeric_limits<float>::max();
+		for (const Box& box : boxes)
+		{
+			const float o[3] = { origin.x, origin.y, origin.z };
+			const float d[3] = { direction.x, direction.y, direction.z };
+			const float lo[3] = { box.mMin.x, box.mMin.y, box.mMin.z };
+			const float hi[3] = { box.mMax.x, box.mMax.y, box.mMax.z };
+			float enter = 0.0f, exit = nearest;
+			int axis = -1;
+			float sign = 0.0f;
+			for (int i = 0; i < 3; i++)
+			{
+				if (d[i] == 0.0f)
+				{
+					if (o[i] < lo[i] || o[i] > hi[i])
+						enter = exit + 1.0f;
+					continue;
+				}
+				float t0 = (lo[i] - o[i]) / d[i];
+				float t1 = (hi[i] - o[i]) / d[i];
+				float faceSign = -1.0f;
+				if (t0 > t1)
+				{
+					std::swap(t0, t1);
+					faceSign = 1.0f;
+				}
+				if (t0 > enter)
+				{
+					enter = t0;
+					axis = i;
+					sign = faceSign;
+				}
+				exit = std::min(exit, t1);
+			}
+			if (axis >= 0 && enter <= exit && enter < nearest)
+			{
+				nearest = enter;
+				position = origin + direction * enter;
+				float n[3] = { 0.0f, 0.0f, 0.0f };
+				n[axis] = sign;
+				normal = { n[0], n[1], n[2] };
+				albedo = box.mAlbedo;
+			}
+		}
+		return nearest < std::numeric_limits<float>::max();
+	}
+
+	void Store(std::vector<float>& data, size_t index, Vector value, float w)
+	{
+		data[index * 4] = value.x;
+		data[index * 4 + 1] = value.y;
+		data[index * 4 + 2] = value.z;
+		data[index * 4 + 3] = w;
+	}
+
+	struct Light
+	{
+		uint32_t mSize = 0;
+		float mViewProjection[16] = {};
+		std::vector<float> mPositions, mNormals, mFlux;
+	};
+
+	void MakeLight(const std::vector<Box>& boxes, uint32_t rsmSize, Light& light)
+	{
+		// orthographic light looking down the light direction, clip = [p 1] * M
+		const Vector direction = Normalize({ -0.5f, -1.0f, -0.6f });
+		const Vector right = Normalize(Cross({ 0.0f, 1.0f, 0.0f }, direction));
+		const Vector up = Cross(direction, right);
+		const Vector center = { 0.0f, 2.0f, 0.0f };
+		const float extent = 16.0f;
+		const float depth = 60.0f;
+		const Vector axes[3] = { right * (1.0f / extent), up * (1.0f / extent), direction * (1.0f / depth) };
+		float* m = light.mViewProjection;
+		for (int column = 0; column < 3; column++)
+		{
+			m[column] = axes[column].x;
+			m[4 + column] = axes[column].y;
+			m[8 + column] = axes[column].z;
+			m[12 + column] = -Dot(center, axes[column]) + (column == 2 ? 0.5f : 0.0f);
+		}
+		m[15] = 1.0f;
+
+		light.mSize = rsmSize;
+		const size_t texels = size_t(rsmSize) * rsmSize;
+		light.mPositions.assign(texels * 4, 0.0f);
+		light.mNormals.assign(texels * 4, 0.0f);
+		light.mFlux.assign(texels * 4, 0.0f);
+		for (uint32_t y = 0; y < rsmSize; y++)
+		{
+			for (uint32_t x = 0; x < rsmSize; x++)
+			{
+				float cx = ((float(x) + 0.5f) / float(rsmSize) - 0.5f) * 2.0f * extent;
+				float cy = (0.5f - (float(y) + 0.5f) / float(rsmSize)) * 2.0f * extent;
+				Vector origin = center + right * cx + up * cy - direction * (0.5f * depth);
+				Vector position, normal, albedo;
+				if (!Trace(boxes, origin, direction, position, normal, albedo))
+					continue;
+				size_t index = size_t(y) * rsmSize + x;
+				Store(light.mPositions, index, position, 1.0f);
+				Store(light.mNormals, index, normal, 0.0f);
+				Store(light.mFlux, index, albedo * std::max(-Dot(normal, direction), 0.0f), 1.0f);
+			}
+		}
+	}
+
+	struct View
+	{
+		const char* mName = "";
+		uint32_t mWidth = 0;
+		uint32_t mHeight = 0;
+		float mViewProjection[16] = {};
+		std::vector<float> mPositions, mNormals;
+	};
+
+	// Perspective camera with a D3D projection (near 0.1, far 500) and its G-buffer
+	void MakeView(const char* name, const std::vector<Box>& boxes, Vector eye, Vector target, uint32_t width, uint32_t height, View& view)
+	{
+		const Vector forward = Normalize(target - eye);
+		const Vector right = Normalize(Cross(forward, { 0.0f, 1.0f, 0.0f }));
+		const Vector up = Cross(right, forward);
+		const float tanHalf = std::tan(0.5f * 1.0472f);
+		const float aspect = float(width) / float(height);
+		const float zNear = 0.1f, zFar = 500.0f;
+		const float a = zFar / (zFar - zNear);
+		const Vector axes[4] = { right * (1.0f / (tanHalf * aspect)), up * (1.0f / tanHalf), forward * a, forward };
+		float* m = view.mViewProjection;
+		for (int column = 0; column < 4; column++)
+		{
+			m[column] = axes[column].x;
+			m[4 + column] = axes[column].y;
+			m[8 + column] = axes[column].z;
+			m[12 + column] = -Dot(eye, axes[column]) + (column == 2 ? -zNear * a : 0.0f);
+		}
+
+		view.mName = name;
+		view.mWidth = width;
+		view.mHeight = height;
+		view.mPositions.assign(size_t(width) * height * 4, 0.0f);
+		view.mNormals.assign(size_t(width) * height * 4, 0.0f);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				float sx = ((float(x) + 0.5f) / float(width) * 2.0f - 1.0f) * tanHalf * aspect;
+				float sy = (1.0f - (float(y) + 0.5f) / float(height) * 2.0f) * tanHalf;
+				Vector ray = Normalize(forward + right * sx + up * sy);
+				Vector position, normal, albedo;
+				if (!Trace(boxes, eye, ray, position, normal, albedo))
+					continue;
+				size_t index = size_t(y) * width + x;
+				Store(view.mPositions, index, position, 1.0f);
+				Store(view.mNormals, index, normal, 0.0f);
+			}
+		}
+	}
+
+	RSMTileClassifier::Frame GetFrame(const View& view, const Light& light)
+	{
+		RSMTileClassifier::Frame frame;
+		frame.mPositions = view.mPositions.data();
+		frame.mNormals = view.mNormals.data();
+		frame.mWidth = view.mWidth;
+		frame.mHeight = view.mHeight;
+		frame.mViewProjection = view.mViewProjection;
+		frame.mShadowViewProjection = light.mViewProjection;
+		return frame;
+	}
+
+	bool HasGeometry(const View& view, size_t index)
+	{
+		return view.mNormals[index * 4] != 0.0f || view.mNormals[index * 4 + 1] != 0.0f || view.mNormals[index * 4 + 2] != 0.0f;
+	}
+
+	RSMLightTree::Receiver GetReceiver(const View& view, const Light& light, size_t index)
+	{
+		RSMLightTree::Receiver receiver;
+		const float* p = &view.mPositions[index * 4];
+		const float* s = light.mViewProjection;
+		for (int i = 0; i < 3; i++)
+		{
+			receiver.mPosition[i] = p[i];
+			receiver.mNormal[i] = view.mNormals[index * 4 + i];
+		}
+		receiver.mUV[0] = (p[0] * s[0] + p[1] * s[4] + p[2] * s[8] + s[12]) * 0.5f + 0.5f;
+		receiver.mUV[1] = (p[0] * s[1] + p[1] * s[5] + p[2] * s[9] + s[13]) * -0.5f + 0.5f;
+		return receiver;
+	}
+
+	// The RSM pass over a tile with sampleCount samples, saturated as it writes; pixels without geometry are cleared
+	void GatherTile(const View& view, const Light& light, const RSMLightTree::Image& image, float rMax, const std::vector<float>& xi, uint32_t sampleCount,
+		uint32_t tileX, uint32_t tileY, std::vector<float>& result)
+	{
+		const uint32_t size = RSMTileClassifier::TILE_SIZE;
+		for (uint32_t y = tileY * size; y < std::min((tileY + 1) * size, view.mHeight); y++)
+		{
+			for (uint32_t x = tileX * size; x < std::min((tileX + 1) * size, view.mWidth); x++)
+			{
+				size_t index = size_t(y) * view.mWidth + x;
+				float rgb[3] = { 0.0f, 0.0f, 0.0f };
+				if (sampleCount > 0 && HasGeometry(view, index))
+					RSMLightTree::GatherSamples(image, GetReceiver(view, light, index), rMax, xi.data(), sampleCount, rgb);
+				for (int c = 0; c < 3; c++)
+					result[index * 4 + c] = std::min(std::max(rgb[c], 0.0f), 1.0f);
+				result[index * 4 + 3] = 1.0f;
+			}
+		}
+	}
+
+	// Whether the buffer holds every tile of the frame exactly once and its arguments count the lists
+	bool HoldsEveryTile(const std::vector<uint32_t>& buffer, uint32_t tilesX, uint32_t tilesY, uint32_t tileCapacity)
+	{
+		std::vector<uint32_t> uses(size_t(tilesX) * tilesY, 0);
+		uint32_t total = 0;
+		for (uint32_t tileClass = 0; tileClass < RSMTileClassifier::CLASS_COUNT; tileClass++)
+		{
+			const uint32_t* arguments = buffer.data() + RSMTileClassifier::GetArgumentsOffset(RSMTileClassifier::Class(tileClass));
+			if (arguments[1] != 1 || arguments[2] != 1 || arguments[0] > tileCapacity)
+				return false;
+			const uint32_t* list = buffer.data() + RSMTileClassifier::GetListOffset(RSMTileClassifier::Class(tileClass), tileCapacity);
+			for (uint32_t i = 0; i < arguments[0]; i++)
+			{
+				uint32_t x, y;
+				RSMTileClassifier::UnpackTile(list[i], x, y);
+				if (x >= tilesX || y >= tilesY)
+					return false;
+				uses[size_t(y) * tilesX + x]++;
+			}
+			total += arguments[0];
+		}
+		return total == tilesX * tilesY && std::all_of(uses.begin(), uses.end(), [](uint32_t use) { return use == 1; });
+	}
+
+	// The tiles of a list, sorted, to compare lists filled in different orders
+	std::vector<uint32_t> GetList(const std::vector<uint32_t>& buffer, RSMTileClassifier::Class tileClass, uint32_t tileCapacity)
+	{
+		const uint32_t* list = buffer.data() + RSMTileClassifier::GetListOffset(tileClass, tileCapacity);
+		std::vector<uint32_t> tiles(list, list + buffer[RSMTileClassifier::GetArgumentsOffset(tileClass)]);
+		std::sort(tiles.begin(), tiles.end());
+		return tiles;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t rsmSize = 1024;
+	uint32_t width = 480;   // the RSM pass at a quarter of 1920 x 1080, partial tiles at the bottom
+	uint32_t height = 270;
+	float rMax = 0.035f;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--rsm-size" && hasValue)
+			rsmSize = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--width" && hasValue)
+			width = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--height" && hasValue)
+			height = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else if (arg == "--rmax" && hasValue)
+			rMax = float(std::atof(argv[++i]));
+		else
+			return Usage();
+	}
+
+	const uint32_t leafSize = 4;   // RSM_LIGHT_TREE_LEAF_SIZE
+	const uint32_t sampleCount = RSMLightTree::MAX_SAMPLES_COUNT;
+	const uint32_t tilesX = RSMTileClassifier::GetTilesX(width);
+	const uint32_t tilesY = RSMTileClassifier::GetTilesY(height);
+	const uint32_t tileCapacity = tilesX * tilesY;
+	std::vector<float> xi;
+	RSMLightTree::MakeSamples(sampleCount, xi);
+
+	struct Scene
+	{
+		const char* mName;
+		const std::vector<Box>* mBoxes;
+		Vector mEye, mTarget;
+	};
+	const Scene scenes[] = {
+		{ "room", &Room, { 12.0f, 9.0f, 14.0f }, { -4.0f, 2.0f, -5.0f } },
+		{ "yard", &Yard, { 0.0f, 5.0f, 28.0f }, { 0.0f, 1.0f, 0.0f } },
+	};
+
+	bool passed = true;
+	bool listsValid = true;
+	bool orderIndependent = true;
+	double maxLost = 0.0;
+	double maxError = 0.0;
+	double yardWork = 1.0;
+
+	std::printf("RSM %u, %ux%u pass (%ux%u tiles of %u), RMax %.3g, %u samples\n\n", rsmSize, width, height, tilesX, tilesY,
+		RSMTileClassifier::TILE_SIZE, rMax, sampleCount);
+	std::printf("%-6s %8s %8s %8s %8s %8s %8s %8s %10s %10s %10s %10s\n", "Scene", "full", "reduced", "none", "sky", "outside", "unlit",
+		"facing", "work", "error", "reduced", "max lost");
+
+	std::vector<Light> lights(std::size(scenes));
+	std::vector<RSMLightTree> trees(std::size(scenes));
+	std::vector<View> views(std::size(scenes));
+	for (size_t s = 0; s < std::size(scenes); s++)
+	{
+		const Scene& scene = scenes[s];
+		Light& light = lights[s];
+		MakeLight(*scene.mBoxes, rsmSize, light);
+		RSMLightTree::Image image;
+		image.mPositions = light.mPositions.data();
+		image.mNormals = light.mNormals.data();
+		image.mFlux = light.mFlux.data();
+		image.mSize = rsmSize;
+		std::string error;
+		if (!trees[s].Build(image, leafSize, error))
+		{
+			std::cerr << error << "\n";
+			return 2;
+		}
+		const RSMLightTree& tree = trees[s];
+
+		View& view = views[s];
+		MakeView(scene.mName, *scene.mBoxes, scene.mEye, scene.mTarget, width, height, view);
+		const RSMTileClassifier::Frame frame = GetFrame(view, light);
+		RSMTileClassifier::Settings settings;
+		settings.mRMax = rMax;
+		settings.mLevel = RSMTileClassifier::GetLevel(rMax, tree.GetLeafLevel());
+
+		std::vector<uint32_t> buffer;
+		RSMTileClassifier::Classify(frame, tree, settings, tileCapacity, buffer);
+		listsValid &= HoldsEveryTile(buffer, tilesX, tilesY, tileCapacity);
+
+		// the GPU appends in whatever order the groups finish
+		std::vector<uint32_t> order(size_t(tilesX) * tilesY);
+		for (uint32_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::mt19937 random(uint32_t(s) + 1);
+		std::shuffle(order.begin(), order.end(), random);
+		std::vector<uint32_t> shuffled;
+		RSMTileClassifier::ResetLists(tileCapacity, shuffled);
+		for (uint32_t i : order)
+		{
+			const uint32_t x = i % tilesX, y = i / tilesX;
+			RSMTileClassifier::AppendTile(RSMTileClassifier::ClassifyTile(frame, tree, settings, x, y), RSMTileClassifier::PackTile(x, y), tileCapacity, shuffled);
+		}
+		listsValid &= HoldsEveryTile(shuffled, tilesX, tilesY, tileCapacity);
+		for (uint32_t tileClass = 0; tileClass < RSMTileClassifier::CLASS_COUNT; tileClass++)
+			orderIndependent &= GetList(buffer, RSMTileClassifier::Class(tileClass), tileCapacity) == GetList(shuffled, RSMTileClassifier::Class(tileClass), tileCapacity);
+
+		// the full dispatch and the tiled one
+		std::vector<float> full(size_t(width) * height * 4, 0.0f);
+		std::vector<float> tiled(size_t(width) * height * 4, 0.0f);
+		uint32_t counts[RSMTileClassifier::CLASS_COUNT] = {};
+		uint32_t reasons[4] = {};   // sky, outside the RSM, no flux in reach, facing away
+		double work = 0.0;
+		for (uint32_t y = 0; y < tilesY; y++)
+		{
+			for (uint32_t x = 0; x < tilesX; x++)
+			{
+				RSMTileClassifier::TileStats stats;
+				RSMTileClassifier::Class tileClass = RSMTileClassifier::ClassifyTile(frame, tree, settings, x, y, &stats);
+				counts[tileClass]++;
+				if (tileClass == RSMTileClassifier::CLASS_NONE)
+					reasons[stats.mGeometryPixels == 0 ? 0 : stats.mNodes == 0 ? 1 : stats.mLitNodes == 0 ? 2 : 3]++;
+				const uint32_t tileSamples = RSMTileClassifier::GetSampleCount(tileClass, sampleCount);
+				work += double(tileSamples) / double(sampleCount);
+				GatherTile(view, light, image, rMax, xi, sampleCount, x, y, full);
+				GatherTile(view, light, image, rMax, xi, tileSamples, x, y, tiled);
+			}
+		}
+		work /= double(tilesX * tilesY);
+
+		double sum = 0.0, difference = 0.0, reducedSum = 0.0, reducedDifference = 0.0, lost = 0.0;
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				size_t index = size_t(y) * width + x;
+				if (!HasGeometry(view, index))
+					continue;
+				const RSMTileClassifier::Class tileClass = RSMTileClassifier::ClassifyTile(frame, tree, settings,
+					x / RSMTileClassifier::TILE_SIZE, y / RSMTileClassifier::TILE_SIZE);
+				double expected = RSMLightTree::GetLuminance(&full[index * 4]);
+				double error = RSMLightTree::GetLuminance(&tiled[index * 4]) - expected;
+				sum += expected * expected;
+				difference += error * error;
+				if (tileClass == RSMTileClassifier::CLASS_REDUCED)
+				{
+					reducedSum += expected * expected;
+					reducedDifference += error * error;
+				}
+				if (tileClass == RSMTileClassifier::CLASS_NONE)
+					lost = std::max(lost, expected);
+			}
+		}
+		const double relative = sum > 0.0 ? std::sqrt(difference / sum) : 0.0;
+		const double reducedRelative = reducedSum > 0.0 ? std::sqrt(reducedDifference / reducedSum) : 0.0;
+		maxLost = std::max(maxLost, lost);
+		maxError = std::max(maxError, relative);
+		if (std::string(scene.mName) == "yard")
+			yardWork = work;
+
+		const double tiles = double(tilesX * tilesY);
+		std::printf("%-6s %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %10.3f %10.4g %10.4g %10.4g\n", scene.mName, counts[0] / tiles, counts[1] / tiles,
+			counts[2] / tiles, reasons[0] / tiles, reasons[1] / tiles, reasons[2] / tiles, reasons[3] / tiles, work, relative, reducedRelative, lost);
+	}
+	std::printf("\n");
+
+	passed &= Check("every tile is in one list, the arguments count them", listsValid, "%.0f tiles", double(tileCapacity));
+	passed &= Check("the lists do not depend on the append order", orderIndependent, "%.0f classes", double(RSMTileClassifier::CLASS_COUNT));
+
+	// synthetic G-buffers: no geometry at all, a receiver facing away from every VPL, then a single pixel facing them
+	{
+		const View& room = views[0];
+		std::vector<float> empty(size_t(width) * height * 4, 0.0f);
+		RSMTileClassifier::Frame frame = GetFrame(room, lights[0]);
+		frame.mPositions = empty.data();
+		frame.mNormals = empty.data();
+		RSMTileClassifier::Settings settings;
+		settings.mRMax = rMax;
+		settings.mLevel = RSMTileClassifier::GetLevel(rMax, trees[0].GetLeafLevel());
+		std::vector<uint32_t> buffer;
+		RSMTileClassifier::Classify(frame, trees[0], settings, tileCapacity, buffer);
+		const uint32_t skyNone = buffer[RSMTileClassifier::GetArgumentsOffset(RSMTileClassifier::CLASS_NONE)];
+		passed &= Check("a G-buffer without geometry is all none", skyNone == tileCapacity, "%.0f none tiles", double(skyNone));
+
+		// a ceiling over the room at the height of the walls: every VPL is below it
+		std::vector<float> positions(size_t(width) * height * 4, 0.0f);
+		std::vector<float> normals(size_t(width) * height * 4, 0.0f);
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				size_t index = size_t(y) * width + x;
+				Store(positions, index, { -10.0f + 20.0f * (float(x) + 0.5f) / float(width), 10.0f, -10.0f + 20.0f * (float(y) + 0.5f) / float(height) }, 1.0f);
+				Store(normals, index, { 0.0f, 1.0f, 0.0f }, 0.0f);
+			}
+		}
+		frame.mPositions = positions.data();
+		frame.mNormals = normals.data();
+		RSMTileClassifier::Classify(frame, trees[0], settings, tileCapacity, buffer);
+		const uint32_t facingNone = buffer[RSMTileClassifier::GetArgumentsOffset(RSMTileClassifier::CLASS_NONE)];
+		passed &= Check("receivers above every VPL, facing up, are all none", facingNone == tileCapacity, "%.0f none tiles", double(facingNone));
+
+		// the same tile with one pixel turned towards the room
+		normals[4 * (size_t(3) * width + 5) + 1] = -1.0f;
+		RSMTileClassifier::TileStats stats;
+		RSMTileClassifier::Class single = RSMTileClassifier::ClassifyTile(frame, trees[0], settings, 0, 0, &stats);
+		passed &= Check("a tile with one receiving pixel is not none", single != RSMTileClassifier::CLASS_NONE, "%.0f receiving pixels", double(stats.mReceivingPixels));
+	}
+
+	passed &= Check("none tiles lose at most half an 8 bit step", maxLost <= 0.5 / 255.0, "%.3g luminance", maxLost);
+	passed &= Check("the tiled pass is within 5% of the full dispatch", maxError <= 0.05, "%.4g relative RMS", maxError);
+	passed &= Check("the yard takes at most half of the samples", yardWork <= 0.5, "%.3f of the samples", yardWork);
+	return passed ? 0 : 1;
+}
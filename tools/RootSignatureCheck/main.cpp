@@ -0,0 +1,216 @@
+// Checks RootSignatureLayout, the device-free description RootSignature::Validate and Finalize use, and the layouts
+// of PerDrawBinding the scene builds its per-draw root signatures from:
+//   cost       root constants cost a DWORD each, root descriptors 2, tables 1 and static samplers nothing; 64 DWORDs
+//              fit, 65 do not
+//   clashes    two bindings of one register class, space and register clash: root constants and root CBVs with each
+//              other and with CBV table ranges, root SRVs and UAVs with their ranges, overlapping and unbounded ranges
+//              of two tables and static samplers with sampler ranges; other spaces, classes and registers do not
+//   visibility bindings visible to different single stages never clash, ALL clashes with every stage
+//   tables     a table mixing sampler and view ranges and a parameter that was never initialized fail
+//   per-draw   every pass drawing all objects has a valid layout for both kinds of per-object data, the pass
+//              constant buffer stays a root CBV at b0 and the object data is 20 root constants or a root CBV at b1
+//
+//   RootSignatureCheck [--verbose]
+//
+// --verbose prints every per-draw layout. Prints a line per check and exits with 1 if any fails and 2 on bad
+// arguments. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o RootSignatureCheck tools/RootSignatureCheck/main.cpp source/RootSignatureLayout.cpp source/PerDrawBinding.cpp
+
+#include "../Check.h"
+#include "PerDrawBinding.h"
+#include "RootSignatureLayout.h"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	typedef RootSignatureLayout L;
+
+	int Usage()
+	{
+		std::cerr << "usage: RootSignatureCheck [--verbose]\n";
+		return 2;
+	}
+
+	struct Case
+	{
+		const char* mName;
+		L mLayout;
+		bool mValid;
+	};
+
+	L Constants(uint32_t count)
+	{
+		L layout;
+		layout.AddConstants(0, count);
+		return layout;
+	}
+
+	std::vector<Case> MakeClashCases()
+	{
+		std::vector<Case> cases;
+		auto add = [&cases](const char* name, bool valid, auto build) {
+			L layout;
+			build(layout);
+			cases.push_back({ name, layout, valid });
+		};
+
+		add("root CBV and CBV range", false, [](L& l) { l.AddDescriptor(L::PARAMETER_CBV, 2); l.AddTable({ { L::RANGE_CBV, 0, 4, 0 } }); });
+		add("root CBV past the CBV range", true, [](L& l) { l.AddDescriptor(L::PARAMETER_CBV, 4); l.AddTable({ { L::RANGE_CBV, 0, 4, 0 } }); });
+		add("root CBV and range in another space", true, [](L& l) { l.AddDescriptor(L::PARAMETER_CBV, 0); l.AddTable({ { L::RANGE_CBV, 0, 1, 1 } }); });
+		add("root CBV and SRV range", true, [](L& l) { l.AddDescriptor(L::PARAMETER_CBV, 0); l.AddTable({ { L::RANGE_SRV, 0, 1, 0 } }); });
+		add("root constants and root CBV", false, [](L& l) { l.AddConstants(1, 4); l.AddDescriptor(L::PARAMETER_CBV, 1); });
+		add("two root CBVs", false, [](L& l) { l.AddDescriptor(L::PARAMETER_CBV, 3); l.AddDescriptor(L::PARAMETER_CBV, 3); });
+		add("root SRV and SRV range", false, [](L& l) { l.AddDescriptor(L::PARAMETER_SRV, 5); l.AddTable({ { L::RANGE_SRV, 4, 2, 0 } }); });
+		add("root UAV and UAV range", false, [](L& l) { l.AddDescriptor(L::PARAMETER_UAV, 0); l.AddTable({ { L::RANGE_UAV, 0, 1, 0 } }); });
+		add("root UAV and SRV range", true, [](L& l) { l.AddDescriptor(L::PARAMETER_UAV, 0); l.AddTable({ { L::RANGE_SRV, 0, 1, 0 } }); });
+		add("overlapping ranges of two tables", false, [](L& l) { l.AddTable({ { L::RANGE_SRV, 0, 4, 0 } }); l.AddTable({ { L::RANGE_SRV, 3, 2, 0 } }); });
+		add("adjacent ranges of two tables", true, [](L& l) { l.AddTable({ { L::RANGE_SRV, 0, 4, 0 } }); l.AddTable({ { L::RANGE_SRV, 4, 2, 0 } }); });
+		add("overlapping ranges of one table", false, [](L& l) { l.AddTable({ { L::RANGE_UAV, 0, 2, 0 }, { L::RANGE_UAV, 1, 1, 0 } }); });
+		add("unbounded range and a later register", false, [](L& l) { l.AddTable({ { L::RANGE_SRV, 8, L::UNBOUNDED, 0 } }); l.AddDescriptor(L::PARAMETER_SRV, 1000); });
+		add("unbounded range and an earlier register", true, [](L& l) { l.AddTable({ { L::RANGE_SRV, 8, L::UNBOUNDED, 0 } }); l.AddDescriptor(L::PARAMETER_SRV, 7); });
+		add("static sampler and sampler range", false, [](L& l) { l.AddTable({ { L::RANGE_SAMPLER, 0, 2, 0 } }); l.AddStaticSampler(1); });
+		add("static sampler and CBV range", true, [](L& l) { l.AddTable({ { L::RANGE_CBV, 0, 2, 0 } }); l.AddStaticSampler(1); });
+		add("two static samplers", false, [](L& l) { l.AddStaticSampler(0, L::VISIBILITY_PIXEL); l.AddStaticSampler(0, L::VISIBILITY_PIXEL); });
+		add("sampler and view ranges in one table", false, [](L& l) { l.AddTable({ { L::RANGE_SRV, 0, 1, 0 }, { L::RANGE_SAMPLER, 0, 1, 0 } }); });
+		add("uninitialized parameter", false, [](L& l) { l.AddDescriptor(L::PARAMETER_UNINITIALIZED, 0); });
+		return cases;
+	}
+
+	std::vector<Case> MakeVisibilityCases()
+	{
+		std::vector<Case> cases;
+		auto add = [&cases](const char* name, bool valid, L::Visibility a, L::Visibility b) {
+			L layout;
+			layout.AddDescriptor(L::PARAMETER_CBV, 0, a);
+			layout.AddTable({ { L::RANGE_CBV, 0, 1, 0 } }, b);
+			cases.push_back({ name, layout, valid });
+		};
+		add("vertex and pixel", true, L::VISIBILITY_VERTEX, L::VISIBILITY_PIXEL);
+		add("geometry and hull", true, L::VISIBILITY_GEOMETRY, L::VISIBILITY_HULL);
+		add("pixel and pixel", false, L::VISIBILITY_PIXEL, L::VISIBILITY_PIXEL);
+		add("all and domain", false, L::VISIBILITY_ALL, L::VISIBILITY_DOMAIN);
+		add("vertex and all", false, L::VISIBILITY_VERTEX, L::VISIBILITY_ALL);
+		return cases;
+	}
+
+	const char* TypeName(L::ParameterType type)
+	{
+		switch (type)
+		{
+		case L::PARAMETER_TABLE: return "table";
+		case L::PARAMETER_CONSTANTS: return "constants";
+		case L::PARAMETER_CBV: return "root CBV";
+		case L::PARAMETER_SRV: return "root SRV";
+		case L::PARAMETER_UAV: return "root UAV";
+		default: return "?";
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	bool verbose = false;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--verbose")
+			verbose = true;
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+
+	{
+		L layout;
+		layout.AddConstants(0, 5);
+		layout.AddDescriptor(L::PARAMETER_CBV, 1);
+		layout.AddDescriptor(L::PARAMETER_SRV, 0);
+		layout.AddDescriptor(L::PARAMETER_UAV, 0);
+		layout.AddTable({ { L::RANGE_SRV, 1, 8, 0 }, { L::RANGE_UAV, 1, 2, 0 } });
+		layout.AddTable({ { L::RANGE_SAMPLER, 0, 4, 0 } });
+		layout.AddStaticSampler(4);
+		passed &= Check("cost: constants 1, descriptors 2, tables 1", layout.GetDWORDCost() == 5 + 2 * 3 + 2 && layout.Validate(), "%.0f DWORDs",
+			double(layout.GetDWORDCost()));
+
+		L full = Constants(62);
+		full.AddDescriptor(L::PARAMETER_CBV, 1);
+		L over = Constants(63);
+		over.AddDescriptor(L::PARAMETER_CBV, 1);
+		std::string error;
+		bool budget = full.GetDWORDCost() == 64 && full.Validate() && over.GetDWORDCost() == 65 && !over.Validate(&error) && error.find("65") != std::string::npos;
+		passed &= Check("cost: 64 DWORDs fit, 65 do not", budget, "%.0f over", double(over.GetDWORDCost()));
+	}
+
+	{
+		int wrong = 0;
+		for (const Case& c : MakeClashCases())
+		{
+			if (c.mLayout.Validate() != c.mValid)
+			{
+				std::printf("    %s: %s\n", c.mName, c.mValid ? "rejected" : "accepted");
+				wrong++;
+			}
+		}
+		passed &= Check("clashes: register classes, spaces, ranges", wrong == 0, "%.0f wrong", double(wrong));
+
+		wrong = 0;
+		for (const Case& c : MakeVisibilityCases())
+		{
+			if (c.mLayout.Validate() != c.mValid)
+			{
+				std::printf("    %s: %s\n", c.mName, c.mValid ? "rejected" : "accepted");
+				wrong++;
+			}
+		}
+		passed &= Check("visibility: single stages apart, ALL clashes", wrong == 0, "%.0f wrong", double(wrong));
+
+		L layout;
+		layout.AddConstants(0, 1);
+		layout.AddTable({ { L::RANGE_CBV, 0, 4, 0 } });
+		std::string error;
+		layout.Validate(&error);
+		passed &= Check("clashes: the error names both bindings", error == "parameter 0 and parameter 1 range 0 both bind b0, space0", "%.0f characters",
+			double(error.size()));
+	}
+
+	{
+		bool layouts = true;
+		int count = 0;
+		for (int pass = 0; pass < PerDrawBinding::PASS_COUNT; pass++)
+		{
+			for (int data = 0; data < PerDrawBinding::DATA_COUNT; data++)
+			{
+				L layout = PerDrawBinding::GetLayout(PerDrawBinding::Pass(pass), PerDrawBinding::Data(data));
+				std::string error;
+				bool valid = layout.Validate(&error);
+				const std::vector<L::Parameter>& parameters = layout.GetParameters();
+				const L::Parameter& perPass = parameters[PerDrawBinding::PASS_PARAMETER];
+				const L::Parameter& perObject = parameters[PerDrawBinding::OBJECT_PARAMETER];
+				bool bound = perPass.mType == L::PARAMETER_CBV && perPass.mRegister == 0 && perObject.mRegister == 1 && (data == PerDrawBinding::DATA_ROOT_CONSTANTS ?
+					perObject.mType == L::PARAMETER_CONSTANTS && perObject.mConstantCount == PerDrawBinding::OBJECT_CONSTANT_DWORDS : perObject.mType == L::PARAMETER_CBV);
+				layouts = layouts && valid && bound;
+				count++;
+
+				if (verbose || !valid || !bound)
+				{
+					std::printf("    %-14s %-16s %2u DWORDs %s\n", PerDrawBinding::GetPassName(PerDrawBinding::Pass(pass)),
+						PerDrawBinding::GetDataName(PerDrawBinding::Data(data)), layout.GetDWORDCost(), valid ? "" : error.c_str());
+					for (size_t i = 0; i < parameters.size(); i++)
+						std::printf("        %zu %-10s register %u, %u DWORDs\n", i, TypeName(parameters[i].mType), parameters[i].mRegister, L::GetDWORDCost(parameters[i]));
+				}
+			}
+		}
+		passed &= Check("per-draw: every pass and data valid", layouts, "%.0f layouts", double(count));
+
+		L constants = PerDrawBinding::GetLayout(PerDrawBinding::PASS_VOXELIZATION, PerDrawBinding::DATA_ROOT_CONSTANTS);
+		L cbv = PerDrawBinding::GetLayout(PerDrawBinding::PASS_VOXELIZATION, PerDrawBinding::DATA_ROOT_CBV);
+		passed &= Check("per-draw: voxelization cost", constants.GetDWORDCost() == 24 && cbv.GetDWORDCost() == 6, "%.0f DWORDs", double(constants.GetDWORDCost()));
+	}
+
+	return passed ? 0 : 1;
+}
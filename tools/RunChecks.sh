@@ -0,0 +1,65 @@
+#!/usr/bin/env bash
+# Builds every tool under tools/ with the g++ line in the header comment of its main.cpp and runs each check and
+# bench (the tools named *Check and *Bench) with its default arguments. The other tools take input files and are
+# only built. Prints the output of every run and a summary, and exits with 1 if a build or a run failed.
+#
+#   tools/RunChecks.sh [--build dir] [tool...]
+#
+# --build is where the binaries go (_checks/ in the repository root), tools names the tools to run (all of them).
+# CXX picks the compiler (g++), CXXFLAGS adds flags, e.g. CXXFLAGS="-fsanitize=address,undefined".
+
+set -u
+
+root="$(cd "$(dirname "$0")/.." && pwd)"
+build="$root/_checks"
+tools=()
+while [ $# -gt 0 ]; do
+	case "$1" in
+		--build) build="$2"; shift 2 ;;
+		-*) echo "usage: tools/RunChecks.sh [--build dir] [tool...]" >&2; exit 2 ;;
+		*) tools+=("$1"); shift ;;
+	esac
+done
+if [ ${#tools[@]} -eq 0 ]; then
+	for main in "$root"/tools/*/main.cpp; do
+		tools+=("$(basename "$(dirname "$main")")")
+	done
+fi
+
+mkdir -p "$build"
+build="$(cd "$build" && pwd)"
+cd "$root"
+
+failed=()
+for tool in "${tools[@]}"; do
+	main="tools/$tool/main.cpp"
+	command="$(grep -m1 '^//   g++ ' "$main" 2>/dev/null | sed 's|^//   g++ ||')"
+	if [ -z "$command" ]; then
+		echo "== $tool: no g++ line in $main"
+		failed+=("$tool (build)")
+		continue
+	fi
+
+	echo "== $tool"
+	# word splitting and globbing of the command are wanted here, it is written like a shell line
+	# shellcheck disable=SC2086
+	if ! ${CXX:-g++} ${CXXFLAGS:-} $(echo "$command" | sed "s|-o \([^ ]*\)|-o $build/\1|"); then
+		failed+=("$tool (build)")
+		continue
+	fi
+
+	case "$tool" in
+		*Check|*Bench)
+			if ! "$build/$tool"; then
+				failed+=("$tool")
+			fi ;;
+	esac
+done
+
+echo
+if [ ${#failed[@]} -eq 0 ]; then
+	echo "all ${#tools[@]} tools passed"
+	exit 0
+fi
+echo "${#failed[@]} of ${#tools[@]} tools failed: ${failed[*]}"
+exit 1
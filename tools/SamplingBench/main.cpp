@@ -0,0 +1,328 @@
+// Checks the sampling library (Sampling, PCG32, BlueNoise) and times the blue noise generation:
+//   PCG32       the reference output of pcg32_srandom_r(42, 54) and unbiased bounded draws
+//   sequences   L2 star discrepancy (Warnock's formula) of uniform random, Halton, Sobol, Owen scrambled Sobol,
+//               rotated Sobol and R2 points; the (0,2) property of Sobol and scrambled Sobol for every power of two
+//               prefix
+//   blue noise  ranks form a permutation; the fraction of the power spectrum below a quarter of the Nyquist frequency
+//               against white noise, whose expected fraction is the area of that disc; the same for a 10% threshold
+//               the ranks don't depend on the thread count, with layers split over threads and rows over bands
+//   timing      generation at 64x64 and 128x128, one layer on 1 and on all threads, and 4 layers on 1 and on all
+//               threads
+//
+//   SamplingBench [--points n] [--seed n] [--repeat n]
+//
+// Exits with 1 if a check fails and 2 on bad arguments. Standalone and standard library only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o SamplingBench tools/SamplingBench/main.cpp source/Sampling.cpp source/BlueNoise.cpp source/CpuProfiler.cpp
+
+#include "../Check.h"
+#include "BlueNoise.h"
+#include "Sampling.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: SamplingBench [--points n] [--seed n] [--repeat n]\n";
+		return 2;
+	}
+
+	typedef std::vector<std::array<double, 2>> Points;
+
+	Points MakePoints(uint32_t count, const std::function<void(uint32_t, double[2])>& sample)
+	{
+		Points points(count);
+		for (uint32_t i = 0; i < count; i++)
+			sample(i, points[i].data());
+		return points;
+	}
+
+	double L2StarDiscrepancy(const Points& points)
+	{
+		const double n = double(points.size());
+		double single = 0.0;
+		double pairs = 0.0;
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			single += (1.0 - points[i][0] * points[i][0]) * (1.0 - points[i][1] * points[i][1]);
+			for (size_t j = 0; j < points.size(); j++)
+				pairs += (1.0 - std::max(points[i][0], points[j][0])) * (1.0 - std::max(points[i][1], points[j][1]));
+		}
+		return std::sqrt(std::max(1.0 / 9.0 - single / (2.0 * n) + pairs / (n * n), 0.0));
+	}
+
+	// One point in each of the 2^a x 2^b cells with a + b = m, for all a
+	bool IsNet(const Points& points)
+	{
+		uint32_t m = 0;
+		while ((size_t(1) << m) < points.size())
+			m++;
+		if ((size_t(1) << m) != points.size())
+			return false;
+		for (uint32_t a = 0; a <= m; a++)
+		{
+			uint32_t columns = 1u << a;
+			uint32_t rows = 1u << (m - a);
+			std::vector<uint8_t> hit(points.size(), 0);
+			for (const auto& point : points)
+			{
+				size_t cell = size_t(point[1] * rows) * columns + size_t(point[0] * columns);
+				if (cell >= hit.size() || hit[cell]++)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	void DFT(std::vector<std::complex<double>>& data, size_t offset, size_t stride, size_t size)
+	{
+		std::vector<std::complex<double>> input(size);
+		for (size_t i = 0; i < size; i++)
+			input[i] = data[offset + i * stride];
+		for (size_t k = 0; k < size; k++)
+		{
+			std::complex<double> sum = 0.0;
+			for (size_t i = 0; i < size; i++)
+				sum += input[i] * std::polar(1.0, -2.0 * 3.14159265358979323846 * double(k * i % size) / double(size));
+			data[offset + k * stride] = sum;
+		}
+	}
+
+	// Fraction of the power (mean removed) at frequencies below a quarter of Nyquist
+	double LowFrequencyFraction(const std::vector<float>& image, uint32_t size)
+	{
+		double mean = 0.0;
+		for (float value : image)
+			mean += value;
+		mean /= double(image.size());
+
+		std::vector<std::complex<double>> spectrum(image.size());
+		for (size_t i = 0; i < image.size(); i++)
+			spectrum[i] = image[i] - mean;
+		for (uint32_t y = 0; y < size; y++)
+			DFT(spectrum, size_t(y) * size, 1, size);
+		for (uint32_t x = 0; x < size; x++)
+			DFT(spectrum, x, size, size);
+
+		double low = 0.0;
+		double total = 0.0;
+		const double cutoff = double(size) / 8.0;
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				double fx = double(std::min(x, size - x));
+				double fy = double(std::min(y, size - y));
+				double power = std::norm(spectrum[size_t(y) * size + x]);
+				total += power;
+				if (fx * fx + fy * fy < cutoff * cutoff)
+					low += power;
+			}
+		}
+		return total > 0.0 ? low / total : 0.0;
+	}
+
+	double WhiteLowFrequencyFraction(uint32_t size)
+	{
+		const double cutoff = double(size) / 8.0;
+		uint32_t count = 0;
+		for (uint32_t y = 0; y < size; y++)
+		{
+			for (uint32_t x = 0; x < size; x++)
+			{
+				double fx = double(std::min(x, size - x));
+				double fy = double(std::min(y, size - y));
+				if (fx * fx + fy * fy < cutoff * cutoff && (x | y) != 0)
+					count++;
+			}
+		}
+		return double(count) / double(size * size - 1);
+	}
+
+	double Milliseconds(const std::function<void()>& work, uint32_t repeat)
+	{
+		double best = 1e30;
+		for (uint32_t i = 0; i < repeat; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			work();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t pointCount = 1024;
+	uint32_t seed = 1;
+	uint32_t repeat = 3;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--points" && hasValue)
+			pointCount = uint32_t(std::max(std::atoi(argv[++i]), 2));
+		else if (arg == "--seed" && hasValue)
+			seed = uint32_t(std::atoi(argv[++i]));
+		else if (arg == "--repeat" && hasValue)
+			repeat = uint32_t(std::max(std::atoi(argv[++i]), 1));
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+
+	// PCG32
+	{
+		const uint32_t expected[6] = { 0xA15C02B7, 0x7B47F409, 0xBA1D3330, 0x83D2F293, 0xBFA4784B, 0xCBED606E };
+		PCG32 random(42, 54);
+		bool same = true;
+		for (uint32_t value : expected)
+			same &= random.Next() == value;
+		passed &= Check("PCG32 matches the reference", same, "%g outputs", 6.0);
+
+		const uint32_t bound = 3;
+		uint32_t counts[bound] = {};
+		const uint32_t draws = 300000;
+		for (uint32_t i = 0; i < draws; i++)
+			counts[random.NextBounded(bound)]++;
+		double deviation = 0.0;
+		for (uint32_t count : counts)
+			deviation = std::max(deviation, std::fabs(double(count) / draws - 1.0 / bound));
+		passed &= Check("PCG32 bounded draws are uniform", deviation < 0.005, "max deviation %.2g", deviation);
+	}
+
+	// sequences
+	{
+		PCG32 random(seed, 0);
+		const uint32_t scrambleX = random.Next();
+		const uint32_t scrambleY = random.Next();
+		float rotation[2];
+		Sampling::GetFrameRotation(seed, rotation);
+
+		struct Sequence
+		{
+			const char* mName;
+			std::function<void(uint32_t, double[2])> mSample;
+		};
+		const Sequence sequences[] = {
+			{ "uniform random", [&](uint32_t, double p[2]) { p[0] = random.NextFloat(); p[1] = random.NextFloat(); } },
+			{ "Halton 2, 3", [](uint32_t i, double p[2]) { p[0] = Sampling::Halton(i, 0); p[1] = Sampling::Halton(i, 1); } },
+			{ "Sobol", [](uint32_t i, double p[2]) { p[0] = Sampling::Sobol(i, 0); p[1] = Sampling::Sobol(i, 1); } },
+			{ "Owen scrambled Sobol", [&](uint32_t i, double p[2]) { p[0] = Sampling::ScrambledSobol(i, 0, scrambleX); p[1] = Sampling::ScrambledSobol(i, 1, scrambleY); } },
+			{ "rotated Sobol", [&](uint32_t i, double p[2]) { p[0] = Sampling::Rotate(Sampling::Sobol(i, 0), rotation[0]); p[1] = Sampling::Rotate(Sampling::Sobol(i, 1), rotation[1]); } },
+			{ "R2", [](uint32_t i, double p[2]) { float r[2]; Sampling::R2(i, r); p[0] = r[0]; p[1] = r[1]; } },
+		};
+
+		std::printf("%-24s %10s %14s\n", "Sequence", "Points", "L2 star disc.");
+		double randomDiscrepancy = 0.0;
+		bool lowDiscrepancy = true;
+		for (const Sequence& sequence : sequences)
+		{
+			double discrepancy = L2StarDiscrepancy(MakePoints(pointCount, sequence.mSample));
+			std::printf("%-24s %10u %14.4g\n", sequence.mName, pointCount, discrepancy);
+			if (sequence.mName == sequences[0].mName)
+				randomDiscrepancy = discrepancy;
+			else
+				lowDiscrepancy &= discrepancy < randomDiscrepancy / 4.0;
+		}
+		std::printf("\n");
+		passed &= Check("sequences beat random by 4x", lowDiscrepancy, "random %.3g", randomDiscrepancy);
+
+		bool nets = true;
+		for (uint32_t count = 1; count <= 4096; count *= 2)
+		{
+			nets &= IsNet(MakePoints(count, sequences[2].mSample));
+			nets &= IsNet(MakePoints(count, sequences[3].mSample));
+		}
+		passed &= Check("Sobol prefixes are (0,m,2)-nets", nets, "up to %g points", 4096.0);
+
+		bool inRange = true;
+		for (uint32_t i = 0; i < 1 << 16; i++)
+		{
+			float values[] = { Sampling::Halton(i * 7919u, i % 16), Sampling::ScrambledSobol(~i, 1, i), Sampling::R1(i), Sampling::Rotate(Sampling::Sobol(i, 0), 0.9999999f) };
+			for (float value : values)
+				inRange &= value >= 0.0f && value < 1.0f;
+		}
+		passed &= Check("samples are in [0, 1)", inRange, "%g per sequence", 65536.0);
+	}
+
+	// blue noise
+	for (uint32_t size : { 64u, 128u })
+	{
+		std::vector<uint32_t> ranks;
+		BlueNoise::Generate(size, 1, seed, 0, ranks);
+
+		std::vector<uint8_t> seen(ranks.size(), 0);
+		bool permutation = true;
+		for (uint32_t rank : ranks)
+			permutation &= rank < ranks.size() && !seen[rank]++;
+
+		std::vector<float> values(ranks.size());
+		std::vector<float> threshold(ranks.size());
+		std::vector<float> white(ranks.size());
+		PCG32 random(seed, 1000);
+		for (size_t i = 0; i < ranks.size(); i++)
+		{
+			values[i] = BlueNoise::ToUnit(ranks[i], size);
+			threshold[i] = ranks[i] < ranks.size() / 10 ? 1.0f : 0.0f;
+			white[i] = random.NextFloat();
+		}
+		double expected = WhiteLowFrequencyFraction(size);
+		double blue = LowFrequencyFraction(values, size);
+		double blueThreshold = LowFrequencyFraction(threshold, size);
+		double whiteMeasured = LowFrequencyFraction(white, size);
+
+		char name[64];
+		std::snprintf(name, sizeof(name), "%ux%u ranks are a permutation", size, size);
+		passed &= Check(name, permutation, "%g pixels", double(ranks.size()));
+		std::snprintf(name, sizeof(name), "%ux%u white noise matches the disc", size, size);
+		passed &= Check(name, std::fabs(whiteMeasured / expected - 1.0) < 0.25, "%.3g of the power", whiteMeasured);
+		std::snprintf(name, sizeof(name), "%ux%u blue noise lacks low frequencies", size, size);
+		passed &= Check(name, blue < expected / 10.0, "%.3g of the power", blue);
+		std::snprintf(name, sizeof(name), "%ux%u 10%% threshold lacks low frequencies", size, size);
+		passed &= Check(name, blueThreshold < expected / 4.0, "%.3g of the power", blueThreshold);
+	}
+
+	// rows split over bands must pick the pixels a single thread picks
+	for (uint32_t threads : { 2u, 5u, 16u })
+	{
+		std::vector<uint32_t> single;
+		std::vector<uint32_t> split;
+		BlueNoise::Generate(64, 2, seed, 0, single);
+		BlueNoise::Generate(64, 2, seed, threads, split);
+		char name[64];
+		std::snprintf(name, sizeof(name), "64x64 x2 ranks on %u threads match 1 thread", threads);
+		passed &= Check(name, single == split, "%.0f bands per layer", double(std::min(threads / 2, 64u / BlueNoise::MIN_BAND_ROWS)));
+	}
+
+	// timing
+	{
+		const uint32_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+		std::printf("\n%-10s %8s %8s %12s\n", "Size", "Layers", "Threads", "Best ms");
+		std::vector<uint32_t> ranks;
+		for (uint32_t size : { 64u, 128u })
+		{
+			std::printf("%-10s %8u %8u %12.2f\n", (std::to_string(size) + "x" + std::to_string(size)).c_str(), 1u, 1u,
+				Milliseconds([&] { BlueNoise::Generate(size, 1, seed, 0, ranks); }, repeat));
+			std::printf("%-10s %8u %8u %12.2f\n", "", 1u, threads, Milliseconds([&] { BlueNoise::Generate(size, 1, seed, threads, ranks); }, repeat));
+			std::printf("%-10s %8u %8u %12.2f\n", "", 4u, 1u, Milliseconds([&] { BlueNoise::Generate(size, 4, seed, 0, ranks); }, repeat));
+			std::printf("%-10s %8u %8u %12.2f\n", "", 4u, threads, Milliseconds([&] { BlueNoise::Generate(size, 4, seed, threads, ranks); }, repeat));
+		}
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,233 @@
+// Checks the keys and entries of the content-addressed shader bytecode cache (ShaderCache) on a small shader tree
+// written to a temporary directory, laid out like content/shaders:
+//   Common.hlsl                  no includes
+//   Shadow.hlsli                 #include "Common.hlsl"
+//   Lighting.hlsl                #include "Common.hlsl" and "Shadow.hlsli"
+//   Blur/Blur.hlsl               #include "../Common.hlsl"
+//   Composite.hlsl               no includes
+//   CycleA.hlsl, CycleB.hlsl     include each other
+//
+//   keys       stable within and across runs, and covering entry point, target, flags, defines and compiler version
+//   compiler   the compiler version follows the size and the write time of the compiler file, 0 without one
+//   includes   editing Common.hlsl changes the key of every shader that includes it, directly, nested or through
+//              a relative path, and of no other; editing Shadow.hlsli only those that include it; a reverted edit
+//              brings the old key back; include cycles terminate; a missing include fails the key
+//   entries    stored bytecode loads back under its key only, truncated entries are rejected
+//
+//   ShaderCacheCheck
+//
+// Prints a line per check and exits with 1 if any fails and 2 on bad arguments. Standalone and standard library
+// only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o ShaderCacheCheck tools/ShaderCacheCheck/main.cpp source/ShaderCache.cpp
+
+#include "../Check.h"
+#include "ShaderCache.h"
+
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: ShaderCacheCheck\n";
+		return 2;
+	}
+
+	void WriteFile(const fs::path& path, const std::string& text)
+	{
+		fs::create_directories(path.parent_path());
+		std::ofstream(path, std::ios::binary | std::ios::trunc) << text;
+	}
+
+	const char* Shaders[] = { "Common.hlsl", "Shadow.hlsli", "Lighting.hlsl", "Blur/Blur.hlsl", "Composite.hlsl", "CycleA.hlsl" };
+
+	ShaderCache::Request MakeRequest(const fs::path& directory, const char* shader)
+	{
+		ShaderCache::Request request;
+		request.mPath = directory / shader;
+		request.mEntryPoint = "main";
+		request.mTarget = "ps_5_1";
+		return request;
+	}
+
+	// Key of every shader in the tree, 0 for the ones that fail
+	std::map<std::string, uint64_t> ComputeKeys(ShaderCache& cache, const fs::path& directory)
+	{
+		std::map<std::string, uint64_t> keys;
+		for (const char* shader : Shaders)
+		{
+			uint64_t key = 0;
+			if (!cache.ComputeKey(MakeRequest(directory, shader), key))
+				key = 0;
+			keys[shader] = key;
+		}
+		return keys;
+	}
+
+	// Shaders whose key differs between the two sets, as a bit mask in the order of Shaders
+	int Changed(const std::map<std::string, uint64_t>& before, const std::map<std::string, uint64_t>& after)
+	{
+		int mask = 0;
+		for (int i = 0; i < int(sizeof(Shaders) / sizeof(Shaders[0])); i++)
+		{
+			if (before.at(Shaders[i]) != after.at(Shaders[i]))
+				mask |= 1 << i;
+		}
+		return mask;
+	}
+}
+
+int main(int argc, char**)
+{
+	if (argc > 1)
+		return Usage();
+
+	const fs::path directory = fs::temp_directory_path() / "ShaderCacheCheck";
+	const fs::path shaders = directory / "shaders";
+	std::error_code ec;
+	fs::remove_all(directory, ec);
+
+	const std::string common = "cbuffer CommonCB : register(b0) { float4x4 ViewProjection; };\n";
+	WriteFile(shaders / "Common.hlsl", common);
+	WriteFile(shaders / "Shadow.hlsli", "#include \"Common.hlsl\"\nfloat Shadow(float3 p) { return 1.0f; }\n");
+	WriteFile(shaders / "Lighting.hlsl", "#include \"Common.hlsl\"\n  #include \"Shadow.hlsli\"\nfloat4 main() : SV_Target { return Shadow(0); }\n");
+	WriteFile(shaders / "Blur/Blur.hlsl", "#include \"../Common.hlsl\"\nfloat4 main() : SV_Target { return 0; }\n");
+	WriteFile(shaders / "Composite.hlsl", "float4 main() : SV_Target { return 1; }\n");
+	WriteFile(shaders / "CycleA.hlsl", "#include \"CycleB.hlsl\"\nfloat4 main() : SV_Target { return A(); }\n");
+	WriteFile(shaders / "CycleB.hlsl", "#include \"CycleA.hlsl\"\nfloat4 A() { return 0; }\n");
+
+	// masks of Changed, in the order of Shaders
+	const int commonBit = 1 << 0, shadowBit = 1 << 1, lightingBit = 1 << 2, blurBit = 1 << 3;
+	bool passed = true;
+
+	ShaderCache cache;
+	std::map<std::string, uint64_t> original = ComputeKeys(cache, shaders);
+	int failed = 0;
+	for (auto& key : original)
+		failed += key.second == 0;
+	passed &= Check("every shader has a key", failed == 0, "%.0f failed", double(failed));
+	passed &= Check("include cycle terminates", original["CycleA.hlsl"] != 0, "%.0f failed", double(original["CycleA.hlsl"] == 0));
+
+	std::map<std::string, uint64_t> again = ComputeKeys(cache, shaders);
+	ShaderCache nextRun;
+	std::map<std::string, uint64_t> nextRunKeys = ComputeKeys(nextRun, shaders);
+	passed &= Check("keys are stable within a run", Changed(original, again) == 0, "%.0f changed", double(std::bitset<8>(Changed(original, again)).count()));
+	passed &= Check("keys are stable across runs", Changed(original, nextRunKeys) == 0, "%.0f changed", double(std::bitset<8>(Changed(original, nextRunKeys)).count()));
+
+	{
+		ShaderCache::Request base = MakeRequest(shaders, "Lighting.hlsl");
+		uint64_t baseKey = 0, key = 0;
+		cache.ComputeKey(base, baseKey);
+		int distinct = 0;
+		ShaderCache::Request request = base;
+		request.mEntryPoint = "PSMain";
+		distinct += cache.ComputeKey(request, key) && key != baseKey;
+		request = base;
+		request.mTarget = "ps_6_0";
+		distinct += cache.ComputeKey(request, key) && key != baseKey;
+		request = base;
+		request.mFlags = 1;
+		distinct += cache.ComputeKey(request, key) && key != baseKey;
+		request = base;
+		request.mDefines = { { "SHADOWS", "1" } };
+		distinct += cache.ComputeKey(request, key) && key != baseKey;
+		uint64_t defineKey = key;
+		request.mDefines = { { "SHADOWS", "0" } };
+		distinct += cache.ComputeKey(request, key) && key != baseKey && key != defineKey;
+		request = base;
+		request.mCompilerVersion = 1;
+		distinct += cache.ComputeKey(request, key) && key != baseKey;
+		passed &= Check("entry, target, flags, defines, compiler key", distinct == 6, "%.0f of 6 distinct", double(distinct));
+	}
+
+	{
+		// a stand-in for d3dcompiler_47.dll: an update changes its size or at least its write time
+		const fs::path compiler = directory / "compiler.dll";
+		WriteFile(compiler, std::string(4096, 'c'));
+		uint64_t version = ShaderCache::GetCompilerVersion(compiler);
+		bool stable = version != 0 && ShaderCache::GetCompilerVersion(compiler) == version;
+		fs::last_write_time(compiler, fs::last_write_time(compiler) - std::chrono::hours(24));
+		uint64_t touched = ShaderCache::GetCompilerVersion(compiler);
+		WriteFile(compiler, std::string(4097, 'c'));
+		fs::last_write_time(compiler, fs::last_write_time(compiler) - std::chrono::hours(24));
+		uint64_t resized = ShaderCache::GetCompilerVersion(compiler);
+		passed &= Check("compiler version is stable", stable, "%.0f versions", double(stable));
+		passed &= Check("compiler version follows write time and size", touched != version && resized != touched && resized != version,
+			"%.0f distinct", double(1 + (touched != version) + (resized != touched && resized != version)));
+		passed &= Check("missing compiler has version 0", ShaderCache::GetCompilerVersion(directory / "missing.dll") == 0, "%.0f", 0.0);
+	}
+
+	WriteFile(shaders / "Common.hlsl", common + "static const float Pi = 3.14159265f;\n");
+	int memoized = Changed(original, ComputeKeys(cache, shaders));
+	passed &= Check("file contents are memoized until invalidated", memoized == 0, "%.0f changed", double(std::bitset<8>(memoized).count()));
+
+	cache.InvalidateFile(shaders / "Common.hlsl");
+	std::map<std::string, uint64_t> editedCommon = ComputeKeys(cache, shaders);
+	int changed = Changed(original, editedCommon);
+	passed &= Check("Common.hlsl edit reaches direct includers", (changed & lightingBit) && (changed & shadowBit), "changed mask %.0f", double(changed));
+	passed &= Check("Common.hlsl edit reaches relative includes", (changed & blurBit) != 0, "changed mask %.0f", double(changed));
+	passed &= Check("Common.hlsl edit leaves other shaders", changed == (commonBit | shadowBit | lightingBit | blurBit), "changed mask %.0f", double(changed));
+
+	ShaderCache freshAfterCommon;
+	int fresh = Changed(editedCommon, ComputeKeys(freshAfterCommon, shaders));
+	passed &= Check("next run sees the same edited keys", fresh == 0, "%.0f changed", double(std::bitset<8>(fresh).count()));
+
+	WriteFile(shaders / "Common.hlsl", common);
+	cache.InvalidateFile(shaders / "Common.hlsl");
+	int reverted = Changed(original, ComputeKeys(cache, shaders));
+	passed &= Check("reverted edit restores the keys", reverted == 0, "%.0f changed", double(std::bitset<8>(reverted).count()));
+
+	WriteFile(shaders / "Shadow.hlsli", "#include \"Common.hlsl\"\nfloat Shadow(float3 p) { return 0.5f; }\n");
+	cache.InvalidateFile(shaders / "Shadow.hlsli");
+	changed = Changed(original, ComputeKeys(cache, shaders));
+	passed &= Check("nested include edit reaches its includers", changed == (shadowBit | lightingBit), "changed mask %.0f", double(changed));
+
+	WriteFile(shaders / "Composite.hlsl", "#include \"Missing.hlsl\"\nfloat4 main() : SV_Target { return 1; }\n");
+	cache.InvalidateFile();
+	uint64_t missingKey = 0;
+	passed &= Check("missing include fails the key", !cache.ComputeKey(MakeRequest(shaders, "Composite.hlsl"), missingKey), "%.0f keys", 0.0);
+
+	{
+		std::vector<fs::path> includes = ShaderCache::ParseIncludes("#include <Common.hlsl>\n\t#include \"a/b.hlsl\"\n// #include \"c.hlsl\"\n#define X\n", shaders / "Main.hlsl");
+		bool parsed = includes.size() == 2 && includes[0] == (shaders / "Common.hlsl").lexically_normal() &&
+			includes[1] == (shaders / "a/b.hlsl").lexically_normal();
+		passed &= Check("includes are parsed and resolved", parsed, "%.0f includes", double(includes.size()));
+	}
+
+	{
+		ShaderCache store;
+		const uint8_t bytecode[] = { 0x44, 0x58, 0x42, 0x43, 1, 2, 3, 4, 5, 6, 7, 8 };
+		std::vector<uint8_t> loaded;
+		passed &= Check("no directory stores nothing", !store.Store(1, bytecode, sizeof(bytecode)) && !store.Load(1, loaded), "%.0f entries", 0.0);
+
+		store.SetDirectory(directory / "cache");
+		uint64_t key = original["Lighting.hlsl"];
+		bool stored = store.Store(key, bytecode, sizeof(bytecode));
+		bool roundTrip = store.Load(key, loaded) && loaded == std::vector<uint8_t>(bytecode, bytecode + sizeof(bytecode));
+		passed &= Check("stored bytecode loads back", stored && roundTrip, "%.0f bytes", double(loaded.size()));
+		passed &= Check("other keys miss", !store.Load(key + 1, loaded), "%.0f loaded", 0.0);
+
+		fs::copy_file(store.GetEntryPath(key), store.GetEntryPath(key + 1), ec);
+		passed &= Check("entry under a foreign name is rejected", !store.Load(key + 1, loaded), "%.0f loaded", 0.0);
+
+		fs::resize_file(store.GetEntryPath(key), fs::file_size(store.GetEntryPath(key)) - 1, ec);
+		passed &= Check("truncated entry is rejected", !store.Load(key, loaded), "%.0f loaded", 0.0);
+
+		int temporaries = 0;
+		for (const fs::directory_entry& entry : fs::directory_iterator(store.GetDirectory()))
+			temporaries += entry.path().extension() == ".tmp";
+		passed &= Check("no temporary files are left", temporaries == 0, "%.0f left", double(temporaries));
+	}
+
+	fs::remove_all(directory, ec);
+	return passed ? 0 : 1;
+}
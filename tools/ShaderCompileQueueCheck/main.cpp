@@ -0,0 +1,203 @@
+// Drives ShaderCompileQueue with a stub compiler that sleeps instead of compiling, in the layout the GI scene uses at
+// startup: every Init* pass is a continuation that depends on its own shaders and on the previous pass.
+//   order      every job runs once; continuations run on the thread that calls Run, in submission order and only
+//              after all of their dependencies, compiles run on the workers (on the caller for 0 threads)
+//   failures   a failing compile or a throwing continuation makes Run return "name: error", is counted once and skips
+//              the continuations depending on it, the earlier ones still run
+//   speed      with 4 workers the sleeping compiles overlap, at least 2x the serial baseline
+//   reuse      Clear empties the queue and a refilled queue runs again
+//
+//   ShaderCompileQueueCheck [--passes n] [--shaders n] [--ms n]
+//
+// Prints a line per check and exits with 1 if any fails and 2 on bad arguments. Standalone and standard library
+// only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -pthread -I source -o ShaderCompileQueueCheck tools/ShaderCompileQueueCheck/main.cpp source/ShaderCompileQueue.cpp source/CpuProfiler.cpp
+
+#include "../Check.h"
+#include "ShaderCompileQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: ShaderCompileQueueCheck [--passes n] [--shaders n] [--ms n]\n";
+		return 2;
+	}
+
+	// What the stub compiler and the continuations observed during one Run
+	struct Trace
+	{
+		std::mutex mMutex;
+		std::vector<int> mCompileRuns;          // per shader
+		std::vector<int> mPassRuns;             // per pass
+		std::vector<int> mPassOrder;
+		std::vector<std::atomic<bool>> mCompiled;
+		std::vector<std::thread::id> mCompileThreads;
+		int mEarlyPasses = 0;                   // ran before one of their shaders or the previous pass
+		int mPassesOffCaller = 0;
+
+		explicit Trace(int shaders, int passes) : mCompileRuns(shaders), mPassRuns(passes), mCompiled(shaders), mCompileThreads(shaders) {}
+	};
+
+	// passes * shadersPerPass compiles of ms each; the shader named in failing returns an error, the pass named in
+	// throwing throws
+	void Fill(ShaderCompileQueue& queue, Trace& trace, int passes, int shadersPerPass, int ms, int failing = -1, int throwing = -1)
+	{
+		const std::thread::id caller = std::this_thread::get_id();
+		ShaderCompileQueue::Handle previous = 0;
+		for (int pass = 0; pass < passes; pass++)
+		{
+			std::vector<ShaderCompileQueue::Handle> dependencies;
+			for (int i = 0; i < shadersPerPass; i++)
+			{
+				int shader = pass * shadersPerPass + i;
+				dependencies.push_back(queue.AddCompile("shader" + std::to_string(shader), [&trace, shader, ms, failing](std::string& error) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+					{
+						std::lock_guard<std::mutex> lock(trace.mMutex);
+						trace.mCompileRuns[shader]++;
+						trace.mCompileThreads[shader] = std::this_thread::get_id();
+					}
+					trace.mCompiled[shader] = true;
+					if (shader == failing)
+					{
+						error = "X3000: syntax error";
+						return false;
+					}
+					return true;
+				}));
+			}
+			if (pass > 0)
+				dependencies.push_back(previous);
+
+			previous = queue.AddContinuation("pass" + std::to_string(pass), dependencies, [&trace, pass, shadersPerPass, caller, throwing]() {
+				if (pass == throwing)
+					throw std::runtime_error("out of memory");
+				bool ready = pass == 0 || trace.mPassRuns[pass - 1] > 0;
+				for (int i = 0; i < shadersPerPass; i++)
+					ready &= trace.mCompiled[pass * shadersPerPass + i].load();
+				trace.mEarlyPasses += !ready;
+				trace.mPassesOffCaller += std::this_thread::get_id() != caller;
+				trace.mPassRuns[pass]++;
+				trace.mPassOrder.push_back(pass);
+			});
+		}
+	}
+
+	bool RunOnce(int runs) { return runs == 1; }
+}
+
+int main(int argc, char** argv)
+{
+	int passes = 8;
+	int shadersPerPass = 4;
+	int ms = 10;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--passes" && hasValue)
+			passes = std::max(std::atoi(argv[++i]), 2);
+		else if (arg == "--shaders" && hasValue)
+			shadersPerPass = std::max(std::atoi(argv[++i]), 1);
+		else if (arg == "--ms" && hasValue)
+			ms = std::max(std::atoi(argv[++i]), 1);
+		else
+			return Usage();
+	}
+
+	const int shaders = passes * shadersPerPass;
+	const std::thread::id caller = std::this_thread::get_id();
+	bool passed = true;
+	double serialMs = 0.0;
+
+	for (uint32_t threads : { 0u, 1u, 4u })
+	{
+		ShaderCompileQueue queue;
+		Trace trace(shaders, passes);
+		Fill(queue, trace, passes, shadersPerPass, ms);
+		bool success = queue.Run(threads).empty();
+		const ShaderCompileQueue::Stats& stats = queue.GetStats();
+
+		int onCaller = 0;
+		for (const std::thread::id& thread : trace.mCompileThreads)
+			onCaller += thread == caller;
+		bool once = std::all_of(trace.mCompileRuns.begin(), trace.mCompileRuns.end(), RunOnce) &&
+			std::all_of(trace.mPassRuns.begin(), trace.mPassRuns.end(), RunOnce);
+		bool ordered = std::is_sorted(trace.mPassOrder.begin(), trace.mPassOrder.end()) && int(trace.mPassOrder.size()) == passes;
+
+		std::string prefix = std::to_string(threads) + " threads: ";
+		passed &= Check((prefix + "succeeds").c_str(), success && stats.mFailedCount == 0 && queue.GetErrors().empty(), "%.0f failed", double(stats.mFailedCount));
+		passed &= Check((prefix + "every job runs once").c_str(), once && stats.mJobCount == uint32_t(shaders), "%.0f compiles", double(stats.mJobCount));
+		passed &= Check((prefix + "passes in submission order").c_str(), ordered, "%.0f passes", double(trace.mPassOrder.size()));
+		passed &= Check((prefix + "passes after their dependencies").c_str(), trace.mEarlyPasses == 0, "%.0f early", double(trace.mEarlyPasses));
+		passed &= Check((prefix + "passes on the calling thread").c_str(), trace.mPassesOffCaller == 0, "%.0f elsewhere", double(trace.mPassesOffCaller));
+		passed &= Check((prefix + "compiles on the expected thread").c_str(), onCaller == (threads == 0 ? shaders : 0), "%.0f on the caller", double(onCaller));
+
+		if (threads == 0)
+			serialMs = stats.mWallMs;
+		else if (threads == 4)
+			passed &= Check("4 threads: at least 2x the serial baseline", stats.mWallMs * 2.0 <= serialMs, "%.1fx", serialMs / stats.mWallMs);
+		std::printf("    %s", queue.GetStatsString().c_str());
+	}
+
+	// the shader of pass 1 fails or pass 1 throws: pass 0 runs, pass 1 and every later pass (they depend on it) do not
+	for (bool throwing : { false, true })
+	{
+		for (uint32_t threads : { 0u, 4u })
+		{
+			ShaderCompileQueue queue;
+			Trace trace(shaders, passes);
+			const int failing = shadersPerPass + 1;
+			Fill(queue, trace, passes, shadersPerPass, 1, throwing ? -1 : failing, throwing ? 1 : -1);
+			std::vector<std::string> errors = queue.Run(threads);
+			const ShaderCompileQueue::Stats& stats = queue.GetStats();
+
+			std::string prefix = std::to_string(threads) + " threads: " + (throwing ? "throwing pass " : "failed compile ");
+			std::string expected = throwing ? "pass1: out of memory" : "shader" + std::to_string(failing) + ": X3000: syntax error";
+			bool skipped = trace.mPassRuns[0] == 1 && std::count(trace.mPassRuns.begin() + 1, trace.mPassRuns.end(), 0) == passes - 1;
+			uint32_t expectedSkips = uint32_t(throwing ? passes - 2 : passes - 1);
+			passed &= Check((prefix + "is returned").c_str(), errors.size() == 1 && errors[0] == expected && errors == queue.GetErrors(), "%.0f errors", double(errors.size()));
+			passed &= Check((prefix + "is counted once").c_str(), stats.mFailedCount == 1, "%.0f failed", double(stats.mFailedCount));
+			passed &= Check((prefix + "skips the later passes").c_str(), skipped && stats.mSkippedCount == expectedSkips, "%.0f skipped", double(stats.mSkippedCount));
+		}
+	}
+
+	{
+		ShaderCompileQueue queue;
+		Trace first(shaders, passes);
+		Fill(queue, first, passes, shadersPerPass, 1, 0);
+		queue.Run(2);
+		queue.Clear();
+		bool cleared = queue.GetErrors().empty() && queue.GetStats().mJobCount == 0;
+
+		Trace second(shaders, passes);
+		Fill(queue, second, passes, shadersPerPass, 1);
+		bool success = queue.Run(2).empty();
+		bool once = std::all_of(second.mCompileRuns.begin(), second.mCompileRuns.end(), RunOnce) &&
+			std::all_of(second.mPassRuns.begin(), second.mPassRuns.end(), RunOnce);
+		passed &= Check("cleared queue runs again", cleared && success && once, "%.0f compiles", double(queue.GetStats().mJobCount));
+	}
+
+	{
+		ShaderCompileQueue queue;
+		bool ran = false;
+		queue.AddContinuation("alone", {}, [&ran]() { ran = true; });
+		bool success = queue.Run(4).empty();
+		passed &= Check("continuation without dependencies runs", success && ran, "%.0f compiles", double(queue.GetStats().mJobCount));
+	}
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+// Checks the hot reload invalidation of ShaderDependencyGraph on an in-memory shader tree read through SetReadFunc:
+//   Lighting.hlsl    -> Common.hlsl, Shadow.hlsli -> Common.hlsl, Sampling.hlsli
+//   GBuffer.hlsl     -> Common.hlsl
+//   VCT.hlsl         -> GBuffer.hlsl (a root included by another root)
+//   Blur/Blur.hlsl   -> ../Sampling.hlsli
+//   Cycle.hlsl       -> CycleA.hlsli -> CycleB.hlsli -> CycleA.hlsli, Common.hlsl
+//   Composite.hlsl      no includes
+//
+//   transitive  a change reaches every root that includes the file directly, nested, through a relative path,
+//               through another root or through an include cycle, and no other root
+//   reading     shared includes are read once, cycles terminate, missing includes stay in the graph
+//   edits       OnFileChanged re-reads the file, so added and removed includes change what later edits reach
+//
+//   ShaderDependencyGraphCheck
+//
+// Prints a line per check and exits with 1 if any fails and 2 on bad arguments. Standalone and standard library
+// only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o ShaderDependencyGraphCheck tools/ShaderDependencyGraphCheck/main.cpp source/ShaderDependencyGraph.cpp source/ShaderCache.cpp
+
+#include "../Check.h"
+#include "ShaderDependencyGraph.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: ShaderDependencyGraphCheck\n";
+		return 2;
+	}
+
+	const fs::path Shaders = fs::path("/shaders");
+
+	// Files of the tree and how often the graph read each of them
+	struct Files
+	{
+		std::map<fs::path, std::string> mSources;
+		std::map<fs::path, int> mReads;
+
+		void Set(const std::string& name, const std::string& source) { mSources[Shaders / name] = source; }
+	};
+
+	// Root names as the graph reports them, relative to Shaders
+	std::vector<std::string> Names(const std::vector<fs::path>& roots)
+	{
+		std::vector<std::string> names;
+		for (const fs::path& root : roots)
+			names.push_back(root.lexically_relative(Shaders).generic_string());
+		std::sort(names.begin(), names.end());
+		return names;
+	}
+
+	bool Reaches(const std::vector<fs::path>& roots, std::vector<std::string> expected)
+	{
+		std::sort(expected.begin(), expected.end());
+		return Names(roots) == expected;
+	}
+}
+
+int main(int argc, char**)
+{
+	if (argc > 1)
+		return Usage();
+
+	Files files;
+	files.Set("Common.hlsl", "cbuffer CommonCB : register(b0) { float4x4 ViewProjection; };\n");
+	files.Set("Sampling.hlsli", "float2 Hammersley(uint i, uint n) { return 0; }\n");
+	files.Set("Shadow.hlsli", "#include \"Common.hlsl\"\n#include \"Sampling.hlsli\"\n");
+	files.Set("Lighting.hlsl", "#include \"Common.hlsl\"\n#include \"Shadow.hlsli\"\n");
+	files.Set("GBuffer.hlsl", "#include \"Common.hlsl\"\n");
+	files.Set("VCT.hlsl", "#include \"GBuffer.hlsl\"\n");
+	files.Set("Blur/Blur.hlsl", "#include \"../Sampling.hlsli\"\n");
+	files.Set("Cycle.hlsl", "#include \"CycleA.hlsli\"\n");
+	files.Set("CycleA.hlsli", "#include \"CycleB.hlsli\"\n");
+	files.Set("CycleB.hlsli", "#include \"CycleA.hlsli\"\n#include \"Common.hlsl\"\n");
+	files.Set("Composite.hlsl", "float4 main() : SV_Target { return 1; }\n");
+
+	ShaderDependencyGraph graph;
+	graph.SetReadFunc([&files](const fs::path& path, std::string& source) {
+		files.mReads[path]++;
+		auto it = files.mSources.find(path);
+		if (it == files.mSources.end())
+			return false;
+		source = it->second;
+		return true;
+	});
+
+	const char* roots[] = { "Lighting.hlsl", "GBuffer.hlsl", "VCT.hlsl", "Blur/Blur.hlsl", "Cycle.hlsl", "Composite.hlsl" };
+	for (const char* root : roots)
+		graph.AddRoot(Shaders / root);
+
+	bool passed = true;
+
+	size_t fileCount = graph.GetFiles().size();
+	passed &= Check("graph holds every root and include", fileCount == files.mSources.size(), "%.0f files", double(fileCount));
+	int rereads = 0;
+	for (auto& reads : files.mReads)
+		rereads += reads.second > 1;
+	passed &= Check("shared includes and cycles are read once", rereads == 0 && files.mReads.size() == files.mSources.size(), "%.0f read twice", double(rereads));
+
+	std::vector<fs::path> affected = graph.GetAffectedRoots(Shaders / "Common.hlsl");
+	passed &= Check("Common.hlsl reaches every includer", Reaches(affected, { "Lighting.hlsl", "GBuffer.hlsl", "VCT.hlsl", "Cycle.hlsl" }), "%.0f roots", double(affected.size()));
+
+	affected = graph.GetAffectedRoots(Shaders / "Sampling.hlsli");
+	passed &= Check("nested and relative includes are reached", Reaches(affected, { "Lighting.hlsl", "Blur/Blur.hlsl" }), "%.0f roots", double(affected.size()));
+
+	affected = graph.GetAffectedRoots(Shaders / "CycleB.hlsli");
+	bool cycleB = Reaches(affected, { "Cycle.hlsl" });
+	affected = graph.GetAffectedRoots(Shaders / "CycleA.hlsli");
+	passed &= Check("include cycles reach their root", cycleB && Reaches(affected, { "Cycle.hlsl" }), "%.0f roots", double(affected.size()));
+
+	affected = graph.GetAffectedRoots(Shaders / "GBuffer.hlsl");
+	passed &= Check("a root reaches itself and its includers", Reaches(affected, { "GBuffer.hlsl", "VCT.hlsl" }), "%.0f roots", double(affected.size()));
+
+	affected = graph.GetAffectedRoots(Shaders / "Blur/../Common.hlsl");
+	passed &= Check("changed paths are normalized", Reaches(affected, { "Lighting.hlsl", "GBuffer.hlsl", "VCT.hlsl", "Cycle.hlsl" }), "%.0f roots", double(affected.size()));
+
+	affected = graph.GetAffectedRoots(Shaders / "Unrelated.hlsl");
+	passed &= Check("unrelated files reach nothing", affected.empty(), "%.0f roots", double(affected.size()));
+
+	files.mReads.clear();
+	affected = graph.OnFileChanged(Shaders / "Common.hlsl");
+	passed &= Check("OnFileChanged re-reads only the file", files.mReads.size() == 1 && files.mReads[Shaders / "Common.hlsl"] == 1, "%.0f files read", double(files.mReads.size()));
+
+	files.Set("Composite.hlsl", "#include \"Common.hlsl\"\n#include \"Tonemap.hlsli\"\n");
+	files.Set("Tonemap.hlsli", "#include \"Sampling.hlsli\"\n");
+	affected = graph.OnFileChanged(Shaders / "Composite.hlsl");
+	passed &= Check("changed root reports itself", Reaches(affected, { "Composite.hlsl" }), "%.0f roots", double(affected.size()));
+	std::vector<fs::path> watched = graph.GetFiles();
+	bool pulledIn = std::find(watched.begin(), watched.end(), Shaders / "Tonemap.hlsli") != watched.end();
+	passed &= Check("new includes are pulled into the graph", pulledIn, "%.0f files", double(watched.size()));
+	affected = graph.GetAffectedRoots(Shaders / "Sampling.hlsli");
+	passed &= Check("added includes reach the edited root", Reaches(affected, { "Lighting.hlsl", "Blur/Blur.hlsl", "Composite.hlsl" }), "%.0f roots", double(affected.size()));
+
+	files.Set("Lighting.hlsl", "#include \"Common.hlsl\"\n");
+	graph.OnFileChanged(Shaders / "Lighting.hlsl");
+	affected = graph.GetAffectedRoots(Shaders / "Shadow.hlsli");
+	passed &= Check("removed includes no longer reach it", affected.empty(), "%.0f roots", double(affected.size()));
+
+	files.Set("CycleB.hlsli", "#include \"CycleA.hlsli\"\n");
+	graph.OnFileChanged(Shaders / "CycleB.hlsli");
+	affected = graph.GetAffectedRoots(Shaders / "Common.hlsl");
+	passed &= Check("edits inside a cycle are picked up", Reaches(affected, { "Lighting.hlsl", "GBuffer.hlsl", "VCT.hlsl", "Composite.hlsl" }), "%.0f roots", double(affected.size()));
+
+	files.Set("GBuffer.hlsl", "#include \"Common.hlsl\"\n#include \"Missing.hlsli\"\n");
+	graph.OnFileChanged(Shaders / "GBuffer.hlsl");
+	const std::vector<fs::path>* missing = graph.GetIncludes(Shaders / "Missing.hlsli");
+	passed &= Check("missing includes stay in the graph", missing && missing->empty(), "%.0f includes", missing ? double(missing->size()) : -1.0);
+	files.Set("Missing.hlsli", "#include \"Sampling.hlsli\"\n");
+	affected = graph.OnFileChanged(Shaders / "Missing.hlsli");
+	bool created = Reaches(affected, { "GBuffer.hlsl", "VCT.hlsl" }) &&
+		Reaches(graph.GetAffectedRoots(Shaders / "Sampling.hlsli"), { "Blur/Blur.hlsl", "Composite.hlsl", "GBuffer.hlsl", "VCT.hlsl" });
+	passed &= Check("a created include joins the graph", created, "%.0f roots", double(affected.size()));
+
+	graph.Clear();
+	passed &= Check("Clear empties the graph", graph.GetFiles().empty() && !graph.IsRoot(Shaders / "Lighting.hlsl"), "%.0f files", double(graph.GetFiles().size()));
+
+	return passed ? 0 : 1;
+}
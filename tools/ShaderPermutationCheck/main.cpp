@@ -0,0 +1,171 @@
+// Checks the key encoding of ShaderPermutationSpace and the option spaces and quality tiers of the GI scene:
+//   keys       every key of a multi-option space decodes and encodes back to itself, keys are dense and distinct,
+//              key 0 is all defaults and the first option is the least significant digit
+//   lookups    MakeKey, SetOption and GetOption agree with Encode/Decode; missing options keep their default,
+//              values outside the space, unknown options and out of range keys are rejected
+//   defines    one define per option in declaration order, distinct for every key
+//   scene      every Low/Medium/High tier maps to a key in each space the scene declares, High to the defaults
+//
+//   ShaderPermutationCheck
+//
+// Prints a line per check and exits with 1 if any fails and 2 on bad arguments. Standalone and standard library
+// only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o ShaderPermutationCheck tools/ShaderPermutationCheck/main.cpp source/ShaderPermutation.cpp
+
+#include "../Check.h"
+#include "ShaderPermutation.h"
+
+#include <cstdio>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: ShaderPermutationCheck\n";
+		return 2;
+	}
+
+	// The quality tiers of DXRSExampleGIScene.cpp, with RSM_MAX_SAMPLES_COUNT and SSAO_MAX_KERNEL spelled out
+	struct QualityTier
+	{
+		const char* mName;
+		int mRSMSamplesCount;
+		int mSSAOKernelSize;
+		int mVCTConesCount;
+		int mBlurTaps;
+	};
+	const QualityTier QualityTiers[] = {
+		{ "Low", 64, 4, 1, 5 },
+		{ "Medium", 256, 8, 6, 7 },
+		{ "High", 512, 16, 6, 9 },
+	};
+}
+
+int main(int argc, char**)
+{
+	if (argc > 1)
+		return Usage();
+
+	bool passed = true;
+
+	const ShaderPermutationSpace space = {
+		{ "RSM_SAMPLES_COUNT", { 512, 256, 64 } },
+		{ "USE_LIGHTCUTS", { 0, 1 } },
+		{ "BLUR_TAPS", { 9, 7, 5, 3 } },
+	};
+	const uint32_t count = space.GetVariantCount();
+	passed &= Check("variant count is the product of the radices", count == 3 * 2 * 4, "%.0f variants", double(count));
+
+	{
+		int roundTrips = 0;
+		std::set<std::vector<int>> tuples;
+		for (ShaderPermutationSpace::Key key = 0; key < count; key++)
+		{
+			std::vector<int> values;
+			ShaderPermutationSpace::Key encoded = ~0u;
+			if (space.Decode(key, values) && space.Encode(values, encoded) && encoded == key)
+				roundTrips++;
+			tuples.insert(values);
+		}
+		passed &= Check("every key round-trips", roundTrips == int(count), "%.0f keys", double(roundTrips));
+		passed &= Check("keys are dense and distinct", tuples.size() == count, "%.0f value sets", double(tuples.size()));
+	}
+
+	{
+		std::vector<int> values;
+		space.Decode(0, values);
+		passed &= Check("key 0 is all defaults", values == std::vector<int>({ 512, 0, 9 }), "%.0f options", double(values.size()));
+
+		ShaderPermutationSpace::Key key = 0;
+		bool lowDigit = space.Encode({ 256, 0, 9 }, key) && key == 1;
+		bool highDigit = space.Encode({ 512, 0, 7 }, key) && key == 3 * 2;
+		passed &= Check("first option is the lowest digit", lowDigit && highDigit, "key %.0f for BLUR_TAPS 7", double(key));
+
+		bool last = space.Encode({ 64, 1, 3 }, key) && key == count - 1;
+		passed &= Check("last values give the last key", last, "key %.0f", double(key));
+	}
+
+	{
+		std::vector<int> values;
+		ShaderPermutationSpace::Key key = 0;
+		int rejected = 0;
+		rejected += !space.Decode(count, values);
+		rejected += !space.Encode({ 512, 0 }, key);
+		rejected += !space.Encode({ 128, 0, 9 }, key);
+		rejected += !space.MakeKey({ { "BLUR_TAPS", 11 } }, key);
+		passed &= Check("invalid keys and values are rejected", rejected == 4, "%.0f of 4", double(rejected));
+	}
+
+	{
+		ShaderPermutationSpace::Key key = 0, expected = 0;
+		bool made = space.MakeKey({ { "BLUR_TAPS", 5 }, { "SSAO_KERNEL_SIZE", 4 } }, key) && space.Encode({ 512, 0, 5 }, expected);
+		passed &= Check("MakeKey defaults and ignores other options", made && key == expected, "key %.0f", double(key));
+
+		int value = 0;
+		bool set = space.SetOption(key, "USE_LIGHTCUTS", 1) && space.GetOption(key, "USE_LIGHTCUTS", value) && value == 1;
+		int blur = 0;
+		set &= space.GetOption(key, "BLUR_TAPS", blur) && blur == 5;
+		passed &= Check("SetOption keeps the other options", set, "key %.0f", double(key));
+
+		ShaderPermutationSpace::Key unchanged = key;
+		bool refused = !space.SetOption(key, "USE_LIGHTCUTS", 2) && !space.SetOption(key, "NUM_CONES", 6) &&
+			!space.GetOption(key, "NUM_CONES", value) && !space.GetOption(count, "BLUR_TAPS", value);
+		passed &= Check("unknown options and values are refused", refused && key == unchanged, "key %.0f", double(key));
+	}
+
+	{
+		std::vector<std::pair<std::string, std::string>> defines = space.GetDefines(1);
+		bool ordered = defines.size() == 3 && defines[0] == std::make_pair(std::string("RSM_SAMPLES_COUNT"), std::string("256")) &&
+			defines[1] == std::make_pair(std::string("USE_LIGHTCUTS"), std::string("0")) &&
+			defines[2] == std::make_pair(std::string("BLUR_TAPS"), std::string("9"));
+		passed &= Check("defines follow declaration order", ordered, "%.0f defines", double(defines.size()));
+
+		std::set<std::vector<std::pair<std::string, std::string>>> distinct;
+		for (ShaderPermutationSpace::Key key = 0; key < count; key++)
+			distinct.insert(space.GetDefines(key));
+		passed &= Check("every key has its own defines", distinct.size() == count, "%.0f define sets", double(distinct.size()));
+		passed &= Check("invalid keys have no defines", space.GetDefines(count).empty(), "%.0f defines", double(space.GetDefines(count).size()));
+	}
+
+	{
+		ShaderPermutationSpace empty;
+		ShaderPermutationSpace::Key key = 1;
+		bool single = empty.GetVariantCount() == 1 && empty.MakeKey({}, key) && key == 0 && empty.GetDefines(0).empty();
+		passed &= Check("a shader without options has one variant", single, "%.0f variants", double(empty.GetVariantCount()));
+	}
+
+	// Spaces as DXRSExampleGIScene.h declares them
+	const ShaderPermutationSpace rsm = { { "RSM_SAMPLES_COUNT", { 512, 256, 64 } } };
+	const ShaderPermutationSpace ssao = { { "SSAO_KERNEL_SIZE", { 16, 8, 4 } } };
+	const ShaderPermutationSpace vct = { { "NUM_CONES", { 6, 1 } } };
+	const ShaderPermutationSpace blur = { { "BLUR_TAPS", { 9, 7, 5 } } };
+	const ShaderPermutationSpace* sceneSpaces[] = { &rsm, &ssao, &vct, &blur };
+
+	std::set<std::vector<ShaderPermutationSpace::Key>> tierKeys;
+	for (const QualityTier& tier : QualityTiers)
+	{
+		ShaderPermutationSpace::Settings settings = {
+			{ "RSM_SAMPLES_COUNT", tier.mRSMSamplesCount }, { "SSAO_KERNEL_SIZE", tier.mSSAOKernelSize },
+			{ "NUM_CONES", tier.mVCTConesCount }, { "BLUR_TAPS", tier.mBlurTaps } };
+		int valid = 0;
+		std::vector<ShaderPermutationSpace::Key> keys;
+		for (const ShaderPermutationSpace* sceneSpace : sceneSpaces)
+		{
+			ShaderPermutationSpace::Key key = 0;
+			valid += sceneSpace->MakeKey(settings, key);
+			keys.push_back(key);
+		}
+		tierKeys.insert(keys);
+		std::string name = std::string(tier.mName) + " tier has a key in every space";
+		passed &= Check(name.c_str(), valid == 4, "%.0f of 4 spaces", double(valid));
+		if (std::string(tier.mName) == "High")
+			passed &= Check("High tier is the default variants", keys == std::vector<ShaderPermutationSpace::Key>(4, 0), "%.0f spaces", double(keys.size()));
+	}
+	passed &= Check("tiers select different variants", tierKeys.size() == 3, "%.0f distinct", double(tierKeys.size()));
+
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+// Checks the allocation and retirement of StagingRing and measures the staging throughput UploadManager gets from it.
+//   allocation  offsets are aligned, in order and never split at the end of the ring: an allocation that does not
+//               fit before the end skips to the start; zero and oversized requests fail
+//   retirement  a full ring fails until its oldest batch retires, GetOldestFenceValue names that batch, batches
+//               retire in order and only up to the completed value, an empty ring starts over at offset 0
+//   overlap     a long random run of allocations, closes and retires never hands out bytes that a batch the GPU
+//               has not finished still owns, and never more than the capacity
+//   throughput  uploads of 64 KB to 2 MB are copied into a ring of UploadManager's default 64 MB, closed every
+//               16 MB like its batches, with the GPU completing each batch two batches after it was closed. The ring
+//               must not stall and must keep at least 80% of the speed of the same copies into a plain buffer
+//
+//   StagingRingCheck [--gb n] [--behind n] [--min-gbps x] [--seed n]
+//
+// --gb is the amount copied by the throughput run (4), --behind how many batches the GPU lags (2) and --min-gbps an
+// optional absolute floor for the ring's copy rate; the last one depends on the machine and is off by default.
+// Prints a line per check and exits with 1 if any fails and 2 on bad arguments. Standalone and standard library
+// only, e.g. on Linux:
+//   g++ -std=c++17 -O2 -I source -o StagingRingCheck tools/StagingRingCheck/main.cpp source/StagingRing.cpp
+
+#include "../Check.h"
+#include "StagingRing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	int Usage()
+	{
+		std::cerr << "usage: StagingRingCheck [--gb n] [--behind n] [--min-gbps x] [--seed n]\n";
+		return 2;
+	}
+
+	// UploadManager::DEFAULT_RING_SIZE and DEFAULT_BATCH_SIZE
+	const uint64_t RingSize = 64 * 1024 * 1024;
+	const uint64_t BatchSize = 16 * 1024 * 1024;
+
+	// A live allocation and the fence value of the batch it was closed with (0 while open)
+	struct Allocation
+	{
+		uint64_t mOffset;
+		uint64_t mSize;
+		uint64_t mFenceValue;
+	};
+
+	bool Overlaps(const Allocation& a, const Allocation& b)
+	{
+		return a.mOffset < b.mOffset + b.mSize && b.mOffset < a.mOffset + a.mSize;
+	}
+
+	// Copies totalBytes of uploads of random sizes, closing a batch every BatchSize bytes, into ring memory through
+	// the ring (useRing) or at running offsets of a plain buffer. Returns the copy rate in GB/s.
+	double Stream(uint64_t totalBytes, uint32_t behind, uint32_t seed, bool useRing, StagingRing& ring, std::vector<uint8_t>& memory, const std::vector<uint8_t>& source)
+	{
+		std::mt19937 random(seed);
+		std::uniform_int_distribution<uint64_t> sizes(64 * 1024, 2 * 1024 * 1024);
+		ring.Reset(RingSize);
+		uint64_t copied = 0, batchBytes = 0, fenceValue = 0, plainOffset = 0;
+
+		auto start = std::chrono::steady_clock::now();
+		while (copied < totalBytes)
+		{
+			uint64_t size = sizes(random);
+			uint64_t offset = 0;
+			if (useRing)
+			{
+				offset = ring.Allocate(size, 512);
+				if (offset == StagingRing::INVALID_OFFSET)
+				{
+					// UploadManager would submit and wait for the oldest batch here
+					ring.Close(++fenceValue);
+					ring.Retire(ring.GetOldestFenceValue());
+					offset = ring.Allocate(size, 512);
+				}
+			}
+			else
+			{
+				plainOffset = (plainOffset + 511) / 512 * 512;
+				if (plainOffset + size > RingSize)
+					plainOffset = 0;
+				offset = plainOffset;
+				plainOffset += size;
+			}
+			std::memcpy(memory.data() + offset, source.data(), size_t(size));
+			copied += size;
+			batchBytes += size;
+
+			if (batchBytes >= BatchSize)
+			{
+				batchBytes = 0;
+				if (useRing)
+				{
+					ring.Close(++fenceValue);
+					ring.Retire(fenceValue > behind ? fenceValue - behind : 0);
+				}
+			}
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		return double(copied) / seconds / 1e9;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	double gigabytes = 4.0;
+	uint32_t behind = 2;
+	double minGbps = 0.0;
+	uint32_t seed = 1;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--gb" && hasValue)
+			gigabytes = std::max(std::atof(argv[++i]), 0.1);
+		else if (arg == "--behind" && hasValue)
+			behind = uint32_t(std::max(std::atoi(argv[++i]), 0));
+		else if (arg == "--min-gbps" && hasValue)
+			minGbps = std::atof(argv[++i]);
+		else if (arg == "--seed" && hasValue)
+			seed = uint32_t(std::atoi(argv[++i]));
+		else
+			return Usage();
+	}
+
+	bool passed = true;
+
+	{
+		StagingRing ring(1024);
+		uint64_t a = ring.Allocate(100, 1);
+		uint64_t b = ring.Allocate(100, 256);
+		uint64_t c = ring.Allocate(10, 16);
+		passed &= Check("allocations are aligned and in order", a == 0 && b == 256 && c == 368, "offset %.0f", double(c));
+
+		int rejected = 0;
+		rejected += ring.Allocate(0, 1) == StagingRing::INVALID_OFFSET;
+		rejected += ring.Allocate(1025, 1) == StagingRing::INVALID_OFFSET;
+		passed &= Check("zero and oversized requests fail", rejected == 2 && ring.GetStats().mFailedCount == 2, "%.0f of 2", double(rejected));
+
+		ring.Close(1);
+		ring.Close(1);
+		passed &= Check("closing nothing adds no batch", ring.GetPendingBatchCount() == 1 && ring.GetOpenSize() == 0, "%.0f batches", double(ring.GetPendingBatchCount()));
+
+		uint64_t d = ring.Allocate(500, 1);
+		uint64_t e = ring.Allocate(300, 1);
+		passed &= Check("an allocation fills up to the end", d == 378 && ring.GetUsedSize() == 878, "%.0f used", double(ring.GetUsedSize()));
+		passed &= Check("a full ring fails", e == StagingRing::INVALID_OFFSET && ring.GetOldestFenceValue() == 1, "oldest fence %.0f", double(ring.GetOldestFenceValue()));
+		ring.Close(2);
+
+		ring.Retire(0);
+		passed &= Check("nothing retires before its fence", ring.GetPendingBatchCount() == 2, "%.0f batches", double(ring.GetPendingBatchCount()));
+		ring.Retire(1);
+		e = ring.Allocate(300, 1);
+		// 146 bytes at the end are skipped and stay used until the second batch retires
+		passed &= Check("the tail wraps to the start, unsplit", e == 0 && ring.GetUsedSize() == 500 + 146 + 300, "offset %.0f", double(e));
+		passed &= Check("retired batches leave in order", ring.GetOldestFenceValue() == 2 && ring.GetPendingBatchCount() == 1, "oldest fence %.0f", double(ring.GetOldestFenceValue()));
+
+		ring.Close(3);
+		ring.Retire(3);
+		uint64_t f = ring.Allocate(1024, 1);
+		passed &= Check("an empty ring starts over at 0", ring.GetUsedSize() == 1024 && f == 0, "offset %.0f", double(f));
+	}
+
+	{
+		const uint64_t capacity = 64 * 1024;
+		StagingRing ring(capacity);
+		std::mt19937 random(seed);
+		std::vector<Allocation> live;
+		uint64_t fenceValue = 0, completedValue = 0;
+		int overlaps = 0, outside = 0, misaligned = 0, overfull = 0, allocations = 0;
+		for (int step = 0; step < 200000; step++)
+		{
+			uint32_t action = random() % 16;
+			if (action < 12)
+			{
+				uint64_t size = 1 + random() % (capacity / 4);
+				uint64_t alignment = uint64_t(1) << (random() % 10);
+				uint64_t offset = ring.Allocate(size, alignment);
+				if (offset == StagingRing::INVALID_OFFSET)
+					continue;
+				Allocation allocation = { offset, size, 0 };
+				for (const Allocation& other : live)
+					overlaps += Overlaps(allocation, other);
+				outside += offset + size > capacity;
+				misaligned += offset % alignment != 0;
+				live.push_back(allocation);
+				allocations++;
+			}
+			else if (action < 14)
+			{
+				fenceValue++;
+				for (Allocation& allocation : live)
+				{
+					if (allocation.mFenceValue == 0)
+						allocation.mFenceValue = fenceValue;
+				}
+				ring.Close(fenceValue);
+			}
+			else if (completedValue < fenceValue)
+			{
+				completedValue += 1 + random() % (fenceValue - completedValue);
+				ring.Retire(completedValue);
+				live.erase(std::remove_if(live.begin(), live.end(), [completedValue](const Allocation& allocation) {
+					return allocation.mFenceValue != 0 && allocation.mFenceValue <= completedValue;
+				}), live.end());
+			}
+			overfull += ring.GetUsedSize() > capacity;
+		}
+		passed &= Check("random run: no live bytes handed out twice", overlaps == 0, "%.0f allocations", double(allocations));
+		passed &= Check("random run: allocations stay in the ring", outside == 0 && overfull == 0, "%.0f outside", double(outside + overfull));
+		passed &= Check("random run: allocations are aligned", misaligned == 0, "%.0f misaligned", double(misaligned));
+	}
+
+	{
+		std::vector<uint8_t> memory(RingSize), source(2 * 1024 * 1024);
+		std::mt19937 random(seed);
+		for (uint8_t& byte : source)
+			byte = uint8_t(random());
+		uint64_t totalBytes = uint64_t(gigabytes * 1e9);
+
+		StagingRing ring, plain;
+		// warm up the pages of both buffers
+		Stream(RingSize, behind, seed, false, plain, memory, source);
+		double plainGbps = Stream(totalBytes, behind, seed, false, plain, memory, source);
+		double ringGbps = Stream(totalBytes, behind, seed, true, ring, memory, source);
+
+		const StagingRing::Stats& stats = ring.GetStats();
+		passed &= Check("throughput: no stalls", stats.mFailedCount == 0, "%.0f stalls", double(stats.mFailedCount));
+		passed &= Check("throughput: peak use fits the ring", stats.mPeakUsedSize <= RingSize, "%.1f MB peak", double(stats.mPeakUsedSize) / (1024.0 * 1024.0));
+		passed &= Check("throughput: ring keeps 80% of memcpy", ringGbps >= 0.8 * plainGbps, "%.1f GB/s", ringGbps);
+		std::printf("    plain buffer %.1f GB/s, %.0f uploads through the ring\n", plainGbps, double(stats.mAllocationCount));
+		if (minGbps > 0.0)
+			passed &= Check("throughput: above --min-gbps", ringGbps >= minGbps, "%.1f GB/s", ringGbps);
+	}
+
+	return passed ? 0 : 1;
+}